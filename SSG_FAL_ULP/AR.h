@@ -0,0 +1,460 @@
+/*
+ * ======================================================================================================================
+ *  AR.h - Log Archiver
+ *
+ *  With ar_ms set, each wake after the observation is logged spends at most ar_ms, or what is left of the background
+ *  budget (BG.h) when that is less, converting closed daily logs (days before today) into /OBS/YYYYMMDD.dla
+ *  archives, oldest day first. An archive is the delta log of OBS.h (obs_dl_encode(), the encoding of the .dlt)
+ *  closed with the SD_BINFTR footer of the binary log, the CRC32 of every byte before it. Each JSON line is parsed
+ *  back into the OBS_BINREC it would have been built as, so the archive holds the binary record's fields to its
+ *  precision, the other keys of the record are not kept. Summary records are left out. With ar_keep=0 the .log and
+ *  its .idx are removed once the archive is closed.
+ *
+ *  The work is resumed each wake from a cursor in AR_FILE, a contiguous file of one block written by a raw block
+ *  write: the day, how far into its .log, and the bytes, CRC32 and last record of the archive so far. The archive is
+ *  written before the cursor, on resume it is cut back to the cursor's bytes so a reset between the two writes
+ *  encodes those records again. A scan that finds no day to archive is not repeated until the date changes.
+ *  The time spent is charged to its own phase, PH_ARCH in WD.h. tools/obsdelta2json.py reads a .dla.
+ * ======================================================================================================================
+ */
+#define AR_FILE           "/OBS/ARCHIVE.cur"
+#define AR_MAGIC          0x52435241        // "ARCR"
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;                           // AR_MAGIC
+  uint32_t done;                            // YYYYMMDD of the last day archived, 0 = none
+  uint32_t idle;                            // YYYYMMDD of a scan that found nothing to archive
+  uint32_t day;                             // YYYYMMDD being archived, 0 = none
+  uint32_t src;                             // Bytes of its .log converted
+  uint32_t bytes;                           // Bytes of its .dla written
+  uint32_t crc;                             // CRC32 of them
+  uint32_t interval;                        // Interval s of the last record encoded
+  OBS_BINREC prev;                          // Last record encoded
+  uint32_t hcrc;                            // CRC32 of the above
+} AR_CURSOR;                                // 95 bytes
+
+#define AR_INT            0                 // Whole number
+#define AR_FIX32          1                 // Fixed point * 100
+#define AR_FIX16          2                 // Fixed point * 100, OBS_BIN_ERR when it does not fit
+
+typedef struct {
+  const char *key;                          // Observation record key
+  uint8_t  off;                             // Offset in OBS_BINREC
+  uint8_t  flag;                            // OBS_BIN_F_* it sets
+  uint8_t  kind;                            // AR_INT, AR_FIX32, AR_FIX16
+} AR_FIELD;
+
+const AR_FIELD ar_fields[] = {
+  {"sg", offsetof(OBS_BINREC, sg), 0, AR_INT},
+  {"sgmin", offsetof(OBS_BINREC, sgmin), OBS_BIN_F_STREAM, AR_INT},
+  {"sgmax", offsetof(OBS_BINREC, sgmax), OBS_BIN_F_STREAM, AR_INT},
+  {"sgiqr", offsetof(OBS_BINREC, sgiqr), OBS_BIN_F_STREAM, AR_INT},
+  {"bp1", offsetof(OBS_BINREC, bp1), OBS_BIN_F_BMX_1, AR_FIX32},
+  {"bt1", offsetof(OBS_BINREC, bt1), OBS_BIN_F_BMX_1, AR_FIX16},
+  {"bh1", offsetof(OBS_BINREC, bh1), OBS_BIN_F_BMX_1, AR_FIX16},
+  {"bp2", offsetof(OBS_BINREC, bp2), OBS_BIN_F_BMX_2, AR_FIX32},
+  {"bt2", offsetof(OBS_BINREC, bt2), OBS_BIN_F_BMX_2, AR_FIX16},
+  {"bh2", offsetof(OBS_BINREC, bh2), OBS_BIN_F_BMX_2, AR_FIX16},
+  {"mt1", offsetof(OBS_BINREC, mt1), OBS_BIN_F_MCP_1, AR_FIX16},
+  {"mt2", offsetof(OBS_BINREC, mt2), OBS_BIN_F_MCP_2, AR_FIX16},
+  {"bv", offsetof(OBS_BINREC, bv), OBS_BIN_F_BV, AR_FIX16},
+  {"hth", offsetof(OBS_BINREC, hth), 0, AR_INT},
+};
+#define AR_FIELDS         (sizeof(ar_fields) / sizeof(ar_fields[0]))
+
+AR_CURSOR ar;
+bool      ar_open = false;                  // AR_FILE found and ar_bgn set
+bool      ar_loaded = false;                // ar read back from it
+uint32_t  ar_bgn;                           // Its SD block
+
+/*
+ *=======================================================================================================================
+ * ar_open_file() - Find or create AR_FILE, false if it can not be used
+ *=======================================================================================================================
+ */
+bool ar_open_file() {
+  uint32_t bgn, end;
+  File fp;
+
+  if (ar_open) {
+    return (true);
+  }
+  fp = (SD.exists(AR_FILE)) ? SD.open(AR_FILE, FILE_READ) : SD.createContiguous(AR_FILE, 512);
+  if (!fp) {
+    return (false);
+  }
+  if ((fp.size() != 512) || !fp.contiguousRange(&bgn, &end)) {
+    fp.close();
+    return (false);
+  }
+  fp.close();
+  ar_bgn = bgn;
+  ar_open = true;
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_load() - Read the cursor back once a boot, a new or torn one starts from the oldest log
+ *=======================================================================================================================
+ */
+bool ar_load() {
+  uint8_t *buf;
+
+  if (ar_loaded) {
+    return (true);
+  }
+  buf = SdVolume::cacheClear();
+  if (!SdVolume::sdCard()->readBlock(ar_bgn, buf)) {
+    return (false);
+  }
+  memcpy (&ar, buf, sizeof(ar));
+  if ((ar.magic != AR_MAGIC) || (ar.hcrc != dsu_crc32(&ar, offsetof(AR_CURSOR, hcrc), 0))) {
+    memset (&ar, 0, sizeof(ar));
+    ar.magic = AR_MAGIC;
+  }
+  ar_loaded = true;
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_save() - Write the cursor, after the day's files are closed
+ *=======================================================================================================================
+ */
+bool ar_save() {
+  uint8_t *buf = SdVolume::cacheClear();
+
+  ar.hcrc = dsu_crc32(&ar, offsetof(AR_CURSOR, hcrc), 0);
+  memset (buf, 0, 512);
+  memcpy (buf, &ar, sizeof(ar));
+  if (!SdVolume::sdCard()->writeBlock(ar_bgn, buf)) {
+    Output ("AR:Write Err");
+    return (false);
+  }
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_digits() - Value of the n digits at s, -1 when they are not all digits
+ *=======================================================================================================================
+ */
+long ar_digits(const char *s, int n) {
+  long v = 0;
+
+  for (int i=0; i<n; i++) {
+    if (!isdigit(s[i])) {
+      return (-1);
+    }
+    v = v * 10 + (s[i] - '0');
+  }
+  return (v);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_logname() - Day of a daily log's file name, n digits then .LOG, 0 when it is not one
+ *=======================================================================================================================
+ */
+long ar_logname(const char *name, int n) {
+  long v = ar_digits(name, n);
+
+  return ((v > 0) && (strcasecmp(name + n, ".log") == 0) ? v : 0);
+}
+
+static_assert(SD_FILE_POOL >= 5, "ar_find() holds 3 files on top of SD_log and SD_mdir");
+
+/*
+ *=======================================================================================================================
+ * ar_find() - Oldest day after the last one archived and before today with a daily log, 0 when there is none
+ *=======================================================================================================================
+ */
+uint32_t ar_find(uint32_t today) {
+  uint32_t best = 0;
+  long d, m;
+  File dir, fp, sub;
+
+  dir = SD.open(SD_obsdir);
+  if (!dir) {
+    Output ("AR:Scan Open Err");
+    return (0);
+  }
+  while ((fp = dir.openNextFile())) {
+    if (!fp.isDirectory()) {
+      d = ar_logname(fp.name(), 8);
+      if ((d > (long) ar.done) && (d < (long) today) && (!best || (d < (long) best))) {
+        best = d;
+      }
+    }
+    else if (((m = ar_digits(fp.name(), 6)) > 0) && (fp.name()[6] == 0) && ((m * 100 + 31) > (long) ar.done) &&
+             ((m * 100) < (long) today) && (!best || ((m * 100) < (long) best))) {
+      while ((sub = fp.openNextFile())) {  // Month directory, sd_month=1
+        d = m * 100 + ar_logname(sub.name(), 2);
+        if ((d > m * 100) && (d > (long) ar.done) && (d < (long) today) && (!best || (d < (long) best))) {
+          best = d;
+        }
+        sub.close();
+      }
+    }
+    fp.close();
+  }
+  dir.close();
+  return (best);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_fixed() - Number text as the JSON record printed it, * 100 and truncated
+ *=======================================================================================================================
+ */
+long ar_fixed(const char *v) {
+  bool neg = (*v == '-');
+  char *e;
+  long l = strtol(v + neg, &e, 10) * 100;
+
+  if ((*e == '.') && isdigit(e[1])) {
+    l += (e[1] - '0') * 10;
+    if (isdigit(e[2])) {
+      l += e[2] - '0';
+    }
+  }
+  return ((neg) ? -l : l);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_parse() - Binary record and interval s of an observation line, false for a summary or a line that is not one
+ *=======================================================================================================================
+ */
+bool ar_parse(char *line, OBS_BINREC *r, uint32_t *interval) {
+  int y, mo, d, h, mi, s;
+  char *k, *v;
+  long l;
+  long p;
+
+  memset (r, 0, sizeof(*r));
+  *interval = cf_obs_interval * 60;
+  if (strncmp(line, "{\"at\":\"", 7) || (sscanf(line + 7, "%4d-%2d-%2dT%2d:%2d:%2d", &y, &mo, &d, &h, &mi, &s) != 6)) {
+    return (false);
+  }
+  r->type = OBS_BIN_TYPE;
+  r->at = DateTime(y, mo, d, h, mi, s).unixtime();
+  for (k = strstr(line, ",\""); k; k = strstr(v, ",\"")) {
+    k += 2;
+    v = strstr(k, "\":");
+    if (!v) {
+      return (false);
+    }
+    *v = 0;
+    v += 2;
+    if (!strcmp(k, "p")) {
+      return (false);  // Hour or day summary
+    }
+    if (!strcmp(k, "cad") && (atoi(v) > 0)) {
+      *interval = atoi(v) * 60;
+      continue;
+    }
+    if (!strcmp(k, "late")) {
+      r->flags |= OBS_BIN_F_LATE;
+      continue;
+    }
+    if ((k[0] == 'd') && (k[1] == 't') && ((p = ar_digits(k + 2, 1)) > 0) && (k[3] == 0) && (p <= DS_MAX_PROBES)) {
+      l = ar_fixed(v);
+      r->flags |= OBS_BIN_F_DS;
+      r->dt[p - 1] = (l < -32767 || l > 32767) ? OBS_BIN_ERR : (int16_t) l;
+      r->dtn = (p > r->dtn) ? p : r->dtn;
+      continue;
+    }
+    for (unsigned int f=0; f<AR_FIELDS; f++) {
+      if (strcmp(k, ar_fields[f].key)) {
+        continue;
+      }
+      l = (ar_fields[f].kind == AR_INT) ? atol(v) : ar_fixed(v);
+      if (ar_fields[f].kind == AR_FIX32) {
+        memcpy ((uint8_t *) r + ar_fields[f].off, &l, 4);
+      }
+      else {
+        int16_t i = ((ar_fields[f].kind == AR_FIX16) && (l < -32767 || l > 32767)) ? OBS_BIN_ERR : (int16_t) l;
+        memcpy ((uint8_t *) r + ar_fields[f].off, &i, 2);
+      }
+      r->flags |= ar_fields[f].flag;
+      break;
+    }
+  }
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_record() - Encode an observation line onto the archive, false when the write failed
+ *=======================================================================================================================
+ */
+bool ar_record(File &out, char *line) {
+  uint8_t buf[OBS_DL_MAX];
+  OBS_BINREC r;
+  uint32_t interval;
+  int len;
+
+  if (!ar_parse(line, &r, &interval)) {
+    return (true);
+  }
+  len = obs_dl_encode(buf, &r, &ar.prev, interval, (ar.bytes == 0) || (interval != ar.interval));
+  if (out.write(buf, len) != (size_t) len) {
+    return (false);
+  }
+  ar.crc = dsu_crc32(buf, len, ar.crc);
+  ar.bytes += len;
+  ar.prev = r;
+  ar.interval = interval;
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_close() - Footer on the finished archive, the log removed when it is not kept
+ *=======================================================================================================================
+ */
+bool ar_close(File &out, const char *logfile) {
+  char path[24];
+  SD_BINFTR f;
+
+  memset (&f, 0, sizeof(f));
+  f.type = SD_BIN_FOOTER;
+  f.at = now.unixtime();
+  f.bytes = ar.bytes;
+  f.crc = ar.crc;
+  if (out.write((const uint8_t *)&f, sizeof(f)) != sizeof(f)) {
+    return (false);
+  }
+  out.close();
+  if (!cf_ar_keep) {
+    SD.remove(logfile);
+    strcpy (path, logfile);
+    strcpy (strrchr(path, '.') + 1, "idx");
+    SD.remove(path);
+  }
+  LOG_INFO ("AR:%s %lu>%lu", logfile, (unsigned long) ar.src, (unsigned long) ar.bytes);
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ar_service() - Archive closed days for at most ms, ar_ms when 0 or less, true if there was a day to work on. Call
+ *   after the observation is logged.
+ *=======================================================================================================================
+ */
+bool ar_service(unsigned long ms) {
+  unsigned long start = millis();
+  const int full = sizeof(msgbuf) - 1;  // Longest record jb_ builds, msgbuf is free once it is logged
+  char logfile[24], path[24];
+  uint32_t today;
+  char *p, *e;
+  bool eof = false;
+  bool ok = true;
+  int n;
+  File in, out;
+
+  if (!cf_ar_ms || !SD_exists || SD_down || !RTC_valid || !ar_open_file() || !ar_load()) {
+    return (false);
+  }
+  if (!ms || (ms > (unsigned long) cf_ar_ms)) {
+    ms = cf_ar_ms;
+  }
+  today = now.year() * 10000UL + now.month() * 100 + now.day();
+  if (!ar.day) {
+    if (ar.idle == today) {
+      return (false);
+    }
+    ar.day = ar_find(today);
+    if (!ar.day) {
+      ar.idle = today;
+      ar_save();
+      return (false);
+    }
+    ar.src = 0;
+  }
+
+  DateTime day(ar.day / 10000, (ar.day / 100) % 100, ar.day % 100);
+  SD_DayPath(logfile, day, "log");
+  SD_DayPath(path, day, "dla");
+  if ((SD_wb_len > 0) && !strcmp(logfile, SD_wb_logfile)) {
+    return (false);  // Held observations of that day go in first
+  }
+  if (!strcmp(logfile, SD_log_name)) {
+    SD_LogClose();
+  }
+
+  in = SD.open(logfile, FILE_READ);
+  if (!in) {
+    ar.done = ar.day;  // Removed since the scan, on to the next
+    ar.day = 0;
+    ar_save();
+    return (true);
+  }
+  out = SD.open(path, O_READ | O_WRITE | O_CREAT);
+  if (out && (out.size() < ar.bytes)) {
+    ar.src = 0;  // Archive is not the one the cursor was written for, start the day again
+  }
+  if (ar.src == 0) {
+    ar.bytes = 0;
+    ar.crc = 0;
+    ar.interval = 0;
+    memset (&ar.prev, 0, sizeof(ar.prev));
+  }
+  if (!out || !out.truncate(ar.bytes) || !out.seek(ar.bytes)) {
+    in.close();
+    out.close();
+    Output ("AR:Open Err");
+    return (true);
+  }
+
+  while (ok && !eof && ((millis() - start) < ms)) {
+    wd_feed();
+    if (!in.seek(ar.src)) {
+      ok = false;
+      break;
+    }
+    n = in.read(msgbuf, full);
+    if (n <= 0) {
+      eof = true;
+      break;
+    }
+    msgbuf[n] = 0;
+    p = msgbuf;
+    while (ok && (p < msgbuf + n)) {
+      e = (char *) memchr(p, '\n', msgbuf + n - p);
+      if (!e && ((p == msgbuf) || (n < full))) {
+        e = msgbuf + n;  // Line as long as msgbuf, or the last one of the file without its CRLF
+      }
+      else if (!e) {
+        break;  // Rest of it with the next read
+      }
+      ar.src += (e - p) + ((e < msgbuf + n) ? 1 : 0);
+      *e = 0;
+      ok = ar_record(out, p);
+      p = e + 1;
+    }
+    eof = (n < full) && (p >= msgbuf + n);
+  }
+
+  in.close();
+  if (ok && eof) {
+    ok = ar_close(out, logfile);
+    if (ok) {
+      ar.done = ar.day;
+      ar.day = 0;
+    }
+  }
+  else {
+    out.close();
+  }
+  if (!ok) {
+    out.close();
+    ar_loaded = false;  // Cursor on the card is the last good one, the next wake cuts the archive back to it
+    Output ("AR:Err");
+    return (true);
+  }
+  ar_save();
+  return (true);
+}
@@ -0,0 +1,91 @@
+/*
+ * ======================================================================================================================
+ *  BG.h - Background Work Budget
+ *
+ *  The optional work of a wake, after the observation is logged and the warm start snapshot written, runs from
+ *  bg_tasks[] in priority order: telemetry, the runtime statistics write and the log archiver. With bg_ms set the
+ *  wake has that many ms for them. Each task keeps how long its last run with work took and is started only when
+ *  that fits in what is left, else it waits for the next wake with its counters as they were, the stats write one
+ *  observation later, the radio at the next wake. The archiver is handed what is left, at most ar_ms, and resumes
+ *  from its cursor. A task passed over BG_DEFER_MAX wakes in a row runs first the next wake whatever it costs, so
+ *  the ones above it cannot starve it, that wake can run over. bg_over counts the wakes that did, bg_deferred the
+ *  tasks passed over. With bg_ms=0 every task runs each wake. Each task's time is charged to its phase (WD.h).
+ * ======================================================================================================================
+ */
+#define BG_DEFER_MAX      4                 // Wakes a task is passed over before it runs regardless
+#define BG_SLICE_MS       100               // Least a task that takes a slice is given
+
+typedef struct {
+  const char *name;
+  bool (*run)(unsigned long ms);            // ms it may take, 0 = no budget, true if it had work
+  int phase;                                // PH_*
+  bool sliced;                              // Stops when its ms are up, any slice fits
+  unsigned long cost_ms;                    // Its last run with work
+  uint8_t deferred;                         // Wakes in a row it was passed over
+} BG_TASK;
+
+uint32_t bg_over = 0;                       // Wakes that ran past bg_ms
+uint32_t bg_deferred = 0;                   // Tasks passed over for the budget
+
+/*
+ *=======================================================================================================================
+ * bg_tl(), bg_rs(), bg_ar() - The tasks, in the form bg_service() calls
+ *=======================================================================================================================
+ */
+bool bg_tl(unsigned long ms) {
+  return (tl_service());
+}
+
+bool bg_rs(unsigned long ms) {
+  return (rs_service());
+}
+
+bool bg_ar(unsigned long ms) {
+  return (ar_service(ms));
+}
+
+BG_TASK bg_tasks[] = {
+  { "tl", bg_tl, PH_SLEEP, false },
+  { "rs", bg_rs, PH_SLEEP, false },
+  { "ar", bg_ar, PH_ARCH, true },
+};
+#define BG_COUNT          (sizeof(bg_tasks) / sizeof(bg_tasks[0]))
+
+/*
+ *=======================================================================================================================
+ * bg_service() - Run the background tasks that fit in bg_ms, starved ones first, call after ws_save()
+ *=======================================================================================================================
+ */
+void bg_service() {
+  unsigned long start = millis();
+  unsigned long used, left, t0;
+  bool done[BG_COUNT];
+  BG_TASK *t;
+
+  memset (done, 0, sizeof(done));
+  for (int pass=0; pass<2; pass++) {
+    for (unsigned int i=0; i<BG_COUNT; i++) {
+      t = &bg_tasks[i];
+      if (done[i] || ((pass == 0) && (!cf_bg_ms || (t->deferred < BG_DEFER_MAX)))) {
+        continue;  // Starved ones go in the first pass
+      }
+      done[i] = true;
+      used = millis() - start;
+      left = (used < (unsigned long) cf_bg_ms) ? (cf_bg_ms - used) : 0;
+      if (cf_bg_ms && (pass == 1) && (!left || (!t->sliced && (t->cost_ms > left)))) {
+        t->deferred++;
+        bg_deferred++;
+        continue;
+      }
+      t0 = millis();
+      if (t->run((cf_bg_ms) ? max(left, (unsigned long) BG_SLICE_MS) : 0)) {
+        t->cost_ms = millis() - t0;
+      }
+      t->deferred = 0;
+      ph_end(t->phase);
+    }
+  }
+  if (cf_bg_ms && ((millis() - start) > (unsigned long) cf_bg_ms)) {
+    bg_over++;
+  }
+}
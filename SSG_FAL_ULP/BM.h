@@ -0,0 +1,519 @@
+/*
+ * ======================================================================================================================
+ *  BM.h - On-target Benchmarks
+ *
+ *  bm_run() times the hot paths of an observation on the hardware, from the sh "bench" command. The M0+ has no DWT
+ *  cycle counter, bm_cycles() counts CPU cycles from millis() and the SysTick down counter, which runs at the CPU
+ *  clock. Each case is run BM_REPS times (sensor and SD cases fewer) and reported as cycles and us per run, then
+ *  all of them go in one block appended to /OBS/BENCH.log with the firmware version, so runs of different
+ *  firmware on the same station can be compared. Cases that change data work on copies, the copy is timed alone
+ *  and taken off.
+ *
+ *  bm_sd_latency(), the sh "bench sd" command, qualifies a card: BM_LAT_REPS writes of each kind the logging does,
+ *  single blocks and BM_LAT_MULTI block runs to a contiguous scratch file, and the open, append and close of a
+ *  record, are timed as Sd2Card reports them to the stats histograms (RS.h) and printed as percentiles in us. The
+ *  card's CID goes in BM_FILE with them, so cards of a batch can be told apart.
+ *
+ *  bm_golden() replays a canned trace of BM_TRACE_N observations, made by a fixed LCG so it is the same on every
+ *  board, through the gauge median, field QC, a binary record, its JSON line and the delta encoder. Each stage's
+ *  output over the trace is reduced to a CRC32 and its time per observation reported like the cases above. The
+ *  CRCs are compared with BM_GOLD_FILE, written by the first run and again by "bench gold set" once a change in
+ *  output is meant, a stage whose bytes differ is reported CHANGED. The sd_log case also reports the card blocks
+ *  read, written and written twice per record (SDC.h Block I/O), they count in the cycle the bench ran in.
+ * ======================================================================================================================
+ */
+#define BM_REPS           20        // Runs of each CPU case
+#define BM_SD_REPS        5         // Runs of the SD open, write, close
+#define BM_N              60        // Samples sorted, the default sg_samples
+#define BM_MAX            24        // Cases reported
+#define BM_FILE           "/OBS/BENCH.log"
+#define BM_LAT_REPS       32        // Writes of each kind bm_sd_latency() times
+#define BM_LAT_MULTI      8         // Blocks in each multi-block write
+#define BM_LAT_FILE       "/OBS/BENCH.tmp"
+#define BM_TRACE_N        96        // Observations bm_golden() replays, a day at 15 minutes
+#define BM_TRACE_T0       1704067200UL  // 2024-01-01T00:00:00, time of the first
+#define BM_TRACE_S        900       // Seconds between them
+#define BM_GOLD_FILE      "/OBS/BENCH.gld"
+#define BM_GOLD_STAGES    4
+#define BM_GOLD_NONE      0         // bm_gold_state[], not run
+#define BM_GOLD_SAME      1
+#define BM_GOLD_CHANGED   2
+#define BM_GOLD_SET       3         // Written to BM_GOLD_FILE
+
+typedef struct {
+  const char *name;
+  uint32_t cycles;                  // Per run
+  uint32_t us;
+} BM_RESULT;
+
+BM_RESULT bm_results[BM_MAX];
+int bm_count = 0;
+uint32_t bm_lat[BM_LAT_REPS];       // us of each write timed
+int bm_lat_n = 0;
+
+const char *bm_gold_names[BM_GOLD_STAGES] = {"g_median", "g_qc", "g_json", "g_delta"};
+uint32_t bm_gold[BM_GOLD_STAGES];   // CRC32 of each stage's output over the trace
+uint8_t bm_gold_state[BM_GOLD_STAGES];  // BM_GOLD_*
+const char *bm_gold_words[] = {"", "same", "CHANGED", "set"};
+
+/*
+ * ======================================================================================================================
+ * bm_cycles() - CPU cycles since boot, wraps every 89 s at 48 MHz
+ * ======================================================================================================================
+ */
+uint32_t bm_cycles() {
+  uint32_t ms, val;
+
+  do {
+    ms = millis();
+    val = SysTick->VAL;
+  } while (ms != millis());  // SysTick wrapped between the two
+  return (ms * (SysTick->LOAD + 1) + (SysTick->LOAD - val));
+}
+
+/*
+ * ======================================================================================================================
+ * bm_report() - Keep and print a case, total cycles over reps runs
+ * ======================================================================================================================
+ */
+void bm_report(const char *name, uint32_t total, int reps) {
+  uint32_t cycles = total / reps;
+  uint32_t us = (uint32_t) (((uint64_t) cycles * 1000) / (SysTick->LOAD + 1));
+
+  if (bm_count < BM_MAX) {
+    bm_results[bm_count].name = name;
+    bm_results[bm_count].cycles = cycles;
+    bm_results[bm_count].us = us;
+    bm_count++;
+  }
+  sprintf (msgbuf, "BM:%s %lucy %luus", name, (unsigned long) cycles, (unsigned long) us);
+  Output (msgbuf);
+  wd_feed();
+}
+
+/*
+ * ======================================================================================================================
+ * bm_sensor() - Start, wait for and read one sensor of sn_table[]
+ * ======================================================================================================================
+ */
+void bm_sensor(SENSOR *s, int reps) {
+  uint32_t start = bm_cycles();
+  unsigned long ms;
+
+  for (int i=0; i<reps; i++) {
+    s->start(s);
+    ms = millis();
+    while (!s->ready(s) && ((millis() - ms) < s->wait_ms));
+    s->read(s);
+  }
+  bm_report(s->key[0], bm_cycles() - start, reps);
+}
+
+/*
+ * ======================================================================================================================
+ * bm_save() - Append the results to BM_FILE
+ * ======================================================================================================================
+ */
+void bm_save() {
+  File fp;
+
+  if (!SD_exists || SD_down) {
+    return;
+  }
+  fp = SD.open(BM_FILE, FILE_WRITE);
+  if (!fp) {
+    Output ("BM:Log Err");
+    return;
+  }
+  rtc_timestamp();
+  sprintf (msgbuf, "%s %s %luMHz", timestamp, VERSION_INFO, (unsigned long) ((SysTick->LOAD + 1) / 1000));
+  fp.println(msgbuf);
+  for (int i=0; i<bm_count; i++) {
+    sprintf (msgbuf, "  %s %lu %lu", bm_results[i].name, (unsigned long) bm_results[i].cycles,
+      (unsigned long) bm_results[i].us);
+    fp.println(msgbuf);
+  }
+  for (int i=0; i<BM_GOLD_STAGES; i++) {
+    if (bm_gold_state[i] != BM_GOLD_NONE) {
+      sprintf (msgbuf, "  %s %08lX %s", bm_gold_names[i], (unsigned long) bm_gold[i], bm_gold_words[bm_gold_state[i]]);
+      fp.println(msgbuf);
+    }
+  }
+  fp.close();
+  Output ("BM:Logged");
+}
+
+/*
+ * ======================================================================================================================
+ * bm_gold_file() - Compare the stage CRCs with BM_GOLD_FILE, or write them to it when set or it is not there
+ * ======================================================================================================================
+ */
+void bm_gold_file(bool set) {
+  uint32_t kept[BM_GOLD_STAGES];
+  char line[32];
+  int n = 0;
+  int len;
+  File fp;
+
+  if (!SD_exists || SD_down) {
+    return;
+  }
+  if (!set && (fp = SD.open(BM_GOLD_FILE, FILE_READ))) {
+    while ((n < BM_GOLD_STAGES) && ((len = fp.readBytesUntil('\n', line, sizeof(line) - 1)) > 0)) {
+      line[len] = 0;
+      kept[n++] = strtoul(line, NULL, 16);
+    }
+    fp.close();
+  }
+  if (n == BM_GOLD_STAGES) {
+    for (int i=0; i<BM_GOLD_STAGES; i++) {
+      bm_gold_state[i] = (kept[i] == bm_gold[i]) ? BM_GOLD_SAME : BM_GOLD_CHANGED;
+    }
+    return;
+  }
+  SD.remove(BM_GOLD_FILE);
+  fp = SD.open(BM_GOLD_FILE, FILE_WRITE);
+  if (!fp) {
+    Output ("BM:Gold Err");
+    return;
+  }
+  for (int i=0; i<BM_GOLD_STAGES; i++) {
+    sprintf (line, "%08lX %s", (unsigned long) bm_gold[i], bm_gold_names[i]);
+    fp.println(line);
+    bm_gold_state[i] = BM_GOLD_SET;
+  }
+  fp.close();
+}
+
+/*
+ * ======================================================================================================================
+ * bm_golden() - Replay the canned trace through the output path, time and fingerprint each stage, set = accept them
+ * ======================================================================================================================
+ */
+void bm_golden(bool set) {
+  uint16_t work[BM_N];
+  uint8_t dl[OBS_DL_MAX];
+  char json[256];
+  OBS_BINREC rec, prev;
+  uint32_t cycles[BM_GOLD_STAGES];
+  uint32_t r = 2024;
+  uint32_t start;
+  int32_t raw[3], value[3];
+  uint16_t mm;
+  uint8_t codes;
+  int level = 400;
+  int n;
+
+  memset (bm_gold, 0, sizeof(bm_gold));
+  memset (cycles, 0, sizeof(cycles));
+  memset (&prev, 0, sizeof(prev));
+  for (int k=0; k<BM_TRACE_N; k++) {
+    // Gauge samples round a level that wanders, snow coming and going
+    r = r * 1103515245 + 12345;
+    level += (int) ((r >> 16) % 9) - 4;
+    for (int i=0; i<BM_N; i++) {
+      r = r * 1103515245 + 12345;
+      work[i] = level + ((r >> 16) % 64);
+    }
+    start = bm_cycles();
+    mm = mymedian(work, BM_N);
+    cycles[0] += bm_cycles() - start;
+    bm_gold[0] = dsu_crc32(&mm, sizeof(mm), bm_gold[0]);
+
+    // Pressure, temperature and humidity, every 16th out of range and every 32nd no reading
+    r = r * 1103515245 + 12345;
+    raw[QC_P] = (950L + (r >> 16) % 100) * FIX_ONE + (r & 0xFFF);
+    raw[QC_T] = ((long) ((r >> 8) % 80) - 30) * FIX_ONE + (r & 0x3FF);
+    raw[QC_RH] = ((r >> 20) % 100) * FIX_ONE;
+    if ((k % 16) == 15) {
+      raw[k % 3] = ((k / 16) & 1) ? qc_fields[k % 3].max + FIX_ONE : qc_fields[k % 3].min - FIX_ONE;
+    }
+    if ((k % 32) == 31) {
+      raw[QC_T] = FIX_NAN;
+    }
+    start = bm_cycles();
+    codes = 0;
+    for (int f=0; f<3; f++) {
+      codes |= qc_check(f, raw[f], &value[f]) << (f * QC_BITS);
+    }
+    cycles[1] += bm_cycles() - start;
+    bm_gold[1] = dsu_crc32(value, sizeof(value), dsu_crc32(&codes, 1, bm_gold[1]));
+
+    // The record an observation of these would log
+    memset (&rec, 0, sizeof(rec));
+    rec.type = OBS_BIN_TYPE;
+    rec.flags = OBS_BIN_F_BMX_1 | OBS_BIN_F_DS | OBS_BIN_F_BV;
+    rec.at = BM_TRACE_T0 + (uint32_t) k * BM_TRACE_S;
+    rec.sg = mm;
+    rec.bp1 = value[QC_P] / (FIX_ONE / 100);
+    rec.bt1 = OBS_fp16(value[QC_T]);
+    rec.bh1 = OBS_fp16(value[QC_RH]);
+    rec.bv = 400 - (k / 8);
+    rec.hth = codes;
+    rec.dtn = 1;
+    rec.dt[0] = rec.bt1 - 150;
+    rec.crc = OBS_bin_crc(&rec);
+
+    start = bm_cycles();
+    OBS_bin_json(&rec, json, sizeof(json));
+    cycles[2] += bm_cycles() - start;
+    bm_gold[2] = dsu_crc32(json, strlen(json), bm_gold[2]);
+
+    start = bm_cycles();
+    n = obs_dl_encode(dl, &rec, &prev, BM_TRACE_S, k == 0);
+    cycles[3] += bm_cycles() - start;
+    bm_gold[3] = dsu_crc32(dl, n, bm_gold[3]);
+    prev = rec;
+    wd_feed();
+  }
+
+  bm_gold_file(set);
+  for (int i=0; i<BM_GOLD_STAGES; i++) {
+    bm_report(bm_gold_names[i], cycles[i], BM_TRACE_N);
+    sprintf (msgbuf, "BM:%s %08lX %s", bm_gold_names[i], (unsigned long) bm_gold[i],
+      bm_gold_words[bm_gold_state[i]]);
+    Output (msgbuf);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * bm_run() - All cases
+ * ======================================================================================================================
+ */
+void bm_run() {
+  uint16_t data[BM_N], work[BM_N];
+  uint32_t start, copy;
+  uint32_t io[3];
+  uint32_t r = 12345;
+  char buf[32];
+  JSONBUF jb;
+  File fp;
+
+  bm_count = 0;
+  memset (bm_gold_state, 0, sizeof(bm_gold_state));
+  for (int i=0; i<BM_N; i++) {
+    r = r * 1103515245 + 12345;  // Gauge like counts, noise around a level
+    data[i] = 400 + ((r >> 16) % 64);
+  }
+
+  // Sample selection
+  start = bm_cycles();
+  for (int i=0; i<BM_REPS; i++) {
+    memcpy (work, data, sizeof(work));
+  }
+  copy = bm_cycles() - start;
+
+  start = bm_cycles();
+  for (int i=0; i<BM_REPS; i++) {
+    memcpy (work, data, sizeof(work));
+    mysort(work, BM_N);
+  }
+  bm_report("mysort60", bm_cycles() - start - copy, BM_REPS);
+
+  start = bm_cycles();
+  for (int i=0; i<BM_REPS; i++) {
+    memcpy (work, data, sizeof(work));
+    mymedian(work, BM_N);
+  }
+  bm_report("median60", bm_cycles() - start - copy, BM_REPS);
+
+  // Number formatting, a pressure to 4 places
+  start = bm_cycles();
+  for (int i=0; i<BM_REPS; i++) {
+    sprintf (buf, "%ld.%04ld", 1013L + i, 2500L);
+  }
+  bm_report("sprintf", bm_cycles() - start, BM_REPS);
+
+  start = bm_cycles();
+  for (int i=0; i<BM_REPS; i++) {
+    jb_init(&jb, buf, sizeof(buf));
+    jb_putfixed(&jb, (1013L + i) * FIX_ONE + FIX_ONE / 4, 4);
+  }
+  bm_report("jb_fixed", bm_cycles() - start, BM_REPS);
+
+  // A record's open, write and close, to a scratch file
+  if (SD_exists && !SD_down) {
+    memset (msgbuf, 'x', 200);
+    msgbuf[200] = 0;
+    memcpy (io, sd_io_n, sizeof(io));
+    start = bm_cycles();
+    for (int i=0; i<BM_SD_REPS; i++) {
+      fp = SD.open("/OBS/BENCH.tmp", FILE_WRITE);
+      if (fp) {
+        fp.println(msgbuf);
+        fp.close();
+      }
+      wd_feed();
+    }
+    bm_report("sd_log", bm_cycles() - start, BM_SD_REPS);
+    sprintf (msgbuf, "BM:sd_log blocks %lu read %lu written %lu rewritten per record",
+      (unsigned long) (sd_io_n[SD_IO_READS] - io[SD_IO_READS]) / BM_SD_REPS,
+      (unsigned long) (sd_io_n[SD_IO_WRITES] - io[SD_IO_WRITES]) / BM_SD_REPS,
+      (unsigned long) (sd_io_n[SD_IO_REWRITES] - io[SD_IO_REWRITES]) / BM_SD_REPS);
+    Output (msgbuf);
+    SD.remove("/OBS/BENCH.tmp");
+  }
+
+  // A scroll of the OLED, every page changes
+  if (DisplayEnabled) {
+    start = bm_cycles();
+    for (int i=0; i<BM_SD_REPS; i++) {
+      OLED_write("BM:oled");
+      iq_drain();
+    }
+    bm_report("oled", bm_cycles() - start, BM_SD_REPS);
+  }
+
+  start = bm_cycles();
+  for (int i=0; i<BM_REPS; i++) {
+    I2C_Device_Exist(RTC_I2C_ADDRESS);
+  }
+  bm_report("i2c_probe", bm_cycles() - start, BM_REPS);
+
+  // Each sensor fitted, a whole read as an observation does it
+  for (int i=0; i<SN_COUNT; i++) {
+    if (*sn_table[i].exists) {
+      bm_sensor(&sn_table[i], (i == SN_DS_1) ? 1 : BM_SD_REPS);
+    }
+  }
+
+  start = bm_cycles();
+  for (int i=0; i<BM_REPS; i++) {
+    vbat_mv();
+  }
+  bm_report("vbat", bm_cycles() - start, BM_REPS);
+
+  bm_golden(false);
+  bm_save();
+}
+
+/*
+ * ======================================================================================================================
+ * bm_lat_hook() - Sd2Card latency hook while bm_sd_latency() runs, keeps the time of each write
+ * ======================================================================================================================
+ */
+void bm_lat_hook(uint8_t kind, uint32_t us) {
+  if (bm_lat_n < BM_LAT_REPS) {
+    bm_lat[bm_lat_n++] = us;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * bm_lat_report() - Percentiles of the writes timed, printed and appended to the open BM_FILE
+ * ======================================================================================================================
+ */
+void bm_lat_report(File *fp, const char *name) {
+  uint32_t v;
+  int i, j;
+
+  if (bm_lat_n == 0) {
+    sprintf (msgbuf, "BM:%s Err", name);
+    Output (msgbuf);
+    return;
+  }
+  for (i=1; i<bm_lat_n; i++) {  // Insertion sort, a few dozen values
+    v = bm_lat[i];
+    for (j=i; (j>0) && (bm_lat[j-1] > v); j--) {
+      bm_lat[j] = bm_lat[j-1];
+    }
+    bm_lat[j] = v;
+  }
+  sprintf (msgbuf, "BM:%s p50 %lu p90 %lu p99 %lu max %luus", name, (unsigned long) bm_lat[(bm_lat_n - 1) / 2],
+    (unsigned long) bm_lat[((bm_lat_n - 1) * 90) / 100], (unsigned long) bm_lat[((bm_lat_n - 1) * 99) / 100],
+    (unsigned long) bm_lat[bm_lat_n - 1]);
+  Output (msgbuf);
+  if (*fp) {
+    fp->print("  ");
+    fp->println(msgbuf + 3);
+  }
+  wd_feed();
+}
+
+/*
+ * ======================================================================================================================
+ * bm_sd_latency() - Time the card's writes of each kind, the card must be up and held records flushed
+ * ======================================================================================================================
+ */
+void bm_sd_latency() {
+  Sd2Card *card = SdVolume::sdCard();
+  uint32_t bgn, end, start;
+  uint8_t *buf;
+  File fp, log;
+  cid_t cid;
+  bool ok = true;
+
+  // Scratch file for the raw writes, contiguous like the logs
+  SD.remove(BM_LAT_FILE);
+  fp = SD.createContiguous(BM_LAT_FILE, (uint32_t) BM_LAT_REPS * BM_LAT_MULTI * 512);
+  if (!fp || !fp.contiguousRange(&bgn, &end)) {
+    Output ("BM:Scratch Err");
+    if (fp) {
+      fp.close();
+      SD.remove(BM_LAT_FILE);
+    }
+    return;
+  }
+  fp.close();
+
+  log = SD.open(BM_FILE, FILE_WRITE);
+  memset (&cid, 0, sizeof(cid));
+  card->readCID(&cid);
+  rtc_timestamp();
+  sprintf (msgbuf, "%s %s SD %02X %.2s %.5s %u.%u %08lX", timestamp, VERSION_INFO, cid.mid, cid.oid, cid.pnm,
+    cid.prv_n, cid.prv_m, (unsigned long) cid.psn);
+  Output (msgbuf);
+  if (log) {
+    log.println(msgbuf);
+  }
+
+  buf = SdVolume::cacheClear();  // Volume cache, the next file access reads its block again
+  for (int i=0; i<512; i++) {
+    buf[i] = i;
+  }
+  card->latencyHook(bm_lat_hook);
+
+  bm_lat_n = 0;
+  for (int i=0; ok && (i<BM_LAT_REPS); i++) {
+    ok = card->writeBlock(bgn + (i * BM_LAT_MULTI), buf);
+  }
+  bm_lat_report(&log, "sd_blk");
+
+  bm_lat_n = 0;
+  for (int i=0; ok && (i<BM_LAT_REPS); i++) {
+    ok = card->writeStart(bgn + (i * BM_LAT_MULTI), BM_LAT_MULTI);
+    for (int b=0; ok && (b<BM_LAT_MULTI); b++) {
+      ok = card->writeData(buf);
+    }
+    ok = card->writeStop() && ok;
+  }
+  bm_lat_report(&log, "sd_multi");
+
+  card->latencyHook(rs_latency);
+  SD.remove(BM_LAT_FILE);
+
+  // A record appended as SD_Flush() does without the contiguous log, open, write and close each time
+  memset (msgbuf, 'x', 200);
+  msgbuf[200] = 0;
+  bm_lat_n = 0;
+  for (int i=0; ok && (i<BM_LAT_REPS); i++) {
+    start = micros();
+    fp = SD.open(BM_LAT_FILE, FILE_WRITE);
+    ok = fp && (fp.println(msgbuf) > 0);
+    if (fp) {
+      fp.close();
+    }
+    bm_lat[bm_lat_n++] = micros() - start;
+  }
+  SD.remove(BM_LAT_FILE);
+  bm_lat_report(&log, "sd_open");
+
+  if (!ok) {
+    Output ("BM:Write Err");
+  }
+  if (log) {
+    log.close();
+    Output ("BM:Logged");
+  }
+}
@@ -5,8 +5,333 @@
 #
 # Line Length is limited to 63 characters
 #12345678901234567890123456789012345678901234567890123456789012
+# Minutes between observations, aligned to midnight, must
+# divide 1440 (1,5,15 default,60)
+obs_interval=15
+# Pin wired to DS3231 INT/SQW to wake on Alarm1, 0 = sleep on
+# SAMD RTC (default)
+rtc_int_pin=0
+# Pin wired to the DS3231 32K output, the SAMD RTC timing the
+# sleeps runs from it and the DS3231 is read over I2C once a
+# day, D6 or D1, 0 = board crystal (default)
+rtc_32k_pin=0
+# Add awake time per phase of the last cycle to the record,
+# "tm":[...] in ms, the gauge window, "sgw":[ms, ms the latest
+# sample came after its slot], and the last sleep, "slp":[ms
+# asked, s slept, wake 1 timer 2 alarm 4 gauge event 8 button
+# 16 brownout, s woken after the wake time], and the card's
+# blocks, "sdio":[read, written, written twice], 0 = off
+# (default)
+obs_tm=0
+# Log only on change: gauge mm and temperature deg C * 10 a
+# value must move from the last logged observation, 0 = log
+# every observation (default). Skipped ones log "skn" and the
+# gauge range "sglo" "sghi" with the next record
+obs_db_sg=0
+obs_db_t=0
+# Minutes after the last logged observation before one is
+# logged even without a change, 0 = none
+obs_hb=60
+# Adaptive cadence: minutes to observe at while the gauge moves
+# obs_fast_mm mm an hour or a temperature obs_fast_t deg C * 10
+# an hour, must divide 1440 and be under obs_interval, 0 = off
+# (default). Steady weather doubles the interval back up to
+# obs_slow minutes, 0 = obs_interval (default)
+obs_fast=0
+obs_fast_mm=10
+obs_fast_t=20
+obs_slow=0
+# Seasonal schedule, up to 6 entries ss1-ss6 of
+# MMDD,INTERVAL,SAMPLES,DS_RES,DISPLAY: from month and day MMDD
+# (UTC) until the next entry's date, the last one running into
+# the first, observe every INTERVAL minutes (must divide 1440)
+# with SAMPLES gauge samples at DS_RES DS18B20 bits, 0 = the
+# obs_interval, sg_samples and ds_res set here. DISPLAY 0 keeps
+# the OLED off. The power profiles still apply on top. No
+# entries (default) = no schedule. e.g. ss1=1101,60,30,9,0
+# ss2=0401,15,60,12,1 ss3=0601,5,0,0,1
+# Hourly and daily summary records in /OBS/SUM.log, per field
+# [n,min,max,mean,first,last], 0 = off (default)
+obs_sum=0
+# Battery volts * 100 to enter the SAVE and CRITICAL power
+# profiles, 0 = off
+pwr_save=360
+pwr_crit=340
+# Date of the next site visit YYYYMMDD, the interval is
+# stretched so the battery lasts until then, 0 = off (default)
+pwr_until=0
+# Battery V*100 taken as empty by pwr_until
+pwr_empty=330
+# 3.3V rail V*100 of the brownout early warning, held records
+# are flushed and the board sleeps until the rail is back, 0 =
+# off (default), e.g. 300. Must be above the brownout reset
+# the fuses set, 2.84V on the Feather
+pwr_bod=0
 # Distance sensor type 0 = 5m (default), 1 = 10m
 ds_type=0
+# Distance sensor model, 0 = from ds_type (default), else one
+# of 7360 7369 7380 7389 (5m) 7363 7366 7383 7386 (10m)
+sg_model=0
+# Gauge channels scanned in one sampling window (1-4). Channel
+# 1 is A3, 2 is A4, 3 is A2, 4 is A1. Each channel takes
+# sg_samples (at most 300 / sg_chans) and is logged as sg, sg2,
+# sg3, sg4. Analog outputs and the sample buffer only (no
+# sg_stream, sg_pw_pin, sg_serial), sg_osr and sg_iqr_stop are
+# not used
+sg_chans=1
+# Distance sensor model on channels 2-4, 0 = same as channel 1
+# (default)
+sg2_model=0
+sg3_model=0
+sg4_model=0
+# DS18B20 resolution in bits (9-12), conversion takes 94, 188,
+# 375 or 750 ms
+ds_res=12
+# BMP280/BME280 oversampling (1,2,4,8,16), sensors sleep
+# between forced conversions
+bmx_osr=1
+# Bosch IIR filter coefficient (0 = off,2,4,8,16), filters
+# across observations in forced mode, across the conversions of
+# bmx_odr in normal mode
+bmx_filter=0
+# BMP388/BMP390 pressure series in the sensor FIFO between
+# observations, 0 = off (default), 1 = log bp1avg bp1min bp1max
+bmx_fifo=0
+# Bosch normal mode, seconds between conversions the sensor
+# makes on its own while the M0 sleeps, 0 = one forced
+# conversion per observation (default). OBS_Do() reads the last
+# one, through bmx_filter a mean of about the last bmx_filter x
+# bmx_odr seconds. BMP280 conversions are at most 4s apart,
+# BME280 1s, BMP388/BMP390 up to 655s.
+bmx_odr=0
+# MCP9808 resolution 0 = 0.5C 30ms, 1 = 0.25C 65ms, 2 = 0.125C
+# 130ms, 3 = 0.0625C 250ms (default)
+mcp_res=3
+# Gauge samples taken per observation, median is reported
+# (1-300, no limit when streaming)
+sg_samples=60
+# Stop gauge sampling once the IQR of the samples so far is at
+# most this many mm, sg_samples is then the most taken. 0 =
+# always take sg_samples (default). Logs the count used as sgn
+sg_iqr_stop=0
+# Fewest gauge samples before sg_iqr_stop is tested (1-300)
+sg_min_samples=20
+# Milliseconds between gauge samples (10-1000)
+sg_interval=250
+# Gauge streaming estimator, 0 = buffer samples (default), 1 =
+# no buffer, also logs sgmin, sgmax, sgiqr
+sg_stream=0
+# Pin wired to the gauge PW output, 0 = sample the analog
+# output (default). PW is 1us per mm, one sample per sensor
+# reading (about 6Hz) so sg_interval and sg_osr are not used
+sg_pw_pin=0
+# Gauge TTL serial output on Serial1 RX (D0), 0 = off
+# (default), 1 = take the sensor's mm readings from it instead
+# of the analog output or sg_pw_pin, one sample per reading so
+# sg_interval and sg_osr are not used
+sg_serial=0
+# Pin wired to the gauge RX (pin 4), 0 = the sensor free runs
+# (default). Held low so the sensor waits, pulsed for each
+# sample of the analog output or sg_pw_pin, at most one every
+# sg_interval ms. Each sample is a new range, so far fewer
+# sg_samples (10) are needed
+sg_trig_pin=0
+# Gauge ADC oversampling, 0 = 10bit (default), 1,2,4,8,16 =
+# 12bit averaging that many conversions per sample
+sg_osr=0
+# Pin driving a load switch on the gauge power, 0 = always
+# powered (default)
+sg_pwr_pin=0
+# Milliseconds after power on before the gauge output is valid
+# (0-5000)
+sg_settle=500
+# Gauge supply current in mA * 10, only used to report the
+# saving
+sg_ma=30
+# Gauge level change in mm that wakes the board between
+# observations, 0 = off (default). Keeps the gauge powered
+sg_event=0
+# Milliseconds between gauge conversions watched while asleep
+# (100-60000)
+sg_event_ms=1000
+# Minutes between observations after a level event, must divide
+# 1440
+sg_burst=1
+# Burst observations in a row changing less than sg_event
+# before going back to obs_interval
+sg_burst_n=5
+# Observations held in RAM before they are written to the SD
+# card (1-10), 1 = write every observation
+sd_batch=1
+# Daily log pre-allocated as one contiguous extent, 0 = normal
+# appends (default), 1 = contiguous
+sd_contig=0
+# Binary observation log /OBS/YYYYMMDD.bin, 0 = off (default),
+# 1 = .bin and .log, 2 = .bin only
+sd_bin=0
+# Delta log /OBS/YYYYMMDD.dlt, hourly keyframes and zig-zag
+# varint deltas of the binary record, 0 = off (default)
+sd_delta=0
+# 1 = Observations on a fast schedule (sg_burst, obs_fast) held
+# in RAM as binary records and written to /OBS/YYYYMMDD.bst in
+# one multiple block write when 36 are held or the fast
+# schedule ends, 0 = off (default)
+sd_burst=0
+# Time index /OBS/YYYYMMDD.idx of the daily log, minute of day
+# to byte offset, 0 = off (default), 1 = on
+sd_idx=0
+# Daily files in monthly directories /OBS/YYYYMM/DD.log, 0 =
+# /OBS/YYYYMMDD.log (default), 1 = monthly
+sd_month=0
+# Log flushes between syncs of the daily log held open,
+# unsynced flushes are lost with power, 1 = every flush
+sd_sync=1
+# 1 = Each observation held for sd_batch first goes to the
+# write ahead journal /OBS/JOURNAL.bin as one block write,
+# replayed into the daily log at boot after a reset, 0 = off
+# (default)
+sd_journal=0
+# 1 = Logged observations also queued in /OBS/N2S.TXT to be
+# sent on, 2 = their binary records queued instead, for the
+# telemetry module (tl), 0 = off (default)
+n2s=0
+# 1 = Return from the last SD write of a flush while the card
+# is still programming it, checked before sleep
+sd_defer=0
+# 1 = Binary records go to a ring in internal flash while the
+# SD card is missing or failing, drained to /OBS/FLASH.bin
+sd_flash=1
+# CPU clock divider while waiting on the gauge and sensor
+# conversions, 1 = 48 MHz always (default), 2 = 24 MHz, 4 = 12
+# MHz. Peripheral clocks and baud rates are not changed
+cpu_div=1
+# 1 = Unused header pins pulled up, SPI bus and ADC released
+# while asleep (default), 0 = pins left as they are
+pwr_park=1
+# 1 = OLED pages and sensor transfers moved by DMA through a
+# queue, the OLED is refreshed in the background, 0 = Wire only
+# (default)
+i2c_dma=0
+# 1 = Watchdog resets the board when a wait hangs for 8s
+# (default), 0 = off
+wdt=1
+# Gauge trace /OBS/SGTRACE.bin, 0 = off (default), 1 = append
+# each observation's raw samples, 2 = replay them in place of
+# the gauge, for checking a bench unit's logs against a field
+# station's
+sg_trace=0
+# Minutes between observations whose raw gauge samples and
+# their timing go to /OBS/RAW/YYYYMMDD.bin, at most 288 a day,
+# 0 = off (default)
+sg_raw=0
+# INA219 or INA260 current monitor on the I2C bus, 0 = none
+# (default), 219, 260. Logs "en" mJ per phase of the last cycle
+# and the sleep, and "sua" sleep current in uA
+en_ina=0
+# Its I2C address in decimal, 64 = 0x40 (default)
+en_addr=64
+# INA219 shunt resistor in mOhm
+en_shunt=100
+# 1 = Radio modem on Serial1 sends the n2s=2 queue, packed
+# several observations to a frame, 0 = off (default). Not with
+# sg_serial
+tl=0
+# Pin powering the modem only while it sends, 0 = always
+# powered
+tl_pin=0
+tl_baud=9600
+# Observations between sends
+tl_every=4
+# Frame bytes at most, 128-255
+tl_frame=255
+# ms from power on to the first frame
+tl_warm=100
+# Service console on Serial1 (D0 RX, D1 TX) at this baud,
+# 1200-115200, 0 = off (default). A byte on RX wakes the board
+# from its sleep between observations into the shell. Not with
+# sg_serial or tl
+sh_uart=0
+# Observations between writes of the health counters to
+# /OBS/STATS.bin, 0 = off
+stats=4
+# Snapshot the runtime state (QC, deadband, summaries, power,
+# burst) to /OBS/WARM.bin each observation and take it back
+# after a reset, 0 = off (default)
+warm=0
+# ms each wake spent converting closed daily logs, oldest
+# first, into /OBS/YYYYMMDD.dla archives (the delta log of the
+# binary record with a CRC32 footer), resumed the next wake
+# from /OBS/ARCHIVE.cur, 0 = off (default)
+ar_ms=0
+# 1 = Daily log kept once archived (default), 0 = the .log and
+# its .idx removed. Only the binary record's fields are
+# archived
+ar_keep=1
+# ms each wake may spend after the observation on telemetry,
+# the stats write and the archiver, in that order. A task whose
+# last run does not fit in what is left waits for the next
+# wake, 0 = no budget, each runs (default)
+bg_ms=0
+# Gauge spike QC against the last 7 accepted values, 0 = off
+# (default), 1 = flag "sgqc", 2 = flag and log their median in
+# place of a spike, the reading as "sgraw"
+sg_qc=0
+# Least jump in mm that is a spike, and the fastest real change
+# in mm per hour, 0 = no rate test
+sg_qc_mm=50
+sg_qc_roc=200
+# Distance in mm from the gauge to bare ground or the stage
+# datum, logs "sgd" depth or stage, 0 = off (default)
+sg_datum=0
+# 1 = Distance scaled for the speed of sound at the air
+# temperature (BMX1, MCP1 or DS1) before "sgd", 0 = off
+# (default), for sensors without their own compensation
+sg_tc=0
+# Calibration of the gauge on channel 1, up to 8 points
+# sg_cal1-sg_cal8 of COUNTS,MM: 12 bit ADC counts (0-4095) and
+# the distance in mm measured at them, counts rising from point
+# to point. Counts between points are interpolated, outside
+# them the end segments carried on. Read at boot, a change
+# takes effect at the next reset. No points (default) = the
+# sensor's nominal full scale. e.g. sg_cal1=82,402
+# sg_cal2=2048,5050 sg_cal3=4010,9935
+# Station elevation in meters for the sea level pressures
+# "slp1" "slp2", 0 = off (default)
+bmx_elev=0
+# With both Bosch sensors, read BMX2 only every bmx_fuse
+# observations or when BMX1 fails QC, and log the fused "bpf"
+# "btf" with BMX2's bias taken out, 0 = read both every
+# observation (default)
+bmx_fuse=0
+# Minutes between reads of the Bosch sensors, the MCP9808s, the
+# DS probes and the battery, 0 = every observation (default).
+# Read at the first observation at or after each multiple of
+# the clock, so obs_interval is the gauge's cadence and a
+# multiple of it here is exact. A record without a sensor
+# leaves its keys out, without the battery "bv" is left out and
+# the power profile goes on the last reading
+bmx_every=0
+mcp_every=0
+ds_every=0
+bv_every=0
+# Calibration mode station monitor, seconds between reads of
+# the Bosch sensors, the DS probes and the gauge pin and
+# battery
+sm_bmx=10
+sm_ds=10
+sm_adc=1
+# Pin of a push button to ground, a press while asleep shows
+# the last observation and health on the OLED for a few
+# seconds, 0 = off (default)
+sm_btn_pin=0
+# DS18B20 alarm search, only probes that moved this many whole
+# degrees C or more are read, the others keep their reading,
+# "dtc" in the record counts them. 0 = every probe read
+# (default)
+ds_alarm=0
+# Observations a reading is carried before every probe is read
+# again
+ds_stale=12
  * ======================================================================================================================
  */
 
@@ -15,4 +340,155 @@ ds_type=0
  *  Define Global Configuration File Variables
  * ======================================================================================================================
  */
+#define SG_CAL_MAX        8                 // sg_cal1-sg_cal8
+#define SS_MAX            6                 // ss1-ss6
+#define SS_FIELDS         5                 // MMDD,INTERVAL,SAMPLES,DS_RES,DISPLAY
+
+ int cf_obs_interval=15;  // Minutes between observations
+ int cf_rtc_int_pin=0;    // Pin wired to DS3231 INT, 0 = not wired
+ int cf_rtc_32k_pin=0;    // Pin wired to DS3231 32K, 0 = not wired
+ int cf_obs_tm=0;         // 1 = add "tm" phase times, "sgw" window, "slp" sleep and "sdio" blocks
+ int cf_obs_db_sg=0;      // Gauge mm change that logs an observation, 0 and obs_db_t 0 = log all
+ int cf_obs_db_t=0;       // Temperature deg C * 10 change that logs an observation
+ int cf_obs_hb=60;        // Minutes between logged observations without a change, 0 = none
+ int cf_obs_sum=0;        // 1 = hourly and daily summary records
+ int cf_obs_fast=0;       // Fastest adaptive cadence minutes, 0 = off
+ int cf_obs_fast_mm=10;   // Gauge mm an hour that steps to obs_fast
+ int cf_obs_fast_t=20;    // Temperature deg C * 10 an hour that steps to obs_fast
+ int cf_obs_slow=0;       // Slowest adaptive cadence minutes, 0 = obs_interval
+ int cf_ss[SS_MAX][SS_FIELDS];  // Seasonal schedule ss1-ss6 MMDD,INTERVAL,SAMPLES,DS_RES,DISPLAY
+ int cf_ss_n=0;           // Entries read, 0 = no schedule
+ int cf_pwr_save=360;     // Battery V*100 for the SAVE profile, 0 = off
+ int cf_pwr_crit=340;     // Battery V*100 for the CRITICAL profile, 0 = off
+ int cf_pwr_until=0;      // Next site visit YYYYMMDD, 0 = off
+ int cf_pwr_empty=330;    // Battery V*100 taken as empty
+ int cf_pwr_bod=0;        // 3.3V rail V*100 of the brownout early warning, 0 = off
  int cf_ds_type=0; //Default is 5m
+ int cf_sg_model=0;       // MaxBotix MB number, 0 = from cf_ds_type
+ int cf_sg_chans=1;       // Gauge channels scanned
+ int cf_sg2_model=0;      // Channel 2-4 MB numbers, 0 = as channel 1
+ int cf_sg3_model=0;
+ int cf_sg4_model=0;
+ int cf_ds_res=12;        // DS18B20 resolution bits
+ int cf_bmx_osr=1;        // BMP280/BME280 oversampling
+ int cf_bmx_filter=0;     // Bosch IIR filter coefficient
+ int cf_bmx_fifo=0;       // 1 = BMP388/BMP390 FIFO pressure series
+ int cf_bmx_odr=0;        // Bosch normal mode s between conversions, 0 = forced
+ int cf_mcp_res=3;        // MCP9808 resolution 0-3
+ int cf_sg_samples=60;    // Gauge samples per observation
+ int cf_sg_interval=250;  // ms between gauge samples
+ int cf_sg_iqr_stop=0;    // mm IQR that ends sampling early, 0 = fixed count
+ int cf_sg_min_samples=20; // Samples before the early stop is tested
+ int cf_sg_stream=0;      // 1 = P2 streaming estimator instead of buffered samples
+ int cf_sg_pw_pin=0;      // Gauge PW capture pin, 0 = analog
+ int cf_sg_serial=0;      // 1 = gauge serial frames on Serial1
+ int cf_sg_trig_pin=0;    // Gauge RX trigger pin, 0 = free running
+ int cf_sg_osr=0;         // 0 = 10bit gauge ADC, else 12bit averaging cf_sg_osr conversions
+ int cf_sg_pwr_pin=0;     // Gauge load switch pin, 0 = not gated
+ int cf_sg_settle=500;    // ms from gauge power on to valid output
+ int cf_sg_ma=30;         // Gauge current mA*10
+ int cf_sg_event=0;       // mm change that wakes from sleep, 0 = off
+ int cf_sg_event_ms=1000; // ms between conversions watched while asleep
+ int cf_sg_burst=1;       // Minutes between observations after an event
+ int cf_sg_burst_n=5;     // Quiet burst observations before the normal schedule
+ int cf_sd_batch=1;       // Observations per SD write
+ int cf_sd_contig=0;      // 1 = pre-allocate daily log as a contiguous extent
+ int cf_sd_bin=0;         // 1 = also log binary records, 2 = binary records only
+ int cf_sd_delta=0;       // 1 = delta compressed .dlt log
+ int cf_sd_burst=0;       // 1 = fast schedule observations held in RAM for .bst
+ int cf_sd_idx=0;         // 1 = .idx sidecar of the daily log
+ int cf_sd_month=0;       // 1 = /OBS/YYYYMM/DD.log layout
+ int cf_sd_sync=1;        // Flushes between syncs of the open daily log
+ int cf_sd_journal=0;     // 1 = Write ahead journal of held observations
+ int cf_n2s=0;            // 1 = Need to send queue of JSON lines, 2 = of binary records
+ int cf_sd_defer=0;       // 1 = Card programming of a flush overlaps the rest of the loop
+ int cf_sd_flash=1;       // 1 = Internal flash fallback ring for binary records
+ int cf_cpu_div=1;        // CPU clock divider in conversion waits, 1 = none
+ int cf_pwr_park=1;       // 1 = Park unused pins and release the SPI bus for sleep
+ int cf_i2c_dma=0;        // 1 = I2C transaction queue by DMA
+ int cf_wdt=1;            // 1 = Hardware watchdog
+ int cf_sg_trace=0;       // 1 = record gauge samples, 2 = replay them
+ int cf_sg_raw=0;         // Minutes between raw gauge captures, 0 = off
+ int cf_en_ina=0;         // Current monitor 219 or 260, 0 = none
+ int cf_en_addr=64;       // Its I2C address
+ int cf_en_shunt=100;     // INA219 shunt mOhm
+ int cf_tl=0;             // 1 = Telemetry of the need to send queue on Serial1
+ int cf_tl_pin=0;         // Modem power pin, 0 = none
+ int cf_tl_baud=9600;     // Modem UART baud
+ int cf_tl_every=4;       // Observations between sends
+ int cf_tl_frame=255;     // Frame bytes at most
+ int cf_tl_warm=100;      // Modem power on to first frame ms
+ int cf_sh_uart=0;        // Service console baud on Serial1, 0 = off
+ int cf_stats=4;          // Observations between STATS.bin writes
+ int cf_warm=0;           // 1 = warm start snapshot
+ int cf_ar_ms=0;          // ms a wake spends archiving closed days, 0 = off
+ int cf_ar_keep=1;        // 1 = keep a daily log once archived
+ int cf_bg_ms=0;          // ms of background work a wake, 0 = no budget
+ int cf_sg_qc=0;          // Gauge spike QC, 1 = flag, 2 = flag and replace
+ int cf_sg_qc_mm=50;      // Least spike mm
+ int cf_sg_qc_roc=200;    // Fastest real change mm per hour
+ int cf_sg_datum=0;       // Gauge to ground or datum mm, 0 = no depth
+ int cf_sg_tc=0;          // 1 = Speed of sound compensation of the depth
+ int cf_sg_cal[SG_CAL_MAX][2];  // Calibration points sg_cal1-sg_cal8 COUNTS,MM
+ int cf_sg_cal_n=0;       // Points read, 0 = nominal full scale
+ int cf_bmx_elev=0;       // Station elevation m, 0 = no sea level pressure
+ int cf_bmx_fuse=0;       // Observations between reads of BMX2, 0 = every one
+ int cf_bmx_every=0;      // Minutes between Bosch reads, 0 = every observation
+ int cf_mcp_every=0;      // Minutes between MCP9808 reads
+ int cf_ds_every=0;       // Minutes between DS probe reads
+ int cf_bv_every=0;       // Minutes between battery reads
+ int cf_sm_bmx=10;        // Monitor seconds between Bosch reads
+ int cf_sm_ds=10;         // Monitor seconds between DS reads
+ int cf_sm_adc=1;         // Monitor seconds between gauge pin and battery reads
+ int cf_sm_btn_pin=0;     // Status button pin, 0 = none
+ int cf_ds_alarm=0;       // DS alarm band whole degrees C, 0 = read every probe
+ int cf_ds_stale=12;      // Observations a DS reading is carried at most
+
+/*
+ * ======================================================================================================================
+ *  Config Keys - The integer keys read by SD_ReadConfigFile(), in the order above, for the shell's cfg command,
+ *    the config snapshot and the reload at wake
+ * ======================================================================================================================
+ */
+typedef struct {
+  const char *key;                          // CONFIG.TXT key
+  int *value;
+  bool reset;                               // Set up once at boot, a reload leaves it for the next reset
+} CF_KEY;
+
+const CF_KEY cf_keys[] = {
+  {"obs_interval", &cf_obs_interval}, {"rtc_int_pin", &cf_rtc_int_pin, true}, {"obs_tm", &cf_obs_tm},
+  {"rtc_32k_pin", &cf_rtc_32k_pin, true}, {"obs_db_sg", &cf_obs_db_sg}, {"obs_db_t", &cf_obs_db_t},
+  {"obs_hb", &cf_obs_hb}, {"obs_sum", &cf_obs_sum},
+  {"obs_fast", &cf_obs_fast, true}, {"obs_fast_mm", &cf_obs_fast_mm}, {"obs_fast_t", &cf_obs_fast_t},
+  {"obs_slow", &cf_obs_slow, true},
+  {"pwr_save", &cf_pwr_save}, {"pwr_crit", &cf_pwr_crit}, {"ds_type", &cf_ds_type}, {"sg_model", &cf_sg_model},
+  {"sg_chans", &cf_sg_chans, true}, {"sg2_model", &cf_sg2_model}, {"sg3_model", &cf_sg3_model},
+  {"sg4_model", &cf_sg4_model}, {"ds_res", &cf_ds_res}, {"bmx_osr", &cf_bmx_osr}, {"bmx_filter", &cf_bmx_filter},
+  {"bmx_fifo", &cf_bmx_fifo, true}, {"bmx_odr", &cf_bmx_odr}, {"mcp_res", &cf_mcp_res},
+  {"sg_samples", &cf_sg_samples},
+  {"sg_interval", &cf_sg_interval}, {"sg_iqr_stop", &cf_sg_iqr_stop}, {"sg_min_samples", &cf_sg_min_samples},
+  {"sg_stream", &cf_sg_stream, true}, {"sg_pw_pin", &cf_sg_pw_pin, true}, {"sg_serial", &cf_sg_serial, true},
+  {"sg_trig_pin", &cf_sg_trig_pin, true},
+  {"sg_osr", &cf_sg_osr}, {"sg_pwr_pin", &cf_sg_pwr_pin, true}, {"sg_settle", &cf_sg_settle}, {"sg_ma", &cf_sg_ma},
+  {"sg_event", &cf_sg_event}, {"sg_event_ms", &cf_sg_event_ms}, {"sg_burst", &cf_sg_burst},
+  {"sg_burst_n", &cf_sg_burst_n}, {"sd_batch", &cf_sd_batch, true}, {"sd_contig", &cf_sd_contig, true},
+  {"sd_bin", &cf_sd_bin, true}, {"sd_delta", &cf_sd_delta, true},
+  {"sd_burst", &cf_sd_burst}, {"sd_idx", &cf_sd_idx, true},
+  {"sd_month", &cf_sd_month, true}, {"sd_sync", &cf_sd_sync}, {"sd_journal", &cf_sd_journal, true},
+  {"n2s", &cf_n2s, true}, {"sd_defer", &cf_sd_defer, true}, {"sd_flash", &cf_sd_flash, true},
+  {"cpu_div", &cf_cpu_div, true}, {"pwr_park", &cf_pwr_park, true}, {"i2c_dma", &cf_i2c_dma, true},
+  {"wdt", &cf_wdt, true}, {"sg_trace", &cf_sg_trace, true}, {"sg_raw", &cf_sg_raw}, {"en_ina", &cf_en_ina, true},
+  {"en_addr", &cf_en_addr, true}, {"en_shunt", &cf_en_shunt}, {"tl", &cf_tl, true}, {"tl_pin", &cf_tl_pin, true},
+  {"tl_baud", &cf_tl_baud}, {"tl_every", &cf_tl_every}, {"tl_frame", &cf_tl_frame}, {"tl_warm", &cf_tl_warm},
+  {"sh_uart", &cf_sh_uart, true},
+  {"stats", &cf_stats}, {"warm", &cf_warm}, {"ar_ms", &cf_ar_ms}, {"ar_keep", &cf_ar_keep},
+  {"bg_ms", &cf_bg_ms},
+  {"sg_qc", &cf_sg_qc}, {"sg_qc_mm", &cf_sg_qc_mm}, {"sg_qc_roc", &cf_sg_qc_roc},
+  {"sg_datum", &cf_sg_datum}, {"sg_tc", &cf_sg_tc}, {"bmx_elev", &cf_bmx_elev}, {"bmx_fuse", &cf_bmx_fuse},
+  {"bmx_every", &cf_bmx_every}, {"mcp_every", &cf_mcp_every}, {"ds_every", &cf_ds_every}, {"bv_every", &cf_bv_every},
+  {"sm_bmx", &cf_sm_bmx}, {"sm_ds", &cf_sm_ds}, {"sm_adc", &cf_sm_adc}, {"sm_btn_pin", &cf_sm_btn_pin, true},
+  {"ds_alarm", &cf_ds_alarm}, {"ds_stale", &cf_ds_stale},
+  {"pwr_until", &cf_pwr_until}, {"pwr_empty", &cf_pwr_empty}, {"pwr_bod", &cf_pwr_bod, true},
+};
+#define CF_KEY_COUNT      (sizeof(cf_keys) / sizeof(cf_keys[0]))
@@ -0,0 +1,59 @@
+/*
+ * ======================================================================================================================
+ *  CK.h - CPU Clock Scaling
+ *
+ *  Most of the awake window is spent waiting on the gauge window and sensor conversions. ck_slow() divides the
+ *  CPU and APB bus clocks by cpu_div around those waits, ck_fast() puts 48 MHz back for the rest. Only the PM
+ *  dividers change, GCLK0 stays at 48 MHz, so SERCOM baud rates, the ADC prescaler and the TC sample timers need
+ *  nothing recomputed. SysTick counts the CPU clock, its reload is scaled so millis() keeps time, the part of a ms
+ *  micros() adds is a fraction too small while slow. USB needs an AHB clock of at least 8 MHz, so 4 (12 MHz) is the
+ *  most. delayMicroseconds() is cycle counted for 48 MHz, so the DS18B20 One Wire bus is only run fast.
+ * ======================================================================================================================
+ */
+uint8_t ck_shift = 0;                       // log2 of the divider in use
+
+/*
+ *=======================================================================================================================
+ * ck_set() - CPU and APB clocks to 48 MHz >> shift
+ *=======================================================================================================================
+ */
+void ck_set(uint8_t shift) {
+  if (shift == ck_shift) {
+    return;
+  }
+
+  // APB clocks may not be faster than the CPU, slow them first and speed them last
+  if (shift > ck_shift) {
+    PM->APBASEL.reg = PM_APBASEL_APBADIV(shift);
+    PM->APBBSEL.reg = PM_APBBSEL_APBBDIV(shift);
+    PM->APBCSEL.reg = PM_APBCSEL_APBCDIV(shift);
+    PM->CPUSEL.reg = PM_CPUSEL_CPUDIV(shift);
+  }
+  else {
+    PM->CPUSEL.reg = PM_CPUSEL_CPUDIV(shift);
+    PM->APBASEL.reg = PM_APBASEL_APBADIV(shift);
+    PM->APBBSEL.reg = PM_APBBSEL_APBBDIV(shift);
+    PM->APBCSEL.reg = PM_APBCSEL_APBCDIV(shift);
+  }
+  SysTick->LOAD = ((VARIANT_MCK >> shift) / 1000) - 1;  // Still 1 ms
+  SysTick->VAL = 0;
+  ck_shift = shift;
+}
+
+/*
+ *=======================================================================================================================
+ * ck_slow() - Divide by cpu_div for a wait
+ *=======================================================================================================================
+ */
+void ck_slow() {
+  ck_set((cf_cpu_div >= 4) ? 2 : ((cf_cpu_div >= 2) ? 1 : 0));
+}
+
+/*
+ *=======================================================================================================================
+ * ck_fast() - Back to 48 MHz
+ *=======================================================================================================================
+ */
+void ck_fast() {
+  ck_set(0);
+}
@@ -0,0 +1,214 @@
+/*
+ * ======================================================================================================================
+ *  DMA.h - SAMD21 Direct Memory Access Controller (DMAC)
+ *
+ *  The DMAC needs a descriptor table and a write back table in SRAM, both 128-bit aligned. One descriptor per channel.
+ *  Transfers are one block of beats, each beat moved on the channel's peripheral trigger. When the block completes
+ *  the channel sets dma_done[ch] from DMAC_Handler() so the caller can sleep in LowPower.idle() until then.
+ *  A ring is two blocks linked to each other, the channel runs until stopped and counts each block in dma_blocks[ch].
+ *  A channel with a dma_isr[ch] handler has it called from DMAC_Handler() after dma_done[ch] is set, it may start the
+ *  channel's next transfer. CHID is put back on the way out, so a dma_start() the interrupt lands in is not upset.
+ * ======================================================================================================================
+ */
+#define DMA_CHANNELS        6     // Size of the descriptor table
+#define DMA_CH_SG           0     // Channel used by the Stream/Snow Gauge for ADC results
+#define DMA_CH_SD_RX        1     // SD card SPI receive, below TX so it wins arbitration and never overruns
+#define DMA_CH_SD_TX        2     // SD card SPI transmit
+#define DMA_CH_I2C          3     // I2C transaction queue, IQ.h
+#define DMA_CH_OW_RX        4     // One Wire UART echo, below TX like the SD card, OW.h
+#define DMA_CH_OW_TX        5     // One Wire UART slots
+
+DmacDescriptor dma_descriptor[DMA_CHANNELS] __attribute__ ((aligned (16)));
+volatile DmacDescriptor dma_writeback[DMA_CHANNELS] __attribute__ ((aligned (16)));
+DmacDescriptor dma_ring_descriptor __attribute__ ((aligned (16)));  // Second block of the one ring allowed
+volatile bool dma_done[DMA_CHANNELS];
+volatile uint16_t dma_blocks[DMA_CHANNELS];
+void (*dma_isr[DMA_CHANNELS])();  // Called on completion, NULL = none
+bool dma_initialized = false;
+
+/*
+ * ======================================================================================================================
+ * DMAC_Handler() - Transfer complete or error on a channel
+ * ======================================================================================================================
+ */
+void DMAC_Handler() {
+  uint8_t chid = DMAC->CHID.reg;  // Channel the interrupted code had selected
+  uint8_t ch;
+
+  // Lowest channel with a pending interrupt
+  while (DMAC->INTPEND.bit.TCMPL || DMAC->INTPEND.bit.TERR) {
+    ch = DMAC->INTPEND.bit.ID;
+    DMAC->CHID.reg = DMAC_CHID_ID(ch);
+    DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR;  // Clear flags
+    if (ch < DMA_CHANNELS) {
+      dma_done[ch] = true;
+      dma_blocks[ch]++;
+      if (dma_isr[ch]) {
+        dma_isr[ch]();
+      }
+    }
+  }
+  DMAC->CHID.reg = chid;
+}
+
+/*
+ * ======================================================================================================================
+ * dma_initialize() - Clock and enable the DMAC, only done once
+ * ======================================================================================================================
+ */
+void dma_initialize() {
+  if (dma_initialized) {
+    return;
+  }
+
+  PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+  PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+
+  DMAC->CTRL.bit.DMAENABLE = 0;
+  DMAC->CTRL.bit.SWRST = 1;
+  while (DMAC->CTRL.bit.SWRST);
+
+  memset((void *)dma_descriptor, 0, sizeof(dma_descriptor));
+  memset((void *)dma_writeback, 0, sizeof(dma_writeback));
+
+  DMAC->BASEADDR.reg = (uint32_t) dma_descriptor;
+  DMAC->WRBADDR.reg = (uint32_t) dma_writeback;
+  DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xf);
+
+  NVIC_EnableIRQ(DMAC_IRQn);
+  dma_initialized = true;
+}
+
+/*
+ * ======================================================================================================================
+ * dma_start() - Start a single block transfer on a channel
+ *
+ *  trigsrc   - Peripheral DMAC ID that moves each beat (ADC_DMAC_ID_RESRDY, SERCOMx_DMAC_ID_RX, ...)
+ *  beatsize  - DMAC_BTCTRL_BEATSIZE_BYTE, _HWORD or _WORD
+ *  src, dst  - Start addresses. An incrementing address is converted to the end address the DMAC expects.
+ * ======================================================================================================================
+ */
+void dma_start(uint8_t ch, uint8_t trigsrc, uint16_t beatsize,
+               volatile void *src, bool srcinc, volatile void *dst, bool dstinc, uint16_t count) {
+  uint32_t bytes = count * (1 << (beatsize >> DMAC_BTCTRL_BEATSIZE_Pos));
+  DmacDescriptor *d = &dma_descriptor[ch];
+
+  dma_initialize();
+
+  DMAC->CHID.reg = DMAC_CHID_ID(ch);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+  while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST);
+  DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(trigsrc) | DMAC_CHCTRLB_TRIGACT_BEAT;
+  DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
+
+  d->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BLOCKACT_NOACT | beatsize |
+                  (srcinc ? DMAC_BTCTRL_SRCINC : 0) | (dstinc ? DMAC_BTCTRL_DSTINC : 0);
+  d->BTCNT.reg = count;
+  d->SRCADDR.reg = (uint32_t) src + (srcinc ? bytes : 0);
+  d->DSTADDR.reg = (uint32_t) dst + (dstinc ? bytes : 0);
+  d->DESCADDR.reg = 0;   // Single block, no linked descriptor
+
+  dma_done[ch] = false;
+  DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+}
+
+/*
+ * ======================================================================================================================
+ * dma_stop() - Abort channel, return the number of beats NOT transfered
+ * ======================================================================================================================
+ */
+uint16_t dma_stop(uint8_t ch) {
+  DMAC->CHID.reg = DMAC_CHID_ID(ch);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE);
+  return ((dma_done[ch]) ? 0 : dma_writeback[ch].BTCNT.reg);
+}
+
+/*
+ * ======================================================================================================================
+ * dma_ring_start() - Byte transfers into dst[0..2*block-1] for ever, two linked blocks of block bytes
+ *
+ *  Block dma_blocks[ch] % 2 is the one being filled, the other is complete once dma_blocks[ch] > 0.
+ * ======================================================================================================================
+ */
+void dma_ring_start(uint8_t ch, uint8_t trigsrc, volatile void *src, volatile uint8_t *dst, uint16_t block) {
+  DmacDescriptor *d = &dma_descriptor[ch];
+
+  dma_initialize();
+
+  DMAC->CHID.reg = DMAC_CHID_ID(ch);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+  while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST);
+  DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) | DMAC_CHCTRLB_TRIGSRC(trigsrc) | DMAC_CHCTRLB_TRIGACT_BEAT;
+  DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
+
+  // Interrupt at the end of each block and carry on into the other
+  d->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BLOCKACT_INT | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_DSTINC;
+  d->BTCNT.reg = block;
+  d->SRCADDR.reg = (uint32_t) src;
+  d->DSTADDR.reg = (uint32_t) dst + block;
+  d->DESCADDR.reg = (uint32_t) &dma_ring_descriptor;
+
+  dma_ring_descriptor.BTCTRL.reg = d->BTCTRL.reg;
+  dma_ring_descriptor.BTCNT.reg = block;
+  dma_ring_descriptor.SRCADDR.reg = (uint32_t) src;
+  dma_ring_descriptor.DSTADDR.reg = (uint32_t) dst + (2 * block);
+  dma_ring_descriptor.DESCADDR.reg = (uint32_t) d;
+
+  dma_done[ch] = false;
+  dma_blocks[ch] = 0;
+  DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+}
+
+/*
+ * ======================================================================================================================
+ * dma_ring_stop() - Stop a ring, return the bytes moved into the block being filled
+ * ======================================================================================================================
+ */
+uint16_t dma_ring_stop(uint8_t ch, uint16_t block) {
+  DMAC->CHID.reg = DMAC_CHID_ID(ch);
+  DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+  while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE);
+  return (block - dma_writeback[ch].BTCNT.reg);
+}
+
+/*
+ * ======================================================================================================================
+ *  SD Card SPI - Sd2Card calls sd_spi_block() for the data of each block it reads or writes. TX clocks the bytes out
+ *  on Data Register Empty, RX takes each received byte off the port so it never overruns, also when the bytes are
+ *  thrown away on a write. Short reads (directory entries) are left to SPI.transfer(), setting up two channels costs
+ *  more than it saves.
+ * ======================================================================================================================
+ */
+#define DMA_SD_SERCOM       SERCOM4             // SPI port of the Feather M0, where the SD card is
+#define DMA_SD_DMAC_ID_TX   SERCOM4_DMAC_ID_TX
+#define DMA_SD_DMAC_ID_RX   SERCOM4_DMAC_ID_RX
+#define DMA_SD_MIN          64                  // Bytes, shorter transfers are done by byte
+
+/*
+ * ======================================================================================================================
+ * sd_spi_block() - Move count bytes over the SD SPI port, src NULL sends 0xFF, dst NULL discards
+ * ======================================================================================================================
+ */
+extern "C" uint8_t sd_spi_block(const uint8_t *src, uint8_t *dst, uint16_t count) {
+  static const uint8_t ones = 0xFF;
+  static uint8_t sink;
+
+  if (count < DMA_SD_MIN) {
+    return (false);
+  }
+
+  // RX first so it is waiting for the first byte TX clocks
+  dma_start(DMA_CH_SD_RX, DMA_SD_DMAC_ID_RX, DMAC_BTCTRL_BEATSIZE_BYTE,
+    &DMA_SD_SERCOM->SPI.DATA.reg, false, (dst) ? dst : &sink, (dst != NULL), count);
+  dma_start(DMA_CH_SD_TX, DMA_SD_DMAC_ID_TX, DMAC_BTCTRL_BEATSIZE_BYTE,
+    (src) ? (void *) src : (void *) &ones, (src != NULL), &DMA_SD_SERCOM->SPI.DATA.reg, false, count);
+
+  // Last byte received is the end of the transfer, 512 bytes are well under a ms
+  while (!dma_done[DMA_CH_SD_RX]) {
+    LowPower.idle();
+  }
+  return (true);
+}
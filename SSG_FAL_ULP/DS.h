@@ -1,7 +1,12 @@
 /*
  * ======================================================================================================================
  *  DS.h - Dallas Sensor - One Wire
- * ====================================================================================================================== 
+ *
+ *  Any number of DS18B20 probes, up to DS_MAX_PROBES, can share DS0_PIN. All probes are told to convert at once with
+ *  a skip ROM broadcast, then each scratchpad is read in turn with select(), so a reading takes one conversion time
+ *  no matter how many probes are on the bus. Probes are numbered in search order and logged as dt1..dtN.
+ *  Scratchpads are read with read_bytes(), which the UART bus of OW.h moves in one DMA transfer.
+ * ======================================================================================================================
  */
 
  #include <OneWire.h>
@@ -12,172 +17,460 @@
  * =======================================================================================================================
  */
 #define DS0_PIN A2
+#define DS_MAX_PROBES   8     // Probes we have room for on the bus
 
 // Allociation for Dallas Sensors attached
+#if STN_DS_UART
+OneWireUart ds;               // SERCOM1 on D10 and D11, OW.h
+#define DS_PIN_USED(pin)  (((pin) == OW_TX_PIN) || ((pin) == OW_RX_PIN))
+#else
 OneWire  ds = OneWire(DS0_PIN);
+#define DS_PIN_USED(pin)  ((pin) == DS0_PIN)
+#endif
+
+// Dallas Sensor Addresses
+byte ds_addr[DS_MAX_PROBES][8];
+int  ds_count = 0;            // Probes found
+
+bool  ds_found = false;       // At least one probe
+int32_t ds_reading[DS_MAX_PROBES];   // deg C, FIX_ONE units
+bool  ds_valid[DS_MAX_PROBES];
+uint8_t ds_qc[DS_MAX_PROBES];        // QC_* code of the last read
 
-// Dallas Sensor Address
-byte ds_addr[8] = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
+#define DS_CONVERT_MS   750   // 12 bit conversion time, halves with each bit less
 
-bool  ds_found = false;
-float ds_reading = 0.0;
-bool  ds_valid = false;
+unsigned long ds_start_ms = 0;  // millis() when the running conversion was started
+unsigned int  ds_convert_ms = DS_CONVERT_MS;  // Conversion time at the configured resolution
+bool ds_retry = true;           // Convert again when a probe reads bad, off in the battery save profiles
+byte ds_cfg = 0x7F;             // Config byte of the resolution in use, ds_resolution()
 
 /*
  * =============================================================
- * getDSTempByAddr() - 
+ * ds_start() - Start a temperature conversion on every probe,
+ *   returns at once
  * =============================================================
  */
-bool getDSTempByAddr(int delayms) {
-  byte i;
-  byte present = 0;
-  byte type_s;
-  byte data[12];
-  
+void ds_start() {
   ds.reset();
-  ds.select(ds_addr);
+  ds.skip();              // Skip ROM, all probes
 
   // start conversion, with parasite power on at the end
   ds.write(0x44,0); // set to 1 for parasite otherwise 0
-  
-  delay(delayms);     // maybe 750ms is enough, maybe not
-  
+  ds_start_ms = millis();
+}
+
+/*
+ * =============================================================
+ * ds_read() - Read a probe's scratchpad of the last conversion
+ * =============================================================
+ */
+bool ds_read(int probe) {
+  byte present = 0;
+  byte data[12];
+
   present = ds.reset();
-  ds.select(ds_addr);    
+  ds.select(ds_addr[probe]);
   ds.write(0xBE);         // Read Scratchpad
-  for ( i = 0; i < 9; i++) { // we need 9 bytes
-    data[i] = ds.read();
-  }
-    
+  ds.read_bytes(data, 9);   // we need 9 bytes
+
   if (OneWire::crc8(data, 8) != data[8]) {
     // CRC on the Data Read
-    
+
     // Return false no temperture because of the CRC error
-    ds_reading=0.0;
-    ds_valid = false;
+    ds_reading[probe]=0;
+    ds_valid[probe] = false;
+    ds_qc[probe] = QC_NONE;
   }
   else {
-    // convert the data to actual temperature
-    unsigned int raw = (data[1] << 8) | data[0];
+    // convert the data to actual temperature, signed 1/16 C at every resolution
+    int16_t raw = (data[1] << 8) | data[0];
     byte cfg = (data[4] & 0x60);
-    if (cfg == 0x00) raw = raw << 3;  // 9bit res, 93.75 ms
-    else if (cfg == 0x20) raw = raw << 2; // 10bit res, 187.5 ms
-    else if (cfg == 0x40) raw = raw << 1; // 11bit res, 375 ms
+    // at lower resolution the low bits are undefined
+    if (cfg == 0x00) raw = raw & ~7;  // 9bit res, 93.75 ms
+    else if (cfg == 0x20) raw = raw & ~3; // 10bit res, 187.5 ms
+    else if (cfg == 0x40) raw = raw & ~1; // 11bit res, 375 ms
     // default is 12 bit resolution, 750 ms conversion time
 
-    float t = raw / 16.0;  // Max 85.0C, for fahrenheit = (raw / 16.0) * 1.8 + 32.0   or Max 185.00F
-    ds_reading = (isnan(t) || (t < QC_MIN_T)  || (t > QC_MAX_T))  ? QC_ERR_T  : t;
-    
-    if (ds_reading != QC_ERR_T) { 
-      ds_valid = true;
+    int32_t t = (int32_t) raw * (FIX_ONE / 16);  // Max 85.0C
+    ds_qc[probe] = qc_check(QC_T, t, &ds_reading[probe]);
+    ds_valid[probe] = (ds_qc[probe] == QC_OK);
+
+    // Have a temp,  but it might have value 85.00C / 185.00F which means it was just plugged in
+  }
+  return(ds_valid[probe]);
+}
+
+/*
+ * =============================================================
+ * ds_read_all() - Read every probe, true if all were good
+ * =============================================================
+ */
+bool ds_read_all() {
+  bool good = true;
+
+  for (int p=0; p<ds_count; p++) {
+    if (!ds_read(p)) {
+      good = false;
+    }
+  }
+  return (good);
+}
+
+/*
+ * =============================================================
+ * ds_wait() - Until the conversion is done, the probes answer
+ *   read time slots with 0 while converting, 1 when done
+ * =============================================================
+ */
+void ds_wait() {
+  while (((millis() - ds_start_ms) < ds_convert_ms) && !ds.read_bit()) {
+    delay(1);
+  }
+}
+
+/*
+ * =============================================================
+ *  Alarm Search - With ds_alarm set each probe's TH and TL are
+ *  written around its last reading, ds_alarm whole degrees
+ *  each way. A probe raises its alarm flag when a conversion
+ *  is at or past TH or TL, the Alarm Search (0xEC) finds just
+ *  those and only their scratchpads are read. The rest keep
+ *  their last reading, ds_stale[] counts the observations it
+ *  was carried, and every probe is read again once one was
+ *  carried ds_stale times, which also catches a probe that
+ *  lost power and its TH and TL with it.
+ * =============================================================
+ */
+uint8_t ds_stale[DS_MAX_PROBES];  // Observations carried forward
+bool ds_armed = false;          // TH and TL set around every reading
+int ds_carried = 0;             // Probes carried by the last collect
+
+/*
+ * =============================================================
+ * ds_arm() - TH and TL of a probe around its reading, the
+ *   scratchpad only, no EEPROM write
+ * =============================================================
+ */
+bool ds_arm(int probe) {
+  int t;
+
+  if (!ds_valid[probe]) {
+    return (false);
+  }
+  t = (ds_reading[probe] >= 0) ? ds_reading[probe] / FIX_ONE : -((FIX_ONE - 1 - ds_reading[probe]) / FIX_ONE);
+  ds.reset();
+  ds.select(ds_addr[probe]);
+  ds.write(0x4E);         // Write Scratchpad TH, TL, Config
+  ds.write((byte) (int8_t) constrain(t + cf_ds_alarm, -55, 125));
+  ds.write((byte) (int8_t) constrain(t - cf_ds_alarm, -55, 125));
+  ds.write(ds_cfg);
+  return (true);
+}
+
+/*
+ * =============================================================
+ * ds_alarm_collect() - Read the probes whose alarm is set,
+ *   false when every probe is to be read
+ * =============================================================
+ */
+bool ds_alarm_collect() {
+  byte addr[8];
+  bool moved[DS_MAX_PROBES];
+
+  for (int p=0; p<ds_count; p++) {
+    if (ds_stale[p] >= cf_ds_stale) {
+      return (false);
+    }
+    moved[p] = false;
+  }
+  ds.reset_search();
+  while (ds.search(addr, false)) {
+    for (int p=0; p<ds_count; p++) {
+      if (memcmp (addr, ds_addr[p], 8) == 0) {
+        moved[p] = true;
+      }
+    }
+  }
+  ds_carried = 0;
+  for (int p=0; p<ds_count; p++) {
+    if (!moved[p]) {
+      ds_stale[p]++;
+      ds_carried++;
+    }
+    else if (!ds_read(p) || !ds_arm(p)) {
+      ds_armed = false;
+      return (false);
     }
     else {
-      ds_valid = false;
-      ds_reading = QC_ERR_P;
+      ds_stale[p] = 0;
     }
-    
-    // Have a temp,  but it might have value 85.00C / 185.00F which means it was just plugged in
   }
-  return(ds_valid);
+  return (true);
 }
 
 /*
  * =============================================================
- * getDSTemp()
+ * ds_collect() - Finish the conversion ds_start() began, only
+ *   waits for what is left of the conversion time
  * =============================================================
  */
-void getDSTemp() {
-  int status = getDSTempByAddr(250);
-  if (status == false) {
-    // reread temp - it might of just been plugged in
-    status = getDSTempByAddr(750);
+void ds_collect() {
+  ds_wait();
+  if (cf_ds_alarm && ds_armed && ds_alarm_collect()) {
+    return;
   }
-
-  // temperture returned in ds_reading
-  // state returned in ds_valid
-  // if false and temp was equal to 0.0 then a CRC happened
-    
-  /*
-  if (status) { // Good Value Read
-    sprintf (msgbuf, "%d TS %d.%02d OK", 
-      probe, (int)ds_reading, (int)(ds_reading*100)%100);
-    Output (msgbuf);
+  ds_carried = 0;
+  if (!ds_read_all() && ds_retry) {
+    // Convert again and reread the bad ones - might of just been plugged in
+    ds_start();
+    ds_wait();
+    for (int p=0; p<ds_count; p++) {
+      if (!ds_valid[p]) {
+        ds_read(p);
+      }
+    }
+  }
+  if (cf_ds_alarm) {
+    ds_armed = true;
+    for (int p=0; p<ds_count; p++) {
+      ds_stale[p] = 0;
+      if (!ds_arm(p)) {
+        ds_armed = false;  // Read them all again next time
+      }
+    }
   }
-  else { // We read a temp but it was a bad value
-    sprintf (msgbuf, "%d TS %d.%02d BAD", 
-      probe, (int)ds_reading, (int)(ds_reading*100)%100);
-    Output (msgbuf);
+}
+
+/*
+ * =============================================================
+ * ds_resolution() - Set 9-12 bit resolution in scratchpad and
+ *   EEPROM of each probe, EEPROM only written when it changes,
+ *   true if a probe was changed
+ * =============================================================
+ */
+bool ds_resolution(int bits) {
+  byte data[9];
+  byte cfg = ((bits - 9) << 5) | 0x1F;
+  bool changed = false;
+
+  ds_convert_ms = (DS_CONVERT_MS >> (12 - bits)) + 1;  // 93.75 ms rounds up
+  ds_cfg = cfg;
+
+  for (int p=0; p<ds_count; p++) {
+    ds.reset();
+    ds.select(ds_addr[p]);
+    ds.write(0xBE);         // Read Scratchpad, keep the TH and TL alarm bytes
+    ds.read_bytes(data, 9);
+    if (OneWire::crc8(data, 8) != data[8]) {
+      LOG_ERR ("DS%d RES CRC", p+1);
+      ds_convert_ms = DS_CONVERT_MS;  // Unknown resolution, allow the longest
+      continue;
+    }
+    if (data[4] == cfg) {
+      continue;
+    }
+
+    ds.reset();
+    ds.select(ds_addr[p]);
+    ds.write(0x4E);         // Write Scratchpad TH, TL, Config
+    ds.write(data[2]);
+    ds.write(data[3]);
+    ds.write(cfg);
+
+    ds.reset();
+    ds.select(ds_addr[p]);
+    ds.write(0x48,0);       // Copy Scratchpad to EEPROM
+    delay(10);
+    changed = true;
+
+    LOG_INFO ("DS%d RES %d SET", p+1, bits);
   }
-  */
+  return (changed);
 }
 
 /*
  * =============================================================
- * Scan1WireBus() - Get Sensor Address and Read Temperature
+ * Scan1WireBus() - Get Sensor Addresses
  * =============================================================
  */
 bool Scan1WireBus() {
-  byte i;
-  byte present = 0;
-  byte type_s;
   byte addr[8];
-  bool found = false;
-  
-  // Reset and Start search
+
+  // Reset and Start search, search() returns false right away if there is no presence pulse
   ds.reset_search();
-  delay(250);
-
-  // Expecting one and only one probe on the pin
-  
-  if (!ds.search(ds_addr)) {
-    // Sensor Not Found
-    sprintf (msgbuf, "DS NF");
-    Output (msgbuf);
-  }
-  else if (OneWire::crc8(ds_addr, 7) != ds_addr[7]) {
-    // Bad CRC
-    sprintf (msgbuf, "DS CRC"); // Bad CRC
-    Output (msgbuf);
-  }
-  else if (ds_addr[0] != 0x28) { // DS18B20
-    // Unknown Device Type
-    sprintf (msgbuf, "DS UKN %d", ds_addr[0]); // Unknown Device type
-    Output (msgbuf);
-  } 
-  else {
-    ds_found = true;
-    sprintf (msgbuf, "DS %02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X", 
-       ds_addr[0], ds_addr[1], ds_addr[2], ds_addr[3],
-       ds_addr[4], ds_addr[5], ds_addr[7], ds_addr[7]); 
-    Output (msgbuf);
-    found = true;
+
+  ds_count = 0;
+  while ((ds_count < DS_MAX_PROBES) && ds.search(addr)) {
+    if (OneWire::crc8(addr, 7) != addr[7]) {
+      ev_note (EV_DS_CRC, 0); // Bad CRC
+    }
+    else if (addr[0] != 0x28) { // DS18B20
+      // Unknown Device Type
+      LOG_ERR ("DS UKN %d", addr[0]); // Unknown Device type
+    }
+    else {
+      memcpy (ds_addr[ds_count], addr, 8);
+      ds_count++;
+      LOG_INFO ("DS%d %02X:%02X:%02X:%02X:%02X:%02X:%02X:%02X", ds_count,
+         addr[0], addr[1], addr[2], addr[3],
+         addr[4], addr[5], addr[6], addr[7]);
+    }
+  }
+
+  if (ds_count == 0) {
+    ev_note (EV_DS_NF, 0); // Sensor Not Found
+  }
+  return (ds_count > 0);
+}
+
+/*
+ * =============================================================
+ *  ROM Cache - Addresses found by a search are kept on SD, one
+ *    probe per line as 16 hex digits in search order. At boot
+ *    they are checked with a read of each probe and the search
+ *    is only run when that fails. Delete the file after adding
+ *    probes to the bus.
+ * =============================================================
+ */
+#define DS_ROM_FILE     "/OBS/DSROM.TXT"
+
+/*
+ * =============================================================
+ * ds_rom_load() - Read cached addresses, check their CRC
+ * =============================================================
+ */
+bool ds_rom_load() {
+  File fp;
+  char line[20];
+  byte addr[8];
+  int i, n;
+
+  if (!SD_exists || !SD.exists(DS_ROM_FILE)) {
+    return (false);
+  }
+  fp = SD.open(DS_ROM_FILE, FILE_READ);
+  if (!fp) {
+    return (false);
+  }
+
+  ds_count = 0;
+  while (fp.available() && (ds_count < DS_MAX_PROBES)) {
+    n = fp.readBytesUntil('\n', line, sizeof(line)-1);
+    line[n] = 0;
+    if (n < 16) {
+      continue;  // Blank line or CR only
+    }
+    for (i=0; i<8; i++) {
+      char hex[3] = {line[i*2], line[i*2+1], 0};
+      addr[i] = (byte) strtoul(hex, NULL, 16);
+    }
+    if ((OneWire::crc8(addr, 7) != addr[7]) || (addr[0] != 0x28)) {
+      ds_count = 0;
+      break;
+    }
+    memcpy (ds_addr[ds_count++], addr, 8);
+  }
+  fp.close();
+  return (ds_count > 0);
+}
+
+/*
+ * =============================================================
+ * ds_rom_verify() - Every cached probe answers with a good
+ *   scratchpad. A config byte without its always set low bits
+ *   catches an empty or shorted bus reading all 0's.
+ * =============================================================
+ */
+bool ds_rom_verify() {
+  byte data[9];
+
+  for (int p=0; p<ds_count; p++) {
+    if (!ds.reset()) {
+      return (false);  // No presence pulse
+    }
+    ds.select(ds_addr[p]);
+    ds.write(0xBE);         // Read Scratchpad
+    ds.read_bytes(data, 9);
+    if ((OneWire::crc8(data, 8) != data[8]) || ((data[4] & 0x1F) != 0x1F)) {
+      return (false);
+    }
   }
-  return (found);
+  return (true);
+}
+
+/*
+ * =============================================================
+ * ds_rom_save() - Write found addresses to the cache
+ * =============================================================
+ */
+void ds_rom_save() {
+  File fp;
+
+  if (!SD_exists) {
+    return;
+  }
+  SD.remove(DS_ROM_FILE);
+  fp = SD.open(DS_ROM_FILE, FILE_WRITE);
+  if (!fp) {
+    Output ("DS ROM SAVE ERR");
+    return;
+  }
+  for (int p=0; p<ds_count; p++) {
+    sprintf (msgbuf, "%02X%02X%02X%02X%02X%02X%02X%02X",
+       ds_addr[p][0], ds_addr[p][1], ds_addr[p][2], ds_addr[p][3],
+       ds_addr[p][4], ds_addr[p][5], ds_addr[p][6], ds_addr[p][7]);
+    fp.println(msgbuf);
+  }
+  fp.close();
 }
 
 /*
  *=======================================================================================================================
- * dallas_sensor_init - Dallas Sensor initialize
+ * dallas_sensor_init - Dallas Sensor initialize, setup() started a conversion at reset with ds_start(), the skip ROM
+ *   broadcast needs no addresses. Its result is read here, a second conversion only if the resolution was changed.
  *=======================================================================================================================
  */
 void dallas_sensor_init() {
-  ds_found = Scan1WireBus();  // Look for Dallas Sensor on pin get it's address   
-  if (!ds_found) {
-    // Retry
-    delay (250);
-    ds_found = Scan1WireBus();
+  SF_SCRATCH sc;
+  char *buf = sc.alloc(SF_LINE);
+
+  ds_wait();  // What is left of the conversion begun at reset, the bus is ours again
+  if (ds_rom_load() && ds_rom_verify()) {
+    ds_found = true;
+    LOG_INFO ("DS ROM %d OK", ds_count);
+  }
+  else {
+    ds_found = Scan1WireBus();  // Look for Dallas Sensors on pin get their address
     if (!ds_found) {
-      SystemStatusBits |= SSB_DS_1;  // Turn On Bit
+      // Retry
+      delay (250);
+      ds_found = Scan1WireBus();
+      if (!ds_found) {
+        SystemStatusBits |= SSB_DS_1;  // Turn On Bit
+      }
+    }
+    if (ds_found) {
+      ds_rom_save();
     }
-  }  
+  }
   if (ds_found) {
-    getDSTemp();
-    if (ds_valid) { // Good Value Read
-      sprintf (msgbuf, "DS %d.%02d OK", (int)ds_reading, (int)(ds_reading*100)%100);
+    if ((cf_ds_res < 9) || (cf_ds_res > 12)) {
+      LOG_ERR ("DS RES %d ERR", cf_ds_res);
+      cf_ds_res = 12;
+    }
+    if (ds_resolution(cf_ds_res)) {
+      ds_start();   // The one from reset was at the old resolution
     }
-    else { // We read a temp but it was a bad value
-      sprintf (msgbuf, "DS %d.%02d BAD", (int)ds_reading, (int)(ds_reading*100)%100);
+    ds_collect();
+    for (int p=0; p<ds_count; p++) {
+      fix_str(buf, SF_LINE, ds_reading[p], 2);
+      if (ds_valid[p]) { // Good Value Read
+        sprintf (msgbuf, "DS%d %s OK", p+1, buf);
+      }
+      else { // We read a temp but it was a bad value
+        sprintf (msgbuf, "DS%d %s BAD", p+1, buf);
+      }
+      Output (msgbuf);
     }
-    Output (msgbuf);
   }
 }
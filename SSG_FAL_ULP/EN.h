@@ -0,0 +1,221 @@
+/*
+ * ======================================================================================================================
+ *  EN.h - Energy Monitor
+ *
+ *  With en_ina set to 219 or 260 an INA219 or INA260 current monitor at en_addr on the I2C bus measures the supply
+ *  of the board. It converts continuously, en_mark() is called by ph_start() and ph_end() and reads the latest bus
+ *  voltage and current at every phase boundary, the power between two marks is taken as the mean of the two and
+ *  charged to the phase just ended. The INA219 current is its shunt voltage over en_shunt mOhm, the INA260 has its
+ *  own 2 mOhm shunt and reports 1.25 mA steps, too coarse for sleep current.
+ *
+ *  en_sleep() before obs_sleep() switches the part to its longest averaging (INA260 1024 x 8.2 ms, about 17 s,
+ *  INA219 128 x 68 ms), en_wake() reads that average first thing after the wake, so it is the sleep current, and
+ *  switches back. The sleep is charged at that current over the RTC seconds slept.
+ *
+ *  With a cycle done the record gets "en":[wake,i2c,sg,bmx,mcp,ds,fmt,sd,out,sleep,arch,slept] in mJ, the last is the
+ *  sleep itself, and "sua" the sleep current in uA.
+ * ======================================================================================================================
+ */
+#define EN_INA219         219
+#define EN_INA260         260
+
+#define EN_REG_CONFIG     0x00
+#define EN_REG_SHUNT      0x01      // INA219 shunt voltage 10uV, INA260 current 1.25mA
+#define EN_REG_BUS        0x02      // INA219 bits 15:3 4mV, INA260 1.25mV
+#define EN_REG_MFG        0xFE      // INA260 only
+#define EN_MFG_TI         0x5449
+
+// Continuous shunt and bus, INA219 16V 40mV 12bit and 128 sample averages, INA260 1.1ms x4 and 8.244ms x1024
+#define EN_219_FAST       0x019F
+#define EN_219_SLOW       0x07FF
+#define EN_260_FAST       0x0327
+#define EN_260_SLOW       0x0FFF
+
+#define EN_SLOTS          (PH_COUNT + 1)  // Phases and the sleep
+
+bool     en_found = false;
+uint32_t en_uj[EN_SLOTS];           // This cycle, uJ
+uint32_t en_last[EN_SLOTS];         // Last complete cycle
+bool     en_last_valid = false;
+uint32_t en_prev_uw = 0;            // Power at the last mark
+unsigned long en_prev_us = 0;
+bool     en_prev_valid = false;     // A mark has been taken this cycle
+int32_t  en_sleep_ua = 0;           // Average current over the last sleep
+uint32_t en_sleep_at = 0;           // tm_now() at sleep entry
+
+/*
+ *=======================================================================================================================
+ * en_write() - INA register write
+ *=======================================================================================================================
+ */
+bool en_write(uint8_t reg, uint16_t v) {
+  iq_drain();
+  Wire.beginTransmission((uint8_t) cf_en_addr);
+  Wire.write(reg);
+  Wire.write(v >> 8);
+  Wire.write(v & 0xFF);
+  return (Wire.endTransmission() == 0);
+}
+
+/*
+ *=======================================================================================================================
+ * en_read() - INA register read, false if no answer
+ *=======================================================================================================================
+ */
+bool en_read(uint8_t reg, uint16_t *v) {
+  iq_drain();
+  Wire.beginTransmission((uint8_t) cf_en_addr);
+  Wire.write(reg);
+  if (Wire.endTransmission() || (Wire.requestFrom((uint8_t) cf_en_addr, (size_t) 2) != 2)) {
+    return (false);
+  }
+  *v = (Wire.read() << 8);
+  *v |= Wire.read();
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * en_sample() - Supply current in uA and voltage in mV
+ *=======================================================================================================================
+ */
+bool en_sample(int32_t *ua, int32_t *mv) {
+  uint16_t shunt, bus;
+
+  if (!en_read(EN_REG_SHUNT, &shunt) || !en_read(EN_REG_BUS, &bus)) {
+    return (false);
+  }
+  if (cf_en_ina == EN_INA260) {
+    *ua = (int32_t) (int16_t) shunt * 1250L;
+    *mv = (int32_t) bus * 5 / 4;
+  }
+  else {
+    *ua = (int32_t) (int16_t) shunt * 10000L / cf_en_shunt;
+    *mv = (int32_t) (bus >> 3) * 4;
+  }
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * en_initialize() - Find and set up the current monitor, after the I2C scan
+ *=======================================================================================================================
+ */
+void en_initialize() {
+  uint16_t v;
+
+  if (!cf_en_ina) {
+    return;
+  }
+  if (((cf_en_ina != EN_INA219) && (cf_en_ina != EN_INA260)) || (cf_en_shunt <= 0) || !I2C_Present(cf_en_addr)) {
+    LOG_ERR ("EN:INA%d NF", cf_en_ina);
+    return;
+  }
+  if ((cf_en_ina == EN_INA260) && (!en_read(EN_REG_MFG, &v) || (v != EN_MFG_TI))) {
+    LOG_ERR ("EN:INA%d NF", cf_en_ina);
+    return;
+  }
+  if (!en_write(EN_REG_CONFIG, (cf_en_ina == EN_INA260) ? EN_260_FAST : EN_219_FAST)) {
+    LOG_ERR ("EN:INA%d NF", cf_en_ina);
+    return;
+  }
+  memset (en_uj, 0, sizeof(en_uj));
+  en_found = true;
+  LOG_INFO ("EN:INA%d %02X", cf_en_ina, cf_en_addr);
+}
+
+/*
+ *=======================================================================================================================
+ * en_mark() - Charge the energy since the last mark to phase, PH_NONE starts a cycle
+ *=======================================================================================================================
+ */
+void en_mark(int phase) {
+  int32_t ua, mv;
+  uint32_t uw;
+  unsigned long t;
+
+  if (!en_found) {
+    return;
+  }
+  if (phase == PH_NONE) {
+    memcpy (en_last, en_uj, sizeof(en_last));
+    en_last_valid = en_prev_valid;
+    memset (en_uj, 0, sizeof(en_uj));
+    en_prev_valid = false;
+  }
+  if (!en_sample(&ua, &mv)) {
+    return;
+  }
+  t = micros();
+  uw = (ua > 0) ? (uint32_t) (((int64_t) ua * mv) / 1000) : 0;
+  if (en_prev_valid && (phase < PH_COUNT)) {
+    en_uj[phase] += (uint32_t) (((uint64_t) (en_prev_uw + uw) / 2 * (t - en_prev_us)) / 1000000ULL);
+  }
+  en_prev_uw = uw;
+  en_prev_us = t;
+  en_prev_valid = true;
+}
+
+/*
+ *=======================================================================================================================
+ * en_sleep() - Average over the sleep, call last before obs_sleep()
+ *=======================================================================================================================
+ */
+void en_sleep() {
+  if (!en_found) {
+    return;
+  }
+  en_write(EN_REG_CONFIG, (cf_en_ina == EN_INA260) ? EN_260_SLOW : EN_219_SLOW);
+  en_sleep_at = tm_now();
+}
+
+/*
+ *=======================================================================================================================
+ * en_wake() - Read the sleep average and charge the sleep, call first after obs_sleep()
+ *=======================================================================================================================
+ */
+void en_wake() {
+  int32_t ua, mv;
+  uint32_t slept;
+
+  if (!en_found) {
+    return;
+  }
+  slept = tm_now() - en_sleep_at;
+  if (en_sample(&ua, &mv)) {
+    en_sleep_ua = ua;
+    if (ua > 0) {
+      en_uj[PH_COUNT] = (uint32_t) (((uint64_t) ua * mv * slept) / 1000);
+    }
+  }
+  en_write(EN_REG_CONFIG, (cf_en_ina == EN_INA260) ? EN_260_FAST : EN_219_FAST);
+}
+
+/*
+ *=======================================================================================================================
+ * en_report() - Energy of the last cycle in the record being built
+ *=======================================================================================================================
+ */
+void en_report(JSONBUF *jb) {
+  uint32_t total = 0;
+  int mark;
+
+  if (!en_found || !en_last_valid) {
+    return;
+  }
+  mark = jb_key(jb, "en");
+  jb_putc(jb, '[');
+  for (int i=0; i<EN_SLOTS; i++) {
+    if (i) {
+      jb_putc(jb, ',');
+    }
+    jb_putu(jb, en_last[i] / 1000, 0);  // mJ to 2 digits, an hour asleep does not fit FIX_ONE units
+    jb_putc(jb, '.');
+    jb_putu(jb, (en_last[i] % 1000) / 10, 2);
+    total += en_last[i];
+  }
+  jb_putc(jb, ']');
+  jb_end(jb, mark);
+  jb_int(jb, "sua", en_sleep_ua);
+  LOG_DBG ("EN:%lu mJ Sleep %ld uA", total / 1000, (long) en_sleep_ua);
+}
@@ -0,0 +1,127 @@
+/*
+ * ======================================================================================================================
+ *  EV.h - Event Catalog
+ *
+ *  Failures and state changes worth counting across the fleet have a number in EV_TABLE. ev_note() keeps the number,
+ *  an argument and the time in a ring of the last EV_RING events and prints the catalog text as before, ev_record()
+ *  only keeps it. The text is in flash once, an event is an 8 byte EV_REC. SD_FlushEvents() appends the events not
+ *  yet written to /OBS/EVENTS.bin when the card is written anyway, tools/obsevents.py turns them back into text.
+ *  The sh "ev" command shows the ring as short codes, E07:1 is BMX1 OFFLINE.
+ *
+ *  Numbers are in the files on the cards, add new events at the end and never reuse one.
+ * ======================================================================================================================
+ */
+#define EV_TABLE \
+  EV_DEF(EV_NONE,           LOG_LEVEL_DBG,  "EV:None") \
+  EV_DEF(EV_BOOT,           LOG_LEVEL_DBG,  "EV:Boot RCAUSE %02X") \
+  EV_DEF(EV_LOST,           LOG_LEVEL_ERR,  "EV:%d Lost") \
+  EV_DEF(EV_WD_RESET,       LOG_LEVEL_ERR,  "WD:Reset after phase %d") \
+  EV_DEF(EV_PH_OVERRUN,     LOG_LEVEL_ERR,  "PH:Overrun phase %d") \
+  EV_DEF(EV_SD_NF,          LOG_LEVEL_ERR,  "SD:NF") \
+  EV_DEF(EV_BMX_ONLINE,     LOG_LEVEL_INFO, "BMX%d ONLINE") \
+  EV_DEF(EV_BMX_OFFLINE,    LOG_LEVEL_ERR,  "BMX%d OFFLINE") \
+  EV_DEF(EV_DS_NF,          LOG_LEVEL_ERR,  "DS NF") \
+  EV_DEF(EV_DS_CRC,         LOG_LEVEL_ERR,  "DS CRC") \
+  EV_DEF(EV_SD_OBS_OPEN,    LOG_LEVEL_ERR,  "OBS Open Log Err") \
+  EV_DEF(EV_SD_OBS_WRITE,   LOG_LEVEL_ERR,  "OBS Write Log Err") \
+  EV_DEF(EV_SD_BIN_OPEN,    LOG_LEVEL_ERR,  "BIN Open Log Err") \
+  EV_DEF(EV_SD_SUM_OPEN,    LOG_LEVEL_ERR,  "SUM Open Log Err") \
+  EV_DEF(EV_SD_WRITE,       LOG_LEVEL_ERR,  "SD:Write Err %d") \
+  EV_DEF(EV_SD_RETRY,       LOG_LEVEL_INFO, "SD:Retry %d") \
+  EV_DEF(EV_SD_DROPPED,     LOG_LEVEL_ERR,  "SD:Dropped %d") \
+  EV_DEF(EV_FL_OPEN,        LOG_LEVEL_ERR,  "FL:Open Err") \
+  EV_DEF(EV_FL_WRITE,       LOG_LEVEL_ERR,  "FL:Write Err") \
+  EV_DEF(EV_RTC_INT_LOW,    LOG_LEVEL_ERR,  "ERR:RTC INT %d LOW") \
+  EV_DEF(EV_RTC_ALARM,      LOG_LEVEL_ERR,  "ERR:RTC Alarm") \
+  EV_DEF(EV_SG_MODEL_NF,    LOG_LEVEL_ERR,  "SG:model %d NF") \
+  EV_DEF(EV_CF_RELOAD,      LOG_LEVEL_INFO, "CF:Reload %d Changed") \
+  EV_DEF(EV_PWR_BOD,        LOG_LEVEL_ERR,  "PWR:Brownout %dmV") \
+  EV_DEF(EV_PWR_CLEAN,      LOG_LEVEL_INFO, "PWR:Clean Shutdown") \
+  EV_DEF(EV_OBS_GAP,        LOG_LEVEL_ERR,  "OBS:Gap %d Slots") \
+  EV_DEF(EV_RTC_32K,        LOG_LEVEL_ERR,  "ERR:RTC 32K %d Edges") \
+  EV_DEF(EV_SS_SEASON,      LOG_LEVEL_INFO, "SS:Season From %04d") \
+  EV_DEF(EV_TM_WAKE,        LOG_LEVEL_ERR,  "TM:Woke %ds Off") \
+  EV_DEF(EV_RTC_MISSED,     LOG_LEVEL_ERR,  "ERR:RTC Alarm Missed INT %d")
+
+#define EV_DEF(id, level, text) id,
+enum { EV_TABLE EV_COUNT };
+#undef EV_DEF
+
+typedef struct {
+  uint8_t level;                    // LOG_LEVEL_* ev_note() prints at
+  const char *text;                 // sprintf() format, one int argument
+} EV_CATALOG;
+
+#define EV_DEF(id, level, text) {level, text},
+const EV_CATALOG ev_catalog[EV_COUNT] = { EV_TABLE };  // const, stays in flash
+#undef EV_DEF
+
+#define EV_RING           32        // Events kept, 256 bytes
+
+typedef struct __attribute__((packed)) {
+  uint32_t at;                      // Unix time, 0 until the RTC is first read
+  uint8_t  id;                      // EV_*
+  uint8_t  pad;
+  int16_t  arg;
+} EV_REC;                           // As written to EVENTS.bin
+
+EV_REC   ev_ring[EV_RING];
+uint32_t ev_total = 0;              // Events since boot, the next goes in ev_ring[ev_total % EV_RING]
+uint32_t ev_written = 0;            // Events SD_FlushEvents() has put on the card
+uint16_t ev_tally[EV_COUNT];        // Events since boot by number, for RS.h
+
+extern uint32_t tm_epoch;           // TM.h, DS3231 time at tm_sync_ms
+extern unsigned long tm_sync_ms;
+
+/*
+ * ======================================================================================================================
+ * ev_record() - Keep an event without printing it
+ * ======================================================================================================================
+ */
+void ev_record(uint8_t id, int arg) {
+  EV_REC *e = &ev_ring[ev_total % EV_RING];
+
+  e->at = (tm_epoch) ? tm_epoch + (millis() - tm_sync_ms) / 1000 : 0;
+  e->id = id;
+  e->pad = 0;
+  e->arg = (int16_t) arg;
+  ev_total++;
+  if (ev_tally[id] < 0xFFFF) {
+    ev_tally[id]++;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * ev_note() - Keep an event and print its catalog text
+ * ======================================================================================================================
+ */
+void ev_note(uint8_t id, int arg) {
+  ev_record(id, arg);
+  if ((id < EV_COUNT) && (ev_catalog[id].level <= LOG_LEVEL) && OP_ACTIVE) {
+    sprintf (msgbuf, ev_catalog[id].text, arg);
+    Output (msgbuf);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * ev_show() - Ring as short codes, oldest first, on the OLED and console
+ * ======================================================================================================================
+ */
+void ev_show() {
+  uint32_t first = (ev_total > EV_RING) ? ev_total - EV_RING : 0;
+  int m = 0;
+
+  sprintf (msgbuf, "EV:%lu since boot", (unsigned long) ev_total);
+  Output (msgbuf);
+  for (uint32_t n=first; n<ev_total; n++) {
+    EV_REC *e = &ev_ring[n % EV_RING];
+
+    m += sprintf (msgbuf + m, "E%02d:%d ", e->id, e->arg);
+    if ((m > 15) || ((n + 1) == ev_total)) {  // A line of the OLED
+      Output (msgbuf);
+      m = 0;
+    }
+  }
+}
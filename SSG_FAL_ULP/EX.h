@@ -0,0 +1,202 @@
+/*
+ * ======================================================================================================================
+ *  EX.h - Log Export over the USB Serial Console
+ *
+ *  In calibration mode the console shell (SH.h) hands a line
+ *
+ *    X YYYYMMDD[-YYYYMMDD] [log|bin|idx|dla] [HH:MM|+offset]
+ *
+ *  to ex_command(), which streams the daily files of the date range as frames at USB speed, the baud rate of a
+ *  native USB port is not used.
+ *  HH:MM starts the first day at that time using its .idx sidecar (sd_idx=1), +offset starts it at a byte offset.
+ *  There is no handshake, the host checks each frame's CRC and after a dropped connection or a bad frame sends the
+ *  command again from the last good day and offset. tools/obsexport.py does this.
+ *
+ *  Frame, little endian:  'X' 'F' | day u32 (YYYYMMDD) | offset u32 | len u16 | data[len] | crc u16
+ *    crc is OneWire::crc16() (CRC-16/ARC) of day through data. A frame with len 0 ends a day's file with offset at
+ *    its size, a missing file gets none. Day 0 ends the export.
+ * ======================================================================================================================
+ */
+#define EX_CHUNK          512               // Data bytes per frame, one SD block
+
+/*
+ *=======================================================================================================================
+ * ex_frame() - Send one frame, false when the host has gone
+ *=======================================================================================================================
+ */
+bool ex_frame(uint32_t day, uint32_t offset, const uint8_t *data, uint16_t len) {
+  uint8_t hdr[12];
+  uint16_t crc;
+
+  hdr[0] = 'X';
+  hdr[1] = 'F';
+  memcpy (&hdr[2], &day, 4);
+  memcpy (&hdr[6], &offset, 4);
+  memcpy (&hdr[10], &len, 2);
+  crc = OneWire::crc16(&hdr[2], 10, 0);
+  crc = OneWire::crc16(data, len, crc);
+
+  wd_feed();  // A slow host can hold a frame for a while
+  Serial.write(hdr, sizeof(hdr));
+  Serial.write(data, len);
+  Serial.write((const uint8_t *)&crc, 2);
+  return (Serial);  // DTR dropped with the laptop
+}
+
+/*
+ *=======================================================================================================================
+ * ex_idx_offset() - Offset in the .log of the first record at or after minute, from its .idx
+ *=======================================================================================================================
+ */
+uint32_t ex_idx_offset(const DateTime &day, int minute) {
+  char path[24];
+  File fp;
+  SD_IDXENT e;
+  uint32_t lo = 0;
+  uint32_t hi;
+  uint32_t mid;
+  uint32_t offset = 0;
+
+  SD_DayPath(path, day, "idx");
+  fp = SD.open(path, FILE_READ);
+  if (!fp) {
+    return (0);  // No index, the whole day
+  }
+
+  // Entries are in time order, binary search for the first one at or after minute
+  hi = fp.size() / sizeof(SD_IDXENT);
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    fp.seek(mid * sizeof(SD_IDXENT));
+    if ((fp.read(&e, sizeof(e)) != (int) sizeof(e)) || (e.minute >= minute)) {
+      hi = mid;
+    }
+    else {
+      lo = mid + 1;
+    }
+  }
+  if (lo == (fp.size() / sizeof(SD_IDXENT))) {
+    offset = 0xFFFFFFFF;  // Nothing that late, the day ends at once
+  }
+  else {
+    fp.seek(lo * sizeof(SD_IDXENT));
+    fp.read(&e, sizeof(e));
+    offset = e.offset;
+  }
+  fp.close();
+  return (offset);
+}
+
+/*
+ *=======================================================================================================================
+ * ex_file() - Stream one daily file from offset, false when the host has gone
+ *=======================================================================================================================
+ */
+bool ex_file(const DateTime &day, const char *ext, uint32_t offset) {
+  char path[24];
+  uint8_t buf[EX_CHUNK];
+  uint32_t id = (uint32_t) day.year() * 10000 + day.month() * 100 + day.day();
+  uint32_t size;
+  int n;
+  File fp;
+
+  SD_DayPath(path, day, ext);
+  fp = SD.open(path, FILE_READ);
+  if (!fp) {
+    return (Serial);
+  }
+  size = fp.size();
+  offset = (offset < size) ? offset : size;
+  fp.seek(offset);
+  while (offset < size) {
+    n = fp.read(buf, sizeof(buf));
+    if (n <= 0) {
+      break;  // Read error, the host sees a short file and asks again
+    }
+    if (!ex_frame(id, offset, buf, n)) {
+      fp.close();
+      return (false);
+    }
+    offset += n;
+  }
+  fp.close();
+  return (ex_frame(id, offset, buf, 0));
+}
+
+/*
+ *=======================================================================================================================
+ * ex_date() - Parse YYYYMMDD
+ *=======================================================================================================================
+ */
+bool ex_date(const char *s, DateTime *day) {
+  long v;
+
+  if ((strlen(s) != 8) || !isnumeric((char *) s)) {
+    return (false);
+  }
+  v = atol(s);
+  *day = DateTime(v / 10000, (v / 100) % 100, v % 100, 0, 0, 0);
+  return (day->isValid());
+}
+
+/*
+ *=======================================================================================================================
+ * ex_command() - Run an X command line
+ *=======================================================================================================================
+ */
+void ex_command(char *line) {
+  char *p = line + 1;
+  char *token;
+  char *dash;
+  const char *ext = "log";
+  DateTime first, last, day;
+  uint32_t offset = 0;
+  int minute = -1;
+
+  token = strtok_r(p, " \r\n", &p);
+  if (!token) {
+    Output ("EX:Usage X YYYYMMDD[-YYYYMMDD] [log|bin|idx|dla] [HH:MM|+offset]");
+    return;
+  }
+  dash = strchr(token, '-');
+  if (dash) {
+    *dash++ = 0;
+  }
+  if (!ex_date(token, &first) || !ex_date((dash) ? dash : token, &last) || (last < first)) {
+    Output ("EX:Bad Dates");
+    return;
+  }
+  while ((token = strtok_r(p, " \r\n", &p))) {
+    if (*token == '+') {
+      offset = strtoul(token + 1, NULL, 10);
+    }
+    else if (strchr(token, ':')) {
+      minute = atoi(token) * 60 + atoi(strchr(token, ':') + 1);
+    }
+    else if (!strcmp(token, "log") || !strcmp(token, "bin") || !strcmp(token, "idx") ||
+             !strcmp(token, "dla")) {
+      ext = token;
+    }
+  }
+
+  if (!SD_exists || SD_down) {
+    Output ("EX:No SD");
+    return;
+  }
+  SD_Close();  // Held records are part of the export
+
+  if ((minute >= 0) && !strcmp(ext, "log")) {
+    offset = ex_idx_offset(first, minute);
+  }
+  op_tx_own(true);  // Console lines out first, the frames go straight to the endpoint
+  for (day = first; day <= last; day = day + TimeSpan(1, 0, 0, 0)) {
+    if (!ex_file(day, ext, offset)) {
+      break;  // Host has gone, it resumes with a new command
+    }
+    offset = 0;
+  }
+  if (day > last) {
+    ex_frame(0, 0, NULL, 0);
+  }
+  op_tx_own(false);
+}
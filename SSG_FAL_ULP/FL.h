@@ -0,0 +1,411 @@
+/*
+ * ======================================================================================================================
+ *  FL.h - Internal Flash Fallback
+ *
+ *  While the SD card is missing or down each observation's binary record (OBS_BINREC) goes into a ring in the top
+ *  FL_SIZE bytes of the SAMD21's own flash. One record per 64 byte page, a page is written once between erases.
+ *  Rows (4 pages) are erased just ahead of the write position, so the ring wears evenly and when full it keeps the
+ *  newest FL_SLOTS - FL_ROW_PAGES records. Each page starts with a sequence number, after a reboot the ring is
+ *  found again by scanning for the highest one. SD_Recover() in SDC.h brings a missing or failed card back.
+ *
+ *  When the card is back the backlog is appended to FL_FILE in one pass, obsbin2json.py reads it like any .bin,
+ *  then the drained rows are erased. Power lost between the two leaves the backlog to be drained again, so
+ *  FL_FILE may hold a row twice but never misses one.
+ *
+ *  The ring is only used when it lies above the end of the sketch in flash, checked at boot.
+ *
+ *  Config Snapshot - The FL_CF_SIZE bytes below the ring hold the integer config (cf_keys[] in CF.h) as
+ *  CONFIG.TXT last gave it, with the file's size and FAT write time, a version, a CRC of the key names so a sketch
+ *  with other keys does not take it, and a CRC of the values. fl_config() at boot loads the snapshot while
+ *  CONFIG.TXT's directory entry still matches and only parses the file when it changed, the snapshot is rewritten
+ *  then. Without a card the snapshot stands in for the defaults. fl_cf_changed() is the same check at each wake.
+ * ======================================================================================================================
+ */
+#define FL_SIZE           0x10000           // 64KB, 1024 records, 10 days at 15 minutes
+#define FL_BASE           (FLASH_SIZE - FL_SIZE)
+#define FL_PAGE           FLASH_PAGE_SIZE   // 64 bytes, the write unit
+#define FL_ROW_PAGES      4                 // Erase unit is a row of 4 pages
+#define FL_ROW            (FL_PAGE * FL_ROW_PAGES)
+#define FL_SLOTS          (FL_SIZE / FL_PAGE)
+#define FL_EMPTY          0xFFFFFFFF        // Sequence of an erased page
+#define FL_FILE           "/OBS/FLASH.bin"
+
+typedef struct __attribute__((packed)) {
+  uint32_t seq;                             // Written order, FL_EMPTY when erased
+  uint8_t  len;                             // Bytes in rec[]
+  uint8_t  rec[FL_PAGE - 5];
+} FL_SLOT;
+
+// Sketch end in flash from the linker script, .data initial values follow the code
+extern uint32_t _etext;
+extern uint32_t _srelocate;
+extern uint32_t _erelocate;
+
+bool     fl_ok = false;                     // Ring is clear of the sketch and in use
+uint16_t fl_head = 0;                       // Slot the next record goes in
+uint16_t fl_count = 0;                      // Records held, oldest at fl_head - fl_count
+uint32_t fl_seq = 0;                        // Sequence of the next record
+
+/*
+ *=======================================================================================================================
+ * fl_slot() - Address of a slot, flash is memory mapped for reading
+ *=======================================================================================================================
+ */
+const FL_SLOT *fl_slot(uint16_t slot) {
+  return ((const FL_SLOT *) (FL_BASE + ((uint32_t) slot * FL_PAGE)));
+}
+
+/*
+ *=======================================================================================================================
+ * fl_nvm() - Run an NVM controller command on a flash address
+ *=======================================================================================================================
+ */
+void fl_nvm(uint32_t addr, uint16_t cmd) {
+  NVMCTRL->STATUS.reg |= NVMCTRL_STATUS_MASK;  // Clear errors of the last command
+  NVMCTRL->ADDR.reg = addr / 2;                // 16 bit word address
+  NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | cmd;
+  while (!NVMCTRL->INTFLAG.bit.READY);
+}
+
+/*
+ *=======================================================================================================================
+ * fl_write() - Program the page at addr from a 32 bit aligned buffer, the page must be erased
+ *=======================================================================================================================
+ */
+void fl_write(uint32_t addr, const uint32_t *src) {
+  volatile uint32_t *dst = (volatile uint32_t *) addr;
+
+  NVMCTRL->CTRLB.bit.MANW = 1;  // We say when the page buffer is written
+  fl_nvm((uint32_t) dst, NVMCTRL_CTRLA_CMD_PBC);
+  for (int i=0; i<(FL_PAGE / 4); i++) {
+    dst[i] = src[i];            // Page buffer takes 32 bit writes only
+  }
+  fl_nvm((uint32_t) dst, NVMCTRL_CTRLA_CMD_WP);
+}
+
+/*
+ *=======================================================================================================================
+ * fl_initialize() - Find the ring left in flash from before the reboot
+ *=======================================================================================================================
+ */
+void fl_initialize() {
+  uint32_t end = (uint32_t) &_etext + ((uint32_t) &_erelocate - (uint32_t) &_srelocate);
+  uint32_t hi = 0;
+  uint16_t at = 0;
+  uint16_t n = 0;
+  const FL_SLOT *p;
+
+  fl_ok = (cf_sd_flash && (end <= FL_BASE));
+  if (!fl_ok) {
+    if (cf_sd_flash) {
+      Output ("FL:Sketch Overlaps");
+    }
+    return;
+  }
+
+  // Valid slots are one run in ring order, ending at the highest sequence
+  for (uint16_t i=0; i<FL_SLOTS; i++) {
+    p = fl_slot(i);
+    if (p->seq != FL_EMPTY) {
+      n++;
+      if (p->seq >= hi) {
+        hi = p->seq;
+        at = i;
+      }
+    }
+  }
+  if (n) {
+    fl_head = (at + 1) % FL_SLOTS;
+    fl_count = n;
+    fl_seq = hi + 1;
+  }
+  else if (RTC_valid) {
+    // Empty ring, start on a row picked by the day so short outages after reboots don't all wear row 0
+    fl_head = ((now.unixtime() / 86400) % (FL_SLOTS / FL_ROW_PAGES)) * FL_ROW_PAGES;
+  }
+  LOG_DBG ("FL:%d Held", fl_count);
+}
+
+/*
+ *=======================================================================================================================
+ * fl_down() - SD card missing or down after a failed write, records go to flash
+ *=======================================================================================================================
+ */
+bool fl_down() {
+  return (fl_ok && (!SD_exists || SD_down));
+}
+
+/*
+ *=======================================================================================================================
+ * fl_log() - Add a record to the ring, the oldest row goes when it is full
+ *=======================================================================================================================
+ */
+void fl_log(uint8_t *rec, int len) {
+  uint32_t page[FL_PAGE / 4];
+  FL_SLOT *p = (FL_SLOT *) page;
+
+  if (!fl_ok || (len > (int) sizeof(p->rec))) {
+    return;
+  }
+
+  if ((fl_head % FL_ROW_PAGES) == 0) {
+    fl_nvm((uint32_t) fl_slot(fl_head), NVMCTRL_CTRLA_CMD_ER);
+    if (fl_count > (FL_SLOTS - FL_ROW_PAGES)) {
+      fl_count = FL_SLOTS - FL_ROW_PAGES;  // Oldest records were in that row
+    }
+  }
+
+  memset (page, 0xFF, sizeof(page));
+  p->seq = fl_seq++;
+  p->len = len;
+  memcpy (p->rec, rec, len);
+  fl_write((uint32_t) fl_slot(fl_head), page);
+
+  fl_head = (fl_head + 1) % FL_SLOTS;
+  fl_count++;
+  LOG_DBG ("FL:%d Held", fl_count);
+}
+
+/*
+ *=======================================================================================================================
+ * fl_drain() - Append the backlog to FL_FILE, then erase the rows it came from
+ *=======================================================================================================================
+ */
+void fl_drain() {
+  uint16_t tail = (fl_head + FL_SLOTS - fl_count) % FL_SLOTS;
+  uint16_t slot;
+  const FL_SLOT *p;
+  File fp;
+  bool ok;
+
+  fp = SD.open(FL_FILE, FILE_WRITE);
+  if (!fp) {
+    SD_Fail();
+    ev_note (EV_FL_OPEN, 0);
+    return;
+  }
+  ok = true;
+  for (uint16_t i=0; ok && (i<fl_count); i++) {
+    p = fl_slot((tail + i) % FL_SLOTS);
+    ok = (fp.write(p->rec, p->len) == p->len);
+  }
+  ok = ok && fp.sync();
+  fp.close();
+  if (!ok) {
+    SD_Fail();
+    ev_note (EV_FL_WRITE, 0);
+    return;
+  }
+
+  // Every row holding a drained record, including the write row, whose unused pages are already erased
+  slot = tail - (tail % FL_ROW_PAGES);
+  for (uint16_t i=0; i<(fl_count + (tail % FL_ROW_PAGES) + FL_ROW_PAGES - 1) / FL_ROW_PAGES; i++) {
+    fl_nvm((uint32_t) fl_slot(slot), NVMCTRL_CTRLA_CMD_ER);
+    slot = (slot + FL_ROW_PAGES) % FL_SLOTS;
+  }
+  LOG_INFO ("FL:%d Drained", fl_count);
+  fl_count = 0;
+
+  // The next record gets a new row, the rest of the write row was erased with it
+  fl_head = (fl_head + FL_ROW_PAGES - 1) / FL_ROW_PAGES * FL_ROW_PAGES % FL_SLOTS;
+}
+
+/*
+ *=======================================================================================================================
+ * fl_service() - After an observation, drain once the card takes writes again
+ *=======================================================================================================================
+ */
+void fl_service() {
+  if (!fl_ok) {
+    return;
+  }
+  if (fl_count && !fl_down()) {
+    fl_drain();
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Config Snapshot
+ * ======================================================================================================================
+ */
+#define FL_CF_SIZE        (3 * FL_ROW)              // 768 bytes, 187 values
+#define FL_CF_BASE        (FL_BASE - FL_CF_SIZE)
+#define FL_CF_MAGIC       0x31474643                // "CFG1"
+#define FL_CF_VERSION     2
+#define FL_CF_TABLES      (2 + SG_CAL_MAX * 2 + SS_MAX * SS_FIELDS)  // String keys after the integer ones
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;                           // FL_CF_MAGIC
+  uint16_t version;                         // FL_CF_VERSION
+  uint16_t count;                           // CF_KEY_COUNT
+  uint16_t keys;                            // CRC of the key names
+  uint16_t crc;                             // CRC of size through the tables
+  uint32_t size;                            // CONFIG.TXT bytes
+  uint32_t modified;                        // FAT write date << 16 | time
+  int32_t  value[(FL_CF_SIZE - 20) / 4];    // cf_keys[] values then the sg_cal and ss tables
+} FL_CFSNAP;
+
+uint32_t fl_cf_size = 0;                    // CONFIG.TXT the config in use came from
+uint32_t fl_cf_modified = 0;
+
+/*
+ *=======================================================================================================================
+ * fl_cf_keys() - CRC of the key names, changes with the sketch's config
+ *=======================================================================================================================
+ */
+uint16_t fl_cf_keys() {
+  uint16_t crc = 0;
+
+  for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+    crc = OneWire::crc16((const uint8_t *) cf_keys[i].key, strlen(cf_keys[i].key) + 1, crc);
+  }
+  return (crc);
+}
+
+/*
+ *=======================================================================================================================
+ * fl_cf_crc() - CRC of a snapshot's file stamp and values
+ *=======================================================================================================================
+ */
+uint16_t fl_cf_crc(const FL_CFSNAP *s) {
+  return (OneWire::crc16((const uint8_t *) &s->size, 8 + (s->count + FL_CF_TABLES) * 4, 0));
+}
+
+/*
+ *=======================================================================================================================
+ * fl_cf_tables() - Copy the string keys' tables, sg_cal and ss, to or from a snapshot's values after the keys
+ *=======================================================================================================================
+ */
+void fl_cf_tables(int32_t *t, bool save) {
+  int *n[2] = {&cf_sg_cal_n, &cf_ss_n};
+  int *v[2] = {&cf_sg_cal[0][0], &cf_ss[0][0]};
+  int size[2] = {SG_CAL_MAX * 2, SS_MAX * SS_FIELDS};
+
+  for (int k=0; k<2; k++) {
+    if (save) {
+      *t++ = *n[k];
+      memcpy (t, v[k], size[k] * 4);
+    }
+    else {
+      *n[k] = *t++;
+      memcpy (v[k], t, size[k] * 4);
+    }
+    t += size[k];
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * fl_cf_usable() - Snapshot area is above the sketch
+ *=======================================================================================================================
+ */
+bool fl_cf_usable() {
+  uint32_t end = (uint32_t) &_etext + ((uint32_t) &_erelocate - (uint32_t) &_srelocate);
+
+  return (((CF_KEY_COUNT + FL_CF_TABLES) <= (sizeof(((FL_CFSNAP *) 0)->value) / 4)) && (end <= FL_CF_BASE));
+}
+
+/*
+ *=======================================================================================================================
+ * fl_cf_load() - Config from the snapshot if it is good and, unless any, taken from this size and write time
+ *=======================================================================================================================
+ */
+bool fl_cf_load(uint32_t size, uint32_t modified, bool any) {
+  const FL_CFSNAP *s = (const FL_CFSNAP *) FL_CF_BASE;
+
+  if (!fl_cf_usable() || (s->magic != FL_CF_MAGIC) || (s->version != FL_CF_VERSION) ||
+      (s->count != CF_KEY_COUNT) || (s->keys != fl_cf_keys()) || (s->crc != fl_cf_crc(s))) {
+    return (false);
+  }
+  if (!any && ((modified == 0) || (s->size != size) || (s->modified != modified))) {
+    return (false);
+  }
+  for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+    *cf_keys[i].value = s->value[i];
+  }
+  fl_cf_tables((int32_t *) &s->value[CF_KEY_COUNT], false);
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * fl_cf_save() - Snapshot of the config in use, the flash is left alone when it already holds it
+ *=======================================================================================================================
+ */
+void fl_cf_save(uint32_t size, uint32_t modified) {
+  uint32_t buf[FL_CF_SIZE / 4];
+  FL_CFSNAP *s = (FL_CFSNAP *) buf;
+
+  if (!fl_cf_usable()) {
+    return;
+  }
+  memset (buf, 0xFF, sizeof(buf));
+  s->magic = FL_CF_MAGIC;
+  s->version = FL_CF_VERSION;
+  s->count = CF_KEY_COUNT;
+  s->keys = fl_cf_keys();
+  s->size = size;
+  s->modified = modified;
+  for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+    s->value[i] = *cf_keys[i].value;
+  }
+  fl_cf_tables(&s->value[CF_KEY_COUNT], true);
+  s->crc = fl_cf_crc(s);
+  if (memcmp ((const void *) FL_CF_BASE, buf, sizeof(buf)) == 0) {
+    return;
+  }
+  for (uint32_t a=FL_CF_BASE; a<(FL_CF_BASE + FL_CF_SIZE); a+=FL_ROW) {
+    fl_nvm(a, NVMCTRL_CTRLA_CMD_ER);
+  }
+  for (int p=0; p<(FL_CF_SIZE / FL_PAGE); p++) {
+    fl_write(FL_CF_BASE + p * FL_PAGE, buf + p * (FL_PAGE / 4));
+  }
+  LOG_INFO ("CF:Snapshot Saved");
+}
+
+/*
+ *=======================================================================================================================
+ * fl_config() - Config at boot, from the snapshot while CONFIG.TXT is unchanged, else parsed from the card
+ *=======================================================================================================================
+ */
+void fl_config() {
+  uint32_t size, modified;
+  File fp;
+
+  if (SD_exists && (fp = SD.open(CF_NAME, FILE_READ))) {
+    size = fp.size();
+    modified = fp.modified();
+    fp.close();
+    fl_cf_size = size;
+    fl_cf_modified = modified;
+    if (fl_cf_load(size, modified, false)) {
+      LOG_INFO ("CF:Snapshot %d Keys", CF_KEY_COUNT);
+      return;
+    }
+    SD_ReadConfigFile();
+    fl_cf_save(size, modified);
+    return;
+  }
+  sprintf(msgbuf, "CF:NO %s", CF_NAME); Output (msgbuf);
+  if (fl_cf_load(0, 0, true)) {
+    LOG_INFO ("CF:Snapshot %d Keys", CF_KEY_COUNT);
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * fl_cf_changed() - CONFIG.TXT's directory entry differs from the one the config in use came from
+ *=======================================================================================================================
+ */
+bool fl_cf_changed(uint32_t *size, uint32_t *modified) {
+  File fp;
+
+  if (!SD_exists || SD_down || !(fp = SD.open(CF_NAME, FILE_READ))) {
+    return (false);
+  }
+  *size = fp.size();
+  *modified = fp.modified();
+  fp.close();
+  return ((*size != fl_cf_size) || (*modified != fl_cf_modified));
+}
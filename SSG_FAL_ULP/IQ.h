@@ -0,0 +1,272 @@
+/*
+ * ======================================================================================================================
+ *  IQ.h - I2C DMA Transaction Queue
+ *
+ *  Transactions on the Wire SERCOM are queued and moved by DMA channel DMA_CH_I2C instead of the CPU. The SERCOM is
+ *  the one Wire set up, iq_start_next() only writes ADDR with LENEN so the master sends the address, LEN data bytes
+ *  and then STOP by itself (a NACK and STOP after the last byte of a read). When the block completes DMAC_Handler()
+ *  calls iq_isr(), which waits out the STOP and starts the next transaction, so a queue of OLED pages goes out in the
+ *  background. An address NACK or a bus error gives no DMA completion, iq_poll() finds those and a hung transfer.
+ *
+ *  A transaction is one read or one write with a STOP, at most 255 bytes. The caller owns the IQ_XFER and its buffer
+ *  until status is IQ_OK or IQ_FAIL, iq_wait() waits for it, iq_drain() for the whole queue. Blocking Wire calls
+ *  must not run under the queue, everything that uses Wire directly calls iq_drain() first.
+ *
+ *  Adafruit_I2CDevice (BusIO) hands its reads and writes to iq_busio(). They keep their blocking API and wait their
+ *  turn behind the queue, a write then read gets a STOP between the two, which the Bosch parts, the MCP9808 and
+ *  the DS3231 allow.
+ * ======================================================================================================================
+ */
+#include <Adafruit_I2CDevice.h>
+
+#define IQ_SERCOM         SERCOM3           // Wire on the Feather M0, SDA PA22 SCL PA23
+#define IQ_DMAC_ID_TX     SERCOM3_DMAC_ID_TX
+#define IQ_DMAC_ID_RX     SERCOM3_DMAC_ID_RX
+#define IQ_DEPTH          20                // Queued transactions, an OLED refresh is 2 per page and the start line
+#define IQ_TIMEOUT_MS     50                // 255 bytes at 100kHz is 23ms
+#define IQ_STOP_US        200               // iq_isr() wait for the bus to go idle after the last byte
+#define IQ_BUSIO_MAX      32                // Prefix and data of a BusIO write, copied into iq_busio_buf
+
+#define IQ_IDLE           0                 // Never submitted
+#define IQ_QUEUED         1
+#define IQ_BUSY           2
+#define IQ_OK             3
+#define IQ_FAIL           4
+
+typedef struct {
+  uint8_t addr;                             // 7 bit address
+  bool read;
+  uint8_t len;                              // 1-255 bytes
+  uint8_t *buf;
+  volatile uint8_t status;
+} IQ_XFER;
+
+bool iq_enabled = false;
+IQ_XFER *iq_queue[IQ_DEPTH];
+uint8_t iq_head = 0;                        // Next to start
+volatile uint8_t iq_count = 0;
+IQ_XFER * volatile iq_active = NULL;        // On the bus
+unsigned long iq_start_ms = 0;
+uint32_t iq_fails = 0;
+uint8_t iq_busio_buf[IQ_BUSIO_MAX];
+IQ_XFER iq_busio_x;
+
+/*
+ * ======================================================================================================================
+ * iq_start_next() - Put the next queued transaction on the bus, DMAC interrupt masked or from it
+ * ======================================================================================================================
+ */
+void iq_start_next() {
+  Sercom *s = IQ_SERCOM;
+  IQ_XFER *x;
+
+  if (iq_active || !iq_count) {
+    return;
+  }
+  x = iq_queue[iq_head];
+  iq_head = (iq_head + 1) % IQ_DEPTH;
+  iq_count--;
+
+  iq_active = x;
+  x->status = IQ_BUSY;
+  iq_start_ms = millis();
+  s->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_ERROR;
+  if (x->read) {
+    dma_start(DMA_CH_I2C, IQ_DMAC_ID_RX, DMAC_BTCTRL_BEATSIZE_BYTE,
+      &s->I2CM.DATA.reg, false, x->buf, true, x->len);
+  }
+  else {
+    dma_start(DMA_CH_I2C, IQ_DMAC_ID_TX, DMAC_BTCTRL_BEATSIZE_BYTE,
+      x->buf, true, &s->I2CM.DATA.reg, false, x->len);
+  }
+  s->I2CM.ADDR.reg = SERCOM_I2CM_ADDR_ADDR((x->addr << 1) | x->read) |
+                     SERCOM_I2CM_ADDR_LENEN | SERCOM_I2CM_ADDR_LEN(x->len);
+  while (s->I2CM.SYNCBUSY.bit.SYSOP);
+}
+
+/*
+ * ======================================================================================================================
+ * iq_check() - State of the active transaction, 1 = done, -1 = failed, 0 = still going
+ * ======================================================================================================================
+ */
+int iq_check() {
+  Sercom *s = IQ_SERCOM;
+  uint8_t flags = s->I2CM.INTFLAG.reg;
+  uint16_t status = s->I2CM.STATUS.reg;
+
+  if ((flags & SERCOM_I2CM_INTFLAG_ERROR) || (status & SERCOM_I2CM_STATUS_LENERR) ||
+      ((flags & SERCOM_I2CM_INTFLAG_MB) && (status & SERCOM_I2CM_STATUS_RXNACK))) {
+    return (-1);
+  }
+  if (dma_done[DMA_CH_I2C] &&
+      ((status & SERCOM_I2CM_STATUS_BUSSTATE_Msk) == SERCOM_I2CM_STATUS_BUSSTATE(1))) {
+    return (1);  // Last byte out and STOP sent, bus idle
+  }
+  if ((millis() - iq_start_ms) > IQ_TIMEOUT_MS) {
+    return (-1);
+  }
+  return (0);
+}
+
+/*
+ * ======================================================================================================================
+ * iq_finish() - Retire the active transaction, a failed one is stopped and the bus released
+ * ======================================================================================================================
+ */
+void iq_finish(bool ok) {
+  Sercom *s = IQ_SERCOM;
+
+  if (!ok) {
+    dma_stop(DMA_CH_I2C);
+    s->I2CM.CTRLB.reg |= SERCOM_I2CM_CTRLB_CMD(3);  // STOP
+    while (s->I2CM.SYNCBUSY.bit.SYSOP);
+    iq_fails++;
+  }
+  s->I2CM.INTFLAG.reg = SERCOM_I2CM_INTFLAG_MB | SERCOM_I2CM_INTFLAG_SB | SERCOM_I2CM_INTFLAG_ERROR;
+  iq_active->status = (ok) ? IQ_OK : IQ_FAIL;
+  iq_active = NULL;
+}
+
+/*
+ * ======================================================================================================================
+ * iq_isr() - DMA_CH_I2C block done, from DMAC_Handler()
+ * ======================================================================================================================
+ */
+void iq_isr() {
+  unsigned long start = micros();
+  int r;
+
+  if (!iq_active) {
+    return;
+  }
+  while (!(r = iq_check()) && ((micros() - start) < IQ_STOP_US));
+  if (r) {
+    iq_finish(r > 0);
+    iq_start_next();
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * iq_poll() - Retire a transaction the interrupt could not, start the next
+ * ======================================================================================================================
+ */
+void iq_poll() {
+  int r;
+
+  NVIC_DisableIRQ(DMAC_IRQn);
+  if (iq_active && (r = iq_check())) {
+    iq_finish(r > 0);
+  }
+  iq_start_next();
+  NVIC_EnableIRQ(DMAC_IRQn);
+}
+
+/*
+ * ======================================================================================================================
+ * iq_wait() - Until x is done, true if it went
+ * ======================================================================================================================
+ */
+bool iq_wait(IQ_XFER *x) {
+  while ((x->status == IQ_QUEUED) || (x->status == IQ_BUSY)) {
+    iq_poll();
+  }
+  return (x->status == IQ_OK);
+}
+
+/*
+ * ======================================================================================================================
+ * iq_drain() - Until the queue is empty and the bus is free for Wire
+ * ======================================================================================================================
+ */
+void iq_drain() {
+  while (iq_active || iq_count) {
+    iq_poll();
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * iq_submit() - Queue a transaction, waits for a free slot when the queue is full
+ * ======================================================================================================================
+ */
+bool iq_submit(IQ_XFER *x, uint8_t addr, bool read, uint8_t *buf, uint8_t len) {
+  if (!iq_enabled || !len) {
+    x->status = IQ_FAIL;
+    return (false);
+  }
+  iq_wait(x);  // Still queued from last time
+  while (iq_count >= IQ_DEPTH) {
+    iq_poll();
+  }
+
+  x->addr = addr;
+  x->read = read;
+  x->buf = buf;
+  x->len = len;
+  x->status = IQ_QUEUED;
+
+  NVIC_DisableIRQ(DMAC_IRQn);
+  iq_queue[(iq_head + iq_count) % IQ_DEPTH] = x;
+  iq_count++;
+  iq_start_next();
+  NVIC_EnableIRQ(DMAC_IRQn);
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * iq_write() - Queue len bytes of buf to addr
+ * ======================================================================================================================
+ */
+bool iq_write(IQ_XFER *x, uint8_t addr, const uint8_t *buf, uint8_t len) {
+  return (iq_submit(x, addr, false, (uint8_t *) buf, len));
+}
+
+/*
+ * ======================================================================================================================
+ * iq_read() - Queue a read of len bytes from addr into buf
+ * ======================================================================================================================
+ */
+bool iq_read(IQ_XFER *x, uint8_t addr, uint8_t *buf, uint8_t len) {
+  return (iq_submit(x, addr, true, buf, len));
+}
+
+/*
+ * ======================================================================================================================
+ * iq_busio() - Adafruit_I2CDevice transfer, 1 = done, 0 = failed, -1 = not taken and Wire may be used
+ * ======================================================================================================================
+ */
+int iq_busio(TwoWire *wire, uint8_t addr, const uint8_t *prefix, size_t prefix_len,
+             const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen) {
+  if (wire != &Wire) {
+    return (-1);
+  }
+  if ((prefix_len + wlen) && ((prefix_len + wlen) <= IQ_BUSIO_MAX)) {
+    iq_wait(&iq_busio_x);
+    if (prefix_len) {
+      memcpy (iq_busio_buf, prefix, prefix_len);
+    }
+    memcpy (iq_busio_buf + prefix_len, wbuf, wlen);
+    iq_write(&iq_busio_x, addr, iq_busio_buf, prefix_len + wlen);
+    return (iq_wait(&iq_busio_x));
+  }
+  if (rlen && (rlen <= 255) && !(prefix_len + wlen)) {
+    iq_read(&iq_busio_x, addr, rbuf, rlen);
+    return (iq_wait(&iq_busio_x));
+  }
+  iq_drain();  // Too long, a probe or a bus change, Wire does it
+  return (-1);
+}
+
+/*
+ * ======================================================================================================================
+ * iq_initialize() - Claim the DMA channel and route BusIO devices through the queue
+ * ======================================================================================================================
+ */
+void iq_initialize() {
+  dma_initialize();
+  dma_isr[DMA_CH_I2C] = iq_isr;
+  iq_enabled = true;
+  Adafruit_I2CDevice::setTransfer(iq_busio);
+}
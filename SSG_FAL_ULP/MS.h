@@ -0,0 +1,338 @@
+/*
+ * ======================================================================================================================
+ *  MS.h - USB Mass Storage Service Mode
+ *
+ *  With the SCE_PIN jumper on (calibration mode) the SD card is a read only USB drive on the native USB port, Bulk
+ *  Only Transport with the SCSI commands Windows, macOS and Linux send. Blocks go from Sd2Card::readBlock() straight
+ *  to the bulk IN endpoint, so a season of logs copies off at USB speed with the card left in the enclosure. Our own
+ *  held records are written out and the log closed before the host sees the card.
+ *
+ *  The interface is plugged in and the USB device re-enumerated on the first entry to service mode, so a console on
+ *  the serial port reconnects then. After service mode it stays until reset and reports no medium. Read only, a
+ *  host can neither leave the file system half written under the logger nor delete the logs by mistake.
+ * ======================================================================================================================
+ */
+#define MS_CBW_SIG        0x43425355        // "USBC"
+#define MS_CSW_SIG        0x53425355        // "USBS"
+#define MS_CBW_IN         0x80              // Data stage is device to host
+
+// SCSI sense key, additional sense code
+#define MS_SENSE_NOT_READY       0x02, 0x3A  // Medium not present
+#define MS_SENSE_MEDIUM          0x03, 0x11  // Unrecovered read error
+#define MS_SENSE_ILLEGAL         0x05, 0x20  // Invalid command
+#define MS_SENSE_CHANGED         0x06, 0x28  // Medium may have changed
+#define MS_SENSE_PROTECT         0x07, 0x27  // Write protected
+
+typedef struct __attribute__((packed)) {
+  uint32_t sig;                             // MS_CBW_SIG
+  uint32_t tag;                             // Echoed in the CSW
+  uint32_t len;                             // Bytes the host expects to move
+  uint8_t  flags;                           // MS_CBW_IN
+  uint8_t  lun;
+  uint8_t  cblen;
+  uint8_t  cb[16];                          // SCSI command block
+} MS_CBW;                                   // 31 bytes
+
+typedef struct __attribute__((packed)) {
+  uint32_t sig;                             // MS_CSW_SIG
+  uint32_t tag;
+  uint32_t residue;                         // Bytes of len not moved
+  uint8_t  status;                          // 0 passed, 1 failed
+} MS_CSW;                                   // 13 bytes
+
+/*
+ * ======================================================================================================================
+ *  MS_USB - The interface and its two bulk endpoints, for the core's pluggable USB device
+ * ======================================================================================================================
+ */
+class MS_USB : public PluggableUSBModule {
+  public:
+    MS_USB() : PluggableUSBModule(2, 1, eptype) {
+      eptype[0] = USB_ENDPOINT_TYPE_BULK | USB_ENDPOINT_OUT(0);
+      eptype[1] = USB_ENDPOINT_TYPE_BULK | USB_ENDPOINT_IN(0);
+    }
+    uint8_t ep_out() {
+      return (pluggedEndpoint);
+    }
+    uint8_t ep_in() {
+      return (pluggedEndpoint + 1);
+    }
+
+  protected:
+    uint32_t eptype[2];
+
+    int getInterface(uint8_t *interfaceCount) {
+      struct __attribute__((packed)) {
+        InterfaceDescriptor iface;
+        EndpointDescriptor out;
+        EndpointDescriptor in;
+      } desc = {
+        D_INTERFACE(pluggedInterface, 2, 0x08, 0x06, 0x50),  // Mass storage, SCSI transparent, bulk only
+        D_ENDPOINT(USB_ENDPOINT_OUT(pluggedEndpoint), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0),
+        D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint + 1), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0)
+      };
+      *interfaceCount += 1;
+      return (USBDevice.sendControl(&desc, sizeof(desc)));
+    }
+
+    int getDescriptor(USBSetup &setup) {
+      (void) setup;
+      return (0);
+    }
+
+    bool setup(USBSetup &setup) {
+      uint8_t lun = 0;
+
+      if (setup.wIndex != pluggedInterface) {
+        return (false);
+      }
+      if ((setup.bmRequestType == REQUEST_DEVICETOHOST_CLASS_INTERFACE) && (setup.bRequest == 0xFE)) {
+        USBDevice.sendControl(&lun, 1);  // Get Max LUN, one drive
+        return (true);
+      }
+      if ((setup.bmRequestType == REQUEST_HOSTTODEVICE_CLASS_INTERFACE) && (setup.bRequest == 0xFF)) {
+        return (true);                   // Bulk Only Reset, we keep no state between commands
+      }
+      return (false);
+    }
+};
+
+MS_USB ms_usb;
+
+bool     ms_plugged = false;                // Interface added to the USB device
+bool     ms_ready = false;                  // Service mode, the card is presented
+bool     ms_changed = false;                // Unit attention owed to the host since ms_ready was set
+uint32_t ms_blocks = 0;                     // Card size in 512 byte blocks
+uint8_t  ms_sense_key = 0;                  // Last failure, for REQUEST SENSE
+uint8_t  ms_sense_asc = 0;
+
+/*
+ *=======================================================================================================================
+ * ms_be32() - Big endian SCSI field
+ *=======================================================================================================================
+ */
+uint32_t ms_be32(const uint8_t *p) {
+  return (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3]);
+}
+
+void ms_put32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/*
+ *=======================================================================================================================
+ * ms_fail() - Note the sense for REQUEST SENSE, the command fails
+ *=======================================================================================================================
+ */
+bool ms_fail(uint8_t key, uint8_t asc) {
+  ms_sense_key = key;
+  ms_sense_asc = asc;
+  return (false);
+}
+
+/*
+ *=======================================================================================================================
+ * ms_reply() - Send up to n bytes of a reply, no more than the host asked for
+ *=======================================================================================================================
+ */
+void ms_reply(MS_CBW *cbw, const void *data, uint32_t n, uint32_t *sent) {
+  n = (n < (cbw->len - *sent)) ? n : (cbw->len - *sent);
+  if (n) {
+    USBDevice.send(ms_usb.ep_in(), data, n);
+    *sent += n;
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * ms_read() - READ(10), card blocks go out as they are read
+ *=======================================================================================================================
+ */
+bool ms_read(MS_CBW *cbw, uint32_t *sent) {
+  Sd2Card *card = SdVolume::sdCard();
+  uint8_t *buf = SdVolume::cacheClear();    // The volume's cache, we are its only user while the host has the card
+  uint32_t lba = ms_be32(&cbw->cb[2]);
+  uint16_t n = ((uint16_t) cbw->cb[7] << 8) | cbw->cb[8];
+
+  if ((lba + n) > ms_blocks) {
+    return (ms_fail(MS_SENSE_ILLEGAL));
+  }
+  for (uint16_t i=0; i<n; i++) {
+    wd_feed();
+    if (!card->readBlock(lba + i, buf)) {
+      return (ms_fail(MS_SENSE_MEDIUM));
+    }
+    ms_reply(cbw, buf, 512, sent);
+  }
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ms_command() - Run one SCSI command block, false when it failed
+ *=======================================================================================================================
+ */
+bool ms_command(MS_CBW *cbw, uint32_t *sent) {
+  uint8_t r[36];
+
+  memset (r, 0, sizeof(r));
+  switch (cbw->cb[0]) {
+    case 0x12 :  // INQUIRY
+      r[1] = 0x80;                     // Removable
+      r[2] = 0x04;                     // SPC-2
+      r[3] = 0x02;
+      r[4] = 31;                       // Bytes after this one
+      memcpy (&r[8], "SSG_FAL Gauge SD Card   1.0 ", 28);  // Vendor 8, product 16, revision 4
+      ms_reply(cbw, r, 36, sent);
+      return (true);
+
+    case 0x03 :  // REQUEST SENSE
+      r[0] = 0x70;
+      r[2] = ms_sense_key;
+      r[7] = 10;
+      r[12] = ms_sense_asc;
+      ms_reply(cbw, r, 18, sent);
+      ms_sense_key = ms_sense_asc = 0;
+      return (true);
+
+    case 0x1A :  // MODE SENSE(6)
+      r[0] = 3;
+      r[2] = 0x80;                     // Write protected
+      ms_reply(cbw, r, 4, sent);
+      return (true);
+
+    case 0x5A :  // MODE SENSE(10)
+      r[1] = 6;
+      r[3] = 0x80;
+      ms_reply(cbw, r, 8, sent);
+      return (true);
+
+    case 0x1E :  // PREVENT ALLOW MEDIUM REMOVAL
+    case 0x1B :  // START STOP UNIT
+      return (true);
+  }
+
+  // The rest need the card
+  if (!ms_ready) {
+    return (ms_fail(MS_SENSE_NOT_READY));
+  }
+  if (ms_changed) {
+    ms_changed = false;
+    return (ms_fail(MS_SENSE_CHANGED));  // Host drops what it cached of an earlier card
+  }
+
+  switch (cbw->cb[0]) {
+    case 0x00 :  // TEST UNIT READY
+    case 0x2F :  // VERIFY(10)
+      return (true);
+
+    case 0x25 :  // READ CAPACITY(10)
+      ms_put32(&r[0], ms_blocks - 1);
+      ms_put32(&r[4], 512);
+      ms_reply(cbw, r, 8, sent);
+      return (true);
+
+    case 0x23 :  // READ FORMAT CAPACITIES
+      r[3] = 8;
+      ms_put32(&r[4], ms_blocks);
+      ms_put32(&r[8], 512);            // 3 byte block length, the top byte is the descriptor type
+      r[8] = 0x02;                     // Formatted media
+      ms_reply(cbw, r, 12, sent);
+      return (true);
+
+    case 0x28 :  // READ(10)
+      return (ms_read(cbw, sent));
+
+    case 0x2A :  // WRITE(10)
+      return (ms_fail(MS_SENSE_PROTECT));
+  }
+  return (ms_fail(MS_SENSE_ILLEGAL));
+}
+
+/*
+ *=======================================================================================================================
+ * ms_poll() - Take a command from the host if there is one, answer it and send its status
+ *=======================================================================================================================
+ */
+void ms_poll() {
+  MS_CBW cbw;
+  MS_CSW csw;
+  uint8_t pad[USB_EP_SIZE];
+  uint32_t sent = 0;
+  uint32_t n;
+  bool ok;
+
+  if (USBDevice.available(ms_usb.ep_out()) < sizeof(cbw)) {
+    return;
+  }
+  USBDevice.recv(ms_usb.ep_out(), &cbw, sizeof(cbw));
+  if (cbw.sig != MS_CBW_SIG) {
+    return;  // Out of step, the host resets us
+  }
+
+  ok = ms_command(&cbw, &sent);
+
+  // Finish the data stage the host asked for, zero padded going in, thrown away coming out
+  memset (pad, 0, sizeof(pad));
+  for (uint32_t done=sent; done<cbw.len; done+=n) {
+    n = ((cbw.len - done) < sizeof(pad)) ? (cbw.len - done) : sizeof(pad);
+    wd_feed();
+    if (cbw.flags & MS_CBW_IN) {
+      USBDevice.send(ms_usb.ep_in(), pad, n);
+    }
+    else {
+      while (!USBDevice.available(ms_usb.ep_out()) && USBDevice.connected());
+      n = USBDevice.recv(ms_usb.ep_out(), pad, n);
+      if (!n) {
+        break;
+      }
+    }
+  }
+
+  csw.sig = MS_CSW_SIG;
+  csw.tag = cbw.tag;
+  csw.residue = cbw.len - sent;
+  csw.status = (ok) ? 0 : 1;
+  USBDevice.send(ms_usb.ep_in(), &csw, sizeof(csw));
+}
+
+/*
+ *=======================================================================================================================
+ * ms_begin() - Enter service mode, write out what we hold and give the card to the host
+ *=======================================================================================================================
+ */
+void ms_begin() {
+  if (ms_ready || !SD_exists || SD_down) {
+    return;
+  }
+  SD_Close();
+  SD_WriteWait();
+  ms_blocks = SdVolume::sdCard()->cardSize();
+  if (ms_blocks == 0) {
+    return;
+  }
+  ms_ready = true;
+  ms_changed = true;
+  if (!ms_plugged) {
+    ms_plugged = PluggableUSB().plug(&ms_usb);
+    USBDevice.detach();  // Host enumerates again and finds the drive
+    delay (100);
+    USBDevice.attach();
+  }
+  Output ("MS:USB Drive");
+}
+
+/*
+ *=======================================================================================================================
+ * ms_end() - Leave service mode, the host sees no medium again
+ *=======================================================================================================================
+ */
+void ms_end() {
+  if (ms_ready) {
+    ms_ready = false;
+    Output ("MS:USB Off");
+  }
+}
@@ -0,0 +1,183 @@
+/*
+ * ======================================================================================================================
+ *  NS.h - Need to Send Queue
+ *
+ *  With n2s=1 every logged observation is also appended to NS_FILE, one JSON line each, for whatever sends them
+ *  on: a radio module, or the sh "n2s send" command for a data mule on the USB console. With n2s=2 the queue holds
+ *  the binary records (OBS_BINREC) instead, each after a length byte, for the telemetry module (TL.h).
+ *
+ *  The read cursor is the byte offset of the oldest unsent entry, kept in NS_PTR_FILE with its complement, so
+ *  taking entries off never rewrites the queue. ns_peek() reads the entry at the cursor, ns_pop() moves the cursor
+ *  past the entries that were sent. When the cursor reaches the end both files are removed and the queue starts
+ *  again empty. SSB_N2S is set while there are entries to send.
+ * ======================================================================================================================
+ */
+#define NS_FILE           "/OBS/N2S.TXT"
+#define NS_PTR_FILE       "/OBS/N2S.PTR"
+#define NS_JSON           1         // cf_n2s, JSON lines
+#define NS_BIN            2         // Length byte and binary record
+
+uint32_t ns_cursor = 0;             // Offset of the oldest unsent line
+uint32_t ns_size = 0;               // Bytes in NS_FILE
+bool ns_loaded = false;             // Cursor and size read from the card
+
+/*
+ *=======================================================================================================================
+ * ns_status() - SSB_N2S follows the queue
+ *=======================================================================================================================
+ */
+void ns_status() {
+  if (ns_cursor < ns_size) {
+    SystemStatusBits |= SSB_N2S;
+  }
+  else {
+    SystemStatusBits &= ~SSB_N2S;
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * ns_load() - Cursor and size of the queue left from before the reboot, false without a card
+ *=======================================================================================================================
+ */
+bool ns_load() {
+  uint32_t ptr[2];
+  File fp;
+
+  if (!SD_exists || SD_down) {
+    return (false);
+  }
+  if (ns_loaded) {
+    return (true);
+  }
+  ns_cursor = 0;
+  ns_size = 0;
+  fp = SD.open(NS_FILE, FILE_READ);
+  if (fp) {
+    ns_size = fp.size();
+    fp.close();
+  }
+  fp = SD.open(NS_PTR_FILE, FILE_READ);
+  if (fp) {
+    if ((fp.read((uint8_t *) ptr, sizeof(ptr)) == sizeof(ptr)) && (ptr[0] == ~ptr[1]) && (ptr[0] <= ns_size)) {
+      ns_cursor = ptr[0];
+    }
+    fp.close();
+  }
+  ns_loaded = true;
+  ns_status();
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ns_initialize() - Find the queue at boot
+ *=======================================================================================================================
+ */
+void ns_initialize() {
+  if (cf_n2s && ns_load() && (ns_cursor < ns_size)) {
+    LOG_INFO ("N2S:%lu Bytes", ns_size - ns_cursor);
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * ns_enqueue() - Append a record of the queue's kind to it
+ *=======================================================================================================================
+ */
+void ns_enqueue(int kind, const uint8_t *rec, int len) {
+  uint8_t n = len;
+  File fp;
+
+  if ((cf_n2s != kind) || (len > 255) || !ns_load()) {
+    return;
+  }
+  fp = SD.open(NS_FILE, FILE_WRITE);
+  if (!fp) {
+    Output ("N2S:Open Err");
+    return;
+  }
+  if (kind == NS_BIN) {
+    fp.write(&n, 1);
+    fp.write(rec, len);
+  }
+  else {
+    fp.write(rec, len);
+    fp.write((const uint8_t *) "\r\n", 2);
+  }
+  ns_size = fp.size();
+  fp.close();
+  ns_status();
+}
+
+/*
+ *=======================================================================================================================
+ * ns_peek() - Entry at offset from the cursor into buf, a line without its ending or a binary record (*len bytes).
+ *   Returns the bytes it takes in the queue, 0 if none.
+ *=======================================================================================================================
+ */
+int ns_peek(uint32_t offset, char *buf, int size, int *len) {
+  uint8_t n = 0;
+  int used;
+  File fp;
+
+  buf[0] = 0;
+  *len = 0;
+  if (!ns_load() || ((ns_cursor + offset) >= ns_size)) {
+    return (0);
+  }
+  fp = SD.open(NS_FILE, FILE_READ);
+  if (!fp) {
+    return (0);
+  }
+  fp.seek(ns_cursor + offset);
+  if (cf_n2s == NS_BIN) {
+    if ((fp.read(&n, 1) != 1) || (n > size) || (fp.read((uint8_t *) buf, n) != n)) {
+      n = 0;  // Cut short by a reset, the rest of the queue is taken as sent
+    }
+    fp.close();
+    *len = n;
+    return ((n) ? n + 1 : ns_size - ns_cursor - offset);
+  }
+  *len = fp.readBytesUntil('\n', buf, size - 1);
+  fp.close();
+  used = *len + 1;
+  buf[*len] = 0;
+  if ((*len > 0) && (buf[*len - 1] == '\r')) {
+    buf[--(*len)] = 0;
+  }
+  return (used);
+}
+
+/*
+ *=======================================================================================================================
+ * ns_pop() - Lines of n bytes at the cursor were sent
+ *=======================================================================================================================
+ */
+void ns_pop(uint32_t n) {
+  uint32_t ptr[2];
+  File fp;
+
+  if (!ns_load() || (n == 0)) {
+    return;
+  }
+  ns_cursor = ((ns_cursor + n) < ns_size) ? ns_cursor + n : ns_size;
+  if (ns_cursor == ns_size) {
+    // Drained, start again empty
+    SD.remove(NS_FILE);
+    SD.remove(NS_PTR_FILE);
+    ns_cursor = 0;
+    ns_size = 0;
+  }
+  else {
+    ptr[0] = ns_cursor;
+    ptr[1] = ~ns_cursor;
+    fp = SD.open(NS_PTR_FILE, O_READ | O_WRITE | O_CREAT);
+    if (fp) {
+      fp.seek(0);
+      fp.write((const uint8_t *) ptr, sizeof(ptr));
+      fp.close();
+    }
+  }
+  ns_status();
+}
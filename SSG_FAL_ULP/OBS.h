@@ -6,135 +6,1270 @@
 
 /*
  * ======================================================================================================================
- * OBS_Do() - Collect Observations, Build message, Send to logging site
+ *  Binary Observation Record - Fixed layout, little endian, logged to /OBS/YYYYMMDD.bin when sd_bin is set.
+ *    Values are the ones the JSON record prints, scaled by 100 and truncated. A value that does not fit in
+ *    16 bits (QC error values) is stored as OBS_BIN_ERR. Flags are the presence bitmap of the sections, a daily
+ *    .bin starts with the schema header SD_BINHDR (SDC.h) naming the record type that follows. The record ends
+ *    with the CRC32 of the bytes before it (dsu_crc32() in SF.h), so a torn write or a bad flash page is found
+ *    wherever it was kept. tools/obsbin2json.py turns a .bin file back into the JSON lines of the .log file.
  * ======================================================================================================================
  */
-void OBS_Do (bool log_obs) {
-  float bmx1_pressure = 0.0;
-  float bmx1_temp = 0.0;
-  float bmx1_humid = 0.0;
-  float bmx2_pressure = 0.0;
-  float bmx2_temp = 0.0;
-  float bmx2_humid = 0.0;
-  float mcp1_temp = 0.0;
-  float batt = 0.0;
-  int msgLength;
-  unsigned short checksum;
+#define OBS_BIN_TYPE      5         // Record layout version, 1 = single dt1 probe (38 bytes), 2 = no mt2 (53 bytes),
+                                    // 3 = no crc (55 bytes), 4 = hth 0x40 and 0x200 unused (AS5600, HTU21DF)
+                                    // and otherwise the layout of 5
+#define OBS_BIN_ERR       -32768    // Value out of range for 16 bits
 
-  // Safty Check for Vaild Time
-  if (!RTC_valid) {
-    Output ("OBS_Do: Time NV");
+#define OBS_BIN_F_STREAM  0x01      // sgmin, sgmax, sgiqr
+#define OBS_BIN_F_BMX_1   0x02      // bp1, bt1, bh1
+#define OBS_BIN_F_BMX_2   0x04      // bp2, bt2, bh2
+#define OBS_BIN_F_MCP_1   0x08      // mt1
+#define OBS_BIN_F_DS      0x10      // dt1..dtN
+#define OBS_BIN_F_MCP_2   0x20      // mt2
+#define OBS_BIN_F_LATE    0x40      // Observed late in its slot, TM.h
+#define OBS_BIN_F_BV      0x80      // bv, read this observation (bv_every), always there before type 5
+
+typedef struct __attribute__((packed)) {
+  uint8_t  type;                    // OBS_BIN_TYPE
+  uint8_t  flags;                   // OBS_BIN_F_*
+  uint32_t at;                      // Unix time
+  int16_t  sg;                      // Gauge median mm
+  int16_t  sgmin;                   // mm
+  int16_t  sgmax;                   // mm
+  int16_t  sgiqr;                   // mm
+  int32_t  bp1;                     // hPa * 100
+  int16_t  bt1;                     // deg C * 100
+  int16_t  bh1;                     // % * 100
+  int32_t  bp2;
+  int16_t  bt2;
+  int16_t  bh2;
+  int16_t  mt1;                     // deg C * 100
+  int16_t  mt2;
+  int16_t  bv;                      // V * 100
+  uint16_t hth;                     // SystemStatusBits
+  uint8_t  dtn;                     // Probes in dt[]
+  int16_t  dt[DS_MAX_PROBES];       // deg C * 100
+  uint32_t crc;                     // CRC32 of the above
+} OBS_BINREC;                       // 59 bytes
+
+OBS_BINREC obs_binrec;
+
+/*
+ * ======================================================================================================================
+ * OBS_fp16() - Fixed point value * 100 as the JSON record truncates it, OBS_BIN_ERR when it does not fit
+ * ======================================================================================================================
+ */
+int16_t OBS_fp16(int32_t v) {
+  long l = v / (FIX_ONE / 100);
+  return ((l < -32767 || l > 32767) ? OBS_BIN_ERR : (int16_t) l);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_bin_crc() - CRC32 of a binary record, what its crc should be
+ * ======================================================================================================================
+ */
+uint32_t OBS_bin_crc(const OBS_BINREC *r) {
+  return (dsu_crc32(r, offsetof(OBS_BINREC, crc), 0));
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_bin_build() - Binary record of the observation just taken, from the values its JSON record printed
+ * ======================================================================================================================
+ */
+void OBS_bin_build(OBS_BINREC *r, int sg, int batt, bool bv, bool late) {
+  SENSOR *s;
+
+  memset (r, 0, sizeof(OBS_BINREC));
+  r->type = OBS_BIN_TYPE;
+  r->at = now.unixtime();
+  r->sg = sg;
+  if (cf_sg_stream) {
+    r->flags |= OBS_BIN_F_STREAM;
+    r->sgmin = s_gauge_mm(sg_min);
+    r->sgmax = s_gauge_mm(sg_max);
+    r->sgiqr = s_gauge_span_mm(sg_iqr);
+  }
+  s = &sn_table[SN_BMX_1];
+  if (*s->exists && !s->skipped) {
+    r->flags |= OBS_BIN_F_BMX_1;
+    r->bp1 = s->value[0] / (FIX_ONE / 100);
+    r->bt1 = OBS_fp16(s->value[1]);
+    r->bh1 = OBS_fp16(s->value[2]);
+  }
+  s = &sn_table[SN_BMX_2];
+  if (*s->exists && !s->skipped) {
+    r->flags |= OBS_BIN_F_BMX_2;
+    r->bp2 = s->value[0] / (FIX_ONE / 100);
+    r->bt2 = OBS_fp16(s->value[1]);
+    r->bh2 = OBS_fp16(s->value[2]);
+  }
+  s = &sn_table[SN_MCP_1];
+  if (*s->exists && !s->skipped) {
+    r->flags |= OBS_BIN_F_MCP_1;
+    r->mt1 = OBS_fp16(s->value[0]);
+  }
+  s = &sn_table[SN_MCP_2];
+  if (*s->exists && !s->skipped) {
+    r->flags |= OBS_BIN_F_MCP_2;
+    r->mt2 = OBS_fp16(s->value[0]);
+  }
+  if (ds_found && !sn_table[SN_DS_1].skipped) {
+    r->flags |= OBS_BIN_F_DS;
+    r->dtn = ds_count;
+    for (int p=0; p<ds_count; p++) {
+      r->dt[p] = OBS_fp16(ds_reading[p]);
+    }
+  }
+  if (bv) {
+    r->flags |= OBS_BIN_F_BV;
+    r->bv = batt / 10;
+  }
+  r->hth = SystemStatusBits;
+  if (late) {
+    r->flags |= OBS_BIN_F_LATE;
+  }
+  r->crc = OBS_bin_crc(r);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_bin_fix() - Fixed point of a value the record holds * 100, the QC error value for OBS_BIN_ERR
+ * ======================================================================================================================
+ */
+int32_t OBS_bin_fix(int32_t v100) {
+  return ((v100 == OBS_BIN_ERR) ? QC_FIX(QC_ERR_T) : v100 * (FIX_ONE / 100));
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_bin_json() - A binary record as the JSON line tools/obsbin2json.py makes of it
+ * ======================================================================================================================
+ */
+void OBS_bin_json(const OBS_BINREC *r, char *buf, int size) {
+  DateTime t(r->at);
+  JSONBUF jb;
+  char at[20];
+  char key[8];
+
+  sprintf (at, "%d-%02d-%02dT%02d:%02d:%02d", t.year(), t.month(), t.day(), t.hour(), t.minute(), t.second());
+  jb_init(&jb, buf, size);
+  jb_str(&jb, "at", at);
+  jb_int(&jb, "sg", r->sg);
+  if (r->flags & OBS_BIN_F_STREAM) {
+    jb_int(&jb, "sgmin", r->sgmin);
+    jb_int(&jb, "sgmax", r->sgmax);
+    jb_int(&jb, "sgiqr", r->sgiqr);
+  }
+  if (r->flags & OBS_BIN_F_BMX_1) {
+    jb_fixed(&jb, "bp1", r->bp1 * (FIX_ONE / 100), 4);
+    jb_fixed(&jb, "bt1", OBS_bin_fix(r->bt1), 2);
+    jb_fixed(&jb, "bh1", OBS_bin_fix(r->bh1), 2);
+  }
+  if (r->flags & OBS_BIN_F_BMX_2) {
+    jb_fixed(&jb, "bp2", r->bp2 * (FIX_ONE / 100), 4);
+    jb_fixed(&jb, "bt2", OBS_bin_fix(r->bt2), 2);
+    jb_fixed(&jb, "bh2", OBS_bin_fix(r->bh2), 2);
+  }
+  if (r->flags & OBS_BIN_F_MCP_1) {
+    jb_fixed(&jb, "mt1", OBS_bin_fix(r->mt1), 4);
+  }
+  if (r->flags & OBS_BIN_F_MCP_2) {
+    jb_fixed(&jb, "mt2", OBS_bin_fix(r->mt2), 4);
+  }
+  for (int p=0; (r->flags & OBS_BIN_F_DS) && (p<r->dtn); p++) {
+    sprintf (key, "dt%d", p+1);
+    jb_fixed(&jb, key, OBS_bin_fix(r->dt[p]), 4);
+  }
+  if (r->flags & OBS_BIN_F_BV) {
+    jb_fixed(&jb, "bv", OBS_bin_fix(r->bv), 2);
+  }
+  if (r->flags & OBS_BIN_F_LATE) {
+    jb_int(&jb, "late", 1);
+  }
+  jb_int(&jb, "hth", r->hth);
+  jb_close(&jb);
+}
+
+/*
+ * ======================================================================================================================
+ *  Delta Log - With sd_delta=1 each binary record is also logged to /OBS/YYYYMMDD.dlt as a keyframe or a delta.
+ *    Fields are sg sgmin sgmax sgiqr bp1 bt1 bh1 bp2 bt2 bh2 mt1 mt2 bv hth dt1..dtN of OBS_BINREC, each as a
+ *    zig-zag varint (LEB128 of (v << 1) ^ (v >> 31)).
+ *
+ *      Keyframe  0x80 | at varint | interval s varint | flags | dtn | fields
+ *      Delta     slots (1-127) | jitter varint | field - previous field, per field
+ *
+ *    A delta's time is the last record's plus slots * interval plus jitter, which is 0 while the awake time before
+ *    the timestamp does not change. A keyframe starts each hour, a new file, and follows a change of interval,
+ *    flags or probe count, a reboot or records lost with the card. tools/obsdelta2json.py turns a .dlt back into
+ *    the JSON lines of the .log, to the precision of the binary record.
+ * ======================================================================================================================
+ */
+#define OBS_DL_KEY        0x80
+#define OBS_DL_SLOTS      127               // Most slots a delta can skip
+#define OBS_DL_FIELDS     (14 + DS_MAX_PROBES)
+#define OBS_DL_MAX        (8 + 5 * (2 + OBS_DL_FIELDS))  // Bytes of the longest record
+
+OBS_BINREC obs_dl_prev;                     // Last record logged
+uint32_t obs_dl_interval = 0;               // obs_interval_s at the last record
+
+/*
+ * ======================================================================================================================
+ * obs_dl_varint() - Append v as a zig-zag LEB128 varint, return bytes
+ * ======================================================================================================================
+ */
+int obs_dl_varint(uint8_t *p, int32_t v) {
+  uint32_t z = ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+  int n = 0;
+
+  while (z >= 0x80) {
+    p[n++] = (z & 0x7F) | 0x80;
+    z >>= 7;
+  }
+  p[n++] = z;
+  return (n);
+}
+
+/*
+ * ======================================================================================================================
+ * obs_dl_fields() - Fields of a record in file order, return how many
+ * ======================================================================================================================
+ */
+int obs_dl_fields(const OBS_BINREC *r, int32_t *v) {
+  int n = 0;
+
+  v[n++] = r->sg;
+  v[n++] = r->sgmin;
+  v[n++] = r->sgmax;
+  v[n++] = r->sgiqr;
+  v[n++] = r->bp1;
+  v[n++] = r->bt1;
+  v[n++] = r->bh1;
+  v[n++] = r->bp2;
+  v[n++] = r->bt2;
+  v[n++] = r->bh2;
+  v[n++] = r->mt1;
+  v[n++] = r->mt2;
+  v[n++] = r->bv;
+  v[n++] = r->hth;
+  for (int p=0; p<r->dtn; p++) {
+    v[n++] = r->dt[p];
+  }
+  return (n);
+}
+
+/*
+ * ======================================================================================================================
+ * obs_dl_encode() - Encode r against prev at interval s into buf, a keyframe when key or the rules above ask for one,
+ *   return bytes. Shared with the archiver (AR.h).
+ * ======================================================================================================================
+ */
+int obs_dl_encode(uint8_t *buf, const OBS_BINREC *r, const OBS_BINREC *prev, uint32_t interval, bool key) {
+  int32_t v[OBS_DL_FIELDS];
+  int32_t pv[OBS_DL_FIELDS];
+  int32_t slots = 0;
+  int len = 0;
+  int n = obs_dl_fields(r, v);
+
+  key = key || (r->flags != prev->flags) || (r->dtn != prev->dtn) || ((r->at / 3600) != (prev->at / 3600)) ||
+        (r->at <= prev->at);
+  if (!key) {
+    slots = (r->at - prev->at + interval / 2) / interval;
+    key = (slots < 1) || (slots > OBS_DL_SLOTS);
+  }
+  if (key) {
+    buf[len++] = OBS_DL_KEY;
+    len += obs_dl_varint(buf + len, r->at);            // Unsigned below 2^31 until 2038, same bytes
+    len += obs_dl_varint(buf + len, interval);
+    buf[len++] = r->flags;
+    buf[len++] = r->dtn;
+    for (int k=0; k<n; k++) {
+      len += obs_dl_varint(buf + len, v[k]);
+    }
+  }
+  else {
+    obs_dl_fields(prev, pv);
+    buf[len++] = slots;
+    len += obs_dl_varint(buf + len, (int32_t) (r->at - prev->at - slots * interval));
+    for (int k=0; k<n; k++) {
+      len += obs_dl_varint(buf + len, v[k] - pv[k]);
+    }
+  }
+  return (len);
+}
+
+/*
+ * ======================================================================================================================
+ * obs_delta() - Encode a record against the last one and log it
+ * ======================================================================================================================
+ */
+void obs_delta(const OBS_BINREC *r) {
+  uint8_t buf[OBS_DL_MAX];
+  int len = obs_dl_encode(buf, r, &obs_dl_prev, obs_interval_s, SD_db_key || (obs_dl_interval != obs_interval_s));
+
+  if (SD_LogDelta(buf, len)) {
+    SD_db_key = false;
+    obs_dl_prev = *r;
+    obs_dl_interval = obs_interval_s;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * obs_burst() - Enter or leave the gauge level event burst schedule, next slot counted from the one just observed
+ * ======================================================================================================================
+ */
+void obs_burst(bool on) {
+  sg_burst = on;
+  sg_burst_quiet = 0;
+  if (on) {
+    SystemStatusBits |= SSB_SG_BURST;
+  }
+  else {
+    SystemStatusBits &= ~SSB_SG_BURST;
+  }
+  obs_interval_s = (uint32_t) ((on) ? cf_sg_burst : pwr_minutes(pwr_profile)) * 60;
+  if (obs_slot_epoch) {
+    obs_next_epoch = (obs_slot_epoch / obs_interval_s + 1) * obs_interval_s;
+  }
+  LOG_INFO ("SG:Burst %s %dm", (on) ? "ON" : "OFF", (int) (obs_interval_s / 60));
+}
+
+/*
+ * ======================================================================================================================
+ * obs_burst_update() - After a logged observation, leave the burst schedule once the level has settled
+ * ======================================================================================================================
+ */
+void obs_burst_update(unsigned int mm) {
+  unsigned int change = (mm > sg_event_mm) ? mm - sg_event_mm : sg_event_mm - mm;
+
+  if (sg_burst) {
+    sg_burst_quiet = (change < (unsigned int) cf_sg_event) ? sg_burst_quiet + 1 : 0;
+    if (sg_burst_quiet >= cf_sg_burst_n) {
+      obs_burst(false);
+    }
+  }
+  sg_event_mm = mm;
+}
+
+/*
+ * ======================================================================================================================
+ *  Gauge Spike QC - With sg_qc set the gauge median is checked against a ring of the last OBS_QC_N accepted values
+ *    before it is used. A Hampel test flags it when it is further from the ring's median than 3 scaled MADs
+ *    (1.4826 * MAD, about 4.45 MAD) or sg_qc_mm, whichever is more, a rate test when it moved from the last
+ *    accepted value more than sg_qc_mm plus sg_qc_roc mm per hour since. The record gets "sgqc", 1 Hampel, 2 rate,
+ *    3 both. sg_qc=2 also logs the ring's median in its place and the reading as "sgraw". A spike is not taken
+ *    into the ring, a step that stays for OBS_QC_N / 2 observations in a row is real and starts the ring again.
+ *    The ring is a fixed handful of values, so the cost is the same each observation.
+ * ======================================================================================================================
+ */
+#define OBS_QC_N          7                 // Accepted values kept
+#define OBS_QC_FLAG       1                 // sg_qc, flag only
+#define OBS_QC_REPLACE    2                 // Flag and log the median
+
+int16_t  obs_qc_ring[OBS_QC_N];
+int      obs_qc_n = 0;                      // Values in the ring
+int      obs_qc_pos = 0;                    // Where the next one goes
+uint32_t obs_qc_at = 0;                     // Time of the last accepted value
+int16_t  obs_qc_last = 0;
+int      obs_qc_run = 0;                    // Flagged in a row
+int      obs_qc_raw = 0;                    // Reading a replaced value came from
+
+/*
+ * ======================================================================================================================
+ * obs_qc_median() - Median of n values, sorted in place
+ * ======================================================================================================================
+ */
+int obs_qc_median(int *v, int n) {
+  int x, j;
+
+  for (int i=1; i<n; i++) {
+    x = v[i];
+    for (j=i; (j > 0) && (v[j-1] > x); j--) {
+      v[j] = v[j-1];
+    }
+    v[j] = x;
+  }
+  return ((n & 1) ? v[n/2] : (v[n/2 - 1] + v[n/2]) / 2);
+}
+
+/*
+ * ======================================================================================================================
+ * obs_qc_accept() - Take a value into the ring
+ * ======================================================================================================================
+ */
+void obs_qc_accept(uint32_t at, int mm) {
+  obs_qc_ring[obs_qc_pos] = mm;
+  obs_qc_pos = (obs_qc_pos + 1) % OBS_QC_N;
+  obs_qc_n = (obs_qc_n < OBS_QC_N) ? obs_qc_n + 1 : OBS_QC_N;
+  obs_qc_at = at;
+  obs_qc_last = mm;
+}
+
+/*
+ * ======================================================================================================================
+ * obs_sg_qc() - Check the gauge median, return the sgqc flags, *mm is replaced with sg_qc=2
+ * ======================================================================================================================
+ */
+int obs_sg_qc(uint32_t at, int *mm) {
+  int v[OBS_QC_N];
+  int med, mad, dev, limit, flags = 0;
+
+  obs_qc_raw = *mm;
+  if (*mm <= 0) {
+    return (0);  // No reading
+  }
+  if (obs_qc_n < 3) {
+    obs_qc_accept(at, *mm);
+    return (0);
+  }
+
+  for (int i=0; i<obs_qc_n; i++) {
+    v[i] = obs_qc_ring[i];
+  }
+  med = obs_qc_median(v, obs_qc_n);
+  for (int i=0; i<obs_qc_n; i++) {
+    v[i] = abs(v[i] - med);
+  }
+  mad = obs_qc_median(v, obs_qc_n);
+  limit = mad * 4448 / 1000;
+  limit = (limit > cf_sg_qc_mm) ? limit : cf_sg_qc_mm;
+  if (abs(*mm - med) > limit) {
+    flags |= 1;
+  }
+  dev = abs(*mm - obs_qc_last);
+  if (cf_sg_qc_roc && (dev > cf_sg_qc_mm + (int) (((at - obs_qc_at) * cf_sg_qc_roc) / 3600))) {
+    flags |= 2;
+  }
+
+  if (flags == 0) {
+    obs_qc_run = 0;
+    obs_qc_accept(at, *mm);
+    return (0);
+  }
+  if (++obs_qc_run > OBS_QC_N / 2) {
+    // The step stayed, the surface moved: start over from it
+    obs_qc_n = 0;
+    obs_qc_pos = 0;
+    obs_qc_run = 0;
+    obs_qc_accept(at, *mm);
+    LOG_INFO ("SG:QC Step %d->%d", med, *mm);
+    return (0);
+  }
+  if (cf_sg_qc == OBS_QC_REPLACE) {
+    *mm = med;
+  }
+  return (flags);
+}
+
+/*
+ * ======================================================================================================================
+ *  Deadband Logging - With obs_db_sg or obs_db_t set an observation goes to the SD card only when a gauge channel
+ *    moved obs_db_sg mm or a temperature (bt, mt, dt) moved obs_db_t tenths of a degree from the last logged one,
+ *    when hth or the set of sensors changed, or when obs_hb minutes have passed. Skipped observations still run the
+ *    power profile and burst logic and go to the console. The next logged record has "skn" skipped and the gauge
+ *    range over them as "sglo" "sghi".
+ * ======================================================================================================================
+ */
+#define OBS_DB_TEMPS      (4 + DS_MAX_PROBES)      // bt1 bt2 mt1 mt2 dt1..dtN
+
+bool obs_db_valid = false;          // Something logged since boot
+uint32_t obs_db_at = 0;             // Unix time of the last logged observation
+unsigned int obs_db_sg[SG_CHANS_MAX];
+int32_t obs_db_t[OBS_DB_TEMPS];
+int obs_db_tn = 0;
+unsigned int obs_db_hth = 0;
+unsigned int obs_skip_n = 0;        // Skipped since the last logged observation
+unsigned int obs_skip_lo = 0;
+unsigned int obs_skip_hi = 0;
+
+/*
+ * ======================================================================================================================
+ * obs_db_temps() - Temperatures of this observation, return how many
+ * ======================================================================================================================
+ */
+int obs_db_temps(int32_t *t) {
+  SENSOR *s;
+  int n = 0;
+
+  for (int i=0; i<SN_COUNT; i++) {
+    s = &sn_table[i];
+    if (*s->exists && (s->kind == SN_BMX || s->kind == SN_MCP)) {
+      t[n++] = s->value[(s->kind == SN_BMX) ? 1 : 0];
+    }
+  }
+  for (int p=0; p<ds_count; p++) {
+    t[n++] = ds_reading[p];
+  }
+  return (n);
+}
+
+/*
+ * ======================================================================================================================
+ * obs_db_changed() - Log this observation? Keeps it as the new reference when so, else counts it as skipped.
+ * ======================================================================================================================
+ */
+bool obs_db_changed(uint32_t at, unsigned int sg) {
+  int32_t t[OBS_DB_TEMPS];
+  int32_t dt = (int32_t) cf_obs_db_t * (FIX_ONE / 10);
+  int tn = obs_db_temps(t);
+  bool log = !obs_db_valid || (tn != obs_db_tn) || (SystemStatusBits != obs_db_hth) ||
+             ((cf_obs_hb > 0) && ((at - obs_db_at) >= ((uint32_t) cf_obs_hb * 60)));
+
+  sg_chan_mm[0] = sg;  // Not set by every gauge backend
+  for (int c=0; !log && cf_obs_db_sg && (c<sg_chans); c++) {
+    log = (((sg_chan_mm[c] > obs_db_sg[c]) ? sg_chan_mm[c] - obs_db_sg[c] : obs_db_sg[c] - sg_chan_mm[c])
+           >= (unsigned int) cf_obs_db_sg);
+  }
+  for (int k=0; !log && cf_obs_db_t && (k<tn); k++) {
+    log = (((t[k] > obs_db_t[k]) ? t[k] - obs_db_t[k] : obs_db_t[k] - t[k]) >= dt);
+  }
+
+  if (!log) {
+    obs_skip_lo = (!obs_skip_n || (sg < obs_skip_lo)) ? sg : obs_skip_lo;
+    obs_skip_hi = (!obs_skip_n || (sg > obs_skip_hi)) ? sg : obs_skip_hi;
+    obs_skip_n++;
+    return (false);
+  }
+
+  obs_db_valid = true;
+  obs_db_at = at;
+  obs_db_tn = tn;
+  obs_db_hth = SystemStatusBits;
+  memcpy (obs_db_sg, sg_chan_mm, sizeof(obs_db_sg));
+  memcpy (obs_db_t, t, sizeof(int32_t) * tn);
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ *  Adaptive Cadence - With obs_fast set the interval follows the weather. Each observation, deadband skipped ones
+ *    too, is compared with the one before it: the gauge median, after spike QC, moving obs_fast_mm mm an hour or a
+ *    temperature obs_fast_t deg C * 10 an hour steps straight to obs_fast minutes. Then OBS_CAD_STEADY observations
+ *    in a row under both double the interval, to the next one that divides a day, up to obs_slow. Time spent at
+ *    obs_slow in steady weather pays for the fast observations. NORMAL profile only and never faster than pwr_until
+ *    allows, the burst schedule of a level event comes first. The record gets "cad", the minutes it was taken at.
+ * ======================================================================================================================
+ */
+#define OBS_CAD_STEADY    2
+
+bool obs_cad_valid = false;         // Last observation kept to compare with
+uint32_t obs_cad_at = 0;
+unsigned int obs_cad_sg = 0;
+int32_t obs_cad_t[OBS_DB_TEMPS];
+int obs_cad_tn = 0;
+int obs_cad_steady = 0;             // Observations in a row under both rates
+
+/*
+ * ======================================================================================================================
+ * obs_cad_set() - Change the cadence, next slot counted from the one just observed
+ * ======================================================================================================================
+ */
+void obs_cad_set(int minutes) {
+  obs_cadence = (minutes == cf_obs_interval) ? 0 : minutes;
+  obs_cad_steady = 0;
+  pwr_apply(pwr_profile);
+  LOG_INFO ("OBS:Cadence %dm", (int) (obs_interval_s / 60));
+}
+
+/*
+ * ======================================================================================================================
+ * obs_cad_update() - After an observation, step to obs_fast on a fast change or back off when steady
+ * ======================================================================================================================
+ */
+void obs_cad_update(uint32_t at, unsigned int sg) {
+  int32_t t[OBS_DB_TEMPS];
+  int tn = obs_db_temps(t);
+  uint32_t dt = at - obs_cad_at;
+  int32_t err = QC_FIX(QC_ERR_T);
+  int64_t d;
+  bool fast = false;
+  int cur, slow, i;
+
+  if (!cf_obs_fast || (pwr_profile != PWR_NORMAL) || sg_burst) {
+    obs_cadence = 0;      // Not used by pwr_minutes() in the other profiles, starts from obs_interval again
+    obs_cad_valid = false;
     return;
   }
+  if (obs_cad_valid && dt) {
+    if (sg && obs_cad_sg) {
+      fast = ((uint32_t) ((sg > obs_cad_sg) ? sg - obs_cad_sg : obs_cad_sg - sg) * 3600 >=
+              (uint32_t) cf_obs_fast_mm * dt);
+    }
+    for (int k=0; !fast && (tn == obs_cad_tn) && (k<tn); k++) {
+      if ((t[k] != err) && (obs_cad_t[k] != err)) {
+        d = (t[k] > obs_cad_t[k]) ? t[k] - obs_cad_t[k] : obs_cad_t[k] - t[k];
+        fast = ((d * 3600) >= ((int64_t) cf_obs_fast_t * (FIX_ONE / 10) * dt));
+      }
+    }
+  }
+  obs_cad_valid = true;
+  obs_cad_at = at;
+  obs_cad_sg = sg;
+  obs_cad_tn = tn;
+  memcpy (obs_cad_t, t, sizeof(int32_t) * tn);
 
-  Output ("OBS_Do()");
- 
-  // Take multiple readings and return the median, 15s spent reading guage
-  int SG_Median = s_gauge_median();
-  
-  //
-  // Add I2C Sensors
-  //
-  if (BMX_1_exists) {
-    float p = 0.0;
-    float t = 0.0;
-    float h = 0.0;
-
-    if (BMX_1_chip_id == BMP280_CHIP_ID) {
-      p = bmp1.readPressure()/100.0F;       // bp1 hPa
-      t = bmp1.readTemperature();           // bt1
-    }
-    else if (BMX_1_chip_id == BME280_BMP390_CHIP_ID) {
-      if (BMX_1_type == BMX_TYPE_BME280) {
-        p = bme1.readPressure()/100.0F;     // bp1 hPa
-        t = bme1.readTemperature();         // bt1
-        h = bme1.readHumidity();            // bh1
+  cur = (obs_cadence) ? obs_cadence : cf_obs_interval;
+  if (fast) {
+    obs_cad_steady = 0;
+    if (cur != cf_obs_fast) {
+      obs_cad_set(cf_obs_fast);
+    }
+  }
+  else if (++obs_cad_steady >= OBS_CAD_STEADY) {
+    slow = (cf_obs_slow) ? cf_obs_slow : cf_obs_interval;
+    for (i=0; (i<(int)PWR_RT_COUNT) && (pwr_rt_list[i] < cur * 2); i++);
+    slow = ((i < (int)PWR_RT_COUNT) && (pwr_rt_list[i] < slow)) ? pwr_rt_list[i] : slow;
+    obs_cad_steady = 0;
+    if (slow > cur) {
+      obs_cad_set(slow);
+    }
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Summary Records - With obs_sum set each observation taken for logging, deadband skipped ones too, is added to an
+ *    hour and a day aggregate of each field: count, sum, min, max, first and last. The first observation of a new
+ *    hour or day writes the one just finished to /OBS/SUM.log, e.g.
+ *      {"at":"2021-03-05T11:00:00","p":"h","n":4,"sg":[4,1520,1532,1526,1520,1531],"bt1":[4,-2.11,...]}
+ *    Temperatures are in the QC range only and to 2 digits, gauge medians of 0 (no samples) are left out. The
+ *    aggregates are in RAM, after a reboot the first hour and day are partial.
+ * ======================================================================================================================
+ */
+#define SUM_SG            0                        // Field index of sg, sg2..sg4
+#define SUM_BMX           (SUM_SG + SG_CHANS_MAX)  // bt1 bt2
+#define SUM_MCP           (SUM_BMX + 2)            // mt1 mt2
+#define SUM_DS            (SUM_MCP + 2)            // dt1..dtN
+#define SUM_FIELDS        (SUM_DS + DS_MAX_PROBES)
+
+typedef struct {
+  uint16_t n;
+  int32_t  sum;                     // mm or FIX_ONE units, a day of -40.0C at 1 minute is -5.8e8
+  int32_t  min;
+  int32_t  max;
+  int32_t  first;
+  int32_t  last;
+} SUM_FIELD;
+
+typedef struct {
+  uint32_t start;                   // Unix time the period began, 0 = nothing added yet
+  uint16_t n;                       // Observations added
+  SUM_FIELD f[SUM_FIELDS];
+} SUM_PERIOD;
+
+SUM_PERIOD sum_hour;
+SUM_PERIOD sum_day;
+
+/*
+ * ======================================================================================================================
+ * sum_add() - Add a value to field i
+ * ======================================================================================================================
+ */
+void sum_add(SUM_PERIOD *p, int i, int32_t v) {
+  SUM_FIELD *f = &p->f[i];
+
+  if (f->n == 0) {
+    f->min = f->max = f->first = v;
+    f->sum = 0;
+  }
+  f->min = (v < f->min) ? v : f->min;
+  f->max = (v > f->max) ? v : f->max;
+  f->sum += v;
+  f->last = v;
+  f->n++;
+}
+
+/*
+ * ======================================================================================================================
+ * sum_write() - Log and clear a period, kind is "h" or "d"
+ * ======================================================================================================================
+ */
+void sum_write(SUM_PERIOD *p, const char *kind) {
+  DateTime dt(p->start);
+  SENSOR *s = NULL;
+  SUM_FIELD *f;
+  JSONBUF jb;
+  char key[8];
+  char at[20];
+  int mark;
+  bool fixed;
+
+  sprintf (at, "%d-%02d-%02dT%02d:%02d:%02d", dt.year(), dt.month(), dt.day(), dt.hour(), dt.minute(), dt.second());
+  jb_init(&jb, msgbuf, sizeof(msgbuf));
+  jb_str(&jb, "at", at);
+  jb_str(&jb, "p", kind);
+  jb_int(&jb, "n", p->n);
+  for (int i=0; i<SUM_FIELDS; i++) {
+    f = &p->f[i];
+    if (f->n == 0) {
+      continue;
+    }
+    fixed = (i >= SUM_BMX);
+    if (i < SUM_BMX) {
+      sprintf (key, (i == SUM_SG) ? "sg" : "sg%d", i - SUM_SG + 1);
+    }
+    else if (i < SUM_DS) {
+      s = &sn_table[(i < SUM_MCP) ? SN_BMX_1 + (i - SUM_BMX) : SN_MCP_1 + (i - SUM_MCP)];
+      strcpy (key, s->key[(s->kind == SN_BMX) ? 1 : 0]);
+    }
+    else {
+      sprintf (key, "dt%d", i - SUM_DS + 1);
+    }
+    mark = jb_key(&jb, key);
+    jb_putc(&jb, '[');
+    jb_putu(&jb, f->n, 0);
+    int32_t v[5] = { f->min, f->max, f->sum / (int32_t) f->n, f->first, f->last };
+    for (int k=0; k<5; k++) {
+      jb_putc(&jb, ',');
+      if (fixed) {
+        jb_putfixed(&jb, v[k], 2);
       }
-      if (BMX_1_type == BMX_TYPE_BMP390) {
-        p = bm31.readPressure()/100.0F;     // bp1 hPa
-        t = bm31.readTemperature();         // bt1       
+      else {
+        jb_puti(&jb, v[k], 0);
       }
     }
-    else { // BMP388
-      p = bm31.readPressure()/100.0F;       // bp1 hPa
-      t = bm31.readTemperature();           // bt1
-    }
-    bmx1_pressure = (isnan(p) || (p < QC_MIN_P)  || (p > QC_MAX_P))  ? QC_ERR_P  : p;
-    bmx1_temp     = (isnan(t) || (t < QC_MIN_T)  || (t > QC_MAX_T))  ? QC_ERR_T  : t;
-    bmx1_humid    = (isnan(h) || (h < QC_MIN_RH) || (h > QC_MAX_RH)) ? QC_ERR_RH : h;
+    jb_putc(&jb, ']');
+    jb_end(&jb, mark);
+  }
+  jb_close(&jb);
+  if (jb.overflow) {
+    Output ("SUM:Record Truncated");
   }
+  SD_LogSummary(msgbuf);
+  memset (p, 0, sizeof(SUM_PERIOD));
+}
 
-  if (BMX_2_exists) {
-    float p = 0.0;
-    float t = 0.0;
-    float h = 0.0;
+/*
+ * ======================================================================================================================
+ * sum_obs() - Close the hour or day just finished, then add this observation. Call before the record is built.
+ * ======================================================================================================================
+ */
+void sum_obs(uint32_t at, unsigned int sg) {
+  SUM_PERIOD *periods[2] = { &sum_hour, &sum_day };
+  uint32_t len[2] = { 3600UL, 86400UL };
+  SENSOR *s;
+  SUM_PERIOD *p;
+
+  sg_chan_mm[0] = sg;  // Not set by every gauge backend
+  for (int k=0; k<2; k++) {
+    p = periods[k];
+    if (p->start && ((at / len[k]) != (p->start / len[k]))) {
+      sum_write(p, (k == 0) ? "h" : "d");
+    }
+    if (!p->start) {
+      p->start = at - (at % len[k]);
+    }
+    p->n++;
 
-    if (BMX_2_chip_id == BMP280_CHIP_ID) {
-      p = bmp2.readPressure()/100.0F;       // bp2 hPa
-      t = bmp2.readTemperature();           // bt2
+    for (int c=0; c<sg_chans; c++) {
+      if (sg_chan_mm[c]) {
+        sum_add(p, SUM_SG + c, sg_chan_mm[c]);
+      }
     }
-    else if (BMX_2_chip_id == BME280_BMP390_CHIP_ID) {
-      if (BMX_2_type == BMX_TYPE_BME280) {
-        p = bme2.readPressure()/100.0F;     // bp2 hPa
-        t = bme2.readTemperature();         // bt2
-        h = bme2.readHumidity();            // bh2 
+    for (int i=0; i<SN_COUNT; i++) {
+      s = &sn_table[i];
+      if (*s->exists && !s->skipped && ((s->kind == SN_BMX) || (s->kind == SN_MCP))) {
+        int32_t t = s->value[(s->kind == SN_BMX) ? 1 : 0];
+        if ((t >= QC_FIX(QC_MIN_T)) && (t <= QC_FIX(QC_MAX_T))) {
+          sum_add(p, ((s->kind == SN_BMX) ? SUM_BMX : SUM_MCP) + s->slot, t);
+        }
       }
-      if (BMX_2_type == BMX_TYPE_BMP390) {
-        p = bm32.readPressure()/100.0F;       // bp2 hPa
-        t = bm32.readTemperature();           // bt2
-      }      
     }
-    else { // BMP388
-      p = bm32.readPressure()/100.0F;       // bp2 hPa
-      t = bm32.readTemperature();           // bt2
+    for (int d=0; (d<ds_count) && !sn_table[SN_DS_1].skipped; d++) {
+      if ((ds_reading[d] >= QC_FIX(QC_MIN_T)) && (ds_reading[d] <= QC_FIX(QC_MAX_T))) {
+        sum_add(p, SUM_DS + d, ds_reading[d]);
+      }
     }
-    bmx2_pressure = (isnan(p) || (p < QC_MIN_P)  || (p > QC_MAX_P))  ? QC_ERR_P  : p;
-    bmx2_temp     = (isnan(t) || (t < QC_MIN_T)  || (t > QC_MAX_T))  ? QC_ERR_T  : t;
-    bmx2_humid    = (isnan(h) || (h < QC_MIN_RH) || (h > QC_MAX_RH)) ? QC_ERR_RH : h;
   }
+}
 
-  if (MCP_1_exists) {
-    mcp1_temp = mcp1.readTempC();
-    mcp1_temp = (isnan(mcp1_temp) || (mcp1_temp < QC_MIN_T)  || (mcp1_temp > QC_MAX_T))  ? QC_ERR_T  : mcp1_temp;
+/*
+ * ======================================================================================================================
+ *  Trend Ring - The gauge over the last 24 hours for the status button (SM.h), a point a quarter hour, the last
+ *    observation in it. A point is one byte, depth or stage with sg_datum set, else the distance, in steps of the
+ *    sensor's range / 254 (20 mm for a 5m sensor, 40 mm for 10m), OBS_TR_NONE where there was no observation.
+ *    The point is addressed by its quarter hour since 1970, so adding one is a store and the points skipped since
+ *    the last one are blanked. A change of sensor range or the clock going back starts it again.
+ * ======================================================================================================================
+ */
+#define OBS_TR_POINTS     96                // 24 hours
+#define OBS_TR_SECS       (86400UL / OBS_TR_POINTS)
+#define OBS_TR_NONE       0xFF
+
+uint8_t  obs_tr[OBS_TR_POINTS];             // Indexed by quarter hour % OBS_TR_POINTS
+uint32_t obs_tr_slot = 0;                   // Quarter hour of the newest point, 0 = empty
+uint16_t obs_tr_mm = 0;                     // mm a step
+
+/*
+ * ======================================================================================================================
+ * obs_trend() - Put an observation's gauge mm in its point
+ * ======================================================================================================================
+ */
+void obs_trend(uint32_t at, int mm) {
+  uint32_t slot = at / OBS_TR_SECS;
+  uint16_t step = (sg_sensor->max_mm + 253) / 254;
+
+  if (!obs_tr_slot || (step != obs_tr_mm) || (slot < obs_tr_slot) || ((slot - obs_tr_slot) >= OBS_TR_POINTS)) {
+    memset (obs_tr, OBS_TR_NONE, sizeof(obs_tr));
+  }
+  else {
+    for (uint32_t k=obs_tr_slot+1; k<slot; k++) {
+      obs_tr[k % OBS_TR_POINTS] = OBS_TR_NONE;
+    }
+  }
+  mm = (mm < 0) ? 0 : mm / step;
+  obs_tr[slot % OBS_TR_POINTS] = (mm < OBS_TR_NONE) ? mm : OBS_TR_NONE - 1;
+  obs_tr_slot = slot;
+  obs_tr_mm = step;
+}
+
+/*
+ * ======================================================================================================================
+ *  Tail Ring - The last OBS_TAIL_RECS observations as their binary records, in RAM for the shell's tail command and
+ *    the status button so neither reads the card. OBS_Do() builds the record of every observation, logged, skipped
+ *    by the deadband or taken in calibration mode, and stores it here. OBS_bin_json() prints one as the .bin line
+ *    would be, the fields only the JSON record has (sg2, slp1, cad, tm, ...) are in the .log on the card.
+ * ======================================================================================================================
+ */
+#define OBS_TAIL_RECS     16                // 944 bytes
+
+OBS_BINREC obs_tail[OBS_TAIL_RECS];
+uint32_t obs_tail_n = 0;                    // Records since boot, the next goes in obs_tail[obs_tail_n % OBS_TAIL_RECS]
+
+/*
+ * ======================================================================================================================
+ * obs_tail_get() - Record k back from the newest, NULL past the oldest one held
+ * ======================================================================================================================
+ */
+const OBS_BINREC *obs_tail_get(int k) {
+  if ((k < 0) || (k >= OBS_TAIL_RECS) || ((uint32_t) k >= obs_tail_n)) {
+    return (NULL);
+  }
+  return (&obs_tail[(obs_tail_n - 1 - k) % OBS_TAIL_RECS]);
+}
+
+/*
+ * ======================================================================================================================
+ *  Observation Pipeline - OBS_Do() takes an observation in stages: obs_acquire() samples the gauge and reads the
+ *    sensors, obs_derive() runs the QC, deadband, summary and trend on it, obs_encode() formats the JSON record into
+ *    msgbuf and the binary record into obs_binrec once. Each sink in obs_sinks[] is then handed the OBS_OUT that
+ *    points at both and decides for itself whether and how it writes, the fast schedule holds the SD binary records
+ *    in RAM, a card that is down sends them to flash. A new output is a sink, it formats nothing and reads no sensor.
+ *    Sinks run in table order, the time of each is charged to its phase.
+ * ======================================================================================================================
+ */
+typedef struct {
+  int sg;                           // Gauge mm after QC
+  int batt;                         // mV
+  bool bv;                          // Battery read this observation, else batt is the last reading
+  int sg_qc;                        // Spike QC flags
+  bool log;                         // Logged observation, not calibration mode
+  bool log_sd;                      // Deadband logging can skip the SD card
+  bool burst;                       // Fast schedule record held in RAM, SDC.h Burst Capture
+  const char *json;                 // Record in msgbuf
+  int json_len;
+  OBS_BINREC *bin;
+} OBS_OUT;
+
+typedef struct {
+  const char *name;
+  void (*emit)(const OBS_OUT *o);
+  int phase;                        // PH_*
+} OBS_SINK;
+
+/*
+ * ======================================================================================================================
+ * obs_sink_sd_json() - The JSON record to the day's .log
+ * ======================================================================================================================
+ */
+void obs_sink_sd_json(const OBS_OUT *o) {
+  if (o->log && o->log_sd && (cf_sd_bin != 2) && !o->burst) {
+    SD_LogObservation((char *) o->json);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * obs_sink_sd_bin() - The binary record to the .bin and .dlt, held in RAM on the fast schedule or in flash
+ *   while the card is down. Held records are written once the burst ends or the card is back.
+ * ======================================================================================================================
+ */
+void obs_sink_sd_bin(const OBS_OUT *o) {
+  if (!o->log) {
+    return;
+  }
+  if (o->log_sd && (o->burst || cf_sd_bin || cf_sd_delta || fl_down())) {
+    if (fl_down()) {
+      fl_log((uint8_t *) o->bin, sizeof(OBS_BINREC));  // Card is down, hold it in flash
+    }
+    else if (o->burst) {
+      SD_LogBurst((uint8_t *) o->bin, sizeof(OBS_BINREC));
+    }
+    else {
+      if (cf_sd_bin) {
+        SD_LogBinary((uint8_t *) o->bin, sizeof(OBS_BINREC));
+      }
+      if (cf_sd_delta) {
+        obs_delta(o->bin);
+      }
+    }
+  }
+  if (!o->burst) {
+    SD_FlushBurst();  // Fast schedule over
+  }
+  if (o->log_sd && !o->burst) {
+    fl_service();
   }
+}
+
+/*
+ * ======================================================================================================================
+ * obs_sink_ns() - The record of n2s's kind to the need to send queue, not held ones
+ * ======================================================================================================================
+ */
+void obs_sink_ns(const OBS_OUT *o) {
+  if (!o->log || !o->log_sd || o->burst) {
+    return;
+  }
+  ns_enqueue(NS_JSON, (const uint8_t *) o->json, o->json_len);
+  if (!fl_down()) {
+    ns_enqueue(NS_BIN, (const uint8_t *) o->bin, sizeof(OBS_BINREC));
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * obs_sink_tail() - Every observation's binary record to the RAM tail ring
+ * ======================================================================================================================
+ */
+void obs_sink_tail(const OBS_OUT *o) {
+  obs_tail[obs_tail_n++ % OBS_TAIL_RECS] = *o->bin;
+}
+
+/*
+ * ======================================================================================================================
+ * obs_sink_console() - The JSON record to the serial console
+ * ======================================================================================================================
+ */
+void obs_sink_console(const OBS_OUT *o) {
+  Serial_write (o->json);
+}
+
+const OBS_SINK obs_sinks[] = {
+  { "sdjson", obs_sink_sd_json, PH_SD },
+  { "sdbin", obs_sink_sd_bin, PH_SD },
+  { "n2s", obs_sink_ns, PH_SD },
+  { "tail", obs_sink_tail, PH_FMT },
+  { "console", obs_sink_console, PH_OUT },
+};
+#define OBS_SINKS         (sizeof(obs_sinks) / sizeof(obs_sinks[0]))
+
+int obs_bv_last = 0;                // mV of the last battery read
+uint32_t obs_bv_due = 0;            // Unix time of the next battery read with bv_every set
+
+/*
+ * ======================================================================================================================
+ * obs_acquire() - Sample the gauge with every sensor that is due converting, then read them and the battery if due
+ * ======================================================================================================================
+ */
+void obs_acquire(OBS_OUT *o) {
+  uint32_t t = tm_now();
+  uint32_t every = (uint32_t) cf_bv_every * 60;
+  SENSOR *s;
+
+  ph_begin(PH_SG);  // Its waits give up at the budget
+ 
+  // Every sensor due converts while the gauge is sampled, collected below
+  sn_plan(t, o->log);
+  bmx_fuse_plan();
+  o->bv = !o->log || !every || !obs_bv_last || ((t + OBS_EARLY_S) >= obs_bv_due);
+  if (o->log && every && o->bv) {
+    obs_bv_due = ((t + OBS_EARLY_S) / every + 1) * every;
+  }
+  sn_start_all();
+
+  // Take multiple readings and return the median, up to sg_samples * cf_sg_interval ms spent reading guage (idle sleeping)
+  // Sensors that finish converting are read between the samples
+  ck_slow();  // The window is spent waiting on the DMAC
+  sg_gap = sn_gap;
+  o->sg = s_gauge_median();
+  sg_gap = NULL;
+  ck_fast();
+  ph_end(PH_SG);
+  sg_power_report();
   
-  batt = vbat_get();
+  //
+  // Collect Sensors
+  //
+  for (int i=0; i<SN_COUNT; i++) {
+    s = &sn_table[i];
+    if ((s->kind == SN_DS) && o->bv) {
+      obs_bv_last = vbat_mv();
+    }
+    if (!s->taken) {
+      sn_collect(s);
+    }
+    ph_end((s->kind == SN_BMX) ? PH_BMX : ((s->kind == SN_MCP) ? PH_MCP : PH_DS));
+  }
+  bmx_fuse();
+  ph_end(PH_BMX);
+  ph_status();  // Overruns so far go in this record
+  o->batt = obs_bv_last;
+}
 
+/*
+ * ======================================================================================================================
+ * obs_derive() - Time the observation, QC the gauge and keep the deadband, summaries and trend
+ * ======================================================================================================================
+ */
+void obs_derive(OBS_OUT *o) {
   // Set the time for this observation
   rtc_timestamp();
-  if (log_obs) {
-    Output(timestamp);
+  if (!o->log) {
+    return;
   }
-  
+  Output(timestamp);
+  if (cf_sg_qc) {
+    o->sg_qc = obs_sg_qc(now.unixtime(), &o->sg);
+  }
+  if (cf_obs_db_sg || cf_obs_db_t) {
+    o->log_sd = obs_db_changed(now.unixtime(), o->sg);
+  }
+  if (cf_obs_sum) {
+    sum_obs(now.unixtime(), o->sg);
+  }
+  if (o->sg) {
+    obs_trend(now.unixtime(), (cf_sg_datum) ? sg_depth(o->sg) : o->sg);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * obs_encode() - The JSON record into msgbuf and the binary record into obs_binrec, once for every sink
+ * ======================================================================================================================
+ */
+void obs_encode(OBS_OUT *o) {
+  JSONBUF jb;
+  char Buffer16Bytes[16];
+  SENSOR *s;
+  uint32_t qcf;
+
   // Build JSON log entry by hand  
   // {"at":"2021-03-05T11:43:59","sg":49,"bp1":3,"bt1":97.875,"bh1":40.20,"bv":3.5,"hth":9}
 
-  sprintf (msgbuf, "{\"at\":\"%s\",\"sg\":%d,", timestamp, SG_Median);
-  if (BMX_1_exists) {
-    sprintf (msgbuf+strlen(msgbuf), "\"bp1\":%u.%04d,\"bt1\":%d.%02d,\"bh1\":%d.%02d,",
-      (int)bmx1_pressure, (int)(bmx1_pressure*100)%100,
-      (int)bmx1_temp, (int)(bmx1_temp*100)%100,
-      (int)bmx1_humid, (int)(bmx1_humid*100)%100);
+  jb_init(&jb, msgbuf, sizeof(msgbuf));
+  jb_str(&jb, "at", timestamp);
+  jb_int(&jb, "sg", o->sg);
+  for (int c=1; c<sg_chans; c++) {
+    sprintf (Buffer16Bytes, "sg%d", c+1);
+    jb_int(&jb, Buffer16Bytes, sg_chan_mm[c]);
+  }
+  if (cf_sg_stream) {
+    jb_int(&jb, "sgmin", s_gauge_mm(sg_min));
+    jb_int(&jb, "sgmax", s_gauge_mm(sg_max));
+    jb_int(&jb, "sgiqr", s_gauge_span_mm(sg_iqr));
+  }
+  if (cf_sg_iqr_stop) {
+    jb_int(&jb, "sgn", sg_count);  // Samples used before the spread settled
   }
-  if (BMX_2_exists) {
-    sprintf (msgbuf+strlen(msgbuf), "\"bp2\":%u.%04d,\"bt2\":%d.%02d,\"bh2\":%d.%02d,",
-      (int)bmx2_pressure, (int)(bmx2_pressure*100)%100,
-      (int)bmx2_temp, (int)(bmx2_temp*100)%100,
-      (int)bmx2_humid, (int)(bmx2_humid*100)%100);
+  if (cf_sg_datum && o->sg) {
+    jb_int(&jb, "sgd", sg_depth(o->sg));
   }
-  if (MCP_1_exists) {
-    sprintf (msgbuf+strlen(msgbuf), "\"mt1\":%d.%04d,", (int)mcp1_temp, (int)(mcp1_temp*100)%100);   
+  if (o->sg_qc) {
+    jb_int(&jb, "sgqc", o->sg_qc);
+    if (cf_sg_qc == OBS_QC_REPLACE) {
+      jb_int(&jb, "sgraw", obs_qc_raw);
+    }
+  }
+  if (o->log && o->log_sd && obs_skip_n) {
+    jb_int(&jb, "skn", obs_skip_n);
+    jb_int(&jb, "sglo", obs_skip_lo);
+    jb_int(&jb, "sghi", obs_skip_hi);
+    obs_skip_n = 0;
+  }
+  for (int i=0; i<SN_COUNT; i++) {
+    s = &sn_table[i];
+    if (*s->exists && !s->skipped) {
+      for (int k=0; k<s->nvalues; k++) {
+        jb_fixed(&jb, s->key[k], s->value[k], s->digits[k]);
+      }
+      if ((s->kind == SN_BMX) && bmx_slp_q16 && (s->value[0] != QC_FIX(QC_ERR_P))) {
+        sprintf (Buffer16Bytes, "slp%d", s->slot+1);
+        jb_fixed(&jb, Buffer16Bytes, bmx_slp(s->value[0]), 2);
+      }
+      if ((s->kind == SN_BMX) && bm3_fifo_on[s->slot]) {
+        sprintf (Buffer16Bytes, "bp%davg", s->slot+1);
+        jb_fixed(&jb, Buffer16Bytes, bm3_fifo_avg[s->slot], 4);
+        sprintf (Buffer16Bytes, "bp%dmin", s->slot+1);
+        jb_fixed(&jb, Buffer16Bytes, bm3_fifo_min[s->slot], 4);
+        sprintf (Buffer16Bytes, "bp%dmax", s->slot+1);
+        jb_fixed(&jb, Buffer16Bytes, bm3_fifo_max[s->slot], 4);
+      }
+    }
+  }
+  if (cf_bmx_fuse && BMX_1_exists && BMX_2_exists && !sn_table[SN_BMX_1].skipped) {
+    jb_fixed(&jb, "bpf", bmx_fuse_p, 4);
+    jb_fixed(&jb, "btf", bmx_fuse_t, 2);
+    jb_int(&jb, "bfs", bmx_fuse_src);
+  }
+  if (!sn_table[SN_DS_1].skipped) {
+    for (int p=0; p<ds_count; p++) {
+      sprintf (Buffer16Bytes, "dt%d", p+1);
+      jb_fixed(&jb, Buffer16Bytes, ds_reading[p], 4);
+    }
+    if (cf_ds_alarm && ds_count) {
+      jb_int(&jb, "dtc", ds_carried);
+    }
+  }
+  if (o->bv) {
+    jb_fixed(&jb, "bv", (int32_t) o->batt * (FIX_ONE / 1000), 2);
+  }
+  if (cf_pwr_until && (pwr_rt_days >= 0)) {
+    jb_int(&jb, "rtd", pwr_rt_days);
+  }
+  if (cf_obs_fast) {
+    jb_int(&jb, "cad", (int) (obs_interval_s / 60));
+  }
+  if (o->log && obs_late) {
+    jb_int(&jb, "late", 1);
+  }
+  if (o->log && obs_gap) {
+    jb_int(&jb, "gap", obs_gap);  // Slots missed before this record
+  }
+  jb_int(&jb, "hth", SystemStatusBits);
+  qcf = sn_qc_flags();
+  if (qcf) {
+    int mark = jb_key(&jb, "qcf");  // QC code of each sensor value, Sensors.h sn_qc_flags()
+    jb_putu(&jb, qcf, 0);
+    jb_end(&jb, mark);
+  }
+  if (i2c_recoveries || sn_table[SN_BMX_1].errors || sn_table[SN_BMX_2].errors || sn_table[SN_MCP_1].errors ||
+      sn_table[SN_MCP_2].errors) {
+    // Failed reads of bmx1, bmx2, mcp1, mcp2 and bus clears, since boot
+    int mark = jb_key(&jb, "i2c");
+    jb_putc(&jb, '[');
+    for (int i=SN_BMX_1; i<=SN_MCP_2; i++) {
+      jb_putu(&jb, sn_table[i].errors, 0);
+      jb_putc(&jb, ',');
+    }
+    jb_putu(&jb, i2c_recoveries, 0);
+    jb_putc(&jb, ']');
+    jb_end(&jb, mark);
+  }
+  if (cf_obs_tm && ph_last_valid) {
+    int mark = jb_key(&jb, "tm");
+    jb_putc(&jb, '[');
+    for (int p=0; p<PH_COUNT; p++) {
+      if (p) {
+        jb_putc(&jb, ',');
+      }
+      jb_putu(&jb, (ph_last[p] + 500) / 1000, 0);
+    }
+    jb_putc(&jb, ']');
+    jb_end(&jb, mark);
+  }
+  if (cf_obs_tm) {
+    int mark = jb_key(&jb, "sgw");  // Gauge window ms and latest sample, SG.h Window Timing
+    jb_putc(&jb, '[');
+    jb_putu(&jb, sg_window_ms, 0);
+    jb_putc(&jb, ',');
+    jb_putu(&jb, sg_jitter_ms, 0);
+    jb_putc(&jb, ']');
+    jb_end(&jb, mark);
+  }
+  if (cf_obs_tm) {
+    int mark = jb_key(&jb, "sdio");  // Blocks of the last cycle, SDC.h Block I/O
+    jb_putc(&jb, '[');
+    for (int i=0; i<3; i++) {
+      if (i) {
+        jb_putc(&jb, ',');
+      }
+      jb_putu(&jb, sd_io_last[i], 0);
+    }
+    jb_putc(&jb, ']');
+    jb_end(&jb, mark);
   }
-  if (ds_found) {
-    getDSTemp();
-    sprintf (msgbuf+strlen(msgbuf), "\"dt1\":%d.%04d,", (int)ds_reading, (int)(ds_reading*100)%100);   
+  if (cf_obs_tm && tm_sl_valid) {
+    int mark = jb_key(&jb, "slp");  // Last sleep, TM.h Sleep Accounting
+    jb_putc(&jb, '[');
+    jb_putu(&jb, tm_sl_ms, 0);
+    jb_putc(&jb, ',');
+    jb_putu(&jb, tm_sl_s, 0);
+    jb_putc(&jb, ',');
+    jb_putu(&jb, tm_sl_wake, 0);
+    jb_putc(&jb, ',');
+    jb_puti(&jb, tm_sl_drift, 0);
+    jb_putc(&jb, ']');
+    jb_end(&jb, mark);
+  }
+  if (o->log) {
+    rm_record(&jb, now.unixtime());
+  }
+  en_report(&jb);
+  jb_close(&jb);
+  OBS_bin_build(&obs_binrec, o->sg, o->batt, o->bv, o->log && obs_late);
+  if (jb.overflow) {
+    Output ("OBS:Record Truncated");
+  }
+  o->json = msgbuf;
+  o->json_len = jb.len;
+  o->bin = &obs_binrec;
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_Do() - Collect Observations, Build message, Send to logging site
+ * ======================================================================================================================
+ */
+void OBS_Do (bool log_obs) {
+  OBS_OUT o;
+
+  // Safty Check for Vaild Time
+  if (!RTC_valid) {
+    Output ("OBS_Do: Time NV");
+    return;
   }
-  sprintf (msgbuf+strlen(msgbuf), "\"bv\":%d.%02d,\"hth\":%d}", 
-    (int)batt, (int)(batt*100)%100, SystemStatusBits);
 
-  // Log Observation to SD Card
-  if (log_obs) {
-    SD_LogObservation(msgbuf);
+  Output ("OBS_Do()");
+  ph_end(PH_OUT);
+  sd_io_cycle();
+
+  memset (&o, 0, sizeof(o));
+  o.log = log_obs;
+  o.log_sd = true;
+  obs_acquire(&o);
+  obs_derive(&o);
+  ph_end(PH_OUT);
+  obs_encode(&o);
+  ph_end(PH_FMT);
+
+  // On a fast schedule with sd_burst only the binary record is held
+  if (o.log) {
+    o.burst = cf_sd_burst && (sg_burst || (obs_cadence && (obs_cadence < cf_obs_interval)));
+    if (o.log_sd) {
+      SD_Recover();  // Missing or failed card, on its backoff
+    }
+  }
+  for (unsigned int k=0; k<OBS_SINKS; k++) {
+    obs_sinks[k].emit(&o);
+    ph_end(obs_sinks[k].phase);
+  }
+
+  if (o.log) {
+    if (o.log_sd) {
+      obs_gap = 0;  // In this record
+    }
+    if (o.batt < SD_WB_LOWBATT) {
+      SD_Close();  // Don't hold observations or an untrimmed log when we may not wake up again
+    }
+    if (o.bv) {
+      pwr_update(o.batt);  // Profile for the next observation, from a new reading only
+    }
+    rs_observation((o.bv) ? o.batt : 0);
+    obs_burst_update(o.sg);
+    obs_cad_update(now.unixtime(), o.sg);
   }
-  Serial_write (msgbuf);
+  ph_end(PH_SD);
 }
@@ -14,55 +14,119 @@
  */
 int  SCE_PIN = 12;
 bool SerialConsoleEnabled = false;  // Variable for serial monitor control
+bool Headless = false;              // No OLED and no serial console, nobody to pause for
+bool SerialHeadlessBoot = false;    // Booted without the jumper, USB was never attached for a host
+bool UsbAttached = true;            // The core attaches USB before setup()
+bool op_uart = false;               // Lines to Serial1 too, SH.h Service Console
 
 /*
  * ======================================================================================================================
- *  OLED Display
+ *  Quiet Boot - Without the console jumper nobody watches the boot, so Output() keeps its lines in op_boot[] instead
+ *    of redrawing the OLED for each one and Output_Delay() does not pause. Output_BootReport() at the end of setup()
+ *    shows the last lines on the OLED in one refresh and writes them all to OP_BOOT_FILE, replacing the last boot's.
+ * ======================================================================================================================
+ */
+#define OP_BOOT_FILE        "/OBS/BOOT.log"
+#define OP_BOOT_MAX         768  // Bytes of boot lines kept, about 40
+
+bool op_quiet = false;              // Boot lines held
+char op_boot[OP_BOOT_MAX];          // Lines, each ended by \n
+int  op_boot_len = 0;
+int  op_boot_lost = 0;              // Lines that did not fit
+
+/*
+ * ======================================================================================================================
+ *  OLED Display - OLED_initialize() makes one display object for the panel it finds, a headless unit has none.
+ *    Only text in 8 pixel rows is shown, so it runs without a framebuffer: each line's glyph columns go straight
+ *    to the controller RAM page it maps to (Adafruit_SSD1306 setTextOnly()).
  * ======================================================================================================================
  */
 #define SCREEN_WIDTH        128 // OLED display width, in pixels
 #define OLED32_I2C_ADDRESS  0x3C // 128x32 - https://www.adafruit.com/product/4440
 #define OLED64_I2C_ADDRESS  0x3D // 128x64 - https://www.adafruit.com/product/326
 #define OLED_RESET          -1 // -1 = Not in use
+#if STN_FIXED
+#define OLED32              (STN_OLED == 32)  // One panel in the build, ST.h
+#define OLED64              (STN_OLED == 64)
+#define OLED_PANEL          STN_OLED
+#else
 #define OLED32              (oled_type == OLED32_I2C_ADDRESS)
 #define OLED64              (oled_type == OLED64_I2C_ADDRESS)
+#define OLED_PANEL          1                 // Either, found at boot
+#endif
+
+#define OLED_RING           8  // Controller RAM pages, a ring of text lines on either panel
+#define OLED_ROWS           ((OLED32) ? 4 : 8)  // Lines shown
 
-bool DisplayEnabled = true;
+bool DisplayEnabled = (OLED_PANEL != 0);
 int  oled_type = 0;
-char oled_lines[8][23];
-Adafruit_SSD1306 display32(SCREEN_WIDTH, 32, &Wire, OLED_RESET);
-Adafruit_SSD1306 display64(SCREEN_WIDTH, 64, &Wire, OLED_RESET);
+char oled_lines[OLED_RING][23];     // Indexed by controller RAM page
+char oled_shown[OLED_RING][23];     // Lines as last sent to each page
+int  oled_head = 0;                 // Page shown as the top line
+int  oled_head_shown = 0;           // Start line page last sent
+Adafruit_SSD1306 *oled = NULL;      // The panel found
+
+/*
+ * ======================================================================================================================
+ *  OLED by DMA - With the I2C queue (IQ.h) on, each changed line is rendered into its own oled_tx[] slot and
+ *  queued as a command write and a data write, OLED_update() returns before they are sent.
+ *  A slot is only filled again once its last transfer is done.
+ * ======================================================================================================================
+ */
+typedef struct {
+  uint8_t cmd[7];                   // Co=0 D/C=0, PAGEADDR page page, COLUMNADDR 0 127
+  uint8_t data[1+SCREEN_WIDTH];     // D/C=1, the page
+  IQ_XFER xcmd;
+  IQ_XFER xdata;
+} OLED_PAGE_TX;
+
+OLED_PAGE_TX oled_tx[OLED_RING];
+uint8_t oled_start_cmd[2];
+IQ_XFER oled_start_x;
 
 /*
  * ======================================================================================================================
- * OLED_sleepDisplay()
+ *  OLED Sleep - The panel is turned off and its charge pump with it, which leaves the controller drawing a few uA
+ *    instead of the pump's idle current. Display RAM is kept while the controller has power, so the lines come back
+ *    as they were. On wake the pump is enabled before the display, the datasheet's 100ms lets it reach the panel
+ *    voltage before anything is shown.
+ * ======================================================================================================================
+ */
+#define OLED_PUMP_OFF       0x10 // SSD1306_CHARGEPUMP argument, pump disabled
+#define OLED_PUMP_ON        0x14 // Pump enabled, the panels run from it (SSD1306_SWITCHCAPVCC)
+#define OLED_PUMP_MS        100  // Pump settle after display on, SSD1306 application note
+
+/*
+ * ======================================================================================================================
+ * OLED_sleepDisplay() - Display and charge pump off
  * ======================================================================================================================
  */
 void OLED_sleepDisplay() {
+#if OLED_PANEL
   if (DisplayEnabled) {
-    if (OLED32) {
-      display32.ssd1306_command(SSD1306_DISPLAYOFF);
-    }
-    else {
-      display64.ssd1306_command(SSD1306_DISPLAYOFF);
-    }
+    iq_drain();
+    oled->ssd1306_command(SSD1306_DISPLAYOFF);
+    oled->ssd1306_command(SSD1306_CHARGEPUMP);
+    oled->ssd1306_command(OLED_PUMP_OFF);
   }
+#endif
 }
 
 /*
  * ======================================================================================================================
- * OLED_wakeDisplay()
+ * OLED_wakeDisplay() - Charge pump and display on, showing what display RAM held
  * ======================================================================================================================
  */
 void OLED_wakeDisplay() {
+#if OLED_PANEL
   if (DisplayEnabled) {
-    if (OLED32) {
-      display32.ssd1306_command(SSD1306_DISPLAYON);
-    }
-    else {
-      display64.ssd1306_command(SSD1306_DISPLAYON);
-    }
+    iq_drain();
+    oled->ssd1306_command(SSD1306_CHARGEPUMP);
+    oled->ssd1306_command(OLED_PUMP_ON);
+    oled->ssd1306_command(SSD1306_DISPLAYON);
+    delay(OLED_PUMP_MS);
   }
+#endif
 }
 
 /*
@@ -73,95 +137,145 @@ void OLED_wakeDisplay() {
 void OLED_ClearDisplayBuffer() {
   int r,c;
   
-  for (r=0; r<8; r++) {
+  for (r=0; r<OLED_RING; r++) {
     for (c=0; c<22; c++) {
       oled_lines [r][c] = ' ';
     }
     oled_lines [r][c] = (char) NULL;
   }
 }
+
+/*
+ * ======================================================================================================================
+ * OLED_line() -- Text of display line r (0 = top), where it sits in the ring
+ * ======================================================================================================================
+ */
+char *OLED_line(int r) {
+  return (oled_lines [(oled_head + r) % OLED_RING]);
+}
+
+/*
+ * ======================================================================================================================
+ * OLED_setline() -- Copy str to display line r, cut to 21 characters and padded with spaces
+ * ======================================================================================================================
+ */
+void OLED_setline(int r, const char *str) {
+  int c, len;
+  char *line = OLED_line(r);
+
+  // check length on new output line string
+  len = strlen (str);
+  if (len>21) {
+    len = 21;
+  }
+  for (c=0; c<=len; c++) {
+    line[c] = *(str+c);
+  }
+
+  // Adding Padding
+  for (;c<=21; c++) {
+    line[c] = ' ';
+  }
+  line[22] = (char) NULL;
+}
   
+/*
+ * ======================================================================================================================
+ * OLED_queue_page() -- Queue the glyph columns of str for controller RAM page p
+ * ======================================================================================================================
+ */
+void OLED_queue_page(const char *str, int p) {
+  OLED_PAGE_TX *t = &oled_tx[p];
+
+  iq_wait(&t->xcmd);
+  iq_wait(&t->xdata);
+  t->cmd[0] = 0x00;
+  t->cmd[1] = SSD1306_PAGEADDR;
+  t->cmd[2] = p;
+  t->cmd[3] = p;
+  t->cmd[4] = SSD1306_COLUMNADDR;
+  t->cmd[5] = 0;
+  t->cmd[6] = SCREEN_WIDTH - 1;
+  t->data[0] = 0x40;
+  oled->textColumns(&t->data[1], str);
+  iq_write(&t->xcmd, oled_type, t->cmd, sizeof(t->cmd));
+  iq_write(&t->xdata, oled_type, t->data, sizeof(t->data));
+}
+
 /*
  * ======================================================================================================================
  * OLED_update() -- Output oled in memory map to display
+ *
+ *   Only lines that differ from what is in the controller RAM page they map to are sent, each to its own page, then
+ *   the start line is moved so oled_head is at the top.
+ *   With the I2C queue on the pages and the start line are queued in that order and go out in the background.
  * ======================================================================================================================
  */
 void OLED_update() {  
+#if OLED_PANEL
+  Adafruit_SSD1306 *d;
+  int r, p;
+
   if (DisplayEnabled) {
-    if (OLED32) {
-      display32.clearDisplay();
-      display32.setCursor(0,0);             // Start at top-left corner
-      display32.print(oled_lines [0]);
-      display32.setCursor(0,8);
-      display32.print(oled_lines [1]);
-      display32.setCursor(0,16);
-      display32.print(oled_lines [2]);
-      display32.setCursor(0,24);  
-      display32.print(oled_lines [3]);
-      display32.display();
+    d = oled;
+    for (r=0; r<OLED_ROWS; r++) {
+      p = (oled_head + r) % OLED_RING;
+      if (strcmp(oled_lines[p], oled_shown[p]) != 0) {
+        if (iq_enabled) {
+          OLED_queue_page(oled_lines[p], p);
+        }
+        else {
+          d->textPage(p, oled_lines[p]);
+        }
+        memcpy (oled_shown[p], oled_lines[p], sizeof(oled_shown[p]));
+      }
     }
-    else {
-      display64.clearDisplay();
-      display64.setCursor(0,0);             // Start at top-left corner
-      display64.print(oled_lines [0]);
-      display64.setCursor(0,8);
-      display64.print(oled_lines [1]);
-      display64.setCursor(0,16);
-      display64.print(oled_lines [2]);
-      display64.setCursor(0,24);  
-      display64.print(oled_lines [3]);
-      display64.setCursor(0,32);  
-      display64.print(oled_lines [4]);
-      display64.setCursor(0,40);  
-      display64.print(oled_lines [5]);
-      display64.setCursor(0,48);  
-      display64.print(oled_lines [6]);
-      display64.setCursor(0,56);  
-      display64.print(oled_lines [7]);
-      display64.display();
-     
+    if (oled_head != oled_head_shown) {
+      if (iq_enabled) {
+        iq_wait(&oled_start_x);
+        oled_start_cmd[0] = 0x00;
+        oled_start_cmd[1] = SSD1306_SETSTARTLINE | ((oled_head * 8) & 0x3F);
+        iq_write(&oled_start_x, oled_type, oled_start_cmd, sizeof(oled_start_cmd));
+      }
+      else {
+        d->setStartLine(oled_head * 8);
+      }
+      oled_head_shown = oled_head;
     }
   }
+#endif
 }
 
 /*
  * ======================================================================================================================
- * OLED_write() 
+ * OLED_columns() -- Send SCREEN_WIDTH column bytes drawn by the caller to display line r, in place of its text
+ *
+ *   The page is sent at once, after the queued lines. Its text is marked unsent so OLED_update() puts it back.
  * ======================================================================================================================
  */
-void OLED_write(const char *str) {
-  int c, len, bottom_line = 3;
-  
-  if (DisplayEnabled) {
-    // move lines up
-    for (c=0; c<=21; c++) {
-      oled_lines [0][c] = oled_lines [1][c];
-      oled_lines [1][c] = oled_lines [2][c];
-      oled_lines [2][c] = oled_lines [3][c];
-      if (OLED64) {
-        oled_lines [3][c] = oled_lines [4][c];
-        oled_lines [4][c] = oled_lines [5][c];
-        oled_lines [5][c] = oled_lines [6][c];  
-        oled_lines [6][c] = oled_lines [7][c];  
-        bottom_line = 7;          
-      }
-    }
+void OLED_columns(int r, const uint8_t *cols) {
+#if OLED_PANEL
+  int p = (oled_head + r) % OLED_RING;
 
-    // check length on new output line string
-    len = strlen (str);
-    if (len>21) {
-      len = 21;
-    }
-    for (c=0; c<=len; c++) {
-      oled_lines [bottom_line][c] = *(str+c);
-    }
+  if (DisplayEnabled) {
+    iq_drain();
+    oled->columnsPage(p, cols);
+    oled_shown[p][0] = 1;  // Not a string any line can hold
+    oled_shown[p][1] = 0;
+  }
+#endif
+}
 
-    // Adding Padding
-    for (;c<=21; c++) {
-      oled_lines [bottom_line][c] = ' ';
-    }
-    oled_lines [bottom_line][22] = (char) NULL;
-    
+/*
+ * ======================================================================================================================
+ * OLED_write() -- Scroll up one line and output on the bottom line
+ * ======================================================================================================================
+ */
+void OLED_write(const char *str) {
+  if (DisplayEnabled) {
+    // move lines up, the old top line becomes the new bottom line
+    oled_head = (oled_head + 1) % OLED_RING;
+    OLED_setline(OLED_ROWS-1, str);
     OLED_update();
   }
 }
@@ -172,28 +286,8 @@ void OLED_write(const char *str) {
  * ======================================================================================================================
  */
 void OLED_write_noscroll(const char *str) {
-  int c, len, bottom_line = 3;
-
-  if (OLED64) {
-    bottom_line = 7;
-  }
-
   if (DisplayEnabled) {
-    len = strlen (str);
-    if (len>21) {
-      len = 21;
-    }
-    
-    for (c=0; c<=len; c++) {
-      oled_lines [bottom_line][c] = *(str+c);
-    }
-
-    // Adding Padding
-    for (;c<=21; c++) {
-      oled_lines [bottom_line][c] = ' ';
-    }
-    oled_lines [bottom_line][22] = (char) NULL;
-    
+    OLED_setline(OLED_ROWS-1, str);
     OLED_update();
   }
 }
@@ -204,36 +298,150 @@ void OLED_write_noscroll(const char *str) {
  * ======================================================================================================================
  */
 void OLED_initialize() {
+#if OLED_PANEL
+  Adafruit_SSD1306 *d = NULL;
+  int height;
+
   if (DisplayEnabled) {
-    if (I2C_Device_Exist (OLED32_I2C_ADDRESS)) {
+#if STN_FIXED
+    if (I2C_Present ((OLED32) ? OLED32_I2C_ADDRESS : OLED64_I2C_ADDRESS)) {
+      oled_type = (OLED32) ? OLED32_I2C_ADDRESS : OLED64_I2C_ADDRESS;
+    }
+#else
+    if (I2C_Present (OLED32_I2C_ADDRESS)) {
       oled_type = OLED32_I2C_ADDRESS;
-      display32.begin(SSD1306_SWITCHCAPVCC, OLED32_I2C_ADDRESS);
-      display32.clearDisplay();
-      display32.setTextSize(1); // Draw 2X-scale text
-      display32.setTextColor(WHITE);
-      display32.setCursor(0, 0);
-      for (int r=0; r<4; r++) {
-        oled_lines[r][0]=0;
-      }
-      OLED_write("OLED32:OK");
     }
-    else if (I2C_Device_Exist (OLED64_I2C_ADDRESS)) {
+    else if (I2C_Present (OLED64_I2C_ADDRESS)) {
       oled_type = OLED64_I2C_ADDRESS;
-      display64.begin(SSD1306_SWITCHCAPVCC, OLED64_I2C_ADDRESS);
-      display64.clearDisplay();
-      display64.setTextSize(1); // Draw 2X-scale text
-      display64.setTextColor(WHITE);
-      display64.setCursor(0, 0);
-      for (int r=0; r<8; r++) {
-        oled_lines[r][0]=0;
-      }
-      OLED_write("OLED64:OK");
     }
+#endif
     else {
       DisplayEnabled = false;
       SystemStatusBits |= SSB_OLED; // Turn on Bit
     }
+
+    if (oled_type) {
+      // Bus clock during and after each display transfer, the library default drops the bus to 100kHz afterwards
+      height = (OLED32) ? 32 : 64;
+      d = oled = new Adafruit_SSD1306(SCREEN_WIDTH, height, &Wire, OLED_RESET, I2C_CLOCK, I2C_CLOCK);
+      d->setTextOnly();  // Before begin(), nothing is malloc()ed and the controller RAM is blanked
+      d->begin(SSD1306_SWITCHCAPVCC, oled_type);
+      oled_head = 0;
+      oled_head_shown = 0;        // begin() sets start line 0
+      for (int r=0; r<OLED_RING; r++) {
+        oled_lines[r][0]=0;
+        oled_shown[r][0]=1;       // Not a string any line can hold, forces every page to be written once
+        oled_shown[r][1]=0;
+      }
+      OLED_write((OLED32) ? "OLED32:OK" : "OLED64:OK");
+    }
+  }
+#endif
+}
+
+/*
+ * ======================================================================================================================
+ *  Console Ring - Serial_write() puts the line in op_tx[] and returns, SysTick drains it to the USB CDC IN endpoint
+ *    a packet at a time, only when the endpoint is free so the core's send() never waits for the host. A console
+ *    nobody reads no longer holds the CPU awake. When a line does not fit the oldest lines are dropped, counted in
+ *    op_tx_dropped. Code that writes to Serial itself (EX.h frames) takes the endpoint with op_tx_own(), which lets
+ *    the ring drain first and holds it until given back. Lines wait in RAM across a sleep, SysTick is stopped then.
+ * ======================================================================================================================
+ */
+#define OP_TX_SIZE          1024  // Bytes, a power of 2
+#define OP_TX_MASK          (OP_TX_SIZE - 1)
+#define OP_TX_PACKET        (EPX_SIZE - 1)  // What the core's send() puts in one IN packet
+#define OP_TX_OWN_MS        500   // Longest op_tx_own() waits for the ring to drain
+
+char op_tx[OP_TX_SIZE];
+volatile uint16_t op_tx_head = 0;   // Next byte in
+volatile uint16_t op_tx_tail = 0;   // Next byte out
+volatile bool op_tx_held = false;   // Endpoint taken by op_tx_own()
+uint32_t op_tx_dropped = 0;         // Lines dropped for room
+
+/*
+ * ======================================================================================================================
+ * op_tx_put() - Line and CR LF into the ring, the oldest lines out until it fits
+ * ======================================================================================================================
+ */
+void op_tx_put(const char *str) {
+  uint32_t primask = __get_PRIMASK();
+  int len = strlen(str);
+  uint16_t head;
+
+  if (len > (OP_TX_SIZE - 3)) {
+    len = OP_TX_SIZE - 3;  // The start of a line longer than the ring
+  }
+
+  __disable_irq();  // SysTick moves the tail
+  while ((OP_TX_MASK - ((op_tx_head - op_tx_tail) & OP_TX_MASK)) < (len + 2)) {
+    while ((op_tx_tail != op_tx_head) && (op_tx[op_tx_tail] != '\n')) {
+      op_tx_tail = (op_tx_tail + 1) & OP_TX_MASK;
+    }
+    op_tx_tail = (op_tx_tail + 1) & OP_TX_MASK;
+    op_tx_dropped++;
   }
+  head = op_tx_head;
+  for (int i=0; i<len; i++) {
+    op_tx[head] = str[i];
+    head = (head + 1) & OP_TX_MASK;
+  }
+  op_tx[head] = '\r';
+  head = (head + 1) & OP_TX_MASK;
+  op_tx[head] = '\n';
+  op_tx_head = (head + 1) & OP_TX_MASK;
+  __set_PRIMASK(primask);
+}
+
+/*
+ * ======================================================================================================================
+ * op_tx_drain() - One packet from the ring when the endpoint has sent the last one, from SysTick
+ * ======================================================================================================================
+ */
+void op_tx_drain() {
+  UsbDeviceEndpoint *ep = &USB->DEVICE.DeviceEndpoint[CDC_ENDPOINT_IN];
+  uint16_t tail = op_tx_tail;
+  uint16_t n;
+  size_t sent;
+
+  if (op_tx_held || !UsbAttached || (tail == op_tx_head)) {
+    return;
+  }
+  if (ep->EPSTATUS.bit.BK1RDY && !ep->EPINTFLAG.bit.TRCPT1) {
+    return;  // Host has not taken the last packet, send() would wait for it
+  }
+  n = (op_tx_head > tail) ? (op_tx_head - tail) : (OP_TX_SIZE - tail);  // Up to the end of op_tx[]
+  n = (n < OP_TX_PACKET) ? n : OP_TX_PACKET;
+  sent = Serial.write((const uint8_t *)&op_tx[tail], n);
+  if ((sent > 0) && (sent <= n)) {
+    op_tx_tail = (tail + sent) & OP_TX_MASK;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * sysTickHook() - Called by the core's SysTick_Handler() each ms, 0 lets it count the tick
+ * ======================================================================================================================
+ */
+extern "C" int sysTickHook(void) {
+  op_tx_drain();
+  return (0);
+}
+
+/*
+ * ======================================================================================================================
+ * op_tx_own() - Take the endpoint for direct Serial writes once the ring has drained, or give it back
+ * ======================================================================================================================
+ */
+void op_tx_own(bool own) {
+  unsigned long start = millis();
+
+  if (own) {
+    while ((op_tx_tail != op_tx_head) && ((millis() - start) < OP_TX_OWN_MS)) {
+      LowPower.idle();  // SysTick wakes us each ms and sends a packet
+    }
+  }
+  op_tx_held = own;
 }
 
 /*
@@ -243,22 +451,52 @@ void OLED_initialize() {
  */
 void Serial_write(const char *str) {
   if (SerialConsoleEnabled) {
-    Serial.println(str);
+    op_tx_put(str);
+  }
+  if (op_uart) {
+    Serial1.write(str);
+    Serial1.write("\r\n");
   }
 }
 
 /*
  * ======================================================================================================================
- * Serial_writeln() 
+ * Serial_writeln() - Same as Serial_write(), the boot lines drain from the ring like any other
  * ======================================================================================================================
  */
 void Serial_writeln(const char *str) {
-  if (SerialConsoleEnabled) {
-    Serial.println(str);
-    Serial.flush();
+  Serial_write(str);
+}
+
+/*
+ * ======================================================================================================================
+ * Serial_Detach() - USB off the bus, the host sees the board unplugged
+ * ======================================================================================================================
+ */
+void Serial_Detach() {
+  if (UsbAttached) {
+    USBDevice.detach();
+    UsbAttached = false;
+    SerialConsoleEnabled = false;
+    Headless = !DisplayEnabled;
   }
 }
 
+/*
+ * ======================================================================================================================
+ * Serial_Attach() - USB on the bus for a console after a headless boot, the jumper went on or the RTC needs setting
+ * ======================================================================================================================
+ */
+void Serial_Attach() {
+  if (!UsbAttached) {
+    USBDevice.attach();
+    UsbAttached = true;
+    Serial.begin(9600);
+  }
+  SerialConsoleEnabled = true;
+  Headless = false;
+}
+
 /*
  * ======================================================================================================================
  * Serial_Initialize() -
@@ -274,6 +512,13 @@ void Serial_Initialize() {
 
   // There are libraries that print to Serial Console so we need to initialize no mater what the jumper is set to.
   Serial.begin(9600);
+
+  if (!SerialConsoleEnabled) {
+    // Deployed, no host to enumerate for or wait on. Off the bus so each sleep does not detach and attach again
+    SerialHeadlessBoot = true;
+    Serial_Detach();
+    return;
+  }
   delay(1000); // prevents usb driver crash on startup, do not omit this
 
   if (SerialConsoleEnabled) {
@@ -305,10 +550,63 @@ void Serial_Initialize() {
  * ======================================================================================================================
  */
 void Output(const char *str) {
-  OLED_write(str);
+  int len;
+
+  if (op_quiet) {
+    len = strlen(str);
+    if ((op_boot_len + len + 1) <= OP_BOOT_MAX) {
+      memcpy (&op_boot[op_boot_len], str, len);
+      op_boot_len += len;
+      op_boot[op_boot_len++] = '\n';
+    }
+    else {
+      op_boot_lost++;
+    }
+  }
+  else {
+    OLED_write(str);
+  }
   Serial_write(str);
 }
 
+/*
+ * ======================================================================================================================
+ *  Leveled Output - LOG_ERR(), LOG_INFO() and LOG_DBG() take sprintf() arguments and format only when Output() has
+ *    somewhere to put the line, the OLED, the console or the quiet boot lines. The line is OP_LOG_MAX bytes of the
+ *    scratch arena (SF.h), not msgbuf, so a record being built there is left alone. Build with LOG_LEVEL below
+ *    LOG_LEVEL_DBG, -DLOG_LEVEL=1 says failures only, and the calls and their strings above it are dropped.
+ *    Console command replies stay on Output(), they are what was asked for.
+ * ======================================================================================================================
+ */
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERR       1  // Something failed or was refused
+#define LOG_LEVEL_INFO      2  // Boot, config and state changes
+#define LOG_LEVEL_DBG       3  // Each observation
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           LOG_LEVEL_DBG
+#endif
+
+#define OP_ACTIVE           (op_quiet || DisplayEnabled || SerialConsoleEnabled || op_uart)
+#define OP_LOG_MAX          SF_SCRATCH_SPILL  // Longer lines are cut
+#define OP_LOG(...)         do { if (OP_ACTIVE) { SF_SCRATCH sc_; char *line_ = sc_.alloc(OP_LOG_MAX); \
+                              snprintf (line_, OP_LOG_MAX, __VA_ARGS__); Output (line_); } } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERR
+#define LOG_ERR(...)        OP_LOG(__VA_ARGS__)
+#else
+#define LOG_ERR(...)        do { } while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...)       OP_LOG(__VA_ARGS__)
+#else
+#define LOG_INFO(...)       do { } while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DBG
+#define LOG_DBG(...)        OP_LOG(__VA_ARGS__)
+#else
+#define LOG_DBG(...)        do { } while (0)
+#endif
+
 /*
  * ======================================================================================================================
  * OutputNS() - Output with no scroll on oled
@@ -319,14 +617,88 @@ void OutputNS(const char *str) {
   Serial_write(str);
 }
 
+/*
+ * ======================================================================================================================
+ * Output_Delay() - Pause so output can be read, skipped when headless or quiet
+ * ======================================================================================================================
+ */
+void Output_Delay(unsigned long ms) {
+  unsigned long start = millis();
+
+  if (!Headless && !op_quiet) {
+    while ((millis() - start) < ms) {
+      LowPower.idle();  // SysTick wakes us each ms
+    }
+  }
+}
+
 /*
  * ======================================================================================================================
  * Output_Initialize() -
  * ======================================================================================================================
  */
 void Output_Initialize() {
+  pinMode(SCE_PIN, INPUT_PULLUP);
+  op_quiet = (digitalRead(SCE_PIN) != LOW);  // No console jumper, boot quietly
   OLED_initialize();
   Output("SER:Init");
   Serial_Initialize();
   Output("SER:OK");
+  Headless = (!DisplayEnabled && !SerialConsoleEnabled);
+}
+
+/*
+ * ======================================================================================================================
+ * Output_BootReport() - End a quiet boot, last lines to the OLED in one refresh and all of them to OP_BOOT_FILE
+ * ======================================================================================================================
+ */
+void Output_BootReport() {
+  SF_SCRATCH sc;
+  char *buf = sc.alloc(SF_LINE);
+  File fp;
+  char *line;
+  char *end;
+  int first = 0;
+  int n = 0;
+
+  if (!op_quiet) {
+    return;
+  }
+  op_quiet = false;
+  if (op_boot_lost) {
+    sprintf (buf, "OP:%d Lines Lost", op_boot_lost);
+    Output (buf);  // Serial and OLED
+  }
+
+  // Count lines, the OLED gets the last OLED_ROWS of them
+  for (int i=0; i<op_boot_len; i++) {
+    n += (op_boot[i] == '\n');
+  }
+  first = (n > OLED_ROWS) ? (n - OLED_ROWS) : 0;
+  if (DisplayEnabled) {
+    line = op_boot;
+    for (int i=0; i<n; i++) {
+      end = (char *) memchr(line, '\n', op_boot_len - (line - op_boot));
+      *end = 0;
+      if (i >= first) {
+        oled_head = (oled_head + 1) % OLED_RING;
+        OLED_setline(OLED_ROWS-1, line);
+      }
+      *end = '\n';
+      line = end + 1;
+    }
+    OLED_update();
+  }
+
+  if (SD_exists) {
+    SD.remove(OP_BOOT_FILE);
+    fp = SD.open(OP_BOOT_FILE, FILE_WRITE);
+    if (fp) {
+      fp.write((const uint8_t *) op_boot, op_boot_len);
+      fp.close();
+    }
+    else {
+      Output ("OP:BOOT.log ERR");
+    }
+  }
 }
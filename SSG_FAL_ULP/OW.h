@@ -0,0 +1,311 @@
+/*
+ * ======================================================================================================================
+ *  OW.h - One Wire over a SERCOM UART
+ *
+ *  Built with STN_DS_UART 1 the DS18B20 bus is run by SERCOM1 as a UART instead of bit-banging DS0_PIN with the
+ *  interrupts off for each slot. TX (D11) drives the bus through an open drain buffer, or a Schottky diode with its
+ *  cathode at TX, RX (D10) is on the bus with the 4.7K pull-up. Each byte the UART sends is one time slot and the
+ *  byte it hears back is what the bus did, the usual 1-Wire over UART timing:
+ *
+ *    Reset   9600 baud, send 0xF0 (520us low), a probe's presence pulse pulls the high bits of the echo low
+ *    Write 1 115200 baud, send 0xFF, the start bit is the 8.7us low of the slot
+ *    Write 0 115200 baud, send 0x00, 78us low
+ *    Read    send 0xFF, the echo is 0xFF for a 1, a probe holding the bus turns the low bits to 0's for a 0
+ *
+ *  Bytes are eight slots moved by two DMA channels, RX below TX so it wins arbitration and the echo never overruns,
+ *  a scratchpad read is 72 slots in one transfer. The core sleeps in LowPower.idle() while the DMAC moves them, the
+ *  interrupts stay on for the gauge sampler. OneWireUart has the methods of OneWire that DS.h uses, so DS.h is the
+ *  same for either, and the CRCs are still OneWire::crc8() and OneWire::crc16().
+ * ======================================================================================================================
+ */
+#if STN_DS_UART
+#include "wiring_private.h"       // pinPeripheral()
+
+#define OW_SERCOM         SERCOM1
+#define OW_DMAC_ID_TX     SERCOM1_DMAC_ID_TX
+#define OW_DMAC_ID_RX     SERCOM1_DMAC_ID_RX
+#define OW_TX_PIN         11                  // PA16 SERCOM1/PAD[0]
+#define OW_RX_PIN         10                  // PA18 SERCOM1/PAD[2]
+#define OW_RESET_BAUD     9600
+#define OW_SLOT_BAUD      115200
+#define OW_SLOTS_MAX      72                  // 9 byte scratchpad
+#define OW_TIMEOUT_MS     20                  // Longest transfer is under 7ms
+
+Uart ow_uart(&sercom1, OW_RX_PIN, OW_TX_PIN, SERCOM_RX_PAD_2, UART_TX_PAD_0);
+
+void SERCOM1_Handler() {
+  ow_uart.IrqHandler();
+}
+
+class OneWireUart {
+  public:
+    uint8_t reset();
+    void select(const uint8_t rom[8]);
+    void skip();
+    void write(uint8_t v, uint8_t power = 0);
+    void write_bytes(const uint8_t *buf, uint16_t count, bool power = 0);
+    uint8_t read();
+    void read_bytes(uint8_t *buf, uint16_t count);
+    void write_bit(uint8_t v);
+    uint8_t read_bit();
+    void depower() { }                        // No strong pull-up, probes are not parasite powered
+    void reset_search();
+    bool search(uint8_t *newAddr, bool search_mode = true);
+
+  private:
+    bool begun = false;
+    uint8_t tx[OW_SLOTS_MAX];
+    uint8_t rx[OW_SLOTS_MAX];
+    uint8_t ROM_NO[8];
+    uint8_t LastDiscrepancy;
+    uint8_t LastFamilyDiscrepancy;
+    bool LastDeviceFlag;
+
+    void begin();
+    void baud(uint32_t b);
+    uint8_t slot(uint8_t v);
+    void slots(int n);
+};
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::begin() - SERCOM1 as a UART on D10 and D11, the receive interrupt off, the bytes are for the DMAC
+ *=======================================================================================================================
+ */
+void OneWireUart::begin() {
+  ow_uart.begin(OW_SLOT_BAUD);
+  pinPeripheral(OW_RX_PIN, PIO_SERCOM);
+  pinPeripheral(OW_TX_PIN, PIO_SERCOM);
+  OW_SERCOM->USART.INTENCLR.reg = SERCOM_USART_INTENCLR_MASK;
+  reset_search();
+  begun = true;
+}
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::baud() - Change the rate, BAUD is written with the UART off. GCLK0 stays at 48 MHz under CK.h.
+ *=======================================================================================================================
+ */
+void OneWireUart::baud(uint32_t b) {
+  OW_SERCOM->USART.CTRLA.bit.ENABLE = 0;
+  while (OW_SERCOM->USART.SYNCBUSY.bit.ENABLE);
+  OW_SERCOM->USART.BAUD.reg = 65536 - (uint16_t) (((uint64_t) 65536 * 16 * b) / SERCOM_FREQ_REF);
+  OW_SERCOM->USART.CTRLA.bit.ENABLE = 1;
+  while (OW_SERCOM->USART.SYNCBUSY.bit.ENABLE);
+}
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::slot() - Send one byte, return its echo, 0 if none came back
+ *=======================================================================================================================
+ */
+uint8_t OneWireUart::slot(uint8_t v) {
+  unsigned long start = millis();
+
+  while (OW_SERCOM->USART.INTFLAG.bit.RXC) {
+    (void) OW_SERCOM->USART.DATA.reg;         // Left from before
+  }
+  OW_SERCOM->USART.DATA.reg = v;
+  while (!OW_SERCOM->USART.INTFLAG.bit.RXC) {
+    if ((millis() - start) > OW_TIMEOUT_MS) {
+      return (0);
+    }
+  }
+  return (OW_SERCOM->USART.DATA.reg);
+}
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::slots() - Send tx[0..n-1] and take the echo into rx[] by DMA
+ *=======================================================================================================================
+ */
+void OneWireUart::slots(int n) {
+  unsigned long start = millis();
+
+  while (OW_SERCOM->USART.INTFLAG.bit.RXC) {
+    (void) OW_SERCOM->USART.DATA.reg;
+  }
+  dma_start(DMA_CH_OW_RX, OW_DMAC_ID_RX, DMAC_BTCTRL_BEATSIZE_BYTE,
+    &OW_SERCOM->USART.DATA.reg, false, rx, true, n);
+  dma_start(DMA_CH_OW_TX, OW_DMAC_ID_TX, DMAC_BTCTRL_BEATSIZE_BYTE,
+    tx, true, &OW_SERCOM->USART.DATA.reg, false, n);
+  while (!dma_done[DMA_CH_OW_RX] && ((millis() - start) <= OW_TIMEOUT_MS)) {
+    LowPower.idle();  // SysTick each ms, the DMAC when the echo is in
+  }
+  dma_stop(DMA_CH_OW_TX);
+  if (!dma_done[DMA_CH_OW_RX]) {
+    dma_stop(DMA_CH_OW_RX);
+    memset (rx, 0, n);                        // Reads as a shorted bus, the CRC fails
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::reset() - Reset pulse, 1 if a probe answered with a presence pulse
+ *=======================================================================================================================
+ */
+uint8_t OneWireUart::reset() {
+  uint8_t echo;
+
+  if (!begun) {
+    begin();
+  }
+  baud(OW_RESET_BAUD);
+  echo = slot(0xF0);
+  baud(OW_SLOT_BAUD);
+  return ((echo != 0xF0) && (echo != 0x00));  // 0x00 is a bus stuck low, or no echo
+}
+
+void OneWireUart::write_bit(uint8_t v) {
+  slot((v) ? 0xFF : 0x00);
+}
+
+uint8_t OneWireUart::read_bit() {
+  return (slot(0xFF) == 0xFF);
+}
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::write_bytes() - Bytes LSB first, OW_SLOTS_MAX slots at a time
+ *=======================================================================================================================
+ */
+void OneWireUart::write_bytes(const uint8_t *buf, uint16_t count, bool power) {
+  int n;
+
+  (void) power;
+  while (count) {
+    n = 0;
+    while (count && (n < OW_SLOTS_MAX)) {
+      for (uint8_t m=0x01; m; m <<= 1) {
+        tx[n++] = (*buf & m) ? 0xFF : 0x00;
+      }
+      buf++;
+      count--;
+    }
+    slots(n);
+  }
+}
+
+void OneWireUart::write(uint8_t v, uint8_t power) {
+  write_bytes(&v, 1, power);
+}
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::read_bytes() - Read slots, a byte's bit is 1 when its echo came back untouched
+ *=======================================================================================================================
+ */
+void OneWireUart::read_bytes(uint8_t *buf, uint16_t count) {
+  int n;
+
+  while (count) {
+    n = (count < (OW_SLOTS_MAX / 8)) ? count * 8 : OW_SLOTS_MAX;
+    memset (tx, 0xFF, n);
+    slots(n);
+    for (int i=0; i<n; i+=8) {
+      *buf = 0;
+      for (int b=0; b<8; b++) {
+        if (rx[i+b] == 0xFF) {
+          *buf |= (1 << b);
+        }
+      }
+      buf++;
+      count--;
+    }
+  }
+}
+
+uint8_t OneWireUart::read() {
+  uint8_t v;
+
+  read_bytes(&v, 1);
+  return (v);
+}
+
+void OneWireUart::select(const uint8_t rom[8]) {
+  uint8_t cmd[9];
+
+  cmd[0] = 0x55;                              // Match ROM
+  memcpy (cmd + 1, rom, 8);
+  write_bytes(cmd, sizeof(cmd));
+}
+
+void OneWireUart::skip() {
+  write(0xCC);                                // Skip ROM
+}
+
+void OneWireUart::reset_search() {
+  LastDiscrepancy = 0;
+  LastDeviceFlag = false;
+  LastFamilyDiscrepancy = 0;
+  memset (ROM_NO, 0, sizeof(ROM_NO));
+}
+
+/*
+ *=======================================================================================================================
+ * OneWireUart::search() - Next ROM on the bus, the search of Maxim AN187 as OneWire::search() has it. search_mode
+ *   false is the Alarm Search (0xEC), only probes whose alarm flag is set answer.
+ *=======================================================================================================================
+ */
+bool OneWireUart::search(uint8_t *newAddr, bool search_mode) {
+  uint8_t id_bit_number = 1;
+  uint8_t last_zero = 0;
+  uint8_t rom_byte_number = 0;
+  uint8_t rom_byte_mask = 1;
+  uint8_t id_bit, cmp_id_bit, dir;
+  bool found = false;
+
+  if (!LastDeviceFlag) {
+    if (!reset()) {
+      reset_search();
+      return (false);
+    }
+    write((search_mode) ? 0xF0 : 0xEC);
+    do {
+      id_bit = read_bit();
+      cmp_id_bit = read_bit();
+      if (id_bit && cmp_id_bit) {
+        break;                                // No probe answered
+      }
+      if (id_bit != cmp_id_bit) {
+        dir = id_bit;
+      }
+      else {
+        dir = (id_bit_number < LastDiscrepancy) ? ((ROM_NO[rom_byte_number] & rom_byte_mask) != 0) :
+                                                  (id_bit_number == LastDiscrepancy);
+        if (dir == 0) {
+          last_zero = id_bit_number;
+          if (last_zero < 9) {
+            LastFamilyDiscrepancy = last_zero;
+          }
+        }
+      }
+      if (dir) {
+        ROM_NO[rom_byte_number] |= rom_byte_mask;
+      }
+      else {
+        ROM_NO[rom_byte_number] &= ~rom_byte_mask;
+      }
+      write_bit(dir);
+      id_bit_number++;
+      rom_byte_mask <<= 1;
+      if (rom_byte_mask == 0) {
+        rom_byte_number++;
+        rom_byte_mask = 1;
+      }
+    } while (rom_byte_number < 8);
+
+    if (id_bit_number >= 65) {
+      LastDiscrepancy = last_zero;
+      LastDeviceFlag = (LastDiscrepancy == 0);
+      found = true;
+    }
+  }
+  if (!found || !ROM_NO[0]) {
+    reset_search();
+    return (false);
+  }
+  memcpy (newAddr, ROM_NO, 8);
+  return (true);
+}
+#endif
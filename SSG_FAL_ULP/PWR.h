@@ -0,0 +1,540 @@
+/*
+ * ======================================================================================================================
+ *  PWR.h - Battery Power Profiles
+ *
+ *  After each logged observation the battery voltage picks the profile for the next one. The voltage is smoothed
+ *  and projected PWR_LOOKAHEAD observations ahead on its current trend, so a falling battery steps down early.
+ *  Stepping back up needs the smoothed voltage PWR_HYST above the threshold.
+ *
+ *    NORMAL   - As configured
+ *    SAVE     - Half the gauge samples, no DS18B20 retry, BMX oversampling x1, interval >= 15m, OLED off,
+ *               no gauge level events
+ *    CRITICAL - Quarter of the gauge samples, as SAVE otherwise, interval >= 60m
+ *
+ *  The profile in use is in SystemStatusBits as SSB_PWR_SAVE or SSB_PWR_CRIT.
+ *
+ *  Runtime - With pwr_until set to the date of the next site visit (YYYYMMDD) the interval is also stretched so the
+ *  battery lasts until then. The smoothed voltage is compared with what it was PWR_RT_SPAN_S before for the mV a
+ *  day it falls. The charge a day takes at an interval is the awake charge of a cycle, from the energy monitor or
+ *  the phase times at PWR_AWAKE_MA, times the cycles a day, plus the sleep current all day. The rate is scaled by
+ *  that charge to each interval that divides a day, from obs_interval up, and the shortest one that keeps the
+ *  battery above pwr_empty until the visit is used. When none does the longest is used with the SAVE profile. The
+ *  days left at the interval in use are logged as "rtd".
+ * ======================================================================================================================
+ */
+#define PWR_NORMAL        0
+#define PWR_SAVE          1
+#define PWR_CRITICAL      2
+
+#define PWR_HYST          50        // mV above a threshold before stepping back up
+#define PWR_LOOKAHEAD     4         // Observations the trend is projected ahead
+#define PWR_SMOOTH        4         // A new reading moves the smoothed voltage 1/PWR_SMOOTH of the way
+
+#define PWR_RT_SPAN_S     21600     // Seconds between rate measurements
+#define PWR_AWAKE_MA      20        // Awake current of the board and gauge without an energy monitor
+#define PWR_SLEEP_UA      150       // Sleep current without an energy monitor
+
+int pwr_profile = PWR_NORMAL;
+int pwr_vavg = 0;                   // Smoothed battery mV, 0 until the first reading
+int pwr_vtrend = 0;                 // Change in pwr_vavg per observation
+
+const int pwr_rt_list[] = {1, 2, 3, 4, 5, 6, 10, 12, 15, 20, 30, 60, 120, 180, 240, 360};  // Minutes dividing a day
+#define PWR_RT_COUNT      (sizeof(pwr_rt_list) / sizeof(pwr_rt_list[0]))
+
+int pwr_rt_minutes = 0;             // Interval the runtime needs, 0 = as configured
+bool pwr_rt_save = false;           // Not even the longest interval lasts, SAVE profile
+int32_t pwr_rt_rate = 0;            // Battery mV a day, negative when falling
+bool pwr_rt_known = false;          // pwr_rt_rate measured
+int pwr_rt_days = -1;               // Days left at the interval in use, -1 = not known
+uint32_t pwr_rt_at = 0;             // Start of the span the rate is measured over
+int pwr_rt_v = 0;                   // pwr_vavg then
+
+extern bool ss_display;             // SS.h, the season lets the OLED on
+
+/*
+ *=======================================================================================================================
+ * pwr_minutes() - Observation interval of a profile
+ *=======================================================================================================================
+ */
+int pwr_minutes(int profile) {
+  int minutes = (obs_cadence && (profile == PWR_NORMAL)) ? obs_cadence : cf_obs_interval;
+
+  minutes = (pwr_rt_minutes > minutes) ? pwr_rt_minutes : minutes;  // The battery can only make it longer
+
+  if ((profile != PWR_NORMAL) && (minutes < ((profile == PWR_SAVE) ? 15 : 60))) {
+    return ((profile == PWR_SAVE) ? 15 : 60);  // Both divide a day so slots still line up at midnight
+  }
+  return (minutes);
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_rt_charge() - uA seconds a day observing every minutes
+ *=======================================================================================================================
+ */
+uint64_t pwr_rt_charge(int minutes) {
+  uint64_t awake = 0;               // uA seconds a cycle
+  uint64_t sleep_ua = PWR_SLEEP_UA;
+
+  if (en_found && en_last_valid && (pwr_vavg > 0)) {
+    for (int i=0; i<PH_COUNT; i++) {
+      awake += (uint64_t) en_last[i] * 1000 / pwr_vavg;  // uJ / mV
+    }
+    sleep_ua = (en_sleep_ua > 0) ? en_sleep_ua : 0;
+  }
+  else if (ph_last_valid) {
+    for (int i=0; i<PH_COUNT; i++) {
+      awake += (uint64_t) ph_last[i] * PWR_AWAKE_MA / 1000;
+    }
+  }
+  return ((awake * 1440 / minutes) + (sleep_ua * 86400));
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_runtime() - Measure the discharge rate and pick the interval that lasts until pwr_until
+ *=======================================================================================================================
+ */
+void pwr_runtime() {
+  uint32_t now = tm_now();
+  uint32_t until;
+  int32_t rate, left, need;
+  uint64_t q_now;
+  int i;
+
+  if (!cf_pwr_until) {
+    pwr_rt_minutes = 0;
+    pwr_rt_save = false;
+    pwr_rt_days = -1;
+    return;
+  }
+  if (!pwr_rt_at) {
+    pwr_rt_at = now;
+    pwr_rt_v = pwr_vavg;
+    return;
+  }
+  if ((now - pwr_rt_at) >= PWR_RT_SPAN_S) {
+    rate = (int32_t) (((int64_t) (pwr_vavg - pwr_rt_v) * 86400) / (int32_t) (now - pwr_rt_at));
+    pwr_rt_rate = (pwr_rt_known) ? pwr_rt_rate + ((rate - pwr_rt_rate) / 2) : rate;
+    pwr_rt_known = true;
+    pwr_rt_at = now;
+    pwr_rt_v = pwr_vavg;
+  }
+  if (!pwr_rt_known) {
+    return;
+  }
+
+  left = pwr_vavg - (cf_pwr_empty * 10);
+  if (pwr_rt_rate >= 0) {
+    pwr_rt_minutes = 0;   // Charging, or holding
+    pwr_rt_save = false;
+    pwr_rt_days = 9999;
+    return;
+  }
+  if (left <= 0) {
+    pwr_rt_days = 0;
+    return;               // Past saving, the thresholds have it
+  }
+  until = DateTime(cf_pwr_until / 10000, (cf_pwr_until / 100) % 100, cf_pwr_until % 100, 0, 0, 0).unixtime();
+  need = (until > now) ? (int32_t) ((until - now + 86399) / 86400) : 0;
+  q_now = pwr_rt_charge(pwr_minutes(pwr_profile));
+  if (q_now == 0) {
+    return;               // Nothing measured to scale by
+  }
+
+  for (i=0; i<(int)PWR_RT_COUNT; i++) {
+    if ((pwr_rt_list[i] >= cf_obs_interval) &&
+        (((uint64_t) left * q_now) >= ((uint64_t) need * (-pwr_rt_rate) * pwr_rt_charge(pwr_rt_list[i])))) {
+      break;
+    }
+  }
+  pwr_rt_save = (i == (int)PWR_RT_COUNT);
+  pwr_rt_minutes = (pwr_rt_save) ? pwr_rt_list[PWR_RT_COUNT-1] : pwr_rt_list[i];
+  pwr_rt_days = (int) (((uint64_t) left * q_now) / ((uint64_t) (-pwr_rt_rate) * pwr_rt_charge(pwr_rt_minutes)));
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_apply() - Set the sampling knobs of each module for a profile
+ *=======================================================================================================================
+ */
+void pwr_apply(int profile) {
+  int minutes = pwr_minutes(profile);
+  bool display = (oled_type != 0) && ss_display;
+
+  SystemStatusBits &= ~(SSB_PWR_SAVE | SSB_PWR_CRIT);
+
+  if (profile == PWR_NORMAL) {
+    sg_samples = cf_sg_samples;
+    ds_retry = true;
+    bmx_osr = cf_bmx_osr;
+  }
+  else {
+    sg_samples = (profile == PWR_SAVE) ? cf_sg_samples/2 : cf_sg_samples/4;
+    sg_samples = (sg_samples < 1) ? 1 : sg_samples;
+    ds_retry = false;
+    bmx_osr = 1;
+    display = false;
+    if (sg_burst) {
+      sg_burst = false;  // Level events keep the gauge powered, normal profile only
+      SystemStatusBits &= ~SSB_SG_BURST;
+    }
+    SystemStatusBits |= (profile == PWR_SAVE) ? SSB_PWR_SAVE : SSB_PWR_CRIT;
+  }
+
+  if (BMX_1_exists) {
+    bmx_configure(0);
+  }
+  if (BMX_2_exists) {
+    bmx_configure(1);
+  }
+
+  // Next slot on the new interval, counted from the slot just observed
+  obs_interval_s = (uint32_t) ((sg_burst) ? cf_sg_burst : minutes) * 60;
+  if (obs_slot_epoch) {
+    obs_next_epoch = (obs_slot_epoch / obs_interval_s + 1) * obs_interval_s;
+  }
+  if (BMX_1_exists) {
+    bm3_configure(0);  // FIFO data rate follows the interval
+  }
+  if (BMX_2_exists) {
+    bm3_configure(1);
+  }
+
+  if (display != DisplayEnabled) {
+    if (display) {
+      DisplayEnabled = true;
+      OLED_wakeDisplay();
+    }
+    else {
+      OLED_sleepDisplay();
+      DisplayEnabled = false;
+    }
+    Headless = (!DisplayEnabled && !SerialConsoleEnabled);
+  }
+  pwr_profile = profile;
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_update() - Pick the profile from the battery voltage and its trend
+ *=======================================================================================================================
+ */
+void pwr_update(int batt) {
+  int vprev = pwr_vavg;
+  int vlow;
+  int profile = PWR_NORMAL;
+  int minutes = pwr_minutes(pwr_profile);
+
+  if (!cf_pwr_save && !cf_pwr_crit && !cf_pwr_until) {
+    return;
+  }
+
+  if (pwr_vavg == 0) {
+    pwr_vavg = batt;
+    pwr_vtrend = 0;
+  }
+  else {
+    pwr_vavg += (batt - pwr_vavg) / PWR_SMOOTH;
+    pwr_vtrend = pwr_vavg - vprev;
+  }
+
+  // Falling battery counts at its projected voltage, a rising one at what it is now
+  vlow = (pwr_vtrend < 0) ? pwr_vavg + (pwr_vtrend * PWR_LOOKAHEAD) : pwr_vavg;
+
+  if (cf_pwr_crit && (vlow < (cf_pwr_crit * 10))) {
+    profile = PWR_CRITICAL;
+  }
+  else if (cf_pwr_save && (vlow < (cf_pwr_save * 10))) {
+    profile = PWR_SAVE;
+  }
+
+  // Step up only once clear of the threshold we are under
+  if (profile < pwr_profile) {
+    if ((pwr_profile == PWR_CRITICAL) && (pwr_vavg < ((cf_pwr_crit * 10) + PWR_HYST))) {
+      profile = PWR_CRITICAL;
+    }
+    else if ((profile == PWR_NORMAL) && cf_pwr_save && (pwr_vavg < ((cf_pwr_save * 10) + PWR_HYST))) {
+      profile = PWR_SAVE;
+    }
+  }
+
+  pwr_runtime();
+  if (pwr_rt_save && (profile == PWR_NORMAL)) {
+    profile = PWR_SAVE;
+  }
+
+  if (profile != pwr_profile) {
+    LOG_INFO ("PWR:%s %d.%02dV",
+      (profile == PWR_NORMAL) ? "NORMAL" : ((profile == PWR_SAVE) ? "SAVE" : "CRITICAL"),
+      pwr_vavg / 1000, (pwr_vavg % 1000) / 10);
+    pwr_apply(profile);
+  }
+  else if (pwr_minutes(profile) != minutes) {
+    LOG_INFO ("PWR:%dm For %d Days", pwr_minutes(profile), pwr_rt_days);
+    pwr_apply(profile);
+  }
+}
+
+
+/*
+ * ======================================================================================================================
+ *  Sleep Current - In standby the SAMD21 stops every APB and generic clock not set to run in standby, so what is left
+ *    to leak is in the pins and the analog side. Header pins nothing is wired to would float, at boot they become
+ *    pulled up inputs (pwr_park=1). Around each sleep the SPI bus is released: SERCOM4 is reset, SCK and MOSI are
+ *    held low, MISO, which the deselected card leaves floating, is pulled up and CS stays high. The ADC is turned
+ *    off unless a gauge level event is watched. The APB clocks of peripherals the sketch never uses are gated at
+ *    boot, that is for the awake current, standby has them off already.
+ * ======================================================================================================================
+ */
+const uint8_t pwr_header_pins[] = { 0, 1, 5, 6, 10, 11, A0, A1, A2, A4, A5 };  // Not SD CS, LEDs, VBAT, A3, I2C, SPI
+
+/*
+ *=======================================================================================================================
+ * pwr_pin_used() - Pin is set up by the configuration
+ *=======================================================================================================================
+ */
+bool pwr_pin_used(int pin) {
+  for (int c=0; c<sg_chans; c++) {
+    if (pin == sg_chan_pins[c]) {
+      return (true);
+    }
+  }
+  return ((pin == SCE_PIN) || DS_PIN_USED(pin) || (pin == cf_sg_pwr_pin) || (pin == cf_sg_pw_pin) ||
+          (pin == cf_sg_trig_pin) || (pin == cf_sm_btn_pin) || (STN_SD_PWR && (pin == STN_SD_PWR)) ||
+          (pin == cf_rtc_int_pin) || (cf_rtc_32k_pin && (pin == cf_rtc_32k_pin)) ||
+          (cf_sg_serial && ((pin == 0) || (pin == 1))) ||
+          (cf_tl && ((pin == 1) || (pin == cf_tl_pin))) || (cf_sh_uart && ((pin == 0) || (pin == 1))));
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_park_pins() - At boot, pull up the header pins not in use and gate the clocks of unused peripherals
+ *=======================================================================================================================
+ */
+void pwr_park_pins() {
+  int n = 0;
+
+  if (!cf_pwr_park) {
+    return;
+  }
+  for (unsigned int i=0; i<sizeof(pwr_header_pins); i++) {
+    if (!pwr_pin_used(pwr_header_pins[i])) {
+      pinMode(pwr_header_pins[i], INPUT_PULLUP);
+      n++;
+    }
+  }
+
+  // The core's init() clocks every SERCOM and TCC for Serial and PWM
+  PM->APBCMASK.reg &= ~(PM_APBCMASK_SERCOM2 | PM_APBCMASK_SERCOM5 | PM_APBCMASK_TCC0 |
+                        PM_APBCMASK_TCC1 | PM_APBCMASK_DAC | PM_APBCMASK_AC);
+#if !STN_DS_UART
+  PM->APBCMASK.reg &= ~PM_APBCMASK_SERCOM1;  // One Wire UART, OW.h
+#endif
+  if (!cf_sg_serial && !cf_tl && !cf_sh_uart) {
+    PM->APBCMASK.reg &= ~PM_APBCMASK_SERCOM0;  // Serial1
+  }
+  LOG_INFO ("PWR:%d Pins Parked", n);
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_sleep_prepare() - Release the SPI bus and the ADC before LowPower.sleep()
+ *=======================================================================================================================
+ */
+void pwr_sleep_prepare() {
+  iq_drain();  // Nothing left on the I2C bus for standby to stop
+  if (!cf_pwr_park) {
+    return;
+  }
+  if (SD_exists) {
+    SPI.end();
+    pinMode(SCK, OUTPUT);
+    digitalWrite(SCK, LOW);
+    pinMode(MOSI, OUTPUT);
+    digitalWrite(MOSI, LOW);
+    pinMode(MISO, (SdVolume::sdCard()->poweredDown()) ? INPUT : INPUT_PULLUP);  // No pull up into a card that is off
+  }
+  if (!sg_event_armed) {
+    ADC->CTRLA.bit.ENABLE = 0;
+    while (ADC->STATUS.bit.SYNCBUSY);
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_wake_restore() - SPI back for the SD card, the ADC is enabled by whoever converts next
+ *=======================================================================================================================
+ */
+void pwr_wake_restore() {
+  if (cf_pwr_park && SD_exists) {
+    SPI.begin();  // Pin mux and SERCOM4, each SD transfer sets its own speed
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Brownout Early Warning - With pwr_bod set BOD33 watches the 3.3V rail, which follows the battery once the
+ *    regulator drops out, and raises an interrupt at pwr_bod. The part has the one BOD33, so while it is armed for
+ *    the warning it does not reset, the interrupt puts it straight back to the reset the fuses set well below
+ *    (PWR_BOD_RESET_LEVEL when the fuses leave it off) and sets pwr_bod_hit. A rail that falls from pwr_bod to the
+ *    reset level within one sample (PWR_BOD_PSEL) can pass it unseen, pwr_bod must sit well above the reset.
+ *    pwr_bod_service(), at the top of each cycle and after each sleep, then flushes what is held (SD_Close(), the
+ *    journal is done with it, and the warm start snapshot), notes a clean shutdown in memory a reset keeps and
+ *    sleeps with the reset in place, waking every PWR_BOD_CHECK_MS only to look at the rail, until it is clear of
+ *    pwr_bod again with the hysteresis, then arms the warning again. If the rail collapses instead the board resets,
+ *    the next boot finds the note, when the RAM kept it, and records EV_PWR_CLEAN. Records held while the card is
+ *    down stay in RAM. The monitor samples the rail, so it also runs in standby.
+ *
+ *    The LEVEL of a voltage is from the datasheet's table, 7 = 1.75V, 39 = 2.84V, 48 = 3.2V, about 35mV a step.
+ * ======================================================================================================================
+ */
+#define PWR_BOD_MV0       1502              // LEVEL 0
+#define PWR_BOD_STEP_UV   35370             // uV a LEVEL
+#define PWR_BOD_CHECK_MS  60000             // Sleep between looks at the rail while parked
+#define PWR_BOD_RESET_LEVEL 39              // 2.84V, the reset the bootloader's fuses set, when they leave it off
+#define PWR_BOD_PSEL      SYSCTRL_BOD33_PSEL_DIV256  // Warning sampled every 256ms of the 1kHz clock
+#define PWR_BOD_MAGIC     0x424F4453        // "SBOB", pwr_bod_noted
+
+void ws_save();                             // WS.h, snapshot before the rail goes
+
+volatile bool pwr_bod_hit = false;          // Set by the interrupt
+uint32_t pwr_bod_warn = 0;                  // BOD33 armed for the warning, 0 = pwr_bod off
+uint32_t pwr_bod_reset;                     // BOD33 resetting, as the fuses set it
+uint32_t pwr_bod_noted __attribute__ ((section (".noinit")));  // Flushed and parked, kept over the reset
+
+/*
+ *=======================================================================================================================
+ * pwr_bod_write() - BOD33 to reg, its fields are set with it off
+ *=======================================================================================================================
+ */
+void pwr_bod_write(uint32_t reg) {
+  SYSCTRL->BOD33.bit.ENABLE = 0;
+  while (!SYSCTRL->PCLKSR.bit.B33SRDY);
+  SYSCTRL->BOD33.reg = reg & ~SYSCTRL_BOD33_ENABLE;
+  while (!SYSCTRL->PCLKSR.bit.B33SRDY);
+  if (reg & SYSCTRL_BOD33_MODE) {
+    SYSCTRL->BOD33.bit.CEN = 1;   // Sampling clock
+    while (!SYSCTRL->PCLKSR.bit.B33SRDY);
+  }
+  SYSCTRL->BOD33.bit.ENABLE = 1;
+  while (!SYSCTRL->PCLKSR.bit.B33SRDY);
+  while (!SYSCTRL->PCLKSR.bit.BOD33RDY);
+}
+
+/*
+ *=======================================================================================================================
+ * SYSCTRL_Handler() - BOD33 early warning, back to the reset until pwr_bod_service() arms it again
+ *=======================================================================================================================
+ */
+void SYSCTRL_Handler() {
+  if (SYSCTRL->INTFLAG.reg & SYSCTRL_INTFLAG_BOD33DET) {
+    SYSCTRL->INTENCLR.reg = SYSCTRL_INTENCLR_BOD33DET;
+    pwr_bod_write(pwr_bod_reset);
+    SYSCTRL->INTFLAG.reg = SYSCTRL_INTFLAG_BOD33DET;
+    pwr_bod_hit = true;
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_bod_arm() - BOD33 to the warning, then clear and enable its interrupt
+ *=======================================================================================================================
+ */
+void pwr_bod_arm() {
+  pwr_bod_write(pwr_bod_warn);
+  SYSCTRL->INTFLAG.reg = SYSCTRL_INTFLAG_BOD33DET;
+  SYSCTRL->INTENSET.reg = SYSCTRL_INTENSET_BOD33DET;
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_bod_low() - Rail still under pwr_bod, BOD33 looks at it with the warning's level and hysteresis for as long
+ *   as it takes to settle and goes back to the reset
+ *=======================================================================================================================
+ */
+bool pwr_bod_low() {
+  bool low;
+
+  pwr_bod_write(pwr_bod_warn & ~SYSCTRL_BOD33_MODE);  // Continuous, the level is there once it is ready
+  low = SYSCTRL->PCLKSR.bit.BOD33DET;
+  pwr_bod_write(pwr_bod_reset);
+  return (low);
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_bod_initialize() - BOD33 to an interrupt at pwr_bod above its reset, call once after the config is read
+ *=======================================================================================================================
+ */
+void pwr_bod_initialize() {
+  int level, reset;
+
+  if ((pwr_bod_noted == PWR_BOD_MAGIC) && !(PM->RCAUSE.reg & PM_RCAUSE_EXT)) {
+    ev_note (EV_PWR_CLEAN, 0);  // The rail went after we were ready for it
+  }
+  pwr_bod_noted = 0;
+  if (!cf_pwr_bod) {
+    return;
+  }
+
+  // The reset the fuses set stays whenever the warning is not armed, it runs in standby too
+  pwr_bod_reset = SYSCTRL->BOD33.reg;
+  if (!(pwr_bod_reset & SYSCTRL_BOD33_ENABLE) ||
+      ((pwr_bod_reset & SYSCTRL_BOD33_ACTION_Msk) != SYSCTRL_BOD33_ACTION_RESET)) {
+    pwr_bod_reset = SYSCTRL_BOD33_LEVEL(PWR_BOD_RESET_LEVEL) | SYSCTRL_BOD33_ACTION_RESET | SYSCTRL_BOD33_HYST |
+                    SYSCTRL_BOD33_ENABLE;
+  }
+  pwr_bod_reset = (pwr_bod_reset & ~(SYSCTRL_BOD33_MODE | SYSCTRL_BOD33_CEN)) | SYSCTRL_BOD33_RUNSTDBY;
+  reset = (pwr_bod_reset & SYSCTRL_BOD33_LEVEL_Msk) >> SYSCTRL_BOD33_LEVEL_Pos;
+
+  level = (((cf_pwr_bod * 10) - PWR_BOD_MV0) * 1000L + PWR_BOD_STEP_UV - 1) / PWR_BOD_STEP_UV;  // At or above
+  if ((level <= reset) || (level > 63)) {
+    LOG_ERR ("PWR:bod %d ERR, Reset Level %d", cf_pwr_bod, reset);
+    return;
+  }
+  pwr_bod_warn = SYSCTRL_BOD33_LEVEL(level) | SYSCTRL_BOD33_ACTION_INT | SYSCTRL_BOD33_HYST |
+                 SYSCTRL_BOD33_RUNSTDBY | SYSCTRL_BOD33_MODE | PWR_BOD_PSEL | SYSCTRL_BOD33_ENABLE;
+
+  pwr_bod_arm();
+  NVIC_SetPriority(SYSCTRL_IRQn, 0);
+  NVIC_EnableIRQ(SYSCTRL_IRQn);
+  LOG_INFO ("PWR:BOD33 %d.%02dV Level %d", cf_pwr_bod / 100, cf_pwr_bod % 100, level);
+}
+
+/*
+ *=======================================================================================================================
+ * pwr_bod_service() - After an early warning flush, then sleep until the rail is back, true if it did
+ *=======================================================================================================================
+ */
+bool pwr_bod_service() {
+  unsigned long parked = 0;
+
+  if (!pwr_bod_hit) {
+    return (false);
+  }
+  ev_note (EV_PWR_BOD, vbat_mv());
+  SD_Close();
+  ws_save();
+  SD_WriteWait();  // Card done programming before the rail goes
+  pwr_bod_noted = PWR_BOD_MAGIC;
+
+  OLED_sleepDisplay();
+  pwr_sleep_prepare();
+  rtc_32k_check();
+  wd_sleep();
+  while (pwr_bod_low()) {
+    LowPower.sleep(PWR_BOD_CHECK_MS);
+    parked++;
+  }
+  wd_wake();
+  pwr_wake_restore();
+  OLED_wakeDisplay();
+
+  pwr_bod_noted = 0;
+  pwr_bod_hit = false;
+  tm_wake();  // millis() stood still
+  pwr_bod_arm();
+  LOG_INFO ("PWR:Rail Back %lum", parked);
+  return (true);
+}
@@ -18,33 +18,56 @@
 #define QC_MAX_RH      100.0     // %
 #define QC_ERR_RH      -999.9    // Relative Humidity Error
 
-// Sensor SI1145
-#define QC_MIN_IR      0.0       // unitless
-#define QC_MAX_IR      16000.0   // unitless - based on the maximum readings from 43 stations located in tropics
-#define QC_ERR_IR      -999.9    // Infrared Light Error
-#define QC_MIN_VI      0.0       // unitless
-#define QC_MAX_VI      2000.0    // unitless
-#define QC_ERR_VI      -999.9    // Visual Light Error
-#define QC_MIN_UV      0.0       // unitless
-#define QC_MAX_UV      1000.0    // unitless
-#define QC_ERR_UV      -999.9    // UV Light Error
-
-// Sensor VEML7700 - Ambient Light Sensor
-#define QC_MIN_LX      0         // lx
-#define QC_MAX_LX      120000    // lx - based on sensor spec
-#define QC_ERR_LX      -999      // Ambient Light Error
-
-// Wind Speed  - world-record surface wind speed measured on Mt. Washington on April 12, 1934 (231 mph or 103 mps)
-#define QC_MIN_WS      0.0       // m/s
-#define QC_MAX_WS      103.0     // m/s
-#define QC_ERR_WS      -999.9    // Relative Humidity Error
-
-// Wind Direction
-#define QC_MIN_WD      0         // deg
-#define QC_MAX_WD      360       // deg
-#define QC_ERR_WD      -999      // deg Error
-
-// Rain Gauge 1 minute measurement 
-#define QC_MIN_RG      0         // mm
-#define QC_MAX_RG      30.0      // mm based on the world-record 1-minute rainfall in Maryland in 1956 (31.24 mm or 1.23")
-#define QC_ERR_RG      -999.9    // Rain Gauge Error
+/*
+ * ======================================================================================================================
+ *  Fixed Point - Measurements are carried as int32_t in 1/10000 of the unit (hPa, deg C, %RH, V) from the driver
+ *    to the record, the M0+ has no FPU. QC_FIX() of a limit above is folded by the compiler.
+ * ======================================================================================================================
+ */
+#define FIX_ONE        10000L
+#define FIX_NAN        INT32_MIN  // No reading
+#define QC_FIX(v)      ((int32_t) (((v) * FIX_ONE) + (((v) < 0) ? -0.5 : 0.5)))
+
+/*
+ * ======================================================================================================================
+ *  Field QC - qc_fields[] holds the limits and error value of each kind of field in FIX_ONE units, folded at compile
+ *    time. qc_check() tests a raw value against its kind with no branch on the outcome and returns a 2 bit code, so
+ *    the record can tell a sensor that gave nothing from a reading out of range. FIX_NAN is below every minimum,
+ *    3 * high + 2 * low - nan gives each case its own code. Any code other than QC_OK logs the error value.
+ * ======================================================================================================================
+ */
+#define QC_P           0         // qc_fields[] index
+#define QC_T           1
+#define QC_RH          2
+
+#define QC_OK          0
+#define QC_NONE        1         // No reading, the sensor did not answer or failed its CRC
+#define QC_LOW         2         // Below the minimum
+#define QC_HIGH        3         // Above the maximum
+#define QC_BITS        2         // Per field in a packed set of codes
+
+typedef struct {
+  int32_t min;
+  int32_t max;
+  int32_t err;
+} QC_FIELD;
+
+constexpr QC_FIELD qc_fields[] = {
+  { QC_FIX(QC_MIN_P), QC_FIX(QC_MAX_P), QC_FIX(QC_ERR_P) },
+  { QC_FIX(QC_MIN_T), QC_FIX(QC_MAX_T), QC_FIX(QC_ERR_T) },
+  { QC_FIX(QC_MIN_RH), QC_FIX(QC_MAX_RH), QC_FIX(QC_ERR_RH) },
+};
+
+/*
+ * ======================================================================================================================
+ * qc_check() - Code of raw against field kind, *value is raw or the error value
+ * ======================================================================================================================
+ */
+inline uint8_t qc_check(uint8_t kind, int32_t raw, int32_t *value) {
+  const QC_FIELD *f = &qc_fields[kind];
+  int32_t code = 3 * (raw > f->max) + 2 * (raw < f->min) - (raw == FIX_NAN);
+  int32_t bad = -(int32_t) (code != 0);  // All ones when the error value is logged
+
+  *value = (f->err & bad) | (raw & ~bad);
+  return ((uint8_t) code);
+}
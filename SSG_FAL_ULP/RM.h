@@ -0,0 +1,109 @@
+/*
+ * ======================================================================================================================
+ *  RM.h - RAM Headroom
+ *
+ *  The 32KB of RAM holds .data and .bss (msgbuf, oled_lines, SD_wb[], the gauge buffers,
+ *  the SD library cache), then the heap (File objects, the display object) growing up and the stack growing down
+ *  from the top. rm_paint() first thing in setup() fills the gap between them with RM_PAINT. Whatever the stack
+ *  reaches, or the heap takes, is overwritten, so the run of RM_PAINT left above the heap's top is the least free
+ *  RAM there has been. rm_report() prints it at boot, the first record of each hour carries
+ *  "ram":[stack,heap,free] in bytes, the deepest stack since boot, the heap in use and that least gap.
+ * ======================================================================================================================
+ */
+#include <malloc.h>
+
+#define RM_PAINT          0xA5
+#define RM_MARGIN         64        // Bytes below the stack pointer left alone by the paint, setup()'s own frame
+
+extern "C" char *sbrk(int incr);
+extern uint32_t __StackTop;         // Linker script, top of RAM
+
+uint32_t rm_hour = 0;               // Hour the last "ram" went in a record
+
+/*
+ *=======================================================================================================================
+ * rm_sp() - Stack pointer
+ *=======================================================================================================================
+ */
+char *rm_sp() {
+  return ((char *) __builtin_frame_address(0));
+}
+
+/*
+ *=======================================================================================================================
+ * rm_paint() - Fill the gap between the heap and the stack, call first in setup()
+ *=======================================================================================================================
+ */
+void rm_paint() {
+  char *p = sbrk(0);
+  char *end = rm_sp() - RM_MARGIN;
+
+  while (p < end) {
+    *p++ = RM_PAINT;
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * rm_free() - Least free bytes between heap and stack since boot
+ *=======================================================================================================================
+ */
+int rm_free() {
+  char *p = sbrk(0);
+  char *sp = rm_sp();
+
+  while ((p < sp) && (*p == RM_PAINT)) {
+    p++;
+  }
+  return (p - sbrk(0));
+}
+
+/*
+ *=======================================================================================================================
+ * rm_stack() - Deepest the stack has been, bytes below the top of RAM
+ *=======================================================================================================================
+ */
+int rm_stack() {
+  return ((char *) &__StackTop - (sbrk(0) + rm_free()));
+}
+
+/*
+ *=======================================================================================================================
+ * rm_heap() - Heap bytes in use
+ *=======================================================================================================================
+ */
+int rm_heap() {
+  return (mallinfo().uordblks);
+}
+
+/*
+ *=======================================================================================================================
+ * rm_report() - Headroom on the console
+ *=======================================================================================================================
+ */
+void rm_report() {
+  LOG_INFO ("RAM:stk %d heap %d free %d", rm_stack(), rm_heap(), rm_free());
+}
+
+/*
+ *=======================================================================================================================
+ * rm_record() - "ram" in the first record of each hour
+ *=======================================================================================================================
+ */
+void rm_record(JSONBUF *jb, uint32_t at) {
+  int mark;
+
+  if ((at / 3600) == rm_hour) {
+    return;
+  }
+  rm_hour = at / 3600;
+  mark = jb_key(jb, "ram");
+  jb_putc(jb, '[');
+  jb_putu(jb, rm_stack(), 0);
+  jb_putc(jb, ',');
+  jb_putu(jb, rm_heap(), 0);
+  jb_putc(jb, ',');
+  jb_putu(jb, rm_free(), 0);
+  jb_putc(jb, ']');
+  jb_end(jb, mark);
+}
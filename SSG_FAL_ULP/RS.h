@@ -0,0 +1,254 @@
+/*
+ * ======================================================================================================================
+ *  RS.h - Runtime Statistics
+ *
+ *  Health counters kept across reboots in RS_FILE, a contiguous file of one block: boots, observations, awake
+ *  seconds, I2C bus recoveries, the battery's lowest and highest mV and how often each event in EV.h happened, SD
+ *  open and write failures, DS CRC errors, BMX offline and online among them. The totals read at boot are the base,
+ *  every stats observations the base plus what happened since boot is written over the block in one raw block
+ *  write, no FAT or directory update. The sh "stats" command shows them. tools/obsstats.py prints the file.
+ *
+ *  SD write latencies are kept the same way, a log2 histogram of each kind: single block writes and multi-block
+ *  writes as Sd2Card reports them once the card is done programming (Sd2Card::latencyHook()), and whole flushes of
+ *  the write behind buffer. Bin 0 counts writes under 256us, bin b those from 2^(b+7) to 2^(b+8)us, the last bin
+ *  everything from 4.2s up. A card that starts to stall shows as counts moving to the right. A version 1 record
+ *  is taken with its latencies at zero.
+ * ======================================================================================================================
+ */
+#define RS_FILE           "/OBS/STATS.bin"
+#define RS_MAGIC          0x54534253        // "SBST"
+#define RS_VERSION        2
+#define RS_EV_MAX         64                // Event counters the record has room for
+#define RS_LAT_KINDS      3                 // SD_LAT_BLOCK, SD_LAT_MULTI (Sd2Card.h), SD_LAT_FLUSH (SDC.h)
+#define RS_LAT_BINS       16                // Log2 bins from 256us
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;                           // RS_MAGIC
+  uint16_t version;                         // RS_VERSION
+  uint16_t events;                          // EV_COUNT of the sketch that wrote it
+  uint32_t since;                           // Unix time of the first write
+  uint32_t at;                              // Unix time of this write
+  uint32_t boots;
+  uint32_t obs;                             // Observations taken
+  uint32_t awake_s;                         // Seconds awake in observation cycles
+  uint32_t i2c_recoveries;                  // Bus clears, SF.h
+  uint16_t vmin;                            // Battery mV, 0 until read
+  uint16_t vmax;
+  uint16_t ev[RS_EV_MAX];                   // Events by EV number
+  uint16_t lat[RS_LAT_KINDS][RS_LAT_BINS];  // SD write latency histograms, version 2
+  uint16_t crc;                             // OneWire::crc16() of the above
+} RS_STATS;                                 // 262 bytes
+
+RS_STATS rs_base;                           // Totals before this boot
+bool     rs_open = false;                   // RS_FILE found and rs_bgn set
+uint32_t rs_bgn;                            // Its SD block
+uint32_t rs_obs = 0;                        // Since boot
+uint32_t rs_awake_ms = 0;
+int      rs_pending = 0;                    // Observations since the last write
+uint16_t rs_lat[RS_LAT_KINDS][RS_LAT_BINS]; // Since boot
+
+const char *rs_lat_names[RS_LAT_KINDS] = {"blk", "multi", "flush"};
+
+/*
+ *=======================================================================================================================
+ * rs_open_file() - Find or create RS_FILE, false if it can not be used
+ *=======================================================================================================================
+ */
+bool rs_open_file() {
+  uint32_t bgn, end;
+  File fp;
+
+  if (rs_open) {
+    return (true);
+  }
+  if (!SD_exists || SD_down) {
+    return (false);
+  }
+  fp = (SD.exists(RS_FILE)) ? SD.open(RS_FILE, FILE_READ) : SD.createContiguous(RS_FILE, 512);
+  if (!fp) {
+    return (false);
+  }
+  if ((fp.size() != 512) || !fp.contiguousRange(&bgn, &end)) {
+    fp.close();
+    return (false);
+  }
+  fp.close();
+  rs_bgn = bgn;
+  rs_open = true;
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * rs_initialize() - Totals from before this boot, after the config is read
+ *=======================================================================================================================
+ */
+void rs_initialize() {
+  uint8_t *buf;
+
+  memset (&rs_base, 0, sizeof(rs_base));
+  SdVolume::sdCard()->latencyHook(rs_latency);
+  if (!cf_stats || !rs_open_file()) {
+    return;
+  }
+  buf = SdVolume::cacheClear();
+  if (SdVolume::sdCard()->readBlock(rs_bgn, buf)) {
+    memcpy (&rs_base, buf, sizeof(rs_base));
+  }
+  if ((rs_base.magic == RS_MAGIC) && (rs_base.version == 1) &&
+      (rs_base.lat[0][0] == OneWire::crc16((const uint8_t *) &rs_base, offsetof(RS_STATS, lat), 0))) {
+    memset (rs_base.lat, 0, sizeof(rs_base.lat));  // Version 1 ended with its CRC where the latencies start
+    rs_base.version = RS_VERSION;
+    rs_base.crc = OneWire::crc16((const uint8_t *) &rs_base, offsetof(RS_STATS, crc), 0);
+  }
+  if ((rs_base.magic != RS_MAGIC) || (rs_base.version != RS_VERSION) ||
+      (rs_base.crc != OneWire::crc16((const uint8_t *) &rs_base, offsetof(RS_STATS, crc), 0))) {
+    memset (&rs_base, 0, sizeof(rs_base));  // New card, or a torn write
+    rs_base.since = tm_now();
+  }
+  LOG_INFO ("RS:%lu Boots %lu Obs", (unsigned long) rs_base.boots, (unsigned long) rs_base.obs);
+}
+
+/*
+ *=======================================================================================================================
+ * rs_totals() - Base and since boot
+ *=======================================================================================================================
+ */
+void rs_totals(RS_STATS *s) {
+  *s = rs_base;
+  s->magic = RS_MAGIC;
+  s->version = RS_VERSION;
+  s->events = EV_COUNT;
+  s->since = (rs_base.since) ? rs_base.since : tm_now();
+  s->at = tm_now();
+  s->boots = rs_base.boots + 1;
+  s->obs = rs_base.obs + rs_obs;
+  s->awake_s = rs_base.awake_s + rs_awake_ms / 1000;
+  s->i2c_recoveries = rs_base.i2c_recoveries + i2c_recoveries;
+  for (int i=0; (i<EV_COUNT) && (i<RS_EV_MAX); i++) {
+    s->ev[i] = ((uint32_t) rs_base.ev[i] + ev_tally[i] < 0xFFFF) ? rs_base.ev[i] + ev_tally[i] : 0xFFFF;
+  }
+  for (int k=0; k<RS_LAT_KINDS; k++) {
+    for (int b=0; b<RS_LAT_BINS; b++) {
+      s->lat[k][b] = ((uint32_t) rs_base.lat[k][b] + rs_lat[k][b] < 0xFFFF) ? rs_base.lat[k][b] + rs_lat[k][b] : 0xFFFF;
+    }
+  }
+  s->crc = OneWire::crc16((const uint8_t *) s, offsetof(RS_STATS, crc), 0);
+}
+
+/*
+ *=======================================================================================================================
+ * rs_observation() - Count an observation and its battery reading, the last cycle's awake time with it
+ *=======================================================================================================================
+ */
+void rs_observation(int batt) {
+  rs_obs++;
+  if (ph_last_valid) {
+    for (int i=0; i<PH_COUNT; i++) {
+      rs_awake_ms += ph_last[i] / 1000;
+    }
+  }
+  if (batt > 0) {
+    rs_base.vmin = ((rs_base.vmin == 0) || (batt < rs_base.vmin)) ? batt : rs_base.vmin;
+    rs_base.vmax = (batt > rs_base.vmax) ? batt : rs_base.vmax;
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * rs_latency() - Count an SD write that took us microseconds, Sd2Card's latency hook
+ *=======================================================================================================================
+ */
+void rs_latency(uint8_t kind, uint32_t us) {
+  int b = 0;
+
+  if (kind >= RS_LAT_KINDS) {
+    return;
+  }
+  for (us >>= 8; us && (b < (RS_LAT_BINS - 1)); us >>= 1) {
+    b++;
+  }
+  if (rs_lat[kind][b] < 0xFFFF) {
+    rs_lat[kind][b]++;
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * rs_lat_ms() - Upper edge of the bin holding the pct percentile of a histogram, in whole ms rounded up
+ *=======================================================================================================================
+ */
+unsigned long rs_lat_ms(const uint16_t *h, uint32_t n, int pct) {
+  uint32_t want = (n * pct + 99) / 100;
+  uint32_t sum = 0;
+  int b;
+
+  for (b=0; b<(RS_LAT_BINS - 1); b++) {
+    sum += h[b];
+    if (sum >= want) {
+      break;
+    }
+  }
+  return (((256UL << b) + 999) / 1000);
+}
+
+/*
+ *=======================================================================================================================
+ * rs_service() - Write the totals every stats observations, call after the observation is logged, true if written
+ *=======================================================================================================================
+ */
+bool rs_service() {
+  uint8_t *buf;
+
+  if (!cf_stats || (++rs_pending < cf_stats) || !rs_open_file()) {
+    return (false);
+  }
+  rs_pending = 0;
+  buf = SdVolume::cacheClear();
+  memset (buf, 0, 512);
+  rs_totals((RS_STATS *) buf);
+  if (!SdVolume::sdCard()->writeBlock(rs_bgn, buf)) {
+    Output ("RS:Write Err");
+  }
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * rs_show() - Totals on the console, events that happened as E<number>:<count>
+ *=======================================================================================================================
+ */
+void rs_show() {
+  RS_STATS s;
+  uint32_t n;
+  int m = 0;
+
+  rs_totals(&s);
+  sprintf (msgbuf, "RS:%lu Boots %lu Obs %lus Awake", (unsigned long) s.boots, (unsigned long) s.obs,
+    (unsigned long) s.awake_s);
+  Output (msgbuf);
+  sprintf (msgbuf, "RS:I2C %lu BAT %u-%umV", (unsigned long) s.i2c_recoveries, s.vmin, s.vmax);
+  Output (msgbuf);
+  for (int k=0; k<RS_LAT_KINDS; k++) {
+    n = 0;
+    for (int b=0; b<RS_LAT_BINS; b++) {
+      n += s.lat[k][b];
+    }
+    if (n) {
+      sprintf (msgbuf, "RS:%s %lu p50<%lu p99<%lu max<%lums", rs_lat_names[k], (unsigned long) n,
+        rs_lat_ms(s.lat[k], n, 50), rs_lat_ms(s.lat[k], n, 99), rs_lat_ms(s.lat[k], n, 100));
+      Output (msgbuf);
+    }
+  }
+  for (int i=1; (i<EV_COUNT) && (i<RS_EV_MAX); i++) {
+    if (s.ev[i]) {
+      m += sprintf (msgbuf + m, "E%02d:%u ", i, s.ev[i]);
+    }
+    if ((m > 15) || ((i + 1) == EV_COUNT)) {  // A line of the OLED
+      if (m) {
+        Output (msgbuf);
+      }
+      m = 0;
+    }
+  }
+}
@@ -12,19 +12,101 @@
 #define VALUE_MAX_LENGTH  30                // Config File Value Length
 #define LINE_MAX_LENGTH   VALUE_MAX_LENGTH+KEY_MAX_LENGTH+3   // =, CR, LF 
 
+/*
+ * ======================================================================================================================
+ *  Card Power - With STN_SD_PWR (ST.h) the card is switched off after the wake's writes are done, SD_PowerDown()
+ *    before sleep. The library keeps the volume, the open files and their extents, and reads the card's CID first.
+ *    The next command to the card powers it up through SD_PowerUp(), initializes it again at the speed it had and
+ *    checks the CID, so a wake whose records are held in the write behind buffer never turns it on. A card that
+ *    fails to come back, or is another card, fails that command and the ones after it like any write error, and
+ *    SD_Recover() mounts it again.
+ * ======================================================================================================================
+ */
+#define SD_PWR_MS         5                 // Supply up before the first clock, the card needs 1ms and 74 clocks
+
+/* 
+ *=======================================================================================================================
+ * SD_PowerUp() - Supply on, called by the library on the first access after SD_PowerDown()
+ *=======================================================================================================================
+ */
+void SD_PowerUp() {
+  if (!STN_SD_PWR) {
+    return;
+  }
+  pinMode(STN_SD_PWR, OUTPUT);
+  digitalWrite(STN_SD_PWR, HIGH);
+  pinMode(SD_ChipSelect, OUTPUT);
+  digitalWrite(SD_ChipSelect, HIGH);
+  delay(SD_PWR_MS);
+}
+
+/*
+ * ======================================================================================================================
+ *  Block I/O - Sd2Card reports each block it reads or writes (Sd2Card::blockHook()), counted per observation cycle
+ *    as reads, writes and rewrites. A rewrite is a block written already this cycle, the FAT, directory entry or
+ *    partial data block of an append written twice, writes a batched flush or the contiguous log would not make.
+ *    sd_io_cycle() at the start of OBS_Do() moves the counts to sd_io_last[], which the record's "sdio" array
+ *    (obs_tm=1) and the sh stats command show, so a change that adds block I/O shows in the logs of a station.
+ * ======================================================================================================================
+ */
+#define SD_IO_SEEN        16                // Blocks written this cycle kept to find rewrites
+#define SD_IO_READS       0                 // sd_io_n[] index
+#define SD_IO_WRITES      1
+#define SD_IO_REWRITES    2
+
+uint32_t sd_io_n[3];                        // This cycle so far
+uint32_t sd_io_last[3];                     // Last whole cycle
+uint32_t sd_io_seen[SD_IO_SEEN];            // Ring of blocks written this cycle
+int sd_io_seen_n = 0;                       // Entries in it, at most SD_IO_SEEN
+
+/* 
+ *=======================================================================================================================
+ * sd_io_hook() - Count a block read or written, Sd2Card's block hook
+ *=======================================================================================================================
+ */
+void sd_io_hook(uint8_t kind, uint32_t block) {
+  int n = (sd_io_seen_n < SD_IO_SEEN) ? sd_io_seen_n : SD_IO_SEEN;
+
+  if (kind == SD_IO_READ) {
+    sd_io_n[SD_IO_READS]++;
+    return;
+  }
+  sd_io_n[SD_IO_WRITES]++;
+  for (int i=0; i<n; i++) {
+    if (sd_io_seen[i] == block) {
+      sd_io_n[SD_IO_REWRITES]++;
+      return;
+    }
+  }
+  sd_io_seen[sd_io_seen_n++ % SD_IO_SEEN] = block;
+}
+
+/* 
+ *=======================================================================================================================
+ * sd_io_cycle() - Start counting a new observation cycle, the one before goes to sd_io_last[]
+ *=======================================================================================================================
+ */
+void sd_io_cycle() {
+  memcpy (sd_io_last, sd_io_n, sizeof(sd_io_last));
+  memset (sd_io_n, 0, sizeof(sd_io_n));
+  sd_io_seen_n = 0;
+}
+
 /* 
  *=======================================================================================================================
  * SD_initialize()
  *=======================================================================================================================
  */
 void SD_initialize() {
+  SD_PowerUp();
   if (!SD.begin(SD_ChipSelect)) {
-    Output ("SD:NF");
+    ev_note (EV_SD_NF, 0);
     SystemStatusBits |= SSB_SD;
-    delay (5000);
+    Output_Delay (5000);
   }
   else {
     SD_exists = true;
+    SdVolume::sdCard()->blockHook(sd_io_hook);
     if (!SD.exists(SD_obsdir)) {
       if (SD.mkdir(SD_obsdir)) {
         Output ("SD:MKDIR OBS OK");
@@ -45,40 +127,1527 @@ void SD_initialize() {
   }
 }
 
+/*
+ * ======================================================================================================================
+ *  Card Recovery - A failed open or write marks the card down. Observations held in the write behind buffer stay
+ *    there, nothing is written until SD_Recover() has torn down the library state and initialized the card again.
+ *    Tries back off 1, 2, 4 .. SD_RETRY_MAX observations apart, so a card pulled and replaced on a site visit is
+ *    picked up without a reboot and a dead one costs little. A card missing at boot is tried the same way.
+ * ======================================================================================================================
+ */
+#define SD_RETRY_MAX      32                // Observations, longest wait between tries
+
+bool SD_down = false;                       // A write failed, card waits for SD_Recover()
+extern bool ns_loaded;                      // NS.h, queue state is read again after a remount
+extern bool rs_open;                        // RS.h, stats block found again after a remount
+extern bool ws_open;                        // WS.h, snapshot file found again after a remount
+extern bool ar_open;                        // AR.h, cursor file found and read again after a remount
+extern bool ar_loaded;
+int  SD_retry_wait = 1;                     // Observations between tries
+int  SD_retry_n = 0;                        // Observations since the last try
+
+/* 
+ *=======================================================================================================================
+ * SD_Fail() - Card open or write failed, hold what we have until it is back
+ *=======================================================================================================================
+ */
+void SD_Fail() {
+  SystemStatusBits |= SSB_SD;  // Turn On Bit
+  SD_down = true;
+}
+
+/*
+ * ======================================================================================================================
+ *  Write Behind Buffer - Observations are held in RAM and appended to the daily log in one write.
+ *    Flushed when cf_sd_batch observations are held, when the next record would not fit, at day rollover
+ *    (records belong to the file of the day they were taken) and on low battery.
+ * ======================================================================================================================
+ */
+#define SD_WB_SIZE        3072              // Bytes, about 15 observations
+#define SD_WB_LOWBATT     3500              // mV, below this every observation is flushed
+#define SD_BATCH_MAX      10                // Most sd_batch, what SD_wb holds of the longest records
+
+char SD_wb[SD_WB_SIZE];
+int  SD_wb_len = 0;                         // Bytes held
+int  SD_wb_count = 0;                       // Observations held
+char SD_wb_logfile[24];                     // Daily log the held observations belong to
+char SD_log_day[24];                        // Daily log last checked for its schema line
+
+/*
+ * ======================================================================================================================
+ *  Monthly Directories - With sd_month=1 the daily files are /OBS/YYYYMM/DD.log (.bin, .idx) instead of
+ *    /OBS/YYYYMMDD.log, so no directory holds more than a month of them. The month's directory is kept open and the
+ *    files are opened in it, an open only searches that directory and does not walk the path from the root.
+ * ======================================================================================================================
+ */
+File SD_mdir;                               // Month directory kept open
+char SD_mdir_name[16] = "";                 // Its path
+
+/* 
+ *=======================================================================================================================
+ * SD_DayPath() - Path of the daily file of day with extension ext
+ *=======================================================================================================================
+ */
+void SD_DayPath(char *path, const DateTime &day, const char *ext) {
+  if (cf_sd_month) {
+    sprintf (path, "%s/%4d%02d/%02d.%s", SD_obsdir, day.year(), day.month(), day.day(), ext);
+  }
+  else {
+    sprintf (path, "%s/%4d%02d%02d.%s", SD_obsdir, day.year(), day.month(), day.day(), ext);
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_DayFile() - Path of today's daily file with extension ext
+ *=======================================================================================================================
+ */
+void SD_DayFile(char *path, const char *ext) {
+  // Note: "now" is global and is set when ever timestamp() is called. Value last read from RTC.
+  SD_DayPath(path, now, ext);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_NewDay() - True the first time path is logged to since boot and it is not on the card yet, so its schema header
+ *   goes first. last holds the path of the previous call.
+ *=======================================================================================================================
+ */
+bool SD_NewDay(const char *path, char *last) {
+  if (strcmp(path, last) == 0) {
+    return (false);
+  }
+  strcpy (last, path);
+  return (!SD_down && !SD.exists(path));
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_MonthDir() - Make sure the month directory of path exists and is the one held open
+ *=======================================================================================================================
+ */
+bool SD_MonthDir(const char *path) {
+  char dir[16];
+  int len = strrchr(path, '/') - path;
+
+  if (!cf_sd_month) {
+    return (true);
+  }
+  if ((len <= 0) || (len >= (int) sizeof(dir))) {
+    return (false);
+  }
+  memcpy (dir, path, len);
+  dir[len] = 0;
+  if (SD_mdir && (strcmp(dir, SD_mdir_name) == 0)) {
+    return (true);
+  }
+
+  if (SD_mdir) {
+    SD_mdir.close();  // Month rollover
+  }
+  SD_mdir_name[0] = 0;
+  if (!SD.exists(dir) && !SD.mkdir(dir)) {
+    SystemStatusBits |= SSB_SD;  // Turn On Bit
+    Output ("SD:MKDIR Err");
+    return (false);
+  }
+  SD_mdir = SD.open(dir);
+  if (!SD_mdir) {
+    return (false);
+  }
+  strcpy (SD_mdir_name, dir);
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_OpenDay() - Open a daily file, in the month directory held open when sd_month is set
+ *=======================================================================================================================
+ */
+File SD_OpenDay(const char *path, uint8_t mode) {
+  if (!cf_sd_month) {
+    return (SD.open(path, mode));
+  }
+  if (!SD_MonthDir(path)) {
+    return (File());
+  }
+  return (SD.open(SD_mdir, strrchr(path, '/') + 1, mode));
+}
+
+/*
+ * ======================================================================================================================
+ *  Time Index - With sd_idx=1 each daily log gets a YYYYMMDD.idx sidecar of fixed 8 byte entries, one per record in
+ *    the order written: minute of day, record length without CRLF, byte offset of the record in the .log (all little
+ *    endian). Entries are sorted by time, so finding a time is a binary search and one seek into the log. The entries
+ *    of the held observations are written after them in the same flush. tools/obsidx.py reads a window this way.
+ * ======================================================================================================================
+ */
+#define SD_WB_RECS        32                // Index entries held, a flush is forced when full
+
+typedef struct __attribute__((packed)) {
+  uint16_t minute;                          // Minute of day
+  uint16_t len;                             // Bytes without CRLF
+  uint32_t offset;                          // Byte offset in the .log
+} SD_IDXENT;                                // 8 bytes
+
+SD_IDXENT SD_wb_idx[SD_WB_RECS];            // Offsets are into SD_wb[] until the flush
+
+/* 
+ *=======================================================================================================================
+ * SD_IndexWrite() - Append the held entries to the .idx of the daily log, base is where SD_wb[] went in the .log
+ *=======================================================================================================================
+ */
+void SD_IndexWrite(uint32_t base) {
+  char SD_idxfile[24];
+  File fp;
+  int n = (SD_wb_count < SD_WB_RECS) ? SD_wb_count : SD_WB_RECS;
+
+  if (!cf_sd_idx || (n == 0)) {
+    return;
+  }
+
+  strcpy (SD_idxfile, SD_wb_logfile);
+  strcpy (SD_idxfile + strlen(SD_idxfile) - 3, "idx");
+  for (int i=0; i<n; i++) {
+    SD_wb_idx[i].offset += base;
+  }
+  fp = SD_OpenDay(SD_idxfile, FILE_WRITE); 
+  if (fp) {
+    fp.write((const uint8_t *)SD_wb_idx, n * sizeof(SD_IDXENT));
+    fp.close();
+  }
+  else {
+    SystemStatusBits |= SSB_SD;  // Turn On Bit
+    Output ("IDX Open Err");
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Contiguous Daily Log - With sd_contig=1 each daily log is created as one run of clusters sized for SD_CB_OBS
+ *    observations and zero filled. Flushes are then raw block writes at SD_cb_bgn + offset, no cluster allocation and
+ *    no FAT or directory updates. Until it is trimmed the file reads as its records followed by zeros. It is trimmed to
+ *    the bytes written at day rollover, when the extent fills and on low battery, after which the rest of the day is
+ *    appended normally. After a reboot the write offset is found again by locating the first zero byte, and the
+ *    extents of the SD_CB_BOOT_DAYS days before today are trimmed the same way, a reboot over a day rollover left
+ *    them untrimmed.
+ * ======================================================================================================================
+ */
+#define SD_CB_OBS         96                // Observations per day, 15 minute interval
+#define SD_CB_OBSLEN      320               // Bytes allowed per observation
+#define SD_CB_SIZE        ((uint32_t)SD_CB_OBS * SD_CB_OBSLEN)
+#define SD_CB_BLOCKS      ((SD_CB_SIZE + 511) / 512)
+#define SD_CB_BOOT_DAYS   7                 // Days before today whose extents are trimmed at boot
+
+bool     SD_cb_open = false;                // Extent below is in use
+char     SD_cb_logfile[24];                 // Daily log the extent belongs to
+uint32_t SD_cb_bgn;                         // First SD block of the extent
+uint32_t SD_cb_len;                         // Bytes written into the extent
+
+/* 
+ *=======================================================================================================================
+ * SD_ContigTrim() - Set the daily log's size to what was written, freeing the unused clusters
+ *=======================================================================================================================
+ */
+void SD_ContigTrim() {
+  File fp;
+
+  if (!SD_cb_open) {
+    return;
+  }
+  SD_cb_open = false;
+
+  fp = SD.open(SD_cb_logfile, O_READ | O_WRITE);
+  if (fp && fp.truncate(SD_cb_len)) {
+    LOG_DBG ("SD:Trim %lu", SD_cb_len);
+  }
+  else {
+    SystemStatusBits |= SSB_SD;  // Turn On Bit
+    Output ("SD:Trim Err");
+  }
+  if (fp) {
+    fp.close();
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_ContigFind() - Bytes used in an untrimmed extent. Records are text, so the first zero byte is the end.
+ *=======================================================================================================================
+ */
+uint32_t SD_ContigFind() {
+  Sd2Card *card = SdVolume::sdCard();
+  uint8_t *buf = SdVolume::cacheClear();
+  uint32_t lo = 0;                          // Blocks before lo have data
+  uint32_t hi = SD_CB_BLOCKS;               // Blocks from hi on are empty
+  uint32_t mid;
+  int i;
+
+  // Blocks fill in order, binary search for the first one starting with zero
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (!card->readBlock(SD_cb_bgn + mid, buf)) {
+      return (SD_CB_SIZE);                  // Treat as full so the file is trimmed and appended to
+    }
+    if (buf[0]) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return (0);
+  }
+  if (!card->readBlock(SD_cb_bgn + lo - 1, buf)) {
+    return (SD_CB_SIZE);
+  }
+  for (i=0; (i<512) && buf[i]; i++);
+  return ((lo - 1) * 512 + i);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_ContigBoot() - Trim the extents of earlier days left untrimmed by a reboot, call once the RTC is read
+ *=======================================================================================================================
+ */
+void SD_ContigBoot() {
+  char logfile[24];
+  uint32_t bgn, end;
+  bool untrimmed;
+  File fp;
+
+  if (!cf_sd_contig || !SD_exists || SD_down || !RTC_valid) {
+    return;
+  }
+  for (int d=1; d<=SD_CB_BOOT_DAYS; d++) {
+    SD_DayPath(logfile, DateTime(now.unixtime() - (uint32_t) d * 86400UL), "log");
+    if (SD_cb_open && (strcmp(logfile, SD_cb_logfile) == 0)) {
+      SD_ContigTrim();  // Picked up by the journal replay
+      continue;
+    }
+    fp = SD.open(logfile, FILE_READ);
+    if (!fp) {
+      continue;
+    }
+    untrimmed = (fp.size() == SD_CB_SIZE) && fp.contiguousRange(&bgn, &end);
+    fp.close();
+    if (untrimmed) {
+      SD_cb_bgn = bgn;
+      SD_cb_len = SD_ContigFind();
+      strcpy (SD_cb_logfile, logfile);
+      SD_cb_open = true;
+      SD_ContigTrim();
+    }
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_ContigOpen() - Create or pick up the extent for logfile, false if it must be appended to normally
+ *=======================================================================================================================
+ */
+bool SD_ContigOpen(char *logfile) {
+  Sd2Card *card;
+  uint8_t *buf;
+  uint32_t bgn, end;
+  uint32_t b;
+  bool ok;
+  File fp;
+
+  if (SD_cb_open && (strcmp(logfile, SD_cb_logfile) == 0)) {
+    return (true);
+  }
+  SD_ContigTrim();  // Day rollover
+
+  if (!SD.exists(logfile)) {
+    fp = SD.createContiguous(logfile, SD_CB_SIZE);
+    if (!fp) {
+      Output ("SD:Contig Err");
+      return (false);
+    }
+    if (!fp.contiguousRange(&bgn, &end)) {
+      fp.close();
+      SD.remove(logfile);  // Full size, the next open would take it for an extent
+      return (false);
+    }
+    fp.close();
+
+    // Zero fill in one multiple block write so unwritten space reads as end of data
+    card = SdVolume::sdCard();
+    buf = SdVolume::cacheClear();
+    memset (buf, 0, 512);
+    ok = card->writeStart(bgn, SD_CB_BLOCKS);
+    for (b=0; ok && (b<SD_CB_BLOCKS); b++) {
+      ok = card->writeData(buf);
+    }
+    if (!ok || !card->writeStop()) {
+      SD.remove(logfile);  // Not zeroed, the next open would read the card's old data as records
+      return (false);
+    }
+    SD_cb_bgn = bgn;
+    SD_cb_len = 0;
+    LOG_DBG ("SD:Contig %lu", SD_cb_bgn);
+  }
+  else {
+    // Untrimmed extent from before a reboot, anything else was trimmed or is a normal file
+    fp = SD.open(logfile, FILE_READ);
+    if (!fp) {
+      return (false);
+    }
+    if ((fp.size() != SD_CB_SIZE) || !fp.contiguousRange(&bgn, &end)) {
+      fp.close();
+      return (false);
+    }
+    fp.close();
+    SD_cb_bgn = bgn;
+    SD_cb_len = SD_ContigFind();
+    LOG_DBG ("SD:Contig %lu+%lu", SD_cb_bgn, SD_cb_len);
+  }
+  strcpy (SD_cb_logfile, logfile);
+  SD_cb_open = true;
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_ContigWrite() - Write len bytes at the end of the extent, false if they do not fit
+ *=======================================================================================================================
+ */
+bool SD_ContigWrite(char *data, int len) {
+  Sd2Card *card = SdVolume::sdCard();
+  uint8_t *buf = SdVolume::cacheClear();
+  uint32_t block = SD_cb_bgn + (SD_cb_len / 512);
+  int offset = SD_cb_len % 512;
+  uint32_t start = SD_cb_len;
+  int n;
+
+  if ((SD_cb_len + len) > SD_CB_SIZE) {
+    return (false);
+  }
+
+  // Partial last block is read back so its earlier records are rewritten with it
+  if (offset && !card->readBlock(block, buf)) {
+    return (false);
+  }
+  if (!offset) {
+    memset (buf, 0, 512);  // Cache held other data, rest of the block must read as zero
+  }
+  while (len > 0) {
+    if (!offset && (len >= 1024)) {
+      // Whole blocks straight from data in one pre-erased multiple block write
+      n = len & ~511;
+      if (!card->writeStart(block, n / 512)) {
+        SD_cb_len = start;
+        return (false);
+      }
+      for (int i=0; i<n; i+=512) {
+        if (!card->writeData((const uint8_t *) data + i)) {
+          SD_cb_len = start;
+          return (false);
+        }
+      }
+      if (!card->writeStop()) {
+        SD_cb_len = start;
+        return (false);
+      }
+      block += n / 512;
+    }
+    else {
+      n = ((512 - offset) < len) ? (512 - offset) : len;
+      memcpy (buf + offset, data, n);
+      if (!card->writeBlock(block, buf)) {
+        SD_cb_len = start;  // Trim drops anything partly written, it is all appended again
+        return (false);
+      }
+      block++;
+      offset = 0;
+      memset (buf, 0, 512);  // Rest of a new block stays zero
+    }
+    SD_cb_len += n;
+    data += n;
+    len -= n;
+  }
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ *  Summary Log - Hourly and daily summary records (OBS.h) appended to /OBS/SUM.log. They are held until the card is
+ *    written for the observation logs anyway, or the buffer is full.
+ * ======================================================================================================================
+ */
+#define SD_SB_SIZE        512               // Bytes, a day of hourly records does not fit, they are flushed sooner
+
+char SD_sb[SD_SB_SIZE];
+int  SD_sb_len = 0;                         // Bytes held
+
+/* 
+ *=======================================================================================================================
+ * SD_FlushSummary() - Append held summary records to /OBS/SUM.log
+ *=======================================================================================================================
+ */
+void SD_FlushSummary() {
+  char SD_logfile[24];
+  File fp;
+
+  if (SD_sb_len == 0) {
+    return;
+  }
+
+  if (SD_exists && !SD_down) {
+    sprintf (SD_logfile, "%s/SUM.log", SD_obsdir);
+    fp = SD.open(SD_logfile, FILE_WRITE); 
+    if (fp) {
+      fp.write((const uint8_t *)SD_sb, SD_sb_len);
+      fp.close();
+      Output ("SUM Logged to SD");
+    }
+    else {
+      SD_Fail();
+      ev_note (EV_SD_SUM_OPEN, 0);
+    }
+  }
+  SD_sb_len = 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogSummary() - Hold a summary record
+ *=======================================================================================================================
+ */
+void SD_LogSummary(char *summary) {
+  int len = strlen(summary);
+
+  if (!SD_exists || ((len + 2) > SD_SB_SIZE)) {
+    return;
+  }
+  if ((SD_sb_len + len + 2) > SD_SB_SIZE) {
+    SD_FlushSummary();
+  }
+  memcpy (SD_sb + SD_sb_len, summary, len);
+  SD_sb_len += len;
+  SD_sb[SD_sb_len++] = '\r';
+  SD_sb[SD_sb_len++] = '\n';
+}
+
+/*
+ * ======================================================================================================================
+ *  Held Open Log - The daily log is opened once and held open until the day rolls over, a write error or SD_Close(),
+ *    so a flush writes the data blocks without a path walk or a malloc. Every sd_sync flushes the file is synced,
+ *    writing its directory entry and FAT so the records survive a power loss. Flushes after the last sync are lost
+ *    with power, 1 = sync every flush (default).
+ * ======================================================================================================================
+ */
+File SD_log;
+char SD_log_name[24] = "";                  // Path of SD_log
+int  SD_log_unsynced = 0;                   // Flushes since the last sync
+
+/* 
+ *=======================================================================================================================
+ * SD_LogClose() - Sync and close the held log
+ *=======================================================================================================================
+ */
+void SD_LogClose() {
+  if (SD_log) {
+    SD_log.close();
+  }
+  SD_log_name[0] = 0;
+  SD_log_unsynced = 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogOpen() - Hold logfile open for appending, reopen only when it is another file
+ *=======================================================================================================================
+ */
+bool SD_LogOpen(const char *logfile) {
+  if (SD_log && (strcmp(logfile, SD_log_name) == 0)) {
+    return (true);
+  }
+  SD_LogClose();  // Day rollover
+  SD_log = SD_OpenDay(logfile, FILE_WRITE);
+  if (!SD_log) {
+    return (false);
+  }
+  strcpy (SD_log_name, logfile);
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ *  Deferred Write - With sd_defer=1 the last block write of a flush returns once its 512 bytes are clocked out, the
+ *    card programs it (tens of ms) while the loop goes on to the display and sleep scheduling. The block is already
+ *    on the card when the SPI transfer ends so the cache buffer is free, only the busy wait and status check move.
+ *    Earlier writes of the flush, and any later SD command, wait for the one before them as usual.
+ * ======================================================================================================================
+ */
+
+/* 
+ *=======================================================================================================================
+ * SD_WriteWait() - Wait out a deferred write and check it, call before sleep
+ *=======================================================================================================================
+ */
+void SD_WriteWait() {
+  Sd2Card *card = SdVolume::sdCard();
+
+  if (!SD_exists || !card->writePending()) {
+    return;
+  }
+  if (!card->writeWait()) {
+    ev_note (EV_SD_WRITE, card->errorCode());
+    SD_LogClose();  // Opened again once the card is back
+    SD_Fail();
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_PowerDown() - Switch the card off for the sleep, after SD_WriteWait()
+ *=======================================================================================================================
+ */
+void SD_PowerDown() {
+  Sd2Card *card = SdVolume::sdCard();
+
+  if (!STN_SD_PWR || !SD_exists || SD_down || card->poweredDown()) {
+    return;
+  }
+  SdVolume::cacheClear();  // Dirty blocks written, the card may be another one when it comes back
+  if (!card->powerDown(SD_PowerUp)) {
+    return;  // Stays on, the next wake tries again
+  }
+  digitalWrite(STN_SD_PWR, LOW);
+  digitalWrite(SD_ChipSelect, LOW);  // No current into the card through its pins
+}
+
+/*
+ * ======================================================================================================================
+ *  Event Log - Events from the ring (EV.h) appended to /OBS/EVENTS.bin as they are held, 8 bytes each, when the card
+ *    is written for the observation logs anyway. Events from before the RTC was first read get the time they are
+ *    written. Each boot starts with EV_BOOT. More events than the ring holds between two flushes are written as one
+ *    EV_LOST with the count.
+ * ======================================================================================================================
+ */
+
+/* 
+ *=======================================================================================================================
+ * SD_FlushEvents() - Append events not yet written to /OBS/EVENTS.bin
+ *=======================================================================================================================
+ */
+void SD_FlushEvents() {
+  EV_REC lost;
+  uint32_t t = now.unixtime();
+  uint32_t i, n;
+  char SD_logfile[24];
+  File fp;
+
+  if ((ev_written == ev_total) || !SD_exists || SD_down || !RTC_valid) {
+    return;
+  }
+
+  sprintf (SD_logfile, "%s/EVENTS.bin", SD_obsdir);
+  fp = SD.open(SD_logfile, FILE_WRITE);
+  if (!fp) {
+    SD_Fail();
+    return;
+  }
+  if ((ev_total - ev_written) > EV_RING) {
+    lost.at = t;
+    lost.id = EV_LOST;
+    lost.pad = 0;
+    lost.arg = (int16_t) (ev_total - ev_written - EV_RING);
+    fp.write((const uint8_t *)&lost, sizeof(lost));
+    ev_written = ev_total - EV_RING;
+  }
+  while (ev_written < ev_total) {
+    i = ev_written % EV_RING;
+    n = (ev_total - ev_written < EV_RING - i) ? ev_total - ev_written : EV_RING - i;  // To the end of the ring
+    for (uint32_t k=i; k<i+n; k++) {
+      if (!ev_ring[k].at) {
+        ev_ring[k].at = t;
+      }
+    }
+    fp.write((const uint8_t *)&ev_ring[i], n * sizeof(EV_REC));
+    ev_written += n;
+  }
+  fp.close();
+}
+
+/*
+ * ======================================================================================================================
+ *  Write Ahead Journal - With sd_journal=1 and sd_batch above 1 each observation held in the write behind buffer is
+ *    first written to /OBS/JOURNAL.bin, a contiguous file of one header block and a ring of SD_JN_RING blocks. A
+ *    record is one raw block write at the block of its sequence number, with its daily log, minute of day, length
+ *    and a CRC, no FAT or directory update. After the held records are in their daily log the header is written
+ *    with the sequence flushed through. At boot SD_JournalReplay() holds the records past that again, in order, and
+ *    flushes them, so a reset or brownout with a batch in RAM loses nothing. A record lost in a torn block fails its
+ *    CRC32 (dsu_crc32() in SF.h) and ends the replay there.
+ * ======================================================================================================================
+ */
+#define SD_JN_FILE        "/OBS/JOURNAL.bin"
+#define SD_JN_RING        64                // Blocks, twice the most held, SD_WB_RECS
+#define SD_JN_MAGIC       0x324A4253        // "SBJ2", "SBJN" had a CRC16
+#define SD_JN_DATA        (512 - sizeof(SD_JNENT))
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;                           // SD_JN_MAGIC
+  uint32_t seq;                             // Record sequence, header block: flushed through
+  uint16_t len;                             // Bytes of record after this
+  uint16_t minute;                          // Minute of day, for the .idx
+  char     logfile[24];                     // Daily log it belongs to
+  uint32_t crc;                             // CRC32 of the above and the record
+} SD_JNENT;                                 // 40 bytes
+
+bool     SD_jn_open = false;                // Extent below is in use
+uint32_t SD_jn_bgn;                         // First SD block, the header
+uint32_t SD_jn_seq = 1;                     // Sequence of the next record
+uint32_t SD_jn_flushed = 0;                 // Records up to this one are in their daily log
+
+/* 
+ *=======================================================================================================================
+ * SD_JournalCrc() - CRC of an entry and its record, buf is the block
+ *=======================================================================================================================
+ */
+uint32_t SD_JournalCrc(const uint8_t *buf) {
+  const SD_JNENT *e = (const SD_JNENT *) buf;
+  uint32_t crc = dsu_crc32(buf, offsetof(SD_JNENT, crc), 0);
+
+  return (dsu_crc32(buf + sizeof(SD_JNENT), (e->len < SD_JN_DATA) ? e->len : SD_JN_DATA, crc));
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_JournalBlock() - Write an entry and its record to block b of the journal
+ *=======================================================================================================================
+ */
+bool SD_JournalBlock(uint32_t b, uint32_t seq, const char *rec, int len, const char *logfile, uint16_t minute) {
+  uint8_t *buf = SdVolume::cacheClear();
+  SD_JNENT *e = (SD_JNENT *) buf;
+
+  memset (buf, 0, 512);
+  e->magic = SD_JN_MAGIC;
+  e->seq = seq;
+  e->len = len;
+  e->minute = minute;
+  strncpy (e->logfile, logfile, sizeof(e->logfile) - 1);
+  memcpy (buf + sizeof(SD_JNENT), rec, len);
+  e->crc = SD_JournalCrc(buf);
+  return (SdVolume::sdCard()->writeBlock(SD_jn_bgn + b, buf));
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_JournalOpen() - Create or find the journal extent, false if it can not be used
+ *=======================================================================================================================
+ */
+bool SD_JournalOpen() {
+  uint32_t bgn, end;
+  uint8_t *buf;
+  File fp;
+
+  if (SD_jn_open) {
+    return (true);
+  }
+  if (!SD.exists(SD_JN_FILE)) {
+    fp = SD.createContiguous(SD_JN_FILE, (SD_JN_RING + 1) * 512UL);
+    if (!fp) {
+      return (false);
+    }
+    if (!fp.contiguousRange(&bgn, &end)) {
+      fp.close();
+      return (false);
+    }
+    fp.close();
+    SD_jn_bgn = bgn;
+
+    // Whatever the clusters held before must not read as records
+    buf = SdVolume::cacheClear();
+    memset (buf, 0, 512);
+    for (uint32_t b=0; b<=SD_JN_RING; b++) {
+      if (!SdVolume::sdCard()->writeBlock(SD_jn_bgn + b, buf)) {
+        return (false);
+      }
+    }
+  }
+  else {
+    fp = SD.open(SD_JN_FILE, FILE_READ);
+    if (!fp) {
+      return (false);
+    }
+    if ((fp.size() != (SD_JN_RING + 1) * 512UL) || !fp.contiguousRange(&bgn, &end)) {
+      fp.close();
+      return (false);
+    }
+    fp.close();
+    SD_jn_bgn = bgn;
+  }
+  SD_jn_open = true;
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_JournalWrite() - Journal a record about to be held
+ *=======================================================================================================================
+ */
+void SD_JournalWrite(const char *rec, int len, const char *logfile, uint16_t minute) {
+  if (!cf_sd_journal || (cf_sd_batch <= 1) || !SD_exists || SD_down || (len > (int) SD_JN_DATA)) {
+    return;
+  }
+  if (!SD_JournalOpen() || !SD_JournalBlock(1 + (SD_jn_seq % SD_JN_RING), SD_jn_seq, rec, len, logfile, minute)) {
+    Output ("SD:Journal Err");
+    return;
+  }
+  SD_jn_seq++;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_JournalCommit() - Everything journaled is in its daily log, say so in the header
+ *=======================================================================================================================
+ */
+void SD_JournalCommit() {
+  if (!SD_jn_open || (SD_jn_flushed == SD_jn_seq - 1)) {
+    return;
+  }
+  if (SD_JournalBlock(0, SD_jn_seq - 1, "", 0, "", 0)) {
+    SD_jn_flushed = SD_jn_seq - 1;
+  }
+}
+
+#define SD_LAT_FLUSH      2                 // Latency kind after SD_LAT_BLOCK and SD_LAT_MULTI (Sd2Card.h)
+void rs_latency(uint8_t kind, uint32_t us); // RS.h, latency histograms
+
+/* 
+ *=======================================================================================================================
+ * SD_Flush() - Append the write behind buffer to its daily log file, timed as SD_LAT_FLUSH when it is written
+ *=======================================================================================================================
+ */
+void SD_Flush() {
+  uint32_t base;                            // Offset of SD_wb[] in the log
+  unsigned long start;
+  bool ok;
+
+  if (SD_wb_len == 0) {
+    return;
+  }
+  SD_FlushSummary();  // Card is being written anyway
+  SD_FlushEvents();
+
+  if (!SD_exists) {
+    SD_wb_len = 0;
+    SD_wb_count = 0;
+    return;
+  }
+  if (SD_down) {
+    return;  // Held until SD_Recover() has the card back
+  }
+
+  Output (SD_wb_logfile);
+
+  start = micros();
+  SdVolume::sdCard()->deferBusy(cf_sd_defer);  // Only the last write is left programming
+  if (cf_sd_contig && SD_MonthDir(SD_wb_logfile) && SD_ContigOpen(SD_wb_logfile)) {
+    base = SD_cb_len;
+    if (SD_ContigWrite(SD_wb, SD_wb_len)) {
+      SD_IndexWrite(base);
+      SystemStatusBits &= ~SSB_SD;  // Turn Off Bit
+      LOG_DBG ("OBS %d Logged to SD", SD_wb_count);
+      SdVolume::sdCard()->deferBusy(0);
+      SD_JournalCommit();
+      rs_latency(SD_LAT_FLUSH, micros() - start);
+      SD_wb_len = 0;
+      SD_wb_count = 0;
+      return;
+    }
+    SD_ContigTrim();  // Full or write error, append normally from here on
+  }
+  
+  if (SD_LogOpen(SD_wb_logfile)) {
+    base = SD_log.size();
+    ok = (SD_log.write((const uint8_t *)SD_wb, SD_wb_len) == (size_t) SD_wb_len);
+    if (ok && (++SD_log_unsynced >= cf_sd_sync)) {
+      ok = SD_log.sync();
+      SD_log_unsynced = 0;
+    }
+    if (ok) {
+      SD_IndexWrite(base);
+      SystemStatusBits &= ~SSB_SD;  // Turn Off Bit
+      LOG_DBG ("OBS %d Logged to SD", SD_wb_count);
+    }
+    else {
+      ev_note (EV_SD_OBS_WRITE, 0);
+      SD_LogClose();  // Opened again once the card is back
+      SD_Fail();
+    }
+  }
+  else {
+    ev_note (EV_SD_OBS_OPEN, 0);
+    SD_Fail();
+  }
+  SdVolume::sdCard()->deferBusy(0);
+  if (SD_down) {
+    return;  // Records stay held for SD_Recover()
+  }
+  SD_JournalCommit();
+  rs_latency(SD_LAT_FLUSH, micros() - start);
+  SD_wb_len = 0;
+  SD_wb_count = 0;
+}
+
+/*
+ * ======================================================================================================================
+ *  Binary Log - Fixed size records (OBS_BINREC in OBS.h) appended to /OBS/YYYYMMDD.bin. Held and flushed on the same
+ *    rules as the write behind buffer. When the day rolls over the finished file is read back through the DSU and
+ *    closed with a footer, the CRC32 of every byte before it, so a copy is checked without parsing its records.
+ *    A file whose day ended while the station was off has no footer.
+ *
+ *    A new file starts with a schema header: the type and size of the records after it, the dt[] slots and the
+ *    firmware. Each record's flags are the presence bitmap of its sections, the fields are in the fixed order of
+ *    OBS_BINREC, so a reader builds one layout per bitmap value and never matches a key.
+ * ======================================================================================================================
+ */
+#define SD_BB_SIZE        512               // Bytes, 8 records
+#define SD_BIN_FOOTER     0xFC              // Footer type, no record type is this high
+#define SD_BIN_HEADER     0xFD              // Header type
+
+typedef struct __attribute__((packed)) {
+  uint8_t  type;                            // SD_BIN_HEADER
+  uint8_t  rtype;                           // Type of the records after it, OBS_BIN_TYPE
+  uint8_t  size;                            // Their bytes
+  uint8_t  dsmax;                           // DS_MAX_PROBES, slots in dt[]
+  uint32_t at;                              // Unix time written
+  char     fw[20];                          // VERSION_INFO, 0 padded
+  uint32_t crc;                             // CRC32 of the above
+} SD_BINHDR;                                // 32 bytes
+
+typedef struct __attribute__((packed)) {
+  uint8_t  type;                            // SD_BIN_FOOTER
+  uint8_t  flags;                           // 0
+  uint32_t at;                              // Unix time written
+  uint32_t bytes;                           // File bytes before the footer
+  uint32_t crc;                             // CRC32 of them
+} SD_BINFTR;                                // 14 bytes
+
+uint8_t SD_bb[SD_BB_SIZE] __attribute__((aligned(4)));
+int  SD_bb_len = 0;                         // Bytes held
+int  SD_bb_count = 0;                       // Records held
+char SD_bb_logfile[24];                     // Daily binary log the held records belong to
+char SD_bb_day[24];                         // Daily binary log last checked for its header
+
+/* 
+ *=======================================================================================================================
+ * SD_FlushBinary() - Append held binary records to their daily .bin file
+ *=======================================================================================================================
+ */
+void SD_FlushBinary() {
+  File fp;
+
+  if (SD_bb_len == 0) {
+    return;
+  }
+  SD_FlushSummary();
+
+  if (SD_exists && !SD_down) {
+    fp = SD_OpenDay(SD_bb_logfile, FILE_WRITE); 
+    if (fp) {
+      fp.write((const uint8_t *)SD_bb, SD_bb_len);
+      fp.close();
+      LOG_DBG ("BIN %d Logged to SD", SD_bb_count);
+    }
+    else {
+      SD_Fail();
+      ev_note (EV_SD_BIN_OPEN, 0);
+    }
+  }
+  SD_bb_len = 0;
+  SD_bb_count = 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_BinaryFooter() - Close a finished day's .bin with the CRC32 of its contents, read back through SD_bb
+ *=======================================================================================================================
+ */
+void SD_BinaryFooter(const char *logfile) {
+  SD_BINFTR f;
+  uint32_t crc = 0;
+  int n;
+  File fp;
+
+  if (!SD_exists || SD_down || (SD_bb_len > 0)) {
+    return;
+  }
+  fp = SD.open(logfile, O_READ | O_WRITE);
+  if (!fp) {
+    return;
+  }
+  memset (&f, 0, sizeof(f));
+  f.bytes = fp.size();
+  while ((n = fp.read(SD_bb, SD_BB_SIZE)) > 0) {
+    crc = dsu_crc32(SD_bb, n, crc);
+  }
+  if (fp.position() == f.bytes) {
+    f.type = SD_BIN_FOOTER;
+    f.at = now.unixtime();
+    f.crc = crc;
+    if (fp.write((const uint8_t *)&f, sizeof(f)) != sizeof(f)) {
+      Output ("SD:Footer Err");
+    }
+  }
+  fp.close();
+  LOG_DBG ("SD:Footer %s %lu %08lX", logfile, f.bytes, f.crc);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogBinary() - Hold a binary record for its daily .bin file
+ *=======================================================================================================================
+ */
+void SD_LogBinary(uint8_t *rec, int len) {
+  char SD_logfile[24];
+  SD_BINHDR h;
+  int hlen = 0;
+
+  if (!SD_exists || !RTC_valid || ((len + (int) sizeof(h)) > SD_BB_SIZE)) {
+    return;
+  }
+
+  SD_DayFile(SD_logfile, "bin");
+
+  if (SD_bb_logfile[0] && (strcmp(SD_logfile, SD_bb_logfile) != 0)) {
+    SD_FlushBinary();
+    SD_BinaryFooter(SD_bb_logfile);  // Day rollover
+  }
+  if (SD_NewDay(SD_logfile, SD_bb_day)) {
+    memset (&h, 0, sizeof(h));
+    h.type = SD_BIN_HEADER;
+    h.rtype = rec[0];
+    h.size = len;
+    h.dsmax = DS_MAX_PROBES;
+    h.at = now.unixtime();
+    strncpy (h.fw, VERSION_INFO, sizeof(h.fw));
+    h.crc = dsu_crc32(&h, offsetof(SD_BINHDR, crc), 0);
+    hlen = sizeof(h);
+  }
+  if ((SD_bb_len > 0) && ((SD_bb_len + hlen + len) > SD_BB_SIZE)) {
+    SD_FlushBinary();
+  }
+
+  strcpy (SD_bb_logfile, SD_logfile);
+  memcpy (SD_bb + SD_bb_len, &h, hlen);
+  SD_bb_len += hlen;
+  memcpy (SD_bb + SD_bb_len, rec, len);
+  SD_bb_len += len;
+  SD_bb_count++;
+
+  if (SD_bb_count >= cf_sd_batch) {
+    SD_FlushBinary();
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Delta Log - Compressed records (OBS.h obs_delta()) appended to /OBS/YYYYMMDD.dlt. Held and flushed on the same
+ *    rules as the binary log. Records held when the card fails are dropped, SD_db_key then makes the next record a
+ *    keyframe so the file still decodes.
+ * ======================================================================================================================
+ */
+#define SD_DB_SIZE        256               // Bytes, 10 or more delta records
+
+uint8_t SD_db[SD_DB_SIZE];
+int  SD_db_len = 0;                         // Bytes held
+int  SD_db_count = 0;                       // Records held
+char SD_db_logfile[24];                     // Daily delta log the held records belong to
+bool SD_db_key = true;                      // Next record must be a keyframe, the chain was broken
+
+/* 
+ *=======================================================================================================================
+ * SD_FlushDelta() - Append held delta records to their daily .dlt file
+ *=======================================================================================================================
+ */
+void SD_FlushDelta() {
+  File fp;
+
+  if (SD_db_len == 0) {
+    return;
+  }
+
+  SD_FlushSummary();
+
+  if (SD_exists && !SD_down) {
+    fp = SD_OpenDay(SD_db_logfile, FILE_WRITE); 
+    if (fp) {
+      if (fp.write((const uint8_t *)SD_db, SD_db_len) != (size_t) SD_db_len) {
+        SD_db_key = true;
+      }
+      fp.close();
+      LOG_DBG ("DLT %d Logged to SD", SD_db_count);
+    }
+    else {
+      SD_db_key = true;
+      SD_Fail();
+      ev_note (EV_SD_BIN_OPEN, 0);
+    }
+  }
+  else {
+    SD_db_key = true;
+  }
+  SD_db_len = 0;
+  SD_db_count = 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogDelta() - Hold an encoded record for today's .dlt file, false if it was not taken
+ *=======================================================================================================================
+ */
+bool SD_LogDelta(uint8_t *rec, int len) {
+  char SD_logfile[24];
+
+  if (!SD_exists || SD_down || !RTC_valid || (len > SD_DB_SIZE)) {
+    SD_db_key = true;
+    return (false);
+  }
+
+  SD_DayFile(SD_logfile, "dlt");
+
+  if ((SD_db_len > 0) && ((strcmp(SD_logfile, SD_db_logfile) != 0) || ((SD_db_len + len) > SD_DB_SIZE))) {
+    SD_FlushDelta();
+  }
+
+  strcpy (SD_db_logfile, SD_logfile);
+  memcpy (SD_db + SD_db_len, rec, len);
+  SD_db_len += len;
+  SD_db_count++;
+
+  if (SD_db_count >= cf_sd_batch) {
+    SD_FlushDelta();
+  }
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ *  Burst Capture - With sd_burst=1 the binary records of observations on a fast schedule (a level event burst or
+ *    the adaptive cadence below obs_interval) are only held in SD_bc, no log file is opened for them. A record never
+ *    crosses a 512 byte block, the rest of a block is zero but for its last 4 bytes, the CRC32 of the 508 before
+ *    them, set when the block is written. The held blocks go to /OBS/YYYYMMDD.bst in one multiple
+ *    block write when SD_bc is full, when the fast schedule ends, at day rollover and in SD_Close(). The day's .bst
+ *    is created as a zero filled extent of SD_BC_DAY blocks, after a reboot its end is the first block starting with
+ *    zero. It is trimmed at day rollover and in SD_Close(), later flushes that day are appended. tools/obsbin2json.py
+ *    reads it as a .bin, skipping the padding. Held records are lost with a reset.
+ * ======================================================================================================================
+ */
+#define SD_BC_BLOCKS      4                 // Held, 32 records
+#define SD_BC_DAY         160               // Blocks of the day's extent, a day at 1 minute
+#define SD_BC_DATA        508               // Record bytes of a block, the CRC32 follows
+
+uint8_t  SD_bc[SD_BC_BLOCKS * 512] __attribute__((aligned(4)));
+int      SD_bc_len = 0;                     // Bytes held
+int      SD_bc_count = 0;                   // Records held
+char     SD_bc_logfile[24];                 // Daily .bst the held records belong to
+bool     SD_bc_open = false;                // Extent below is in use
+char     SD_bc_extfile[24];                 // Daily .bst the extent belongs to
+uint32_t SD_bc_bgn;                         // First SD block of the extent
+uint32_t SD_bc_used;                        // Blocks written into the extent
+
+/* 
+ *=======================================================================================================================
+ * SD_BurstTrim() - Set the day's .bst size to the blocks written
+ *=======================================================================================================================
+ */
+void SD_BurstTrim() {
+  File fp;
+
+  if (!SD_bc_open) {
+    return;
+  }
+  SD_bc_open = false;
+
+  fp = SD.open(SD_bc_extfile, O_READ | O_WRITE);
+  if (!fp || !fp.truncate(SD_bc_used * 512)) {
+    SystemStatusBits |= SSB_SD;  // Turn On Bit
+    Output ("SD:Trim Err");
+  }
+  if (fp) {
+    fp.close();
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_BurstOpen() - Create or pick up the extent of logfile, false if it must be appended to normally
+ *=======================================================================================================================
+ */
+bool SD_BurstOpen(char *logfile) {
+  Sd2Card *card = SdVolume::sdCard();
+  uint8_t *buf;
+  uint32_t bgn, end, lo, hi, mid;
+  bool ok;
+  File fp;
+
+  if (SD_bc_open && (strcmp(logfile, SD_bc_extfile) == 0)) {
+    return (true);
+  }
+  SD_BurstTrim();  // Day rollover
+
+  if (!SD.exists(logfile)) {
+    fp = SD.createContiguous(logfile, (uint32_t) SD_BC_DAY * 512);
+    if (!fp) {
+      return (false);
+    }
+    if (!fp.contiguousRange(&bgn, &end)) {
+      fp.close();
+      SD.remove(logfile);  // Full size, the next open would take it for an extent
+      return (false);
+    }
+    fp.close();
+    buf = SdVolume::cacheClear();
+    memset (buf, 0, 512);
+    ok = card->writeStart(bgn, SD_BC_DAY);
+    for (lo=0; ok && (lo<SD_BC_DAY); lo++) {
+      ok = card->writeData(buf);
+    }
+    if (!ok || !card->writeStop()) {
+      SD.remove(logfile);  // Not zeroed, the next open would read the card's old data as blocks
+      return (false);
+    }
+    lo = 0;
+  }
+  else {
+    fp = SD.open(logfile, FILE_READ);
+    if (!fp) {
+      return (false);
+    }
+    if ((fp.size() != (uint32_t) SD_BC_DAY * 512) || !fp.contiguousRange(&bgn, &end)) {
+      fp.close();
+      return (false);  // Trimmed already
+    }
+    fp.close();
+
+    // Records start with their type, never zero, so the first block starting with zero is the end
+    buf = SdVolume::cacheClear();
+    lo = 0;
+    hi = SD_BC_DAY;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (!card->readBlock(bgn + mid, buf)) {
+        return (false);
+      }
+      if (buf[0]) {
+        lo = mid + 1;
+      }
+      else {
+        hi = mid;
+      }
+    }
+  }
+  strcpy (SD_bc_extfile, logfile);
+  SD_bc_bgn = bgn;
+  SD_bc_used = lo;
+  SD_bc_open = true;
+  LOG_DBG ("SD:Burst %lu+%lu", SD_bc_bgn, SD_bc_used);
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_FlushBurst() - Write the held blocks to their daily .bst
+ *=======================================================================================================================
+ */
+void SD_FlushBurst() {
+  Sd2Card *card = SdVolume::sdCard();
+  uint32_t n = (SD_bc_len + 511) / 512;
+  uint32_t crc;
+  bool ok = false;
+  File fp;
+
+  if (SD_bc_len == 0) {
+    return;
+  }
+  for (uint32_t b=0; b<n; b++) {
+    crc = dsu_crc32(SD_bc + (b * 512), SD_BC_DATA, 0);
+    memcpy (SD_bc + (b * 512) + SD_BC_DATA, &crc, sizeof(crc));
+  }
+  if (SD_exists && !SD_down) {
+    if (SD_BurstOpen(SD_bc_logfile) && ((SD_bc_used + n) <= SD_BC_DAY)) {
+      ok = card->writeStart(SD_bc_bgn + SD_bc_used, n);
+      for (uint32_t b=0; ok && (b<n); b++) {
+        ok = card->writeData(SD_bc + (b * 512));
+      }
+      ok = ok && card->writeStop();
+      if (ok) {
+        SD_bc_used += n;
+      }
+    }
+    else {
+      SD_BurstTrim();  // Full, append whole blocks from here on
+      fp = SD_OpenDay(SD_bc_logfile, FILE_WRITE);
+      if (fp) {
+        ok = (fp.write(SD_bc, n * 512) == (n * 512));
+        fp.close();
+      }
+    }
+    if (ok) {
+      LOG_DBG ("BST %d Logged to SD", SD_bc_count);
+    }
+    else {
+      ev_note (EV_SD_BIN_OPEN, 0);
+      SD_Fail();
+    }
+  }
+  memset (SD_bc, 0, sizeof(SD_bc));
+  SD_bc_len = 0;
+  SD_bc_count = 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogBurst() - Hold a binary record of a fast schedule observation, flushed only when the held blocks are full
+ *=======================================================================================================================
+ */
+void SD_LogBurst(uint8_t *rec, int len) {
+  char SD_logfile[24];
+  int room;
+
+  if (!SD_exists || !RTC_valid || (len > SD_BC_DATA)) {
+    return;
+  }
+
+  SD_DayFile(SD_logfile, "bst");
+  if ((SD_bc_len > 0) && (strcmp(SD_logfile, SD_bc_logfile) != 0)) {
+    SD_FlushBurst();
+  }
+
+  room = SD_BC_DATA - (SD_bc_len % 512);
+  if (len > room) {
+    SD_bc_len += room + 4;  // Zero to the CRC, the next block
+  }
+  if ((SD_bc_len + len) > (int) sizeof(SD_bc)) {
+    SD_FlushBurst();
+  }
+
+  strcpy (SD_bc_logfile, SD_logfile);
+  memcpy (SD_bc + SD_bc_len, rec, len);
+  SD_bc_len += len;
+  SD_bc_count++;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Close() - Flush held observations, close and trim the daily log, leaves nothing on the card to recover
+ *=======================================================================================================================
+ */
+void SD_Close() {
+  SD_Flush();
+  SD_LogClose();
+  SD_FlushBinary();
+  SD_FlushDelta();
+  SD_FlushBurst();
+  SD_FlushSummary();
+  SD_ContigTrim();
+  SD_BurstTrim();
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Remount() - Try a card that was missing or failing again, quietly, true when it is usable
+ *=======================================================================================================================
+ */
+bool SD_Remount() {
+  // Handles and extents below belong to the card we lost, closing gives their pool slots back
+  SD_LogClose();
+  if (SD_mdir) {
+    SD_mdir.close();
+  }
+  SD_mdir_name[0] = 0;
+  SD_cb_open = false;
+  SD_bc_open = false;
+  SD_jn_open = false;
+  ns_loaded = false;  // Read again from the card that comes back
+  rs_open = false;
+  ws_open = false;
+  ar_open = false;
+  ar_loaded = false;
+  SD.end();
+
+  SD_PowerUp();
+  if (!SD.begin(SD_ChipSelect)) {
+    return (false);
+  }
+  SdVolume::sdCard()->blockHook(sd_io_hook);  // A card missing at boot has had none
+  if (!SD.exists(SD_obsdir) && !SD.mkdir(SD_obsdir)) {
+    return (false);
+  }
+  SD_exists = true;
+  SD_down = false;
+  SystemStatusBits &= ~SSB_SD;  // Turn Off Bit
+  Output ("SD:Online");
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Recover() - Once per observation, retry a missing or down card on the backoff and write what was held
+ *=======================================================================================================================
+ */
+void SD_Recover() {
+  if (SD_exists && !SD_down) {
+    SD_retry_wait = 1;
+    SD_retry_n = 0;
+    return;
+  }
+  if (++SD_retry_n < SD_retry_wait) {
+    return;
+  }
+  SD_retry_n = 0;
+  if (SD_Remount()) {
+    SD_retry_wait = 1;
+    SD_Flush();  // Held observations go to their daily log now
+    return;
+  }
+  ev_note (EV_SD_RETRY, SD_retry_wait);
+  SD_retry_wait = (SD_retry_wait < SD_RETRY_MAX) ? SD_retry_wait * 2 : SD_RETRY_MAX;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Hold() - Add a record of logfile to the write behind buffer, flushing what is held for another file first
+ *=======================================================================================================================
+ */
+void SD_Hold(const char *observations, int len, const char *logfile, uint16_t minute) {
+  // Day rollover or no room, write out what we have for the previous file
+  if ((SD_wb_len > 0) && ((strcmp(logfile, SD_wb_logfile) != 0) || ((SD_wb_len + len + 2) > SD_WB_SIZE) ||
+                          (cf_sd_idx && (SD_wb_count >= SD_WB_RECS)))) {
+    SD_Flush();
+    if (SD_wb_len > 0) {
+      // Card still down, make room by dropping the oldest held
+      ev_note (EV_SD_DROPPED, SD_wb_count);
+      SD_wb_len = 0;
+      SD_wb_count = 0;
+    }
+  }
+
+  strcpy (SD_wb_logfile, logfile);
+  if ((len + 2) > SD_WB_SIZE) {
+    len = SD_WB_SIZE - 2;
+  }
+  if (SD_wb_count < SD_WB_RECS) {
+    SD_wb_idx[SD_wb_count].minute = minute;
+    SD_wb_idx[SD_wb_count].len = len;
+    SD_wb_idx[SD_wb_count].offset = SD_wb_len;
+  }
+  memcpy (SD_wb + SD_wb_len, observations, len);
+  SD_wb_len += len;
+  SD_wb[SD_wb_len++] = '\r';    // Same line ending println() gave us
+  SD_wb[SD_wb_len++] = '\n';
+  SD_wb_count++;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogObservation() - Hold a JSON record for its daily .log, a new file starts with the schema line
+ *   {"schema":SD_SCHEMA,"fw":VERSION_INFO}, SD_SCHEMA numbers the grammar of the jb_ functions in SF.h and the
+ *   meaning of the hth bits
+ *=======================================================================================================================
+ */
+#define SD_SCHEMA         2                 // 1 = hth 0x40 and 0x200 unused (AS5600, HTU21DF), 2 = OVERRUN, WDT
+
+void SD_LogObservation(char *observations) {
+  char SD_logfile[24];
+  char schema[48];
+  int len = strlen(observations);
+  uint16_t minute;
+
+  if (!SD_exists) {
+    return;
+  }
+
+  if (!RTC_valid) {
+    return;
+  }
+
+  SD_DayFile(SD_logfile, "log");
+  if (SD_NewDay(SD_logfile, SD_log_day)) {
+    sprintf (schema, "{\"schema\":%d,\"fw\":\"%s\"}", SD_SCHEMA, VERSION_INFO);
+    SD_Hold(schema, strlen(schema), SD_logfile, 0);  // Minute 0, first in the index
+  }
+  minute = (now.hour() * 60) + now.minute();
+  SD_Hold(observations, len, SD_logfile, minute);
+
+  if (SD_wb_count >= cf_sd_batch) {
+    SD_Flush();
+  }
+  else {
+    SD_JournalWrite(observations, len, SD_logfile, minute);  // Held, a reset before the flush replays it
+    LOG_DBG ("OBS Buffered %d", SD_wb_count);
+  }
+}
+
 /* 
  *=======================================================================================================================
- * SD_LogObservation()
+ * SD_JournalReplay() - Hold and flush the journaled records a reset kept from their daily log, call at boot
  *=======================================================================================================================
  */
-void SD_LogObservation(char *observations) {
-  char SD_logfile[24];
-  File fp;
+void SD_JournalReplay() {
+  uint8_t *buf;
+  SD_JNENT *e;
+  uint32_t first = 0;                       // Lowest sequence past the flushed one
+  uint32_t last = 0;                        // Highest sequence seen
+  int n = 0;
+  char rec[SD_JN_DATA];
+  char logfile[24];
+  uint16_t minute;
+  int len;
 
-  if (!SD_exists) {
+  if (!cf_sd_journal || !SD_exists || !SD.exists(SD_JN_FILE) || !SD_JournalOpen()) {
     return;
   }
 
-  if (!RTC_valid) {
-    return;
+  buf = SdVolume::cacheClear();
+  e = (SD_JNENT *) buf;
+  if (SdVolume::sdCard()->readBlock(SD_jn_bgn, buf) && (e->magic == SD_JN_MAGIC) && (e->crc == SD_JournalCrc(buf))) {
+    SD_jn_flushed = e->seq;
   }
+  last = SD_jn_flushed;
+  for (uint32_t b=1; b<=SD_JN_RING; b++) {
+    if (!SdVolume::sdCard()->readBlock(SD_jn_bgn + b, buf)) {
+      return;
+    }
+    if ((e->magic != SD_JN_MAGIC) || (e->crc != SD_JournalCrc(buf))) {
+      continue;
+    }
+    last = (e->seq > last) ? e->seq : last;
+    if ((e->seq > SD_jn_flushed) && (!first || (e->seq < first))) {
+      first = e->seq;
+    }
+  }
+  SD_jn_seq = last + 1;
 
-  // Note: "now" is global and is set when ever timestamp() is called. Value last read from RTC.
-  sprintf (SD_logfile, "%s/%4d%02d%02d.log", SD_obsdir, now.year(), now.month(), now.day());
-
-  Output (SD_logfile);
-  
-  fp = SD.open(SD_logfile, FILE_WRITE); 
-  if (fp) {
-    fp.println(observations);
-    fp.close();
-    SystemStatusBits &= ~SSB_SD;  // Turn Off Bit
-    Output ("OBS Logged to SD");
+  // Records after the flushed one are in order round the ring, a gap is where the reset struck
+  for (uint32_t seq=first; first && (seq<=last); seq++) {
+    buf = SdVolume::cacheClear();           // Holding may have used the cache
+    e = (SD_JNENT *) buf;
+    if (!SdVolume::sdCard()->readBlock(SD_jn_bgn + 1 + (seq % SD_JN_RING), buf) || (e->magic != SD_JN_MAGIC) ||
+        (e->seq != seq) || (e->crc != SD_JournalCrc(buf))) {
+      break;
+    }
+    // Out of the cache before holding, a flush for another day uses it
+    len = (e->len < SD_JN_DATA) ? e->len : SD_JN_DATA;
+    memcpy (rec, buf + sizeof(SD_JNENT), len);
+    memcpy (logfile, e->logfile, sizeof(logfile));
+    logfile[sizeof(logfile) - 1] = 0;
+    minute = e->minute;
+    SD_Hold(rec, len, logfile, minute);
+    n++;
+  }
+  if (n) {
+    SD_Flush();
+    LOG_INFO ("SD:Journal %d Replayed", n);
   }
   else {
-    SystemStatusBits |= SSB_SD;  // Turn On Bit - Note this will be reported on next observation
-    Output ("OBS Open Log Err");
-    // At thins point we could set SD_exists to false and/or set a status bit to report it
-    // SD_initialize();  // Reports SD NOT Found. Library bug with SD
+    SD_JournalCommit();
   }
 }
 
@@ -90,7 +1659,7 @@ void SD_LogObservation(char *observations) {
  *  
  *  myInt_1    = SD_findInt(F("myInt_1"));
  *  myFloat_1  = SD_findFloat(F("myFloat_1"));
- *  myString_1 = SD_findString(F("myString_1"));
+ *  SD_findString(F("myString_1"), myString_1, sizeof(myString_1));
  *  
  *  CONFIG.TXT content example
  *  myString_1=Hello
@@ -99,20 +1668,152 @@ void SD_LogObservation(char *observations) {
  * =======================================================================================================================
  */
 
-int SD_findKey(const __FlashStringHelper * key, char * value) {
-  
-  File configFile = SD.open(CF_NAME);
+/*
+ * =======================================================================================================================
+ *  Config Table - CONFIG.TXT is read once into cf_pool. cf_table holds the offsets of each key and value, sorted by
+ *    key, so a lookup is a binary search. Lines starting with # and lines without = are skipped. The first of a
+ *    duplicated key wins, as it did when the file was scanned per key. Keys never looked up are reported as unknown.
+ * =======================================================================================================================
+ */
+#define CF_MAX_KEYS       112
+#define CF_POOL_SIZE      1536
+
+typedef struct {
+  uint16_t key;                             // Offset in cf_pool, 0 terminated
+  uint16_t value;                           // Offset in cf_pool, 0 terminated
+  bool     used;                            // Looked up by SD_findKey()
+} CF_ENTRY;
+
+CF_ENTRY cf_table[CF_MAX_KEYS];
+int  cf_entries = 0;
+char cf_pool[CF_POOL_SIZE];
+int  cf_pool_len = 0;
+bool cf_loaded = false;
+
+/*
+ * =======================================================================================================================
+ * SD_findEntry() - Binary search cf_table, returns index or -1. *pos is where key would be inserted.
+ * =======================================================================================================================
+ */
+int SD_findEntry(const char *key, int *pos) {
+  int lo = 0;
+  int hi = cf_entries - 1;
+  int mid, c;
+
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    c = strcmp(key, cf_pool + cf_table[mid].key);
+    if (c == 0) {
+      return (mid);
+    }
+    if (c < 0) {
+      hi = mid - 1;
+    }
+    else {
+      lo = mid + 1;
+    }
+  }
+  if (pos) {
+    *pos = lo;
+  }
+  return (-1);
+}
+
+/*
+ * =======================================================================================================================
+ * SD_LoadConfigFile() - Read all of CONFIG.TXT into the config table in one pass
+ * =======================================================================================================================
+ */
+void SD_LoadConfigFile() {
+  char line[LINE_MAX_LENGTH+1];
+  int len, klen, vlen, pos, i;
+  char *eq;
 
+  cf_loaded = true;
+  cf_entries = 0;
+  cf_pool_len = 0;
+
+  File configFile = SD.open(CF_NAME);
   if (!configFile) {
-    Serial.print(F("SD Card: error on opening file "));
-    Serial.println(CF_NAME);
-    return(0);
+    LOG_ERR ("SD:%s Open Err", CF_NAME);
+    return;
+  }
+
+  while (configFile.available()) {
+    // UNIX uses LF = \n
+    // WINDOWS uses CFLF = \r\n
+    len = configFile.readBytesUntil('\n', line, LINE_MAX_LENGTH);
+    if (len == LINE_MAX_LENGTH) {
+      // Longer than any key and value, the rest of it is not a line of its own
+      while (configFile.available() && (configFile.read() != '\n'));
+      if (line[0] != '#') {
+        line[KEY_MAX_LENGTH] = 0;
+        LOG_ERR ("CF:Long line [%s]", line);
+      }
+      continue;
+    }
+    if ((len > 0) && (line[len - 1] == '\r')) {
+      len--; // trim the \r
+    }
+    line[len] = 0;
+
+    if ((len == 0) || (line[0] == '#') || ((eq = strchr(line, '=')) == NULL)) {
+      continue;
+    }
+    klen = eq - line;
+    vlen = len - klen - 1;
+    if ((klen == 0) || (klen >= KEY_MAX_LENGTH) || (vlen == 0) || (vlen >= VALUE_MAX_LENGTH)) {
+      LOG_ERR ("CF:Bad line [%s]", line);
+      continue;
+    }
+    *eq = 0;
+
+    if (SD_findEntry(line, &pos) >= 0) {
+      LOG_ERR ("CF:Dup %s", line);
+      continue;
+    }
+    if ((cf_entries == CF_MAX_KEYS) || ((cf_pool_len + len + 1) > CF_POOL_SIZE)) {
+      Output ("CF:Table Full");
+      break;
+    }
+
+    // Key and value go in the pool back to back, both 0 terminated
+    memcpy (cf_pool + cf_pool_len, line, len + 1);
+    for (i=cf_entries; i>pos; i--) {
+      cf_table[i] = cf_table[i-1];
+    }
+    cf_table[pos].key = cf_pool_len;
+    cf_table[pos].value = cf_pool_len + klen + 1;
+    cf_table[pos].used = false;
+    cf_pool_len += len + 1;
+    cf_entries++;
+  }
+
+  configFile.close();  // close the file
+}
+
+/*
+ * =======================================================================================================================
+ * SD_ReportUnknownKeys() - Keys in CONFIG.TXT that were never looked up
+ * =======================================================================================================================
+ */
+void SD_ReportUnknownKeys() {
+  for (int i=0; i<cf_entries; i++) {
+    if (!cf_table[i].used) {
+      LOG_ERR ("CF:Unknown %s", cf_pool + cf_table[i].key);
+    }
   }
+}
 
+int SD_findKey(const __FlashStringHelper * key, char * value) {
   char key_string[KEY_MAX_LENGTH];
-  char SD_buffer[KEY_MAX_LENGTH + VALUE_MAX_LENGTH + 1]; // 1 is = character
   int key_length = 0;
   int value_length = 0;
+  int i;
+
+  if (!cf_loaded) {
+    SD_LoadConfigFile();
+  }
 
   // Flash string to string
   PGM_P keyPoiter;
@@ -120,30 +1821,17 @@ int SD_findKey(const __FlashStringHelper * key, char * value) {
   byte ch;
   do {
     ch = pgm_read_byte(keyPoiter++);
-    if (ch != 0)
+    if ((ch != 0) && (key_length < (KEY_MAX_LENGTH-1)))
       key_string[key_length++] = ch;
   } while (ch != 0);
+  key_string[key_length] = 0;
 
-  // check line by line
-  while (configFile.available()) {
-    // UNIX uses LF = \n
-    // WINDOWS uses CFLF = \r\n
-    int buffer_length = configFile.readBytesUntil('\n', SD_buffer, LINE_MAX_LENGTH);
-    if (SD_buffer[buffer_length - 1] == '\r')
-      buffer_length--; // trim the \r
-
-    if (buffer_length > (key_length + 1)) { // 1 is = character
-      if (memcmp(SD_buffer, key_string, key_length) == 0) { // equal
-        if (SD_buffer[key_length] == '=') {
-          value_length = buffer_length - key_length - 1;
-          memcpy(value, SD_buffer + key_length + 1, value_length);
-          break;
-        }
-      }
-    }
+  i = SD_findEntry(key_string, NULL);
+  if (i >= 0) {
+    cf_table[i].used = true;
+    value_length = strlen(cf_pool + cf_table[i].value);
+    memcpy(value, cf_pool + cf_table[i].value, value_length);
   }
-
-  configFile.close();  // close the file
   return value_length;
 }
 
@@ -208,31 +1896,6 @@ float HELPER_ascii2Float(char *ascii, int length) {
   return (number + decimal) * sign;
 }
 
-String HELPER_ascii2String(char *ascii, int length) {
-  String str;
-  str.reserve(length);
-  str = "";
-
-  for (int i = 0; i < length; i++) {
-    char c = *(ascii + i);
-    str += String(c);
-  }
-  return str;
-}
-
-char* HELPER_ascii2CharStr(char *ascii, int length) {
-  char *str;
-  int i = 0;
-  str = (char *) malloc (length+1);
-  str[0] = 0;
-  for (int i = 0; i < length; i++) {
-    char c = *(ascii + i);
-    str[i] = c;
-    str[i+1] = 0;
-  }
-  return str;
-}
-
 bool SD_available(const __FlashStringHelper * key) {
   char value_string[VALUE_MAX_LENGTH];
   int value_length = SD_findKey(key, value_string);
@@ -251,16 +1914,13 @@ float SD_findFloat(const __FlashStringHelper * key) {
   return HELPER_ascii2Float(value_string, value_length);
 }
 
-String SD_findString(const __FlashStringHelper * key) {
-  char value_string[VALUE_MAX_LENGTH];
-  int value_length = SD_findKey(key, value_string);
-  return HELPER_ascii2String(value_string, value_length);
-}
-
-char* SD_findCharStr(const __FlashStringHelper * key) {
+int SD_findString(const __FlashStringHelper * key, char *str, int size) {
   char value_string[VALUE_MAX_LENGTH];
   int value_length = SD_findKey(key, value_string);
-  return HELPER_ascii2CharStr(value_string, value_length);
+  value_length = (value_length < size) ? value_length : size - 1;  // Truncated to fit, no heap
+  memcpy (str, value_string, value_length);
+  str[value_length] = 0;
+  return value_length;
 }
 
 long SD_findLong(const __FlashStringHelper * key) {
@@ -276,6 +1936,410 @@ long SD_findLong(const __FlashStringHelper * key) {
  * =======================================================================================================================
  */
 void SD_ReadConfigFile() {
+  if (SD_available(F("obs_interval"))) {
+    cf_obs_interval = SD_findInt(F("obs_interval"));
+  }
+  LOG_INFO ("CF:obs_interval=[%d]", cf_obs_interval);
+
+  cf_rtc_int_pin = SD_findInt(F("rtc_int_pin"));
+  LOG_INFO ("CF:rtc_int_pin=[%d]", cf_rtc_int_pin);
+
+  cf_rtc_32k_pin = SD_findInt(F("rtc_32k_pin"));
+  LOG_INFO ("CF:rtc_32k_pin=[%d]", cf_rtc_32k_pin);
+
+  cf_obs_tm = SD_findInt(F("obs_tm"));
+  LOG_INFO ("CF:obs_tm=[%d]", cf_obs_tm);
+
+  cf_obs_db_sg = SD_findInt(F("obs_db_sg"));
+  LOG_INFO ("CF:obs_db_sg=[%d]", cf_obs_db_sg);
+
+  cf_obs_db_t = SD_findInt(F("obs_db_t"));
+  LOG_INFO ("CF:obs_db_t=[%d]", cf_obs_db_t);
+
+  if (SD_available(F("obs_hb"))) {
+    cf_obs_hb = SD_findInt(F("obs_hb"));
+  }
+  LOG_INFO ("CF:obs_hb=[%d]", cf_obs_hb);
+
+  cf_obs_sum = SD_findInt(F("obs_sum"));
+  LOG_INFO ("CF:obs_sum=[%d]", cf_obs_sum);
+
+  cf_obs_fast = SD_findInt(F("obs_fast"));
+  LOG_INFO ("CF:obs_fast=[%d]", cf_obs_fast);
+
+  if (SD_available(F("obs_fast_mm"))) {
+    cf_obs_fast_mm = SD_findInt(F("obs_fast_mm"));
+  }
+  LOG_INFO ("CF:obs_fast_mm=[%d]", cf_obs_fast_mm);
+
+  if (SD_available(F("obs_fast_t"))) {
+    cf_obs_fast_t = SD_findInt(F("obs_fast_t"));
+  }
+  LOG_INFO ("CF:obs_fast_t=[%d]", cf_obs_fast_t);
+
+  cf_obs_slow = SD_findInt(F("obs_slow"));
+  LOG_INFO ("CF:obs_slow=[%d]", cf_obs_slow);
+
+  // Seasonal schedule, string keys looked up in the table directly
+  cf_ss_n = 0;
+  for (int k=1; k<=SS_MAX; k++) {
+    char key[8];
+    int e, *f = cf_ss[cf_ss_n];
+
+    sprintf (key, "ss%d", k);
+    if ((e = SD_findEntry(key, NULL)) < 0) {
+      continue;
+    }
+    cf_table[e].used = true;
+    if (sscanf(cf_pool + cf_table[e].value, "%d,%d,%d,%d,%d", &f[0], &f[1], &f[2], &f[3], &f[4]) != SS_FIELDS) {
+      LOG_ERR ("CF:%s=[%s] ERR", key, cf_pool + cf_table[e].value);
+      continue;
+    }
+    LOG_INFO ("CF:%s=[%04d,%d,%d,%d,%d]", key, f[0], f[1], f[2], f[3], f[4]);
+    cf_ss_n++;
+  }
+
+  if (SD_available(F("pwr_save"))) {
+    cf_pwr_save = SD_findInt(F("pwr_save"));
+  }
+  LOG_INFO ("CF:pwr_save=[%d]", cf_pwr_save);
+
+  if (SD_available(F("pwr_crit"))) {
+    cf_pwr_crit = SD_findInt(F("pwr_crit"));
+  }
+  LOG_INFO ("CF:pwr_crit=[%d]", cf_pwr_crit);
+
+  cf_pwr_until = SD_findInt(F("pwr_until"));
+  LOG_INFO ("CF:pwr_until=[%d]", cf_pwr_until);
+
+  if (SD_available(F("pwr_empty"))) {
+    cf_pwr_empty = SD_findInt(F("pwr_empty"));
+  }
+  LOG_INFO ("CF:pwr_empty=[%d]", cf_pwr_empty);
+
+  cf_pwr_bod = SD_findInt(F("pwr_bod"));
+  LOG_INFO ("CF:pwr_bod=[%d]", cf_pwr_bod);
+
   cf_ds_type   = SD_findInt(F("ds_type"));
-  sprintf(msgbuf, "CF:ds_type=[%d]", cf_ds_type); Output (msgbuf);
+  LOG_INFO ("CF:ds_type=[%d]", cf_ds_type);
+
+  cf_sg_model = SD_findInt(F("sg_model"));
+  LOG_INFO ("CF:sg_model=[%d]", cf_sg_model);
+
+  if (SD_available(F("sg_chans"))) {
+    cf_sg_chans = SD_findInt(F("sg_chans"));
+  }
+  LOG_INFO ("CF:sg_chans=[%d]", cf_sg_chans);
+
+  cf_sg2_model = SD_findInt(F("sg2_model"));
+  LOG_INFO ("CF:sg2_model=[%d]", cf_sg2_model);
+
+  cf_sg3_model = SD_findInt(F("sg3_model"));
+  LOG_INFO ("CF:sg3_model=[%d]", cf_sg3_model);
+
+  cf_sg4_model = SD_findInt(F("sg4_model"));
+  LOG_INFO ("CF:sg4_model=[%d]", cf_sg4_model);
+
+  if (SD_available(F("ds_res"))) {
+    cf_ds_res = SD_findInt(F("ds_res"));
+  }
+  LOG_INFO ("CF:ds_res=[%d]", cf_ds_res);
+
+  if (SD_available(F("bmx_osr"))) {
+    cf_bmx_osr = SD_findInt(F("bmx_osr"));
+  }
+  LOG_INFO ("CF:bmx_osr=[%d]", cf_bmx_osr);
+
+  cf_bmx_filter = SD_findInt(F("bmx_filter"));
+  LOG_INFO ("CF:bmx_filter=[%d]", cf_bmx_filter);
+
+  cf_bmx_fifo = SD_findInt(F("bmx_fifo"));
+  LOG_INFO ("CF:bmx_fifo=[%d]", cf_bmx_fifo);
+
+  cf_bmx_odr = SD_findInt(F("bmx_odr"));
+  LOG_INFO ("CF:bmx_odr=[%d]", cf_bmx_odr);
+
+  if (SD_available(F("mcp_res"))) {
+    cf_mcp_res = SD_findInt(F("mcp_res"));
+  }
+  LOG_INFO ("CF:mcp_res=[%d]", cf_mcp_res);
+
+  if (SD_available(F("sg_samples"))) {
+    cf_sg_samples = SD_findInt(F("sg_samples"));
+  }
+  LOG_INFO ("CF:sg_samples=[%d]", cf_sg_samples);
+
+  cf_sg_iqr_stop = SD_findInt(F("sg_iqr_stop"));
+  LOG_INFO ("CF:sg_iqr_stop=[%d]", cf_sg_iqr_stop);
+
+  if (SD_available(F("sg_min_samples"))) {
+    cf_sg_min_samples = SD_findInt(F("sg_min_samples"));
+  }
+  LOG_INFO ("CF:sg_min_samples=[%d]", cf_sg_min_samples);
+
+  if (SD_available(F("sg_interval"))) {
+    cf_sg_interval = SD_findInt(F("sg_interval"));
+  }
+  LOG_INFO ("CF:sg_interval=[%d]", cf_sg_interval);
+
+  if (SD_available(F("sd_batch"))) {
+    cf_sd_batch = SD_findInt(F("sd_batch"));
+  }
+  if ((cf_sd_batch < 1) || (cf_sd_batch > SD_BATCH_MAX)) {
+    LOG_ERR ("CF:sd_batch %d ERR", cf_sd_batch);
+    cf_sd_batch = (cf_sd_batch < 1) ? 1 : SD_BATCH_MAX;
+  }
+  LOG_INFO ("CF:sd_batch=[%d]", cf_sd_batch);
+
+  cf_sd_contig = SD_findInt(F("sd_contig"));
+  LOG_INFO ("CF:sd_contig=[%d]", cf_sd_contig);
+
+  cf_sd_bin = SD_findInt(F("sd_bin"));
+  LOG_INFO ("CF:sd_bin=[%d]", cf_sd_bin);
+
+  cf_sd_delta = SD_findInt(F("sd_delta"));
+  LOG_INFO ("CF:sd_delta=[%d]", cf_sd_delta);
+
+  cf_sd_burst = SD_findInt(F("sd_burst"));
+  LOG_INFO ("CF:sd_burst=[%d]", cf_sd_burst);
+
+  cf_sd_idx = SD_findInt(F("sd_idx"));
+  LOG_INFO ("CF:sd_idx=[%d]", cf_sd_idx);
+
+  cf_sd_month = SD_findInt(F("sd_month"));
+  LOG_INFO ("CF:sd_month=[%d]", cf_sd_month);
+
+  if (SD_available(F("sd_sync"))) {
+    cf_sd_sync = SD_findInt(F("sd_sync"));
+  }
+  LOG_INFO ("CF:sd_sync=[%d]", cf_sd_sync);
+
+  cf_sd_journal = SD_findInt(F("sd_journal"));
+  LOG_INFO ("CF:sd_journal=[%d]", cf_sd_journal);
+
+  cf_n2s = SD_findInt(F("n2s"));
+  LOG_INFO ("CF:n2s=[%d]", cf_n2s);
+
+  cf_sd_defer = SD_findInt(F("sd_defer"));
+  LOG_INFO ("CF:sd_defer=[%d]", cf_sd_defer);
+
+  if (SD_available(F("sd_flash"))) {
+    cf_sd_flash = SD_findInt(F("sd_flash"));
+  }
+  LOG_INFO ("CF:sd_flash=[%d]", cf_sd_flash);
+
+  if (SD_available(F("cpu_div"))) {
+    cf_cpu_div = SD_findInt(F("cpu_div"));
+  }
+  LOG_INFO ("CF:cpu_div=[%d]", cf_cpu_div);
+
+  if (SD_available(F("pwr_park"))) {
+    cf_pwr_park = SD_findInt(F("pwr_park"));
+  }
+  LOG_INFO ("CF:pwr_park=[%d]", cf_pwr_park);
+
+  cf_i2c_dma = SD_findInt(F("i2c_dma"));
+  LOG_INFO ("CF:i2c_dma=[%d]", cf_i2c_dma);
+
+  if (SD_available(F("wdt"))) {
+    cf_wdt = SD_findInt(F("wdt"));
+  }
+  LOG_INFO ("CF:wdt=[%d]", cf_wdt);
+
+  cf_sg_stream = SD_findInt(F("sg_stream"));
+  LOG_INFO ("CF:sg_stream=[%d]", cf_sg_stream);
+
+  cf_sg_pw_pin = SD_findInt(F("sg_pw_pin"));
+  LOG_INFO ("CF:sg_pw_pin=[%d]", cf_sg_pw_pin);
+
+  cf_sg_serial = SD_findInt(F("sg_serial"));
+  LOG_INFO ("CF:sg_serial=[%d]", cf_sg_serial);
+
+  cf_sg_trig_pin = SD_findInt(F("sg_trig_pin"));
+  LOG_INFO ("CF:sg_trig_pin=[%d]", cf_sg_trig_pin);
+
+  cf_sg_osr = SD_findInt(F("sg_osr"));
+  LOG_INFO ("CF:sg_osr=[%d]", cf_sg_osr);
+
+  cf_sg_pwr_pin = SD_findInt(F("sg_pwr_pin"));
+  LOG_INFO ("CF:sg_pwr_pin=[%d]", cf_sg_pwr_pin);
+
+  if (SD_available(F("sg_settle"))) {
+    cf_sg_settle = SD_findInt(F("sg_settle"));
+  }
+  LOG_INFO ("CF:sg_settle=[%d]", cf_sg_settle);
+
+  if (SD_available(F("sg_ma"))) {
+    cf_sg_ma = SD_findInt(F("sg_ma"));
+  }
+  LOG_INFO ("CF:sg_ma=[%d]", cf_sg_ma);
+
+  cf_sg_event = SD_findInt(F("sg_event"));
+  LOG_INFO ("CF:sg_event=[%d]", cf_sg_event);
+
+  if (SD_available(F("sg_event_ms"))) {
+    cf_sg_event_ms = SD_findInt(F("sg_event_ms"));
+  }
+  LOG_INFO ("CF:sg_event_ms=[%d]", cf_sg_event_ms);
+
+  if (SD_available(F("sg_burst"))) {
+    cf_sg_burst = SD_findInt(F("sg_burst"));
+  }
+  LOG_INFO ("CF:sg_burst=[%d]", cf_sg_burst);
+
+  if (SD_available(F("sg_burst_n"))) {
+    cf_sg_burst_n = SD_findInt(F("sg_burst_n"));
+  }
+  LOG_INFO ("CF:sg_burst_n=[%d]", cf_sg_burst_n);
+
+  cf_sg_trace = SD_findInt(F("sg_trace"));
+  LOG_INFO ("CF:sg_trace=[%d]", cf_sg_trace);
+
+  cf_sg_raw = SD_findInt(F("sg_raw"));
+  LOG_INFO ("CF:sg_raw=[%d]", cf_sg_raw);
+
+  cf_en_ina = SD_findInt(F("en_ina"));
+  LOG_INFO ("CF:en_ina=[%d]", cf_en_ina);
+
+  if (SD_available(F("en_addr"))) {
+    cf_en_addr = SD_findInt(F("en_addr"));
+  }
+  LOG_INFO ("CF:en_addr=[%d]", cf_en_addr);
+
+  if (SD_available(F("en_shunt"))) {
+    cf_en_shunt = SD_findInt(F("en_shunt"));
+  }
+  LOG_INFO ("CF:en_shunt=[%d]", cf_en_shunt);
+
+  cf_tl = SD_findInt(F("tl"));
+  LOG_INFO ("CF:tl=[%d]", cf_tl);
+
+  cf_tl_pin = SD_findInt(F("tl_pin"));
+  LOG_INFO ("CF:tl_pin=[%d]", cf_tl_pin);
+
+  if (SD_available(F("tl_baud"))) {
+    cf_tl_baud = SD_findInt(F("tl_baud"));
+  }
+  LOG_INFO ("CF:tl_baud=[%d]", cf_tl_baud);
+
+  if (SD_available(F("tl_every"))) {
+    cf_tl_every = SD_findInt(F("tl_every"));
+  }
+  LOG_INFO ("CF:tl_every=[%d]", cf_tl_every);
+
+  if (SD_available(F("tl_frame"))) {
+    cf_tl_frame = SD_findInt(F("tl_frame"));
+  }
+  LOG_INFO ("CF:tl_frame=[%d]", cf_tl_frame);
+
+  if (SD_available(F("tl_warm"))) {
+    cf_tl_warm = SD_findInt(F("tl_warm"));
+  }
+  LOG_INFO ("CF:tl_warm=[%d]", cf_tl_warm);
+
+  cf_sh_uart = SD_findInt(F("sh_uart"));
+  LOG_INFO ("CF:sh_uart=[%d]", cf_sh_uart);
+
+  if (SD_available(F("stats"))) {
+    cf_stats = SD_findInt(F("stats"));
+  }
+  LOG_INFO ("CF:stats=[%d]", cf_stats);
+
+  cf_warm = SD_findInt(F("warm"));
+  LOG_INFO ("CF:warm=[%d]", cf_warm);
+
+  cf_ar_ms = SD_findInt(F("ar_ms"));
+  LOG_INFO ("CF:ar_ms=[%d]", cf_ar_ms);
+
+  if (SD_available(F("ar_keep"))) {
+    cf_ar_keep = SD_findInt(F("ar_keep"));
+  }
+  LOG_INFO ("CF:ar_keep=[%d]", cf_ar_keep);
+
+  cf_bg_ms = SD_findInt(F("bg_ms"));
+  LOG_INFO ("CF:bg_ms=[%d]", cf_bg_ms);
+
+  cf_sg_qc = SD_findInt(F("sg_qc"));
+  LOG_INFO ("CF:sg_qc=[%d]", cf_sg_qc);
+
+  if (SD_available(F("sg_qc_mm"))) {
+    cf_sg_qc_mm = SD_findInt(F("sg_qc_mm"));
+  }
+  LOG_INFO ("CF:sg_qc_mm=[%d]", cf_sg_qc_mm);
+
+  if (SD_available(F("sg_qc_roc"))) {
+    cf_sg_qc_roc = SD_findInt(F("sg_qc_roc"));
+  }
+  LOG_INFO ("CF:sg_qc_roc=[%d]", cf_sg_qc_roc);
+
+  cf_sg_datum = SD_findInt(F("sg_datum"));
+  LOG_INFO ("CF:sg_datum=[%d]", cf_sg_datum);
+
+  cf_sg_tc = SD_findInt(F("sg_tc"));
+  LOG_INFO ("CF:sg_tc=[%d]", cf_sg_tc);
+
+  // Calibration points, string keys looked up in the table directly
+  cf_sg_cal_n = 0;
+  for (int k=1; k<=SG_CAL_MAX; k++) {
+    char key[12];
+    int e;
+
+    sprintf (key, "sg_cal%d", k);
+    if ((e = SD_findEntry(key, NULL)) < 0) {
+      continue;
+    }
+    cf_table[e].used = true;
+    if (sscanf(cf_pool + cf_table[e].value, "%d,%d", &cf_sg_cal[cf_sg_cal_n][0], &cf_sg_cal[cf_sg_cal_n][1]) != 2) {
+      LOG_ERR ("CF:%s=[%s] ERR", key, cf_pool + cf_table[e].value);
+      continue;
+    }
+    LOG_INFO ("CF:%s=[%d,%d]", key, cf_sg_cal[cf_sg_cal_n][0], cf_sg_cal[cf_sg_cal_n][1]);
+    cf_sg_cal_n++;
+  }
+
+  cf_bmx_elev = SD_findInt(F("bmx_elev"));
+  LOG_INFO ("CF:bmx_elev=[%d]", cf_bmx_elev);
+
+  cf_bmx_fuse = SD_findInt(F("bmx_fuse"));
+  LOG_INFO ("CF:bmx_fuse=[%d]", cf_bmx_fuse);
+
+  cf_bmx_every = SD_findInt(F("bmx_every"));
+  LOG_INFO ("CF:bmx_every=[%d]", cf_bmx_every);
+
+  cf_mcp_every = SD_findInt(F("mcp_every"));
+  LOG_INFO ("CF:mcp_every=[%d]", cf_mcp_every);
+
+  cf_ds_every = SD_findInt(F("ds_every"));
+  LOG_INFO ("CF:ds_every=[%d]", cf_ds_every);
+
+  cf_bv_every = SD_findInt(F("bv_every"));
+  LOG_INFO ("CF:bv_every=[%d]", cf_bv_every);
+
+  if (SD_available(F("sm_bmx"))) {
+    cf_sm_bmx = SD_findInt(F("sm_bmx"));
+  }
+  LOG_INFO ("CF:sm_bmx=[%d]", cf_sm_bmx);
+
+  if (SD_available(F("sm_ds"))) {
+    cf_sm_ds = SD_findInt(F("sm_ds"));
+  }
+  LOG_INFO ("CF:sm_ds=[%d]", cf_sm_ds);
+
+  if (SD_available(F("sm_adc"))) {
+    cf_sm_adc = SD_findInt(F("sm_adc"));
+  }
+  LOG_INFO ("CF:sm_adc=[%d]", cf_sm_adc);
+
+  cf_sm_btn_pin = SD_findInt(F("sm_btn_pin"));
+  LOG_INFO ("CF:sm_btn_pin=[%d]", cf_sm_btn_pin);
+
+  cf_ds_alarm = SD_findInt(F("ds_alarm"));
+  LOG_INFO ("CF:ds_alarm=[%d]", cf_ds_alarm);
+
+  if (SD_available(F("ds_stale"))) {
+    cf_ds_stale = SD_findInt(F("ds_stale"));
+  }
+  LOG_INFO ("CF:ds_stale=[%d]", cf_ds_stale);
+
+  SD_ReportUnknownKeys();
 }
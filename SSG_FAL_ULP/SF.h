@@ -7,24 +7,231 @@
 // Prototyping functions to aviod compile function unknown issue.
 void Output(const char *str);
 
+/*
+ * ======================================================================================================================
+ *  Scratch Arena - Lines are formatted in space taken from sf_scratch[] instead of shared globals, so a log line
+ *    in the middle of building a record in msgbuf does not clobber it. An SF_SCRATCH on the stack marks the top of
+ *    the arena, alloc() takes from there and the destructor gives it all back when the SF_SCRATCH goes out of scope,
+ *    nested scopes stack. When the arena is full alloc() counts it in sf_scratch_over and returns sf_scratch_spill,
+ *    which one caller at a time may then share, so no allocation may be larger than it. sf_scratch_peak is the most
+ *    in use since boot, the shell's stats prints both.
+ * ======================================================================================================================
+ */
+#define SF_SCRATCH_SIZE   512               // Bytes
+#define SF_SCRATCH_SPILL  160               // Largest single allocation
+#define SF_LINE           32                // A short line, the OLED's 21 columns and a bit
+
+char sf_scratch[SF_SCRATCH_SIZE] __attribute__ ((aligned (4)));
+char sf_scratch_spill[SF_SCRATCH_SPILL];
+uint16_t sf_scratch_top = 0;                // Next free byte
+uint16_t sf_scratch_peak = 0;
+uint16_t sf_scratch_over = 0;               // Allocations that did not fit
+
+struct SF_SCRATCH {
+  uint16_t mark;                            // Top when the scope was entered
+
+  SF_SCRATCH() : mark(sf_scratch_top) { }
+  ~SF_SCRATCH() { sf_scratch_top = mark; }
+
+  /*
+   *=====================================================================================================================
+   * alloc() - n bytes, word aligned, until the scope ends
+   *=====================================================================================================================
+   */
+  char *alloc(uint16_t n) {
+    char *p;
+
+    n = (n + 3) & ~3;
+    if ((n > SF_SCRATCH_SIZE) || (sf_scratch_top > (SF_SCRATCH_SIZE - n))) {
+      sf_scratch_over++;
+      return (sf_scratch_spill);
+    }
+    p = &sf_scratch[sf_scratch_top];
+    sf_scratch_top += n;
+    if (sf_scratch_top > sf_scratch_peak) {
+      sf_scratch_peak = sf_scratch_top;
+    }
+    return (p);
+  }
+};
+
 /*
  * =======================================================================================================================
  *  Measuring Battery - SEE https://learn.adafruit.com/adafruit-feather-m0-radio-with-lora-radio-module/power-management
  * =======================================================================================================================
  */
 #define VBATPIN      A7
+#define VBAT_AVG_LOG2   4           // 16 conversions summed in hardware, ADJRES divides back to a 12bit average
+#define VBAT_SETTLE_US  100         // The 100K/100K divider onto the sample capacitor after the mux change
 
 /*
  *=======================================================================================================================
- * vbat_get() -- return battery voltage
+ * vbat_mv() -- return battery voltage in mV
+ *   The core's analogRead() sets the mux, reference and gain and its conversion starts charging the sample
+ *   capacitor from the divider, the reading is then one start of 16 averaged 12bit conversions. The factory BIAS and
+ *   LINEARITY calibration is loaded from the NVM fuses by the core's init(). The ADC is left the way analogRead()
+ *   expects it, 10bit single conversions and disabled.
+ *=======================================================================================================================
+ */
+int vbat_mv() {
+  uint32_t raw;
+
+  analogRead(VBATPIN);
+  delayMicroseconds(VBAT_SETTLE_US);
+  ADC->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_16BIT_Val;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM(VBAT_AVG_LOG2) | ADC_AVGCTRL_ADJRES(VBAT_AVG_LOG2);
+  ADC->CTRLA.bit.ENABLE = 1;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+  ADC->SWTRIG.bit.START = 1;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  while (!ADC->INTFLAG.bit.RESRDY);
+  raw = ADC->RESULT.reg;
+
+  ADC->CTRLA.bit.ENABLE = 0;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_10BIT_Val;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM_1 | ADC_AVGCTRL_ADJRES(0);
+
+  // We divided by 2 so multiply back, 3.3V reference, 12bit
+  return ((int) ((raw * 2UL * 3300UL + 2048UL) / 4096UL));
+}
+
+/* 
+ *=======================================================================================================================
+ *  I2C Bus - Every part on the bus (BMP/BME280, BMP3XX, MCP9808, DS3231, SSD1306) is rated for Fast-mode 400kHz.
+ *    Wire.begin() is done once here. Drivers call it again in their begin(), which puts the SERCOM back to 100kHz,
+ *    so I2C_Restore() is called after a driver begin().
+ *
+ *    The SAMD core's Wire waits on the SERCOM with no time limit. I2C_Restore() also turns on the SERCOM's own
+ *    timeouts so every wait ends: SCL held low 25-35ms ends the transaction with a STOP, a bus that reads busy with
+ *    SCL idle for 205us is taken as idle, the next START then loses arbitration and Wire returns an error.
+ *    A part holding SDA low is freed by I2C_Bus_Clear(), nine SCL pulses with the pins as GPIO and then a STOP.
+ *    I2C_Bus_Check() does that before the I2C work of an observation when the bus is stuck or the last
+ *    I2C_FAIL_RUN transfers failed, i2c_recoveries is logged in the record.
+ *=======================================================================================================================
+ */
+#define I2C_CLOCK         400000UL
+#define I2C_FAIL_RUN      3         // Failures in a row before the bus is cleared
+#define I2C_HALF_US       5         // Half an SCL period of the recovery clock, 100kHz
+
+bool I2C_begun = false;
+uint16_t i2c_recoveries = 0;        // Bus clears since boot
+uint8_t i2c_fail_run = 0;           // Failed transfers since the last good one
+
+/* 
+ *=======================================================================================================================
+ * I2C_Timeouts() - SCL low and bus inactivity timeouts, CTRLA is enable protected and Wire.begin() clears it
  *=======================================================================================================================
  */
-float vbat_get() {
-  float v = analogRead(VBATPIN);
-  v *= 2;    // we divided by 2, so multiply back
-  v *= 3.3;  // Multiply by 3.3V, our reference voltage
-  v /= 1024; // convert to voltage
-  return (v);
+void I2C_Timeouts() {
+  Sercom *s = IQ_SERCOM;
+
+  s->I2CM.CTRLA.reg &= ~SERCOM_I2CM_CTRLA_ENABLE;
+  while (s->I2CM.SYNCBUSY.bit.ENABLE);
+  s->I2CM.CTRLA.reg |= SERCOM_I2CM_CTRLA_LOWTOUTEN | SERCOM_I2CM_CTRLA_INACTOUT(3);  // 25-35ms, 205us
+  s->I2CM.CTRLA.reg |= SERCOM_I2CM_CTRLA_ENABLE;
+  while (s->I2CM.SYNCBUSY.bit.ENABLE);
+  s->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(1);  // Idle, as Wire does on enable
+  while (s->I2CM.SYNCBUSY.bit.SYSOP);
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_Restore() - Put the bus back to I2C_CLOCK and the timeouts on after a driver begin()
+ *=======================================================================================================================
+ */
+void I2C_Restore() {
+  iq_drain();
+  Wire.setClock(I2C_CLOCK);
+  I2C_Timeouts();
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_Bus_Clear() - Clock out a part holding SDA low and end with a STOP, Wire must not be running. True when
+ *   both lines are high after.
+ *=======================================================================================================================
+ */
+bool I2C_Bus_Clear() {
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, INPUT_PULLUP);
+  delayMicroseconds(I2C_HALF_US);
+
+  // Pulse SCL until the part lets go of SDA, a byte and its ACK is nine
+  for (int i=0; (i<9) && (digitalRead(SDA) == LOW); i++) {
+    pinMode(SCL, OUTPUT);
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(I2C_HALF_US);
+    pinMode(SCL, INPUT_PULLUP);       // Released, open drain
+    delayMicroseconds(I2C_HALF_US);
+  }
+
+  // STOP, SDA rising while SCL is high
+  pinMode(SDA, OUTPUT);
+  digitalWrite(SDA, LOW);
+  delayMicroseconds(I2C_HALF_US);
+  pinMode(SDA, INPUT_PULLUP);
+  delayMicroseconds(I2C_HALF_US);
+
+  return ((digitalRead(SDA) == HIGH) && (digitalRead(SCL) == HIGH));
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_Initialize() - Connect to I2C as Master, only done once
+ *=======================================================================================================================
+ */
+void I2C_Initialize() {
+  if (!I2C_begun) {
+    I2C_Bus_Clear();                // A part left mid byte by a reset would hold SDA
+    Wire.begin();                   // Connect to I2C as Master (no addess is passed to signal being a slave)
+    I2C_begun = true;
+  }
+  I2C_Restore();
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_Result() - Count a transfer's result toward I2C_FAIL_RUN
+ *=======================================================================================================================
+ */
+void I2C_Result(bool ok) {
+  if (ok) {
+    i2c_fail_run = 0;
+  }
+  else if (i2c_fail_run < 255) {
+    i2c_fail_run++;
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_Bus_Check() - Clear the bus when it is stuck or transfers keep failing
+ *=======================================================================================================================
+ */
+void I2C_Bus_Check() {
+  Sercom *s = IQ_SERCOM;
+  bool ok;
+
+  if (!I2C_begun) {
+    return;
+  }
+  iq_drain();
+  if ((i2c_fail_run < I2C_FAIL_RUN) &&
+      ((s->I2CM.STATUS.reg & SERCOM_I2CM_STATUS_BUSSTATE_Msk) != SERCOM_I2CM_STATUS_BUSSTATE(3))) {
+    return;  // Not busy with nobody on it
+  }
+  Wire.end();
+  ok = I2C_Bus_Clear();
+  Wire.begin();
+  I2C_Restore();
+  i2c_recoveries++;
+  i2c_fail_run = 0;
+  sprintf (msgbuf, "I2C:Bus Clear %s", (ok) ? "OK" : "STUCK");
+  Output (msgbuf);
 }
 
 /* 
@@ -38,8 +245,11 @@ float vbat_get() {
 bool I2C_Device_Exist(byte address) {
   byte error;
 
-  Wire.begin();                     // Connect to I2C as Master (no addess is passed to signal being a slave)
+  if (!I2C_begun) {
+    I2C_Initialize();
+  }
 
+  iq_drain();
   Wire.beginTransmission(address);  // Begin a transmission to the I2C slave device with the given address. 
                                     // Subsequently, queue bytes for transmission with the write() function 
                                     // and transmit them by calling endTransmission(). 
@@ -76,6 +286,83 @@ bool I2C_Device_Exist(byte address) {
   }
 }
 
+/* 
+ *=======================================================================================================================
+ *  I2C Boot Scan - I2C_Scan() addresses every 7 bit address once at boot, the drivers' initialize() functions ask
+ *    I2C_Present() instead of each probing the bus, and I2C_Report() lists what answered in one line. Parts that
+ *    come or go later are found by I2C_Check_Sensors(), which still probes.
+ *=======================================================================================================================
+ */
+#define I2C_ADDR_FIRST    0x08          // 0x00-0x07 and 0x78-0x7F are reserved
+#define I2C_ADDR_LAST     0x77
+
+uint8_t i2c_present[16];                // Bit per address that answered the scan
+bool i2c_scanned = false;
+
+/* 
+ *=======================================================================================================================
+ * I2C_Scan() - Build the presence bitmap
+ *=======================================================================================================================
+ */
+void I2C_Scan() {
+  memset (i2c_present, 0, sizeof(i2c_present));
+  for (byte a=I2C_ADDR_FIRST; a<=I2C_ADDR_LAST; a++) {
+    if (I2C_Device_Exist(a)) {
+      i2c_present[a >> 3] |= (1 << (a & 7));
+    }
+  }
+  i2c_scanned = true;
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_Present() - Did address answer the boot scan, a probe until there has been one
+ *=======================================================================================================================
+ */
+bool I2C_Present(byte address) {
+  if (!i2c_scanned) {
+    return (I2C_Device_Exist(address));
+  }
+  return ((i2c_present[address >> 3] & (1 << (address & 7))) != 0);
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_ReadReg() - Read one register, 0 if no answer
+ *=======================================================================================================================
+ */
+byte I2C_ReadReg(byte address, byte reg) {
+  iq_drain();
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  if (Wire.endTransmission() || !Wire.requestFrom(address, 1)) {
+    I2C_Result(false);
+    return (0);
+  }
+  I2C_Result(true);
+  return (Wire.read());
+}
+
+/* 
+ *=======================================================================================================================
+ * I2C_Report() - One line of the addresses that answered the scan
+ *=======================================================================================================================
+ */
+void I2C_Report() {
+  int n;
+
+  n = sprintf (msgbuf, "I2C:");
+  for (byte a=I2C_ADDR_FIRST; (a<=I2C_ADDR_LAST) && (n < (int) sizeof(msgbuf) - 4); a++) {
+    if (I2C_Present(a)) {
+      n += sprintf (msgbuf + n, "%02X ", a);
+    }
+  }
+  if (n == 4) {
+    sprintf (msgbuf + n, "NONE");
+  }
+  Output (msgbuf);
+}
+
 /*
  * ======================================================================================================================
  * Blink() - Count, delay between, delay at end
@@ -124,8 +411,8 @@ void FadeOff(unsigned int time,int decreament){
  * myswap()
  *======================================================================================================================
  */
-void myswap(unsigned int *p, unsigned int *q) {
-  int t;
+void myswap(uint16_t *p, uint16_t *q) {
+  uint16_t t;
   
   t=*p;
   *p=*q;
@@ -137,9 +424,9 @@ void myswap(unsigned int *p, unsigned int *q) {
  * mysort()
  *======================================================================================================================
  */
-void mysort(unsigned int a[], int n)
+void mysort(uint16_t a[], int n)
 {
-  unsigned int i,j,temp;
+  int i,j;
 
   for(i = 0;i < n-1;i++) {
     for(j = 0;j < n-i-1;j++) {
@@ -149,12 +436,459 @@ void mysort(unsigned int a[], int n)
   }
 }
 
+/*
+ *======================================================================================================================
+ * myselect() - Return the k'th smallest (0 based) of a[0..n-1], Hoare's quickselect.
+ *   Average O(n). Partially reorders a[], everything before k ends up <= a[k] and everything after >= a[k].
+ *======================================================================================================================
+ */
+uint16_t myselect(uint16_t a[], int n, int k)
+{
+  int lo = 0, hi = n-1;
+  int i, j;
+  uint16_t pivot;
+
+  while (lo < hi) {
+    pivot = a[(lo+hi)/2];
+    i = lo;
+    j = hi;
+    while (i <= j) {
+      while (a[i] < pivot) i++;
+      while (a[j] > pivot) j--;
+      if (i <= j) {
+        myswap(&a[i], &a[j]);
+        i++;
+        j--;
+      }
+    }
+    if (k <= j) {
+      hi = j;
+    }
+    else if (k >= i) {
+      lo = i;
+    }
+    else {
+      break;   // a[k] == pivot
+    }
+  }
+  return (a[k]);
+}
+
+/*
+ *======================================================================================================================
+ * mymedian() - Median of a[0..n-1], lower middle element when n is even. Same element mysort() would leave at 
+ *              index (n+1)/2-1.
+ *======================================================================================================================
+ */
+uint16_t mymedian(uint16_t a[], int n)
+{
+  if (n <= 0) {
+    return (0);
+  }
+  return (myselect(a, n, (n+1)/2-1));
+}
+
+/*
+ *======================================================================================================================
+ * P2 Quartile Estimator - Streaming min, Q1, median, Q3, max without storing the samples
+ * 
+ *   Extended P-Square algorithm (Jain & Chlamtac, Raatikainen) with 9 markers at the probabilities
+ *   0, 1/8, 2/8 ... 8/8. Marker 0 and 8 are the exact min and max, markers 2, 4, 6 track Q1, median and Q3.
+ *   Integer only. Heights are kept in 1/16 sample units so the parabolic adjustment keeps some precision.
+ *   The first 9 samples are held exactly, so short streams return exact order statistics.
+ *======================================================================================================================
+ */
+#define P2_MARKERS  9
+#define P2_SCALE    16
+
+typedef struct {
+  long q[P2_MARKERS];           // Marker heights * P2_SCALE
+  long n[P2_MARKERS];           // Actual marker positions, 0 based
+  long np8[P2_MARKERS];         // Desired marker positions * 8
+  unsigned long count;          // Samples seen
+} P2_QUARTILES;
+
+/*
+ *======================================================================================================================
+ * p2_reset()
+ *======================================================================================================================
+ */
+void p2_reset(P2_QUARTILES *p) {
+  p->count = 0;
+}
+
+/*
+ *======================================================================================================================
+ * p2_parabolic() - Piecewise-parabolic prediction for marker i moved d (+1/-1) positions
+ *======================================================================================================================
+ */
+long p2_parabolic(P2_QUARTILES *p, int i, int d) {
+  long *q = p->q;
+  long *n = p->n;
+
+  return (q[i] + (d * (
+      ((n[i]-n[i-1]+d) * (q[i+1]-q[i])) / (n[i+1]-n[i]) + 
+      ((n[i+1]-n[i]-d) * (q[i]-q[i-1])) / (n[i]-n[i-1])
+    )) / (n[i+1]-n[i-1]));
+}
+
+/*
+ *======================================================================================================================
+ * p2_add() - Add one sample to the estimator
+ *======================================================================================================================
+ */
+void p2_add(P2_QUARTILES *p, uint16_t sample) {
+  long x = (long) sample * P2_SCALE;
+  long qp;
+  int i, k, d;
+
+  // Startup, keep the first samples in sorted order (insertion) 
+  if (p->count < P2_MARKERS) {
+    for (i = p->count; (i > 0) && (p->q[i-1] > x); i--) {
+      p->q[i] = p->q[i-1];
+    }
+    p->q[i] = x;
+    p->count++;
+    if (p->count == P2_MARKERS) {
+      for (i=0; i<P2_MARKERS; i++) {
+        p->n[i] = i;
+        p->np8[i] = 8 * i;
+      }
+    }
+    return;
+  }
+  p->count++;
+
+  // Find the cell k the sample falls in, extend the extremes
+  if (x < p->q[0]) {
+    p->q[0] = x;
+    k = 0;
+  }
+  else if (x >= p->q[P2_MARKERS-1]) {
+    p->q[P2_MARKERS-1] = x;
+    k = P2_MARKERS-2;
+  }
+  else {
+    for (k=0; x >= p->q[k+1]; k++);
+  }
+
+  for (i=k+1; i<P2_MARKERS; i++) {
+    p->n[i]++;
+  }
+  for (i=0; i<P2_MARKERS; i++) {
+    p->np8[i] += i;   // Desired position moves by its probability i/8
+  }
+
+  // Adjust the middle markers if they are off their desired position by one or more
+  for (i=1; i<P2_MARKERS-1; i++) {
+    d = p->np8[i] - (8 * p->n[i]);
+    if (((d >= 8) && ((p->n[i+1] - p->n[i]) > 1)) || ((d <= -8) && ((p->n[i-1] - p->n[i]) < -1))) {
+      d = (d > 0) ? 1 : -1;
+      qp = p2_parabolic(p, i, d);
+      if ((p->q[i-1] < qp) && (qp < p->q[i+1])) {
+        p->q[i] = qp;
+      }
+      else {
+        p->q[i] += (d * (p->q[i+d] - p->q[i])) / (p->n[i+d] - p->n[i]);   // Linear
+      }
+      p->n[i] += d;
+    }
+  }
+}
+
+/*
+ *======================================================================================================================
+ * p2_quantile() - Return marker m (0=min, 2=Q1, 4=median, 6=Q3, 8=max) in sample units
+ *======================================================================================================================
+ */
+uint16_t p2_quantile(P2_QUARTILES *p, int m) {
+  int i;
+
+  if (p->count == 0) {
+    return (0);
+  }
+  if (p->count < P2_MARKERS) {
+    // Exact order statistic from the sorted startup samples, same index rule as mymedian()
+    i = ((p->count - 1) * m + 4) / 8;
+    if (m == 4) {
+      i = (p->count+1)/2-1;
+    }
+    return ((uint16_t) (p->q[i] / P2_SCALE));
+  }
+  return ((uint16_t) ((p->q[m] + (P2_SCALE/2)) / P2_SCALE));
+}
+
+/*
+ *======================================================================================================================
+ * JSON Builder - Appends to a fixed buffer through a cursor, no strlen() rescans and no sprintf().
+ * 
+ *   Fixed point values (FIX_ONE units) are printed with the fraction truncated to digits, sign first so
+ *   -0.5 is "-0.50". A field that does not fit is left out whole and sets overflow, one byte is
+ *   always kept for the closing brace so the record stays valid JSON.
+ *======================================================================================================================
+ */
+typedef struct {
+  char *buf;
+  int  len;                     // Bytes used, buf[len] is always 0
+  int  max;                     // Bytes usable by fields, leaves room for '}' and the 0
+  bool overflow;                // A field was dropped
+  bool err;                     // Current field did not fit
+} JSONBUF;
+
+/*
+ *======================================================================================================================
+ * jb_init() - Start an empty buffer of size bytes
+ *======================================================================================================================
+ */
+void jb_init(JSONBUF *jb, char *buf, int size) {
+  jb->buf = buf;
+  jb->len = 0;
+  jb->max = size - 2;
+  jb->overflow = false;
+  jb->err = false;
+  buf[0] = 0;
+}
+
+/*
+ *======================================================================================================================
+ * jb_putc() - Append one character
+ *======================================================================================================================
+ */
+void jb_putc(JSONBUF *jb, char c) {
+  if (jb->len >= jb->max) {
+    jb->err = true;
+    return;
+  }
+  jb->buf[jb->len++] = c;
+  jb->buf[jb->len] = 0;
+}
+
+/*
+ *======================================================================================================================
+ * jb_puts() - Append a string
+ *======================================================================================================================
+ */
+void jb_puts(JSONBUF *jb, const char *s) {
+  while (*s && !jb->err) {
+    jb_putc(jb, *s++);
+  }
+}
+
+/*
+ *======================================================================================================================
+ * jb_putu() - Append an unsigned number, zero padded to width digits
+ *======================================================================================================================
+ */
+void jb_putu(JSONBUF *jb, unsigned long v, int width) {
+  char d[10];
+  int n = 0;
+
+  do {
+    d[n++] = '0' + (v % 10);
+    v /= 10;
+  } while (v);
+  while (width-- > n) {
+    jb_putc(jb, '0');
+  }
+  while (n) {
+    jb_putc(jb, d[--n]);
+  }
+}
+
+/*
+ *======================================================================================================================
+ * jb_puti() - Append a signed number, printf "%0*d" rules, the sign counts toward width
+ *======================================================================================================================
+ */
+void jb_puti(JSONBUF *jb, long v, int width) {
+  if (v < 0) {
+    jb_putc(jb, '-');
+    jb_putu(jb, 0UL - (unsigned long)v, width-1);
+  }
+  else {
+    jb_putu(jb, (unsigned long)v, width);
+  }
+}
+
+/*
+ *======================================================================================================================
+ * jb_putfixed() - Append a fixed point value with digits (1-4) of fraction, truncated
+ *======================================================================================================================
+ */
+void jb_putfixed(JSONBUF *jb, int32_t v, int digits) {
+  unsigned long a = (v < 0) ? 0UL - (unsigned long)v : (unsigned long)v;
+  unsigned long frac = a % FIX_ONE;
+
+  for (int i=digits; i<4; i++) {
+    frac /= 10;
+  }
+  if (v < 0) {
+    jb_putc(jb, '-');
+  }
+  jb_putu(jb, a / FIX_ONE, 0);
+  jb_putc(jb, '.');
+  jb_putu(jb, frac, digits);
+}
+
+/*
+ *======================================================================================================================
+ * fix_str() - Fixed point value as a string for messages
+ *======================================================================================================================
+ */
+char *fix_str(char *buf, int size, int32_t v, int digits) {
+  JSONBUF jb;
+
+  jb_init(&jb, buf, size);
+  jb_putfixed(&jb, v, digits);
+  return (buf);
+}
+
+/*
+ *======================================================================================================================
+ * jb_key() - Start a field, opens the object or adds the separating comma
+ *======================================================================================================================
+ */
+int jb_key(JSONBUF *jb, const char *key) {
+  int mark = jb->len;
+
+  jb->err = false;
+  jb_putc(jb, (jb->len == 0) ? '{' : ',');
+  jb_putc(jb, '"');
+  jb_puts(jb, key);
+  jb_putc(jb, '"');
+  jb_putc(jb, ':');
+  return (mark);
+}
+
+/*
+ *======================================================================================================================
+ * jb_end() - Finish a field, drop it whole if it did not fit
+ *======================================================================================================================
+ */
+void jb_end(JSONBUF *jb, int mark) {
+  if (jb->err) {
+    jb->len = mark;
+    jb->buf[mark] = 0;
+    jb->overflow = true;
+    jb->err = false;
+  }
+}
+
+/*
+ *======================================================================================================================
+ * jb_str(), jb_int(), jb_fixed() - Add a field
+ *======================================================================================================================
+ */
+void jb_str(JSONBUF *jb, const char *key, const char *v) {
+  int mark = jb_key(jb, key);
+  jb_putc(jb, '"');
+  jb_puts(jb, v);
+  jb_putc(jb, '"');
+  jb_end(jb, mark);
+}
+
+void jb_int(JSONBUF *jb, const char *key, long v) {
+  int mark = jb_key(jb, key);
+  jb_puti(jb, v, 0);
+  jb_end(jb, mark);
+}
+
+void jb_fixed(JSONBUF *jb, const char *key, int32_t v, int digits) {
+  int mark = jb_key(jb, key);
+  jb_putfixed(jb, v, digits);
+  jb_end(jb, mark);
+}
+
+/*
+ *======================================================================================================================
+ * jb_close() - Close the object, there is always room for the brace
+ *======================================================================================================================
+ */
+void jb_close(JSONBUF *jb) {
+  if (jb->len == 0) {
+    jb->buf[jb->len++] = '{';
+  }
+  jb->buf[jb->len++] = '}';
+  jb->buf[jb->len] = 0;
+}
+
+/*
+ * ======================================================================================================================
+ *  Hardware CRC32 - The Device Service Unit computes the CRC32 of IEEE 802.3 (zlib's crc32(), reflected 0xEDB88320)
+ *    over a word aligned range of memory in about one clock a word while the core waits. dsu_crc32() runs the
+ *    unaligned head and tail bytes in software and the words on the DSU, and carries on from a previous result so
+ *    a file is checked block by block. The DSU is write protected in PAC1 from reset, it is opened for the run and
+ *    protected again. A bus error (a range the DSU may not read) falls back to software for the words too.
+ * ======================================================================================================================
+ */
+#define DSU_PAC1_BIT      (1 << 1)          // DSU's write protect bit in PAC1
+#define CRC32_POLY        0xEDB88320
+
+/*
+ *=======================================================================================================================
+ * crc32_sw() - Bytes into a running CRC32 register, the DSU's DATA before its final inversion
+ *=======================================================================================================================
+ */
+uint32_t crc32_sw(uint32_t reg, const uint8_t *p, uint32_t len) {
+  while (len--) {
+    reg ^= *p++;
+    for (int b=0; b<8; b++) {
+      reg = (reg >> 1) ^ (CRC32_POLY & (0 - (reg & 1)));
+    }
+  }
+  return (reg);
+}
+
+/*
+ *=======================================================================================================================
+ * dsu_crc32() - CRC32 of len bytes at buf, following crc, the CRC of what came before (0 to start)
+ *=======================================================================================================================
+ */
+uint32_t dsu_crc32(const void *buf, uint32_t len, uint32_t crc) {
+  const uint8_t *p = (const uint8_t *) buf;
+  uint32_t reg = ~crc;
+  uint32_t head = (4 - ((uint32_t) p & 3)) & 3;
+  uint32_t words;
+
+  if (head > len) {
+    head = len;
+  }
+  reg = crc32_sw(reg, p, head);
+  p += head;
+  len -= head;
+
+  words = len / 4;
+  if (words) {
+    PAC1->WPCLR.reg = DSU_PAC1_BIT;
+    DSU->STATUSA.reg = DSU_STATUSA_DONE | DSU_STATUSA_BERR;
+    DSU->ADDR.reg = (uint32_t) p;
+    DSU->LENGTH.reg = DSU_LENGTH_LENGTH(words);
+    DSU->DATA.reg = reg;
+    DSU->CTRL.reg = DSU_CTRL_CRC;
+    while (!(DSU->STATUSA.reg & DSU_STATUSA_DONE));
+    if (DSU->STATUSA.reg & DSU_STATUSA_BERR) {
+      reg = crc32_sw(reg, p, words * 4);
+    }
+    else {
+      reg = DSU->DATA.reg;
+    }
+    DSU->STATUSA.reg = DSU_STATUSA_DONE | DSU_STATUSA_BERR;
+    PAC1->WPSET.reg = DSU_PAC1_BIT;
+    p += words * 4;
+    len -= words * 4;
+  }
+  return (~crc32_sw(reg, p, len));
+}
+
 /*
  * =======================================================================================================================
  * isnumeric() - check if string contains all digits
  * =======================================================================================================================
  */
 bool isnumeric(char *s) {
+  if ((s == NULL) || (*s == 0)) {
+    return(false);  // Missing token of a short line
+  }
   for (int i=0; i< strlen(s); i++) {
     if (!isdigit(*(s+i)) ) {
       return(false);
@@ -177,5 +911,6 @@ void JPO_ClearBits() {
     SystemStatusBits &= ~SSB_BMX_2; // Turn Off BMX280_1 Not Found Bit
     SystemStatusBits &= ~SSB_MCP_1; // Turn Off MCP_1 Not Found Bit
     SystemStatusBits &= ~SSB_DS_1;  // Turn Off Dallas Sensor Not Found Bit
+    SystemStatusBits &= ~SSB_WDT;   // Turn Off Watchdog Reset Bit
   }
 }
@@ -13,37 +13,1442 @@
  * The 10-meter sensors (MB7363, MB7366, MB7383, and MB7386) use a scale factor of (Vcc/10240) per 1-mm.
  * Particle 12bit resolution (0-4095), Sensor has a resolution of 0 - 10239mm, Each unit of the 0-4095 resolution is 2.5mm
  * Feather has 10bit resolution (0-1023), Sensor has a resolution of 0 - 10239mm, Each unit of the 0-1023 resolution is 10mm
+ *
+ * With sg_osr set the SAMD21 ADC runs at 12bit (0-4095) and averages sg_osr conversions in hardware (AVGCTRL) for each
+ * timer triggered sample, one wakeup per sample. Each unit is then 1.25mm (5m) or 2.5mm (10m).
+ *
+ * With sg_pw_pin set the pulse width output is timed instead, 1us per mm for every model, see Pulse Width Capture.
+ * With sg_serial set the sensor's own "Rdddd" mm frames are read from Serial1, see Serial Frames.
+ * With sg_trig_pin set each sample of the analog or PW output is a range the sensor was told to take, see Triggered
+ * Ranging.
  */
 
+/*
+ * Sensor Models - Full scale is the distance at the top ADC count, range is what the sensor reports between the
+ *   blanking distance (targets closer read as this) and the max (no target reads as this).
+ */
+typedef struct {
+  int model;                      // MB number
+  unsigned long full_scale_mm;    // Vcc/full_scale_mm per mm
+  unsigned int blank_mm;
+  unsigned int max_mm;
+} SG_SENSOR;
+
+const SG_SENSOR sg_sensors[] = {
+  { 7360,  5120, 300, 5000 },     // 5m HRXL-MaxSonar-WR, ds_type=0 default
+  { 7369,  5120, 300, 5000 },
+  { 7380,  5120, 300, 5000 },
+  { 7389,  5120, 300, 5000 },
+  { 7363, 10240, 500, 9999 },     // 10m HRXL-MaxSonar-WR, ds_type=1 default
+  { 7366, 10240, 500, 9999 },
+  { 7383, 10240, 500, 9999 },
+  { 7386, 10240, 500, 9999 },
+};
+#define SG_SENSORS     (sizeof(sg_sensors) / sizeof(sg_sensors[0]))
+#define SG_SENSOR_5M   0          // Index used for ds_type=0
+#define SG_SENSOR_10M  4          // Index used for ds_type=1
+
+const SG_SENSOR *sg_sensor = &sg_sensors[SG_SENSOR_5M];
+
 #define SGAUGE_PIN     A3
-#define SG_BUCKETS     60
+#define SG_STREAM_BUCKETS 32      // Buffer of a STN_SG_STREAM build (ST.h), trace replay reads through it
+#if STN_SG_STREAM
+#define SG_BUCKETS     SG_STREAM_BUCKETS
+#else
+#define SG_BUCKETS     300        // Maximum samples held, cf_sg_samples is the count taken
+#endif
+#define SG_STEP        10         // Samples between sg_iqr_stop tests once sg_min_samples are in
+
+/*
+ * Channels
+ *   With sg_chans > 1 the ADC input scan (INPUTSCAN) converts the next channel's input on each TC4 event. TC4 runs
+ *   sg_chans times faster and the DMAC moves the results interleaved into sg_buckets[], so every channel is sampled
+ *   across the same window and the awake time is that of one channel. The scan needs consecutive AIN inputs, the
+ *   pins are AIN4 AIN5 AIN3 AIN2 so the first sg_chans of them always are.
+ */
+#define SG_CHANS_MAX   4
+const int sg_chan_pins[SG_CHANS_MAX] = { SGAUGE_PIN, A4, A2, A1 };
+int sg_chans = 1;
+const SG_SENSOR *sg_chan_sensor[SG_CHANS_MAX];
+uint8_t sg_scan_ain = 0;                  // Lowest AIN in the scan
+uint8_t sg_chan_pos[SG_CHANS_MAX];        // Place of each channel in the scan
+unsigned int sg_chan_mm[SG_CHANS_MAX];    // Median of each channel, [0] is what s_gauge_median() returns
+uint16_t sg_chan_buf[SG_BUCKETS / 2];     // One channel gathered out of the interleave
+
+/*
+ * Sampling Engine
+ *   TC4 overflows every cf_sg_interval ms and fires an event that starts an ADC conversion. The DMAC moves each
+ *   result into sg_buckets[] so the CPU stays in LowPower.idle() for the whole window and only wakes to do the median.
+ *   TC4 is clocked from GCLK0 (48MHz) / 1024 = 46875Hz, so the longest interval is 65535 ticks = 1398ms.
+ */
+#define SG_TC                 TC4
+#define SG_TC_HZ              (48000000UL / 1024)
+#define SG_EVENT_TC_HZ        (32768UL / 1024)    // TC4 from OSCULP32K while asleep, 65535 ticks = 2048s
+#define SG_INTERVAL_MAX       1000        // ms
+#define SG_INTERVAL_MIN       10          // ms
+#define SG_OSR_MAX            16          // Conversions averaged, AVGCTRL ADJRES only divides down to 12bit up to 16
+
+int sg_adc_bits = 10;                     // Resolution of the counts in sg_buckets[]
+
+/*
+ * Pulse Width Capture
+ *   The PW pin's EIC line is a level event (sense HIGH, no interrupt) routed by event channel 1 to TC3 in PWP mode:
+ *   the rising edge restarts the count, the falling edge captures the pulse width in CC0. The DMAC moves CC0 into
+ *   sg_buckets[] on each capture, so there is no CPU work per edge. TC3 runs at 48MHz / 16, 3 ticks per us = per mm,
+ *   the longest pulse (10239mm) is 30717 ticks.
+ */
+#define SG_PW_TC              TC3
+#define SG_PW_TICKS_MM        3           // TC3 ticks per mm
+#define SG_PW_PERIOD_MS       200         // Longest time between sensor readings, for timeouts
+
+/*
+ * Serial Frames
+ *   The MB73xx TTL serial output (pin 5) sends "Rdddd\r" in mm after each reading, 9600 8N1, about 6 a second. It
+ *   goes to Serial1 RX (D0, SERCOM0). The SAMD21 cannot invert RX, RS232 level models need an inverter. The core's
+ *   RX interrupt is turned off and the DMAC moves each byte into sg_ser_ring[], two blocks of SG_SER_BLOCK bytes
+ *   (SG_STEP frames). The CPU stays in LowPower.idle() and only wakes to parse a block once it is full.
+ */
+#define SG_SER_SERCOM         SERCOM0
+#define SG_SER_DMAC_ID_RX     SERCOM0_DMAC_ID_RX
+#define SG_SER_BAUD           9600
+#define SG_SER_FRAME          6           // R, 4 digits, CR
+#define SG_SER_BLOCK          (SG_STEP * SG_SER_FRAME)
+#define SG_SER_PERIOD_MS      200         // Longest time between frames, for timeouts
+
+volatile uint8_t sg_ser_ring[2 * SG_SER_BLOCK];
+int sg_ser_val = -1;                      // Frame being parsed, -1 = waiting for R
+int sg_ser_digits = 0;
+
+/*
+ * Triggered Ranging
+ *   Free running, the MB73xx ranges on its own and filters the readings, the analog output lags and samples taken
+ *   close together are not independent. With sg_trig_pin wired to the sensor's RX (pin 4) the pin is held low so
+ *   the sensor waits, and each sample is a pulse of SG_TRIG_US on it. The analog output is converted SG_TRIG_RANGE_MS
+ *   later, when the range is done, or the PW pulse of that range is captured. The CPU is in LowPower.idle() until
+ *   then and on to the next pulse, sg_interval or SG_TRIG_RANGE_MS apart, whichever is longer. Not with sg_serial.
+ */
+#define SG_TRIG_US            30          // RX high for 20us or more commands a range
+#define SG_TRIG_RANGE_MS      160         // Range and output update after the pulse
+
+// Where gauge samples come from, picked by s_gauge_initialize()
+#define SG_SRC_ADC            0
+#define SG_SRC_PW             1
+#define SG_SRC_SERIAL         2
+int sg_source = SG_SRC_ADC;
+
+uint16_t sg_buckets[SG_BUCKETS];
+unsigned int sg_count = 0;                // Number of samples collected by the last sampling window
+int sg_samples = 60;                      // Samples taken per observation, cf_sg_samples less any power profile cut
+
+// Spread of the last sampling window in ADC counts, from the buffer or the streaming estimator
+uint16_t sg_min = 0;
+uint16_t sg_max = 0;
+uint16_t sg_iqr = 0;
+P2_QUARTILES sg_p2;
+
+// Called while the DMAC fills a window or the sensor settles, calibration mode runs its other tasks here (TK.h).
+// Not called by the streaming estimator, it has no buffer to cover a late return.
+void (*sg_yield)() = NULL;
+
+/*
+ * Window Timing
+ *   The samples are paced by TC4 or the sensor, not the CPU, so work done between them does not move them. OBS_Do()
+ *   reads the sensors whose conversions are done through sg_gap, called where sg_yield is. sg_window_ms is the length
+ *   of the last window. sg_jitter_ms is the latest a sample came after its slot: for the timer triggered ADC the time
+ *   the window ran past samples times interval, conversions lost between DMAC blocks while sg_iqr_stop selected. For
+ *   triggered ranging the pulses go out on slots sg_interval apart counted from the first, a range that runs past the
+ *   next slot is measured and the slots move on rather than bunch up. PW and serial readings come when the sensor
+ *   ranges, there is no slot and it stays 0.
+ */
+void (*sg_gap)() = NULL;                  // Work between samples, OBS.h
+unsigned long sg_window_ms = 0;
+unsigned long sg_jitter_ms = 0;
+
+/*
+ * Power Gating
+ *   With sg_pwr_pin set the sensor is powered through a load switch on that pin, high = on. It is turned on for the
+ *   sampling window only. After power on the MB73xx calibrates and ranges before its output is valid, sg_settle ms
+ *   are waited in LowPower.idle(). The saving per cycle is sg_ma for the part of the interval it was off.
+ */
+bool sg_powered = true;                   // Always on when not gated
+unsigned long sg_on_ms = 0;               // Awake time powered this cycle
+
+/* 
+ *=======================================================================================================================
+ * sg_power() - Switch the sensor, on waits out the settle time
+ *=======================================================================================================================
+ */
+void sg_power(bool on) {
+  unsigned long start;
+
+  if (!cf_sg_pwr_pin || (on == sg_powered)) {
+    return;
+  }
+
+  if (on) {
+    digitalWrite(cf_sg_pwr_pin, HIGH);
+    sg_powered = true;
+    start = millis();
+    while (((millis() - start) < (unsigned long) cf_sg_settle) && !ph_over(PH_SG)) {
+      if (sg_gap) {
+        sg_gap();
+      }
+      if (sg_yield) {
+        sg_yield();
+      }
+      LowPower.idle();  // SysTick wakes us each ms
+    }
+    sg_on_ms = millis();
+  }
+  else {
+    digitalWrite(cf_sg_pwr_pin, LOW);
+    sg_powered = false;
+    sg_on_ms = millis() - sg_on_ms + cf_sg_settle;  // Total time on
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_power_report() - Charge not drawn this cycle against an always on sensor
+ *=======================================================================================================================
+ */
+void sg_power_report() {
+  unsigned long cycle_ms = obs_interval_s * 1000UL;
+  unsigned long off_ms;
+
+  if (!cf_sg_pwr_pin || cf_sg_event) {
+    return;  // Level events keep it on while asleep
+  }
+  off_ms = (sg_on_ms < cycle_ms) ? cycle_ms - sg_on_ms : 0;
+
+  // uAh = mA/10 * ms / 3600 / 10
+  LOG_DBG ("SG:On %lums Saved %luuAh", sg_on_ms, (off_ms / 100UL) * cf_sg_ma / 360UL);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_timer_start() - TC4 periodic overflow event to the ADC start input through event channel 0. With standby TC4
+ *   runs from GCLK6 (OSCULP32K, set up by LowPower) so it keeps starting conversions in LowPower.sleep().
+ *=======================================================================================================================
+ */
+void sg_timer_start(unsigned long interval_ms, bool standby) {
+  unsigned long hz = (standby) ? SG_EVENT_TC_HZ : SG_TC_HZ;
+
+  PM->APBCMASK.reg |= PM_APBCMASK_TC4 | PM_APBCMASK_EVSYS;
+
+  GCLK->CLKCTRL.reg = (uint16_t) (GCLK_CLKCTRL_CLKEN | ((standby) ? GCLK_CLKCTRL_GEN_GCLK6 : GCLK_CLKCTRL_GEN_GCLK0) |
+                                  GCLK_CLKCTRL_ID_TC4_TC5);
+  while (GCLK->STATUS.bit.SYNCBUSY);
+
+  // Event channel 0: TC4 overflow -> ADC start conversion. User channel numbers are one more than the channel.
+  EVSYS->USER.reg = (uint16_t) (EVSYS_USER_CHANNEL(1) | EVSYS_USER_USER(EVSYS_ID_USER_ADC_START));
+  EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(0) | EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_TC4_OVF) | 
+                       EVSYS_CHANNEL_PATH_ASYNCHRONOUS | EVSYS_CHANNEL_EDGSEL_NO_EVT_OUTPUT;
+
+  SG_TC->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (SG_TC->COUNT16.STATUS.bit.SYNCBUSY);
+  SG_TC->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV1024 |
+                             ((standby) ? TC_CTRLA_RUNSTDBY : 0);
+  SG_TC->COUNT16.CC[0].reg = (uint16_t) ((hz * interval_ms) / 1000) - 1;
+  SG_TC->COUNT16.EVCTRL.reg = TC_EVCTRL_OVFEO;
+  SG_TC->COUNT16.COUNT.reg = 0;
+  while (SG_TC->COUNT16.STATUS.bit.SYNCBUSY);
+  SG_TC->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (SG_TC->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_timer_stop()
+ *=======================================================================================================================
+ */
+void sg_timer_stop() {
+  SG_TC->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (SG_TC->COUNT16.STATUS.bit.SYNCBUSY);
+  EVSYS->USER.reg = (uint16_t) (EVSYS_USER_CHANNEL(0) | EVSYS_USER_USER(EVSYS_ID_USER_ADC_START));
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_adc_start() - ADC conversions started by event from sg_timer
+ *=======================================================================================================================
+ */
+void sg_adc_start() {
+  uint8_t n = 0;
+
+  // Let the core configure the pin mux, reference, gain and input mux. It leaves the ADC disabled.
+  analogRead(SGAUGE_PIN);
+
+  if (cf_sg_osr) {
+    while ((1 << n) < cf_sg_osr) {
+      n++;
+    }
+    // One start event runs all 2^n conversions, ADJRES divides the sum back to a 12bit average
+    ADC->CTRLB.bit.RESSEL = (n) ? ADC_CTRLB_RESSEL_16BIT_Val : ADC_CTRLB_RESSEL_12BIT_Val;
+    while (ADC->STATUS.bit.SYNCBUSY);
+    ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM(n) | ADC_AVGCTRL_ADJRES(n);
+    sg_adc_bits = 12;
+  }
+  else {
+    sg_adc_bits = 10;
+  }
+
+  if (sg_chans > 1) {
+    for (int c=1; c<sg_chans; c++) {
+      pinPeripheral(sg_chan_pins[c], PIO_ANALOG);
+    }
+    ADC->INPUTCTRL.bit.MUXPOS = sg_scan_ain;
+    ADC->INPUTCTRL.bit.INPUTSCAN = sg_chans - 1;
+    ADC->INPUTCTRL.bit.INPUTOFFSET = 0;
+    while (ADC->STATUS.bit.SYNCBUSY);
+  }
+
+  ADC->EVCTRL.reg = ADC_EVCTRL_STARTEI;
+  ADC->INTFLAG.reg = ADC_INTFLAG_RESRDY;
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_adc_stop()
+ *=======================================================================================================================
+ */
+void sg_adc_stop() {
+  ADC->CTRLA.bit.ENABLE = 0;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->EVCTRL.reg = 0;
+
+  // Back to the core's 10bit single conversion for analogRead()
+  if (cf_sg_osr) {
+    ADC->CTRLB.bit.RESSEL = ADC_CTRLB_RESSEL_10BIT_Val;
+    while (ADC->STATUS.bit.SYNCBUSY);
+    ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM_1 | ADC_AVGCTRL_ADJRES(0);
+  }
+  if (sg_chans > 1) {
+    ADC->INPUTCTRL.bit.INPUTSCAN = 0;   // analogRead() only sets MUXPOS
+    ADC->INPUTCTRL.bit.INPUTOFFSET = 0;
+    while (ADC->STATUS.bit.SYNCBUSY);
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_pw_start() - Capture the PW pulse width of each sensor reading into TC3 CC0
+ *=======================================================================================================================
+ */
+void sg_pw_start() {
+  uint32_t in = g_APinDescription[cf_sg_pw_pin].ulExtInt;
+  uint32_t pos = (in % 8) * 4;
+
+  PM->APBCMASK.reg |= PM_APBCMASK_TC3 | PM_APBCMASK_EVSYS;
+  GCLK->CLKCTRL.reg = (uint16_t) (GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TCC2_TC3);
+  while (GCLK->STATUS.bit.SYNCBUSY);
+
+  // Pin to the EIC, level sense needs no EIC clock to make the event. No interrupt.
+  if (!EIC->CTRL.bit.ENABLE) {
+    GCLK->CLKCTRL.reg = (uint16_t) (GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_EIC);
+    while (GCLK->STATUS.bit.SYNCBUSY);
+    EIC->CTRL.bit.ENABLE = 1;
+    while (EIC->STATUS.bit.SYNCBUSY);
+  }
+  pinPeripheral(cf_sg_pw_pin, PIO_EXTINT);
+  EIC->INTENCLR.reg = (1 << in);
+  EIC->CONFIG[in / 8].reg = (EIC->CONFIG[in / 8].reg & ~(0xFUL << pos)) | (EIC_CONFIG_SENSE0_HIGH_Val << pos);
+  EIC->EVCTRL.reg |= (1 << in);
+
+  // Event channel 1: EXTINT -> TC3. User channel numbers are one more than the channel.
+  EVSYS->USER.reg = (uint16_t) (EVSYS_USER_CHANNEL(2) | EVSYS_USER_USER(EVSYS_ID_USER_TC3_EVU));
+  EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(1) | EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_EIC_EXTINT_0 + in) | 
+                       EVSYS_CHANNEL_PATH_ASYNCHRONOUS | EVSYS_CHANNEL_EDGSEL_NO_EVT_OUTPUT;
+
+  SG_PW_TC->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (SG_PW_TC->COUNT16.STATUS.bit.SYNCBUSY);
+  SG_PW_TC->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV16;
+  SG_PW_TC->COUNT16.EVCTRL.reg = TC_EVCTRL_TCEI | TC_EVCTRL_EVACT_PWP;
+  SG_PW_TC->COUNT16.CTRLC.reg = TC_CTRLC_CPTEN0 | TC_CTRLC_CPTEN1;
+  SG_PW_TC->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0 | TC_INTFLAG_MC1 | TC_INTFLAG_OVF;
+  while (SG_PW_TC->COUNT16.STATUS.bit.SYNCBUSY);
+  SG_PW_TC->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (SG_PW_TC->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_pw_stop()
+ *=======================================================================================================================
+ */
+void sg_pw_stop() {
+  uint32_t in = g_APinDescription[cf_sg_pw_pin].ulExtInt;
+
+  SG_PW_TC->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (SG_PW_TC->COUNT16.STATUS.bit.SYNCBUSY);
+  EIC->EVCTRL.reg &= ~(1 << in);
+  EVSYS->USER.reg = (uint16_t) (EVSYS_USER_CHANNEL(0) | EVSYS_USER_USER(EVSYS_ID_USER_TC3_EVU));
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_stop_counts() - sg_iqr_stop in sample units (ADC counts at sg_adc_bits, PW ticks or mm), 0 = no early stop
+ *=======================================================================================================================
+ */
+unsigned int sg_stop_counts() {
+  if (sg_source == SG_SRC_PW) {
+    return ((unsigned int) cf_sg_iqr_stop * SG_PW_TICKS_MM);
+  }
+  if (sg_source == SG_SRC_SERIAL) {
+    return ((unsigned int) cf_sg_iqr_stop);
+  }
+  return ((unsigned int) (((unsigned long) cf_sg_iqr_stop << sg_adc_bits) / sg_sensor->full_scale_mm));
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_serial_parse() - Take the frames in len bytes of the ring, a frame split across blocks carries over.
+ *   Readings go to sg_buckets[n] or the P2 estimator, return n plus readings taken, no more than count.
+ *=======================================================================================================================
+ */
+unsigned int sg_serial_parse(volatile uint8_t *buf, uint16_t len, unsigned int n, unsigned int count, bool stream) {
+  uint8_t c;
+
+  for (uint16_t i=0; (i<len) && (n<count); i++) {
+    c = buf[i];
+    if (c == 'R') {
+      sg_ser_val = 0;
+      sg_ser_digits = 0;
+    }
+    else if ((sg_ser_val >= 0) && (c >= '0') && (c <= '9') && (sg_ser_digits < 4)) {
+      sg_ser_val = (sg_ser_val * 10) + (c - '0');
+      sg_ser_digits++;
+    }
+    else {
+      if ((c == '\r') && (sg_ser_digits == 4)) {
+        if (stream) {
+          p2_add(&sg_p2, (uint16_t) sg_ser_val);
+        }
+        else {
+          sg_buckets[n] = (uint16_t) sg_ser_val;
+        }
+        n++;
+      }
+      sg_ser_val = -1;  // Frame done, or noise
+    }
+  }
+  return (n);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_serial_collect() - Up to count readings from the serial frames, parsed a block at a time. sg_iqr_stop is tested
+ *   after each block once sg_min_samples are in. Return readings taken.
+ *=======================================================================================================================
+ */
+unsigned int sg_serial_collect(unsigned int count, bool stream) {
+  unsigned long timeout;
+  unsigned int n = 0;
+  unsigned int stop = sg_stop_counts();
+  uint16_t seen = 0;
+  uint16_t part;
+  bool settled = false;
+
+  sg_ser_val = -1;
+  Serial1.begin(SG_SER_BAUD);
+  SG_SER_SERCOM->USART.INTENCLR.reg = SERCOM_USART_INTENCLR_MASK;  // Bytes are for the DMAC, not the core's buffer
+  dma_ring_start(DMA_CH_SG, SG_SER_DMAC_ID_RX, &SG_SER_SERCOM->USART.DATA.reg, sg_ser_ring, SG_SER_BLOCK);
+
+  timeout = millis() + ((unsigned long) count * SG_SER_PERIOD_MS) + 1000;
+  while ((n < count) && !settled && ((long)(millis() - timeout) < 0) && !ph_over(PH_SG)) {
+    if (dma_blocks[DMA_CH_SG] == seen) {
+      if (sg_gap) {
+        sg_gap();
+      }
+      if (sg_yield) {
+        sg_yield();
+      }
+      LowPower.idle();  // SysTick wakes us each ms, the DMAC at the end of each block
+      continue;
+    }
+    n = sg_serial_parse(&sg_ser_ring[(seen % 2) * SG_SER_BLOCK], SG_SER_BLOCK, n, count, stream);
+    seen++;
+
+    if (cf_sg_iqr_stop && (n >= (unsigned int) cf_sg_min_samples)) {
+      settled = (stream) ? ((p2_quantile(&sg_p2, 6) - p2_quantile(&sg_p2, 2)) <= (long) stop) :
+                           ((myselect(sg_buckets, n, (3*n)/4) - myselect(sg_buckets, n, n/4)) <= stop);
+    }
+  }
+
+  part = dma_ring_stop(DMA_CH_SG, SG_SER_BLOCK);
+  Serial1.end();
+
+  // Timed out with a block part filled
+  if ((n < count) && !settled && (dma_blocks[DMA_CH_SG] == seen)) {
+    n = sg_serial_parse(&sg_ser_ring[(seen % 2) * SG_SER_BLOCK], part, n, count, stream);
+  }
+  return (n);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_trig_collect() - Up to count samples, each from its own triggered range. Samples go to sg_buckets[] or the P2
+ *   estimator, sg_iqr_stop is tested as in s_gauge_sample(). Return samples taken.
+ *=======================================================================================================================
+ */
+unsigned int sg_trig_collect(unsigned int count, bool stream) {
+  unsigned long period = ((unsigned long) cf_sg_interval > SG_TRIG_RANGE_MS) ? cf_sg_interval : SG_TRIG_RANGE_MS;
+  unsigned long t0, slot, late;
+  unsigned int n = 0;
+  unsigned int stop = sg_stop_counts();
+  unsigned int next = (cf_sg_iqr_stop) ? cf_sg_min_samples : count;
+  uint16_t v;
+  bool got;
+
+  if (sg_source == SG_SRC_PW) {
+    sg_pw_start();
+  }
+  else {
+    sg_adc_start();
+    ADC->EVCTRL.reg = 0;  // Started by software, after each range
+    ADC->CTRLA.bit.ENABLE = 1;
+    while (ADC->STATUS.bit.SYNCBUSY);
+  }
+
+  slot = millis();
+  while ((n < count) && !ph_over(PH_SG)) {
+    if (sg_source == SG_SRC_PW) {
+      SG_PW_TC->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+    }
+    digitalWrite(cf_sg_trig_pin, HIGH);
+    delayMicroseconds(SG_TRIG_US);
+    digitalWrite(cf_sg_trig_pin, LOW);
+    t0 = millis();
+    late = t0 - slot;
+    if (late > sg_jitter_ms) {
+      sg_jitter_ms = late;
+    }
+    slot += period * (late / period + 1);  // Past slots are dropped, not caught up
+
+    if (sg_source == SG_SRC_PW) {
+      while (!(got = SG_PW_TC->COUNT16.INTFLAG.bit.MC0) && ((millis() - t0) < SG_PW_PERIOD_MS)) {
+        LowPower.idle();  // SysTick wakes us each ms
+      }
+      if (got) {
+        v = SG_PW_TC->COUNT16.CC[0].reg;
+        if (stream) {
+          p2_add(&sg_p2, v);
+        }
+        else {
+          sg_buckets[n] = v;
+        }
+        n++;
+      }
+    }
+    else {
+      while ((millis() - t0) < SG_TRIG_RANGE_MS) {
+        LowPower.idle();
+      }
+      for (int c=0; (c<sg_chans) && (n<count); c++) {  // Each start converts the next input of the scan
+        ADC->SWTRIG.bit.START = 1;
+        while (!ADC->INTFLAG.bit.RESRDY);
+        v = ADC->RESULT.reg;
+        if (stream) {
+          p2_add(&sg_p2, v);
+        }
+        else {
+          sg_buckets[n] = v;
+        }
+        n++;
+      }
+    }
+
+    if (cf_sg_iqr_stop && (n >= next)) {
+      if ((stream) ? ((p2_quantile(&sg_p2, 6) - p2_quantile(&sg_p2, 2)) <= (long) stop) :
+                     ((myselect(sg_buckets, n, (3*n)/4) - myselect(sg_buckets, n, n/4)) <= stop)) {
+        break;
+      }
+      next += SG_STEP;
+    }
+    while (((long)(millis() - slot) < 0) && (n < count)) {
+      if (sg_gap) {
+        sg_gap();
+      }
+      if (sg_yield && !stream) {
+        sg_yield();
+      }
+      LowPower.idle();
+    }
+  }
+
+  if (sg_source == SG_SRC_PW) {
+    sg_pw_stop();
+  }
+  else {
+    sg_adc_stop();
+  }
+  return (n);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_source_start(), sg_source_stop() - Start the PW capture or the timer triggered ADC, return ms between samples
+ *=======================================================================================================================
+ */
+unsigned long sg_source_start(int interval_ms) {
+  if (sg_source == SG_SRC_PW) {
+    sg_pw_start();
+    return (SG_PW_PERIOD_MS);
+  }
+  sg_adc_start();
+  ADC->CTRLA.bit.ENABLE = 1;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  sg_timer_start(interval_ms / sg_chans, false);  // One conversion per channel each interval
+  return (interval_ms / sg_chans);
+}
+
+void sg_source_stop() {
+  if (sg_source == SG_SRC_PW) {
+    sg_pw_stop();
+    return;
+  }
+  sg_timer_stop();
+  sg_adc_stop();
+}
+
+/*
+ * Gauge Traces
+ *   With sg_trace=1 the raw samples of each observation are appended to /OBS/SGTRACE.bin, a uint16 count then the
+ *   counts, channels interleaved. With sg_trace=2 the gauge is not sampled, each observation takes the next record
+ *   of SGTRACE.bin instead and starts over after the last one. A bench unit then runs the median, QC, record and
+ *   logging code on a field station's gauge data, its logs can be compared with the logs that station wrote.
+ *   Streamed observations are fed the trace one sample at a time but are not recorded, there is no buffer.
+ */
+#define SG_TRACE_RECORD       1
+#define SG_TRACE_REPLAY       2
+
+uint32_t sg_trace_pos = 0;                // Next replay record in SGTRACE.bin
+
+/* 
+ *=======================================================================================================================
+ * sg_trace_write() - Append the n samples in sg_buckets[] to the trace
+ *=======================================================================================================================
+ */
+void sg_trace_write(unsigned int n) {
+  uint16_t len = n;
+  char path[24];
+  File fp;
+
+  if (!SD_exists || SD_down) {
+    return;
+  }
+  sprintf (path, "%s/SGTRACE.bin", SD_obsdir);
+  fp = SD.open(path, FILE_WRITE);
+  if (!fp) {
+    Output ("SG:Trace Err");
+    return;
+  }
+  fp.write((const uint8_t *)&len, sizeof(len));
+  fp.write((const uint8_t *)sg_buckets, n * sizeof(sg_buckets[0]));
+  fp.close();
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_trace_read() - Next trace record into sg_buckets[], at most count samples, return samples read. With stream
+ *   each sample goes to the P2 estimator, read SG_BUCKETS at a time, so the record may be longer than the buffer.
+ *=======================================================================================================================
+ */
+unsigned int sg_trace_read(unsigned int count, bool stream) {
+  uint16_t len = 0;
+  unsigned int n, got, total = 0;
+  char path[24];
+  File fp;
+
+  if (!SD_exists || SD_down) {
+    return (0);
+  }
+  sprintf (path, "%s/SGTRACE.bin", SD_obsdir);
+  fp = SD.open(path, FILE_READ);
+  if (!fp) {
+    Output ("SG:Trace NF");
+    return (0);
+  }
+  if ((sg_trace_pos + sizeof(len)) >= fp.size()) {
+    sg_trace_pos = 0;  // Played through, start over
+  }
+  fp.seek(sg_trace_pos);
+  if (fp.read(&len, sizeof(len)) != sizeof(len)) {
+    len = 0;
+  }
+  n = (len < count) ? len : count;
+  if (!stream) {
+    n = (n < SG_BUCKETS) ? n : SG_BUCKETS;
+  }
+  while (total < n) {
+    got = ((n - total) < SG_BUCKETS) ? (n - total) : SG_BUCKETS;
+    got = fp.read(sg_buckets, got * sizeof(sg_buckets[0])) / sizeof(sg_buckets[0]);
+    if (got == 0) {
+      break;
+    }
+    for (unsigned int i=0; stream && (i<got); i++) {
+      p2_add(&sg_p2, sg_buckets[i]);
+    }
+    total += got;
+  }
+  sg_trace_pos += sizeof(len) + (uint32_t) len * sizeof(sg_buckets[0]);
+  fp.close();
+  return (total);
+}
+
+/*
+ * Raw Capture
+ *   With sg_raw set the samples of an observation are appended to /OBS/RAW/YYYYMMDD.bin, at most one observation
+ *   every sg_raw minutes and SG_RAW_DAY_MAX a day, so it can be left on in the field for days. Each record is an
+ *   SG_RAWHDR and n uint16 samples as taken (ADC counts at bits, PW ticks or mm), channels interleaved. Sample i of
+ *   channel c was taken about (i / chans) * interval_ms after the window started, interval_ms 0 is one per sensor
+ *   reading spread over window_ms. With SG_RAW_F_SELECTED sg_iqr_stop has reordered what was taken before its last
+ *   test. Streamed observations have no buffer and are not captured. tools/sgraw2csv.py prints the samples.
+ */
+#define SG_RAW_MAGIC          0x5752      // "RW"
+#define SG_RAW_DAY_MAX        288
+#define SG_RAW_F_SELECTED     0x01        // Order not kept, sg_iqr_stop
+#define SG_RAW_F_TRIG         0x02        // Triggered ranging
+
+typedef struct __attribute__((packed)) {
+  uint16_t magic;                         // SG_RAW_MAGIC
+  uint32_t at;                            // Unix time the window started
+  uint32_t window_ms;                     // Window length
+  uint16_t interval_ms;                   // Per channel, 0 = one per sensor reading
+  uint16_t n;                             // Samples that follow
+  uint8_t  source;                        // SG_SRC_*
+  uint8_t  bits;                          // ADC resolution, 0 when not the ADC
+  uint8_t  chans;
+  uint8_t  flags;                         // SG_RAW_F_*
+} SG_RAWHDR;                              // 18 bytes
+
+uint32_t sg_raw_last = 0;                 // Window start of the last capture
+uint16_t sg_raw_day = 0;                  // Day of sg_raw_n, days since 1970
+uint16_t sg_raw_n = 0;                    // Captures that day
+
+/* 
+ *=======================================================================================================================
+ * sg_raw_write() - Append the n samples in sg_buckets[] of a window that started at at and took window_ms
+ *=======================================================================================================================
+ */
+void sg_raw_write(unsigned int n, uint32_t at, unsigned long window_ms) {
+  SG_RAWHDR h;
+  DateTime day(at);
+  char path[32];
+  File fp;
+
+  if (!SD_exists || SD_down || !RTC_valid) {
+    return;
+  }
+  if ((uint16_t) (at / 86400) != sg_raw_day) {
+    sg_raw_day = at / 86400;
+    sg_raw_n = 0;
+  }
+  if ((sg_raw_n >= SG_RAW_DAY_MAX) || (sg_raw_last && ((at - sg_raw_last + OBS_EARLY_S) < (uint32_t) cf_sg_raw * 60))) {
+    return;
+  }
+
+  sprintf (path, "%s/RAW", SD_obsdir);
+  if (!SD.exists(path) && !SD.mkdir(path)) {
+    Output ("SG:Raw Err");
+    return;
+  }
+  sprintf (path, "%s/RAW/%4d%02d%02d.bin", SD_obsdir, day.year(), day.month(), day.day());
+  fp = SD.open(path, FILE_WRITE);
+  if (!fp) {
+    Output ("SG:Raw Err");
+    return;
+  }
+  h.magic = SG_RAW_MAGIC;
+  h.at = at;
+  h.window_ms = window_ms;
+  h.interval_ms = ((sg_source == SG_SRC_ADC) || cf_sg_trig_pin) ? cf_sg_interval : 0;
+  if (cf_sg_trig_pin && (cf_sg_interval < SG_TRIG_RANGE_MS)) {
+    h.interval_ms = SG_TRIG_RANGE_MS;
+  }
+  h.n = n;
+  h.source = sg_source;
+  h.bits = (sg_source == SG_SRC_ADC) ? sg_adc_bits : 0;
+  h.chans = sg_chans;
+  h.flags = ((cf_sg_iqr_stop) ? SG_RAW_F_SELECTED : 0) | ((cf_sg_trig_pin) ? SG_RAW_F_TRIG : 0);
+  fp.write((const uint8_t *)&h, sizeof(h));
+  fp.write((const uint8_t *)sg_buckets, n * sizeof(sg_buckets[0]));
+  fp.close();
+  sg_raw_last = at;
+  sg_raw_n++;
+}
 
-unsigned int sg_bucket = 0;
-unsigned int sg_buckets[SG_BUCKETS];
+/* 
+ *=======================================================================================================================
+ * sg_slip() - sg_jitter_ms of a timer triggered window of n conversions period_ms apart that took ms. The last result
+ *   is seen at the SysTick wake after it, up to SG_SLIP_TOL_MS late without any conversion lost.
+ *=======================================================================================================================
+ */
+#define SG_SLIP_TOL_MS        1
+
+void sg_slip(unsigned long ms, unsigned int n, unsigned long period_ms) {
+  unsigned long due = (unsigned long) n * period_ms + SG_SLIP_TOL_MS;
+
+  if ((sg_source == SG_SRC_ADC) && (ms > due)) {
+    sg_jitter_ms = ms - due;
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * s_gauge_sample() - Fill sg_buckets[] with up to count samples spaced interval_ms apart (ADC) or one per sensor
+ *   reading (PW), return samples taken. With sg_chans > 1 count is of all channels, interval_ms is per channel.
+ *   With sg_iqr_stop the DMAC moves sg_min_samples then SG_STEP at a time, sampling stops once the IQR of what is
+ *   in the buffer is within sg_iqr_stop. Selection reorders the samples taken so far, that does not matter here.
+ *=======================================================================================================================
+ */
+unsigned int s_gauge_sample(unsigned int count, int interval_ms) {
+  unsigned long timeout, period_ms, start;
+  unsigned int n = 0;
+  unsigned int block, got, stop;
+  uint8_t trigger = (sg_source == SG_SRC_PW) ? TC3_DMAC_ID_MC_0 : ADC_DMAC_ID_RESRDY;
+  volatile void *src = (sg_source == SG_SRC_PW) ? (volatile void *) &SG_PW_TC->COUNT16.CC[0].reg : 
+                                        (volatile void *) &ADC->RESULT.reg;
+
+  if (count > SG_BUCKETS) {
+    count = SG_BUCKETS - (SG_BUCKETS % sg_chans);  // Whole scans
+  }
+  if (cf_sg_trace == SG_TRACE_REPLAY) {
+    return (sg_trace_read(count, false));
+  }
+  if (sg_source == SG_SRC_SERIAL) {
+    return (sg_serial_collect(count, false));
+  }
+  if (cf_sg_trig_pin) {
+    return (sg_trig_collect(count, false));
+  }
+
+  stop = (cf_sg_iqr_stop) ? sg_stop_counts() : 0;
+  block = (cf_sg_iqr_stop) ? cf_sg_min_samples : count;
+  period_ms = sg_source_start(interval_ms);
+  start = millis();
+
+  while (n < count) {
+    block = (block < (count - n)) ? block : (count - n);
+    dma_start(DMA_CH_SG, trigger, DMAC_BTCTRL_BEATSIZE_HWORD, src, false, &sg_buckets[n], true, block);
+
+    // Sleep until the DMAC has moved the last result. SysTick will wake us each ms, that is ok.
+    timeout = millis() + ((unsigned long) block * period_ms) + 1000;
+    while (!dma_done[DMA_CH_SG] && ((long)(millis() - timeout) < 0) && !ph_over(PH_SG)) {
+      if (sg_gap) {
+        sg_gap();
+      }
+      if (sg_yield) {
+        sg_yield();
+      }
+      LowPower.idle();
+    }
+    got = block - dma_stop(DMA_CH_SG);
+    n += got;
+
+    if ((got < block) || !cf_sg_iqr_stop ||
+        ((myselect(sg_buckets, n, (3*n)/4) - myselect(sg_buckets, n, n/4)) <= stop)) {
+      break;  // Timed out, fixed count, or settled
+    }
+    block = SG_STEP;
+  }
+
+  sg_slip(millis() - start, n, period_ms);
+  sg_source_stop();
+
+  return (n);
+}
+
+/* 
+ *=======================================================================================================================
+ * s_gauge_stream() - Feed up to count samples spaced interval_ms apart into the P2 estimator, no sample buffer.
+ *                    Count is not limited by SG_BUCKETS. sg_iqr_stop is tested as in s_gauge_sample().
+ *                    Return samples taken.
+ *=======================================================================================================================
+ */
+unsigned int s_gauge_stream(unsigned int count, int interval_ms) {
+  unsigned long timeout, period_ms, start;
+  unsigned int n = 0;
+  unsigned int next, stop;
+
+  p2_reset(&sg_p2);
+  if (cf_sg_trace == SG_TRACE_REPLAY) {
+    return (sg_trace_read(count, true));
+  }
+  if (sg_source == SG_SRC_SERIAL) {
+    return (sg_serial_collect(count, true));
+  }
+  if (cf_sg_trig_pin) {
+    return (sg_trig_collect(count, true));
+  }
+  stop = (cf_sg_iqr_stop) ? sg_stop_counts() : 0;
+  next = (cf_sg_iqr_stop) ? cf_sg_min_samples : count;
+
+  // SysTick wakes us each ms, pick up the result when the conversion or capture is ready
+  period_ms = sg_source_start(interval_ms);
+  start = millis();
+  timeout = start + ((unsigned long) count * period_ms) + 1000;
+  while ((n < count) && ((long)(millis() - timeout) < 0)) {
+    if ((sg_source == SG_SRC_PW) && SG_PW_TC->COUNT16.INTFLAG.bit.MC0) {
+      p2_add(&sg_p2, SG_PW_TC->COUNT16.CC[0].reg);  // Reading CC0 clears MC0
+      n++;
+    }
+    else if ((sg_source == SG_SRC_ADC) && ADC->INTFLAG.bit.RESRDY) {
+      p2_add(&sg_p2, ADC->RESULT.reg);  // Reading RESULT clears RESRDY
+      n++;
+    }
+    else {
+      LowPower.idle();
+      continue;
+    }
+    if (n >= next) {
+      if ((p2_quantile(&sg_p2, 6) - p2_quantile(&sg_p2, 2)) <= (long) stop) {
+        break;
+      }
+      next += SG_STEP;
+    }
+  }
+
+  sg_slip(millis() - start, n, period_ms);
+  sg_source_stop();
+
+  return (n);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_find_model() - Sensor with MB number model, dflt when 0 or not found
+ *=======================================================================================================================
+ */
+const SG_SENSOR *sg_find_model(int model, const SG_SENSOR *dflt) {
+  unsigned int i;
+
+  if (model) {
+    for (i=0; (i<SG_SENSORS) && (sg_sensors[i].model != model); i++);
+    if (i<SG_SENSORS) {
+      return (&sg_sensors[i]);
+    }
+    ev_note (EV_SG_MODEL_NF, model);
+  }
+  return (dflt);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_chans_initialize() - Validate sg_chans, set up the scan and the sensor of each channel
+ *=======================================================================================================================
+ */
+void sg_chans_initialize() {
+  const int models[SG_CHANS_MAX] = { 0, cf_sg2_model, cf_sg3_model, cf_sg4_model };
+  uint8_t ain, hi = 0;
+
+  sg_chans = 1;
+  sg_chan_sensor[0] = sg_sensor;
+  if (cf_sg_chans == 1) {
+    return;
+  }
+  if ((cf_sg_chans < 1) || (cf_sg_chans > SG_CHANS_MAX) || cf_sg_stream || (sg_source != SG_SRC_ADC)) {
+    LOG_INFO ("SG:chans %d->1", cf_sg_chans);
+    cf_sg_chans = 1;
+    return;
+  }
+
+  sg_scan_ain = 0xFF;
+  for (int c=0; c<cf_sg_chans; c++) {
+    ain = g_APinDescription[sg_chan_pins[c]].ulADCChannelNumber;
+    sg_scan_ain = (ain < sg_scan_ain) ? ain : sg_scan_ain;
+    hi = (ain > hi) ? ain : hi;
+  }
+  if ((hi - sg_scan_ain + 1) != cf_sg_chans) {
+    LOG_ERR ("SG:chans %d AIN ERR", cf_sg_chans);
+    cf_sg_chans = 1;
+    return;
+  }
+
+  for (int c=0; c<cf_sg_chans; c++) {
+    sg_chan_pos[c] = g_APinDescription[sg_chan_pins[c]].ulADCChannelNumber - sg_scan_ain;
+    pinMode(sg_chan_pins[c], INPUT);
+    if (c) {
+      sg_chan_sensor[c] = sg_find_model(models[c], sg_sensor);
+      LOG_INFO ("SG:%d MB%d", c+1, sg_chan_sensor[c]->model);
+    }
+  }
+
+  // Scan results are one conversion each and there is no single channel to test for the early stop
+  if (cf_sg_osr) {
+    LOG_INFO ("SG:osr %d->0", cf_sg_osr);
+    cf_sg_osr = 0;
+  }
+  if (cf_sg_iqr_stop) {
+    LOG_INFO ("SG:iqr_stop %d->0", cf_sg_iqr_stop);
+    cf_sg_iqr_stop = 0;
+  }
+  if (cf_sg_samples > (SG_BUCKETS / cf_sg_chans)) {
+    LOG_INFO ("SG:samples %d->%d", cf_sg_samples, SG_BUCKETS / cf_sg_chans);
+    cf_sg_samples = SG_BUCKETS / cf_sg_chans;
+  }
+  sg_chans = cf_sg_chans;
+}
+
+/* 
+ *=======================================================================================================================
+ * s_gauge_initialize() - Validate gauge configuration
+ *=======================================================================================================================
+ */
+void s_gauge_initialize() {
+  pinMode(SGAUGE_PIN, INPUT);
+
+  // sg_model picks the exact sensor, otherwise ds_type picks the family
+  sg_sensor = sg_find_model(cf_sg_model, &sg_sensors[(cf_ds_type) ? SG_SENSOR_10M : SG_SENSOR_5M]);
+  LOG_INFO ("SG:MB%d %u-%umm", sg_sensor->model, sg_sensor->blank_mm, sg_sensor->max_mm);
+
+  if (cf_sg_pwr_pin) {
+    if ((cf_sg_settle < 0) || (cf_sg_settle > 5000)) {
+      LOG_INFO ("SG:settle %d->500", cf_sg_settle);
+      cf_sg_settle = 500;
+    }
+    pinMode(cf_sg_pwr_pin, OUTPUT);
+    digitalWrite(cf_sg_pwr_pin, LOW);
+    sg_powered = false;
+  }
+
+  if (STN_SG_STREAM && !cf_sg_stream) {
+    LOG_INFO ("SG:stream 0->1");  // No sample buffer in this build
+    cf_sg_stream = 1;
+  }
+  if ((cf_sg_samples < 1) || (!cf_sg_stream && (cf_sg_samples > SG_BUCKETS))) {
+    LOG_INFO ("SG:samples %d->60", cf_sg_samples);
+    cf_sg_samples = 60;
+  }
+  if ((cf_sg_interval < SG_INTERVAL_MIN) || (cf_sg_interval > SG_INTERVAL_MAX)) {
+    LOG_INFO ("SG:interval %d->250", cf_sg_interval);
+    cf_sg_interval = 250;
+  }
+  if (cf_sg_pw_pin) {
+    if ((cf_sg_pw_pin >= PINS_COUNT) || (g_APinDescription[cf_sg_pw_pin].ulExtInt == NOT_AN_INTERRUPT) ||
+        (g_APinDescription[cf_sg_pw_pin].ulExtInt == EXTERNAL_INT_NMI)) {
+      LOG_ERR ("SG:pw_pin %d ERR", cf_sg_pw_pin);
+      cf_sg_pw_pin = 0;
+    }
+    else {
+      pinMode(cf_sg_pw_pin, INPUT);
+      LOG_INFO ("SG:PW pin %d", cf_sg_pw_pin);
+      sg_source = SG_SRC_PW;
+    }
+  }
+  if (cf_sg_serial) {
+    Output ("SG:Serial1");
+    sg_source = SG_SRC_SERIAL;  // Over sg_pw_pin when both are set
+  }
+  if (cf_sg_trig_pin) {
+    if ((cf_sg_trig_pin >= PINS_COUNT) || cf_sg_serial) {
+      LOG_ERR ("SG:trig_pin %d ERR", cf_sg_trig_pin);
+      cf_sg_trig_pin = 0;
+    }
+    else {
+      pinMode(cf_sg_trig_pin, OUTPUT);
+      digitalWrite(cf_sg_trig_pin, LOW);  // Sensor waits for a pulse
+      LOG_INFO ("SG:Trig pin %d", cf_sg_trig_pin);
+    }
+  }
+  if ((cf_sg_osr < 0) || (cf_sg_osr > SG_OSR_MAX) || (cf_sg_osr & (cf_sg_osr - 1))) {
+    LOG_INFO ("SG:osr %d->0", cf_sg_osr);
+    cf_sg_osr = 0;
+  }
+  if (cf_sg_event) {
+    if ((cf_sg_event_ms < 100) || (cf_sg_event_ms > 60000)) {
+      LOG_INFO ("SG:event_ms %d->1000", cf_sg_event_ms);
+      cf_sg_event_ms = 1000;
+    }
+    if ((cf_sg_burst < 1) || (cf_sg_burst > 1440) || ((1440 % cf_sg_burst) != 0)) {
+      LOG_INFO ("SG:burst %d->1", cf_sg_burst);
+      cf_sg_burst = 1;
+    }
+    if (cf_sg_burst_n < 1) {
+      LOG_INFO ("SG:burst_n %d->5", cf_sg_burst_n);
+      cf_sg_burst_n = 5;
+    }
+  }
+  if (cf_sg_iqr_stop && ((cf_sg_min_samples < 1) || (cf_sg_min_samples > SG_BUCKETS))) {
+    LOG_INFO ("SG:min_samples %d->20", cf_sg_min_samples);
+    cf_sg_min_samples = 20;
+  }
+  sg_chans_initialize();
+  sg_samples = cf_sg_samples;
+}
+
+/*
+ * Calibration - The sg_cal1-sg_cal8 points of CONFIG.TXT, 12 bit ADC counts to mm, are compiled once at boot into
+ *   sg_cal[], each with the Q16 slope in mm per count to the next point, so a conversion is a binary search for the
+ *   segment and one multiply. Counts below the first or above the last point go on along the end segment. Without
+ *   points, or with points out of order, sg_cal_n is 0 and the counts are scaled by the sensor's full scale as before.
+ *   Only channel 1 of the ADC is calibrated, the PW and serial sources report mm of their own.
+ */
+typedef struct {
+  int32_t counts;                           // 12 bit ADC counts
+  int32_t mm;
+  int32_t slope;                            // mm per count to the next point, Q16
+} SG_CAL_PT;
+
+SG_CAL_PT sg_cal[SG_CAL_MAX];
+int sg_cal_n = 0;                           // Points in sg_cal[], 0 = nominal full scale
+
+/* 
+ *=======================================================================================================================
+ * sg_cal_initialize() - Compile the calibration points, call once at boot after the config is read
+ *=======================================================================================================================
+ */
+void sg_cal_initialize() {
+  sg_cal_n = 0;
+  if (cf_sg_cal_n == 0) {
+    return;
+  }
+  if (cf_sg_cal_n < 2) {
+    LOG_ERR ("SG:Cal 1 Point");
+    return;
+  }
+  for (int i=0; i<cf_sg_cal_n; i++) {
+    if ((cf_sg_cal[i][0] < 0) || (cf_sg_cal[i][0] > 4095) || (cf_sg_cal[i][1] < 0) ||
+        (i && (cf_sg_cal[i][0] <= cf_sg_cal[i-1][0]))) {
+      LOG_ERR ("SG:Cal Point %d ERR", i + 1);
+      return;
+    }
+    sg_cal[i].counts = cf_sg_cal[i][0];
+    sg_cal[i].mm = cf_sg_cal[i][1];
+  }
+  for (int i=0; i<cf_sg_cal_n - 1; i++) {
+    sg_cal[i].slope = ((sg_cal[i+1].mm - sg_cal[i].mm) * 65536) / (sg_cal[i+1].counts - sg_cal[i].counts);
+  }
+  sg_cal[cf_sg_cal_n - 1].slope = sg_cal[cf_sg_cal_n - 2].slope;
+  sg_cal_n = cf_sg_cal_n;
+  LOG_INFO ("SG:Cal %d Points", sg_cal_n);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_cal_mm() - ADC counts at sg_adc_bits to mm on the calibration
+ *=======================================================================================================================
+ */
+unsigned int sg_cal_mm(unsigned int counts) {
+  int32_t c = counts << (12 - sg_adc_bits);
+  int32_t mm;
+  int lo = 0, hi = sg_cal_n - 1, mid;
+
+  while (lo < hi) {  // Last point at or below c, the first when c is below them all
+    mid = (lo + hi + 1) / 2;
+    if (sg_cal[mid].counts <= c) {
+      lo = mid;
+    }
+    else {
+      hi = mid - 1;
+    }
+  }
+  mm = sg_cal[lo].mm + (int32_t) (((int64_t) (c - sg_cal[lo].counts) * sg_cal[lo].slope) / 65536);
+  return ((mm < 0) ? 0 : (unsigned int) mm);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_cal_counts() - mm to 12 bit ADC counts on the calibration, sg_cal_mm() backwards for points rising in mm
+ *=======================================================================================================================
+ */
+unsigned int sg_cal_counts(unsigned long mm) {
+  int32_t c;
+  int lo = 0, hi = sg_cal_n - 1, mid;
+
+  while (lo < hi) {  // Last point at or below mm, the first when mm is below them all
+    mid = (lo + hi + 1) / 2;
+    if (sg_cal[mid].mm <= (int32_t) mm) {
+      lo = mid;
+    }
+    else {
+      hi = mid - 1;
+    }
+  }
+  c = sg_cal[lo].counts;
+  if (sg_cal[lo].slope > 0) {
+    c += (int32_t) ((((int64_t) mm - sg_cal[lo].mm) * 65536) / sg_cal[lo].slope);
+  }
+  return ((c < 0) ? 0 : ((c > 4095) ? 4095 : (unsigned int) c));
+}
+
+/* 
+ *=======================================================================================================================
+ * s_gauge_mm() - ADC counts at sg_adc_bits, PW ticks, or serial mm to mm
+ *=======================================================================================================================
+ */
+unsigned int s_gauge_mm(unsigned int counts) {
+  if (sg_source == SG_SRC_PW) {
+    return (counts / SG_PW_TICKS_MM);
+  }
+  if (sg_source == SG_SRC_SERIAL) {
+    return (counts);
+  }
+  if (sg_cal_n) {
+    return (sg_cal_mm(counts));
+  }
+  return ((unsigned int) ((counts * sg_sensor->full_scale_mm) >> sg_adc_bits));
+}
+
+/* 
+ *=======================================================================================================================
+ * s_gauge_span_mm() - A spread in sample units to mm on the nominal scale, the calibration's offset is not in it
+ *=======================================================================================================================
+ */
+unsigned int s_gauge_span_mm(unsigned int counts) {
+  if (sg_source == SG_SRC_PW) {
+    return (counts / SG_PW_TICKS_MM);
+  }
+  if (sg_source == SG_SRC_SERIAL) {
+    return (counts);
+  }
+  return ((unsigned int) ((counts * sg_sensor->full_scale_mm) >> sg_adc_bits));
+}
 
 /* 
  *=======================================================================================================================
- * s_gauge_median()
+ * s_gauge_chan_mm() - ADC counts of channel c to mm
+ *=======================================================================================================================
+ */
+unsigned int s_gauge_chan_mm(int c, unsigned int counts) {
+  return ((unsigned int) ((counts * sg_chan_sensor[c]->full_scale_mm) >> sg_adc_bits));
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_chan_gather() - Copy channel c's n samples out of the interleaved scan into sg_chan_buf[]
+ *=======================================================================================================================
+ */
+void sg_chan_gather(int c, unsigned int n) {
+  for (unsigned int i=0; i<n; i++) {
+    sg_chan_buf[i] = sg_buckets[(i * sg_chans) + sg_chan_pos[c]];
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * s_gauge_median() - Sample the gauge, return median in mm. Spread is left in sg_min, sg_max, sg_iqr (counts)
+ *   With sg_chans > 1 the median of every channel is left in sg_chan_mm[], the spread is channel 1's.
  *=======================================================================================================================
  */
 unsigned int s_gauge_median() {
-  int i;
+  unsigned int median;
+  uint16_t *buf = sg_buckets;
+  uint32_t at;
+  unsigned long start;
 
-  for (i=0; i<SG_BUCKETS; i++) {
-    // delay(500);
-    delay(250);
-    sg_buckets[i] = (int) analogRead(SGAUGE_PIN);
-    // sprintf (Buffer32Bytes, "SG[%02d]:%d", i, sg_buckets[i]);
-    // OutputNS (Buffer32Bytes);
+  sg_jitter_ms = 0;
+  sg_power(true);
+  if (cf_sg_stream) {
+    start = millis();
+    sg_count = s_gauge_stream(sg_samples, cf_sg_interval);
+    sg_window_ms = millis() - start;
+    sg_power(false);
+    median = p2_quantile(&sg_p2, 4);
+    sg_min = p2_quantile(&sg_p2, 0);
+    sg_max = p2_quantile(&sg_p2, 8);
+    sg_iqr = p2_quantile(&sg_p2, 6) - p2_quantile(&sg_p2, 2);
+    return (s_gauge_mm(median));
   }
+
+  at = tm_now();
+  start = millis();
+  sg_count = s_gauge_sample(sg_samples * sg_chans, cf_sg_interval) / sg_chans;  // Per channel
+  sg_window_ms = millis() - start;
+  sg_power(false);
+  if (cf_sg_trace == SG_TRACE_RECORD) {
+    sg_trace_write(sg_count * sg_chans);
+  }
+  if (cf_sg_raw && sg_count && (cf_sg_trace != SG_TRACE_REPLAY)) {
+    sg_raw_write(sg_count * sg_chans, at, sg_window_ms);
+  }
+  if (sg_count == 0) {
+    sg_min = sg_max = sg_iqr = 0;
+    memset(sg_chan_mm, 0, sizeof(sg_chan_mm));
+    return (0);
+  }
+
+  if (sg_chans > 1) {
+    for (int c=1; c<sg_chans; c++) {
+      sg_chan_gather(c, sg_count);
+      sg_chan_mm[c] = s_gauge_chan_mm(c, mymedian(sg_chan_buf, sg_count));
+    }
+    sg_chan_gather(0, sg_count);
+    buf = sg_chan_buf;
+  }
+
+  // for (int i=0; i<sg_count; i++) {
+  //   sprintf (msgbuf, "SG[%02d]:%d", i, sg_buckets[i]);
+  //   OutputNS (msgbuf);
+  // }
   
-  mysort(sg_buckets, SG_BUCKETS);
-  i = (SG_BUCKETS+1) / 2 - 1; // -1 as array indexing in C starts from 0
+  median = mymedian(buf, sg_count);
 
-  if (cf_ds_type) {  // 0 = 5m, 1 = 10m
-    return (sg_buckets[i]*5);
+  // Quartiles by selection on either side of the median, min and max from the partitioned ends
+  sg_iqr = myselect(buf, sg_count, (3*sg_count)/4) - myselect(buf, sg_count, sg_count/4);
+  sg_min = sg_max = buf[0];
+  for (unsigned int i=1; i<sg_count; i++) {
+    if (buf[i] < sg_min) sg_min = buf[i];
+    if (buf[i] > sg_max) sg_max = buf[i];
   }
-  else {
-    return (sg_buckets[i]*10);
+
+  sg_chan_mm[0] = s_gauge_mm(median);
+  return (sg_chan_mm[0]);
+}
+
+/*
+ * Level Event Wake
+ *   With sg_event set the gauge stays powered while the board sleeps. LowPower.attachAdcInterrupt() puts the ADC on
+ *   GCLK6 with a window of sg_event mm either side of the last median, its edges turned back into counts through
+ *   the sg_cal points when there are any, then conversions are started by TC4 every
+ *   sg_event_ms instead of free running, so the ADC is idle between them. A conversion outside the window wakes the
+ *   board with obs_event set and observations go to the sg_burst minute schedule until sg_burst_n in a row change
+ *   less than sg_event.
+ */
+bool sg_event_armed = false;
+bool sg_burst = false;                    // Burst schedule in use
+int sg_burst_quiet = 0;                   // Burst observations in a row under sg_event
+unsigned int sg_event_mm = 0;             // Median of the last logged observation, 0 = none yet
+
+/* 
+ *=======================================================================================================================
+ * sg_event_isr() - Conversion outside the window, from ADC_Handler() in LowPower
+ *=======================================================================================================================
+ */
+void sg_event_isr() {
+  obs_event = true;
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_event_counts() - mm to the 10 bit counts the window compares, on the calibration when there is one
+ *=======================================================================================================================
+ */
+unsigned int sg_event_counts(unsigned long mm) {
+  unsigned long c = (sg_cal_n) ? (sg_cal_counts(mm) >> 2) : ((mm << 10) / sg_sensor->full_scale_mm);
+
+  return ((c > 1023) ? 1023 : (unsigned int) c);
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_event_arm() - Watch the gauge for a level change while asleep, call just before obs_sleep()
+ *=======================================================================================================================
+ */
+void sg_event_arm() {
+  unsigned int c, lo, hi;
+
+  if (!cf_sg_event || sg_burst || !sg_event_mm) {
+    return;
+  }
+
+  sg_power(true);
+  if (cf_sg_trig_pin) {
+    digitalWrite(cf_sg_trig_pin, HIGH);   // Free running while watched
+  }
+  analogRead(SGAUGE_PIN);                 // Core sets pin mux, reference and 10bit
+
+  c = sg_event_counts(sg_event_mm);
+  lo = sg_event_counts((sg_event_mm > (unsigned int) cf_sg_event) ? sg_event_mm - cf_sg_event : 0);
+  hi = sg_event_counts((unsigned long) sg_event_mm + cf_sg_event);
+  lo = (lo < c) ? lo : ((c > 0) ? c - 1 : 0);  // At least one count each side
+  hi = (hi > c) ? hi : ((c < 1023) ? c + 1 : 1023);
+
+  LowPower.attachAdcInterrupt(SGAUGE_PIN, sg_event_isr, ADC_INT_OUTSIDE, lo, hi);
+
+  // Replace free running with one conversion per sg_event_ms
+  ADC->CTRLA.bit.ENABLE = 0;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->CTRLB.bit.FREERUN = 0;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->EVCTRL.reg = ADC_EVCTRL_STARTEI;
+  ADC->INTFLAG.reg = ADC_INTFLAG_WINMON;
+  obs_event = false;                      // Anything the free running conversions saw
+  ADC->CTRLA.bit.ENABLE = 1;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  sg_timer_start(cf_sg_event_ms, true);
+  sg_event_armed = true;
+}
+
+/* 
+ *=======================================================================================================================
+ * sg_event_disarm() - Stop watching, give the ADC back to the core, call right after obs_sleep()
+ *=======================================================================================================================
+ */
+void sg_event_disarm() {
+  if (!sg_event_armed) {
+    return;
+  }
+  sg_timer_stop();
+  ADC->CTRLA.bit.ENABLE = 0;
+  while (ADC->STATUS.bit.SYNCBUSY);
+  ADC->EVCTRL.reg = 0;
+  LowPower.detachAdcInterrupt();
+  if (cf_sg_trig_pin) {
+    digitalWrite(cf_sg_trig_pin, LOW);
+  }
+  sg_event_armed = false;
+}
+
+/*
+ * Depth - With sg_datum set the record also has "sgd", the snow depth or stage in mm: sg_datum, the distance from the
+ *   sensor face to the bare ground or the stage datum, less the distance read. With sg_tc=1 the distance is first
+ *   scaled for the speed of sound in the air, c(T) = 331.3 * sqrt(1 + T/273.15) m/s, against the 20 deg C the sensor
+ *   assumes. sg_tc_ratio[] holds c(T)/c(20) * 10000 every 5 deg C from -40 to 60, interpolated between,
+ *   within 0.1 mm at 5 m. T is the first good one of BMX1, MCP1 and DS1. Without one the distance is used as read.
+ *   Sensors with their own temperature compensation (the HRXL-MaxSonar-WR parts) use sg_tc=0.
+ */
+#define SG_TC_MIN_C       -40
+#define SG_TC_STEP_C      5
+
+const uint16_t sg_tc_ratio[] = {
+  8918, 9013, 9107, 9201, 9293, 9384, 9475, 9564, 9653, 9741, 9828,
+  9914, 10000, 10085, 10169, 10253, 10335, 10418, 10499, 10580, 10660
+};
+#define SG_TC_COUNT       (sizeof(sg_tc_ratio) / sizeof(sg_tc_ratio[0]))
+
+/*
+ *=======================================================================================================================
+ * sg_air_temp() - Air temperature in FIX_ONE units from the first good sensor, false if none
+ *=======================================================================================================================
+ */
+bool sg_air_temp(int32_t *t) {
+  if (BMX_1_exists && (sn_table[SN_BMX_1].value[1] != QC_FIX(QC_ERR_T))) {
+    *t = sn_table[SN_BMX_1].value[1];
+    return (true);
+  }
+  if (MCP_1_exists && (sn_table[SN_MCP_1].value[0] != QC_FIX(QC_ERR_T))) {
+    *t = sn_table[SN_MCP_1].value[0];
+    return (true);
+  }
+  if (ds_found && (ds_count > 0) && ds_valid[0] && (ds_reading[0] != QC_FIX(QC_ERR_T))) {
+    *t = ds_reading[0];
+    return (true);
+  }
+  return (false);
+}
+
+/*
+ *=======================================================================================================================
+ * sg_depth() - Depth or stage in mm from a distance in mm
+ *=======================================================================================================================
+ */
+int sg_depth(unsigned int mm) {
+  int32_t t, f;
+  uint32_t k, ratio;
+
+  if (cf_sg_tc && sg_air_temp(&t)) {
+    t -= (int32_t) SG_TC_MIN_C * FIX_ONE;  // From the table's first entry
+    t = (t < 0) ? 0 : t;
+    k = t / (SG_TC_STEP_C * FIX_ONE);
+    if (k >= (SG_TC_COUNT - 1)) {
+      ratio = sg_tc_ratio[SG_TC_COUNT - 1];
+    }
+    else {
+      f = t - (int32_t) k * SG_TC_STEP_C * FIX_ONE;  // Into the step
+      ratio = sg_tc_ratio[k] + ((int32_t) (sg_tc_ratio[k + 1] - sg_tc_ratio[k]) * f) / (SG_TC_STEP_C * FIX_ONE);
+    }
+    mm = (mm * ratio + 5000) / 10000;
   }
+  return (cf_sg_datum - (int) mm);
 }
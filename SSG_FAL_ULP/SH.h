@@ -0,0 +1,641 @@
+/*
+ * ======================================================================================================================
+ *  SH.h - Serial Command Shell
+ *
+ *  sh_poll() is called from the loop while the RTC is unset and by the shell task (TK.h) in calibration mode. It
+ *  moves what the USB serial port has buffered into sh_line and returns at once, a command runs only when its line
+ *  is complete. Lines that overflow sh_line are dropped up to their newline. The first word is looked up in
+ *  sh_commands[], every command is bounded so the 1 Hz monitor update and the minute observation keep their time.
+ *  While the gauge samples only the quick commands run, the others wait for it. With sh_uart set the same shell
+ *  also answers on Serial1 between observations, see Service Console.
+ *
+ *    help                           This list
+ *    time [YYYY:MM:DD:HH:MM:SS]     Show or set the RTC, a bare YYYY:MM:DD:HH:MM:SS line also sets it
+ *    cfg [get KEY | set KEY VALUE]  Config values in use, set lasts until reboot, CONFIG.TXT is not changed
+ *    stats                          Uptime, status bits, SD and flash ring state, RAM headroom, totals kept
+ *                                   across reboots (RS.h), card blocks of the last cycle (SDC.h), background
+ *                                   budget (BG.h), last sleep (TM.h), last cycle's phase times
+ *    ev                             Events since boot as short codes, see EV.h
+ *    tail [N]                       Last N observations (4, at most OBS_TAIL_RECS) from RAM, oldest first, as
+ *                                   the JSON lines of their binary records, see OBS.h Tail Ring
+ *    ls [DIR]                       Files in DIR, default /OBS
+ *    dump PATH [OFFSET] [LEN]       Hex of LEN bytes (256, at most SH_DUMP_MAX) of a file
+ *    bench [card | sd | gold [set]] Timed hot paths (BM.h) logged to /OBS/BENCH.log, then card read speed over
+ *                                   SH_BENCH_BLOCKS raw blocks, card alone with "card", card write latency
+ *                                   percentiles with "sd", golden trace replay alone with "gold", "gold set"
+ *                                   takes its output as the new reference
+ *    sample [N]                     Gauge median of N samples (5, at most SH_SAMPLE_MAX) and the sensors
+ *    n2s [send [N]]                 Need to send queue depth, or send N lines (at most SH_N2S_MAX) on the console
+ *                                   and take them off the queue, see NS.h
+ *    X ...                          Log export, see EX.h, USB only
+ * ======================================================================================================================
+ */
+#define SH_LINE_MAX       80                // Longest command line
+#define SH_ARGS_MAX       4                 // Words after the command
+#define SH_DUMP_MAX       4096              // Bytes a dump prints
+#define SH_BENCH_BLOCKS   256               // 128KB
+#define SH_SAMPLE_MAX     20                // 5 seconds at sg_interval 250
+#define SH_N2S_MAX        96                // Lines sent by one n2s send, a day at 15 minutes
+
+char sh_line[SH_LINE_MAX + 1];
+int  sh_len = 0;
+bool sh_overflow = false;                   // Dropping the rest of a long line
+bool sh_pending = false;                    // sh_line waits for the gauge to finish
+Stream *sh_port = &Serial;                  // Where sh_poll() reads, Serial1 in a service session
+
+typedef struct {
+  const char *name;
+  void (*run)(int argc, char **argv);
+  bool quick;                               // Runs while the gauge samples, no ADC, sensor or SD use
+} SH_COMMAND;
+
+/*
+ *=======================================================================================================================
+ * sh_sd() - Card is there for a file command
+ *=======================================================================================================================
+ */
+bool sh_sd() {
+  if (!SD_exists || SD_down) {
+    Output ("SH:No SD");
+    return (false);
+  }
+  SD_Close();  // Held records are on the card before it is looked at
+  return (true);
+}
+
+void sh_help(int argc, char **argv);
+
+/*
+ *=======================================================================================================================
+ * sh_time() - Show or set the RTC
+ *=======================================================================================================================
+ */
+void sh_time(int argc, char **argv) {
+  if (argc > 1) {
+    rtc_settime(argv[1]);
+    return;
+  }
+  if (!RTC_valid) {
+    Output ("NEED TIME->RTC");
+    return;
+  }
+  rtc_timestamp();
+  Output (timestamp);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_cfg() - List, get or set a config value in use
+ *=======================================================================================================================
+ */
+void sh_cfg(int argc, char **argv) {
+  const CF_KEY *c = NULL;
+
+  if (argc == 1) {
+    for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+      sprintf (msgbuf, "%s=%d", cf_keys[i].key, *cf_keys[i].value);
+      Serial_write (msgbuf);
+    }
+    return;
+  }
+  if (argc > 2) {
+    for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+      if (!strcmp(argv[2], cf_keys[i].key)) {
+        c = &cf_keys[i];
+      }
+    }
+  }
+  if (!c) {
+    Output ("SH:cfg get KEY | set KEY VALUE");
+    return;
+  }
+  if (!strcmp(argv[1], "set") && (argc > 3)) {
+    *c->value = atoi(argv[3]);
+  }
+  else if (strcmp(argv[1], "get")) {
+    Output ("SH:cfg get KEY | set KEY VALUE");
+    return;
+  }
+  sprintf (msgbuf, "CF:%s=[%d]", c->key, *c->value);
+  Output (msgbuf);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_stats() - Where the station is at
+ *=======================================================================================================================
+ */
+void sh_stats(int argc, char **argv) {
+  int batt = vbat_mv();
+
+  sprintf (msgbuf, "UP:%lus HTH:%04X BAT:%d.%02d", millis() / 1000, SystemStatusBits, batt / 1000, (batt % 1000) / 10);
+  Output (msgbuf);
+  sprintf (msgbuf, "SD:%s WB:%d/%d FL:%d", (!SD_exists) ? "none" : ((SD_down) ? "down" : "ok"), SD_wb_count,
+    SD_wb_len, fl_count);
+  Output (msgbuf);
+  sprintf (msgbuf, "RAM:stk %d heap %d free %d", rm_stack(), rm_heap(), rm_free());
+  Output (msgbuf);
+  sprintf (msgbuf, "SCR:peak %d of %d over %d", sf_scratch_peak, SF_SCRATCH_SIZE, sf_scratch_over);
+  Output (msgbuf);
+  if (iq_enabled) {
+    sprintf (msgbuf, "IQ:%d queued %lu failed", iq_count, (unsigned long) iq_fails);
+    Output (msgbuf);
+  }
+  rs_show();
+  sprintf (msgbuf, "SGW:%lums late %lums", sg_window_ms, sg_jitter_ms);
+  Output (msgbuf);
+  sprintf (msgbuf, "CON:%lu Lines Dropped", (unsigned long) op_tx_dropped);
+  Output (msgbuf);
+  sprintf (msgbuf, "SDIO:%lu read %lu written %lu rewritten", (unsigned long) sd_io_last[SD_IO_READS],
+    (unsigned long) sd_io_last[SD_IO_WRITES], (unsigned long) sd_io_last[SD_IO_REWRITES]);
+  Output (msgbuf);
+  if (cf_bg_ms) {
+    int m = sprintf (msgbuf, "BG:%dms over %lu deferred %lu", cf_bg_ms, (unsigned long) bg_over,
+      (unsigned long) bg_deferred);
+    for (unsigned int i=0; i<BG_COUNT; i++) {
+      m += sprintf (msgbuf + m, " %s %lums", bg_tasks[i].name, bg_tasks[i].cost_ms);
+    }
+    Output (msgbuf);
+  }
+  if (tm_sl_valid) {
+    sprintf (msgbuf, "SLP:%lums %lus wake %02X drift %lds", (unsigned long) tm_sl_ms, (unsigned long) tm_sl_s,
+      tm_sl_wake, (long) tm_sl_drift);
+    Output (msgbuf);
+  }
+  if (ph_last_valid) {
+    for (int i=0; i<PH_COUNT; i++) {
+      sprintf (msgbuf, "TM:%s %lums", ph_names[i], ph_last[i] / 1000);
+      Serial_write (msgbuf);
+    }
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * sh_ev() - Event ring as codes
+ *=======================================================================================================================
+ */
+void sh_ev(int argc, char **argv) {
+  ev_show();
+}
+
+/*
+ *=======================================================================================================================
+ * sh_tail() - Last observations from the tail ring, the card is not read
+ *=======================================================================================================================
+ */
+void sh_tail(int argc, char **argv) {
+  int n = (argc > 1) ? atoi(argv[1]) : 4;
+  const OBS_BINREC *r;
+
+  n = (n < 1) ? 1 : ((n > OBS_TAIL_RECS) ? OBS_TAIL_RECS : n);
+  for (int k=n-1; k>=0; k--) {
+    if ((r = obs_tail_get(k))) {
+      OBS_bin_json(r, msgbuf, sizeof(msgbuf));
+      Serial_write (msgbuf);
+    }
+  }
+  sprintf (msgbuf, "SH:%lu Observations", (unsigned long) obs_tail_n);
+  Output (msgbuf);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_ls() - List a directory
+ *=======================================================================================================================
+ */
+void sh_ls(int argc, char **argv) {
+  File dir;
+  File fp;
+
+  if (!sh_sd()) {
+    return;
+  }
+  dir = SD.open((argc > 1) ? argv[1] : "/OBS");
+  if (!dir || !dir.isDirectory()) {
+    dir.close();
+    Output ("SH:No Dir");
+    return;
+  }
+  while ((fp = dir.openNextFile())) {
+    if (fp.isDirectory()) {
+      sprintf (msgbuf, "%s/", fp.name());
+    }
+    else {
+      sprintf (msgbuf, "%-13s %lu", fp.name(), fp.size());
+    }
+    Serial_write (msgbuf);
+    fp.close();
+  }
+  dir.close();
+}
+
+/*
+ *=======================================================================================================================
+ * sh_dump() - Hex of part of a file, 16 bytes a line
+ *=======================================================================================================================
+ */
+void sh_dump(int argc, char **argv) {
+  uint8_t buf[16];
+  uint32_t offset = (argc > 2) ? strtoul(argv[2], NULL, 0) : 0;
+  uint32_t len = (argc > 3) ? strtoul(argv[3], NULL, 0) : 256;
+  int n, m;
+  File fp;
+
+  if (argc < 2) {
+    Output ("SH:dump PATH [OFFSET] [LEN]");
+    return;
+  }
+  if (!sh_sd()) {
+    return;
+  }
+  fp = SD.open(argv[1], FILE_READ);
+  if (!fp) {
+    Output ("SH:No File");
+    return;
+  }
+  len = (len < SH_DUMP_MAX) ? len : SH_DUMP_MAX;
+  fp.seek(offset);
+  while (len && ((n = fp.read(buf, (len < sizeof(buf)) ? len : sizeof(buf))) > 0)) {
+    m = sprintf (msgbuf, "%08lX", offset);
+    for (int i=0; i<n; i++) {
+      m += sprintf (msgbuf + m, " %02X", buf[i]);
+    }
+    Serial_write (msgbuf);
+    offset += n;
+    len -= n;
+    wd_feed();
+  }
+  fp.close();
+}
+
+/*
+ *=======================================================================================================================
+ * sh_bench() - Benchmarks, then time raw block reads from the start of the card, through the same path as a file read
+ *=======================================================================================================================
+ */
+void sh_bench(int argc, char **argv) {
+  Sd2Card *card = SdVolume::sdCard();
+  uint8_t *buf;
+  unsigned long start;
+  unsigned long ms;
+
+  if ((argc > 1) && !strcmp(argv[1], "sd")) {
+    if (sh_sd()) {
+      bm_sd_latency();
+    }
+    return;
+  }
+  if ((argc > 1) && !strcmp(argv[1], "gold")) {
+    bm_count = 0;
+    memset (bm_gold_state, 0, sizeof(bm_gold_state));
+    bm_golden((argc > 2) && !strcmp(argv[2], "set"));
+    bm_save();
+    return;
+  }
+  if ((argc < 2) || strcmp(argv[1], "card")) {
+    bm_run();
+  }
+  if (!sh_sd()) {
+    return;
+  }
+  buf = SdVolume::cacheClear();  // Volume cache, the next file access reads its block again
+  start = millis();
+  for (int i=0; i<SH_BENCH_BLOCKS; i++) {
+    wd_feed();
+    if (!card->readBlock(i, buf)) {
+      Output ("SH:Read Err");
+      return;
+    }
+  }
+  ms = millis() - start;
+  ms = (ms) ? ms : 1;
+  sprintf (msgbuf, "SH:%dKB %lums %luKB/s", SH_BENCH_BLOCKS / 2, ms, (SH_BENCH_BLOCKS / 2 * 1000UL) / ms);
+  Output (msgbuf);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_sample() - Gauge median of a few samples and the online sensors, nothing is logged
+ *=======================================================================================================================
+ */
+void sh_sample(int argc, char **argv) {
+  int n = (argc > 1) ? atoi(argv[1]) : 5;
+  int saved = sg_samples;
+  char Buffer16Bytes[16];
+  unsigned int mm;
+  SENSOR *s;
+
+  sg_samples = (n < 1) ? 1 : ((n > SH_SAMPLE_MAX) ? SH_SAMPLE_MAX : n);
+  mm = s_gauge_median();
+  sprintf (msgbuf, "SG:%umm n=%u iqr=%u", mm, sg_count, sg_iqr);
+  Output (msgbuf);
+  sg_samples = saved;
+
+  for (int i=0; i<SN_COUNT; i++) {
+    s = &sn_table[i];
+    if (*s->exists && s->nvalues) {
+      sn_sample(s);
+      for (int v=0; v<s->nvalues; v++) {
+        sprintf (msgbuf, "%s:%s", s->key[v], fix_str(Buffer16Bytes, sizeof(Buffer16Bytes), s->value[v], s->digits[v]));
+        Output (msgbuf);
+      }
+    }
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * sh_n2s() - Queue depth, or send up to N lines on the console and take them off the queue
+ *=======================================================================================================================
+ */
+void sh_n2s(int argc, char **argv) {
+  int n = (argc > 2) ? atoi(argv[2]) : SH_N2S_MAX;
+  uint32_t used = 0;
+  uint8_t rec[128];
+  int len, k, m;
+
+  if (!sh_sd() || !ns_load()) {
+    return;
+  }
+  if ((argc < 2) || strcmp(argv[1], "send")) {
+    sprintf (msgbuf, "N2S:%lu of %lu Bytes", ns_size - ns_cursor, ns_size);
+    Output (msgbuf);
+    return;
+  }
+  n = (n < 1) ? 1 : ((n > SH_N2S_MAX) ? SH_N2S_MAX : n);
+  for (int i=0; i<n; i++) {
+    if (cf_n2s == NS_BIN) {
+      k = ns_peek(used, (char *) rec, sizeof(rec), &len);
+      for (m=0; m<len; m++) {
+        sprintf (msgbuf + 2 * m, "%02X", rec[m]);  // Hex of the OBS_BINREC
+      }
+    }
+    else {
+      k = ns_peek(used, msgbuf, sizeof(msgbuf), &len);
+    }
+    if (k == 0) {
+      break;
+    }
+    Serial_write (msgbuf);
+    used += k;
+    SendSensorMsgCount++;
+    wd_feed();
+  }
+  ns_pop(used);
+  sprintf (msgbuf, "N2S:%lu Bytes Sent", used);
+  Output (msgbuf);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_export() - X line, EX.h parses it
+ *=======================================================================================================================
+ */
+void sh_export(int argc, char **argv) {
+  if (sh_port != &Serial) {
+    Output ("SH:X USB Only");  // Frames go to the USB endpoint, EX.h
+    return;
+  }
+
+  // ex_command() wants the line, put back the spaces the split took out
+  for (int i=1; i<argc; i++) {
+    argv[i][-1] = ' ';
+  }
+  ex_command(argv[0]);
+}
+
+const SH_COMMAND sh_commands[] = {
+  {"help", sh_help, true},
+  {"time", sh_time, true},
+  {"cfg", sh_cfg, true},
+  {"stats", sh_stats, false},
+  {"ev", sh_ev, true},
+  {"tail", sh_tail, true},
+  {"ls", sh_ls, false},
+  {"dump", sh_dump, false},
+  {"bench", sh_bench, false},
+  {"sample", sh_sample, false},
+  {"n2s", sh_n2s, false},
+  {"X", sh_export, false},
+};
+#define SH_COMMAND_COUNT  (sizeof(sh_commands) / sizeof(sh_commands[0]))
+
+/*
+ *=======================================================================================================================
+ * sh_help() - Command names
+ *=======================================================================================================================
+ */
+void sh_help(int argc, char **argv) {
+  int m = sprintf (msgbuf, "SH:");
+
+  for (unsigned int i=0; i<SH_COMMAND_COUNT; i++) {
+    m += sprintf (msgbuf + m, " %s", sh_commands[i].name);
+  }
+  Output (msgbuf);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_find() - Command of a line's first word, NULL if there is none
+ *=======================================================================================================================
+ */
+const SH_COMMAND *sh_find(const char *line) {
+  int len;
+
+  line += strspn(line, " \t");
+  len = strcspn(line, " \t");
+  for (unsigned int i=0; i<SH_COMMAND_COUNT; i++) {
+    if (((int) strlen(sh_commands[i].name) == len) && !strncmp(line, sh_commands[i].name, len)) {
+      return (&sh_commands[i]);
+    }
+  }
+  return (NULL);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_run() - Split a line into words and run its command
+ *=======================================================================================================================
+ */
+void sh_run(char *line) {
+  char *argv[SH_ARGS_MAX + 1];
+  int argc = 0;
+  char *p = line;
+  char *token;
+  const SH_COMMAND *c;
+
+  while ((argc <= SH_ARGS_MAX) && (token = strtok_r(p, " \t", &p))) {
+    argv[argc++] = token;
+  }
+  if (argc == 0) {
+    return;
+  }
+
+  // A bare date and time line sets the clock, as the RTC prompt asks
+  if (isdigit(*argv[0])) {
+    rtc_settime(argv[0]);
+    return;
+  }
+  if ((c = sh_find(argv[0]))) {
+    c->run(argc, argv);
+    return;
+  }
+  sprintf (msgbuf, "SH:Unknown %s", argv[0]);
+  Output (msgbuf);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_poll() - Take what the console port has, run a command when its line is complete. Does not wait.
+ *   With quick_only set (the gauge is sampling) a line for any other command is held until a poll without it.
+ *=======================================================================================================================
+ */
+void sh_poll(bool quick_only) {
+  const SH_COMMAND *c;
+  char ch;
+
+  if (sh_pending) {
+    if (quick_only) {
+      return;  // Input stays with the USB port meanwhile
+    }
+    sh_pending = false;
+    sh_run(sh_line);
+    return;
+  }
+
+  while (sh_port->available()) {
+    ch = sh_port->read();
+    if ((ch == '\n') || (ch == '\r')) {
+      if (!sh_overflow && sh_len) {
+        sh_line[sh_len] = 0;
+        sh_len = 0;
+        c = sh_find(sh_line);
+        if (quick_only && c && !c->quick) {
+          sh_pending = true;
+          Output ("SH:After Sampling");
+          return;
+        }
+        sh_run(sh_line);
+        return;  // Rest waits for the next poll, the loop keeps its pace
+      }
+      sh_len = 0;
+      sh_overflow = false;
+    }
+    else if (sh_len < SH_LINE_MAX) {
+      sh_line[sh_len++] = ch;
+    }
+    else if (!sh_overflow) {
+      sh_overflow = true;
+      Output ("SH:Line Too Long");
+    }
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Service Console - With sh_uart set Serial1 (D0 RX, D1 TX) stays enabled at that baud through the sleep between
+ *    observations, so a laptop on the TTL header gets the shell with no jumper, no reset and USB left off. SERCOM0
+ *    runs in standby from OSC8M on demand (GCLK3, the core's 8 MHz generator) with start of frame detection: the
+ *    start bit of a byte powers up the oscillator, the byte is received and its interrupt ends the sleep. The first
+ *    byte may be lost at the higher rates, a technician presses Enter. sh_uart_session() then runs the shell on
+ *    Serial1, console lines go there too, until SH_UART_IDLE_MS pass without input or the next observation is due,
+ *    and the board goes back to sleep for the rest of the way. Not with sg_serial or tl, they own Serial1.
+ * ======================================================================================================================
+ */
+#define SH_UART_GCLK      3                 // OSC8M, set up by the core's startup
+#define SH_UART_HZ        8000000UL
+#define SH_UART_IDLE_MS   120000            // Session ends after this long without input
+
+bool sh_uart_on = false;
+
+/*
+ *=======================================================================================================================
+ * sh_uart_sync() - Wait for SERCOM0 to take a write to CTRLA or CTRLB
+ *=======================================================================================================================
+ */
+void sh_uart_sync() {
+  while (SERCOM0->USART.SYNCBUSY.reg);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_uart_initialize() - Serial1 up and able to wake the board from standby, before pwr_park_pins()
+ *=======================================================================================================================
+ */
+void sh_uart_initialize() {
+  if (!cf_sh_uart) {
+    return;
+  }
+  if (cf_sg_serial || cf_tl) {
+    LOG_ERR ("SH:Serial1 Used by %s", (cf_sg_serial) ? "sg_serial" : "tl");
+    cf_sh_uart = 0;
+    return;
+  }
+  if ((cf_sh_uart < 1200) || (cf_sh_uart > 115200)) {
+    LOG_INFO ("SH:uart %d->9600", cf_sh_uart);
+    cf_sh_uart = 9600;
+  }
+  Serial1.begin(cf_sh_uart);  // Pins, frame format and the RX interrupt, clocked from GCLK0 for now
+
+  // OSC8M only while a peripheral asks for it, in standby too
+  SYSCTRL->OSC8M.reg |= SYSCTRL_OSC8M_ONDEMAND | SYSCTRL_OSC8M_RUNSTDBY;
+  GCLK->GENDIV.reg = GCLK_GENDIV_ID(SH_UART_GCLK) | GCLK_GENDIV_DIV(1);
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(SH_UART_GCLK) | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_OSC8M |
+                      GCLK_GENCTRL_RUNSTDBY;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+
+  SERCOM0->USART.CTRLA.bit.ENABLE = 0;  // RUNSTDBY, SFDE and BAUD are set with it off
+  sh_uart_sync();
+  GCLK->CLKCTRL.reg = (uint16_t) (GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN(SH_UART_GCLK) | GCLK_CLKCTRL_ID_SERCOM0_CORE);
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  SERCOM0->USART.BAUD.reg = (uint16_t) (65536 - ((65536ULL * 16 * cf_sh_uart) / SH_UART_HZ));  // 16x, arithmetic
+  SERCOM0->USART.CTRLA.bit.RUNSTDBY = 1;
+  SERCOM0->USART.CTRLB.bit.SFDE = 1;
+  sh_uart_sync();
+  SERCOM0->USART.CTRLA.bit.ENABLE = 1;
+  sh_uart_sync();
+
+  sh_uart_on = true;
+  LOG_INFO ("SH:Serial1 %d Baud", cf_sh_uart);
+}
+
+/*
+ *=======================================================================================================================
+ * sh_uart_rx() - Service console has input waiting, a byte ended the sleep
+ *=======================================================================================================================
+ */
+bool sh_uart_rx() {
+  return (sh_uart_on && Serial1.available());
+}
+
+/*
+ *=======================================================================================================================
+ * sh_uart_session() - Shell on Serial1 until it is idle or the next observation is due, true if there was one.
+ *   Call after the wake, with the SD bus back.
+ *=======================================================================================================================
+ */
+bool sh_uart_session() {
+  unsigned long last = millis();
+
+  if (!sh_uart_rx()) {
+    return (false);
+  }
+  op_uart = true;
+  sh_port = &Serial1;
+  Output ("SH:Service Console");
+  while (((millis() - last) < SH_UART_IDLE_MS) && ((tm_now() + (OBS_WAKE_MS / 1000)) < obs_next_epoch)) {
+    wd_feed();
+    if (Serial1.available()) {
+      sh_poll(false);
+      last = millis();
+    }
+    LowPower.idle();  // SysTick or the next byte
+  }
+  Output ("SH:Service Console Closed");
+  Serial1.flush();
+  sh_port = &Serial;
+  sh_len = 0;  // A part line stays behind
+  op_uart = false;
+  return (true);
+}
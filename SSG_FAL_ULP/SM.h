@@ -4,20 +4,88 @@
  * ======================================================================================================================
  */
 
+/*
+ * ======================================================================================================================
+ *  Latest Values - The monitor draws what the sensors last gave and reads none itself. sm_refresh() is the sampler
+ *    task of calibration mode (TK.h), once a second it reads each kind of sensor whose count of seconds is up: the
+ *    Bosch sensors every sm_bmx, the DS probes every sm_ds, the gauge pin and battery every sm_adc. An observation
+ *    leaves sn_table[] and ds_reading[] as it logged them and sm_observed() starts those counts again, so the monitor
+ *    shows what OBS_Do() wrote until the next read is due.
+ * ======================================================================================================================
+ */
+#define SM_FIRST          0x7FFF    // Count that makes the first pass read everything
+
+int sm_sg_raw = 0;                  // analogRead() of the gauge pin
+int sm_batt = 0;                    // mV
+int sm_bmx_n = SM_FIRST;            // Seconds since the last read
+int sm_ds_n = SM_FIRST;
+int sm_adc_n = SM_FIRST;
+bool sm_ds_busy = false;            // Conversion started, read on the next pass
+
+/*
+ * ======================================================================================================================
+ * sm_due() - Count a second, true and start again when period seconds are up
+ * ======================================================================================================================
+ */
+bool sm_due(int *n, int period) {
+  if ((*n < SM_FIRST) && (++(*n) < period)) {
+    return (false);
+  }
+  *n = 0;
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * sm_refresh() - Read the sensors that are due
+ * ======================================================================================================================
+ */
+void sm_refresh() {
+  if (sm_due(&sm_adc_n, cf_sm_adc)) {
+    sg_power(true);  // Left on while monitoring, the next observation turns it off
+    sm_sg_raw = analogRead(SGAUGE_PIN);
+    sm_batt = vbat_mv();
+  }
+  if (sm_due(&sm_bmx_n, cf_sm_bmx)) {
+    sn_sample(&sn_table[SN_BMX_1]);
+    sn_sample(&sn_table[SN_BMX_2]);
+  }
+  if (ds_found) {
+    if (sm_ds_busy) {
+      ds_collect();  // Started on the last pass, no wait left
+      sm_ds_busy = false;
+    }
+    else if (sm_due(&sm_ds_n, cf_sm_ds)) {
+      ds_start();    // Converts until the next pass
+      sm_ds_busy = true;
+    }
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * sm_observed() - The observation read the sensors, its values are the latest
+ * ======================================================================================================================
+ */
+void sm_observed() {
+  sm_bmx_n = 0;
+  sm_ds_n = 0;
+  sm_ds_busy = false;
+}
+
  /*
  * ======================================================================================================================
  * StationMonitor() - On OLED display station information
  * ======================================================================================================================
  */
 void StationMonitor() {
+  SF_SCRATCH sc;
+  char *buf = sc.alloc(SF_LINE);
   int r, c, len;
   
-  float bmx_pressure = 0.0;
-  float bmx_temp = 0.0;
-  float bmx_humid = 0.0;
   char Buffer16Bytes[16];
-
-  float batt = vbat_get();
+  SENSOR *s;
+  JSONBUF jb;
 
   OLED_ClearDisplayBuffer();
 
@@ -26,82 +94,270 @@ void StationMonitor() {
   // =================================================================
   rtc_timestamp();
   len = (strlen (timestamp) > 21) ? 21 : strlen (timestamp);
-  for (c=0; c<=len; c++) oled_lines [0][c] = *(timestamp+c);
+  for (c=0; c<=len; c++) OLED_line(0)[c] = *(timestamp+c);
   Serial_write (timestamp);
 
   // =================================================================
   // Line 1 of OLED
   // =================================================================
-  if (BMX_1_exists) {
-    if (BMX_1_chip_id == BMP280_CHIP_ID) {
-      bmx_pressure = bmp1.readPressure()/100.0F;           // bmxp1
-      bmx_temp = bmp1.readTemperature();                   // bmxt1
-      bmx_humid = 0.0;
-    }
-    else if (BMX_1_chip_id == BME280_BMP390_CHIP_ID) {
-      bmx_pressure = bme1.readPressure()/100.0F;           // bmxp1
-      bmx_temp = bme1.readTemperature();                   // bmxt1
-      bmx_humid = bme1.readHumidity();                     // bmxh1 
-    }
-    else { // BMP388
-      bmx_pressure = bm31.readPressure()/100.0F;           // bmxp1 hPa
-      bmx_temp = bm31.readTemperature();                   // bmxt1
-      bmx_humid = 0.0;
-    }
-    sprintf (Buffer32Bytes, "%d.%02d %d.%02d %d.%02d", 
-      (int)bmx_pressure, (int)(bmx_pressure*100)%100,
-      (int)bmx_temp, (int)(bmx_temp*100)%100,
-      (int)bmx_humid, (int)(bmx_humid*100)%100);
+  s = &sn_table[SN_BMX_1];
+  if (*s->exists) {
+    jb_init(&jb, buf, SF_LINE);
+    jb_putfixed(&jb, s->value[0], 2);
+    jb_putc(&jb, ' ');
+    jb_putfixed(&jb, s->value[1], 2);
+    jb_putc(&jb, ' ');
+    jb_putfixed(&jb, s->value[2], 2);
+    len = jb.len;
   }
   else {
-    sprintf (Buffer32Bytes, "BMX:NF");
+    strcpy (buf, "BMX:NF");
+    len = 6;
   }
-  len = (strlen (Buffer32Bytes) > 21) ? 21 : strlen (Buffer32Bytes);
-  for (c=0; c<=len; c++) oled_lines [1][c] = *(Buffer32Bytes+c);
-  Serial_write (Buffer32Bytes);
+  len = (len > 21) ? 21 : len;
+  for (c=0; c<=len; c++) OLED_line(1)[c] = *(buf+c);
+  Serial_write (buf);
 
   // =================================================================
   // Line 2 of OLED
   // =================================================================
-  if (BMX_2_exists) {
-    if (BMX_2_chip_id == BMP280_CHIP_ID) {
-      bmx_pressure = bmp2.readPressure()/100.0F;           // bmxp1
-      bmx_temp = bmp2.readTemperature();                   // bmxt1
-      bmx_humid = 0.0;
-    }
-    else if (BMX_2_chip_id == BME280_BMP390_CHIP_ID) {
-      bmx_pressure = bme2.readPressure()/100.0F;           // bmxp1
-      bmx_temp = bme2.readTemperature();                   // bmxt1
-      bmx_humid = bme2.readHumidity();                     // bmxh1 
-    }
-    else { // BMP388
-      bmx_pressure = bm32.readPressure()/100.0F;           // bmpx1 hPa
-      bmx_temp = bm32.readTemperature();                   // bmtx1
-      bmx_humid = 0.0;
-    }
-    sprintf (Buffer32Bytes, "%d.%02d %d.%02d %d.%02d", 
-      (int)bmx_pressure, (int)(bmx_pressure*100)%100,
-      (int)bmx_temp, (int)(bmx_temp*100)%100,
-      (int)bmx_humid, (int)(bmx_humid*100)%100);
+  s = &sn_table[SN_BMX_2];
+  if (*s->exists) {
+    jb_init(&jb, buf, SF_LINE);
+    jb_putfixed(&jb, s->value[0], 2);
+    jb_putc(&jb, ' ');
+    jb_putfixed(&jb, s->value[1], 2);
+    jb_putc(&jb, ' ');
+    jb_putfixed(&jb, s->value[2], 2);
+    len = jb.len;
   }
   else {
-    sprintf (Buffer32Bytes, "BMX:NF");
+    strcpy (buf, "BMX:NF");
+    len = 6;
   }
-  len = (strlen (Buffer32Bytes) > 21) ? 21 : strlen (Buffer32Bytes);
-  for (c=0; c<=len; c++) oled_lines [2][c] = *(Buffer32Bytes+c);
-  Serial_write (Buffer32Bytes);
+  len = (len > 21) ? 21 : len;
+  for (c=0; c<=len; c++) OLED_line(2)[c] = *(buf+c);
+  Serial_write (buf);
   
   // =================================================================
   // Line 3 of OLED
   // =================================================================
-  sprintf (Buffer32Bytes, "SG:%3d %d.%02d %04X", 
-    (int) analogRead(SGAUGE_PIN),    // Pins are 12bit resolution (0-1023)
-    (int)batt, (int)(batt*100)%100,
+  sprintf (buf, "SG:%3d %d.%02d %04X", 
+    sm_sg_raw,    // Pins are 10bit resolution (0-1023)
+    sm_batt / 1000, (sm_batt % 1000) / 10,
     SystemStatusBits); 
 
-  len = (strlen (Buffer32Bytes) > 21) ? 21 : strlen (Buffer32Bytes);
-  for (c=0; c<=len; c++) oled_lines [3][c] = *(Buffer32Bytes+c);
-  Serial_write (Buffer32Bytes);
+  len = (strlen (buf) > 21) ? 21 : strlen (buf);
+  for (c=0; c<=len; c++) OLED_line(3)[c] = *(buf+c);
+  Serial_write (buf);
+
+  OLED_update();
+}
+
+/*
+ * ======================================================================================================================
+ * StationMonitorSampling() - While the gauge samples keep the clock going, the ADC and sensors are not touched
+ * ======================================================================================================================
+ */
+void StationMonitorSampling(unsigned long ms) {
+  SF_SCRATCH sc;
+  char *buf = sc.alloc(SF_LINE);
+  int c, len;
+
+  rtc_timestamp();
+  len = (strlen (timestamp) > 21) ? 21 : strlen (timestamp);
+  for (c=0; c<=len; c++) OLED_line(0)[c] = *(timestamp+c);
+  Serial_write (timestamp);
+
+  sprintf (buf, "SG:Sampling %lus", ms / 1000);
+  len = (strlen (buf) > 21) ? 21 : strlen (buf);
+  for (c=0; c<=len; c++) OLED_line(3)[c] = *(buf+c);
+  Serial_write (buf);
+
+  OLED_update();
+}
+
+/*
+ * ======================================================================================================================
+ *  Status Button - With sm_btn_pin set a push button from that pin to ground wakes the board from its sleep between
+ *    observations. sm_button() then shows the last observation and the station's health on the OLED for SM_BTN_MS,
+ *    from what is held in RAM, nothing is read or sampled, and obs_sleep() goes back to sleep until the slot it
+ *    was sleeping for. The panel shows its own RAM, the board sleeps through the SM_BTN_MS too. Presses while the
+ *    status is shown are dropped. The display is turned on for it in the power save profiles as well.
+ *
+ *    The gauge's last 24 hours from the trend ring (OBS.h obs_trend()) are drawn as a sparkline below the status
+ *    on a 128x64 panel, on a 128x32 one for another SM_BTN_MS after it. A column a quarter hour, oldest on the left,
+ *    scaled to the lowest and highest point, which are printed on the right in mm. Each page is drawn in a column
+ *    buffer and sent by itself (OLED_columns()), the lines it covers are sent again by the next OLED_update().
+ * ======================================================================================================================
+ */
+#define SM_BTN_MS         5000              // Status shown
+#define SM_TR_LABEL       (OBS_TR_POINTS + 2)  // Column of the labels
+
+volatile bool sm_btn_pressed = false;
+
+/*
+ * ======================================================================================================================
+ * sm_btn_isr() - Status button went low
+ * ======================================================================================================================
+ */
+void sm_btn_isr() {
+  sm_btn_pressed = true;
+}
+
+/*
+ * ======================================================================================================================
+ * sm_btn_initialize() - Button pin as a wakeup source, after the pins are parked
+ * ======================================================================================================================
+ */
+void sm_btn_initialize() {
+  if (!cf_sm_btn_pin) {
+    return;
+  }
+  if ((cf_sm_btn_pin == SCE_PIN) || (cf_sm_btn_pin == cf_rtc_int_pin) || (cf_sm_btn_pin == cf_sg_pwr_pin) ||
+      (cf_sm_btn_pin == cf_sg_pw_pin) || (cf_sm_btn_pin == cf_sg_trig_pin)) {
+    LOG_ERR ("SM:btn pin %d ERR", cf_sm_btn_pin);
+    cf_sm_btn_pin = 0;
+    return;
+  }
+  pinMode(cf_sm_btn_pin, INPUT_PULLUP);
+  LowPower.attachInterruptWakeup(cf_sm_btn_pin, sm_btn_isr, FALLING);
+  LOG_INFO ("SM:Button %d", cf_sm_btn_pin);
+}
 
+/*
+ * ======================================================================================================================
+ * sm_status() - Last observation, from the tail ring, and health on the OLED lines
+ * ======================================================================================================================
+ */
+void sm_status() {
+  SF_SCRATCH sc;
+  char *buf = sc.alloc(SF_LINE);
+  const char *profile[] = {"NRM", "SAV", "CRT"};
+  const OBS_BINREC *r = obs_tail_get(0);
+  char v1[12], v2[12];
+  uint32_t now_s = tm_now();
+
+  OLED_ClearDisplayBuffer();
+  if (r) {
+    DateTime t(r->at);
+
+    sprintf (buf, "OBS %d-%02d-%02d %02d:%02d", t.year(), t.month(), t.day(), t.hour(), t.minute());
+    OLED_setline(0, buf);
+    if (r->flags & OBS_BIN_F_BV) {
+      sprintf (buf, "SG:%dmm BV:%d.%02d", r->sg, r->bv / 100, r->bv % 100);
+    }
+    else {
+      sprintf (buf, "SG:%dmm", r->sg);
+    }
+    OLED_setline(1, buf);
+    if (r->flags & OBS_BIN_F_BMX_1) {
+      fix_str(v1, sizeof(v1), OBS_bin_fix(r->bt1), 1);
+      fix_str(v2, sizeof(v2), r->bp1 * (FIX_ONE / 100), 1);
+      sprintf (buf, "T:%s P:%s", v1, v2);
+    }
+    else {
+      strcpy (buf, "BMX:NF");
+    }
+    OLED_setline(2, buf);
+  }
+  else {
+    OLED_setline(0, "OBS None");
+  }
+  sprintf (buf, "%04X %s NXT %lum", SystemStatusBits, profile[pwr_profile],
+    (unsigned long) ((obs_next_epoch > now_s) ? (obs_next_epoch - now_s + 59) / 60 : 0));
+  OLED_setline(3, buf);
   OLED_update();
 }
+
+/*
+ * ======================================================================================================================
+ * sm_trend() - Sparkline of the trend ring on display lines row to row + rows - 1
+ * ======================================================================================================================
+ */
+void sm_trend(int row, int rows) {
+  uint8_t cols[SCREEN_WIDTH];
+  uint8_t text[SCREEN_WIDTH];
+  int8_t y[OBS_TR_POINTS];          // Pixel row of each point from the top, -1 = none
+  int h = rows * 8;
+  int lo = OBS_TR_NONE, hi = -1;
+  int v, a, b;
+  char label[8];
+
+  for (int x=0; x<OBS_TR_POINTS; x++) {
+    v = (obs_tr_slot) ? obs_tr[(obs_tr_slot + 1 + x) % OBS_TR_POINTS] : OBS_TR_NONE;  // Oldest first
+    y[x] = (v == OBS_TR_NONE) ? -1 : v;
+    if (v != OBS_TR_NONE) {
+      lo = (v < lo) ? v : lo;
+      hi = (v > hi) ? v : hi;
+    }
+  }
+  for (int x=0; x<OBS_TR_POINTS; x++) {
+    if (y[x] >= 0) {  // 1 pixel margin top and bottom, a flat trend across the middle
+      y[x] = (hi > lo) ? (h - 2) - ((y[x] - lo) * (h - 3)) / (hi - lo) : h / 2;
+    }
+  }
+
+  for (int r=0; r<rows; r++) {
+    memset (cols, 0, sizeof(cols));
+    for (int x=0; x<OBS_TR_POINTS; x++) {
+      if (y[x] < 0) {
+        continue;
+      }
+      a = y[x];
+      b = ((x > 0) && (y[x-1] >= 0)) ? y[x-1] : a;  // Joined to the point before it
+      for (int py=((a < b) ? a : b); py<=((a < b) ? b : a); py++) {
+        if ((py / 8) == r) {
+          cols[x] |= 1 << (py % 8);
+        }
+      }
+    }
+    label[0] = 0;
+    if (hi < 0) {
+      strcpy (label, (r == 0) ? "none" : "");
+    }
+    else if (r == 0) {
+      sprintf (label, "%d", hi * obs_tr_mm);
+    }
+    else if (r == rows - 1) {
+      sprintf (label, "%d", lo * obs_tr_mm);
+    }
+    else if (r == 1) {
+      strcpy (label, "24h");
+    }
+    oled->textColumns(text, label);
+    memcpy (cols + SM_TR_LABEL, text, SCREEN_WIDTH - SM_TR_LABEL);
+    OLED_columns(row + r, cols);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * sm_button() - Show the status for a button press, call after each wake from the sleep between observations
+ * ======================================================================================================================
+ */
+bool sm_button() {
+  bool enabled = DisplayEnabled;
+
+  if (!sm_btn_pressed) {
+    return (false);
+  }
+  if (oled_type) {
+    DisplayEnabled = true;
+    OLED_wakeDisplay();
+    sm_status();
+    if (OLED64) {
+      sm_trend(4, 4);  // Below the status
+    }
+    iq_drain();  // Lines sent before standby stops the bus
+    LowPower.sleep(SM_BTN_MS);
+    if (!OLED64) {
+      sm_trend(0, OLED_ROWS);
+      LowPower.sleep(SM_BTN_MS);
+    }
+    OLED_sleepDisplay();
+    DisplayEnabled = enabled;
+  }
+  sm_btn_pressed = false;
+  return (true);
+}
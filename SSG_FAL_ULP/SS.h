@@ -0,0 +1,161 @@
+/*
+ * ======================================================================================================================
+ *  SS.h - Seasonal Schedule
+ *
+ *  The ss1-ss6 entries of CONFIG.TXT each give a season's observation interval, gauge sample count, DS18B20
+ *  resolution and display, from its month and day until the next entry's, the last running into the first. They
+ *  are checked and sorted by date when the config is read and the time of the next change is worked out then, so a
+ *  wake compares tm_now() with ss_next and nothing more. The season's values go in cf_obs_interval, cf_sg_samples
+ *  and cf_ds_res over those of the file, kept in ss_base[], and the modules are set up for them as for a config
+ *  reload. The power profiles, pwr_until and the adaptive cadence work from the season's interval. Each change is
+ *  an EV_SS_SEASON event with the entry's MMDD.
+ * ======================================================================================================================
+ */
+void cf_apply();                    // SSG_FAL_ULP.ino, modules set up for the config
+
+#define SS_BASE_INTERVAL  0                 // ss_base[] index
+#define SS_BASE_SAMPLES   1
+#define SS_BASE_DS_RES    2
+
+typedef struct {
+  int mmdd;                         // First day, month * 100 + day
+  int interval;                     // Minutes, 0 = obs_interval
+  int samples;                      // Gauge samples, 0 = sg_samples
+  int ds_res;                       // DS18B20 bits, 0 = ds_res
+  bool display;                     // OLED left on
+} SS_ENTRY;
+
+SS_ENTRY ss[SS_MAX];                // By date
+int ss_n = 0;                       // Entries, 0 = no schedule
+int ss_active = -1;                 // Entry in use, -1 = none
+uint32_t ss_next = 0xFFFFFFFF;      // Unix time of the next change, never without a schedule
+bool ss_display = true;             // Season lets the OLED on, PWR.h
+int ss_base[3];                     // obs_interval, sg_samples and ds_res as CONFIG.TXT has them
+
+const uint8_t ss_mdays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};  // No 0229, it is not every year
+
+/*
+ *=======================================================================================================================
+ * ss_valid() - Entry k of cf_ss[] is a date that comes every year with values the modules take
+ *=======================================================================================================================
+ */
+bool ss_valid(int k) {
+  int *f = cf_ss[k];
+  int month = f[0] / 100;
+  int day = f[0] % 100;
+
+  if ((month < 1) || (month > 12) || (day < 1) || (day > ss_mdays[month - 1])) {
+    return (false);
+  }
+  if ((f[1] < 0) || (f[1] > 1440) || (f[1] && ((1440 % f[1]) != 0))) {
+    return (false);
+  }
+  if ((f[2] < 0) || (!cf_sg_stream && (f[2] > (SG_BUCKETS / cf_sg_chans)))) {
+    return (false);
+  }
+  return ((f[3] == 0) || ((f[3] >= 9) && (f[3] <= 12)));
+}
+
+/*
+ *=======================================================================================================================
+ * ss_select() - Season of time t into the config and the time of the one after it
+ *=======================================================================================================================
+ */
+void ss_select(uint32_t t) {
+  DateTime d(t);
+  int today = d.month() * 100 + d.day();
+  int year = d.year();
+  int i, next;
+  SS_ENTRY *e;
+
+  for (i=ss_n-1; (i>=0) && (ss[i].mmdd > today); i--);
+  if (i < 0) {
+    i = ss_n - 1;  // Before the first date, the last season of the year before
+  }
+  next = (i + 1) % ss_n;
+  if (ss[next].mmdd <= today) {
+    year++;
+  }
+  ss_next = DateTime(year, ss[next].mmdd / 100, ss[next].mmdd % 100, 0, 0, 0).unixtime();
+
+  e = &ss[i];
+  ss_active = i;
+  cf_obs_interval = (e->interval) ? e->interval : ss_base[SS_BASE_INTERVAL];
+  cf_sg_samples = (e->samples) ? e->samples : ss_base[SS_BASE_SAMPLES];
+  cf_ds_res = (e->ds_res) ? e->ds_res : ss_base[SS_BASE_DS_RES];
+  ss_display = e->display;
+  obs_cadence = 0;  // Adaptive cadence starts again from the season's interval
+
+  ev_note (EV_SS_SEASON, e->mmdd);
+  LOG_INFO ("SS:%dm %d Samples %d Bits %s", cf_obs_interval, cf_sg_samples, cf_ds_res, (ss_display) ? "OLED" : "Dark");
+}
+
+/*
+ *=======================================================================================================================
+ * ss_restore() - The file's values back in the config, before CONFIG.TXT is read again
+ *=======================================================================================================================
+ */
+void ss_restore() {
+  if (ss_active < 0) {
+    return;
+  }
+  cf_obs_interval = ss_base[SS_BASE_INTERVAL];
+  cf_sg_samples = ss_base[SS_BASE_SAMPLES];
+  cf_ds_res = ss_base[SS_BASE_DS_RES];
+}
+
+/*
+ *=======================================================================================================================
+ * ss_initialize() - Sort the schedule read from CONFIG.TXT and put the season of today in the config, call once the
+ *   RTC is read and after each reload. True when the season or its display changed, the modules are not set up here.
+ *=======================================================================================================================
+ */
+bool ss_initialize() {
+  int was = ss_active;
+  bool display = ss_display;
+  int i;
+
+  ss_n = 0;
+  ss_active = -1;
+  ss_next = 0xFFFFFFFF;
+  ss_display = true;
+  ss_base[SS_BASE_INTERVAL] = cf_obs_interval;
+  ss_base[SS_BASE_SAMPLES] = cf_sg_samples;
+  ss_base[SS_BASE_DS_RES] = cf_ds_res;
+
+  for (int k=0; k<cf_ss_n; k++) {
+    if (!ss_valid(k)) {
+      LOG_ERR ("SS:%04d ERR", cf_ss[k][0]);
+      continue;
+    }
+    for (i=0; (i<ss_n) && (ss[i].mmdd < cf_ss[k][0]); i++);
+    if ((i < ss_n) && (ss[i].mmdd == cf_ss[k][0])) {
+      LOG_ERR ("SS:%04d Twice", cf_ss[k][0]);
+      continue;
+    }
+    memmove (&ss[i+1], &ss[i], (ss_n - i) * sizeof(SS_ENTRY));
+    ss[i].mmdd = cf_ss[k][0];
+    ss[i].interval = cf_ss[k][1];
+    ss[i].samples = cf_ss[k][2];
+    ss[i].ds_res = cf_ss[k][3];
+    ss[i].display = (cf_ss[k][4] != 0);
+    ss_n++;
+  }
+  if (ss_n) {
+    ss_select(tm_now());
+  }
+  return ((ss_active != was) || (ss_display != display));
+}
+
+/*
+ *=======================================================================================================================
+ * ss_check() - At wake, the next season once its date is reached
+ *=======================================================================================================================
+ */
+void ss_check() {
+  if (tm_now() < ss_next) {
+    return;
+  }
+  ss_select(tm_now());
+  cf_apply();
+}
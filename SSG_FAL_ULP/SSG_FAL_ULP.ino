@@ -33,28 +33,43 @@
 #include <Wire.h>
 #include <ArduinoLowPower.h>
 #include <SD.h>
+#include <USB/PluggableUSB.h>
+#include "ST.h"                   // Station Build, which of the drivers below are linked
+#if STN_BME280
 #include <Adafruit_BME280.h>
+#endif
+#if STN_BMP280
 #include <Adafruit_BMP280.h>
+#endif
+#if STN_BM3
 #include <Adafruit_BMP3XX.h>
+#endif
+#if STN_MCP
 #include <Adafruit_MCP9808.h>
+#endif
 
 #include <RTClib.h>
 
 #define RTC_I2C_ADDRESS 0x68       // I2C address for PCF8523 and DS3231
 
+// 0x40 and 0x200 were SSB_AS5600 and SSB_HTU21DF, never set by this firmware. They are SSB_OVERRUN and SSB_WDT from
+// log schema 2 (SDC.h SD_SCHEMA) and binary record type 5 (OBS.h OBS_BIN_TYPE), read them by those.
 #define SSB_PWRON           0x1     // Set at power on, but cleared after first observation
 #define SSB_SD              0x2     // Set if SD missing at boot or other SD related issues
 #define SSB_RTC             0x4     // Set if RTC missing at boot
 #define SSB_OLED            0x8     // Set if OLED missing at boot, but cleared after first observation
 #define SSB_N2S             0x10    // Set when Need to Send observations exist
 #define SSB_FROM_N2S        0x20    // Set in transmitted N2S observation when finally transmitted
-#define SSB_AS5600          0x40    // Set if wind direction sensor AS5600 has issues
+#define SSB_OVERRUN         0x40    // Set if a phase of the cycle ran past its budget, see WD.h
 #define SSB_BMX_1           0x80    // Set if Barometric Pressure & Altitude Sensor missing
 #define SSB_BMX_2           0x100   // Set if Barometric Pressure & Altitude Sensor missing
-#define SSB_HTU21DF         0x200   // Set if Humidity & Temp Sensor missing
+#define SSB_WDT             0x200   // Set after a watchdog reset, cleared after first observation
 #define SSB_SI1145          0x400   // Set if UV index & IR & Visible Sensor missing
 #define SSB_MCP_1           0x800   // Set if Precision I2C Temperature Sensor missing
 #define SSB_DS_1           0x1000   // Set if Dallas One WireSensor missing at startup
+#define SSB_PWR_SAVE       0x2000   // Set while the battery power profile is SAVE
+#define SSB_PWR_CRIT       0x4000   // Set while the battery power profile is CRITICAL
+#define SSB_SG_BURST       0x8000   // Set while a gauge level event has the burst schedule in use
 
 
 unsigned int SystemStatusBits = SSB_PWRON; // Set bit 0 for initial value power on. Bit 0 is cleared after first obs
@@ -65,9 +80,7 @@ bool JustPoweredOn = true;         // Used to clear SystemStatusBits set during
  *  Globals
  * =======================================================================================================================
  */
-char msgbuf[256];
-char *msgp;                               // Pointer to message text
-char Buffer32Bytes[32];                   // General storage
+char msgbuf[384];
 int countdown = 1800;        // Exit calibration mode when reaches 0 - protects against burnt out pin or forgotten jumper
 unsigned int SendSensorMsgCount=0;        // Counter for Sensor messages transmitted
 unsigned int SendType2MsgCount=0;         // Counter for Powerup and Heartbeat messages transmitted
@@ -90,60 +103,178 @@ bool SD_exists = false;     // Set to true if SD card found at boot
  * ======================================================================================================================
  */
 #include "QC.h"                   // Quality Control Min and Max Sensor Values on Surface of the Earth
+#include "DMA.h"                  // SAMD21 DMA Controller
+#include "IQ.h"                   // I2C DMA Transaction Queue
 #include "SF.h"                   // Support Functions
 #include "OP.h"                   // OutPut support for OLED and Serial Console
+#include "EV.h"                   // Event Catalog
+#include "RM.h"                   // RAM Headroom
 #include "CF.h"                   // Configuration File Variables
+#include "CK.h"                   // CPU Clock Scaling
+#include "WD.h"                   // Watchdog and Phase Budgets
 #include "TM.h"                   // Time Management
+#include "EN.h"                   // Energy Monitor
+#include "OW.h"                   // One Wire over a SERCOM UART
 #include "DS.h"                   // Dallas Sensor - One Wire
 #include "Sensors.h"              // I2C Based Sensors
 #include "SDC.h"                  // SD Card
+#include "FL.h"                   // Internal Flash Fallback
+#include "NS.h"                   // Need to Send Queue
+#include "RS.h"                   // Runtime Statistics
+#include "MS.h"                   // USB Mass Storage Service Mode
+#include "EX.h"                   // Log Export over the USB Serial Console
 #include "SG.h"                   // Stream/Snow Gauge
+#include "PWR.h"                  // Battery Power Profiles
+#include "SS.h"                   // Seasonal Schedule
 #include "OBS.h"                  // Do Observation Processing
+#include "WS.h"                   // Warm Start Snapshot
+#include "AR.h"                   // Log Archiver
+#include "TL.h"                   // Telemetry
+#include "BG.h"                   // Background Work Budget
 #include "SM.h"                   // Station Monitor
+#include "BM.h"                   // On-target Benchmarks
+#include "SH.h"                   // Serial Command Shell
+#include "TK.h"                   // Calibration Mode Tasks
 
 
 /* 
  *=======================================================================================================================
- * seconds_to_next_obs() - do observations on 0, 15, 30, or 45 minute window
+ * seconds_to_next_obs() - do observations on cf_obs_interval minute window
  *=======================================================================================================================
  */
 int seconds_to_next_obs() {
-  now = rtc.now(); //get the current date-time
-  return (900 - (now.unixtime() % 900)); // 900 = 60s * 15m,  The mod operation gives us seconds passed in this 15m window
+  return (obs_interval_s - (tm_now() % obs_interval_s)); // The mod operation gives us seconds passed in this window
+}
+
+/*
+ *=======================================================================================================================
+ * cf_reload() - At wake, parse CONFIG.TXT again when its directory entry changed and set the modules up for it.
+ *   Keys set up only at boot keep their value until a reset. A key taken out of the file goes back to its default
+ *   when that is 0, read without SD_available() in SD_ReadConfigFile(), any other keeps its last value.
+ *=======================================================================================================================
+ */
+void cf_reload() {
+  int old[CF_KEY_COUNT];
+  uint32_t size, modified;
+  int n = 0;
+  bool season;
+
+  if (SdVolume::sdCard()->poweredDown()) {
+    return;  // Card off for the sleep, SDC.h Card Power, not turned on for this
+  }
+  if (!fl_cf_changed(&size, &modified)) {
+    return;
+  }
+  for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+    old[i] = *cf_keys[i].value;
+  }
+  ss_restore();       // The file's values under the season, a key taken out keeps those
+  cf_loaded = false;  // Read the file into the table again
+  SD_ReadConfigFile();
+  fl_cf_size = size;
+  fl_cf_modified = modified;
+  fl_cf_save(size, modified);  // As parsed, boot keys included for the next reset
+  season = ss_initialize();    // Season over the file's values again, compared with the ones in use below
+
+  for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+    if (*cf_keys[i].value == old[i]) {
+      continue;
+    }
+    if (cf_keys[i].reset) {
+      LOG_INFO ("CF:%s=%d at Reset", cf_keys[i].key, *cf_keys[i].value);
+      *cf_keys[i].value = old[i];
+      continue;
+    }
+    LOG_INFO ("CF:%s %d->%d", cf_keys[i].key, old[i], *cf_keys[i].value);
+    n++;
+  }
+  ev_note (EV_CF_RELOAD, n);
+  if ((n == 0) && !season) {
+    return;
+  }
+  cf_apply();
+}
+
+/*
+ *=======================================================================================================================
+ * cf_apply() - Set the modules up for the config after a reload or a change of season, between observations when
+ *   nothing is sampling
+ *=======================================================================================================================
+ */
+void cf_apply() {
+  s_gauge_initialize();
+#if STN_DS
+  if (ds_found) {
+    if ((cf_ds_res < 9) || (cf_ds_res > 12)) {
+      LOG_ERR ("DS RES %d ERR", cf_ds_res);
+      cf_ds_res = 12;
+    }
+    ds_resolution(cf_ds_res);
+  }
+#endif
+  mcp9808_initialize();
+  bmx_slp_initialize();
+  bmx_cf_check();          // Before pwr_apply() writes bmx_osr to the sensors
+  pwr_apply(pwr_profile);  // Interval, sample count and BMX oversampling of the profile
 }
 
 /*
  * =======================================================================================================================
- * setup()
+ * setup() - Ordered by what each step needs rather than one device after another. The waits that are the sensor's
+ *   and not the CPU's start first and are collected last: the DS18B20 conversion begins at reset with a skip ROM
+ *   broadcast and runs through the console wait, the SD mount, the config read and the Bosch and MCP init, which
+ *   need the config and so follow it. dallas_sensor_init() then finds the reading done. The delays left are the
+ *   USB one below, console only, SD_PWR_MS for the card supply, a 5 s pause when the card is missing and the
+ *   console is up, and the 250 ms before a second 1-Wire scan when the first found nothing.
  * =======================================================================================================================
  */
 void setup() 
 {
+  rm_paint();       // Before anything else takes stack
+
   // Put initialization like pinMode and begin functions here.
   pinMode (LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, LOW);
 
+#if STN_DS
+  ds_start();       // Converts while we boot, dallas_sensor_init() reads it
+#endif
+
+  I2C_Initialize();
+  I2C_Scan();       // Every driver below looks up its address in the scan
   Output_Initialize();
-  delay(2000); // Prevents usb driver crash on startup
+  Output_Delay(2000); // Prevents usb driver crash on startup, skipped when headless or quiet
 
   Serial_writeln(COPYRIGHT);
   Output (VERSION_INFO);
-
-  // Set up gauge pin for reading 
-  pinMode(SGAUGE_PIN, INPUT);
+  I2C_Report();
+  ev_record (EV_BOOT, PM->RCAUSE.reg);
+  wd_boot();
 
   // Initialize SD card if we have one.
   SD_initialize();
 
-  if (SD_exists && SD.exists(CF_NAME)) {
-    SD_ReadConfigFile();
-  }
-  else {
-    sprintf(msgbuf, "CF:NO %s", CF_NAME); Output (msgbuf);
+  fl_config();  // Snapshot in flash while CONFIG.TXT is unchanged
+  SD_JournalReplay();  // Records a reset kept from their daily log
+  if (cf_i2c_dma) {
+    iq_initialize();  // OLED pages and BusIO sensor transfers by DMA from here on
   }
 
+  // Set up gauge pin for reading, validate sampling config
+  s_gauge_initialize();
+  sg_cal_initialize();  // Calibration points, a change waits for the next reset
+  tl_initialize();
+  sh_uart_initialize();
+  pwr_park_pins();   // After every configured pin is known
+  pwr_bod_initialize();
+  sm_btn_initialize();
+
   // Read RTC and set system clock if RTC clock valid
   rtc_initialize();
+  if (ss_initialize()) {
+    pwr_apply(pwr_profile);  // Interval, sample count and display of the season, DS resolution at its init below
+  }
+  SD_ContigBoot();   // Earlier days' extents a reboot over midnight left untrimmed
 
   if (RTC_valid) {
     Output("RTC: Valid");
@@ -155,14 +286,35 @@ void setup()
   rtc_timestamp();
   sprintf (msgbuf, "%s", timestamp);
   Output(msgbuf);
-  delay (2000);
 
-  // Dallas Sensor
-  dallas_sensor_init();
+  // Records held in flash while the SD card was down
+  fl_initialize();
+  ns_initialize();
+  rs_initialize();
+  ws_restore();     // Runtime state of the last observation when this is a reset mid-season
 
-  // Adafruit i2c Sensors
+  // Adafruit i2c Sensors, the DS18B20 conversion from reset is still running
   bmx_initialize();
   mcp9808_initialize();
+  I2C_Restore();    // Driver begin() calls left the bus at 100kHz
+
+#if STN_DS
+  // Dallas Sensor, the probes of the snapshot on a warm start
+  if (ws_warm && ds_found) {
+    ds_wait();
+    ds_resolution(cf_ds_res);
+  }
+  else {
+    dallas_sensor_init();
+  }
+#endif
+  en_initialize();
+  ws_resume();
+
+  wd_initialize();  // From here a hang resets the board
+  rm_report();
+  Output_BootReport();  // Quiet boot lines to the OLED and SD
+  ph_start(false);  // First cycle's wake phase is the rest of boot
 }
 
 /*
@@ -172,16 +324,17 @@ void setup()
  */
 void loop()
 {
+  wd_feed();
+
   // RTC not set, Get Time for User
   if (!RTC_valid) {
     static bool first = true;
 
-    delay (1000);
+    tk_wait (1000);  // Idle, a console line ends it
       
     if (first) {
       if (digitalRead(SCE_PIN) != LOW) {
-        Serial.begin(9600);
-        SerialConsoleEnabled = true;
+        Serial_Attach();
       }  
     
       Output("SET RTC ENTER:");
@@ -189,72 +342,86 @@ void loop()
       first = false;
     }
     
-    if (rtc_readserial()) { // check for serial input, validate for rtc, set rtc, report result
+    sh_poll(false);  // Console shell, a YYYY:MM:DD:HH:MM:SS line sets the rtc
+    if (RTC_valid) {
       Output("!!!!!!!!!!!!!!!!!!!");
       Output("!!! Press Reset !!!");
       Output("!!!!!!!!!!!!!!!!!!!");
 
       while (true) {
-        delay (1000);
+        LowPower.idle();
       }
     }
   }
 
   //Calibration mode, You can also reset the RTC here
   else if (countdown && digitalRead(SCE_PIN) == LOW) { 
-    // Every minute, Do observation (don't save to SD) and transmit - So we can test LoRa
-    I2C_Check_Sensors();
-    
-    if ( (countdown%60) == 0) { 
-      OBS_Do(false);
-      sprintf (Buffer32Bytes, "NO:%ds", seconds_to_next_obs());
-      Output (Buffer32Bytes);
-    }
-    
-    if (BMX_1_exists || BMX_2_exists) {
-      StationMonitor();
-    }
-    else {
-      float batt = vbat_get();
-      if (ds_found) {
-        getDSTemp();
-      }
-      sprintf (Buffer32Bytes, "S:%3d T:%d.%02d %d.%02d %04X", 
-        (int) analogRead(SGAUGE_PIN),    // Pins are 10bit resolution (0-1023)
-        (int)ds_reading, (int)(ds_reading*100)%100,
-        (int)batt, (int)(batt*100)%100,
-        SystemStatusBits); 
-      Output (Buffer32Bytes);
-    }
-    
-    // check for input sting, validate for rtc, set rtc, report result
-    if (Serial.available() > 0) {
-      rtc_readserial(); // check for serial input, validate for rtc, set rtc, report result
-    }
-    
-    countdown--;
-    delay (1000);
+    // Every minute, Do observation (don't save to SD) and transmit - So we can test LoRa. Monitor each second, the
+    // console shell and the USB drive between them, see TK.h
+    Serial_Attach();  // Jumper put on after a headless boot
+    ms_begin();    // Card is a USB drive while the jumper is on
+    tk_loop();
   }
 
   // Normal Operation
   else {
+    ms_end();
+    if (SerialHeadlessBoot && (digitalRead(SCE_PIN) != LOW)) {
+      Serial_Detach();  // Jumper back off, headless again
+    }
+    pwr_bod_service();  // Early warning while awake, parked until the rail is back
+    cf_reload();      // CONFIG.TXT edited since the last wake
+    ss_check();       // Season's date reached
+    ph_end(PH_WAKE);
+    obs_schedule();   // Fix the next slot before the work so awake time does not shift it
     I2C_Check_Sensors();
+    ph_end(PH_I2C);
     OBS_Do(true);
 
     // Shutoff System Status Bits related to initialization after we have logged first observation
     JPO_ClearBits();
+    ws_save();
+    ph_end(PH_SLEEP);
+    bg_service();     // Telemetry, stats and the archiver, within bg_ms
+#if STN_SD_PWR
+    cf_reload();      // Checked while the writes have the card on, it was off at the top of the wake
+#endif
     
     Output("Going to Sleep");
-    
-    delay(2000);    
     OLED_sleepDisplay();
+    SD_WriteWait();  // Card programmed the observation while we were awake
+    SD_PowerDown();
 
-    // At this point we need to determine seconds to next 0, 15, 30, or 45 minute window
-    
-    LowPower.sleep(seconds_to_next_obs()*1000); // uses milliseconds
+    // Sleep until the slot fixed by obs_schedule(), less the time spent waking the display
+    // or a gauge level event. Events keep the gauge powered so they are only watched on the normal profile.
+    if (pwr_profile == PWR_NORMAL) {
+      sg_event_arm();
+    }
+    pwr_sleep_prepare();
+    ph_end(PH_SLEEP);
+    en_sleep();
+    obs_sleep();
+    en_wake();
+    pwr_wake_restore();
+    sg_event_disarm();
+    if (pwr_bod_service()) {
+      pwr_sleep_prepare();
+      obs_sleep();  // Rest of the way to the slot, or the next one
+      pwr_wake_restore();
+    }
+    while (sh_uart_session()) {
+      pwr_sleep_prepare();
+      obs_sleep();  // Rest of the way after the service console
+      pwr_wake_restore();
+    }
+    ph_start(true);
+    if (obs_event) {
+      obs_event = false;
+      Output("SG:Event");
+      obs_burst(true);
+    }
  
-    OLED_wakeDisplay();   // May need to toggle the Display reset pin.
-    delay(2000);
+    OLED_wakeDisplay();   // Settles its charge pump, OP.h
     OLED_ClearDisplayBuffer(); 
     Output("Wakeup");
   }
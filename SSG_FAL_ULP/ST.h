@@ -0,0 +1,85 @@
+/*
+ * ======================================================================================================================
+ *  ST.h - Station Build
+ *
+ *  STN_FIXED 0, the default, links every driver and finds the sensors and display on the bus at boot. A station
+ *  whose hardware is known can be built with STN_FIXED 1 and its parts described below, or with -D in the build.
+ *  Drivers for parts it lacks are not included, their branches are compiled out and the Bosch type of each slot is
+ *  a constant, so the reads dispatch without a switch on the chip ID. Boot reads no chip IDs, a part that is not on
+ *  the bus is still reported missing.
+ *
+ *    STN_BMX_1, STN_BMX_2   BMX_TYPE_* at 0x77 and 0x76, BMX_TYPE_UNKNOWN for none
+ *    STN_MCP_1, STN_MCP_2   1 = MCP9808 at 0x18, 0x19
+ *    STN_DS                 1 = DS18B20 probes on the One Wire bus
+ *    STN_OLED               0 = none, 32 = 128x32 at 0x3C, 64 = 128x64 at 0x3D
+ *
+ *  STN_DS_UART 1, with or without STN_FIXED, runs the One Wire bus from SERCOM1 on D10 and D11 (OW.h) in place of
+ *  DS0_PIN, the station needs the TX buffer or diode for it.
+ *
+ *  STN_SD_PWR, the pin of a load switch on the SD card's supply (high = on), powers the card off while the board
+ *  sleeps (SDC.h Card Power). A build define, not a key, the config is read from the card it switches. 0 = none.
+ *
+ *  STN_SG_STREAM 1 builds the gauge for the streaming estimator only (SG.h), sg_stream is always on and the 600
+ *  byte sample buffer shrinks to SG_STREAM_BUCKETS, which a trace replay reads through. Buffered sampling, sg_chans,
+ *  sg_trace=1 and sg_raw need the full buffer and do not run in such a build.
+ * ======================================================================================================================
+ */
+#define BMX_TYPE_UNKNOWN      0
+#define BMX_TYPE_BMP280       1
+#define BMX_TYPE_BME280       2
+#define BMX_TYPE_BMP388       3
+#define BMX_TYPE_BMP390       4
+
+#ifndef STN_FIXED
+#define STN_FIXED             0
+#endif
+
+#ifndef STN_DS_UART
+#define STN_DS_UART           0
+#endif
+
+#ifndef STN_SD_PWR
+#define STN_SD_PWR            0
+#endif
+
+#ifndef STN_SG_STREAM
+#define STN_SG_STREAM         0
+#endif
+
+#if STN_FIXED
+#ifndef STN_BMX_1
+#define STN_BMX_1             BMX_TYPE_BMP390
+#endif
+#ifndef STN_BMX_2
+#define STN_BMX_2             BMX_TYPE_UNKNOWN
+#endif
+#ifndef STN_MCP_1
+#define STN_MCP_1             1
+#endif
+#ifndef STN_MCP_2
+#define STN_MCP_2             0
+#endif
+#ifndef STN_DS
+#define STN_DS                1
+#endif
+#ifndef STN_OLED
+#define STN_OLED              32
+#endif
+
+// Drivers the build needs
+#define STN_BMP280            ((STN_BMX_1 == BMX_TYPE_BMP280) || (STN_BMX_2 == BMX_TYPE_BMP280))
+#define STN_BME280            ((STN_BMX_1 == BMX_TYPE_BME280) || (STN_BMX_2 == BMX_TYPE_BME280))
+#define STN_BM3               ((STN_BMX_1 == BMX_TYPE_BMP388) || (STN_BMX_2 == BMX_TYPE_BMP388) || \
+                               (STN_BMX_1 == BMX_TYPE_BMP390) || (STN_BMX_2 == BMX_TYPE_BMP390))
+#define STN_MCP               (STN_MCP_1 || STN_MCP_2)
+#define STN_BMX_TYPE(slot)    ((slot) ? STN_BMX_2 : STN_BMX_1)
+
+#else
+#define STN_BMP280            1
+#define STN_BME280            1
+#define STN_BM3               1
+#define STN_MCP               1
+#define STN_MCP_1             1
+#define STN_MCP_2             1
+#define STN_DS                1
+#endif
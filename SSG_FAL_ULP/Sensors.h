@@ -19,29 +19,40 @@
  *  https://forecast.weather.gov/product.php?issuedby=BOU&product=OSO&site=bou 
  * ======================================================================================================================
  */
-#define BMX_STATION_ELEVATION 1017.272  // default 1013.25
 #define BMX_ADDRESS_1         0x77        // BMP Default Address - Connecting SDO to GND will change BMP to 0x76
 #define BMX_ADDRESS_2         0x76        // BME Default Address - Connecting SDO to GND will change BME to 0x77
 #define BMP280_CHIP_ID        0x58
 #define BME280_BMP390_CHIP_ID 0x60
 #define BMP388_CHIP_ID        0x50
-#define BMX_TYPE_UNKNOWN      0
-#define BMX_TYPE_BMP280       1
-#define BMX_TYPE_BME280       2
-#define BMX_TYPE_BMP388       3
-#define BMX_TYPE_BMP390       4
+#define BMX_CHIP_VALID(id)    (((id) == BMP280_CHIP_ID) || ((id) == BME280_BMP390_CHIP_ID) || ((id) == BMP388_CHIP_ID))
+#define BMX_TYPE_CHIP(t)      (((t) == BMX_TYPE_BMP280) ? BMP280_CHIP_ID : ((t) == BMX_TYPE_BMP388) ? BMP388_CHIP_ID : \
+                               ((t) != BMX_TYPE_UNKNOWN) ? BME280_BMP390_CHIP_ID : 0)
+// BMX_TYPE_* are in ST.h
+#if STN_FIXED
+#define BMX_SLOT_TYPE(slot)   STN_BMX_TYPE(slot)  // Known at build, the branches for other types fold away
+#else
+#define BMX_SLOT_TYPE(slot)   ((slot) ? BMX_2_type : BMX_1_type)
+#endif
+#if STN_BMP280
 Adafruit_BMP280 bmp1;
 Adafruit_BMP280 bmp2;
+#endif
+#if STN_BME280
 Adafruit_BME280 bme1;
 Adafruit_BME280 bme2;
+#endif
+#if STN_BM3
 Adafruit_BMP3XX bm31;
 Adafruit_BMP3XX bm32;
+#endif
 byte BMX_1_chip_id = 0x00;
 byte BMX_2_chip_id = 0x00;
 bool BMX_1_exists = false;
 bool BMX_2_exists = false;
 byte BMX_1_type=BMX_TYPE_UNKNOWN;
 byte BMX_2_type=BMX_TYPE_UNKNOWN;
+int  bmx_osr = 1;              // Oversampling in use, cf_bmx_osr unless a power profile lowers it
+bool bmx_normal[2] = {false, false};  // Normal mode at bmx_odr, the data registers hold the filtered conversion
 
 /*
  * ======================================================================================================================
@@ -54,11 +65,16 @@ byte BMX_2_type=BMX_TYPE_UNKNOWN;
  */
 #define MCP_ADDRESS_1     0x18
 #define MCP_ADDRESS_2     0x19        // A0 set high, VDD
+#if STN_MCP
 Adafruit_MCP9808 mcp1;
 Adafruit_MCP9808 mcp2;
+#endif
 bool MCP_1_exists = false;
 bool MCP_2_exists = false;
 
+// Conversion time by resolution 0.5, 0.25, 0.125, 0.0625 C
+const unsigned int mcp_convert_ms[4] = {30, 65, 130, 250};
+
 /* 
  *=======================================================================================================================
  * get_Bosch_ChipID ()  -  Return what Bosch chip is at specified address
@@ -69,232 +85,507 @@ bool MCP_2_exists = false;
  *=======================================================================================================================
  */
 byte get_Bosch_ChipID (byte address) {
-  byte chip_id = 0;
-  byte error;
-
-  Output ("get_Bosch_ChipID()");
-  // The i2c_scanner uses the return value of
-  // the Write.endTransmisstion to see if
-  // a device did acknowledge to the address.
+  byte chip_id;
 
   // Important! Need to check the 0x00 register first. Doing a 0x0D (not chip id loaction) on a bmp388 
   // will return a value that could match one of the IDs 
+  chip_id = I2C_ReadReg(address, 0x00);    // BM3 CHIPID REGISTER
+  if (!BMX_CHIP_VALID(chip_id)) {
+    chip_id = I2C_ReadReg(address, 0xD0);  // BM2 CHIPID REGISTER
+  }
+  return ((BMX_CHIP_VALID(chip_id)) ? chip_id : 0);
+}
 
-  // Check Register 0x00
-  sprintf (msgbuf, "  I2C:%02X Reg:%02X", address, 0x00);
-  Output (msgbuf);
-  Wire.begin();
-  Wire.beginTransmission(address);
-  Wire.write(0x00);  // BM3 CHIPID REGISTER
-  error = Wire.endTransmission();
-    //  0:success
-    //  1:data too long to fit in transmit buffer
-    //  2:received NACK on transmit of address
-    //  3:received NACK on transmit of data
-    //  4:other error 
-  if (error) {
-    sprintf (msgbuf, "  ERR_ET:%d", error);
-    Output (msgbuf);
-  }
-  else if (Wire.requestFrom(address, 1)) {  // Returns the number of bytes returned from the slave device 
-    chip_id = Wire.read();
-    if (chip_id == BMP280_CHIP_ID) { // 0x58
-      sprintf (msgbuf, "  CHIPID:%02X BMP280", chip_id);
-      Output (msgbuf);
-      return (chip_id); // Found a Sensor!
-    }
-    else if (chip_id == BMP388_CHIP_ID) {
-      sprintf (msgbuf, "  CHIPID:%02X BMP388", chip_id);
-      Output (msgbuf);
-      return (chip_id); // Found a Sensor!   
-    }
-    else if (chip_id == BME280_BMP390_CHIP_ID) {  // 0x60
-      sprintf (msgbuf, "  CHIPID:%02X BME/390", chip_id);
-      Output (msgbuf);
-      return (chip_id); // Found a Sensor!   
-    }
-    else {
-      sprintf (msgbuf, "  CHIPID:%02X InValid", chip_id);
-      Output (msgbuf);      
-    }
+/* 
+ *=======================================================================================================================
+ * bmx_probe() - Chip ID of the Bosch sensor found in slot, a fixed build knows it without asking
+ *=======================================================================================================================
+ */
+byte bmx_probe(int slot) {
+#if STN_FIXED
+  return (BMX_TYPE_CHIP(STN_BMX_TYPE(slot)));
+#else
+  return (get_Bosch_ChipID((slot) ? BMX_ADDRESS_2 : BMX_ADDRESS_1));
+#endif
+}
+
+/* 
+ *=======================================================================================================================
+ * bmx_osr_code() - Oversampling or filter coefficient (0,1,2,4,8,16) to the register code 0-5 both drivers use
+ *=======================================================================================================================
+ */
+int bmx_osr_code(int v) {
+  int code = 0;
+
+  while (v > 0) {
+    code++;
+    v >>= 1;
   }
-  else {
-    sprintf (msgbuf, "  ERR_RF:0");
-    Output (msgbuf);
+  return (code);  // 0 -> 0, 1 -> 1, 2 -> 2, 4 -> 3, 8 -> 4, 16 -> 5
+}
+
+/* 
+ *=======================================================================================================================
+ * bmx_configure() - Put a BMP280/BME280 in forced mode, it sleeps until bmx_sn_start() starts a conversion, or with
+ *   bmx_odr in normal mode with the longest standby up to bmx_odr seconds, its first conversion starts at once
+ *=======================================================================================================================
+ */
+void bmx_configure(int slot) {
+  byte type = BMX_SLOT_TYPE(slot);
+  int osr = bmx_osr_code(bmx_osr);
+  int filter = bmx_osr_code(cf_bmx_filter) - 1;  // Filter codes start at X2
+  int sb = bmx_osr_code(cf_bmx_odr) + 4;         // Standby codes 5, 6, 7 are 1s, 2s, 4s
+
+  filter = (filter < 0) ? 0 : filter;
+  sb = (sb > 7) ? 7 : sb;
+#if STN_BMP280
+  if (type == BMX_TYPE_BMP280) {
+    bmx_normal[slot] = (cf_bmx_odr > 0);
+    ((slot) ? &bmp2 : &bmp1)->setSampling(
+      (bmx_normal[slot]) ? Adafruit_BMP280::MODE_NORMAL : Adafruit_BMP280::MODE_FORCED,
+      (Adafruit_BMP280::sensor_sampling) osr,                // Temperature
+      (Adafruit_BMP280::sensor_sampling) osr,                // Pressure
+      (Adafruit_BMP280::sensor_filter) filter,
+      (bmx_normal[slot]) ? (Adafruit_BMP280::standby_duration) sb : Adafruit_BMP280::STANDBY_MS_1);
   }
+#endif
+#if STN_BME280
+  if (type == BMX_TYPE_BME280) {
+    bmx_normal[slot] = (cf_bmx_odr > 0);
+    ((slot) ? &bme2 : &bme1)->setSampling(
+      (bmx_normal[slot]) ? Adafruit_BME280::MODE_NORMAL : Adafruit_BME280::MODE_FORCED,
+      (Adafruit_BME280::sensor_sampling) osr,                // Temperature
+      (Adafruit_BME280::sensor_sampling) osr,                // Pressure
+      (Adafruit_BME280::sensor_sampling) osr,                // Humidity
+      (Adafruit_BME280::sensor_filter) filter,
+      (bmx_normal[slot]) ? Adafruit_BME280::STANDBY_MS_1000 : Adafruit_BME280::STANDBY_MS_0_5);
+  }
+#endif
+}
 
-  // Check Register 0xD0
-  chip_id = 0;
-  sprintf (msgbuf, "  I2C:%02X Reg:%02X", address, 0xD0);
-  Output (msgbuf);
-  Wire.begin();
-  Wire.beginTransmission(address);
-  Wire.write(0xD0);  // BM2 CHIPID REGISTER
-  error = Wire.endTransmission();
-    //  0:success
-    //  1:data too long to fit in transmit buffer
-    //  2:received NACK on transmit of address
-    //  3:received NACK on transmit of data
-    //  4:other error 
-  if (error) {
-    sprintf (msgbuf, "  ERR_ET:%d", error);
-    Output (msgbuf);
-  }
-  else if (Wire.requestFrom(address, 1)) {  // Returns the number of bytes returned from the slave device 
-    chip_id = Wire.read(); 
-    if (chip_id == BMP280_CHIP_ID) {  // 0x58
-      sprintf (msgbuf, "  CHIPID:%02X BMP280", chip_id);
-      Output (msgbuf);
-      return (chip_id); // Found a Sensor!
+/*
+ * ======================================================================================================================
+ *  BMP388/BMP390 Pressure Series - With bmx_fifo set the sensor runs in normal mode between observations and queues
+ *    every conversion in its 512 byte FIFO while the M0 sleeps. The data rate is the fastest that keeps one
+ *    observation interval within BM3_FIFO_FRAMES frames, e.g. one every 20.48s at 15m. OBS_Do() drains the FIFO in
+ *    one burst read and logs the mean, min and max pressure of the interval, bp1 and bt1 are the last conversion.
+ * ======================================================================================================================
+ */
+#define BM3_FIFO_FRAMES       64    // Pressure and temperature frames are 7 bytes, 73 fit
+#define BM3_ODR_MAX           17    // BMP3_ODR_0_001_HZ, 200Hz / 2^17
+
+#if STN_BM3
+uint8_t bm3_fifo_buf[BMP3_FIFO_BYTES];  // Shared, the slots are drained one at a time
+#endif
+bool bm3_fifo_on[2] = {false, false};
+int32_t bm3_fifo_avg[2];            // hPa, FIX_ONE units
+int32_t bm3_fifo_min[2];
+int32_t bm3_fifo_max[2];
+uint16_t bm3_fifo_n[2];             // Frames in the last drain
+
+/* 
+ *=======================================================================================================================
+ * bm3_configure() - IIR filter of a BMP388/BMP390, start or stop its FIFO for bmx_fifo and the observation interval
+ *   in use, or its normal mode at the slowest data rate with conversions no more than bmx_odr seconds apart
+ *=======================================================================================================================
+ */
+void bm3_configure(int slot) {
+#if STN_BM3
+  byte type = BMX_SLOT_TYPE(slot);
+  Adafruit_BMP3XX *bm3 = (slot) ? &bm32 : &bm31;
+  int filter = bmx_osr_code(cf_bmx_filter) - 1;  // Coefficient 1, 3, 7, 15, the same X2 to X16 step response
+  int odr;
+
+  if ((type != BMX_TYPE_BMP388) && (type != BMX_TYPE_BMP390)) {
+    return;
+  }
+  bm3->setIIRFilterCoeff((filter < 0) ? BMP3_IIR_FILTER_DISABLE : filter);
+  if (cf_bmx_fifo) {
+    for (odr=0; odr<BM3_ODR_MAX; odr++) {
+      if (((obs_interval_s * 200) >> odr) <= BM3_FIFO_FRAMES) {
+        break;
+      }
+    }
+    bm3_fifo_on[slot] = bm3->startFifo(odr);
+    bm3_fifo_n[slot] = 0;
+    bmx_normal[slot] = false;
+    LOG_INFO ("BM3%d FIFO %lums %s", slot+1, 5UL << odr, (bm3_fifo_on[slot]) ? "OK" : "ERR");
+  }
+  else if (cf_bmx_odr > 0) {
+    for (odr=0; odr<BM3_ODR_MAX; odr++) {
+      if ((5UL << (odr + 1)) > (unsigned long) cf_bmx_odr * 1000) {
+        break;
+      }
     }
-    else if (chip_id == BMP388_CHIP_ID) {  // 0x50
-      sprintf (msgbuf, "  CHIPID:%02X BMP388", chip_id);
-      Output (msgbuf);
-      return (chip_id); // Found a Sensor!   
+    bmx_normal[slot] = bm3->startNormal(odr);
+    LOG_INFO ("BM3%d ODR %lums %s", slot+1, 5UL << odr, (bmx_normal[slot]) ? "OK" : "ERR");
+  }
+  else {
+    if (bm3_fifo_on[slot]) {
+      bm3->stopFifo();
+      bm3_fifo_on[slot] = false;
     }
-    else if (chip_id == BME280_BMP390_CHIP_ID) {  // 0x60
-      sprintf (msgbuf, "  CHIPID:%02X BME/390", chip_id);
-      Output (msgbuf);
-      return (chip_id); // Found a Sensor!   
+    if (bmx_normal[slot]) {
+      bm3->stopNormal();
+      bmx_normal[slot] = false;
     }
-    else {
-      sprintf (msgbuf, "  CHIPID:%02X InValid", chip_id);
-      Output (msgbuf);   
+  }
+#endif
+}
+
+/* 
+ *=======================================================================================================================
+ * bm3_fifo_drain() - Read the FIFO of a slot, keep the statistics of the frames that pass QC
+ *=======================================================================================================================
+ */
+#if STN_BM3
+void bm3_fifo_drain(int slot) {
+  Adafruit_BMP3XX *bm3 = (slot) ? &bm32 : &bm31;
+  int32_t t;
+  uint32_t p;
+  uint32_t sum = 0;                 // Pa*100, 73 frames of 1100hPa still fit
+  uint16_t n = 0;
+
+  bm3_fifo_min[slot] = INT32_MAX;
+  bm3_fifo_max[slot] = INT32_MIN;
+  if (bm3->readFifo(bm3_fifo_buf, sizeof(bm3_fifo_buf))) {
+    while (bm3->nextFifoFrame(&t, &p)) {
+      if (((int32_t) p < QC_FIX(QC_MIN_P)) || ((int32_t) p > QC_FIX(QC_MAX_P))) {
+        continue;
+      }
+      sum += p;
+      n++;
+      bm3_fifo_min[slot] = ((int32_t) p < bm3_fifo_min[slot]) ? (int32_t) p : bm3_fifo_min[slot];
+      bm3_fifo_max[slot] = ((int32_t) p > bm3_fifo_max[slot]) ? (int32_t) p : bm3_fifo_max[slot];
     }
   }
+  bm3_fifo_n[slot] = n;
+  if (n) {
+    bm3_fifo_avg[slot] = (int32_t) ((sum + (n / 2)) / n);
+  }
   else {
-    sprintf (msgbuf, "  ERR_RF:0");
-    Output (msgbuf);
+    bm3_fifo_avg[slot] = bm3_fifo_min[slot] = bm3_fifo_max[slot] = QC_FIX(QC_ERR_P);
   }
-  return(0);
 }
+#endif
+
+/*
+ * ======================================================================================================================
+ *  Bosch Sensor State - A sensor that is online costs no bus traffic in I2C_Check_Sensors(). A failed read in
+ *    OBS_Do() marks it BMX_ST_CHECK and the next check reads its chip ID. An offline sensor is re-probed with a
+ *    backoff that doubles each miss up to BMX_BACKOFF_MAX checks. When it answers with the chip ID it had, the driver
+ *    of its slot (its address) still holds the calibration read by begin(), so bmx_reattach() sets its sampling up
+ *    again and nothing more: a BMP280/BME280 has its config registers written, a BMP388/390 has its chip ID read
+ *    once more and its FIFO or normal mode restarted. A few bytes on the bus in place of a reset and the calibration
+ *    block. A different chip ID is a new sensor and gets a full begin().
+ * ======================================================================================================================
+ */
+#define BMX_ST_OK             0     // Online, nothing to do
+#define BMX_ST_CHECK          1     // Read failed, probe at the next check
+#define BMX_ST_OFFLINE        2     // Not answering, probe on backoff
+
+#define BMX_BACKOFF_MAX       64    // Checks between probes of an offline sensor, at most
+
+typedef struct {
+  byte state;
+  byte backoff;                     // Checks to skip after the next miss
+  byte wait;                        // Checks left before the next probe
+  bool begun;                       // Driver begin() done, calibration held by the driver
+} BMX_STATE;
+
+BMX_STATE bmx_state[2] = {{BMX_ST_OFFLINE, 1, 0, false}, {BMX_ST_OFFLINE, 1, 0, false}};
 
 /* 
  *=======================================================================================================================
- * bmx_initialize() - Bosch sensor initialize
+ * bmx_begin() - Begin the driver that matches the chip ID in slot 0 or 1, report and set the sensor state
  *=======================================================================================================================
  */
-void bmx_initialize() {
-  Output("BMX:INIT");
-  
-  // 1st Bosch Sensor - Need to see which (BMP, BME, BM3) is plugged in
-  BMX_1_chip_id = get_Bosch_ChipID(BMX_ADDRESS_1);
+bool bmx_begin(int slot) {
+  int n = slot + 1;
+  byte address      = (slot) ? BMX_ADDRESS_2 : BMX_ADDRESS_1;
+  byte chip_id      = (slot) ? BMX_2_chip_id : BMX_1_chip_id;
+  byte *type        = (slot) ? &BMX_2_type : &BMX_1_type;
+  bool *exists      = (slot) ? &BMX_2_exists : &BMX_1_exists;
+  unsigned int ssb  = (slot) ? SSB_BMX_2 : SSB_BMX_1;
+  float p;
 
-  switch (BMX_1_chip_id) {
+  *exists = false;
+  switch (chip_id) {
+#if STN_BMP280
     case BMP280_CHIP_ID :
-      if (!bmp1.begin(BMX_ADDRESS_1)) { 
-        msgp = (char *) "BMP1 ERR";
-        BMX_1_exists = false;
-        SystemStatusBits |= SSB_BMX_1;  // Turn On Bit          
+      if (!((slot) ? &bmp2 : &bmp1)->begin(address)) { 
+        sprintf (msgbuf, "BMP%d ERR", n);
       }
       else {
-        BMX_1_exists = true;
-        BMX_1_type = BMX_TYPE_BMP280;
-        msgp = (char *) "BMP1 OK";
-        float p = bmp1.readPressure();
+        *exists = true;
+        *type = BMX_TYPE_BMP280;
+        sprintf (msgbuf, "BMP%d OK", n);
+        p = ((slot) ? &bmp2 : &bmp1)->readPressure();
       }
     break;
+#endif
 
+#if STN_BME280 || STN_BM3
     case BME280_BMP390_CHIP_ID :
-      if (!bme1.begin(BMX_ADDRESS_1)) { 
-        if (!bm31.begin_I2C(BMX_ADDRESS_1)) {  // Perhaps it is a BMP390
-          msgp = (char *) "BMX1 ERR";
-          BMX_1_exists = false;
-          SystemStatusBits |= SSB_BMX_1;  // Turn On Bit          
-        }
-        else {
-          BMX_1_exists = true;
-          BMX_1_type = BMX_TYPE_BMP390;
-          msgp = (char *) "BMP390_1 OK"; 
-          float p = bm31.readPressure();       
-        }      
+      sprintf (msgbuf, "BMX%d ERR", n);
+#if STN_BME280
+      if ((!STN_FIXED || (BMX_SLOT_TYPE(slot) == BMX_TYPE_BME280)) && ((slot) ? &bme2 : &bme1)->begin(address)) {
+        *exists = true;
+        *type = BMX_TYPE_BME280;
+        sprintf (msgbuf, "BME280_%d OK", n);
+        p = ((slot) ? &bme2 : &bme1)->readPressure();
+        break;
       }
-      else {
-        BMX_1_exists = true;
-        BMX_1_type = BMX_TYPE_BME280;
-        msgp = (char *) "BME280_1 OK";
-        float p = bme1.readPressure();
+#endif
+#if STN_BM3
+      if ((!STN_FIXED || (BMX_SLOT_TYPE(slot) == BMX_TYPE_BMP390)) && ((slot) ? &bm32 : &bm31)->begin_I2C(address)) {
+        *exists = true;                  // Perhaps it is a BMP390
+        *type = BMX_TYPE_BMP390;
+        sprintf (msgbuf, "BMP390_%d OK", n);
+        p = ((slot) ? &bm32 : &bm31)->readPressure();
       }
+#endif
     break;
+#endif
 
+#if STN_BM3
     case BMP388_CHIP_ID :
-      if (!bm31.begin_I2C(BMX_ADDRESS_1)) { 
-        msgp = (char *) "BM31 ERR";
-        BMX_1_exists = false;
-        SystemStatusBits |= SSB_BMX_1;  // Turn On Bit          
+      if (!((slot) ? &bm32 : &bm31)->begin_I2C(address)) { 
+        sprintf (msgbuf, "BM3%d ERR", n);
       }
       else {
-        BMX_1_exists = true;
-        BMX_1_type = BMX_TYPE_BMP388;
-        msgp = (char *) "BM31 OK";
-        float p = bm31.readPressure();
+        *exists = true;
+        *type = BMX_TYPE_BMP388;
+        sprintf (msgbuf, "BM3%d OK", n);
+        p = ((slot) ? &bm32 : &bm31)->readPressure();
       }
     break;
+#endif
 
     default:
-      msgp = (char *) "BMX_1 NF";
+      sprintf (msgbuf, "BMX_%d NF", n);
     break;
   }
-  Output (msgp);
+  Output (msgbuf);
+  I2C_Restore();  // Driver begin() left the bus at 100kHz
 
-  // 2nd Bosch Sensor - Need to see which (BMP, BME, BM3) is plugged in
-  BMX_2_chip_id = get_Bosch_ChipID(BMX_ADDRESS_2);
-  switch (BMX_2_chip_id) {
-    case BMP280_CHIP_ID :
-      if (!bmp2.begin(BMX_ADDRESS_2)) { 
-        msgp = (char *) "BMP2 ERR";
-        BMX_2_exists = false;
-        SystemStatusBits |= SSB_BMX_2;  // Turn On Bit          
-      }
-      else {
-        BMX_2_exists = true;
-        BMX_2_type = BMX_TYPE_BMP280;
-        msgp = (char *) "BMP2 OK";
-        float p = bmp2.readPressure();
-      }
-    break;
+  if (*exists) {
+    bmx_configure(slot);
+    bm3_configure(slot);
+    bmx_state[slot].state = BMX_ST_OK;
+    bmx_state[slot].backoff = 1;
+    bmx_state[slot].begun = true;
+    SystemStatusBits &= ~ssb; // Turn Off Bit
+  }
+  else {
+    if (chip_id) {
+      SystemStatusBits |= ssb;  // Turn On Bit, a chip answered but its driver did not start
+    }
+    bmx_state[slot].state = BMX_ST_OFFLINE;
+    bmx_state[slot].wait = 0;
+  }
+  return (*exists);
+}
 
-    case BME280_BMP390_CHIP_ID :
-      if (!bme2.begin(BMX_ADDRESS_2)) { 
-        if (!bm32.begin_I2C(BMX_ADDRESS_2)) {  // Perhaps it is a BMP390
-          msgp = (char *) "BMX2 ERR";
-          BMX_2_exists = false;
-          SystemStatusBits |= SSB_BMX_2;  // Turn On Bit          
-        }
-        else {
-          BMX_2_exists = true;
-          BMX_2_type = BMX_TYPE_BMP390;
-          msgp = (char *) "BMP390_2 OK"; 
-          float p = bm32.readPressure();         
-        }
-      }
-      else {
-        BMX_2_exists = true;
-        BMX_2_type = BMX_TYPE_BME280;
-        msgp = (char *) "BME280_2 OK";
-        float p = bme2.readPressure();
-      }
-    break;
+/*
+ * ======================================================================================================================
+ * bmx_reattach() - A sensor begun before is back with the same chip ID, set it up on the calibration its driver holds
+ * ======================================================================================================================
+ */
+bool bmx_reattach(int slot, byte type) {
+  switch (type) {
+    case BMX_TYPE_BMP280 :
+    case BMX_TYPE_BME280 :
+      bmx_configure(slot);
+      return (true);
 
-    case BMP388_CHIP_ID :
-      if (!bm32.begin_I2C(BMX_ADDRESS_2)) { 
-        msgp = (char *) "BM32 ERR";
-        BMX_2_exists = false;
-        SystemStatusBits |= SSB_BMX_2;  // Turn On Bit          
-      }
-      else {
-        BMX_2_exists = true;
-        BMX_2_type = BMX_TYPE_BMP388;
-        msgp = (char *) "BM32 OK";
-        float p = bm32.readPressure();
+#if STN_BM3
+    case BMX_TYPE_BMP388 :
+    case BMX_TYPE_BMP390 :
+      if (!((slot) ? &bm32 : &bm31)->reattach()) {
+        return (false);
       }
-    break;
+      bm3_configure(slot);  // FIFO or normal mode started again, they were lost with the power
+      return (true);
+#endif
 
     default:
-      msgp = (char *) "BMX_2 NF";
-    break;
+      return (false);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * bmx_suspect() - A read from the sensor in slot failed, have the next I2C_Check_Sensors() look at it
+ * ======================================================================================================================
+ */
+void bmx_suspect(int slot) {
+  if (bmx_state[slot].state == BMX_ST_OK) {
+    bmx_state[slot].state = BMX_ST_CHECK;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * bmx_backoff() - Skip the next backoff checks, double the backoff for the miss after that
+ * ======================================================================================================================
+ */
+void bmx_backoff(BMX_STATE *st) {
+  st->wait = st->backoff;
+  st->backoff = (st->backoff >= (BMX_BACKOFF_MAX/2)) ? BMX_BACKOFF_MAX : st->backoff*2;
+}
+
+/*
+ * ======================================================================================================================
+ * bmx_check() - Probe a suspect or offline sensor, bring it back with as little as its chip type needs
+ * ======================================================================================================================
+ */
+void bmx_check(int slot) {
+  int n = slot + 1;
+  BMX_STATE *st     = &bmx_state[slot];
+  byte address      = (slot) ? BMX_ADDRESS_2 : BMX_ADDRESS_1;
+  byte *chip_id     = (slot) ? &BMX_2_chip_id : &BMX_1_chip_id;
+  byte type         = (slot) ? BMX_2_type : BMX_1_type;
+  bool *exists      = (slot) ? &BMX_2_exists : &BMX_1_exists;
+  unsigned int ssb  = (slot) ? SSB_BMX_2 : SSB_BMX_1;
+  byte id;
+  bool present;
+
+  if (st->state == BMX_ST_OK) {
+    return;  // Healthy, no bus traffic
+  }
+  if ((st->state == BMX_ST_OFFLINE) && st->wait) {
+    st->wait--;
+    return;
+  }
+
+  if (*chip_id) {
+    // BMP388/390 keep the chip ID in register 0x00, the BMP280/BME280 in 0xD0
+    id = I2C_ReadReg(address, ((type == BMX_TYPE_BMP388) || (type == BMX_TYPE_BMP390)) ? 0x00 : 0xD0);
+    present = (id != 0);
+  }
+  else {
+    id = 0;
+    present = I2C_Device_Exist (address);  // Never found, is anything there now
+  }
+
+  if (!present) {
+    if (*exists) {
+      *exists = false;
+      ev_note (EV_BMX_OFFLINE, n);
+      SystemStatusBits |= ssb;  // Turn On Bit 
+    }
+    st->state = BMX_ST_OFFLINE;
+    bmx_backoff(st);
+    return;
+  }
+
+  if (id && (id == *chip_id)) {
+    if (*exists) {
+      st->state = BMX_ST_OK;  // Still there, the failed read was a one off
+      return;
+    }
+    if (st->begun && bmx_reattach(slot, type)) {
+      // Power cycled, the driver still has the calibration, only the sampling setup was lost
+      *exists = true;
+      st->state = BMX_ST_OK;
+      st->backoff = 1;
+      SystemStatusBits &= ~ssb; // Turn Off Bit
+      ev_note (EV_BMX_ONLINE, n);
+      return;
+    }
+  }
+  else {
+    // Not the chip we had, or none known. Find out what it is
+    *chip_id = bmx_probe(slot);
+    st->begun = false;
+  }
+
+  if (*chip_id && bmx_begin(slot)) {
+    ev_note (EV_BMX_ONLINE, n);
+  }
+  else {
+    st->state = BMX_ST_OFFLINE;
+    bmx_backoff(st);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Sea Level Pressure - With bmx_elev set the record has "slp1" and "slp2", each pressure reduced from the station
+ *    elevation in meters to sea level by the barometric formula the Bosch drivers' seaLevelForAltitude() use,
+ *    p / (1 - h/44330)^5.255. The factor only depends on the elevation, bmx_slp_initialize() works it out once with
+ *    pow() as a Q16 multiplier, so an observation takes one integer multiply per pressure.
+ * ======================================================================================================================
+ */
+uint32_t bmx_slp_q16 = 0;           // Sea level over station pressure * 65536, 0 = off
+
+/* 
+ *=======================================================================================================================
+ * bmx_slp_initialize() - Reduction factor for bmx_elev
+ *=======================================================================================================================
+ */
+void bmx_slp_initialize() {
+  if ((cf_bmx_elev < -500) || (cf_bmx_elev > 9000)) {
+    LOG_ERR ("BMX:ELEV %d ERR", cf_bmx_elev);
+    cf_bmx_elev = 0;
+  }
+  bmx_slp_q16 = (cf_bmx_elev) ? (uint32_t) (65536.0 / pow(1.0 - cf_bmx_elev / 44330.0, 5.255) + 0.5) : 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * bmx_slp() - Sea level pressure of a station pressure, FIX_ONE units
+ *=======================================================================================================================
+ */
+int32_t bmx_slp(int32_t p) {
+  return ((int32_t) (((int64_t) p * bmx_slp_q16 + 32768) >> 16));
+}
+
+/* 
+ *=======================================================================================================================
+ * bmx_cf_check() - Put bmx_osr, bmx_filter and bmx_odr back to their defaults when out of range, at boot and reload
+ *=======================================================================================================================
+ */
+void bmx_cf_check() {
+  if ((cf_bmx_osr != 1) && (cf_bmx_osr != 2) && (cf_bmx_osr != 4) && (cf_bmx_osr != 8) && (cf_bmx_osr != 16)) {
+    LOG_ERR ("BMX:OSR %d ERR", cf_bmx_osr);
+    cf_bmx_osr = 1;
+  }
+  if ((cf_bmx_filter != 0) && (cf_bmx_filter != 2) && (cf_bmx_filter != 4) && (cf_bmx_filter != 8) && 
+      (cf_bmx_filter != 16)) {
+    LOG_ERR ("BMX:FILTER %d ERR", cf_bmx_filter);
+    cf_bmx_filter = 0;
+  }
+  if ((cf_bmx_odr < 0) || (cf_bmx_odr > 655)) {
+    LOG_ERR ("BMX:ODR %d ERR", cf_bmx_odr);
+    cf_bmx_odr = 0;
   }
-  Output (msgp);
+}
+
+/* 
+ *=======================================================================================================================
+ * bmx_initialize() - Bosch sensor initialize
+ *=======================================================================================================================
+ */
+void bmx_initialize() {
+  Output("BMX:INIT");
+
+  bmx_cf_check();
+  bmx_osr = cf_bmx_osr;
+  
+#if !STN_FIXED || STN_BMX_1
+  // 1st Bosch Sensor - Need to see which (BMP, BME, BM3) is plugged in
+  BMX_1_chip_id = (I2C_Present(BMX_ADDRESS_1)) ? bmx_probe(0) : 0;
+  bmx_begin(0);
+#endif
+
+#if !STN_FIXED || STN_BMX_2
+  // 2nd Bosch Sensor - Need to see which (BMP, BME, BM3) is plugged in
+  BMX_2_chip_id = (I2C_Present(BMX_ADDRESS_2)) ? bmx_probe(1) : 0;
+  bmx_begin(1);
+#endif
+  bmx_slp_initialize();
 }
 
 /* 
@@ -302,99 +593,542 @@ void bmx_initialize() {
  * mcp9808_initialize() - MCP9808 sensor initialize
  *=======================================================================================================================
  */
+#if STN_MCP
+bool mcp_begin(Adafruit_MCP9808 *mcp, uint8_t addr) {
+  *mcp = Adafruit_MCP9808();
+  if (!mcp->begin(addr)) {
+    return (false);
+  }
+  mcp->setResolution(cf_mcp_res);
+  mcp->shutdown();  // Sleeps between observations, mcp_sn_start() wakes it for one conversion
+  return (true);
+}
+#endif
+
 void mcp9808_initialize() {
+#if STN_MCP
   Output("MCP9808:INIT");
+
+  if ((cf_mcp_res < 0) || (cf_mcp_res > 3)) {
+    LOG_ERR ("MCP RES %d ERR", cf_mcp_res);
+    cf_mcp_res = 3;
+  }
   
+#if STN_MCP_1
   // 1st MCP9808 Precision I2C Temperature Sensor (I2C ADDRESS = 0x18)
-  mcp1 = Adafruit_MCP9808();
-  if (!mcp1.begin(MCP_ADDRESS_1)) {
-    msgp = (char *) "MCP1 NF";
+  if (!I2C_Present(MCP_ADDRESS_1) || !mcp_begin(&mcp1, MCP_ADDRESS_1)) {
     MCP_1_exists = false;
     SystemStatusBits |= SSB_MCP_1;  // Turn On Bit
   }
   else {
     MCP_1_exists = true;
-    msgp = (char *) "MCP1 OK";
   }
-  Output (msgp);
+  Output ((MCP_1_exists) ? "MCP1 OK" : "MCP1 NF");
+#endif
+
+#if STN_MCP_2
+  // 2nd MCP9808 Precision I2C Temperature Sensor (I2C ADDRESS = 0x19)
+  if (!I2C_Present(MCP_ADDRESS_2) || !mcp_begin(&mcp2, MCP_ADDRESS_2)) {
+    MCP_2_exists = false;
+  }
+  else {
+    MCP_2_exists = true;
+  }
+  Output ((MCP_2_exists) ? "MCP2 OK" : "MCP2 NF");
+#endif
+#endif
 }
 
 /*
  * ======================================================================================================================
- * I2C_Check_Sensors() - See if each I2C sensor responds on the bus and take action accordingly             
+ *  Sensor Registry - One descriptor per sensor with a start()/ready()/read() interface. sn_start_all() starts every
+ *    conversion at once, sn_collect() waits for and reads one sensor, so conversions overlap with each other and with
+ *    the gauge sampling. An observation then takes the gauge window plus the reads, not the sum of the conversions.
+ *    read() leaves up to SN_VALUES raw values in FIX_ONE units, FIX_NAN when there is none, sn_collect() applies the
+ *    QC limits to them. Drivers are read with their integer compensation, no float from register to record.
+ *    Table order is the order values appear in the observation record.
  * ======================================================================================================================
  */
-void I2C_Check_Sensors() {
+#define SN_BMX            1         // BMP280, BME280, BMP388, BMP390 - pressure, temperature, humidity
+#define SN_MCP            2         // MCP9808 - temperature
+#define SN_DS             3         // DS18B20 probes, values are in ds_reading[]
 
-  // BMX_1 Barometric Pressure 
-  if (I2C_Device_Exist (BMX_ADDRESS_1)) {
-    // Sensor online but our state had it offline
-    if (BMX_1_exists == false) {
-      if (BMX_1_chip_id == BME280_BMP390_CHIP_ID) {
-        if (bmp1.begin(BMX_ADDRESS_1)) { 
-          BMX_1_exists = true;
-          Output ("BMP1 ONLINE");
-          SystemStatusBits &= ~SSB_BMX_1; // Turn Off Bit
-        } 
-      }
-      else if (BMX_1_chip_id == BME280_BMP390_CHIP_ID) {
-        if (bme1.begin(BMX_ADDRESS_1)) { 
-          BMX_1_exists = true;
-          Output ("BME1 ONLINE");
-          SystemStatusBits &= ~SSB_BMX_1; // Turn Off Bit
-        }          
+#define SN_VALUES         3
+#define SN_TIMEOUT_MS     100       // Longest a Bosch conversion is waited for
+
+#define SN_BMX_1          0         // Index in sn_table[]
+#define SN_BMX_2          1
+#define SN_MCP_1          2
+#define SN_MCP_2          3
+#define SN_DS_1           4
+#define SN_COUNT          5
+
+typedef struct SENSOR SENSOR;
+struct SENSOR {
+  byte kind;                        // SN_*
+  byte slot;                        // Bosch slot 0/1
+  bool *exists;
+  void (*start)(SENSOR *s);
+  bool (*ready)(SENSOR *s);
+  void (*read)(SENSOR *s);
+  byte nvalues;
+  unsigned int wait_ms;             // Longest sn_collect() waits for ready() after start
+  const char *key[SN_VALUES];       // Observation record keys
+  byte digits[SN_VALUES];           // Fraction digits in the record
+  byte qc[SN_VALUES];               // QC_P, QC_T or QC_RH of each value
+  int32_t raw[SN_VALUES];           // As read
+  int32_t value[SN_VALUES];         // After QC
+  uint8_t qc_flags;                 // QC_* code of each value, QC_BITS each from bit 0
+  unsigned long start_ms;
+  uint16_t errors;                  // Failed reads since boot, I2C sensors are in the record's i2c
+  bool skipped;                     // Not started or read this observation, Sensor Cadence and Bosch Fusion
+  bool taken;                       // Read between gauge samples this observation, sn_gap()
+};
+
+/* 
+ *=======================================================================================================================
+ * bmx_sn_start(), bmx_sn_ready(), bmx_sn_read() - Bosch sensor, forced conversion, normal mode or the FIFO series
+ *=======================================================================================================================
+ */
+void bmx_sn_start(SENSOR *s) {
+  byte type = BMX_SLOT_TYPE(s->slot);
+
+  if (bmx_normal[s->slot]) {
+    return;  // Converting on its own at bmx_odr
+  }
+
+#if STN_BMP280
+  if (type == BMX_TYPE_BMP280) {
+    ((s->slot) ? &bmp2 : &bmp1)->startForcedMeasurement();
+  }
+#endif
+#if STN_BME280
+  if (type == BMX_TYPE_BME280) {
+    ((s->slot) ? &bme2 : &bme1)->startForcedMeasurement();
+  }
+#endif
+#if STN_BM3
+  if (((type == BMX_TYPE_BMP388) || (type == BMX_TYPE_BMP390)) && !bm3_fifo_on[s->slot]) {
+    ((s->slot) ? &bm32 : &bm31)->startReading();
+  }
+#endif
+}
+
+bool bmx_sn_ready(SENSOR *s) {
+  byte type = BMX_SLOT_TYPE(s->slot);
+
+  if (bmx_normal[s->slot]) {
+    return (true);  // The data registers hold the last filtered conversion
+  }
+
+#if STN_BMP280
+  if (type == BMX_TYPE_BMP280) {
+    return (!((s->slot) ? &bmp2 : &bmp1)->measuring());
+  }
+#endif
+#if STN_BME280
+  if (type == BMX_TYPE_BME280) {
+    return (!((s->slot) ? &bme2 : &bme1)->measuring());
+  }
+#endif
+#if STN_BM3
+  if (bm3_fifo_on[s->slot]) {
+    return (true);  // Normal mode, the data registers hold the last conversion
+  }
+  return (((s->slot) ? &bm32 : &bm31)->readingReady());
+#else
+  return (true);
+#endif
+}
+
+void bmx_sn_read(SENSOR *s) {
+  byte type = BMX_SLOT_TYPE(s->slot);
+  int32_t t;
+  uint32_t p, h;
+
+  s->raw[0] = s->raw[1] = FIX_NAN;
+  s->raw[2] = 0;                                        // Only the BME280 has humidity
+#if STN_BMP280
+  if (type == BMX_TYPE_BMP280) {
+    Adafruit_BMP280 *bmp = (s->slot) ? &bmp2 : &bmp1;
+    s->raw[1] = bmp->readTemperatureFixed() * 100;      // C, C*100
+    p = bmp->readPressureFixed();
+    s->raw[0] = (int32_t) ((p * 25) / 64);              // hPa, Pa*256 * 100/256
+  }
+#endif
+#if STN_BME280
+  if (type == BMX_TYPE_BME280) {
+    if (((s->slot) ? &bme2 : &bme1)->readAllFixed(&t, &p, &h)) {  // One burst read
+      s->raw[0] = (int32_t) ((p * 25) / 64);            // hPa, Pa*256 * 100/256
+      s->raw[1] = t * 100;                              // C, C*100
+      s->raw[2] = (int32_t) ((h * 625) / 64);           // %, %*1024 * 10000/1024
+    }
+    else {
+      s->raw[2] = FIX_NAN;
+    }
+  }
+#endif
+#if STN_BM3
+  if ((type == BMX_TYPE_BMP388) || (type == BMX_TYPE_BMP390)) {
+    Adafruit_BMP3XX *bm3 = (s->slot) ? &bm32 : &bm31;
+    if (bm3->readData()) {
+      s->raw[0] = (int32_t) bm3->pressure100;           // hPa, Pa*100 is hPa*10000
+      s->raw[1] = bm3->temperature100 * 100;            // C, C*100
+      if (bm3_fifo_on[s->slot]) {
+        bm3_fifo_drain(s->slot);
       }
-      else {
-        if (bm31.begin_I2C(BMX_ADDRESS_1)) { 
-          BMX_1_exists = true;
-          Output ("BM31 ONLINE");
-          SystemStatusBits &= ~SSB_BMX_1; // Turn Off Bit
-        }                  
-      }      
     }
   }
+#endif
+}
+
+/* 
+ *=======================================================================================================================
+ * mcp_sn_start(), mcp_sn_ready(), mcp_sn_read() - MCP9808 has no one-shot mode, it is woken from shutdown, left to
+ *   finish a conversion and shut down again once read. There is no conversion done flag so ready() is timed.
+ *   A build without the driver keeps them empty, MCP_1_exists and MCP_2_exists stay false.
+ *=======================================================================================================================
+ */
+#if STN_MCP
+void mcp_sn_start(SENSOR *s) {
+  ((s->slot) ? &mcp2 : &mcp1)->shutdown_wake(false);  // Not wake(), that blocks for 260ms
+}
+
+bool mcp_sn_ready(SENSOR *s) {
+  return ((millis() - s->start_ms) >= mcp_convert_ms[cf_mcp_res]);
+}
+
+void mcp_sn_read(SENSOR *s) {
+  Adafruit_MCP9808 *mcp = (s->slot) ? &mcp2 : &mcp1;
+  uint16_t t = mcp->read16(MCP9808_REG_AMBIENT_TEMP);
+  int32_t c16 = t & 0x0FFF;                             // 1/16 C, 13bit two's complement
+
+  if (t == 0xFFFF) {
+    s->raw[0] = FIX_NAN;
+  }
   else {
-    // Sensor offline but our state has it online
-    if (BMX_1_exists == true) {
-      BMX_1_exists = false;
-      Output ("BMX1 OFFLINE");
-      SystemStatusBits |= SSB_BMX_1;  // Turn On Bit 
-    }    
-  }
-
-  // BMX_2 Barometric Pressure 
-  if (I2C_Device_Exist (BMX_ADDRESS_2)) {
-    // Sensor online but our state had it offline
-    if (BMX_2_exists == false) {
-      if (BMX_2_chip_id == BME280_BMP390_CHIP_ID) {
-        if (bmp2.begin(BMX_ADDRESS_2)) { 
-          BMX_2_exists = true;
-          Output ("BMP2 ONLINE");
-          SystemStatusBits &= ~SSB_BMX_2; // Turn Off Bit
-        } 
+    if (t & 0x1000) {
+      c16 -= 4096;
+    }
+    s->raw[0] = c16 * (FIX_ONE / 16);
+  }
+  mcp->shutdown();
+}
+#else
+void mcp_sn_start(SENSOR *s) {
+}
+
+bool mcp_sn_ready(SENSOR *s) {
+  return (true);
+}
+
+void mcp_sn_read(SENSOR *s) {
+}
+#endif
+
+/* 
+ *=======================================================================================================================
+ * ds_sn_start(), ds_sn_read() - DS18B20 probes, ds_collect() waits for the conversion itself
+ *=======================================================================================================================
+ */
+void ds_sn_start(SENSOR *s) {
+  ds_start();
+}
+
+void ds_sn_read(SENSOR *s) {
+  ds_collect();
+}
+
+/* 
+ *=======================================================================================================================
+ * sn_always_ready() - For sensors with nothing to wait for, or that wait in their read()
+ *=======================================================================================================================
+ */
+bool sn_always_ready(SENSOR *s) {
+  return (true);
+}
+
+SENSOR sn_table[SN_COUNT] = {
+  { SN_BMX, 0, &BMX_1_exists, bmx_sn_start, bmx_sn_ready, bmx_sn_read, 3, SN_TIMEOUT_MS,
+    {"bp1", "bt1", "bh1"}, {4, 2, 2}, {QC_P, QC_T, QC_RH} },
+  { SN_BMX, 1, &BMX_2_exists, bmx_sn_start, bmx_sn_ready, bmx_sn_read, 3, SN_TIMEOUT_MS,
+    {"bp2", "bt2", "bh2"}, {4, 2, 2}, {QC_P, QC_T, QC_RH} },
+  { SN_MCP, 0, &MCP_1_exists, mcp_sn_start, mcp_sn_ready, mcp_sn_read, 1, 300,
+    {"mt1"}, {4}, {QC_T} },
+  { SN_MCP, 1, &MCP_2_exists, mcp_sn_start, mcp_sn_ready, mcp_sn_read, 1, 300,
+    {"mt2"}, {4}, {QC_T} },
+  { SN_DS, 0, &ds_found, ds_sn_start, sn_always_ready, ds_sn_read, 0, 0 },
+};
+
+/* 
+ *=======================================================================================================================
+ * sn_start_all() - Start a conversion on every sensor that is online
+ *=======================================================================================================================
+ */
+void sn_start_all() {
+  for (int i=0; i<SN_COUNT; i++) {
+    SENSOR *s = &sn_table[i];
+    if (*s->exists && !s->skipped) {
+      if (s->start) {
+        s->start(s);
       }
-      else if (BMX_2_chip_id == BME280_BMP390_CHIP_ID) {
-        if (bme2.begin(BMX_ADDRESS_2)) { 
-          BMX_2_exists = true;
-          Output ("BME2 ONLINE");
-          SystemStatusBits &= ~SSB_BMX_2; // Turn Off Bit
-        }          
+      s->start_ms = millis();
+    }
+    s->taken = false;
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * sn_collect() - Wait for a started sensor, read it, apply QC. A Bosch sensor that fails is marked suspect.
+ *=======================================================================================================================
+ */
+void sn_collect(SENSOR *s) {
+  int k;
+
+  if (!*s->exists || s->skipped) {
+    return;
+  }
+
+  if (!s->ready(s)) {
+    ck_slow();  // I2C polls of the conversion, no bit banging
+    while (!s->ready(s)) {
+      if ((millis() - s->start_ms) > s->wait_ms) {
+        break;
       }
-      else {
-         if (bm32.begin_I2C(BMX_ADDRESS_2)) { 
-          BMX_2_exists = true;
-          Output ("BM32 ONLINE");
-          SystemStatusBits &= ~SSB_BMX_2; // Turn Off Bit
-        }                         
-      }     
+      delay(1);
+    }
+    ck_fast();
+  }
+
+  if (s->ready(s)) {
+    s->read(s);
+  }
+  else {
+    for (k=0; k<s->nvalues; k++) {
+      s->raw[k] = FIX_NAN;  // Conversion never finished
+    }
+  }
+
+  s->qc_flags = 0;
+  for (k=0; k<s->nvalues; k++) {
+    s->qc_flags |= qc_check(s->qc[k], s->raw[k], &s->value[k]) << (k * QC_BITS);
+  }
+  if (s->kind != SN_DS) {
+    I2C_Result(s->raw[0] != FIX_NAN);
+    if (s->raw[0] == FIX_NAN) {
+      s->errors++;
+    }
+  }
+  if ((s->kind == SN_BMX) && (s->value[0] == QC_FIX(QC_ERR_P))) {
+    bmx_suspect(s->slot);  // Read failed or nonsense, I2C_Check_Sensors() looks at it next time
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * sn_qc_flags() - QC codes of the record's sensor values, QC_BITS each: bp1 bt1 bh1 bp2 bt2 bh2 mt1 mt2 from bit 0,
+ *   dt1 to dt8 from bit 16. A value that is not in the record is QC_OK.
+ *=======================================================================================================================
+ */
+uint32_t sn_qc_flags() {
+  uint32_t f = 0;
+  int pos = 0;
+
+  for (int i=SN_BMX_1; i<=SN_MCP_2; i++) {
+    SENSOR *s = &sn_table[i];
+    if (*s->exists && !s->skipped) {
+      f |= (uint32_t) s->qc_flags << pos;
+    }
+    pos += s->nvalues * QC_BITS;
+  }
+  for (int p=0; (p<ds_count) && !sn_table[SN_DS_1].skipped; p++) {
+    f |= (uint32_t) ds_qc[p] << (pos + p * QC_BITS);
+  }
+  return (f);
+}
+
+/* 
+ *=======================================================================================================================
+ * sn_gap() - Between gauge samples, read the started I2C sensors whose conversion is done. The DS18B20 waits for
+ *   OBS_Do(), One Wire is bit banged at 48 MHz only and the battery read before it uses the ADC.
+ *=======================================================================================================================
+ */
+void sn_gap() {
+  for (int i=0; i<SN_COUNT; i++) {
+    SENSOR *s = &sn_table[i];
+    if ((s->kind != SN_DS) && *s->exists && !s->skipped && !s->taken && s->ready(s)) {
+      sn_collect(s);
+      s->taken = true;
+    }
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * sn_sample() - Start, wait for and read one sensor
+ *=======================================================================================================================
+ */
+void sn_sample(SENSOR *s) {
+  if (*s->exists) {
+    if (s->start) {
+      s->start(s);
+    }
+    s->start_ms = millis();
+    sn_collect(s);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Sensor Cadence - bmx_every, mcp_every and ds_every give the minutes between reads of a kind of sensor, 0 reads it
+ *    every observation. A sensor is read at the first logged observation at or after each multiple of its minutes
+ *    on the clock, so with obs_interval dividing them the reads land on the same slots every day. Between reads it
+ *    is skipped, not started, not collected and out of the record. Calibration mode reads every sensor.
+ * ======================================================================================================================
+ */
+uint32_t sn_due[SN_COUNT];          // Unix time of each sensor's next read, 0 = the next observation
+
+/* 
+ *=======================================================================================================================
+ * sn_every() - Minutes between reads of the sensor's kind, 0 = every observation
+ *=======================================================================================================================
+ */
+int sn_every(SENSOR *s) {
+  switch (s->kind) {
+    case SN_BMX : return (cf_bmx_every);
+    case SN_MCP : return (cf_mcp_every);
+    case SN_DS  : return (cf_ds_every);
+  }
+  return (0);
+}
+
+/* 
+ *=======================================================================================================================
+ * sn_plan() - Before the sensors are started, mark those that are not due at time t
+ *=======================================================================================================================
+ */
+void sn_plan(uint32_t t, bool log) {
+  for (int i=0; i<SN_COUNT; i++) {
+    SENSOR *s = &sn_table[i];
+    uint32_t every = (uint32_t) sn_every(s) * 60;
+
+    s->skipped = log && every && ((t + OBS_EARLY_S) < sn_due[i]);
+    if (log && every && !s->skipped) {
+      sn_due[i] = ((t + OBS_EARLY_S) / every + 1) * every;
+    }
+  }
+}
+
+/*
+ * ======================================================================================================================
+ *  Bosch Fusion - With bmx_fuse set and both Bosch sensors online, BMX_2 is started and read only every bmx_fuse
+ *    observations, or when BMX_1's pressure or temperature failed QC. Each observation with both good moves the bias
+ *    of BMX_2 against BMX_1 1/BMX_FUSE_SMOOTH of the way. The fused values are the mean of BMX_1 and BMX_2 less its
+ *    bias when both were read, else whichever was good. The record gets them as "bpf" and "btf" with "bfs", 1 BMX_1
+ *    used, 2 BMX_2 used, 4 the two differ by more than BMX_FUSE_DP or BMX_FUSE_DT after the bias. bp2 bt2 bh2 are
+ *    only in records BMX_2 was read for. Not with the BMP388/390 FIFO on BMX_2, it converts all the time anyway.
+ * ======================================================================================================================
+ */
+#define BMX_FUSE_SMOOTH   8                 // A new difference moves the bias 1/BMX_FUSE_SMOOTH of the way
+#define BMX_FUSE_DP       (FIX_ONE)         // 1 hPa
+#define BMX_FUSE_DT       (FIX_ONE)         // 1 deg C
+
+int bmx_fuse_n = 0;                 // Observations since BMX_2 was read
+bool bmx_fuse_known = false;        // Bias measured
+int32_t bmx_fuse_bp = 0;            // BMX_2 less BMX_1, FIX_ONE units
+int32_t bmx_fuse_bt = 0;
+int32_t bmx_fuse_p = 0;             // Fused, FIX_ONE units
+int32_t bmx_fuse_t = 0;
+int bmx_fuse_src = 0;               // "bfs"
+
+/* 
+ *=======================================================================================================================
+ * bmx_fuse_plan() - Before the sensors are started, is BMX_2 left out of this observation
+ *=======================================================================================================================
+ */
+void bmx_fuse_plan() {
+  SENSOR *s = &sn_table[SN_BMX_2];
+
+  if (sn_table[SN_BMX_1].skipped) {
+    return;  // Neither is due, sn_plan()
+  }
+  s->skipped = cf_bmx_fuse && BMX_1_exists && BMX_2_exists && !bm3_fifo_on[1] && bmx_fuse_known &&
+               (++bmx_fuse_n < cf_bmx_fuse);
+  if (!s->skipped) {
+    bmx_fuse_n = 0;
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * bmx_fuse() - After the sensors are collected, read BMX_2 if BMX_1 failed, update the bias and the fused values
+ *=======================================================================================================================
+ */
+void bmx_fuse() {
+  SENSOR *s1 = &sn_table[SN_BMX_1];
+  SENSOR *s2 = &sn_table[SN_BMX_2];
+  int32_t ep = QC_FIX(QC_ERR_P);
+  int32_t et = QC_FIX(QC_ERR_T);
+  int32_t dp, dt;
+  bool ok1, ok2;
+
+  if (!cf_bmx_fuse || !BMX_1_exists || !BMX_2_exists || s1->skipped) {
+    return;
+  }
+  ok1 = (s1->value[0] != ep) && (s1->value[1] != et);
+  if (s2->skipped && !ok1) {
+    s2->skipped = false;  // The secondary after all
+    bmx_fuse_n = 0;
+    sn_sample(s2);
+  }
+  ok2 = !s2->skipped && (s2->value[0] != ep) && (s2->value[1] != et);
+
+  bmx_fuse_src = 0;
+  if (ok1 && ok2) {
+    dp = s2->value[0] - s1->value[0];
+    dt = s2->value[1] - s1->value[1];
+    if (!bmx_fuse_known) {
+      bmx_fuse_bp = dp;
+      bmx_fuse_bt = dt;
+      bmx_fuse_known = true;
+    }
+    if ((abs(dp - bmx_fuse_bp) > BMX_FUSE_DP) || (abs(dt - bmx_fuse_bt) > BMX_FUSE_DT)) {
+      bmx_fuse_src |= 4;
     }
+    bmx_fuse_bp += (dp - bmx_fuse_bp) / BMX_FUSE_SMOOTH;
+    bmx_fuse_bt += (dt - bmx_fuse_bt) / BMX_FUSE_SMOOTH;
+    bmx_fuse_p = s1->value[0] + (dp - bmx_fuse_bp) / 2;
+    bmx_fuse_t = s1->value[1] + (dt - bmx_fuse_bt) / 2;
+    bmx_fuse_src |= 3;
+  }
+  else if (ok1) {
+    bmx_fuse_p = s1->value[0];
+    bmx_fuse_t = s1->value[1];
+    bmx_fuse_src = 1;
+  }
+  else if (ok2) {
+    bmx_fuse_p = s2->value[0] - bmx_fuse_bp;  // 0 until both have been good together
+    bmx_fuse_t = s2->value[1] - bmx_fuse_bt;
+    bmx_fuse_src = 2;
   }
   else {
-    // Sensor offline but we our state has it online
-    if (BMX_2_exists == true) {
-      BMX_2_exists = false;
-      Output ("BMX2 OFFLINE");
-      SystemStatusBits |= SSB_BMX_2;  // Turn On Bit 
-    }    
+    bmx_fuse_p = ep;
+    bmx_fuse_t = et;
   }
 }
+
+/*
+ * ======================================================================================================================
+ * I2C_Check_Sensors() - Look at each I2C sensor that failed or is offline and take action accordingly
+ * ======================================================================================================================
+ */
+void I2C_Check_Sensors() {
+  I2C_Bus_Check();  // Stuck or failing bus first, or every probe below fails too
+#if !STN_FIXED || STN_BMX_1
+  bmx_check(0);  // BMX_1 Barometric Pressure 
+#endif
+#if !STN_FIXED || STN_BMX_2
+  bmx_check(1);  // BMX_2 Barometric Pressure 
+#endif
+}
@@ -0,0 +1,221 @@
+/*
+ * ======================================================================================================================
+ *  TK.h - Calibration Mode Tasks
+ *
+ *  tk_loop() is the calibration branch of loop(). Each pass runs the tasks that are due, then tk_idle() keeps the CPU
+ *  in LowPower.idle() until the next timed task is due. USB traffic ends the idle early, so console input and the
+ *  USB drive are served at once rather than on the next tick. SysTick still wakes the core each ms to keep millis(),
+ *  that costs a few us and the check of the wake conditions. Tasks run to completion and must not delay. A period
+ *  of 0 is a poll, run every pass, it returns at once when there is nothing to do.
+ *
+ *  The observation blocks for the gauge window, so while it samples s_gauge_sample() calls tk_yield() through
+ *  sg_yield and the other tasks keep running. Tasks marked exclusive would use the ADC or I2C sensors under it and
+ *  wait, the monitor shows the clock only and the shell holds commands that are not quick. The monitor reads no
+ *  sensor, the sensors task ahead of it keeps the latest values (SM.h).
+ * ======================================================================================================================
+ */
+#define TK_IDLE_MAX_MS    1000              // Longest idle when no timed task is waiting
+
+typedef struct {
+  const char *name;
+  unsigned long period_ms;                  // 0 = every pass
+  bool exclusive;                           // Not while the gauge samples
+  void (*run)();
+  unsigned long last_ms;                    // Last start
+  bool started;                             // Has run, the first run is on the first pass
+  bool busy;                                // Running, not entered again from tk_yield()
+} TK_TASK;
+
+int seconds_to_next_obs();                  // SSG_FAL_ULP.ino
+
+bool tk_sampling = false;                   // OBS_Do() is in the gauge window
+unsigned long tk_sample_ms = 0;             // When it started
+
+/*
+ *=======================================================================================================================
+ * tk_health() - Sensors that came or went
+ *=======================================================================================================================
+ */
+void tk_health() {
+  I2C_Check_Sensors();
+}
+
+void tk_run();
+
+/*
+ *=======================================================================================================================
+ * tk_yield() - Run the other tasks while the gauge samples
+ *=======================================================================================================================
+ */
+void tk_yield() {
+  tk_run();
+}
+
+/*
+ *=======================================================================================================================
+ * tk_sample() - Observation every minute, not saved to SD
+ *=======================================================================================================================
+ */
+void tk_sample() {
+  SF_SCRATCH sc;
+  char *buf = sc.alloc(SF_LINE);
+
+  tk_sampling = true;
+  tk_sample_ms = millis();
+  sg_yield = tk_yield;
+  ph_start(false);  // Phase budgets count from here, calibration keeps no cycle
+  OBS_Do(false);
+  sm_observed();
+  sg_yield = NULL;
+  tk_sampling = false;
+
+  sprintf (buf, "NO:%ds", seconds_to_next_obs());
+  Output (buf);
+}
+
+/*
+ *=======================================================================================================================
+ * tk_monitor() - Station monitor each second, counts down calibration mode
+ *=======================================================================================================================
+ */
+void tk_monitor() {
+  SF_SCRATCH sc;
+  char *buf = sc.alloc(SF_LINE);
+
+  if (countdown) {
+    countdown--;
+  }
+  if (tk_sampling) {
+    StationMonitorSampling(millis() - tk_sample_ms);
+  }
+  else if (BMX_1_exists || BMX_2_exists) {
+    StationMonitor();
+  }
+  else {
+    char Buffer16Bytes[16];
+    sprintf (buf, "S:%3d T:%s %d.%02d %04X",
+      sm_sg_raw,    // Pins are 10bit resolution (0-1023)
+      fix_str(Buffer16Bytes, sizeof(Buffer16Bytes), ds_reading[0], 2),
+      sm_batt / 1000, (sm_batt % 1000) / 10,
+      SystemStatusBits);
+    Output (buf);
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * tk_shell() - Console commands, SH.h
+ *=======================================================================================================================
+ */
+void tk_shell() {
+  sh_poll(tk_sampling);
+}
+
+/*
+ *=======================================================================================================================
+ * tk_usb() - USB drive commands from the host, MS.h
+ *=======================================================================================================================
+ */
+void tk_usb() {
+  if (ms_ready) {
+    ms_poll();
+  }
+}
+
+TK_TASK tk_tasks[] = {
+  {"health",  1000,  true,  tk_health},
+  {"sample",  60000, true,  tk_sample},
+  {"sensors", 1000,  true,  sm_refresh},
+  {"monitor", 1000,  false, tk_monitor},
+  {"shell",   0,     false, tk_shell},
+  {"usb",     0,     false, tk_usb},
+};
+#define TK_COUNT          (sizeof(tk_tasks) / sizeof(tk_tasks[0]))
+
+/*
+ *=======================================================================================================================
+ * tk_run() - One pass over the tasks, run the ones that are due
+ *=======================================================================================================================
+ */
+void tk_run() {
+  TK_TASK *t;
+
+  for (unsigned int i=0; i<TK_COUNT; i++) {
+    t = &tk_tasks[i];
+    if (t->busy || (tk_sampling && t->exclusive)) {
+      continue;
+    }
+    if (t->started && ((millis() - t->last_ms) < t->period_ms)) {
+      continue;
+    }
+    t->started = true;
+    t->last_ms = millis();
+    t->busy = true;
+    wd_feed();
+    t->run();
+    t->busy = false;
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * tk_next_ms() - Time to the next timed task that can run
+ *=======================================================================================================================
+ */
+unsigned long tk_next_ms() {
+  unsigned long next = TK_IDLE_MAX_MS;
+  unsigned long since;
+  TK_TASK *t;
+
+  for (unsigned int i=0; i<TK_COUNT; i++) {
+    t = &tk_tasks[i];
+    if (!t->period_ms || t->busy || (tk_sampling && t->exclusive)) {
+      continue;
+    }
+    if (!t->started) {
+      return (0);
+    }
+    since = millis() - t->last_ms;
+    if (since >= t->period_ms) {
+      return (0);
+    }
+    next = ((t->period_ms - since) < next) ? (t->period_ms - since) : next;
+  }
+  return (next);
+}
+
+/*
+ *=======================================================================================================================
+ * tk_wait() - LowPower.idle() for up to ms, less when the console or the USB drive has something for us
+ *=======================================================================================================================
+ */
+void tk_wait(unsigned long ms) {
+  unsigned long start = millis();
+
+  while ((millis() - start) < ms) {
+    if (Serial.available() || (ms_ready && (USBDevice.available(ms_usb.ep_out()) >= sizeof(MS_CBW)))) {
+      return;
+    }
+    wd_feed();
+    LowPower.idle();  // SysTick each ms, USB on traffic
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * tk_idle() - Until the next tick
+ *=======================================================================================================================
+ */
+void tk_idle() {
+  tk_wait(tk_next_ms());
+}
+
+/*
+ *=======================================================================================================================
+ * tk_loop() - Calibration mode pass, idle until the next tick or input
+ *=======================================================================================================================
+ */
+void tk_loop() {
+  tk_run();
+  tk_idle();
+}
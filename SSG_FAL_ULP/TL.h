@@ -0,0 +1,206 @@
+/*
+ * ======================================================================================================================
+ *  TL.h - Telemetry
+ *
+ *  With tl=1 and n2s=2 a radio modem in transparent mode on Serial1 (TX D1) sends the binary records of the need
+ *  to send queue (NS.h). Every tl_every observations, after the observation is logged and before the sleep, the
+ *  modem is powered from tl_pin (0 = always powered, only the UART is started), given tl_warm ms to come up, sent
+ *  up to TL_FRAMES frames of what the queue holds and powered off again. Records come off the queue once the UART
+ *  has sent them, a modem without acknowledgement cannot tell us more.
+ *
+ *    Frame   'S' 'G' | length | seq | count | records | CRC16 of the bytes before it, low byte first
+ *    First   at (4 bytes) | flags | dtn | fields
+ *    Others  at - previous at | fields - previous fields
+ *
+ *  length is the whole frame, at most tl_frame bytes. Fields and differences are the zig-zag varints of the Delta
+ *  Log in OBS.h. A record whose flags or probe count differ from the one before starts the next frame. Records that
+ *  waited in the queue, all but this observation's, carry SSB_FROM_N2S in hth. tools/tlframe2json.py decodes the
+ *  frames a receiver saved.
+ * ======================================================================================================================
+ */
+#define TL_MAGIC0         'S'
+#define TL_MAGIC1         'G'
+#define TL_HDR_LEN        5
+#define TL_CRC_LEN        2
+#define TL_REC_MAX        (6 + OBS_DL_FIELDS * 5)   // Record with every varint at 5 bytes
+#define TL_FRAME_MIN      (TL_HDR_LEN + TL_REC_MAX + TL_CRC_LEN)
+#define TL_FRAME_MAX      255                       // LoRa payload
+#define TL_FRAMES         8                         // Frames sent per wake
+#define TL_GAP_MS         250                       // Air time of a frame before the next, or power off
+
+uint8_t tl_frame[TL_FRAME_MAX];
+uint8_t tl_seq = 0;
+int tl_obs = 0;                     // Observations since the last send
+
+/*
+ *=======================================================================================================================
+ * tl_initialize() - Check the telemetry config, before pwr_park_pins()
+ *=======================================================================================================================
+ */
+void tl_initialize() {
+  if (!cf_tl) {
+    return;
+  }
+  if (cf_n2s != NS_BIN) {
+    LOG_ERR ("TL:n2s %d Not 2", cf_n2s);
+    cf_tl = 0;
+    return;
+  }
+  if (cf_sg_serial) {
+    LOG_ERR ("TL:Serial1 Used by sg_serial");
+    cf_tl = 0;
+    return;
+  }
+  if ((cf_tl_baud < 1200) || (cf_tl_baud > 115200)) {
+    LOG_INFO ("TL:baud %d->9600", cf_tl_baud);
+    cf_tl_baud = 9600;
+  }
+  if ((cf_tl_frame < TL_FRAME_MIN) || (cf_tl_frame > TL_FRAME_MAX)) {
+    LOG_INFO ("TL:frame %d->%d", cf_tl_frame, TL_FRAME_MAX);
+    cf_tl_frame = TL_FRAME_MAX;
+  }
+  if (cf_tl_every < 1) {
+    cf_tl_every = 1;
+  }
+  if ((cf_tl_warm < 0) || (cf_tl_warm > 5000)) {
+    cf_tl_warm = 100;
+  }
+  if (cf_tl_pin) {
+    pinMode(cf_tl_pin, OUTPUT);
+    digitalWrite(cf_tl_pin, LOW);
+  }
+  LOG_INFO ("TL:Serial1 %d Every %d", cf_tl_baud, cf_tl_every);
+}
+
+/*
+ *=======================================================================================================================
+ * tl_radio() - Modem and UART on or off
+ *=======================================================================================================================
+ */
+void tl_radio(bool on) {
+  if (on) {
+    if (cf_tl_pin) {
+      digitalWrite(cf_tl_pin, HIGH);
+    }
+    Serial1.begin(cf_tl_baud);
+    delay(cf_tl_warm);
+  }
+  else {
+    Serial1.flush();
+    delay(TL_GAP_MS);
+    Serial1.end();
+    if (cf_tl_pin) {
+      digitalWrite(cf_tl_pin, LOW);
+    }
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * tl_pack() - Frame of the records at the head of the queue, return its length, 0 if the queue is empty.
+ *   *used is the queue bytes it took, *count the records.
+ *=======================================================================================================================
+ */
+int tl_pack(uint32_t *used, int *count) {
+  OBS_BINREC r, prev;
+  uint8_t rec[TL_REC_MAX];
+  int32_t v[OBS_DL_FIELDS], pv[OBS_DL_FIELDS];
+  int len = TL_HDR_LEN;
+  int k, n, got, rl;
+  uint16_t crc;
+
+  *used = 0;
+  *count = 0;
+  while (*count < 255) {
+    k = ns_peek(*used, (char *) &r, sizeof(r), &got);
+    if (k == 0) {
+      break;
+    }
+    if ((got != sizeof(r)) || ((r.type != OBS_BIN_TYPE) && (r.type != 4)) || (r.dtn > DS_MAX_PROBES) ||
+        (r.crc != OBS_bin_crc(&r))) {  // 4 is the layout of 5, queued by the firmware before
+      *used += k;  // Not a record we can send, or torn in the queue file
+      continue;
+    }
+    if (r.at != obs_binrec.at) {
+      r.hth |= SSB_FROM_N2S;
+    }
+    n = obs_dl_fields(&r, v);
+    rl = 0;
+    if (*count == 0) {
+      memcpy (rec, &r.at, sizeof(r.at));
+      rl = sizeof(r.at);
+      rec[rl++] = r.flags;
+      rec[rl++] = r.dtn;
+      for (int i=0; i<n; i++) {
+        rl += obs_dl_varint(rec + rl, v[i]);
+      }
+    }
+    else {
+      if ((r.flags != prev.flags) || (r.dtn != prev.dtn)) {
+        break;
+      }
+      obs_dl_fields(&prev, pv);
+      rl = obs_dl_varint(rec, (int32_t) (r.at - prev.at));
+      for (int i=0; i<n; i++) {
+        rl += obs_dl_varint(rec + rl, v[i] - pv[i]);
+      }
+    }
+    if ((len + rl + TL_CRC_LEN) > cf_tl_frame) {
+      break;
+    }
+    memcpy (tl_frame + len, rec, rl);
+    len += rl;
+    *used += k;
+    (*count)++;
+    prev = r;
+  }
+  if (*count == 0) {
+    return (0);
+  }
+  tl_frame[0] = TL_MAGIC0;
+  tl_frame[1] = TL_MAGIC1;
+  tl_frame[2] = len + TL_CRC_LEN;
+  tl_frame[3] = tl_seq++;
+  tl_frame[4] = *count;
+  crc = OneWire::crc16(tl_frame, len, 0);
+  tl_frame[len++] = crc & 0xFF;
+  tl_frame[len++] = crc >> 8;
+  return (len);
+}
+
+/*
+ *=======================================================================================================================
+ * tl_service() - Send the queue every tl_every observations, call after OBS_Do() before the sleep, true if it sent
+ *=======================================================================================================================
+ */
+bool tl_service() {
+  uint32_t used;
+  int count, len, frames = 0, sent = 0;
+
+  if (!cf_tl || (++tl_obs < cf_tl_every) || !ns_load() || (ns_cursor >= ns_size)) {
+    return (false);
+  }
+  tl_obs = 0;
+  tl_radio(true);
+  while (frames < TL_FRAMES) {
+    wd_feed();
+    len = tl_pack(&used, &count);
+    if (len) {
+      if (frames) {
+        Serial1.flush();
+        delay(TL_GAP_MS);
+      }
+      Serial1.write(tl_frame, len);
+      frames++;
+      sent += count;
+    }
+    ns_pop(used);  // Also the bytes skipped over
+    if (!len) {
+      break;
+    }
+  }
+  tl_radio(false);
+  SendSensorMsgCount += sent;
+  LOG_INFO ("TL:%d Obs in %d Frames", sent, frames);
+  return (true);
+}
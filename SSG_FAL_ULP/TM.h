@@ -16,18 +16,653 @@ char timestamp[32];
 bool RTC_valid = false;
 bool RTC_exists = false;
 
+/*
+ * ======================================================================================================================
+ *  Observation Schedule
+ *
+ *  Observations are aligned to multiples of cf_obs_interval minutes since midnight. The slot is fixed by obs_schedule()
+ *  when work starts, so the time spent awake only shortens the sleep and never moves the next observation.
+ *
+ *  obs_last_slot, kept by the warm start, is the slot last observed. A slot passed by since then, work that overran
+ *  or a reset, is counted in obs_gap and the next record logged carries it as "gap", EV_OBS_GAP notes it. Work that
+ *  ran into the first half of the next slot does not skip it, the board goes straight back round and observes it
+ *  late. An observation more than OBS_LATE_S into its slot, that one or the first after a reset, is "late":1. Slots
+ *  are only compared on the same interval, a burst, cadence or profile change starts the count again.
+ * ======================================================================================================================
+ */
+#define OBS_EARLY_S     5         // Waking this many seconds before a slot counts as being in that slot
+#define OBS_LATE_S      30        // Seconds into the slot an observation is late
+#define OBS_WAKE_MS     ((Headless) ? 0 : 2000) // Time spent after LowPower.sleep() before the observation starts
+
+uint32_t obs_interval_s = 900;    // Set from cf_obs_interval
+int obs_cadence = 0;              // Minutes set by the adaptive cadence, 0 = cf_obs_interval, OBS.h
+uint32_t obs_slot_epoch = 0;      // Slot of the observation being worked on
+uint32_t obs_next_epoch = 0;      // Slot of the next observation
+uint32_t obs_last_slot = 0;       // Slot last observed, 0 = none known
+uint32_t obs_last_interval = 0;   // obs_interval_s then
+int obs_gap = 0;                  // Slots missed not yet in a logged record
+bool obs_late = false;            // This observation started late in its slot
+volatile bool obs_event = false;  // Set from an interrupt that wants an observation now, ends the sleep early
+
+/*
+ * ======================================================================================================================
+ *  Sleep Accounting - Each sleep between observations keeps the ms asked of it, the seconds that went by on the
+ *    clock, what woke it and how far from the wake time the board woke. The first obs_sleep() of a cycle opens the
+ *    account and obs_schedule() closes it, so the rest of the way after a brownout wake is in the same sleep. With
+ *    obs_tm set the record gets "slp":[ms,s,wake,drift], wake the TM_WK_* bits, drift the seconds after (+) or
+ *    before (-) the wake time. A timer or alarm wake more than TM_WK_TOL_S off is EV_TM_WAKE.
+ * ======================================================================================================================
+ */
+#define TM_WK_TIMER     0x01      // SAMD RTC ran out
+#define TM_WK_ALARM     0x02      // DS3231 Alarm1
+#define TM_WK_EVENT     0x04      // Gauge level event, the ADC window
+#define TM_WK_BUTTON    0x08      // Status button, went back to sleep
+#define TM_WK_BOD       0x10      // Brownout early warning
+#define TM_WK_CONSOLE   0x20      // Byte on the service console, SH.h
+#define TM_WK_TOL_S     2         // Seconds a timed wake may be off
+#define TM_ALARM_MARGIN_MS 5000  // SAMD RTC wake this long after a DS3231 alarm that never came
+
+bool tm_sl_open = false;          // Sleep under way, not yet closed by obs_schedule()
+bool tm_sl_valid = false;         // Last sleep's account is in the tm_sl_ values
+uint32_t tm_sl_at = 0;            // Clock when it began
+uint32_t tm_sl_ms = 0;            // ms asked for
+uint32_t tm_sl_s = 0;             // Seconds it took on the clock
+uint8_t tm_sl_wake = 0;           // TM_WK_* bits
+int32_t tm_sl_drift = 0;          // Seconds after the wake time, negative before it
+
+/*
+ * ======================================================================================================================
+ *  DS3231 Alarm Wake
+ *
+ *  With the DS3231 INT/SQW pin wired to cf_rtc_int_pin, Alarm1 is set to the wake time and the board sleeps with no
+ *  SAMD RTC alarm at all. INT is open drain, active low, and stays low until the alarm flag is cleared.
+ * ======================================================================================================================
+ */
+bool rtc_alarm_enabled = false;
+volatile bool rtc_alarm_fired = false;
+extern volatile bool pwr_bod_hit;   // PWR.h, the brownout early warning ends the sleep
+bool sm_button();                   // SM.h, status on the OLED for a button press, true if there was one
+bool sh_uart_rx();                  // SH.h, service console input ended the sleep
+
+/*
+ * ======================================================================================================================
+ *  Software Clock - The DS3231 is read over I2C once per wake, after that the time is that reading plus millis()
+ *    since. millis() stops in LowPower.sleep() so obs_sleep() drops the reading and the next tm_now() after the wake
+ *    reads the DS3231 again. Calibration mode never sleeps, there the reading is refreshed every TM_RESYNC_MS.
+ *    The reading lags the DS3231 by less than its second, which was already the resolution of the schedule.
+ * ======================================================================================================================
+ */
+#define TM_RESYNC_MS    60000     // Longest millis() is trusted without a DS3231 reading
+
+uint32_t tm_epoch = 0;            // DS3231 time at tm_sync_ms
+unsigned long tm_sync_ms = 0;
+bool tm_synced = false;           // tm_epoch is from this wake
+uint32_t tm_ts_day = 0;           // Day the date part of timestamp was formatted for, 0 = none
+
+/*
+ * ======================================================================================================================
+ *  DS3231 32 kHz Timebase - With rtc_32k_pin wired to the DS3231 32K output the SAMD RTC, which times
+ *    LowPower.sleep(), counts the DS3231's temperature compensated oscillator through a GCLK_IO input in place of the
+ *    board's crystal. The two clocks then tick together, a sleep is as long as the DS3231 says, and after one
+ *    tm_wake() moves the software clock on by the SAMD RTC seconds slept. The DS3231 is read over I2C only every
+ *    TM_32K_RESYNC wakes or after a clock set, their second boundaries keep the phase they had at that read so the
+ *    time stays within the DS3231 second it always was. The aging offset rtc_drift() sets trims both.
+ *
+ *    The 32K output is open drain, the pin's pull-up draws about 40 uA while it runs, an external 100k less. Only
+ *    pins with a GCLK_IO function on a generator nothing else uses will do, D6 and D1 on the Feather (GCLK4). Without
+ *    the signal the RTC stops and a sleep never ends, so the pin is watched for edges before each sleep and on a
+ *    miss the RTC goes back to GCLK2, the crystal RTCZero set up, and EV_RTC_32K notes it.
+ * ======================================================================================================================
+ */
+#include "wiring_private.h"       // pinPeripheral()
+
+#define TM_32K_RESYNC   96        // Wakes between DS3231 reads, a day at 15m
+#define TM_32K_PROBE_US 2000      // Pin watched this long, 131 edges at 32768 Hz
+#define TM_32K_EDGES    64        // Fewer is no 32K signal
+
+bool rtc_32k = false;             // SAMD RTC runs from the DS3231 32K output
+uint32_t tm_rtc_off = 0;          // DS3231 less SAMD RTC seconds at the last DS3231 read
+int tm_32k_wakes = 0;             // Wakes since then
+
 /* 
  *=======================================================================================================================
- * rtc_timestamp() - Read from RTC and set timestamp string
+ * tm_rtc_secs() - SAMD RTC clock as seconds, its epoch is RTCZero's, only differences mean anything
+ *=======================================================================================================================
+ */
+uint32_t tm_rtc_secs() {
+  RTC_MODE2_CLOCK_Type c;
+
+  RTC->MODE2.READREQ.reg = RTC_READREQ_RREQ;
+  while (RTC->MODE2.STATUS.bit.SYNCBUSY);
+  c.reg = RTC->MODE2.CLOCK.reg;
+  return (DateTime(2000 + c.bit.YEAR, c.bit.MONTH, c.bit.DAY, c.bit.HOUR, c.bit.MINUTE, c.bit.SECOND).unixtime());
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_32k_gclk() - Generator whose GCLK_IO a pin has, -1 for none we can use
+ *=======================================================================================================================
+ */
+int rtc_32k_gclk(int pin) {
+  if ((pin <= 0) || (pin >= (int) PINS_COUNT) || (g_APinDescription[pin].ulPort != PORTA)) {
+    return (-1);
+  }
+  switch (g_APinDescription[pin].ulPin) {
+    case 10 :
+    case 20 :
+      return (4);
+    case 11 :
+    case 21 :
+      return (5);
+  }
+  return (-1);
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_32k_edges() - Level changes seen on a pin in TM_32K_PROBE_US, read from the port so none are missed
+ *=======================================================================================================================
+ */
+unsigned int rtc_32k_edges(int pin) {
+  PortGroup *port = &PORT->Group[g_APinDescription[pin].ulPort];
+  uint32_t mask = 1UL << g_APinDescription[pin].ulPin;
+  uint32_t last = port->IN.reg & mask;
+  uint32_t v;
+  unsigned int n = 0;
+  unsigned long start = micros();
+
+  while ((micros() - start) < TM_32K_PROBE_US) {
+    v = port->IN.reg & mask;
+    n += (v != last);
+    last = v;
+  }
+  return (n);
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_32k_route() - Clock the SAMD RTC from a generator
+ *=======================================================================================================================
+ */
+void rtc_32k_route(int gen) {
+  GCLK->CLKCTRL.reg = (uint16_t) (GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN(gen) | GCLK_CLKCTRL_ID_RTC);
+  while (GCLK->STATUS.bit.SYNCBUSY);
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_32k_initialize() - Turn on the DS3231 32K output, check it arrives and run the SAMD RTC from it
+ *=======================================================================================================================
+ */
+void rtc_32k_initialize() {
+  int gen;
+  unsigned int n;
+
+  if (!cf_rtc_32k_pin) {
+    return;
+  }
+  gen = rtc_32k_gclk(cf_rtc_32k_pin);
+  if (gen < 0) {
+    LOG_ERR ("RTC:32K Pin %d ERR", cf_rtc_32k_pin);
+    return;
+  }
+
+  rtc.enable32K();
+  pinMode(cf_rtc_32k_pin, INPUT_PULLUP);
+  n = rtc_32k_edges(cf_rtc_32k_pin);
+  if (n < TM_32K_EDGES) {
+    ev_note (EV_RTC_32K, n);
+    rtc.disable32K();
+    return;
+  }
+
+  // RTCZero is begun here, not by the first LowPower.sleep(), its configureClock() would take the RTC back
+  LowPower.attachInterruptWakeup(RTC_ALARM_WAKEUP, NULL, (irq_mode) 0);
+  pinPeripheral(cf_rtc_32k_pin, PIO_AC_CLK);  // GCLK_IO, the input stays on for rtc_32k_edges()
+  GCLK->GENDIV.reg = GCLK_GENDIV_ID(gen) | GCLK_GENDIV_DIV(4);  // DIVSEL, 2^(4+1), 1024 Hz as RTCZero's GCLK2
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(gen) | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_GCLKIN | GCLK_GENCTRL_DIVSEL |
+                      GCLK_GENCTRL_RUNSTDBY;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  rtc_32k_route(gen);
+  rtc_32k = true;
+  tm_synced = false;  // Take the offset at the next DS3231 read
+  LOG_INFO ("RTC:32K Pin %d GCLK%d", cf_rtc_32k_pin, gen);
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_32k_check() - Before a sleep, back to the crystal if the 32K signal is gone
+ *=======================================================================================================================
+ */
+void rtc_32k_check() {
+  unsigned int n;
+
+  if (rtc_32k && ((n = rtc_32k_edges(cf_rtc_32k_pin)) < TM_32K_EDGES)) {
+    rtc_32k_route(2);
+    rtc_32k = false;
+    tm_synced = false;
+    ev_note (EV_RTC_32K, n);
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * tm_sync() - Read the DS3231
+ *=======================================================================================================================
+ */
+void tm_sync() {
+  now = rtc.now();
+  tm_epoch = now.unixtime();
+  tm_sync_ms = millis();
+  tm_synced = true;
+  if (rtc_32k) {
+    tm_rtc_off = tm_epoch - tm_rtc_secs();
+    tm_32k_wakes = 0;
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * tm_wake() - After a sleep, millis() stood still. The 32 kHz timebase carries the time over, else the next tm_now()
+ *   reads the DS3231.
+ *=======================================================================================================================
+ */
+void tm_wake() {
+  if (rtc_32k && tm_synced && (++tm_32k_wakes < TM_32K_RESYNC)) {
+    tm_epoch = tm_rtc_secs() + tm_rtc_off;
+    tm_sync_ms = millis();
+    return;
+  }
+  tm_synced = false;
+}
+
+/* 
+ *=======================================================================================================================
+ * tm_now() - Unix time, from the DS3231 only on the first call of a wake
+ *=======================================================================================================================
+ */
+uint32_t tm_now() {
+  if (!tm_synced || ((millis() - tm_sync_ms) >= TM_RESYNC_MS)) {
+    tm_sync();
+  }
+  return (tm_epoch + ((millis() - tm_sync_ms) / 1000));
+}
+
+/*
+ * ======================================================================================================================
+ *  DS3231 Drift - Each time the console sets the clock the DS3231 time it replaces is compared with the host time.
+ *    The offset over the seconds since the last set is the drift, it is logged and moved into the aging offset
+ *    register, about 0.1 ppm per LSB at 25C, positive slows the oscillator. The last set time and the aging value
+ *    are kept in TM_CAL_FILE so the rate is measured over the whole time between two site visits. Offsets are whole
+ *    seconds, so spans shorter than TM_CAL_MIN_S are logged but not used, and a rate past TM_CAL_MAX_PPM10 is taken
+ *    to be a clock that lost power or a host with the wrong time. One second over TM_CAL_MIN_S is still about 16
+ *    LSBs, so an offset of 1 s or less is only the quantization and leaves the aging alone, and each correction is
+ *    held to TM_AGING_STEP_MAX LSBs so the register walks toward the rate over several visits instead of swinging.
+ * ======================================================================================================================
+ */
+#define TM_CAL_FILE     "/OBS/RTCCAL.TXT"
+#define TM_CAL_MIN_S    (7L * 86400)  // 1 s in a week is 1.7 ppm
+#define TM_CAL_MAX_PPM10 500          // 50 ppm
+#define TM_AGING_STEP_MAX 4           // Aging LSBs moved per set
+#define DS3231_AGING    0x10
+#define DS3231_CONTROL  0x0E
+#define DS3231_CONV     0x20
+
+/* 
+ *=======================================================================================================================
+ * rtc_reg_read() - DS3231 register
+ *=======================================================================================================================
+ */
+uint8_t rtc_reg_read(uint8_t reg) {
+  iq_drain();
+  Wire.beginTransmission(RTC_I2C_ADDRESS);
+  Wire.write(reg);
+  Wire.endTransmission();
+  Wire.requestFrom(RTC_I2C_ADDRESS, 1);
+  return (Wire.read());
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_reg_write() - DS3231 register
+ *=======================================================================================================================
+ */
+void rtc_reg_write(uint8_t reg, uint8_t val) {
+  iq_drain();
+  Wire.beginTransmission(RTC_I2C_ADDRESS);
+  Wire.write(reg);
+  Wire.write(val);
+  Wire.endTransmission();
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_cal_load() - Epoch of the last set from the host, 0 = none
+ *=======================================================================================================================
+ */
+uint32_t rtc_cal_load() {
+  File fp;
+  char line[24];
+  int n;
+
+  if (!SD_exists || !SD.exists(TM_CAL_FILE)) {
+    return (0);
+  }
+  fp = SD.open(TM_CAL_FILE, FILE_READ);
+  if (!fp) {
+    return (0);
+  }
+  n = fp.readBytesUntil('\n', line, sizeof(line)-1);
+  line[n] = 0;
+  fp.close();
+  return (strtoul(line, NULL, 10));
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_cal_save() - Remember this set and the aging value written
+ *=======================================================================================================================
+ */
+void rtc_cal_save(uint32_t epoch, int aging) {
+  File fp;
+
+  if (!SD_exists) {
+    return;
+  }
+  SD.remove(TM_CAL_FILE);
+  fp = SD.open(TM_CAL_FILE, FILE_WRITE);
+  if (!fp) {
+    Output ("RTC CAL SAVE ERR");
+    return;
+  }
+  sprintf (msgbuf, "%lu %d", (unsigned long) epoch, aging);
+  fp.println(msgbuf);
+  fp.close();
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_drift() - Log the DS3231 offset from the host time about to be set, correct the aging offset from its rate
+ *=======================================================================================================================
+ */
+void rtc_drift(uint32_t host) {
+  uint32_t last = rtc_cal_load();
+  int32_t offset;
+  int32_t span;
+  int32_t ppm10;  // ppm * 10, 1 aging LSB
+  int aging;
+  char Buffer16Bytes[16];
+
+  if (!RTC_exists) {
+    return;
+  }
+  aging = (int8_t) rtc_reg_read(DS3231_AGING);
+  sprintf (msgbuf, "RTC:Aging %d T:%s", aging,
+    fix_str(Buffer16Bytes, sizeof(Buffer16Bytes), QC_FIX(rtc.getTemperature()), 2));
+  Output (msgbuf);
+
+  if (RTC_valid) {
+    offset = (int32_t) (rtc.now().unixtime() - host);  // + = DS3231 fast
+    span = (int32_t) (host - last);
+    sprintf (msgbuf, "RTC:Offset %lds", (long) offset);
+    Output (msgbuf);
+
+    if (last && (span >= TM_CAL_MIN_S)) {
+      ppm10 = (int32_t) (((int64_t) offset * 10000000LL) / span);
+      sprintf (msgbuf, "RTC:Drift %ld.%ldppm %ldd", (long) (ppm10 / 10), (long) abs(ppm10 % 10),
+        (long) (span / 86400));
+      Output (msgbuf);
+      if (abs(offset) <= 1) {
+        Output ("RTC:Drift Within 1s");
+      }
+      else if (abs(ppm10) <= TM_CAL_MAX_PPM10) {
+        ppm10 = (ppm10 > TM_AGING_STEP_MAX) ? TM_AGING_STEP_MAX :
+          ((ppm10 < -TM_AGING_STEP_MAX) ? -TM_AGING_STEP_MAX : ppm10);
+        aging += ppm10;
+        aging = (aging > 127) ? 127 : ((aging < -128) ? -128 : aging);
+        rtc_reg_write(DS3231_AGING, (uint8_t) (int8_t) aging);
+        rtc_reg_write(DS3231_CONTROL, rtc_reg_read(DS3231_CONTROL) | DS3231_CONV);  // Applied on a conversion
+        sprintf (msgbuf, "RTC:Aging->%d", aging);
+        Output (msgbuf);
+      }
+      else {
+        Output ("RTC:Drift Ignored");
+      }
+    }
+  }
+  rtc_cal_save(host, aging);
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_timestamp() - Set now and the timestamp string, the date part is only formatted when the day changes
  *=======================================================================================================================
  */
 void rtc_timestamp() {
-  now = rtc.now(); //get the current date-time
+  uint32_t t = tm_now();
+
+  now = DateTime(t);
+  if ((t / 86400) != tm_ts_day) {
+    // ISO_8601 Time Format
+    sprintf (timestamp, "%d-%02d-%02dT%02d:%02d:%02d", 
+      now.year(), now.month(), now.day(),
+      now.hour(), now.minute(), now.second());
+    tm_ts_day = t / 86400;
+  }
+  else {
+    sprintf (timestamp + 11, "%02d:%02d:%02d", now.hour(), now.minute(), now.second());
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * obs_schedule() - Fix the slot for this observation and the next one, call before doing any work
+ *=======================================================================================================================
+ */
+void obs_schedule() {
+  uint32_t t, due;
+  bool same;
+  int n;
+
+  t = tm_now();
+  now = DateTime(t);
+  obs_slot_epoch = ((t + OBS_EARLY_S) / obs_interval_s) * obs_interval_s;
+  obs_next_epoch = obs_slot_epoch + obs_interval_s;
+  same = (obs_last_interval == obs_interval_s);  // Else a burst, cadence or profile change moved the schedule
+  obs_late = (t > obs_slot_epoch + OBS_LATE_S) && (same || !obs_last_slot);
+
+  // Slots between the last one observed and this one
+  if (obs_last_slot && same && (obs_slot_epoch > obs_last_slot)) {
+    due = (obs_last_slot / obs_interval_s + 1) * obs_interval_s;
+    if (obs_slot_epoch > due) {
+      n = (obs_slot_epoch - due + obs_interval_s - 1) / obs_interval_s;
+      obs_gap += n;
+      ev_note (EV_OBS_GAP, n);
+    }
+  }
+  obs_last_slot = obs_slot_epoch;
+  obs_last_interval = obs_interval_s;
+  tm_sl_valid = tm_sl_open;
+  tm_sl_open = false;
+}
+
+/* 
+ *=======================================================================================================================
+ * obs_sleep_ms() - Milliseconds to sleep so the next observation starts on obs_next_epoch
+ *=======================================================================================================================
+ */
+uint32_t obs_sleep_ms() {
+  uint32_t t, ms;
+  
+  t = tm_now();
+  now = DateTime(t);
+
+  // Work overran the slot (or the RTC was set). In the first half of a slot not yet observed catch it up now, else
+  // skip ahead to the next slot still in the future and leave the one passed to obs_schedule() as a gap
+  if ((obs_next_epoch == 0) || ((t + (OBS_WAKE_MS / 1000)) >= obs_next_epoch)) {
+    uint32_t slot = (t / obs_interval_s) * obs_interval_s;
+
+    if ((obs_next_epoch != 0) && (slot > obs_last_slot) && ((t - slot) < (obs_interval_s / 2))) {
+      Output("TM:Late Slot");
+      obs_next_epoch = slot;
+      return (0);
+    }
+    if (obs_next_epoch != 0) {
+      Output("TM:Missed Slot");
+    }
+    obs_next_epoch = ((t + (OBS_WAKE_MS / 1000)) / obs_interval_s + 1) * obs_interval_s;
+  }
+
+  ms = (obs_next_epoch - t) * 1000;
+  return ((ms > OBS_WAKE_MS) ? (ms - OBS_WAKE_MS) : 0);
+}
+
+/* 
+ *=======================================================================================================================
+ * obs_sleep_rest() - Milliseconds still to sleep after an early wake, 0 when it is time, the slot stays as it is
+ *=======================================================================================================================
+ */
+uint32_t obs_sleep_rest() {
+  uint32_t t;
+
+  tm_wake();  // millis() stood still
+  t = tm_now();
+  if ((t + (OBS_WAKE_MS / 1000)) >= obs_next_epoch) {
+    return (0);
+  }
+  return (((obs_next_epoch - t) * 1000) - OBS_WAKE_MS);
+}
+
+/* 
+ *=======================================================================================================================
+ * tm_sl_begin() - Open the sleep's account, once a cycle
+ *=======================================================================================================================
+ */
+void tm_sl_begin(uint32_t ms) {
+  if (tm_sl_open) {
+    return;
+  }
+  tm_sl_open = true;
+  tm_sl_at = tm_now();
+  tm_sl_ms = ms;
+  tm_sl_wake = 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * tm_sl_end() - What woke it and when, call once the time is carried over the sleep
+ *=======================================================================================================================
+ */
+void tm_sl_end(uint8_t wake, bool button) {
+  uint32_t t = tm_now();
+
+  if (obs_event) {
+    wake = TM_WK_EVENT;
+  }
+  else if (pwr_bod_hit) {
+    wake = TM_WK_BOD;
+  }
+  else if (sh_uart_rx()) {
+    wake = TM_WK_CONSOLE;
+  }
+  tm_sl_wake |= wake | ((button) ? TM_WK_BUTTON : 0);
+  tm_sl_s = t - tm_sl_at;
+  tm_sl_drift = (int32_t) (t - (obs_next_epoch - (OBS_WAKE_MS / 1000)));
+  if ((wake & (TM_WK_TIMER | TM_WK_ALARM)) && ((tm_sl_drift > TM_WK_TOL_S) || (tm_sl_drift < -TM_WK_TOL_S))) {
+    ev_note (EV_TM_WAKE, tm_sl_drift);
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_alarm_isr() - DS3231 INT went low
+ *=======================================================================================================================
+ */
+void rtc_alarm_isr() {
+  rtc_alarm_fired = true;
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_alarm_initialize() - Route DS3231 Alarm1 to INT and make the pin a wakeup source
+ *=======================================================================================================================
+ */
+void rtc_alarm_initialize() {
+  if (!cf_rtc_int_pin) {
+    return;
+  }
+
+  rtc.disable32K();
+  rtc.writeSqwPinMode(DS3231_OFF);  // INTCN = 1, INT pin follows the alarm flags
+  rtc.disableAlarm(2);
+  rtc.clearAlarm(1);
+  rtc.clearAlarm(2);
 
-  // ISO_8601 Time Format
-  sprintf (timestamp, "%d-%02d-%02dT%02d:%02d:%02d", 
-    now.year(), now.month(), now.day(),
-    now.hour(), now.minute(), now.second());
+  pinMode(cf_rtc_int_pin, INPUT_PULLUP);
+  if (digitalRead(cf_rtc_int_pin) == LOW) {
+    ev_note (EV_RTC_INT_LOW, cf_rtc_int_pin);
+    return;
+  }
+  LowPower.attachInterruptWakeup(cf_rtc_int_pin, rtc_alarm_isr, FALLING);
+  rtc_alarm_enabled = true;
+  LOG_INFO ("RTC:Alarm INT %d", cf_rtc_int_pin);
+}
+
+/* 
+ *=======================================================================================================================
+ * obs_sleep() - Sleep until the next observation, woken by DS3231 Alarm1 if we can, else the SAMD RTC. obs_event
+ *   set by another wakeup source or service console input ends it early. The watchdog is off while asleep, so the
+ *   SAMD RTC also wakes an alarm sleep TM_ALARM_MARGIN_MS after the alarm time, the alarm is then cleared for the
+ *   next sleep to set again and it is EV_RTC_MISSED with the INT pin level.
+ *=======================================================================================================================
+ */
+void obs_sleep() {
+  uint32_t ms = obs_sleep_ms();
+  bool button = false;
+
+  if (ms == 0) {
+    return;  // Its slot is here or being caught up
+  }
+  tm_sl_begin(ms);
+  rtc_32k_check();
+  if (rtc_alarm_enabled && (ms >= 1000)) {
+    rtc_alarm_fired = false;
+    rtc.clearAlarm(1);
+    if (rtc.setAlarm1(DateTime(obs_next_epoch - (OBS_WAKE_MS / 1000)), DS3231_A1_Date) && 
+        (digitalRead(cf_rtc_int_pin) == HIGH)) {
+      wd_sleep();
+      while (!rtc_alarm_fired && !obs_event && !pwr_bod_hit && !sh_uart_rx()) {
+        LowPower.sleep(ms + TM_ALARM_MARGIN_MS);  // Any other wakeup source puts us right back to sleep
+        button |= sm_button();
+        if (!rtc_alarm_fired && ((ms = obs_sleep_rest()) == 0)) {
+          break;            // Past the alarm time and no edge seen
+        }
+      }
+      wd_wake();
+      if (!rtc_alarm_fired && !obs_event && !pwr_bod_hit && !sh_uart_rx()) {
+        ev_note (EV_RTC_MISSED, digitalRead(cf_rtc_int_pin));
+      }
+      rtc.disableAlarm(1);
+      rtc.clearAlarm(1);    // Release INT, obs_sleep() sets it again for the next slot
+      tm_wake();            // millis() stood still
+      tm_sl_end((rtc_alarm_fired) ? TM_WK_ALARM : TM_WK_TIMER, button);
+      return;
+    }
+    ev_note (EV_RTC_ALARM, 0);
+    rtc_alarm_enabled = false;
+  }
+  wd_sleep();
+  LowPower.sleep(ms);
+  while (sm_button()) {
+    button = true;
+    if (obs_event || pwr_bod_hit || sh_uart_rx() || ((ms = obs_sleep_rest()) == 0)) {
+      break;
+    }
+    LowPower.sleep(ms);  // A status button press, the rest of the way
+  }
+  wd_wake();
+  tm_wake();
+  tm_sl_end(TM_WK_TIMER, button);
 }
 
 /* 
@@ -37,20 +672,37 @@ void rtc_timestamp() {
  */
 void rtc_initialize() {
 
+  // Interval must divide a day so slots line up at midnight
+  if ((cf_obs_interval < 1) || (cf_obs_interval > 1440) || ((1440 % cf_obs_interval) != 0)) {
+    LOG_INFO ("TM:interval %d->15", cf_obs_interval);
+    cf_obs_interval = 15;
+  }
+  obs_interval_s = (uint32_t) cf_obs_interval * 60;
+  if (cf_obs_fast && ((cf_obs_fast >= cf_obs_interval) || ((1440 % cf_obs_fast) != 0))) {
+    LOG_INFO ("TM:fast %d->0", cf_obs_fast);
+    cf_obs_fast = 0;
+  }
+  if (cf_obs_slow && ((cf_obs_slow < cf_obs_interval) || (cf_obs_slow > 1440) || ((1440 % cf_obs_slow) != 0))) {
+    LOG_INFO ("TM:slow %d->0", cf_obs_slow);
+    cf_obs_slow = 0;
+  }
+
   if (!rtc.begin()) { // Always returns true
      Output("ERR:RTC NOT FOUND");
      SystemStatusBits |= SSB_RTC; // Turn on Bit
      return;
   }
   
-  if (!I2C_Device_Exist(RTC_I2C_ADDRESS)) {
+  if (!I2C_Present(RTC_I2C_ADDRESS)) {
     Output("ERR:RTC-I2C NOTFOUND");
     SystemStatusBits |= SSB_RTC; // Turn on Bit
-    delay (5000);
+    Output_Delay (5000);
     return;
   }
 
   RTC_exists = true; // We have a clock hardware connected
+  rtc_alarm_initialize();
+  rtc_32k_initialize();
 
   rtc_timestamp();
   sprintf (msgbuf, "%s*", timestamp);
@@ -60,7 +712,6 @@ void rtc_initialize() {
   // Asumption is: If RTC not set, it will not have the current year.
 
   if ((now.year() >= 2022) && (now.year() <= 2031)) {
-    now = rtc.now();
     RTC_valid = true;
   }
   else {
@@ -70,95 +721,81 @@ void rtc_initialize() {
 
 /*
  * =======================================================================================================================
- * rtc_readserial() - // check for serial input, validate for rtc, set rtc, report result
+ * rtc_settime() - Validate a YYYY:MM:DD:HH:MM:SS line from the console shell, set rtc, report result
  * =======================================================================================================================
  */
-bool rtc_readserial()
+bool rtc_settime(char *buffer)
 {
-  boolean ready = false;
-  int cnt = 0;
-  char buffer[32];
   char *p, *token;
   int year, month, day, hour, minute, second;
-  
-  while (Serial.available()) {
-    char c = Serial.read();
-    buffer[cnt++] = c;
-    if ((c == '\n') || (cnt == 31) ){
-      buffer[cnt] = '\0';  // Note: there will be a \r\n on end of string in buffer
-      cnt = 0;
-      Serial.flush(); // if anything left in the Serial buffer, get rid of it
-
-      // Validate User input for a good date and time
-      p = &buffer[0];
-      token = strtok_r(p, ":", &p);
-      if (isnumeric(token) && (year = atoi (token)) && (year >= 2022) && (year <= 2031) ) {   // FOO set back 2022
+
+  // Validate User input for a good date and time
+  p = &buffer[0];
+  token = strtok_r(p, ":", &p);
+  if (isnumeric(token) && (year = atoi (token)) && (year >= 2022) && (year <= 2031) ) {   // FOO set back 2022
+    token = strtok_r(p, ":", &p);
+    if (isnumeric(token) && (month = atoi (token)) && (month >= 1) && (month <= 12) ) {
+      token = strtok_r(p, ":", &p);        
+      if (isnumeric(token) && (day = atoi (token)) && 
+           (
+             ( (day>=1  && day<=31) && (month==1 || month==3 || month==5 || month==7 || month==8 || month==10 || month==12) ) ||
+             ( (day>=1  && day<=30) && (month==4 || month==6 || month==9 || month==11) ) ||
+             ( (day>=1  && day<=28) && (month==2) ) ||
+             ( (day==29)            && (month==2) && ( (year%400==0) || ( (year%4==0) && (year%100!=0) ) ) )
+            ) 
+         ) {
         token = strtok_r(p, ":", &p);
-        if (isnumeric(token) && (month = atoi (token)) && (month >= 1) && (month <= 12) ) {
-          token = strtok_r(p, ":", &p);        
-          if (isnumeric(token) && (day = atoi (token)) && 
-               (
-                 ( (day>=1  && day<=31) && (month==1 || month==3 || month==5 || month==7 || month==8 || month==10 || month==12) ) ||
-                 ( (day>=1  && day<=30) && (month==4 || month==6 || month==9 || month==11) ) ||
-                 ( (day>=1  && day<=28) && (month==2) ) ||
-                 ( (day==29)            && (month==2) && ( (year%400==0) || ( (year%4==0) && (year%100!=0) ) ) )
-                ) 
-             ) {
-            token = strtok_r(p, ":", &p);
-            hour = atoi (token);
-            if ( (isnumeric(token) && (hour >= 0) && (hour <= 23)) ) {
-              token = strtok_r(p, ":", &p);
-              minute = atoi (token);
-              if ( (isnumeric(token) && (minute >= 0) && (minute <= 59)) ) {
-                token = strtok_r(p, "\r", &p);
-                second = atoi (token);
-                if ( (isnumeric(token) && (second >= 0) && (second <= 59)) ) { 
-                  sprintf (msgbuf, ">%d.%d.%d.%d.%d.%d", 
-                     year, month, day, hour, minute, second);
-                  rtc.adjust(DateTime(year, month, day, hour, minute, second));
-                  Output("RTC: Set");
-                  RTC_valid = true;
-                  rtc_timestamp();
-                  sprintf (msgbuf, "%s=", timestamp);
-                  Output (msgbuf);
-                  return(true);
-                }
-                else {
-                  sprintf (msgbuf, "Invalid Second: %s", token);
-                  Output(msgbuf);
-                  return(false);
-                }
-              }
-              else {
-                sprintf (msgbuf, "Invalid Minute: %s", token);
-                Output(msgbuf);
-                return(false);
-              }
+        if ( (isnumeric(token) && ((hour = atoi (token)) >= 0) && (hour <= 23)) ) {
+          token = strtok_r(p, ":", &p);
+          if ( (isnumeric(token) && ((minute = atoi (token)) >= 0) && (minute <= 59)) ) {
+            token = strtok_r(p, "\r", &p);
+            if ( (isnumeric(token) && ((second = atoi (token)) >= 0) && (second <= 59)) ) { 
+              sprintf (msgbuf, ">%d.%d.%d.%d.%d.%d", 
+                 year, month, day, hour, minute, second);
+              rtc_drift(DateTime(year, month, day, hour, minute, second).unixtime());
+              rtc.adjust(DateTime(year, month, day, hour, minute, second));
+              tm_synced = false;
+              tm_ts_day = 0;
+              Output("RTC: Set");
+              RTC_valid = true;
+              rtc_timestamp();
+              sprintf (msgbuf, "%s=", timestamp);
+              Output (msgbuf);
+              return(true);
             }
             else {
-              sprintf (msgbuf, "Invalid Hour: %s", token);
+              sprintf (msgbuf, "Invalid Second: %s", token);
               Output(msgbuf);
               return(false);
             }
           }
           else {
-            sprintf (msgbuf, "Invalid Day: %s", token);
+            sprintf (msgbuf, "Invalid Minute: %s", token);
             Output(msgbuf);
             return(false);
           }
         }
         else {
-          sprintf (msgbuf, "Invalid Month: %s", token);
+          sprintf (msgbuf, "Invalid Hour: %s", token);
           Output(msgbuf);
           return(false);
-        }                
+        }
       }
       else {
-        sprintf (msgbuf, "Invalid Year: %s", token);
+        sprintf (msgbuf, "Invalid Day: %s", token);
         Output(msgbuf);
         return(false);
       }
-    } // if line
-  } // while
-  return(false);
+    }
+    else {
+      sprintf (msgbuf, "Invalid Month: %s", token);
+      Output(msgbuf);
+      return(false);
+    }                
+  }
+  else {
+    sprintf (msgbuf, "Invalid Year: %s", token);
+    Output(msgbuf);
+    return(false);
+  }
 }
@@ -0,0 +1,265 @@
+/*
+ * ======================================================================================================================
+ *  WD.h - Watchdog and Phase Budgets
+ *
+ *  Each phase of an observation cycle has a budget from ph_budget_ms(). The waits the sketch owns (gauge power settle,
+ *  the gauge window, the serial gauge) ask ph_over() each pass and, once OBS_Do() has called ph_begin() for the
+ *  phase, give up when it has run past its budget, the cycle goes on with what it has. A phase that overran,
+ *  abandoned or not, is printed by ph_end() and sets SSB_OVERRUN in the next record built.
+ *
+ *  A wait that never comes back, in Wire, the SD library or USB, is caught by the WDT. It runs from GCLK7
+ *  (OSCULP32K / 32 = 1024 Hz) with an 8 s period, ph_over() and ph_end() feed it. 4 s without a feed the early
+ *  warning interrupt notes the phase that was running in memory a reset keeps, 4 s later the WDT resets the board.
+ *  At boot that phase is printed and SSB_WDT is set until the first observation is logged. Sleeps are longer than
+ *  the longest WDT period, so obs_sleep() stops it with wd_sleep() and starts it again with wd_wake().
+ * ======================================================================================================================
+ */
+
+/*
+ * ======================================================================================================================
+ *  Awake Time Accounting - micros() between phase marks is added to the phase just finished. micros() stops while
+ *    in LowPower.sleep() so only awake time is counted. With obs_tm set the previous cycle is added to the record as
+ *    "tm":[wake,i2c,sg,bmx,mcp,ds,fmt,sd,out,sleep,arch] in ms, the current cycle is not done until after it is logged.
+ * ======================================================================================================================
+ */
+#define PH_WAKE           0         // Sleep return to obs_schedule(), display wake
+#define PH_I2C            1         // I2C_Check_Sensors()
+#define PH_SG             2         // sn_start_all(), s_gauge_median()
+#define PH_BMX            3         // Bosch reads
+#define PH_MCP            4         // MCP9808 read
+#define PH_DS             5         // Battery and DS18B20 reads
+#define PH_FMT            6         // Timestamp and building the JSON
+#define PH_SD             7         // SD_LogObservation(), binary record
+#define PH_OUT            8         // OLED and Serial output
+#define PH_SLEEP          9         // Sleep entry, display off
+#define PH_ARCH           10        // ar_service(), log archiver (AR.h), run before the sleep entry
+#define PH_COUNT          11
+#define PH_NONE           0xFF      // No phase ended yet
+
+void en_mark(int phase);            // EN.h, energy at each phase boundary
+
+const char *ph_names[PH_COUNT] = {"wake", "i2c", "sg", "bmx", "mcp", "ds", "fmt", "sd", "out", "sleep", "arch"};
+
+unsigned long ph_us[PH_COUNT];      // This cycle
+unsigned long ph_last[PH_COUNT];    // Last complete cycle
+unsigned long ph_mark_us = 0;
+bool ph_last_valid = false;
+uint16_t ph_overran = 0;            // Phases over budget since the last record, bit per phase
+uint8_t ph_current = PH_NONE;       // Last phase ended, the one after it is running
+uint8_t ph_enforced = PH_NONE;      // Phase whose waits ph_over() may cut short, until it ends
+
+/*
+ * ======================================================================================================================
+ *  Watchdog
+ * ======================================================================================================================
+ */
+#define WD_GCLK           7         // OSCULP32K / 32, 1024 Hz, free of LowPower (6) and RTCZero (2)
+#define WD_MAGIC          0x57445400 // wd_noted, low byte is the phase
+
+bool wd_running = false;
+bool wd_reset = false;              // This boot is a WDT reset
+uint32_t wd_noted __attribute__ ((section (".noinit")));  // Set by the early warning, kept over the reset
+
+/*
+ * ======================================================================================================================
+ * ph_budget_ms() - Most a phase may take, the gauge window follows its config
+ * ======================================================================================================================
+ */
+unsigned long ph_budget_ms(int phase) {
+  static const unsigned long budget[PH_COUNT] = {5000, 2000, 0, 500, 500, 2000, 500, 5000, 5000, 5000, 0};
+
+  if (phase == PH_SG) {
+    return ((unsigned long) cf_sg_samples * cf_sg_interval + cf_sg_settle + 2000);
+  }
+  if (phase == PH_ARCH) {
+    return ((unsigned long) cf_ar_ms + 1000);  // A read or write started just before ar_ms is let finish
+  }
+  return (budget[phase]);
+}
+
+/*
+ * ======================================================================================================================
+ * wd_sync() - Wait out a WDT register write
+ * ======================================================================================================================
+ */
+void wd_sync() {
+  while (WDT->STATUS.bit.SYNCBUSY);
+}
+
+/*
+ * ======================================================================================================================
+ * wd_feed() - Restart the WDT period
+ * ======================================================================================================================
+ */
+void wd_feed() {
+  if (wd_running && !WDT->STATUS.bit.SYNCBUSY) {
+    WDT->CLEAR.reg = WDT_CLEAR_CLEAR_KEY;  // A clear still syncing from the last feed is as good
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * WDT_Handler() - Early warning, note the phase before the reset
+ * ======================================================================================================================
+ */
+void WDT_Handler() {
+  WDT->INTFLAG.reg = WDT_INTFLAG_EW;
+  wd_noted = WD_MAGIC | ph_current;
+}
+
+/*
+ * ======================================================================================================================
+ * wd_sleep() - Stop the WDT for LowPower.sleep()
+ * ======================================================================================================================
+ */
+void wd_sleep() {
+  if (wd_running) {
+    WDT->CTRL.bit.ENABLE = 0;
+    wd_sync();
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * wd_wake() - Start it again after LowPower.sleep()
+ * ======================================================================================================================
+ */
+void wd_wake() {
+  if (wd_running) {
+    WDT->CTRL.bit.ENABLE = 1;
+    wd_sync();
+    wd_feed();
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * wd_boot() - Was the last reset ours, call early in setup()
+ * ======================================================================================================================
+ */
+void wd_boot() {
+  uint8_t p = wd_noted & 0xFF;
+
+  if (PM->RCAUSE.reg & PM_RCAUSE_WDT) {  // .bit.WDT is hidden by the WDT instance macro
+    wd_reset = true;
+    SystemStatusBits |= SSB_WDT;
+    ev_record (EV_WD_RESET, ((wd_noted & 0xFFFFFF00) == WD_MAGIC) ? p : PH_NONE);
+    if ((wd_noted & 0xFFFFFF00) != WD_MAGIC) {
+      Output ("WD:Reset");
+    }
+    else {
+      LOG_ERR ("WD:Reset after %s", (p < PH_COUNT) ? ph_names[p] : "boot");
+    }
+  }
+  wd_noted = 0;
+}
+
+/*
+ * ======================================================================================================================
+ * wd_initialize() - Start the WDT, 8 s period, early warning at 4 s
+ * ======================================================================================================================
+ */
+void wd_initialize() {
+  if (!cf_wdt) {
+    Output ("WD:Off");
+    return;
+  }
+
+  GCLK->GENDIV.reg = GCLK_GENDIV_ID(WD_GCLK) | GCLK_GENDIV_DIV(4);  // DIVSEL, 2^(4+1)
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(WD_GCLK) | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_OSCULP32K |
+                      GCLK_GENCTRL_DIVSEL;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  GCLK->CLKCTRL.reg = (uint16_t) (GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK7 | GCLK_CLKCTRL_ID_WDT);
+  while (GCLK->STATUS.bit.SYNCBUSY);
+
+  WDT->CTRL.reg = 0;
+  wd_sync();
+  WDT->CONFIG.reg = WDT_CONFIG_PER_8K;
+  WDT->EWCTRL.reg = WDT_EWCTRL_EWOFFSET_4K;
+  wd_sync();
+  WDT->INTFLAG.reg = WDT_INTFLAG_EW;
+  WDT->INTENSET.reg = WDT_INTENSET_EW;
+  NVIC_SetPriority(WDT_IRQn, 0);
+  NVIC_EnableIRQ(WDT_IRQn);
+  WDT->CTRL.bit.ENABLE = 1;
+  wd_sync();
+  wd_running = true;
+  Output ("WD:OK");
+}
+
+/*
+ * ======================================================================================================================
+ * ph_start() - Start a cycle, keep the one just finished for the next record
+ * ======================================================================================================================
+ */
+void ph_start(bool cycle_done) {
+  if (cycle_done) {
+    memcpy (ph_last, ph_us, sizeof(ph_last));
+    ph_last_valid = true;
+  }
+  memset (ph_us, 0, sizeof(ph_us));
+  ph_mark_us = micros();
+  ph_current = PH_NONE;
+  en_mark(PH_NONE);
+  wd_feed();
+}
+
+/*
+ * ======================================================================================================================
+ * ph_begin() - Waits of phase give up at its budget until ph_end(), the same waits outside a cycle do not
+ * ======================================================================================================================
+ */
+void ph_begin(int phase) {
+  ph_enforced = phase;
+}
+
+/*
+ * ======================================================================================================================
+ * ph_over() - The running phase is past its budget, a wait gives up. Feeds the WDT while it is not.
+ * ======================================================================================================================
+ */
+bool ph_over(int phase) {
+  if ((phase == ph_enforced) && ((micros() - ph_mark_us) > (ph_budget_ms(phase) * 1000))) {
+    return (true);
+  }
+  wd_feed();
+  return (false);
+}
+
+/*
+ * ======================================================================================================================
+ * ph_end() - Charge the time since the last mark to phase
+ * ======================================================================================================================
+ */
+void ph_end(int phase) {
+  unsigned long t = micros();
+  char buf[32];                     // msgbuf may hold the record
+
+  if ((t - ph_mark_us) > (ph_budget_ms(phase) * 1000)) {
+    ph_overran |= (1 << phase);
+    ev_record (EV_PH_OVERRUN, phase);
+    sprintf (buf, "PH:%s Overrun %lums", ph_names[phase], (t - ph_mark_us) / 1000);
+    Output (buf);
+  }
+  ph_us[phase] += t - ph_mark_us;
+  ph_mark_us = t;
+  en_mark(phase);
+  ph_current = phase;
+  ph_enforced = PH_NONE;
+  wd_feed();
+}
+
+/*
+ * ======================================================================================================================
+ * ph_status() - SSB_OVERRUN for the record being built, overruns after it go in the next
+ * ======================================================================================================================
+ */
+void ph_status() {
+  if (ph_overran) {
+    SystemStatusBits |= SSB_OVERRUN;
+  }
+  else {
+    SystemStatusBits &= ~SSB_OVERRUN;
+  }
+  ph_overran = 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * ======================================================================================================================
+ *  WS.h - Warm Start
+ *
+ *  With warm=1 the runtime state the observations build up is written to WS_FILE after each observation: the gauge
+ *  QC ring, the deadband and cadence baselines, the slot last observed, the hour and day summaries, the trend ring,
+ *  the power profile and runtime estimate, the burst schedule, the Bosch fusion bias, the raw capture count and the
+ *  DS18B20 probes found. ws_regions[] lists the variables, they are packed one after the other into WS_BLOCKS blocks,
+ *  each with a header and a CRC32 (SF.h dsu_crc32()). WS_FILE is contiguous and holds two snapshots that take turns,
+ *  written by raw block writes, so a write torn by a brownout leaves the one before it whole.
+ *
+ *  At boot ws_restore() takes the newest whole snapshot back when it was written by this sketch (its version and
+ *  the sizes of the regions), with the same I2C parts answering the boot scan and every config key at the same
+ *  value, and no more than two intervals ago: a reset mid-season, not a station brought back after a while. A warm
+ *  start skips the DS18B20 check and boot reading and the boot pause. The I2C drivers are set up as always, the
+ *  parts lost their settings with the power. SSB_PWRON and EV_BOOT still mark the reset in the record.
+ * ======================================================================================================================
+ */
+#define WS_FILE           "/OBS/WARM.bin"
+#define WS_MAGIC          0x4D524157        // "WARM"
+#define WS_BLOCKS         4                 // Blocks of a snapshot, two of them in WS_FILE
+#define WS_DATA           (512 - sizeof(WS_HDR))
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;                           // WS_MAGIC
+  uint32_t seq;                             // Snapshot, every block of it has the same
+  uint32_t at;                              // Unix time of the observation
+  uint32_t interval;                        // obs_interval_s then
+  uint32_t layout;                          // ws_layout() of the sketch that wrote it
+  uint32_t print;                           // ws_print of the boot that wrote it
+  uint16_t block;                           // Place in the snapshot
+  uint16_t len;                             // Bytes of state after this
+  uint32_t crc;                             // CRC32 of the above and the state
+} WS_HDR;                                   // 32 bytes
+
+typedef struct {
+  void     *p;
+  uint16_t size;
+} WS_REGION;
+
+#define WS_REG(v)         { (void *) &(v), sizeof(v) }
+
+const WS_REGION ws_regions[] = {
+  WS_REG(obs_qc_ring), WS_REG(obs_qc_n), WS_REG(obs_qc_pos), WS_REG(obs_qc_at), WS_REG(obs_qc_last),
+  WS_REG(obs_qc_run), WS_REG(obs_qc_raw),
+  WS_REG(obs_db_valid), WS_REG(obs_db_at), WS_REG(obs_db_sg), WS_REG(obs_db_t), WS_REG(obs_db_tn),
+  WS_REG(obs_db_hth), WS_REG(obs_skip_n), WS_REG(obs_skip_lo), WS_REG(obs_skip_hi),
+  WS_REG(obs_cad_valid), WS_REG(obs_cad_at), WS_REG(obs_cad_sg), WS_REG(obs_cad_t), WS_REG(obs_cad_tn),
+  WS_REG(obs_cad_steady), WS_REG(obs_cadence), WS_REG(obs_last_slot), WS_REG(obs_last_interval), WS_REG(obs_gap),
+  WS_REG(sum_hour), WS_REG(sum_day), WS_REG(obs_tr), WS_REG(obs_tr_slot), WS_REG(obs_tr_mm),
+  WS_REG(pwr_profile), WS_REG(pwr_vavg), WS_REG(pwr_vtrend), WS_REG(pwr_rt_minutes), WS_REG(pwr_rt_save),
+  WS_REG(pwr_rt_rate), WS_REG(pwr_rt_known), WS_REG(pwr_rt_days), WS_REG(pwr_rt_at), WS_REG(pwr_rt_v),
+  WS_REG(sg_burst), WS_REG(sg_burst_quiet), WS_REG(sg_event_mm),
+  WS_REG(bmx_fuse_known), WS_REG(bmx_fuse_bp), WS_REG(bmx_fuse_bt),
+  WS_REG(sg_raw_last), WS_REG(sg_raw_day), WS_REG(sg_raw_n),
+  WS_REG(ds_found), WS_REG(ds_count), WS_REG(ds_addr),
+};
+#define WS_REGIONS        (sizeof(ws_regions) / sizeof(ws_regions[0]))
+
+bool     ws_warm = false;                   // This boot took a snapshot back
+bool     ws_open = false;                   // WS_FILE found and ws_bgn set
+uint32_t ws_bgn;                            // Its first SD block
+uint32_t ws_seq = 0;                        // Last snapshot written or taken
+uint32_t ws_print = 0;                      // Hardware and config of this boot
+
+/*
+ *=======================================================================================================================
+ * ws_open_file() - Find or create WS_FILE, false if it can not be used
+ *=======================================================================================================================
+ */
+bool ws_open_file() {
+  uint32_t bgn, end;
+  File fp;
+
+  if (ws_open) {
+    return (true);
+  }
+  if (!SD_exists || SD_down) {
+    return (false);
+  }
+  fp = (SD.exists(WS_FILE)) ? SD.open(WS_FILE, FILE_READ) : SD.createContiguous(WS_FILE, 2 * WS_BLOCKS * 512UL);
+  if (!fp) {
+    return (false);
+  }
+  if ((fp.size() != 2 * WS_BLOCKS * 512UL) || !fp.contiguousRange(&bgn, &end)) {
+    fp.close();
+    return (false);
+  }
+  fp.close();
+  ws_bgn = bgn;
+  ws_open = true;
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ws_layout() - CRC32 of the version and the region sizes, a sketch with other state does not take the snapshot
+ *=======================================================================================================================
+ */
+uint32_t ws_layout() {
+  uint32_t crc = dsu_crc32(VERSION_INFO, strlen(VERSION_INFO), 0);
+
+  for (unsigned int i=0; i<WS_REGIONS; i++) {
+    crc = dsu_crc32(&ws_regions[i].size, sizeof(ws_regions[i].size), crc);
+  }
+  return (crc);
+}
+
+/*
+ *=======================================================================================================================
+ * ws_crc() - CRC32 of a block's header and state
+ *=======================================================================================================================
+ */
+uint32_t ws_crc(const uint8_t *buf) {
+  const WS_HDR *h = (const WS_HDR *) buf;
+  uint32_t crc = dsu_crc32(buf, offsetof(WS_HDR, crc), 0);
+
+  return (dsu_crc32(buf + sizeof(WS_HDR), (h->len < WS_DATA) ? h->len : WS_DATA, crc));
+}
+
+/*
+ *=======================================================================================================================
+ * ws_move() - Copy block b's share of the regions into its state (save) or back out of it, return the bytes
+ *=======================================================================================================================
+ */
+int ws_move(uint8_t *data, uint32_t b, bool save) {
+  uint32_t bgn = b * WS_DATA;
+  uint32_t end = bgn + WS_DATA;
+  uint32_t at = 0, lo, hi;
+  int len = 0;
+
+  for (unsigned int i=0; i<WS_REGIONS; i++) {
+    lo = (at > bgn) ? at : bgn;
+    hi = ((at + ws_regions[i].size) < end) ? at + ws_regions[i].size : end;
+    if (lo < hi) {
+      if (save) {
+        memcpy (data + (lo - bgn), (uint8_t *) ws_regions[i].p + (lo - at), hi - lo);
+      }
+      else {
+        memcpy ((uint8_t *) ws_regions[i].p + (lo - at), data + (lo - bgn), hi - lo);
+      }
+      len = hi - bgn;
+    }
+    at += ws_regions[i].size;
+  }
+  return (len);
+}
+
+/*
+ *=======================================================================================================================
+ * ws_check() - Header of a whole snapshot in slot, false if a block is torn or it is not ours
+ *=======================================================================================================================
+ */
+bool ws_check(int slot, WS_HDR *hdr) {
+  uint8_t *buf = SdVolume::cacheClear();
+  const WS_HDR *h = (const WS_HDR *) buf;
+  uint32_t layout = ws_layout();
+
+  for (uint16_t b=0; b<WS_BLOCKS; b++) {
+    if (!SdVolume::sdCard()->readBlock(ws_bgn + (slot * WS_BLOCKS) + b, buf) || (h->magic != WS_MAGIC) ||
+        (h->block != b) || (h->layout != layout) || (h->crc != ws_crc(buf)) || (b && (h->seq != hdr->seq))) {
+      return (false);
+    }
+    if (b == 0) {
+      *hdr = *h;
+    }
+  }
+  return (true);
+}
+
+/*
+ *=======================================================================================================================
+ * ws_restore() - Take back the newest snapshot when it fits this boot, after the config, SD card and RTC are up
+ *=======================================================================================================================
+ */
+void ws_restore() {
+  WS_HDR h[2];
+  bool ok[2];
+  uint32_t now_s = tm_now();
+  uint8_t *buf;
+  int s;
+
+  ws_print = dsu_crc32(i2c_present, sizeof(i2c_present), 0);
+  for (unsigned int i=0; i<CF_KEY_COUNT; i++) {
+    ws_print = dsu_crc32(cf_keys[i].value, sizeof(int), ws_print);
+  }
+  ws_print = dsu_crc32(sg_cal, sg_cal_n * sizeof(SG_CAL_PT), ws_print);  // State in mm on this calibration
+  if (!cf_warm || !RTC_valid || !ws_open_file()) {
+    return;
+  }
+  for (s=0; s<2; s++) {
+    ok[s] = ws_check(s, &h[s]);
+  }
+  if (!ok[0] && !ok[1]) {
+    LOG_INFO ("WS:Cold");
+    return;
+  }
+  s = (ok[1] && (!ok[0] || ((int32_t) (h[1].seq - h[0].seq) > 0))) ? 1 : 0;
+  ws_seq = h[s].seq;
+  if ((h[s].print != ws_print) || (now_s < h[s].at) || ((now_s - h[s].at) > 2 * h[s].interval)) {
+    LOG_INFO ("WS:Cold %lus", (unsigned long) (now_s - h[s].at));
+    return;
+  }
+
+  buf = SdVolume::cacheClear();
+  for (uint32_t b=0; b<WS_BLOCKS; b++) {
+    if (!SdVolume::sdCard()->readBlock(ws_bgn + (s * WS_BLOCKS) + b, buf)) {
+      LOG_ERR ("WS:Read Err");  // Read a moment ago, the state is part taken
+      return;
+    }
+    ws_move(buf + sizeof(WS_HDR), b, false);
+  }
+  ws_warm = true;
+  LOG_INFO ("WS:Warm %lu %lus", (unsigned long) ws_seq, (unsigned long) (now_s - h[s].at));
+}
+
+/*
+ *=======================================================================================================================
+ * ws_resume() - Put the modules back on the state taken, after the sensors are set up
+ *=======================================================================================================================
+ */
+void ws_resume() {
+  if (!ws_warm) {
+    return;
+  }
+  pwr_apply(pwr_profile);  // Interval on the burst schedule or the cadence, sample count and the SSB_PWR bits
+  if (sg_burst) {
+    SystemStatusBits |= SSB_SG_BURST;  // Turn On Bit
+  }
+}
+
+/*
+ *=======================================================================================================================
+ * ws_save() - Write the snapshot into the older slot, call after the observation is logged
+ *=======================================================================================================================
+ */
+void ws_save() {
+  Sd2Card *card = SdVolume::sdCard();
+  uint32_t seq = ws_seq + 1;
+  uint32_t layout, size = 0;
+  uint8_t *buf;
+  WS_HDR *h;
+  bool ok;
+
+  if (!cf_warm || !RTC_valid || !ws_open_file()) {
+    return;
+  }
+  for (unsigned int i=0; i<WS_REGIONS; i++) {
+    size += ws_regions[i].size;
+  }
+  if (size > WS_BLOCKS * WS_DATA) {
+    LOG_ERR ("WS:State %lu Bytes", (unsigned long) size);  // ws_regions[] outgrew WS_BLOCKS
+    return;
+  }
+  layout = ws_layout();
+  buf = SdVolume::cacheClear();
+  h = (WS_HDR *) buf;
+  ok = card->writeStart(ws_bgn + ((seq & 1) * WS_BLOCKS), WS_BLOCKS);
+  for (uint16_t b=0; ok && (b<WS_BLOCKS); b++) {
+    memset (buf, 0, 512);
+    h->magic = WS_MAGIC;
+    h->seq = seq;
+    h->at = tm_now();
+    h->interval = obs_interval_s;
+    h->layout = layout;
+    h->print = ws_print;
+    h->block = b;
+    h->len = ws_move(buf + sizeof(WS_HDR), b, true);
+    h->crc = ws_crc(buf);
+    ok = card->writeData(buf);
+  }
+  ok = card->writeStop() && ok;
+  if (ok) {
+    ws_seq = seq;
+  }
+  else {
+    Output ("WS:Write Err");
+  }
+}
@@ -296,6 +296,28 @@ bool Adafruit_BME280::takeForcedMeasurement(void) {
   return return_value;
 }
 
+/*!
+ *  @brief  Start a new measurement and return at once (only possible in
+ *          forced mode), poll measuring() for the end of the conversion
+    @returns true if a conversion was started else false
+ */
+bool Adafruit_BME280::startForcedMeasurement(void) {
+  if (_measReg.mode == MODE_FORCED) {
+    write8(BME280_REGISTER_CONTROL, _measReg.get());
+    return true;
+  }
+  return false;
+}
+
+/*!
+ *  @brief  Check the status register for a conversion in progress
+    @returns true while converting, false once the result registers are
+    loaded
+ */
+bool Adafruit_BME280::measuring(void) {
+  return (read8(BME280_REGISTER_STATUS) & 0x08) != 0;
+}
+
 /*!
  *   @brief  Reads the factory-set coefficients
  */
@@ -339,11 +361,29 @@ bool Adafruit_BME280::isReadingCalibration(void) {
  *   @returns the temperature read from the device
  */
 float Adafruit_BME280::readTemperature(void) {
-  int32_t var1, var2;
+  return compensateTemperature(read24(BME280_REGISTER_TEMPDATA));
+}
 
-  int32_t adc_T = read24(BME280_REGISTER_TEMPDATA);
+/*!
+ *   @brief  Compensates a raw temperature reading and sets t_fine
+ *   @param adc_T the 20 bit reading left aligned in 24 bits
+ *   @returns the temperature in degrees Celsius
+ */
+float Adafruit_BME280::compensateTemperature(int32_t adc_T) {
   if (adc_T == 0x800000) // value in case temp measurement was disabled
     return NAN;
+
+  return (float)compensateTemperatureFixed(adc_T) / 100;
+}
+
+/*!
+ *   @brief  Integer temperature compensation, sets t_fine
+ *   @param adc_T the 20 bit reading left aligned in 24 bits
+ *   @returns the temperature in degrees Celsius * 100
+ */
+int32_t Adafruit_BME280::compensateTemperatureFixed(int32_t adc_T) {
+  int32_t var1, var2;
+
   adc_T >>= 4;
 
   var1 = (int32_t)((adc_T / 8) - ((int32_t)_bme280_calib.dig_T1 * 2));
@@ -353,9 +393,7 @@ float Adafruit_BME280::readTemperature(void) {
 
   t_fine = var1 + var2 + t_fine_adjust;
 
-  int32_t T = (t_fine * 5 + 128) / 256;
-
-  return (float)T / 100;
+  return (t_fine * 5 + 128) / 256;
 }
 
 /*!
@@ -363,13 +401,45 @@ float Adafruit_BME280::readTemperature(void) {
  *   @returns the pressure value (in Pascal) read from the device
  */
 float Adafruit_BME280::readPressure(void) {
-  int64_t var1, var2, var3, var4;
-
   readTemperature(); // must be done first to get t_fine
 
-  int32_t adc_P = read24(BME280_REGISTER_PRESSUREDATA);
+  return compensatePressure(read24(BME280_REGISTER_PRESSUREDATA));
+}
+
+/*!
+ *   @brief  Compensates a raw pressure reading, t_fine must be current
+ *   @param adc_P the 20 bit reading left aligned in 24 bits
+ *   @returns the pressure in Pascal
+ */
+float Adafruit_BME280::compensatePressure(int32_t adc_P) {
   if (adc_P == 0x800000) // value in case pressure measurement was disabled
     return NAN;
+
+  return compensatePressureFixed(adc_P) / 256.0;
+}
+
+/*!
+ *   @brief  Integer pressure compensation, t_fine must be current. The 32 bit
+ *           formula when BME280_PRESSURE_INT32 is defined
+ *   @param adc_P the 20 bit reading left aligned in 24 bits
+ *   @returns the pressure in Pascal * 256 (Q24.8)
+ */
+uint32_t Adafruit_BME280::compensatePressureFixed(int32_t adc_P) {
+#ifdef BME280_PRESSURE_INT32
+  return compensatePressure32(adc_P);
+#else
+  return compensatePressure64(adc_P);
+#endif
+}
+
+/*!
+ *   @brief  Bosch 64 bit integer pressure compensation, t_fine must be current
+ *   @param adc_P the 20 bit reading left aligned in 24 bits
+ *   @returns the pressure in Pascal * 256 (Q24.8)
+ */
+uint32_t Adafruit_BME280::compensatePressure64(int32_t adc_P) {
+  int64_t var1, var2, var3, var4;
+
   adc_P >>= 4;
 
   var1 = ((int64_t)t_fine) - 128000;
@@ -392,9 +462,45 @@ float Adafruit_BME280::readPressure(void) {
   var2 = (((int64_t)_bme280_calib.dig_P8) * var4) / 524288;
   var4 = ((var4 + var1 + var2) / 256) + (((int64_t)_bme280_calib.dig_P7) * 16);
 
-  float P = var4 / 256.0;
+  return (uint32_t)var4;
+}
 
-  return P;
+/*!
+ *   @brief  Bosch 32 bit integer pressure compensation, t_fine must be current
+ *   @param adc_P the 20 bit reading left aligned in 24 bits
+ *   @returns the pressure in Pascal * 256, the low 8 bits are 0
+ */
+uint32_t Adafruit_BME280::compensatePressure32(int32_t adc_P) {
+  int32_t var1, var2;
+  uint32_t p;
+
+  adc_P >>= 4;
+
+  var1 = (((int32_t)t_fine) >> 1) - (int32_t)64000;
+  var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)_bme280_calib.dig_P6);
+  var2 = var2 + ((var1 * ((int32_t)_bme280_calib.dig_P5)) << 1);
+  var2 = (var2 >> 2) + (((int32_t)_bme280_calib.dig_P4) << 16);
+  var1 = (((_bme280_calib.dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) +
+          ((((int32_t)_bme280_calib.dig_P2) * var1) >> 1)) >>
+         18;
+  var1 = ((((32768 + var1)) * ((int32_t)_bme280_calib.dig_P1)) >> 15);
+
+  if (var1 == 0) {
+    return 0; // avoid exception caused by division by zero
+  }
+  p = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+  if (p < 0x80000000) {
+    p = (p << 1) / ((uint32_t)var1);
+  } else {
+    p = (p / (uint32_t)var1) * 2;
+  }
+  var1 = (((int32_t)_bme280_calib.dig_P9) *
+          ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >>
+         12;
+  var2 = (((int32_t)(p >> 2)) * ((int32_t)_bme280_calib.dig_P8)) >> 13;
+  p = (uint32_t)((int32_t)p + ((var1 + var2 + _bme280_calib.dig_P7) >> 4));
+
+  return p << 8;
 }
 
 /*!
@@ -402,14 +508,31 @@ float Adafruit_BME280::readPressure(void) {
  *  @returns the humidity value read from the device
  */
 float Adafruit_BME280::readHumidity(void) {
-  int32_t var1, var2, var3, var4, var5;
-
   readTemperature(); // must be done first to get t_fine
 
-  int32_t adc_H = read16(BME280_REGISTER_HUMIDDATA);
+  return compensateHumidity(read16(BME280_REGISTER_HUMIDDATA));
+}
+
+/*!
+ *   @brief  Compensates a raw humidity reading, t_fine must be current
+ *   @param adc_H the 16 bit reading
+ *   @returns the relative humidity in percent
+ */
+float Adafruit_BME280::compensateHumidity(int32_t adc_H) {
   if (adc_H == 0x8000) // value in case humidity measurement was disabled
     return NAN;
 
+  return (float)compensateHumidityFixed(adc_H) / 1024.0;
+}
+
+/*!
+ *   @brief  Integer humidity compensation, t_fine must be current
+ *   @param adc_H the 16 bit reading
+ *   @returns the relative humidity in percent * 1024 (Q22.10)
+ */
+uint32_t Adafruit_BME280::compensateHumidityFixed(int32_t adc_H) {
+  int32_t var1, var2, var3, var4, var5;
+
   var1 = t_fine - ((int32_t)76800);
   var2 = (int32_t)(adc_H * 16384);
   var3 = (int32_t)(((int32_t)_bme280_calib.dig_H4) * 1048576);
@@ -424,9 +547,80 @@ float Adafruit_BME280::readHumidity(void) {
   var5 = var3 - ((var4 * ((int32_t)_bme280_calib.dig_H1)) / 16);
   var5 = (var5 < 0 ? 0 : var5);
   var5 = (var5 > 419430400 ? 419430400 : var5);
-  uint32_t H = (uint32_t)(var5 / 4096);
 
-  return (float)H / 1024.0;
+  return (uint32_t)(var5 / 4096);
+}
+
+/*!
+ *   @brief  Reads temperature, pressure and humidity with one burst read of
+ *           the data registers 0xF7-0xFE, so all three come from the same
+ *           conversion and the temperature is compensated once
+ *   @param temperature set to degrees Celsius
+ *   @param pressure set to Pascal
+ *   @param humidity set to percent relative humidity
+ */
+void Adafruit_BME280::readAll(float *temperature, float *pressure,
+                              float *humidity) {
+  int32_t adc_T, adc_P, adc_H;
+
+  readAllRaw(&adc_T, &adc_P, &adc_H);
+
+  *temperature = compensateTemperature(adc_T); // sets t_fine
+  if (isnan(*temperature)) {
+    *pressure = NAN;
+    *humidity = NAN;
+    return;
+  }
+  *pressure = compensatePressure(adc_P);
+  *humidity = compensateHumidity(adc_H);
+}
+
+/*!
+ *   @brief  readAll() with integer compensation only, no floating point
+ *   @param temperature set to degrees Celsius * 100
+ *   @param pressure set to Pascal * 256
+ *   @param humidity set to percent relative humidity * 1024
+ *   @returns false if a measurement was disabled (skipped)
+ */
+bool Adafruit_BME280::readAllFixed(int32_t *temperature, uint32_t *pressure,
+                                   uint32_t *humidity) {
+  int32_t adc_T, adc_P, adc_H;
+
+  readAllRaw(&adc_T, &adc_P, &adc_H);
+  if ((adc_T == 0x800000) || (adc_P == 0x800000) || (adc_H == 0x8000))
+    return false;
+
+  *temperature = compensateTemperatureFixed(adc_T); // sets t_fine
+  *pressure = compensatePressureFixed(adc_P);
+  *humidity = compensateHumidityFixed(adc_H);
+  return true;
+}
+
+/*!
+ *   @brief  Burst read of the data registers 0xF7-0xFE
+ *   @param adc_T set to the temperature reading left aligned in 24 bits
+ *   @param adc_P set to the pressure reading left aligned in 24 bits
+ *   @param adc_H set to the humidity reading
+ *   @returns true
+ */
+bool Adafruit_BME280::readAllRaw(int32_t *adc_T, int32_t *adc_P,
+                                 int32_t *adc_H) {
+  uint8_t buffer[8];
+
+  if (i2c_dev) {
+    buffer[0] = uint8_t(BME280_REGISTER_PRESSUREDATA);
+    i2c_dev->write_then_read(buffer, 1, buffer, 8);
+  } else {
+    buffer[0] = uint8_t(BME280_REGISTER_PRESSUREDATA | 0x80);
+    spi_dev->write_then_read(buffer, 1, buffer, 8);
+  }
+
+  *adc_P = int32_t(buffer[0]) << 16 | int32_t(buffer[1]) << 8 |
+           int32_t(buffer[2]);
+  *adc_T = int32_t(buffer[3]) << 16 | int32_t(buffer[4]) << 8 |
+           int32_t(buffer[5]);
+  *adc_H = int32_t(buffer[6]) << 8 | int32_t(buffer[7]);
+  return true;
 }
 
 /*!
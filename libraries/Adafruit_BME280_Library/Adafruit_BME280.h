@@ -30,6 +30,13 @@
 /*!
  *  @brief  default I2C address
  */
+/*!
+ *  Uncomment to compensate pressure with the Bosch 32 bit integer formula,
+ *  1 Pa resolution and no 64 bit multiplies or divides. Default is the 64 bit
+ *  formula, 1/256 Pa.
+ */
+// #define BME280_PRESSURE_INT32
+
 #define BME280_ADDRESS (0x77)           // Primary I2C Address
                                         /*!
                                          *  @brief  alternate I2C address
@@ -226,9 +233,16 @@ public:
                    standby_duration duration = STANDBY_MS_0_5);
 
   bool takeForcedMeasurement(void);
+  bool startForcedMeasurement(void);
+  bool measuring(void);
   float readTemperature(void);
   float readPressure(void);
   float readHumidity(void);
+  void readAll(float *temperature, float *pressure, float *humidity);
+  bool readAllFixed(int32_t *temperature, uint32_t *pressure,
+                    uint32_t *humidity);
+  uint32_t compensatePressure64(int32_t adc_P);
+  uint32_t compensatePressure32(int32_t adc_P);
 
   float readAltitude(float seaLevel);
   float seaLevelForAltitude(float altitude, float pressure);
@@ -254,6 +268,14 @@ protected:
   Adafruit_BME280_Humidity *humidity_sensor = NULL;
   //!< Adafruit_Sensor compat humidity sensor component
 
+  float compensateTemperature(int32_t adc_T);
+  float compensatePressure(int32_t adc_P);
+  float compensateHumidity(int32_t adc_H);
+  int32_t compensateTemperatureFixed(int32_t adc_T);
+  uint32_t compensatePressureFixed(int32_t adc_P);
+  uint32_t compensateHumidityFixed(int32_t adc_H);
+  bool readAllRaw(int32_t *adc_T, int32_t *adc_P, int32_t *adc_H);
+
   void readCoefficients(void);
   bool isReadingCalibration(void);
 
@@ -246,10 +246,20 @@ void Adafruit_BMP280::readCoefficients() {
  * @return The temperature in degress celcius.
  */
 float Adafruit_BMP280::readTemperature() {
-  int32_t var1, var2;
   if (!_sensorID)
     return NAN; // begin() not called yet
 
+  float T = readTemperatureFixed();
+  return T / 100;
+}
+
+/*!
+ * Reads the temperature with integer compensation only.
+ * @return The temperature in degrees celcius * 100.
+ */
+int32_t Adafruit_BMP280::readTemperatureFixed() {
+  int32_t var1, var2;
+
   int32_t adc_T = read24(BMP280_REGISTER_TEMPDATA);
   adc_T >>= 4;
 
@@ -265,8 +275,7 @@ float Adafruit_BMP280::readTemperature() {
 
   t_fine = var1 + var2;
 
-  float T = (t_fine * 5 + 128) >> 8;
-  return T / 100;
+  return (t_fine * 5 + 128) >> 8;
 }
 
 /*!
@@ -274,14 +283,36 @@ float Adafruit_BMP280::readTemperature() {
  * @return Barometric pressure in Pa.
  */
 float Adafruit_BMP280::readPressure() {
-  int64_t var1, var2, p;
   if (!_sensorID)
     return NAN; // begin() not called yet
 
+  return (float)readPressureFixed() / 256;
+}
+
+/*!
+ * Reads the barometric pressure with integer compensation only.
+ * @return Barometric pressure in Pa * 256 (Q24.8).
+ */
+uint32_t Adafruit_BMP280::readPressureFixed() {
   // Must be done first to get the t_fine variable set up
-  readTemperature();
+  readTemperatureFixed();
 
   int32_t adc_P = read24(BMP280_REGISTER_PRESSUREDATA);
+#ifdef BMP280_PRESSURE_INT32
+  return compensatePressure32(adc_P);
+#else
+  return compensatePressure64(adc_P);
+#endif
+}
+
+/*!
+ * Bosch 64 bit integer pressure compensation, t_fine must be current.
+ * @param adc_P the 20 bit reading left aligned in 24 bits
+ * @return Barometric pressure in Pa * 256 (Q24.8).
+ */
+uint32_t Adafruit_BMP280::compensatePressure64(int32_t adc_P) {
+  int64_t var1, var2, p;
+
   adc_P >>= 4;
 
   var1 = ((int64_t)t_fine) - 128000;
@@ -302,7 +333,45 @@ float Adafruit_BMP280::readPressure() {
   var2 = (((int64_t)_bmp280_calib.dig_P8) * p) >> 19;
 
   p = ((p + var1 + var2) >> 8) + (((int64_t)_bmp280_calib.dig_P7) << 4);
-  return (float)p / 256;
+  return (uint32_t)p;
+}
+
+/*!
+ * Bosch 32 bit integer pressure compensation, t_fine must be current.
+ * @param adc_P the 20 bit reading left aligned in 24 bits
+ * @return Barometric pressure in Pa * 256, the low 8 bits are 0.
+ */
+uint32_t Adafruit_BMP280::compensatePressure32(int32_t adc_P) {
+  int32_t var1, var2;
+  uint32_t p;
+
+  adc_P >>= 4;
+
+  var1 = (((int32_t)t_fine) >> 1) - (int32_t)64000;
+  var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)_bmp280_calib.dig_P6);
+  var2 = var2 + ((var1 * ((int32_t)_bmp280_calib.dig_P5)) << 1);
+  var2 = (var2 >> 2) + (((int32_t)_bmp280_calib.dig_P4) << 16);
+  var1 = (((_bmp280_calib.dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) +
+          ((((int32_t)_bmp280_calib.dig_P2) * var1) >> 1)) >>
+         18;
+  var1 = ((((32768 + var1)) * ((int32_t)_bmp280_calib.dig_P1)) >> 15);
+
+  if (var1 == 0) {
+    return 0; // avoid exception caused by division by zero
+  }
+  p = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+  if (p < 0x80000000) {
+    p = (p << 1) / ((uint32_t)var1);
+  } else {
+    p = (p / (uint32_t)var1) * 2;
+  }
+  var1 = (((int32_t)_bmp280_calib.dig_P9) *
+          ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >>
+         12;
+  var2 = (((int32_t)(p >> 2)) * ((int32_t)_bmp280_calib.dig_P8)) >> 13;
+  p = (uint32_t)((int32_t)p + ((var1 + var2 + _bmp280_calib.dig_P7) >> 4));
+
+  return p << 8;
 }
 
 /*!
@@ -374,6 +443,27 @@ bool Adafruit_BMP280::takeForcedMeasurement() {
   return false;
 }
 
+/*!
+    @brief  Start a new measurement and return at once (only possible in
+            forced mode), poll measuring() for the end of the conversion
+    @return true if a conversion was started, otherwise false
+ */
+bool Adafruit_BMP280::startForcedMeasurement() {
+  if (_measReg.mode == MODE_FORCED) {
+    write8(BMP280_REGISTER_CONTROL, _measReg.get());
+    return true;
+  }
+  return false;
+}
+
+/*!
+    @brief  Check the status register for a conversion in progress
+    @return true while converting, false once the result registers are loaded
+ */
+bool Adafruit_BMP280::measuring() {
+  return (read8(BMP280_REGISTER_STATUS) & 0x08) != 0;
+}
+
 /*!
  *  @brief  Resets the chip via soft reset
  */
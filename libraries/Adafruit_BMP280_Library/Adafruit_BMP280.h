@@ -31,6 +31,13 @@
 /*!
  *  I2C ADDRESS/BITS/SETTINGS
  */
+/*!
+ *  Uncomment to compensate pressure with the Bosch 32 bit integer formula,
+ *  1 Pa resolution and no 64 bit multiplies or divides. Default is the 64 bit
+ *  formula, 1/256 Pa.
+ */
+// #define BMP280_PRESSURE_INT32
+
 #define BMP280_ADDRESS (0x77) /**< The default I2C address for the sensor. */
 #define BMP280_ADDRESS_ALT                                                     \
   (0x76)                     /**< Alternative I2C address for the sensor. */
@@ -191,10 +198,16 @@ public:
 
   float readTemperature();
   float readPressure(void);
+  int32_t readTemperatureFixed(void);
+  uint32_t readPressureFixed(void);
+  uint32_t compensatePressure64(int32_t adc_P);
+  uint32_t compensatePressure32(int32_t adc_P);
   float readAltitude(float seaLevelhPa = 1013.25);
   float seaLevelForAltitude(float altitude, float atmospheric);
   float waterBoilingPoint(float pressure);
   bool takeForcedMeasurement();
+  bool startForcedMeasurement();
+  bool measuring();
 
   Adafruit_Sensor *getTemperatureSensor(void);
   Adafruit_Sensor *getPressureSensor(void);
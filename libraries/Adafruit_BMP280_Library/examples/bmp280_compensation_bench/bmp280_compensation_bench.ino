@@ -0,0 +1,62 @@
+/***************************************************************************
+  Cycles per pressure compensation, 64 bit and 32 bit Bosch integer formulas
+
+  Reads the sensor once for its calibration and t_fine, then runs each
+  formula RUNS times on the same raw reading and prints the average cycles
+  and the result. Cycles come from micros() and F_CPU, so the loop overhead
+  is included in both.
+
+  BSD license, all text above must be included in any redistribution
+ ***************************************************************************/
+
+#include <Wire.h>
+#include <Adafruit_BMP280.h>
+
+#define RUNS 1000
+
+Adafruit_BMP280 bmp; // I2C
+
+volatile uint32_t sink; // Keeps the loops from being optimized away
+
+uint32_t bench(uint32_t (Adafruit_BMP280::*fn)(int32_t), int32_t adc_P) {
+  uint32_t start = micros();
+
+  for (int i = 0; i < RUNS; i++) {
+    sink = (bmp.*fn)(adc_P + (i & 15)); // Vary the input a little
+  }
+  return ((micros() - start) * (F_CPU / 1000000UL)) / RUNS;
+}
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial)
+    delay(100); // wait for native usb
+  Serial.println(F("BMP280 compensation benchmark"));
+
+  if (!bmp.begin()) {
+    Serial.println(F("Could not find a valid BMP280 sensor"));
+    while (1)
+      delay(10);
+  }
+
+  bmp.readTemperature(); // Sets t_fine
+  int32_t adc_P = 415148L << 4; // Datasheet example, left aligned in 24 bits
+
+  uint32_t c64 = bench(&Adafruit_BMP280::compensatePressure64, adc_P);
+  uint32_t p64 = bmp.compensatePressure64(adc_P);
+  uint32_t c32 = bench(&Adafruit_BMP280::compensatePressure32, adc_P);
+  uint32_t p32 = bmp.compensatePressure32(adc_P);
+
+  Serial.print(F("64 bit: "));
+  Serial.print(c64);
+  Serial.print(F(" cycles, "));
+  Serial.print(p64 / 256.0, 2);
+  Serial.println(F(" Pa"));
+  Serial.print(F("32 bit: "));
+  Serial.print(c32);
+  Serial.print(F(" cycles, "));
+  Serial.print(p32 / 256.0, 2);
+  Serial.println(F(" Pa"));
+}
+
+void loop() {}
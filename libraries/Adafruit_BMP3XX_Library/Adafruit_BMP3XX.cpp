@@ -57,7 +57,10 @@ static int8_t cal_crc(uint8_t seed, uint8_t data);
 /**************************************************************************/
 Adafruit_BMP3XX::Adafruit_BMP3XX(void) {
   _meas_end = 0;
-  _filterEnabled = _tempOSEnabled = _presOSEnabled = false;
+  _filterEnabled = _tempOSEnabled = _presOSEnabled = _ODREnabled = false;
+  _settingsDirty = true;
+  _fifoEnabled = false;
+  the_sensor.fifo = NULL;
 }
 
 /**************************************************************************/
@@ -170,6 +173,9 @@ bool Adafruit_BMP3XX::begin_SPI(int8_t cs_pin, int8_t sck_pin, int8_t miso_pin,
 bool Adafruit_BMP3XX::_init(void) {
   g_i2c_dev = i2c_dev;
   g_spi_dev = spi_dev;
+  _settingsDirty = true;
+  _fifoEnabled = false; // Soft reset turns the FIFO off
+  _normalEnabled = false;
   the_sensor.delay_us = delay_usec;
   int8_t rslt = BMP3_OK;
 
@@ -260,6 +266,35 @@ float Adafruit_BMP3XX::readTemperature(void) {
 /**************************************************************************/
 uint8_t Adafruit_BMP3XX::chipID(void) { return the_sensor.chip_id; }
 
+/**************************************************************************/
+/*!
+    @brief Take the sensor up again after it lost power, with the
+   calibration read by begin_I2C() or begin_SPI(). Only the chip ID is read,
+   there is no soft reset and no calibration read. The sensor powers up
+   asleep with its FIFO off, the settings are written again by the next
+   forced reading, startFifo() or startNormal().
+
+    @return True if the chip ID is the one begin read
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::reattach(void) {
+  uint8_t id = 0;
+
+  g_i2c_dev = i2c_dev;
+  g_spi_dev = spi_dev;
+  if (!i2c_dev && !spi_dev)
+    return false;
+  if ((bmp3_get_regs(BMP3_REG_CHIP_ID, &id, 1, &the_sensor) != BMP3_OK) ||
+      (id != the_sensor.chip_id))
+    return false;
+
+  the_sensor.settings.op_mode = BMP3_MODE_SLEEP;
+  _fifoEnabled = false;
+  _normalEnabled = false;
+  _settingsDirty = true;
+  return true;
+}
+
 /**************************************************************************/
 /*!
     @brief Performs a reading and returns the barometric pressure.
@@ -305,25 +340,90 @@ float Adafruit_BMP3XX::readAltitude(float seaLevel) {
 */
 /**************************************************************************/
 bool Adafruit_BMP3XX::performReading(void) {
+  uint32_t timeout_start;
+
+  if (!startReading())
+    return false;
+
+  /* Wait for the forced conversion, otherwise the data registers still hold
+   * the previous one */
+  timeout_start = millis();
+  while (!readingReady()) {
+    if ((millis() - timeout_start) > 100)
+      return false;
+    delay(1);
+  }
+  if (!readData())
+    return false;
+
+  temperature = temperature100 / 100.0;
+  pressure = pressure100 / 100.0;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Start one forced conversion of pressure and temperature and
+   return at once, see readingReady() and readData()
+
+    @return True on success, False on failure
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::startReading(void) {
   g_i2c_dev = i2c_dev;
   g_spi_dev = spi_dev;
   int8_t rslt;
+
+  if (_fifoEnabled || _normalEnabled)
+    return false;
+
+  /* The registers keep the configuration between forced conversions and the
+   * sensor drops back to sleep after each one, so once the settings are
+   * applied a single write of PWR_CTRL starts the next conversion */
+  if (!_settingsDirty) {
+    uint8_t reg_addr = BMP3_REG_PWR_CTRL;
+    uint8_t pwr_ctrl = BMP3_PRESS_EN_MSK | BMP3_TEMP_EN_MSK |
+                       (BMP3_MODE_FORCED << BMP3_OP_MODE_POS);
+
+    return (bmp3_set_regs(&reg_addr, &pwr_ctrl, 1, &the_sensor) == BMP3_OK);
+  }
+
+  if (!_applySettings())
+    return false;
+
+  /* Set the power mode, the full path leaves any normal mode first */
+  the_sensor.settings.op_mode = BMP3_MODE_FORCED;
+#ifdef BMP3XX_DEBUG
+  Serial.println(F("Setting power mode"));
+#endif
+  rslt = bmp3_set_op_mode(&the_sensor);
+  if (rslt != BMP3_OK)
+    return false;
+
+  _settingsDirty = false;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Write oversampling, filter and data rate settings to the sensor
+
+    @return True on success, False on failure
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::_applySettings(void) {
   /* Used to select the settings user needs to change */
   uint16_t settings_sel = 0;
-  /* Variable used to select the sensor component */
-  uint8_t sensor_comp = 0;
 
   /* Select the pressure and temperature sensor to be enabled */
   the_sensor.settings.temp_en = BMP3_ENABLE;
   settings_sel |= BMP3_SEL_TEMP_EN;
-  sensor_comp |= BMP3_TEMP;
   if (_tempOSEnabled) {
     settings_sel |= BMP3_SEL_TEMP_OS;
   }
 
   the_sensor.settings.press_en = BMP3_ENABLE;
   settings_sel |= BMP3_SEL_PRESS_EN;
-  sensor_comp |= BMP3_PRESS;
   if (_presOSEnabled) {
     settings_sel |= BMP3_SEL_PRESS_OS;
   }
@@ -343,20 +443,246 @@ bool Adafruit_BMP3XX::performReading(void) {
 #ifdef BMP3XX_DEBUG
   Serial.println("Setting sensor settings");
 #endif
-  rslt = bmp3_set_sensor_settings(settings_sel, &the_sensor);
+  return (bmp3_set_sensor_settings(settings_sel, &the_sensor) == BMP3_OK);
+}
 
-  if (rslt != BMP3_OK)
+/**************************************************************************/
+/*!
+    @brief Run the sensor in normal mode at a data rate and queue every
+   pressure and temperature conversion in the 512 byte on-chip FIFO. The
+   oldest frames are overwritten once it is full. startReading() must not
+   be used until stopFifo().
+
+    @param  odr Output data rate, BMP3_ODR_200_HZ to BMP3_ODR_0_001_HZ
+    @return True on success, False on failure
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::startFifo(uint8_t odr) {
+  g_i2c_dev = i2c_dev;
+  g_spi_dev = spi_dev;
+
+  if (!setOutputDataRate(odr))
     return false;
 
-  /* Set the power mode */
-  the_sensor.settings.op_mode = BMP3_MODE_FORCED;
-#ifdef BMP3XX_DEBUG
-  Serial.println(F("Setting power mode"));
-#endif
-  rslt = bmp3_set_op_mode(&the_sensor);
-  if (rslt != BMP3_OK)
+  /* Settings are only written in sleep mode */
+  the_sensor.settings.op_mode = BMP3_MODE_SLEEP;
+  if (bmp3_set_op_mode(&the_sensor) != BMP3_OK)
+    return false;
+  _normalEnabled = false;
+  if (!_applySettings())
+    return false;
+
+  memset(&_fifo, 0, sizeof(_fifo));
+  _fifo.settings.mode = BMP3_ENABLE;
+  _fifo.settings.stop_on_full_en = BMP3_DISABLE;
+  _fifo.settings.time_en = BMP3_DISABLE;
+  _fifo.settings.press_en = BMP3_ENABLE;
+  _fifo.settings.temp_en = BMP3_ENABLE;
+  _fifo.settings.down_sampling = BMP3_FIFO_NO_SUBSAMPLING;
+  _fifo.settings.filter_en = _filterEnabled ? BMP3_ENABLE : BMP3_DISABLE;
+  the_sensor.fifo = &_fifo;
+  if (bmp3_set_fifo_settings(BMP3_SEL_FIFO_MODE | BMP3_SEL_FIFO_STOP_ON_FULL_EN |
+                                 BMP3_SEL_FIFO_TIME_EN | BMP3_SEL_FIFO_PRESS_EN |
+                                 BMP3_SEL_FIFO_TEMP_EN |
+                                 BMP3_SEL_FIFO_DOWN_SAMPLING |
+                                 BMP3_SEL_FIFO_FILTER_EN,
+                             &the_sensor) != BMP3_OK)
+    return false;
+  if (bmp3_fifo_flush(&the_sensor) != BMP3_OK)
+    return false;
+
+  the_sensor.settings.op_mode = BMP3_MODE_NORMAL;
+  if (bmp3_set_op_mode(&the_sensor) != BMP3_OK)
+    return false;
+
+  _fifoEnabled = true;
+  _settingsDirty = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Stop the FIFO and put the sensor back to sleep for forced
+   readings
+
+    @return True on success, False on failure
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::stopFifo(void) {
+  g_i2c_dev = i2c_dev;
+  g_spi_dev = spi_dev;
+
+  if (!_fifoEnabled)
+    return true;
+
+  the_sensor.settings.op_mode = BMP3_MODE_SLEEP;
+  if (bmp3_set_op_mode(&the_sensor) != BMP3_OK)
+    return false;
+
+  _fifo.settings.mode = BMP3_DISABLE;
+  if (bmp3_set_fifo_settings(BMP3_SEL_FIFO_MODE, &the_sensor) != BMP3_OK)
+    return false;
+
+  _fifoEnabled = false;
+  _settingsDirty = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Run the sensor in normal mode at a data rate without the FIFO,
+   the data registers hold the last conversion through the IIR filter set
+   with setIIRFilterCoeff(). One forced conversion is done first so they
+   hold a reading before the first normal mode one is done. startReading()
+   must not be used until stopNormal().
+
+    @param  odr Output data rate, BMP3_ODR_200_HZ to BMP3_ODR_0_001_HZ
+    @return True on success, False on failure
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::startNormal(uint8_t odr) {
+  if (!stopFifo() || !stopNormal())
+    return false;
+  if (!setOutputDataRate(odr))
+    return false;
+  if (!performReading())
+    return false;
+
+  the_sensor.settings.op_mode = BMP3_MODE_NORMAL;
+  if (bmp3_set_op_mode(&the_sensor) != BMP3_OK)
+    return false;
+
+  _normalEnabled = true;
+  _settingsDirty = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Leave normal mode and put the sensor back to sleep for forced
+   readings
+
+    @return True on success, False on failure
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::stopNormal(void) {
+  g_i2c_dev = i2c_dev;
+  g_spi_dev = spi_dev;
+
+  if (!_normalEnabled)
+    return true;
+
+  the_sensor.settings.op_mode = BMP3_MODE_SLEEP;
+  if (bmp3_set_op_mode(&the_sensor) != BMP3_OK)
     return false;
 
+  _normalEnabled = false;
+  _settingsDirty = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Drain the FIFO in one burst read, see nextFifoFrame()
+
+    @param  buffer Where the frames are read to, BMP3_FIFO_BYTES long so
+   the FIFO always fits
+    @param  size Length of buffer, frames that do not fit are flushed
+    @return Bytes read, 0 when empty or on failure
+*/
+/**************************************************************************/
+uint16_t Adafruit_BMP3XX::readFifo(uint8_t *buffer, uint16_t size) {
+  g_i2c_dev = i2c_dev;
+  g_spi_dev = spi_dev;
+  uint16_t len;
+
+  _fifo.data.byte_count = 0;
+  if (!_fifoEnabled)
+    return 0;
+  if (bmp3_get_fifo_length(&len, &the_sensor) != BMP3_OK)
+    return 0;
+
+  if (len > size) {
+    len = size;
+  }
+  if (len &&
+      (bmp3_get_regs(BMP3_REG_FIFO_DATA, buffer, len, &the_sensor) != BMP3_OK))
+    return 0;
+  if (len == size) {
+    bmp3_fifo_flush(&the_sensor); // A partial frame may be left behind
+  }
+
+  _fifo.data.buffer = buffer;
+  _fifo.data.byte_count = len;
+  _fifo.data.req_frames = 1;
+  _fifo.data.start_idx = 0;
+  _fifo.data.parsed_frames = 0;
+  _fifo.data.frame_not_available = 0;
+  _fifo.data.config_err = 0;
+  return len;
+}
+
+/**************************************************************************/
+/*!
+    @brief Compensate the next frame read by readFifo(), integer only
+
+    @param  temperature100 Celsius * 100
+    @param  pressure100 Pascals * 100
+    @return True with a frame, False once all are parsed
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::nextFifoFrame(int32_t *temperature100,
+                                    uint32_t *pressure100) {
+  struct bmp3_data data;
+  uint8_t parsed = _fifo.data.parsed_frames;
+
+  if (_fifo.data.byte_count == 0)
+    return false;
+  if (bmp3_extract_fifo_data(&data, &the_sensor) != BMP3_OK)
+    return false;
+  if (_fifo.data.parsed_frames == parsed)
+    return false;
+
+  *temperature100 = (int32_t)data.temperature;
+  *pressure100 = (uint32_t)data.pressure;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Check the data ready flags of the conversion started by
+   startReading()
+
+    @return True when pressure and temperature are both ready, False while
+   converting or on a bus error
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::readingReady(void) {
+  g_i2c_dev = i2c_dev;
+  g_spi_dev = spi_dev;
+  uint8_t status;
+
+  if (bmp3_get_regs(BMP3_REG_SENS_STATUS, &status, 1, &the_sensor) != BMP3_OK)
+    return false;
+
+  return ((status & (BMP3_STATUS_DRDY_PRESS_MSK | BMP3_STATUS_DRDY_TEMP_MSK)) ==
+          (BMP3_STATUS_DRDY_PRESS_MSK | BMP3_STATUS_DRDY_TEMP_MSK));
+}
+
+/**************************************************************************/
+/*!
+    @brief Read the conversion started by startReading() into
+   Adafruit_BMP3XX#temperature100 & Adafruit_BMP3XX#pressure100, integer
+   only
+
+    @return True on success, False on failure
+*/
+/**************************************************************************/
+bool Adafruit_BMP3XX::readData(void) {
+  g_i2c_dev = i2c_dev;
+  g_spi_dev = spi_dev;
+  int8_t rslt;
+
   /* Variable used to store the compensated data */
   struct bmp3_data data;
 
@@ -365,22 +691,14 @@ bool Adafruit_BMP3XX::performReading(void) {
 #ifdef BMP3XX_DEBUG
   Serial.println(F("Getting sensor data"));
 #endif
-  rslt = bmp3_get_sensor_data(sensor_comp, &data, &the_sensor);
-  if (rslt != BMP3_OK)
-    return false;
-
-  /*
-#ifdef BMP3XX_DEBUG
-  Serial.println(F("Analyzing sensor data"));
-#endif
-  rslt = analyze_sensor_data(&data);
+  rslt = bmp3_get_sensor_data(BMP3_PRESS | BMP3_TEMP, &data, &the_sensor);
   if (rslt != BMP3_OK)
     return false;
-    */
 
-  /* Save the temperature and pressure data */
-  temperature = data.temperature;
-  pressure = data.pressure;
+  /* Save the temperature and pressure data, integer compensation gives
+   * both * 100 */
+  temperature100 = (int32_t)data.temperature;
+  pressure100 = (uint32_t)data.pressure;
 
   return true;
 }
@@ -400,6 +718,7 @@ bool Adafruit_BMP3XX::setTemperatureOversampling(uint8_t oversample) {
     return false;
 
   the_sensor.settings.odr_filter.temp_os = oversample;
+  _settingsDirty = true;
 
   if (oversample == BMP3_NO_OVERSAMPLING)
     _tempOSEnabled = false;
@@ -423,6 +742,7 @@ bool Adafruit_BMP3XX::setPressureOversampling(uint8_t oversample) {
     return false;
 
   the_sensor.settings.odr_filter.press_os = oversample;
+  _settingsDirty = true;
 
   if (oversample == BMP3_NO_OVERSAMPLING)
     _presOSEnabled = false;
@@ -448,6 +768,7 @@ bool Adafruit_BMP3XX::setIIRFilterCoeff(uint8_t filtercoeff) {
     return false;
 
   the_sensor.settings.odr_filter.iir_filter = filtercoeff;
+  _settingsDirty = true;
 
   if (filtercoeff == BMP3_IIR_FILTER_DISABLE)
     _filterEnabled = false;
@@ -474,6 +795,7 @@ bool Adafruit_BMP3XX::setOutputDataRate(uint8_t odr) {
     return false;
 
   the_sensor.settings.odr_filter.odr = odr;
+  _settingsDirty = true;
 
   _ODREnabled = true;
 
@@ -33,6 +33,7 @@
 #define BMP3XX_DEFAULT_ADDRESS (0x77) ///< The default I2C address
 /*=========================================================================*/
 #define BMP3XX_DEFAULT_SPIFREQ (1000000) ///< The default SPI Clock speed
+#define BMP3_FIFO_BYTES (512)            ///< On-chip FIFO size
 
 /** Adafruit_BMP3XX Class for both I2C and SPI usage.
  *  Wraps the Bosch library for Arduino usage
@@ -47,6 +48,8 @@ public:
   bool begin_SPI(uint8_t cs_pin, SPIClass *theSPI = &SPI);
   bool begin_SPI(int8_t cs_pin, int8_t sck_pin, int8_t miso_pin,
                  int8_t mosi_pin);
+  /// After a power loss, set up again with the calibration begin read
+  bool reattach(void);
   uint8_t chipID(void);
   float readTemperature(void);
   float readPressure(void);
@@ -59,19 +62,47 @@ public:
 
   /// Perform a reading in blocking mode
   bool performReading(void);
+  /// Start a forced conversion and return, poll readingReady() then readData()
+  bool startReading(void);
+  /// True once the conversion started by startReading() is done
+  bool readingReady(void);
+  /// Read the finished conversion into temperature100 and pressure100
+  bool readData(void);
+
+  /// Run in normal mode at odr, every conversion queued in the FIFO
+  bool startFifo(uint8_t odr);
+  /// Back to sleep and forced readings
+  bool stopFifo(void);
+  /// Run in normal mode at odr, readData() gets the last filtered conversion
+  bool startNormal(uint8_t odr);
+  /// Back to sleep and forced readings
+  bool stopNormal(void);
+  /// Burst read the FIFO into buffer, returns the bytes read
+  uint16_t readFifo(uint8_t *buffer, uint16_t size);
+  /// Next frame from readFifo(), False when there are no more
+  bool nextFifoFrame(int32_t *temperature100, uint32_t *pressure100);
 
   /// Temperature (Celsius) assigned after calling performReading()
   double temperature;
   /// Pressure (Pascals) assigned after calling performReading()
   double pressure;
+  /// Temperature (Celsius * 100) assigned after calling readData()
+  int32_t temperature100;
+  /// Pressure (Pascals * 100) assigned after calling readData()
+  uint32_t pressure100;
 
 private:
   Adafruit_I2CDevice *i2c_dev = NULL; ///< Pointer to I2C bus interface
   Adafruit_SPIDevice *spi_dev = NULL; ///< Pointer to SPI bus interface
 
   bool _init(void);
+  bool _applySettings(void);
 
   bool _filterEnabled, _tempOSEnabled, _presOSEnabled, _ODREnabled;
+  bool _settingsDirty; ///< Settings changed since last written to the sensor
+  bool _fifoEnabled;   ///< Normal mode into the FIFO, see startFifo()
+  bool _normalEnabled; ///< Normal mode without the FIFO, see startNormal()
+  struct bmp3_fifo _fifo;
   uint8_t _i2caddr;
   int32_t _sensorID;
   int8_t _cs;
@@ -100,9 +100,9 @@ extern "C" {
 /********************************************************/
 /**\name Compiler switch macros */
 /**\name Uncomment the below line to use floating-point compensation */
-#ifndef BMP3_DOUBLE_PRECISION_COMPENSATION
-#define BMP3_DOUBLE_PRECISION_COMPENSATION
-#endif
+/* Integer compensation, the M0+ has no FPU. Adafruit_BMP3XX converts to
+ * double only in performReading() */
+/* #define BMP3_DOUBLE_PRECISION_COMPENSATION */
 
 /********************************************************/
 /**\name Macro definitions */
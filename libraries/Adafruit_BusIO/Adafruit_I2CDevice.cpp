@@ -2,6 +2,8 @@
 
 //#define DEBUG_SERIAL Serial
 
+Adafruit_I2CTransfer Adafruit_I2CDevice::_transfer = nullptr;
+
 /*!
  *    @brief  Create an I2C device at a given address
  *    @param  addr The 7-bit I2C address for the device
@@ -26,6 +28,7 @@ Adafruit_I2CDevice::Adafruit_I2CDevice(uint8_t addr, TwoWire *theWire) {
  *    @return True if I2C initialized and a device with the addr found
  */
 bool Adafruit_I2CDevice::begin(bool addr_detect) {
+  _sync();
   _wire->begin();
   _begun = true;
 
@@ -47,6 +50,7 @@ void Adafruit_I2CDevice::end(void) {
 #if !(defined(ESP8266) ||                                                      \
       (defined(ARDUINO_ARCH_AVR) && !defined(WIRE_HAS_END)) ||                 \
       defined(ARDUINO_ARCH_ESP32))
+  _sync();
   _wire->end();
   _begun = false;
 #endif
@@ -58,6 +62,7 @@ void Adafruit_I2CDevice::end(void) {
  *    @return True if I2C initialized and a device with the addr found
  */
 bool Adafruit_I2CDevice::detected(void) {
+  _sync();
   // Init I2C if not done yet
   if (!_begun && !begin()) {
     return false;
@@ -103,6 +108,14 @@ bool Adafruit_I2CDevice::write(const uint8_t *buffer, size_t len, bool stop,
     return false;
   }
 
+  if (_transfer) {
+    int r = _transfer(_wire, _addr, prefix_buffer, prefix_len, buffer, len,
+                      nullptr, 0);
+    if (r >= 0) {
+      return r;
+    }
+  }
+
   _wire->beginTransmission(_addr);
 
   // Write the prefix data (usually an address)
@@ -185,6 +198,13 @@ bool Adafruit_I2CDevice::read(uint8_t *buffer, size_t len, bool stop) {
 }
 
 bool Adafruit_I2CDevice::_read(uint8_t *buffer, size_t len, bool stop) {
+  if (_transfer) {
+    int r = _transfer(_wire, _addr, nullptr, 0, nullptr, 0, buffer, len);
+    if (r >= 0) {
+      return r;
+    }
+  }
+
 #if defined(TinyWireM_h)
   size_t recv = _wire->requestFrom((uint8_t)_addr, (uint8_t)len);
 #else
@@ -258,6 +278,7 @@ uint8_t Adafruit_I2CDevice::address(void) { return _addr; }
  */
 bool Adafruit_I2CDevice::setSpeed(uint32_t desiredclk) {
 #if (ARDUINO >= 157) && !defined(ARDUINO_STM32_FEATHER) && !defined(TinyWireM_h)
+  _sync();
   _wire->setClock(desiredclk);
   return true;
 #else
@@ -265,3 +286,13 @@ bool Adafruit_I2CDevice::setSpeed(uint32_t desiredclk) {
   return false;
 #endif
 }
+
+/*!
+ *    @brief  Let a transfer set with setTransfer() finish what it has on the
+ *    bus before this device uses Wire directly
+ */
+void Adafruit_I2CDevice::_sync(void) {
+  if (_transfer) {
+    _transfer(_wire, _addr, nullptr, 0, nullptr, 0, nullptr, 0);
+  }
+}
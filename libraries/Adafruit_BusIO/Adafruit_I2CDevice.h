@@ -4,9 +4,22 @@
 #include <Arduino.h>
 #include <Wire.h>
 
+/*! Transfer that takes the place of Wire: a write of prefix then wbuf, or a
+ *  read of rlen bytes into rbuf, always ended with a STOP. Called with nothing
+ *  to move before the device uses Wire itself. Returns 1 when done, 0 when it
+ *  failed, -1 when not taken and Wire is to be used. */
+typedef int (*Adafruit_I2CTransfer)(TwoWire *wire, uint8_t addr,
+                                    const uint8_t *prefix, size_t prefix_len,
+                                    const uint8_t *wbuf, size_t wlen,
+                                    uint8_t *rbuf, size_t rlen);
+
 ///< The class which defines how we will talk to this device over I2C
 class Adafruit_I2CDevice {
 public:
+  /*!   @brief  Route every device's reads and writes through fn, NULL = Wire
+   *    @param  fn The transfer */
+  static void setTransfer(Adafruit_I2CTransfer fn) { _transfer = fn; }
+
   Adafruit_I2CDevice(uint8_t addr, TwoWire *theWire = &Wire);
   uint8_t address(void);
   bool begin(bool addr_detect = true);
@@ -31,6 +44,8 @@ private:
   bool _begun;
   size_t _maxBufferSize;
   bool _read(uint8_t *buffer, size_t len, bool stop);
+  void _sync(void);
+  static Adafruit_I2CTransfer _transfer;
 };
 
 #endif // Adafruit_I2CDevice_h
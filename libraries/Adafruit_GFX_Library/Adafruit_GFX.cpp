@@ -1099,6 +1099,17 @@ void Adafruit_GFX::drawRGBBitmap(int16_t x, int16_t y, uint16_t *bitmap,
 
 // TEXT- AND CHARACTER-HANDLING FUNCTIONS ----------------------------------
 
+/**************************************************************************/
+/*!
+   @brief   Classic font glyph of a character, the cp437() setting applied
+    @param    c   The 8-bit font-indexed character (likely ascii)
+    @returns  5 column bytes in PROGMEM, bit 0 is the top row
+*/
+/**************************************************************************/
+const uint8_t *Adafruit_GFX::classicGlyph(unsigned char c) {
+  return &font[((!_cp437 && (c >= 176)) ? c + 1 : c) * 5];
+}
+
 // Draw a character
 /**************************************************************************/
 /*!
@@ -1250,8 +1261,11 @@ size_t Adafruit_GFX::write(uint8_t c) {
         cursor_x = 0;                                       // Reset x to zero,
         cursor_y += textsize_y * 8; // advance y one line
       }
-      drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x,
-               textsize_y);
+      if ((textsize_x != 1) || (textsize_y != 1) ||
+          !blitChar(cursor_x, cursor_y, classicGlyph(c), textcolor,
+                    textbgcolor))
+        drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x,
+                 textsize_y);
       cursor_x += textsize_x * 6; // Advance x one char
     }
 
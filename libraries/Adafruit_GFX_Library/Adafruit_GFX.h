@@ -229,6 +229,23 @@ public:
 protected:
   void charBounds(unsigned char c, int16_t *x, int16_t *y, int16_t *minx,
                   int16_t *miny, int16_t *maxx, int16_t *maxy);
+  const uint8_t *classicGlyph(unsigned char c);
+  /**********************************************************************/
+  /*!
+    @brief  Fast path for a size 1 classic font glyph. A display whose
+            buffer layout allows it copies the columns in directly.
+    @param  x      Left edge
+    @param  y      Top edge
+    @param  glyph  5 column bytes in PROGMEM, bit 0 is the top row
+    @param  color  Text color
+    @param  bg     Background color, same as color for transparent
+    @returns  true if drawn, false to draw it pixel by pixel
+  */
+  /**********************************************************************/
+  virtual bool blitChar(int16_t x, int16_t y, const uint8_t *glyph,
+                        uint16_t color, uint16_t bg) {
+    return false;
+  }
   int16_t WIDTH;        ///< This is the 'raw' display width - never changes
   int16_t HEIGHT;       ///< This is the 'raw' display height - never changes
   int16_t _width;       ///< Display width as modified by current rotation
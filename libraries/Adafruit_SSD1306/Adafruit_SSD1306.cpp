@@ -335,7 +335,7 @@ Adafruit_SSD1306::Adafruit_SSD1306(int8_t rst_pin)
     @brief  Destructor for Adafruit_SSD1306 object.
 */
 Adafruit_SSD1306::~Adafruit_SSD1306(void) {
-  if (buffer) {
+  if (buffer && !extBuffer) {
     free(buffer);
     buffer = NULL;
   }
@@ -491,20 +491,23 @@ void Adafruit_SSD1306::ssd1306_command(uint8_t c) {
 bool Adafruit_SSD1306::begin(uint8_t vcs, uint8_t addr, bool reset,
                              bool periphBegin) {
 
-  if ((!buffer) && !(buffer = (uint8_t *)malloc(WIDTH * ((HEIGHT + 7) / 8))))
-    return false;
+  if (!textOnly) {
+    if ((!buffer) &&
+        !(buffer = (uint8_t *)malloc(WIDTH * ((HEIGHT + 7) / 8))))
+      return false;
 
-  clearDisplay();
+    clearDisplay();
 
 #ifndef SSD1306_NO_SPLASH
-  if (HEIGHT > 32) {
-    drawBitmap((WIDTH - splash1_width) / 2, (HEIGHT - splash1_height) / 2,
-               splash1_data, splash1_width, splash1_height, 1);
-  } else {
-    drawBitmap((WIDTH - splash2_width) / 2, (HEIGHT - splash2_height) / 2,
-               splash2_data, splash2_width, splash2_height, 1);
-  }
+    if (HEIGHT > 32) {
+      drawBitmap((WIDTH - splash1_width) / 2, (HEIGHT - splash1_height) / 2,
+                 splash1_data, splash1_width, splash1_height, 1);
+    } else {
+      drawBitmap((WIDTH - splash2_width) / 2, (HEIGHT - splash2_height) / 2,
+                 splash2_data, splash2_width, splash2_height, 1);
+    }
 #endif
+  }
 
   vccstate = vcs;
 
@@ -616,6 +619,11 @@ bool Adafruit_SSD1306::begin(uint8_t vcs, uint8_t addr, bool reset,
 
   TRANSACTION_END
 
+  if (textOnly) { // Blank the controller RAM, all 8 pages
+    for (uint8_t page = 0; page < 8; page++)
+      textPage(page, "");
+  }
+
   return true; // Success
 }
 
@@ -979,6 +987,189 @@ bool Adafruit_SSD1306::getPixel(int16_t x, int16_t y) {
 */
 uint8_t *Adafruit_SSD1306::getBuffer(void) { return buffer; }
 
+/*!
+    @brief  Classic font glyph straight into the buffer when it sits on a
+            page, unrotated and fully on the display. Each of its 5 column
+            bytes is one page byte, no per-pixel drawing.
+    @param  x
+            Left edge.
+    @param  y
+            Top edge, a multiple of 8.
+    @param  glyph
+            5 column bytes in PROGMEM.
+    @param  color
+            SSD1306_WHITE, SSD1306_BLACK or SSD1306_INVERSE.
+    @param  bg
+            Background, same as color for transparent text.
+    @return true if drawn, false for the pixel by pixel path.
+*/
+bool Adafruit_SSD1306::blitChar(int16_t x, int16_t y, const uint8_t *glyph,
+                                uint16_t color, uint16_t bg) {
+  uint8_t *ptr;
+  uint8_t i, b;
+
+  if (!buffer || rotation || (y & 7) || (x < 0) || (y < 0) ||
+      ((x + 6) > WIDTH) || ((y + 8) > HEIGHT))
+    return false;
+
+  ptr = &buffer[(y / 8) * WIDTH + x];
+  if (bg == color) {
+    for (i = 0; i < 5; i++) {
+      b = pgm_read_byte(&glyph[i]);
+      switch (color) {
+      case SSD1306_WHITE:
+        ptr[i] |= b;
+        break;
+      case SSD1306_BLACK:
+        ptr[i] &= ~b;
+        break;
+      case SSD1306_INVERSE:
+        ptr[i] ^= b;
+        break;
+      }
+    }
+    return true;
+  }
+  if ((color == SSD1306_WHITE) && (bg == SSD1306_BLACK)) {
+    memcpy_P(ptr, glyph, 5);
+    ptr[5] = 0x00;
+    return true;
+  }
+  if ((color == SSD1306_BLACK) && (bg == SSD1306_WHITE)) {
+    for (i = 0; i < 5; i++)
+      ptr[i] = ~pgm_read_byte(&glyph[i]);
+    ptr[5] = 0xFF;
+    return true;
+  }
+  return false;
+}
+
+/*!
+    @brief  Use caller memory for the display buffer instead of allocating
+            it in begin(). Call before begin().
+    @param  buf
+            At least WIDTH * ((HEIGHT + 7) / 8) bytes, kept for the life of
+            the object and not freed by it.
+    @return None (void).
+*/
+void Adafruit_SSD1306::setBuffer(uint8_t *buf) {
+  if (buffer && !extBuffer) {
+    free(buffer);
+  }
+  buffer = buf;
+  extBuffer = true;
+}
+
+/*!
+    @brief  Run without a display buffer. begin() allocates nothing and
+            blanks the controller RAM, text rows are sent straight to it by
+            textPage() or rendered by textColumns() for the caller to send.
+            Graphics calls need the buffer and must not be used. Call
+            before begin().
+    @return None (void).
+*/
+void Adafruit_SSD1306::setTextOnly(void) {
+  if (buffer && !extBuffer) {
+    free(buffer);
+  }
+  buffer = NULL;
+  extBuffer = false;
+  textOnly = true;
+}
+
+/*!
+    @brief  Render a row of classic font text into the WIDTH column bytes
+            of one page, 6 columns a character, cut at the display width
+            and blank after the text.
+    @param  dst
+            WIDTH bytes, column-major like the buffer.
+    @param  str
+            Text, size 1 white on black.
+    @return None (void).
+*/
+void Adafruit_SSD1306::textColumns(uint8_t *dst, const char *str) {
+  int16_t x = 0;
+
+  for (; *str && ((x + 6) <= WIDTH); str++, x += 6) {
+    memcpy_P(&dst[x], classicGlyph((unsigned char)*str), 5);
+    dst[x + 5] = 0x00;
+  }
+  memset(&dst[x], 0, WIDTH - x);
+}
+
+/*!
+    @brief  Send a row of classic font text to a page of SSD1306 RAM, the
+            columns textColumns() would render, made as they are sent.
+    @param  page
+            Page of SSD1306 RAM to write (0-7).
+    @param  str
+            Text, size 1 white on black.
+    @return None (void).
+*/
+void Adafruit_SSD1306::textPage(uint8_t page, const char *str) {
+  const uint8_t *glyph = NULL;
+  uint8_t col = 0, b;
+
+  if (page > 7)
+    return;
+
+  TRANSACTION_START
+  ssd1306_command1(SSD1306_PAGEADDR);
+  ssd1306_command1(page); // Page start address
+  ssd1306_command1(page); // Page end address
+  ssd1306_command1(SSD1306_COLUMNADDR);
+  ssd1306_command1(0);         // Column start address
+  ssd1306_command1(WIDTH - 1); // Column end address
+
+  if (wire) { // I2C
+    wire->beginTransmission(i2caddr);
+    WIRE_WRITE((uint8_t)0x40);
+  } else { // SPI
+    SSD1306_MODE_DATA
+  }
+  uint16_t bytesOut = 1;
+  for (int16_t x = 0; x < WIDTH; x++, col++) {
+    if (col == 6)
+      col = 0;
+    if (col == 0)
+      glyph = (*str && ((x + 6) <= WIDTH))
+                  ? classicGlyph((unsigned char)*str++)
+                  : NULL;
+    b = (glyph && (col < 5)) ? pgm_read_byte(&glyph[col]) : 0x00;
+    if (wire) {
+      if (bytesOut >= WIRE_MAX) {
+        wire->endTransmission();
+        wire->beginTransmission(i2caddr);
+        WIRE_WRITE((uint8_t)0x40);
+        bytesOut = 1;
+      }
+      WIRE_WRITE(b);
+      bytesOut++;
+    } else {
+      SPIwrite(b);
+    }
+  }
+  if (wire)
+    wire->endTransmission();
+  TRANSACTION_END
+}
+
+/*!
+    @brief  Send WIDTH column bytes from the caller to a page of SSD1306
+            RAM, for graphics drawn a page at a time without the buffer.
+    @param  page
+            Page of SSD1306 RAM to write (0-7).
+    @param  cols
+            WIDTH bytes, column-major like the buffer.
+    @return None (void).
+*/
+void Adafruit_SSD1306::columnsPage(uint8_t page, const uint8_t *cols) {
+  if (page > 7)
+    return;
+
+  sendPages(cols, page, page);
+}
+
 // REFRESH DISPLAY ---------------------------------------------------------
 
 /*!
@@ -1035,6 +1226,104 @@ void Adafruit_SSD1306::display(void) {
 #endif
 }
 
+/*!
+    @brief  Push a range of 8-pixel-high pages from RAM to the SSD1306,
+            leaving the rest of the display as it is.
+    @param  first
+            First page (0 = top 8 rows).
+    @param  last
+            Last page, inclusive. Clipped to the display height.
+    @return None (void).
+    @note   Same transfer as display() for the bytes of those pages only,
+            for callers that know which part of the buffer changed.
+*/
+void Adafruit_SSD1306::displayPages(uint8_t first, uint8_t last) {
+  uint8_t pages = (HEIGHT + 7) / 8;
+
+  if (last >= pages)
+    last = pages - 1;
+  if (first > last)
+    return;
+
+  sendPages(buffer + WIDTH * first, first, last);
+}
+
+/*!
+    @brief  Push one page of the buffer to any page of SSD1306 RAM. The
+            controller holds 8 pages even when the panel shows fewer, so
+            pages past the display height can be filled ahead of a
+            setStartLine() scroll.
+    @param  src
+            Page of the buffer to send.
+    @param  page
+            Page of SSD1306 RAM to write (0-7).
+    @return None (void).
+*/
+void Adafruit_SSD1306::displayPage(uint8_t src, uint8_t page) {
+  if ((src >= (HEIGHT + 7) / 8) || (page > 7))
+    return;
+
+  sendPages(buffer + WIDTH * src, page, page);
+}
+
+/*!
+    @brief  Set the RAM row shown at the top of the display, scrolls the
+            whole panel with one command and no data transfer.
+    @param  line
+            RAM row (0-63).
+    @return None (void).
+*/
+void Adafruit_SSD1306::setStartLine(uint8_t line) {
+  TRANSACTION_START
+  ssd1306_command1(SSD1306_SETSTARTLINE | (line & 0x3F));
+  TRANSACTION_END
+}
+
+/*!
+    @brief  Send WIDTH bytes per page from ptr to RAM pages first..last.
+    @param  ptr
+            Source bytes, column-major like the buffer.
+    @param  first
+            First RAM page.
+    @param  last
+            Last RAM page, inclusive.
+    @return None (void).
+    @note   Protected, callers have checked the range.
+*/
+void Adafruit_SSD1306::sendPages(const uint8_t *ptr, uint8_t first,
+                                 uint8_t last) {
+  TRANSACTION_START
+  ssd1306_command1(SSD1306_PAGEADDR);
+  ssd1306_command1(first); // Page start address
+  ssd1306_command1(last);  // Page end address
+  ssd1306_command1(SSD1306_COLUMNADDR);
+  ssd1306_command1(0);         // Column start address
+  ssd1306_command1(WIDTH - 1); // Column end address
+
+  uint16_t count = WIDTH * (last - first + 1);
+  if (wire) { // I2C
+    wire->beginTransmission(i2caddr);
+    WIRE_WRITE((uint8_t)0x40);
+    uint16_t bytesOut = 1;
+    while (count--) {
+      if (bytesOut >= WIRE_MAX) {
+        wire->endTransmission();
+        wire->beginTransmission(i2caddr);
+        WIRE_WRITE((uint8_t)0x40);
+        bytesOut = 1;
+      }
+      WIRE_WRITE(*ptr++);
+      bytesOut++;
+    }
+    wire->endTransmission();
+  } else { // SPI
+    SSD1306_MODE_DATA
+    while (count--)
+      SPIwrite(*ptr++);
+  }
+  TRANSACTION_END
+}
+
 // SCROLLING FUNCTIONS -----------------------------------------------------
 
 /*!
@@ -148,6 +148,9 @@ public:
   bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0,
              bool reset = true, bool periphBegin = true);
   void display(void);
+  void displayPages(uint8_t first, uint8_t last);
+  void displayPage(uint8_t src, uint8_t page);
+  void setStartLine(uint8_t line);
   void clearDisplay(void);
   void invertDisplay(bool i);
   void dim(bool dim);
@@ -162,6 +165,11 @@ public:
   void ssd1306_command(uint8_t c);
   bool getPixel(int16_t x, int16_t y);
   uint8_t *getBuffer(void);
+  void setBuffer(uint8_t *buf);
+  void setTextOnly(void);
+  void textColumns(uint8_t *dst, const char *str);
+  void textPage(uint8_t page, const char *str);
+  void columnsPage(uint8_t page, const uint8_t *cols);
 
 protected:
   inline void SPIwrite(uint8_t d) __attribute__((always_inline));
@@ -169,6 +177,9 @@ protected:
   void drawFastVLineInternal(int16_t x, int16_t y, int16_t h, uint16_t color);
   void ssd1306_command1(uint8_t c);
   void ssd1306_commandList(const uint8_t *c, uint8_t n);
+  void sendPages(const uint8_t *ptr, uint8_t first, uint8_t last);
+  bool blitChar(int16_t x, int16_t y, const uint8_t *glyph, uint16_t color,
+                uint16_t bg);
 
   SPIClass *spi;   ///< Initialized during construction when using SPI. See
                    ///< SPI.cpp, SPI.h
@@ -176,6 +187,8 @@ protected:
                    ///< Wire.cpp, Wire.h
   uint8_t *buffer; ///< Buffer data used for display buffer. Allocated when
                    ///< begin method is called.
+  bool extBuffer = false; ///< buffer was given by setBuffer(), not freed
+  bool textOnly = false;  ///< No buffer, text is sent by textPage()
   int8_t i2caddr;  ///< I2C address initialized when begin method is called.
   int8_t vccstate; ///< VCC selection, set by begin method.
   int8_t page_end; ///< not used
@@ -39,7 +39,8 @@ void ArduinoLowPowerClass::sleep() {
 	bool restoreUSBDevice = false;
 	if (SERIAL_PORT_USBVIRTUAL) {
 		USBDevice.standby();
-	} else {
+	} else if (!USB->DEVICE.CTRLB.bit.DETACH) {
+		// Detached by the sketch (no host expected) stays detached, no attach and re-enumeration on each wake
 		USBDevice.detach();
 		restoreUSBDevice = true;
 	}
@@ -181,7 +182,7 @@ void ArduinoLowPowerClass::detachAdcInterrupt()
 	while (ADC->STATUS.bit.SYNCBUSY) {}
 
 	// Disable ADC in standby mode
-	ADC->CTRLA.bit.RUNSTDBY = 1;
+	ADC->CTRLA.bit.RUNSTDBY = 0;
 	while (ADC->STATUS.bit.SYNCBUSY) {}
 
 	// Disable window interrupt
@@ -18,9 +18,20 @@
    uint8_t nfilecount=0;
 */
 
+// open files come from a fixed pool, an unattended logger must not fragment the heap
+static SdFile filePool[SD_FILE_POOL];
+static boolean filePoolUsed[SD_FILE_POOL];
+
 File::File(SdFile f, const char *n) {
-  // oh man you are kidding me, new() doesn't exist? Ok we do it by hand!
-  _file = (SdFile *)malloc(sizeof(SdFile));
+  _file = 0;
+  _name[0] = 0;
+  for (uint8_t i = 0; i < SD_FILE_POOL; i++) {
+    if (!filePoolUsed[i]) {
+      filePoolUsed[i] = true;
+      _file = &filePool[i];
+      break;
+    }
+  }
   if (_file) {
     memcpy(_file, &f, sizeof(SdFile));
 
@@ -123,6 +134,10 @@ void File::flush() {
   }
 }
 
+boolean File::sync() {
+  return (_file && _file->sync());
+}
+
 boolean File::seek(uint32_t pos) {
   if (! _file) {
     return false;
@@ -145,10 +160,36 @@ uint32_t File::size() {
   return _file->fileSize();
 }
 
+// first and last SD block of a file that was created contiguous
+boolean File::contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock) {
+  if (! _file) {
+    return false;
+  }
+  return _file->contiguousRange(bgnBlock, endBlock);
+}
+
+// last write date and time from the directory entry
+uint32_t File::modified() {
+  dir_t d;
+
+  if (! _file || ! _file->dirEntry(&d)) {
+    return 0;
+  }
+  return ((uint32_t) d.lastWriteDate << 16) | d.lastWriteTime;
+}
+
+// shorten the file, clusters past the new size are freed
+boolean File::truncate(uint32_t size) {
+  if (! _file) {
+    return false;
+  }
+  return _file->truncate(size);
+}
+
 void File::close() {
   if (_file) {
     _file->close();
-    free(_file);
+    filePoolUsed[_file - filePool] = false;
     _file = 0;
 
     /* for debugging file open/close leaks
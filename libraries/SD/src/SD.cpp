@@ -348,7 +348,7 @@ namespace SDLib {
       Return true if initialization succeeds, false otherwise.
 
     */
-    return card.init(SPI_HALF_SPEED, csPin) &&
+    return card.init(SPI_FULL_SPEED, csPin) &&
            volume.init(card) &&
            root.openRoot(volume);
   }
@@ -367,6 +367,10 @@ namespace SDLib {
   //call this when a card is removed. It will allow you to insert and initialise a new card.
   void SDClass::end() {
     root.close();
+    // write what is cached if the card is still there, then drop it so
+    // begin() on the next card starts with an empty cache
+    SdVolume::cacheClear();
+    SdVolume::cacheInvalidate();
   }
 
   // this little helper is used to traverse paths
@@ -487,6 +491,58 @@ namespace SDLib {
   }
 
 
+  File SDClass::open(File &dir, const char *filename, uint8_t mode) {
+    /*
+
+       Open or create filename in the directory dir, as open() does with
+       a path but starting from dir. A directory kept open this way saves
+       reading every directory on the path again for each file.
+
+    */
+
+    SdFile file;
+
+    if (!dir || !dir.isDirectory()) {
+      return File();
+    }
+    if (! file.open(dir._file, filename, mode)) {
+      return File();
+    }
+    if ((mode & (O_APPEND | O_WRITE)) == (O_APPEND | O_WRITE)) {
+      file.seekSet(file.fileSize());
+    }
+    return File(file, filename);
+  }
+
+
+  File SDClass::createContiguous(const char *filepath, uint32_t size) {
+    /*
+
+       Create a new file with all of its clusters allocated in one run,
+       leaving it open for read and write. The file size is set to `size`,
+       use File::truncate() once the real length is known.
+
+    */
+
+    int pathidx;
+
+    SdFile parentdir = getParentDir(filepath, &pathidx);
+    filepath += pathidx;
+
+    if (! filepath[0] || !parentdir.isOpen()) {
+      return File();
+    }
+
+    SdFile file;
+    if (! file.createContiguous(&parentdir, filepath, size)) {
+      return File();
+    }
+    parentdir.close();
+
+    return File(file, filepath);
+  }
+
+
   /*
     File SDClass::open(char *filepath, uint8_t mode) {
     //
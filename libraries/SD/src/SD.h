@@ -20,6 +20,13 @@
 #include "utility/SdFat.h"
 #include "utility/SdFatUtil.h"
 
+// open files at once, each File holds one of these SdFile slots until close()
+// 5 for the sketch's worst case: the held daily log and month directory while
+// the archiver's scan (AR.h ar_find()) has /OBS, a month and a file in it open
+#ifndef SD_FILE_POOL
+  #define SD_FILE_POOL 5
+#endif
+
 #define FILE_READ O_READ
 #define FILE_WRITE (O_READ | O_WRITE | O_CREAT | O_APPEND)
 
@@ -40,10 +47,14 @@ namespace SDLib {
       virtual int peek();
       virtual int available();
       virtual void flush();
+      boolean sync();  // flush() that says if the directory entry was written
       int read(void *buf, uint16_t nbyte);
       boolean seek(uint32_t pos);
       uint32_t position();
       uint32_t size();
+      boolean contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock);
+      uint32_t modified();  // FAT write date << 16 | write time of the directory entry, 0 if unknown
+      boolean truncate(uint32_t size);
       void close();
       operator bool();
       char * name();
@@ -53,6 +64,8 @@ namespace SDLib {
       void rewindDirectory(void);
 
       using Print::write;
+
+      friend class SDClass;
   };
 
   class SDClass {
@@ -82,6 +95,14 @@ namespace SDLib {
         return open(filename.c_str(), mode);
       }
 
+      // Open a file in an already open directory, the path is not walked
+      // from the root again. Keep the directory open to reuse it.
+      File open(File &dir, const char *filename, uint8_t mode = FILE_READ);
+
+      // Create a new file of size bytes in one contiguous run of clusters and
+      // open it read/write. Fails if the file already exists.
+      File createContiguous(const char *filepath, uint32_t size);
+
       // Methods to determine if the requested file path exists.
       boolean exists(const char *filepath);
       boolean exists(const String &filepath) {
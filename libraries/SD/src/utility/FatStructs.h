@@ -288,6 +288,46 @@ uint32_t const FAT32MASK = 0X0FFFFFFF;
 /** Type name for fat32BootSector */
 typedef struct fat32BootSector fbs_t;
 //------------------------------------------------------------------------------
+/** Value of leadSignature in the FSINFO sector */
+uint32_t const FSINFO_LEAD_SIG = 0X41615252;
+/** Value of structSignature in the FSINFO sector */
+uint32_t const FSINFO_STRUCT_SIG = 0X61417272;
+/** Value of tailSignature in the FSINFO sector */
+uint32_t const FSINFO_TAIL_SIG = 0XAA550000;
+/** FSINFO freeCount or nextFree not known */
+uint32_t const FSINFO_UNKNOWN = 0XFFFFFFFF;
+/**
+   \struct fat32_fsinfo
+
+   \brief FSINFO sector of a FAT32 volume, at bpb.fat32FSInfo.
+
+   Both counts are hints, a driver must check them against the FAT.
+*/
+struct fat32_fsinfo {
+  /** must be 0X41615252 */
+  uint32_t leadSignature;
+  /** must be zero */
+  uint8_t  reserved1[480];
+  /** must be 0X61417272 */
+  uint32_t structSignature;
+  /**
+     Last known free cluster count on the volume, 0XFFFFFFFF if not
+     known.
+  */
+  uint32_t freeCount;
+  /**
+     Cluster number at which to start looking for free clusters,
+     0XFFFFFFFF if not known.
+  */
+  uint32_t nextFree;
+  /** must be zero */
+  uint8_t  reserved2[12];
+  /** must be 0XAA550000 */
+  uint32_t tailSignature;
+} __attribute__((packed));
+/** Type name for fat32_fsinfo */
+typedef struct fat32_fsinfo fsinfo_t;
+//------------------------------------------------------------------------------
 /**
    \struct directoryEntry
    \brief FAT short directory entry
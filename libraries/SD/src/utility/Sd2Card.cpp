@@ -51,6 +51,20 @@ static  uint8_t spiRec(void) {
   return SDCARD_SPI.transfer(0xFF);
   #endif
 }
+#ifdef USE_SPI_LIB
+/**
+   Block transfer hook. An application with a DMA path for the SD SPI port
+   defines sd_spi_block() to clock count bytes out of src (0XFF when src is
+   NULL) and into dst (discarded when dst is NULL) and return true. This
+   default returns false and the bytes are moved one at a time.
+*/
+extern "C" uint8_t __attribute__((weak)) sd_spi_block(const uint8_t* src, uint8_t* dst, uint16_t count) {
+  (void) src;
+  (void) dst;
+  (void) count;
+  return false;
+}
+#endif  // USE_SPI_LIB
 #else  // SOFTWARE_SPI
 //------------------------------------------------------------------------------
 /** nop to tune soft SPI timing */
@@ -256,7 +270,10 @@ uint8_t Sd2Card::eraseSingleBlockEnable(void) {
 */
 uint8_t Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
   errorCode_ = inBlock_ = partialBlockRead_ = type_ = 0;
+  writePending_ = 0;
+  powerOff_ = 0;
   chipSelectPin_ = chipSelectPin;
+  sckRateID_ = sckRateID;
   // 16-bit init start time allows over a minute
   unsigned int t0 = millis();
   uint32_t arg;
@@ -407,6 +424,9 @@ uint8_t Sd2Card::readData(uint32_t block,
   if ((count + offset) > 512) {
     goto fail;
   }
+  if (powerOff_ && !powerOn()) {
+    goto fail;
+  }
   if (!inBlock_ || block != block_ || offset < offset_) {
     block_ = block;
     // use address if not SDHC card
@@ -422,6 +442,7 @@ uint8_t Sd2Card::readData(uint32_t block,
     }
     offset_ = 0;
     inBlock_ = 1;
+    blockIo(SD_IO_READ, block_);
   }
 
   #ifdef OPTIMIZE_HARDWARE_SPI
@@ -454,6 +475,9 @@ uint8_t Sd2Card::readData(uint32_t block,
     spiRec();
   }
   // transfer data
+  #ifdef USE_SPI_LIB
+  if (!sd_spi_block(NULL, dst, count))
+  #endif  // USE_SPI_LIB
   for (uint16_t i = 0; i < count; i++) {
     dst[i] = spiRec();
   }
@@ -499,6 +523,9 @@ void Sd2Card::readEnd(void) {
 /** read CID or CSR register */
 uint8_t Sd2Card::readRegister(uint8_t cmd, void* buf) {
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+  if (powerOff_ && !powerOn()) {
+    goto fail;
+  }
   if (cardCommand(cmd, 0)) {
     error(SD_CARD_ERROR_READ_REG);
     goto fail;
@@ -564,6 +591,7 @@ uint8_t Sd2Card::setSckRate(uint8_t sckRateID) {
 //------------------------------------------------------------------------------
 // set the SPI clock frequency
 uint8_t Sd2Card::setSpiClock(uint32_t clock) {
+  spiClock_ = clock;
   settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
   return true;
 }
@@ -613,6 +641,7 @@ fail:
    the value zero, false, is returned for failure.
 */
 uint8_t Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src, uint8_t blocking) {
+  uint32_t t0;
   #if SD_PROTECT_BLOCK_ZERO
   // don't allow write to first block
   if (blockNumber == 0) {
@@ -620,7 +649,16 @@ uint8_t Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src, uint8_t bl
     goto fail;
   }
   #endif  // SD_PROTECT_BLOCK_ZERO
+  if (powerOff_ && !powerOn()) {
+    goto fail;
+  }
 
+  // finish a deferred write so its status is still checked
+  if (!writeWait()) {
+    goto fail;
+  }
+  t0 = micros();
+  blockIo(SD_IO_WRITE, blockNumber);
   // use address if not SDHC card
   if (type() != SD_CARD_TYPE_SDHC) {
     blockNumber <<= 9;
@@ -632,7 +670,12 @@ uint8_t Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src, uint8_t bl
   if (!writeData(DATA_START_BLOCK, src)) {
     goto fail;
   }
-  if (blocking) {
+  if (blocking && deferBusy_) {
+    // programming is checked by the next write or writeWait()
+    writePending_ = 1;
+    latOp_ = SD_LAT_BLOCK;
+    latUs_ = micros() - t0;
+  } else if (blocking) {
     // wait for flash programming to complete
     if (!waitNotBusy(SD_WRITE_TIMEOUT)) {
       error(SD_CARD_ERROR_WRITE_TIMEOUT);
@@ -643,6 +686,7 @@ uint8_t Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src, uint8_t bl
       error(SD_CARD_ERROR_WRITE_PROGRAMMING);
       goto fail;
     }
+    latency(SD_LAT_BLOCK, micros() - t0);
   }
   chipSelectHigh();
   return true;
@@ -654,13 +698,19 @@ fail:
 //------------------------------------------------------------------------------
 /** Write one data block in a multiple block write sequence */
 uint8_t Sd2Card::writeData(const uint8_t* src) {
+  uint32_t t0 = micros();
   // wait for previous write to finish
   if (!waitNotBusy(SD_WRITE_TIMEOUT)) {
     error(SD_CARD_ERROR_WRITE_MULTIPLE);
     chipSelectHigh();
     return false;
   }
-  return writeData(WRITE_MULTIPLE_TOKEN, src);
+  if (!writeData(WRITE_MULTIPLE_TOKEN, src)) {
+    return false;
+  }
+  blockIo(SD_IO_WRITE, ioBlock_++);
+  latUs_ += micros() - t0;
+  return true;
 }
 //------------------------------------------------------------------------------
 // send one block of data for write block or write multiple blocks
@@ -686,6 +736,9 @@ uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
 
   #else  // OPTIMIZE_HARDWARE_SPI
   spiSend(token);
+  #ifdef USE_SPI_LIB
+  if (!sd_spi_block(src, NULL, 512))
+  #endif  // USE_SPI_LIB
   for (uint16_t i = 0; i < 512; i++) {
     spiSend(src[i]);
   }
@@ -714,6 +767,7 @@ uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
    the value zero, false, is returned for failure.
 */
 uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
+  uint32_t t0;
   #if SD_PROTECT_BLOCK_ZERO
   // don't allow write to first block
   if (blockNumber == 0) {
@@ -721,6 +775,14 @@ uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
     goto fail;
   }
   #endif  // SD_PROTECT_BLOCK_ZERO
+  if (powerOff_ && !powerOn()) {
+    goto fail;
+  }
+  if (!writeWait()) {
+    goto fail;
+  }
+  t0 = micros();
+  ioBlock_ = blockNumber;
   // send pre-erase count
   if (cardAcmd(ACMD23, eraseCount)) {
     error(SD_CARD_ERROR_ACMD23);
@@ -734,6 +796,7 @@ uint8_t Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
     error(SD_CARD_ERROR_CMD25);
     goto fail;
   }
+  latUs_ = micros() - t0;
   return true;
 
 fail:
@@ -747,12 +810,19 @@ fail:
    the value zero, false, is returned for failure.
 */
 uint8_t Sd2Card::writeStop(void) {
+  uint32_t t0 = micros();
   if (!waitNotBusy(SD_WRITE_TIMEOUT)) {
     goto fail;
   }
   spiSend(STOP_TRAN_TOKEN);
-  if (!waitNotBusy(SD_WRITE_TIMEOUT)) {
+  if (deferBusy_) {
+    writePending_ = 1;
+    latOp_ = SD_LAT_MULTI;
+    latUs_ += micros() - t0;
+  } else if (!waitNotBusy(SD_WRITE_TIMEOUT)) {
     goto fail;
+  } else {
+    latency(SD_LAT_MULTI, latUs_ + micros() - t0);
   }
   chipSelectHigh();
   return true;
@@ -763,12 +833,104 @@ fail:
   return false;
 }
 //------------------------------------------------------------------------------
+/** Wait for a deferred write to finish programming and check its status
+
+  \return The value one, true, is returned when there was no deferred
+   write or it completed and the value zero, false, is returned on a
+   timeout or programming error.
+*/
+uint8_t Sd2Card::writeWait(void) {
+  uint32_t t0;
+  if (!writePending_) {
+    return true;
+  }
+  writePending_ = 0;
+  t0 = micros();
+  chipSelectLow();
+  if (!waitNotBusy(SD_WRITE_TIMEOUT)) {
+    error(SD_CARD_ERROR_WRITE_TIMEOUT);
+    goto fail;
+  }
+  // response is r2 so get and check two bytes for nonzero
+  if (cardCommand(CMD13, 0) || spiRec()) {
+    error(SD_CARD_ERROR_WRITE_PROGRAMMING);
+    goto fail;
+  }
+  chipSelectHigh();
+  latency(latOp_, latUs_ + micros() - t0);
+  return true;
+
+fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Get ready for the card's power to be cut
+
+  The card's CID is kept and a deferred write is finished. The next read,
+  write or erase calls powerUp, which must switch the card on and let its
+  supply settle, then runs init() with the chip select and clock the card
+  had. The SdVolume and open files are kept as they were, flush what they
+  hold before. A card with another CID fails with SD_CARD_ERROR_SWAPPED
+  and must be mounted again.
+
+  \param[in] powerUp Switches the card's power on.
+
+  \return The value one, true, is returned for success and
+  the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::powerDown(void (*powerUp)(void)) {
+  readEnd();
+  if (!writeWait() || !readCID(&cid_)) {
+    return false;
+  }
+  powerUp_ = powerUp;
+  powerOff_ = 1;
+  return true;
+}
+//------------------------------------------------------------------------------
+// power a card up after powerDown(), initialize it again and check it is the
+// same card.  One try, a card that fails stays down and every access fails
+// until init() is called again
+uint8_t Sd2Card::powerOn(void) {
+  cid_t cid;
+  uint32_t clock = spiClock_;
+
+  if (!powerUp_) {
+    return false;
+  }
+  powerUp_();
+  powerUp_ = NULL;
+  if (!init(sckRateID_, chipSelectPin_)) {
+    powerOff_ = 1;
+    return false;
+  }
+  #ifdef USE_SPI_LIB
+  if (clock) {
+    setSpiClock(clock);
+  }
+  #endif  // USE_SPI_LIB
+  if (!readCID(&cid)) {
+    powerOff_ = 1;
+    return false;
+  }
+  if (memcmp(&cid, &cid_, sizeof(cid))) {
+    error(SD_CARD_ERROR_SWAPPED);
+    powerOff_ = 1;
+    return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
 /** Check if the SD card is busy
 
   \return The value one, true, is returned when is busy and
    the value zero, false, is returned for when is NOT busy.
 */
 uint8_t Sd2Card::isBusy(void) {
+  if (powerOff_) {
+    return false;
+  }
   chipSelectLow();
   byte b = spiRec();
   chipSelectHigh();
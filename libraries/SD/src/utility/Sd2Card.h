@@ -160,6 +160,8 @@ uint8_t const SD_CARD_ERROR_WRITE_PROGRAMMING = 0X14;
 uint8_t const SD_CARD_ERROR_WRITE_TIMEOUT = 0X15;
 /** incorrect rate selected */
 uint8_t const SD_CARD_ERROR_SCK_RATE = 0X16;
+/** card powered up again after powerDown() is not the one powered down */
+uint8_t const SD_CARD_ERROR_SWAPPED = 0X17;
 //------------------------------------------------------------------------------
 // card types
 /** Standard capacity V1 SD card */
@@ -169,6 +171,18 @@ uint8_t const SD_CARD_TYPE_SD2 = 2;
 /** High Capacity SD card */
 uint8_t const SD_CARD_TYPE_SDHC = 3;
 //------------------------------------------------------------------------------
+// write latency kinds, see latencyHook()
+/** writeBlock() until the card is done programming */
+uint8_t const SD_LAT_BLOCK = 0;
+/** writeStart() through writeStop() until the card is done programming */
+uint8_t const SD_LAT_MULTI = 1;
+//------------------------------------------------------------------------------
+// block transfer kinds, see blockHook()
+/** a block read from the card */
+uint8_t const SD_IO_READ = 0;
+/** a block written to the card, alone or in a multiple block write */
+uint8_t const SD_IO_WRITE = 1;
+//------------------------------------------------------------------------------
 /**
    \class Sd2Card
    \brief Raw access to SD and SDHC flash memory cards.
@@ -176,7 +190,9 @@ uint8_t const SD_CARD_TYPE_SDHC = 3;
 class Sd2Card {
   public:
     /** Construct an instance of Sd2Card. */
-    Sd2Card(void) : errorCode_(0), inBlock_(0), partialBlockRead_(0), type_(0) {}
+    Sd2Card(void) : deferBusy_(0), errorCode_(0), inBlock_(0), partialBlockRead_(0), type_(0), writePending_(0),
+      powerOff_(0), powerUp_(NULL), sckRateID_(0), spiClock_(0), latHook_(NULL), latUs_(0), latOp_(0),
+      ioHook_(NULL), ioBlock_(0) {}
     uint32_t cardSize(void);
     uint8_t erase(uint32_t firstBlock, uint32_t lastBlock);
     uint8_t eraseSingleBlockEnable(void);
@@ -241,8 +257,45 @@ class Sd2Card {
     uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount);
     uint8_t writeStop(void);
     uint8_t isBusy(void);
+    /**
+       Leave the last write programming. With defer set, writeBlock() and
+       writeStop() return once the data is sent; the wait and status check
+       for that write are done by the next write or by writeWait().
+    */
+    void deferBusy(uint8_t value) {
+      deferBusy_ = value;
+    }
+    /** \return true while a deferred write has not been checked. */
+    uint8_t writePending(void) const {
+      return writePending_;
+    }
+    uint8_t writeWait(void);
+    uint8_t powerDown(void (*powerUp)(void));
+    /** \return true while the card is powered down. */
+    uint8_t poweredDown(void) const {
+      return powerOff_;
+    }
+    /**
+       Call hook with the kind (SD_LAT_BLOCK, SD_LAT_MULTI) and the
+       microseconds spent in the library on each write that completes,
+       once the card is done programming it. A deferred write is reported
+       by the writeWait() that checks it, the time between is not counted.
+       NULL for none.
+    */
+    void latencyHook(void (*hook)(uint8_t kind, uint32_t us)) {
+      latHook_ = hook;
+    }
+    /**
+       Call hook with the kind (SD_IO_READ, SD_IO_WRITE) and the block
+       number of each block sent to or started from the card. Reads of
+       the rest of a block already started are not counted. NULL for none.
+    */
+    void blockHook(void (*hook)(uint8_t kind, uint32_t block)) {
+      ioHook_ = hook;
+    }
   private:
     uint32_t block_;
+    uint8_t deferBusy_;
     uint8_t chipSelectPin_;
     uint8_t errorCode_;
     uint8_t inBlock_;
@@ -250,15 +303,37 @@ class Sd2Card {
     uint8_t partialBlockRead_;
     uint8_t status_;
     uint8_t type_;
+    uint8_t writePending_;
+    uint8_t powerOff_;
+    void (*powerUp_)(void);
+    uint8_t sckRateID_;
+    uint32_t spiClock_;
+    cid_t cid_;
+    void (*latHook_)(uint8_t kind, uint32_t us);
+    uint32_t latUs_;
+    uint8_t latOp_;
+    void (*ioHook_)(uint8_t kind, uint32_t block);
+    uint32_t ioBlock_;
     // private functions
     uint8_t cardAcmd(uint8_t cmd, uint32_t arg) {
       cardCommand(CMD55, 0);
       return cardCommand(cmd, arg);
     }
     uint8_t cardCommand(uint8_t cmd, uint32_t arg);
+    uint8_t powerOn(void);
     void error(uint8_t code) {
       errorCode_ = code;
     }
+    void latency(uint8_t kind, uint32_t us) {
+      if (latHook_) {
+        latHook_(kind, us);
+      }
+    }
+    void blockIo(uint8_t kind, uint32_t block) {
+      if (ioHook_) {
+        ioHook_(kind, block);
+      }
+    }
     uint8_t readRegister(uint8_t cmd, void* buf);
     uint8_t sendWriteCommand(uint32_t blockNumber, uint32_t eraseCount);
     void chipSelectHigh(void);
@@ -35,6 +35,15 @@
 */
 #define ALLOW_DEPRECATED_FUNCTIONS 1
 //------------------------------------------------------------------------------
+/**
+   Blocks held by the SdVolume cache, 512 bytes of RAM each.  With three a
+   file's data block, its FAT block and its directory block stay cached
+   together.  One behaves as a single block cache.
+*/
+#ifndef SD_CACHE_SLOTS
+#define SD_CACHE_SLOTS 3
+#endif
+//------------------------------------------------------------------------------
 // forward declaration since SdVolume is used in SdFile
 class SdVolume;
 //==============================================================================
@@ -473,6 +482,8 @@ union cache_t {
   mbr_t    mbr;
   /** Used to access to a cached FAT boot sector. */
   fbs_t    fbs;
+  /** Used to access a cached FAT32 FSINFO sector. */
+  fsinfo_t fsinfo;
 };
 //------------------------------------------------------------------------------
 /**
@@ -482,14 +493,28 @@ union cache_t {
 class SdVolume {
   public:
     /** Create an instance of SdVolume */
-    SdVolume(void) : allocSearchStart_(2), fatType_(0) {}
+    SdVolume(void) : allocSearchStart_(2), fatType_(0), freeClusters_(FSINFO_UNKNOWN),
+      fsInfoBlock_(0), fsInfoDirty_(0) {}
     /** Clear the cache and returns a pointer to the cache.  Used by the WaveRP
         recorder to do raw write to the SD card.  Not for normal apps.
     */
     static uint8_t* cacheClear(void) {
       cacheFlush();
-      cacheBlockNumber_ = 0XFFFFFFFF;
-      return cacheBuffer_.data;
+      for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+        cacheValid_[i] = 0;
+      }
+      // the last slot to be taken again
+      return cacheBuffer_[cacheCur_].data;
+    }
+    /** Forget the cached blocks, dirty or not. For a card that was removed,
+        its blocks must not be written to the card that replaces it.
+    */
+    static void cacheInvalidate(void) {
+      for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+        cacheValid_[i] = 0;
+        cacheDirty_[i] = 0;
+        cacheMirrorBlock_[i] = 0;
+      }
     }
     /**
        Initialize a FAT volume.  Try partition one first then try super
@@ -536,6 +561,11 @@ class SdVolume {
     uint32_t fatStartBlock(void) const {
       return fatStartBlock_;
     }
+    /** \return Free clusters on a FAT32 volume from its FSINFO sector, kept
+        as clusters are allocated and freed, 0XFFFFFFFF if not known. */
+    uint32_t freeClusterCount(void) const {
+      return freeClusters_;
+    }
     /** \return The FAT type of the volume. Values are 12, 16 or 32. */
     uint8_t fatType(void) const {
       return fatType_;
@@ -575,12 +605,20 @@ class SdVolume {
     static uint8_t const CACHE_FOR_READ = 0;
     // value for action argument in cacheRawBlock to indicate cache dirty
     static uint8_t const CACHE_FOR_WRITE = 1;
+    // kinds of cached block in the order cacheFlush() writes them
+    static uint8_t const CACHE_KIND_DATA = 0;
+    static uint8_t const CACHE_KIND_FAT = 1;
+    static uint8_t const CACHE_KIND_DIR = 2;
 
-    static cache_t cacheBuffer_;        // 512 byte cache for device blocks
-    static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
-    static Sd2Card* sdCard_;            // Sd2Card object for cache
-    static uint8_t cacheDirty_;         // cacheFlush() will write block if true
-    static uint32_t cacheMirrorBlock_;  // block number for mirror FAT
+    static cache_t cacheBuffer_[SD_CACHE_SLOTS];       // 512 byte cache for device blocks
+    static uint32_t cacheBlockNumber_[SD_CACHE_SLOTS]; // Logical number of block in each slot
+    static Sd2Card* sdCard_;                           // Sd2Card object for cache
+    static uint8_t cacheValid_[SD_CACHE_SLOTS];        // slot holds its block
+    static uint8_t cacheDirty_[SD_CACHE_SLOTS];        // cacheFlush() will write block if true
+    static uint8_t cacheKind_[SD_CACHE_SLOTS];         // CACHE_KIND_ of a block
+    static uint8_t cacheAge_[SD_CACHE_SLOTS];          // least recently used has the highest
+    static uint32_t cacheMirrorBlock_[SD_CACHE_SLOTS]; // block number for mirror FAT
+    static uint8_t cacheCur_;                          // slot of the block last cached
     //
     uint32_t allocSearchStart_;   // start cluster for alloc search
     uint8_t blocksPerCluster_;    // cluster size in blocks
@@ -593,6 +631,9 @@ class SdVolume {
     uint8_t fatType_;             // volume type (12, 16, OR 32)
     uint16_t rootDirEntryCount_;  // number of entries in FAT16 root dir
     uint32_t rootDirStart_;       // root start block for FAT16, cluster for FAT32
+    uint32_t freeClusters_;       // FSINFO free count, FSINFO_UNKNOWN if not known
+    uint32_t fsInfoBlock_;        // FSINFO block of a FAT32 volume, zero if none
+    uint8_t fsInfoDirty_;         // fsInfoFlush() will write FSINFO if true
     //----------------------------------------------------------------------------
     uint8_t allocContiguous(uint32_t count, uint32_t* curCluster);
     uint8_t blockOfCluster(uint32_t position) const {
@@ -604,11 +645,26 @@ class SdVolume {
     uint32_t blockNumber(uint32_t cluster, uint32_t position) const {
       return clusterStartBlock(cluster) + blockOfCluster(position);
     }
+    static uint8_t cacheClaim(uint32_t blockNumber, uint8_t* cached);
+    /** \return The block last cached, cacheRawBlock() and friends leave it here. */
+    static cache_t* cacheCurrent(void) {
+      return &cacheBuffer_[cacheCur_];
+    }
+    /** \return The number of the block last cached, 0XFFFFFFFF if none. */
+    static uint32_t cacheCurrentBlock(void) {
+      return cacheValid_[cacheCur_] ? cacheBlockNumber_[cacheCur_] : 0XFFFFFFFF;
+    }
+    static void cacheDrop(uint32_t blockNumber, uint32_t count);
+    static int8_t cacheFind(uint32_t blockNumber);
     static uint8_t cacheFlush(uint8_t blocking = 1);
     static uint8_t cacheMirrorBlockFlush(uint8_t blocking);
+    static uint8_t cacheNewBlock(uint32_t blockNumber);
     static uint8_t cacheRawBlock(uint32_t blockNumber, uint8_t action);
+    static void cacheSetDir(void) {
+      cacheKind_[cacheCur_] = CACHE_KIND_DIR;
+    }
     static void cacheSetDirty(void) {
-      cacheDirty_ |= CACHE_FOR_WRITE;
+      cacheDirty_[cacheCur_] |= CACHE_FOR_WRITE;
     }
     static uint8_t cacheZeroBlock(uint32_t blockNumber);
     uint8_t chainSize(uint32_t beginCluster, uint32_t* size) const;
@@ -618,6 +674,7 @@ class SdVolume {
       return fatPut(cluster, 0x0FFFFFFF);
     }
     uint8_t freeChain(uint32_t cluster);
+    uint8_t fsInfoFlush(void);
     uint8_t isEOC(uint32_t cluster) const {
       return  cluster >= (fatType_ == 16 ? FAT16EOC_MIN : FAT32EOC_MIN);
     }
@@ -631,11 +688,28 @@ class SdVolume {
     uint8_t writeBlock(uint32_t block, const uint8_t* dst, uint8_t blocking = 1) {
       return sdCard_->writeBlock(block, dst, blocking);
     }
+    // count blocks from src in one pre-erased multiple block write (CMD25)
+    uint8_t writeBlocks(uint32_t block, const uint8_t* src, uint8_t count) {
+      if (!sdCard_->writeStart(block, count)) {
+        return false;
+      }
+      for (uint8_t i = 0; i < count; i++, src += 512) {
+        if (!sdCard_->writeData(src)) {
+          return false;
+        }
+      }
+      return sdCard_->writeStop();
+    }
     uint8_t isBusy(void) {
       return sdCard_->isBusy();
     }
     uint8_t isCacheMirrorBlockDirty(void) {
-      return (cacheMirrorBlock_ != 0);
+      for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+        if (cacheMirrorBlock_[i] != 0) {
+          return true;
+        }
+      }
+      return false;
     }
 };
 #endif  // SdFat_h
@@ -71,7 +71,10 @@ dir_t* SdFile::cacheDirEntry(uint8_t action) {
   if (!SdVolume::cacheRawBlock(dirBlock_, action)) {
     return NULL;
   }
-  return SdVolume::cacheBuffer_.dir + dirIndex_;
+  if (action == SdVolume::CACHE_FOR_WRITE) {
+    SdVolume::cacheSetDir();
+  }
+  return SdVolume::cacheCurrent()->dir + dirIndex_;
 }
 //------------------------------------------------------------------------------
 /**
@@ -383,7 +386,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
   }
 
   // copy '.' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[0], &d, sizeof(d));
+  memcpy(&SdVolume::cacheCurrent()->dir[0], &d, sizeof(d));
 
   // make entry for '..'
   d.name[1] = '.';
@@ -395,7 +398,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
     d.firstClusterHigh = dir->firstCluster_ >> 16;
   }
   // copy '..' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[1], &d, sizeof(d));
+  memcpy(&SdVolume::cacheCurrent()->dir[1], &d, sizeof(d));
 
   // set position after '..'
   curPosition_ = 2 * sizeof(d);
@@ -481,7 +484,7 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
       if (!emptyFound) {
         emptyFound = true;
         dirIndex_ = index;
-        dirBlock_ = SdVolume::cacheBlockNumber_;
+        dirBlock_ = SdVolume::cacheCurrentBlock();
       }
       // done if no entries follow
       if (p->name[0] == DIR_NAME_FREE) {
@@ -520,7 +523,7 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
 
     // use first entry in cluster
     dirIndex_ = 0;
-    p = SdVolume::cacheBuffer_.dir;
+    p = SdVolume::cacheCurrent()->dir;
   }
   // initialize as empty file
   memset(p, 0, sizeof(dir_t));
@@ -598,7 +601,7 @@ uint8_t SdFile::open(SdFile* dirFile, uint16_t index, uint8_t oflag) {
 // open a cached directory entry. Assumes vol_ is initializes
 uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   // location of entry in cache
-  dir_t* p = SdVolume::cacheBuffer_.dir + dirIndex;
+  dir_t* p = SdVolume::cacheCurrent()->dir + dirIndex;
 
   // write or truncate is an error for a directory or read-only file
   if (p->attributes & (DIR_ATT_READ_ONLY | DIR_ATT_DIRECTORY)) {
@@ -608,7 +611,7 @@ uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   }
   // remember location of directory entry on SD
   dirIndex_ = dirIndex;
-  dirBlock_ = SdVolume::cacheBlockNumber_;
+  dirBlock_ = SdVolume::cacheCurrentBlock();
 
   // copy first cluster number for directory fields
   firstCluster_ = (uint32_t)p->firstClusterHigh << 16;
@@ -811,7 +814,7 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
 
     // no buffering needed if n == 512 or user requests no buffering
     if ((unbufferedRead() || n == 512) &&
-        block != SdVolume::cacheBlockNumber_) {
+        SdVolume::cacheFind(block) < 0) {
       if (!vol_->readData(block, offset, n, dst)) {
         return -1;
       }
@@ -821,7 +824,7 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
       if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) {
         return -1;
       }
-      uint8_t* src = SdVolume::cacheBuffer_.data + offset;
+      uint8_t* src = SdVolume::cacheCurrent()->data + offset;
       uint8_t* end = src + n;
       while (src != end) {
         *dst++ = *src++;
@@ -889,7 +892,7 @@ dir_t* SdFile::readDirCache(void) {
   curPosition_ += 31;
 
   // return pointer to entry
-  return (SdVolume::cacheBuffer_.dir + i);
+  return (SdVolume::cacheCurrent()->dir + i);
 }
 //------------------------------------------------------------------------------
 /**
@@ -1159,6 +1162,11 @@ uint8_t SdFile::sync(uint8_t blocking) {
     flags_ &= ~F_FILE_DIR_DIRTY;
   }
 
+  // allocation hints, only after clusters were taken or freed
+  if (!vol_->fsInfoFlush()) {
+    return false;
+  }
+
   if (!blocking) {
     flags_ &= ~F_FILE_NON_BLOCKING_WRITE;
   }
@@ -1388,30 +1396,36 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
     // block for data write
     uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
     if (n == 512) {
-      // full block - don't need to use cache
-      // invalidate cache if block is in cache
-      if (SdVolume::cacheBlockNumber_ == block) {
-        SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
+      // full blocks - don't need to use cache
+      // the ones left in this cluster go in one multiple block write
+      uint16_t count = vol_->blocksPerCluster() - blockOfCluster;
+      if (count > (nToWrite >> 9)) {
+        count = nToWrite >> 9;
       }
-      if (!vol_->writeBlock(block, src, blocking)) {
+      // invalidate cache if a block is in cache
+      SdVolume::cacheDrop(block, count);
+      if (count > 1 && blocking) {
+        if (!vol_->writeBlocks(block, src, count)) {
+          goto writeErrorReturn;
+        }
+        n = count << 9;
+      } else if (!vol_->writeBlock(block, src, blocking)) {
         goto writeErrorReturn;
       }
-      src += 512;
+      src += n;
     } else {
       if (blockOffset == 0 && curPosition_ >= fileSize_) {
         // start of new block don't need to read into cache
-        if (!SdVolume::cacheFlush()) {
+        if (!SdVolume::cacheNewBlock(block)) {
           goto writeErrorReturn;
         }
-        SdVolume::cacheBlockNumber_ = block;
-        SdVolume::cacheSetDirty();
       } else {
         // rewrite part of block
         if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) {
           goto writeErrorReturn;
         }
       }
-      uint8_t* dst = SdVolume::cacheBuffer_.data + blockOffset;
+      uint8_t* dst = SdVolume::cacheCurrent()->data + blockOffset;
       uint8_t* end = dst + n;
       while (dst != end) {
         *dst++ = *src++;
@@ -19,13 +19,16 @@
 */
 #include "SdFat.h"
 //------------------------------------------------------------------------------
-// raw block cache
-// init cacheBlockNumber_to invalid SD block number
-uint32_t SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
-cache_t  SdVolume::cacheBuffer_;     // 512 byte cache for Sd2Card
-Sd2Card* SdVolume::sdCard_;          // pointer to SD card object
-uint8_t  SdVolume::cacheDirty_ = 0;  // cacheFlush() will write block if true
-uint32_t SdVolume::cacheMirrorBlock_ = 0;  // mirror  block for second FAT
+// raw block cache, SD_CACHE_SLOTS blocks, all start empty
+cache_t  SdVolume::cacheBuffer_[SD_CACHE_SLOTS];       // 512 byte blocks for Sd2Card
+uint32_t SdVolume::cacheBlockNumber_[SD_CACHE_SLOTS];  // block in each slot
+Sd2Card* SdVolume::sdCard_;                            // pointer to SD card object
+uint8_t  SdVolume::cacheValid_[SD_CACHE_SLOTS];        // slot holds its block
+uint8_t  SdVolume::cacheDirty_[SD_CACHE_SLOTS];        // cacheFlush() will write block if true
+uint8_t  SdVolume::cacheKind_[SD_CACHE_SLOTS];         // write-back order of a dirty block
+uint8_t  SdVolume::cacheAge_[SD_CACHE_SLOTS];          // uses of other slots since last used
+uint32_t SdVolume::cacheMirrorBlock_[SD_CACHE_SLOTS];  // mirror block for second FAT
+uint8_t  SdVolume::cacheCur_ = 0;                      // slot last cached
 //------------------------------------------------------------------------------
 // find a contiguous group of clusters
 uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
@@ -100,69 +103,166 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   // return first cluster number to caller
   *curCluster = bgnCluster;
 
-  // remember possible next free cluster
+  // remember possible next free cluster, no free cluster was passed over
+  // when the group starts where the search did
   if (setStart) {
     allocSearchStart_ = bgnCluster + 1;
+  } else if (bgnCluster == allocSearchStart_) {
+    allocSearchStart_ = bgnCluster + count;
   }
+  if (freeClusters_ != FSINFO_UNKNOWN) {
+    freeClusters_ = freeClusters_ > count ? freeClusters_ - count : 0;
+  }
+  fsInfoDirty_ = fsInfoBlock_ != 0;
 
   return true;
 }
 //------------------------------------------------------------------------------
-uint8_t SdVolume::cacheFlush(uint8_t blocking) {
-  if (cacheDirty_) {
-    if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data, blocking)) {
-      return false;
+// take a slot for blockNumber and make it the current one, cached is set
+// if the slot already holds the block.  Otherwise the least recently used
+// clean slot is taken, an empty one first.  When every slot is dirty they
+// are all written, in order, so a FAT or directory block never goes out
+// ahead of the blocks it points to.
+uint8_t SdVolume::cacheClaim(uint32_t blockNumber, uint8_t* cached) {
+  int8_t slot = cacheFind(blockNumber);
+
+  *cached = slot >= 0;
+  if (slot < 0) {
+    uint16_t oldest = 0;
+    for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+      uint16_t age = cacheValid_[i] ? cacheAge_[i] : 0X100 + cacheAge_[i];
+      if (!cacheDirty_[i] && (slot < 0 || age > oldest)) {
+        slot = i;
+        oldest = age;
+      }
     }
-
-    if (!blocking) {
-      return true;
+    if (slot < 0) {
+      if (!cacheFlush()) {
+        return false;
+      }
+      slot = 0;
+      for (uint8_t i = 1; i < SD_CACHE_SLOTS; i++) {
+        if (cacheAge_[i] > cacheAge_[slot]) {
+          slot = i;
+        }
+      }
     }
-
-    // mirror FAT tables
-    if (!cacheMirrorBlockFlush(blocking)) {
-      return false;
+    cacheBlockNumber_[slot] = blockNumber;
+    cacheValid_[slot] = 1;
+    cacheKind_[slot] = CACHE_KIND_DATA;
+    cacheMirrorBlock_[slot] = 0;
+  }
+  // age the other slots
+  for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+    if (cacheAge_[i] < 0XFF) {
+      cacheAge_[i]++;
+    }
+  }
+  cacheAge_[slot] = 0;
+  cacheCur_ = slot;
+  return true;
+}
+//------------------------------------------------------------------------------
+// forget cached blocks in [blockNumber, blockNumber + count), the caller
+// writes them directly
+void SdVolume::cacheDrop(uint32_t blockNumber, uint32_t count) {
+  for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+    if (cacheValid_[i] && cacheBlockNumber_[i] >= blockNumber &&
+        cacheBlockNumber_[i] < blockNumber + count) {
+      cacheValid_[i] = 0;
+      cacheDirty_[i] = 0;
+      cacheMirrorBlock_[i] = 0;
+    }
+  }
+}
+//------------------------------------------------------------------------------
+// slot holding blockNumber, -1 if it is not cached
+int8_t SdVolume::cacheFind(uint32_t blockNumber) {
+  for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+    if (cacheValid_[i] && cacheBlockNumber_[i] == blockNumber) {
+      return i;
+    }
+  }
+  return -1;
+}
+//------------------------------------------------------------------------------
+// write the dirty blocks, file data first then the FAT then directory
+// entries so the FAT and the entries only ever point at written data
+uint8_t SdVolume::cacheFlush(uint8_t blocking) {
+  for (uint8_t kind = CACHE_KIND_DATA; kind <= CACHE_KIND_DIR; kind++) {
+    for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+      if (!cacheDirty_[i] || cacheKind_[i] != kind) {
+        continue;
+      }
+      if (!sdCard_->writeBlock(cacheBlockNumber_[i], cacheBuffer_[i].data, blocking)) {
+        return false;
+      }
+
+      if (!blocking) {
+        continue;
+      }
+
+      // mirror FAT tables
+      if (cacheMirrorBlock_[i]) {
+        if (!sdCard_->writeBlock(cacheMirrorBlock_[i], cacheBuffer_[i].data, blocking)) {
+          return false;
+        }
+        cacheMirrorBlock_[i] = 0;
+      }
+      cacheDirty_[i] = 0;
     }
-    cacheDirty_ = 0;
   }
   return true;
 }
 //------------------------------------------------------------------------------
 uint8_t SdVolume::cacheMirrorBlockFlush(uint8_t blocking) {
-  if (cacheMirrorBlock_) {
-    if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_.data, blocking)) {
-      return false;
+  for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+    if (cacheMirrorBlock_[i]) {
+      if (!sdCard_->writeBlock(cacheMirrorBlock_[i], cacheBuffer_[i].data, blocking)) {
+        return false;
+      }
+      cacheMirrorBlock_[i] = 0;
     }
-    cacheMirrorBlock_ = 0;
   }
   return true;
 }
 //------------------------------------------------------------------------------
+// cache blockNumber for a write that fills it, it is not read
+uint8_t SdVolume::cacheNewBlock(uint32_t blockNumber) {
+  uint8_t cached;
+
+  if (!cacheClaim(blockNumber, &cached)) {
+    return false;
+  }
+  cacheSetDirty();
+  return true;
+}
+//------------------------------------------------------------------------------
 uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action) {
-  if (cacheBlockNumber_ != blockNumber) {
-    if (!cacheFlush()) {
-      return false;
-    }
-    if (!sdCard_->readBlock(blockNumber, cacheBuffer_.data)) {
-      return false;
-    }
-    cacheBlockNumber_ = blockNumber;
+  uint8_t cached;
+
+  if (!cacheClaim(blockNumber, &cached)) {
+    return false;
   }
-  cacheDirty_ |= action;
+  if (!cached && !sdCard_->readBlock(blockNumber, cacheBuffer_[cacheCur_].data)) {
+    cacheValid_[cacheCur_] = 0;
+    return false;
+  }
+  cacheDirty_[cacheCur_] |= action;
   return true;
 }
 //------------------------------------------------------------------------------
 // cache a zero block for blockNumber
 uint8_t SdVolume::cacheZeroBlock(uint32_t blockNumber) {
-  if (!cacheFlush()) {
+  if (!cacheNewBlock(blockNumber)) {
     return false;
   }
 
   // loop take less flash than memset(cacheBuffer_.data, 0, 512);
+  uint8_t* data = cacheBuffer_[cacheCur_].data;
   for (uint16_t i = 0; i < 512; i++) {
-    cacheBuffer_.data[i] = 0;
+    data[i] = 0;
   }
-  cacheBlockNumber_ = blockNumber;
-  cacheSetDirty();
   return true;
 }
 //------------------------------------------------------------------------------
@@ -186,15 +286,15 @@ uint8_t SdVolume::fatGet(uint32_t cluster, uint32_t* value) const {
   }
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
-  if (lba != cacheBlockNumber_) {
+  if (lba != cacheCurrentBlock()) {
     if (!cacheRawBlock(lba, CACHE_FOR_READ)) {
       return false;
     }
   }
   if (fatType_ == 16) {
-    *value = cacheBuffer_.fat16[cluster & 0XFF];
+    *value = cacheCurrent()->fat16[cluster & 0XFF];
   } else {
-    *value = cacheBuffer_.fat32[cluster & 0X7F] & FAT32MASK;
+    *value = cacheCurrent()->fat32[cluster & 0X7F] & FAT32MASK;
   }
   return true;
 }
@@ -215,31 +315,29 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
 
-  if (lba != cacheBlockNumber_) {
+  if (lba != cacheCurrentBlock()) {
     if (!cacheRawBlock(lba, CACHE_FOR_READ)) {
       return false;
     }
   }
   // store entry
   if (fatType_ == 16) {
-    cacheBuffer_.fat16[cluster & 0XFF] = value;
+    cacheCurrent()->fat16[cluster & 0XFF] = value;
   } else {
-    cacheBuffer_.fat32[cluster & 0X7F] = value;
+    cacheCurrent()->fat32[cluster & 0X7F] = value;
   }
   cacheSetDirty();
+  cacheKind_[cacheCur_] = CACHE_KIND_FAT;
 
   // mirror second FAT
   if (fatCount_ > 1) {
-    cacheMirrorBlock_ = lba + blocksPerFat_;
+    cacheMirrorBlock_[cacheCur_] = lba + blocksPerFat_;
   }
   return true;
 }
 //------------------------------------------------------------------------------
 // free a cluster chain
 uint8_t SdVolume::freeChain(uint32_t cluster) {
-  // clear free cluster location
-  allocSearchStart_ = 2;
-
   do {
     uint32_t next;
     if (!fatGet(cluster, &next)) {
@@ -251,12 +349,35 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
       return false;
     }
 
+    // move free cluster location back
+    if (cluster < allocSearchStart_) {
+      allocSearchStart_ = cluster;
+    }
+    if (freeClusters_ != FSINFO_UNKNOWN) {
+      freeClusters_++;
+    }
+    fsInfoDirty_ = fsInfoBlock_ != 0;
+
     cluster = next;
   } while (!isEOC(cluster));
 
   return true;
 }
 //------------------------------------------------------------------------------
+// write the free count and next free hints to FSINFO, they have changed
+uint8_t SdVolume::fsInfoFlush(void) {
+  if (!fsInfoDirty_) {
+    return true;
+  }
+  if (!cacheRawBlock(fsInfoBlock_, CACHE_FOR_WRITE)) {
+    return false;
+  }
+  cacheCurrent()->fsinfo.freeCount = freeClusters_;
+  cacheCurrent()->fsinfo.nextFree = allocSearchStart_;
+  fsInfoDirty_ = 0;
+  return true;
+}
+//------------------------------------------------------------------------------
 /**
    Initialize a FAT volume.
 
@@ -275,6 +396,10 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
 uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   uint32_t volumeStartBlock = 0;
   sdCard_ = dev;
+  allocSearchStart_ = 2;  // card may have been swapped since the last init
+  freeClusters_ = FSINFO_UNKNOWN;
+  fsInfoBlock_ = 0;
+  fsInfoDirty_ = 0;
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
@@ -284,7 +409,7 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) {
       return false;
     }
-    part_t* p = &cacheBuffer_.mbr.part[part - 1];
+    part_t* p = &cacheCurrent()->mbr.part[part - 1];
     if ((p->boot & 0X7F) != 0  ||
         p->totalSectors < 100 ||
         p->firstSector == 0) {
@@ -296,7 +421,7 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) {
     return false;
   }
-  bpb_t* bpb = &cacheBuffer_.fbs.bpb;
+  bpb_t* bpb = &cacheCurrent()->fbs.bpb;
   if (bpb->bytesPerSector != 512 ||
       bpb->fatCount == 0 ||
       bpb->reservedSectorCount == 0 ||
@@ -346,6 +471,27 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   } else {
     rootDirStart_ = bpb->fat32RootCluster;
     fatType_ = 32;
+
+    // start the first allocation at the FSINFO hints instead of scanning
+    // the FAT from cluster 2, they are checked as clusters are taken
+    if (bpb->fat32FSInfo && bpb->fat32FSInfo < bpb->reservedSectorCount) {
+      uint32_t fsInfoBlock = volumeStartBlock + bpb->fat32FSInfo;
+      if (!cacheRawBlock(fsInfoBlock, CACHE_FOR_READ)) {
+        return false;
+      }
+      fsinfo_t* fsi = &cacheCurrent()->fsinfo;
+      if (fsi->leadSignature == FSINFO_LEAD_SIG &&
+          fsi->structSignature == FSINFO_STRUCT_SIG &&
+          fsi->tailSignature == FSINFO_TAIL_SIG) {
+        fsInfoBlock_ = fsInfoBlock;
+        if (fsi->nextFree >= 2 && fsi->nextFree <= clusterCount_ + 1) {
+          allocSearchStart_ = fsi->nextFree;
+        }
+        if (fsi->freeCount <= clusterCount_) {
+          freeClusters_ = fsi->freeCount;
+        }
+      }
+    }
   }
   return true;
 }
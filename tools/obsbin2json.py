@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""
+obsbin2json.py - Convert SSG_FAL_ULP binary observation logs (/OBS/YYYYMMDD.bin) to JSON lines
+
+The output matches what OBS_Do() writes to the .log file, including its number
+formatting: sign, integer part, fraction truncated toward zero. Records hold
+values * 100, so fields logged with 4 fraction digits (bp, mt, dt) come back
+with the last two digits 0.
+
+Burst capture logs (/OBS/YYYYMMDD.bst) are the same records, packed so none
+crosses a 512 byte block, with the rest of each block zero but for the block's
+CRC32 in its last 4 bytes. A zero type byte skips to the next block.
+
+Type 4 records end with their CRC32 and a finished day's .bin with a footer,
+the CRC32 of the file before it. A .bin started by this firmware begins with
+a schema header, the record type and size and the firmware, printed as the
+schema line the .log starts with. The record flags are the presence bitmap of
+its sections, the output of each bitmap is laid out once and reused. A record
+or block whose CRC does not match is reported on stderr and still converted,
+obscrc.py checks files without converting them.
+
+Usage: obsbin2json.py YYYYMMDD.bin [...] > YYYYMMDD.log
+"""
+import functools
+import struct
+import sys
+import zlib
+from datetime import datetime, timezone
+
+# OBS_BINREC in OBS.h
+OBS_BIN_ERR = -32768
+OBS_BIN_ERR_V100 = -99990        # (int)(QC_ERR_*100)
+
+OBS_BIN_F_STREAM = 0x01
+OBS_BIN_F_BMX_1 = 0x02
+OBS_BIN_F_BMX_2 = 0x04
+OBS_BIN_F_MCP_1 = 0x08
+OBS_BIN_F_DS = 0x10
+OBS_BIN_F_MCP_2 = 0x20
+OBS_BIN_F_LATE = 0x40
+OBS_BIN_F_BV = 0x80             # From type 5, bv was always there before
+
+DS_MAX_PROBES = 8
+
+# Record layouts by type byte, type 1 has a single DS18B20 as dt1, type 3 adds mt2, type 4 the CRC32,
+# type 5 is type 4 with hth 0x40 and 0x200 meaning OVERRUN and WDT
+REC_V1 = struct.Struct("<BBIhhhhihhihhhhhH")                        # 38 bytes
+REC_V2 = struct.Struct("<BBIhhhhihhihhhhHB%dh" % DS_MAX_PROBES)     # 53 bytes
+REC_V3 = struct.Struct("<BBIhhhhihhihhhhhHB%dh" % DS_MAX_PROBES)    # 55 bytes
+REC_V4 = struct.Struct("<BBIhhhhihhihhhhhHB%dhI" % DS_MAX_PROBES)   # 59 bytes
+RECS = {1: REC_V1, 2: REC_V2, 3: REC_V3, 4: REC_V4, 5: REC_V4}
+
+# SD_BINFTR, SD_BINHDR and the .bst blocks in SDC.h
+FOOTER = struct.Struct("<BBIII")                                    # 14 bytes
+SD_BIN_FOOTER = 0xFC
+HEADER = struct.Struct("<BBBBI20sI")                                # 32 bytes
+SD_BIN_HEADER = 0xFD
+SD_SCHEMA = 1                # Log schema of the record types before 5, 2 from it
+BLOCK = 512
+BLOCK_DATA = 508
+
+
+def footer_ok(data):
+    """ True, False or None (no footer) for the footer at the end of a .bin """
+    if len(data) < FOOTER.size or data[-FOOTER.size] != SD_BIN_FOOTER:
+        return None
+    _, _, _, nbytes, crc = FOOTER.unpack_from(data, len(data) - FOOTER.size)
+    return nbytes == len(data) - FOOTER.size and zlib.crc32(data[:nbytes]) == crc
+
+
+def block_ok(data, off):
+    """ CRC32 check of the .bst block at off """
+    crc, = struct.unpack_from("<I", data, off + BLOCK_DATA)
+    return zlib.crc32(data[off:off + BLOCK_DATA]) == crc
+
+
+def records(data, path, bst=False):
+    """ Bytes of each record of a .bin or .bst file, CRC mismatches and the rest of a bad file go to stderr """
+    off = 0
+    while off < len(data):
+        if bst and off % BLOCK == 0 and off + BLOCK <= len(data) and not block_ok(data, off):
+            sys.stderr.write("%s: block %d CRC\n" % (path, off // BLOCK))
+        if data[off] == 0 or (bst and off % BLOCK >= BLOCK_DATA):
+            off = (off // BLOCK + 1) * BLOCK  # .bst padding
+            continue
+        if data[off] == SD_BIN_FOOTER and off + FOOTER.size == len(data):
+            if not footer_ok(data):
+                sys.stderr.write("%s: footer CRC\n" % path)
+            return
+        if data[off] == SD_BIN_HEADER and off + HEADER.size <= len(data):
+            h = HEADER.unpack_from(data, off)
+            if zlib.crc32(data[off:off + HEADER.size - 4]) != h[-1]:
+                sys.stderr.write("%s: header CRC at offset %d\n" % (path, off))
+            elif h[1] not in RECS or RECS[h[1]].size != h[2]:
+                sys.stderr.write("%s: header names type %d of %d bytes, not known\n" % (path, h[1], h[2]))
+            yield data[off:off + HEADER.size]
+            off += HEADER.size
+            continue
+        rec = RECS.get(data[off])
+        if rec is None or off + rec.size > len(data):
+            sys.stderr.write("%s: bad record at offset %d, %d bytes ignored\n" % (path, off, len(data) - off))
+            return
+        if rec is REC_V4 and zlib.crc32(data[off:off + rec.size - 4]) != REC_V4.unpack_from(data, off)[-1]:
+            sys.stderr.write("%s: record CRC at offset %d\n" % (path, off))
+        yield data[off:off + rec.size]
+        off += rec.size
+
+
+def c_fixed(v100, digits):
+    """ jb_putfixed() of a value the firmware stored as value * 100 truncated """
+    if v100 == OBS_BIN_ERR:
+        v100 = OBS_BIN_ERR_V100
+    a = abs(v100)
+    return "%s%d.%02d%s" % ("-" if v100 < 0 else "", a // 100, a % 100, "0" * (digits - 2))
+
+
+@functools.lru_cache(maxsize=None)
+def layout(flags, dtn):
+    """ Format of a record with these presence bits and dtn probes, and the (field, digits) it takes, digits 0 = int """
+    cols = [("sg", 0)]
+    if flags & OBS_BIN_F_STREAM:
+        cols += [("sgmin", 0), ("sgmax", 0), ("sgiqr", 0)]
+    if flags & OBS_BIN_F_BMX_1:
+        cols += [("bp1", 4), ("bt1", 2), ("bh1", 2)]
+    if flags & OBS_BIN_F_BMX_2:
+        cols += [("bp2", 4), ("bt2", 2), ("bh2", 2)]
+    if flags & OBS_BIN_F_MCP_1:
+        cols += [("mt1", 4)]
+    if flags & OBS_BIN_F_MCP_2:
+        cols += [("mt2", 4)]
+    if flags & OBS_BIN_F_DS:
+        cols += [("dt%d" % (i + 1), 4) for i in range(dtn)]
+    if flags & OBS_BIN_F_BV:
+        cols += [("bv", 2)]
+    fmt = '{"at":"%s",' + "".join('"%s":%s,' % (k, "%d" if d == 0 else "%s") for k, d in cols)
+    if flags & OBS_BIN_F_LATE:
+        fmt += '"late":1,'
+    fmt += '"hth":%d}'
+    return fmt, tuple(cols)
+
+
+def record_to_json(rec):
+    rtype = rec[0]
+    mt2 = 0
+    if rtype == SD_BIN_HEADER:
+        h = HEADER.unpack(rec)
+        schema = SD_SCHEMA + 1 if h[1] >= 5 else SD_SCHEMA
+        return '{"schema":%d,"fw":"%s"}' % (schema, h[5].rstrip(b"\0").decode("ascii", "replace"))
+    if rtype == 1:
+        (rtype, flags, at, sg, sgmin, sgmax, sgiqr,
+         bp1, bt1, bh1, bp2, bt2, bh2, mt1, dt1, bv, hth) = REC_V1.unpack(rec)
+        dt = [dt1]
+    elif rtype == 2:
+        v = REC_V2.unpack(rec)
+        (rtype, flags, at, sg, sgmin, sgmax, sgiqr,
+         bp1, bt1, bh1, bp2, bt2, bh2, mt1, bv, hth, dtn) = v[:17]
+        dt = list(v[17:17 + dtn])
+    elif rtype in (3, 4, 5):
+        v = RECS[rtype].unpack(rec)
+        (rtype, flags, at, sg, sgmin, sgmax, sgiqr,
+         bp1, bt1, bh1, bp2, bt2, bh2, mt1, mt2, bv, hth, dtn) = v[:18]
+        dt = list(v[18:18 + dtn])
+    else:
+        raise ValueError("unknown record type %d" % rtype)
+
+    if rtype < 5:
+        flags |= OBS_BIN_F_BV
+    t = datetime.fromtimestamp(at, timezone.utc)
+    fields = {"sg": sg, "sgmin": sgmin, "sgmax": sgmax, "sgiqr": sgiqr, "bp1": bp1, "bt1": bt1, "bh1": bh1,
+              "bp2": bp2, "bt2": bt2, "bh2": bh2, "mt1": mt1, "mt2": mt2, "bv": bv}
+    for i, d in enumerate(dt):
+        fields["dt%d" % (i + 1)] = d
+    fmt, cols = layout(flags, len(dt))
+    return fmt % ((t.strftime("%Y-%m-%dT%H:%M:%S"),) +
+                  tuple(fields[k] if d == 0 else c_fixed(fields[k], d) for k, d in cols) + (hth,))
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    for path in argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read()
+        for rec in records(data, path, path.lower().endswith(".bst")):
+            sys.stdout.write(record_to_json(rec) + "\r\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""
+obscheck.py - Check the observation logs of many SSG_FAL_ULP cards for missing and doubled slots
+
+Each /OBS/YYYYMMDD.log is memory-mapped and scanned for its records, one
+process per file, then every station (the directory holding OBS) is checked
+against the schedule of seconds_to_next_obs(): observations on multiples of
+the interval since midnight UTC.
+
+  misaligned  "at" further than the tolerance from a slot
+  duplicate   more than one record in a slot
+  gap         slots with no record, not counted after a record with the SAVE
+              or CRITICAL power profile bit, those stretch the interval. The
+              slots the station counted itself ("gap") are shown with it
+  clock       time going back in the log, or forward by more than a day
+
+Records with SSB_SG_BURST are on the burst schedule, and records whose "cad"
+(obs_fast) is not the interval are on the adaptive cadence, both are only
+counted and no gap is counted after them. A "late" record was taken after the
+start of its slot, it is counted in the slot it started in and not misaligned.
+The SystemStatusBits of hth are summed per station, 0x40 and 0x200 are named
+OVERRUN and WDT as from log schema 2, before it they were never set. Exit
+status 1 when any station has a problem.
+
+Usage: obscheck.py [-i MINUTES] [-t SECONDS] [-j JOBS] PATH [...]
+"""
+import argparse
+import calendar
+import mmap
+import os
+import re
+import sys
+import time
+from multiprocessing import Pool
+
+from obsingest import station_of
+
+# SystemStatusBits, SSG_FAL_ULP.ino
+SSB = [(0x1, "PWRON"), (0x2, "SD"), (0x4, "RTC"), (0x8, "OLED"), (0x10, "N2S"), (0x20, "FROM_N2S"),
+       (0x40, "OVERRUN"), (0x80, "BMX_1"), (0x100, "BMX_2"), (0x200, "WDT"), (0x400, "SI1145"),
+       (0x800, "MCP_1"), (0x1000, "DS_1"), (0x2000, "PWR_SAVE"), (0x4000, "PWR_CRIT"), (0x8000, "SG_BURST")]
+SSB_PWR = 0x2000 | 0x4000
+SSB_SG_BURST = 0x8000
+CLOCK_JUMP_S = 86400
+
+# Observation records, not the summaries that have "p" after "at"
+REC = re.compile(rb'^\{"at":"(\d{4})-(\d\d)-(\d\d)T(\d\d):(\d\d):(\d\d)",(?!"p")[^\n]*?"hth":(\d+)', re.M)
+CAD = re.compile(rb'"cad":(\d+)')
+LATE = re.compile(rb'"late":1')
+GAP = re.compile(rb'"gap":(\d+)')
+
+
+def read_log(path):
+    """ Worker: (station, path, [(epoch, hth, cad minutes or 0, late, gap)] in file order) """
+    recs = []
+    with open(path, "rb") as f:
+        if os.fstat(f.fileno()).st_size:
+            with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as m:
+                for g in REC.finditer(m):
+                    t = calendar.timegm(tuple(int(x) for x in g.groups()[:6]))
+                    c = CAD.search(m, g.start(), g.end())
+                    late = LATE.search(m, g.start(), g.end()) is not None
+                    n = GAP.search(m, g.start(), g.end())
+                    recs.append((t, int(g.group(7)), int(c.group(1)) if c else 0, late, int(n.group(1)) if n else 0))
+    return station_of(path), path, recs
+
+
+def find_logs(paths):
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, files in os.walk(p):
+                for name in sorted(files):
+                    if name.lower().endswith(".log"):
+                        yield os.path.join(root, name)
+        else:
+            yield p
+
+
+def check(stn, files, interval, tol):
+    """ Report lines for a station, and whether it had a problem """
+    out = []
+    bits = {}
+    slots = {}
+    seq = []
+    nburst = 0
+    ncad = 0
+    nlate = 0
+    for path, recs in sorted(files):
+        prev = None
+        for t, hth, cad, late, gap in recs:
+            for b, _ in SSB:
+                if hth & b:
+                    bits[b] = bits.get(b, 0) + 1
+            if prev is not None and (t < prev or t - prev > CLOCK_JUMP_S):
+                out.append("  clock      %s %+ds" % (os.path.basename(path), t - prev))
+            prev = t
+            if hth & SSB_SG_BURST:
+                nburst += 1
+                continue
+            if cad and cad * 60 != interval:
+                ncad += 1
+                if seq:
+                    seq[-1] = (seq[-1][0], True)  # Off the interval until the next one on it
+                continue
+            off = t % interval
+            if late:
+                nlate += 1
+                slot = t // interval
+            else:
+                if min(off, interval - off) > tol:
+                    out.append("  misaligned %s %ds" % (stamp(t), off))
+                slot = (t + interval // 2) // interval
+            slots[slot] = slots.get(slot, 0) + 1
+            seq.append((slot, bool(hth & SSB_PWR), gap))
+
+    for slot, n in sorted(slots.items()):
+        if n > 1:
+            out.append("  duplicate  %s x%d" % (stamp(slot * interval), n))
+    seq.sort()
+    missing = 0
+    for (s0, held, _), (s1, _, gap) in zip(seq, seq[1:]):
+        if s1 - s0 > 1 and not held:
+            missing += s1 - s0 - 1
+            out.append("  gap        %s %d slots%s" % (stamp((s0 + 1) * interval), s1 - s0 - 1,
+                                                    " (station %d)" % gap if gap else ""))
+
+    head = "%s: %d records, %d burst, %d cadence, %d late, %s to %s, %d missing" % (
+        stn, len(seq) + nburst + ncad, nburst, ncad, nlate, stamp(seq[0][0] * interval) if seq else "-",
+        stamp(seq[-1][0] * interval) if seq else "-", missing)
+    hth = "  hth        " + (" ".join("%s:%d" % (name, bits[b]) for b, name in SSB if b in bits) or "none")
+    return [head, hth] + out, len(out) > 0
+
+
+def stamp(t):
+    return time.strftime("%Y-%m-%dT%H:%M:%S", time.gmtime(t))
+
+
+def main(argv):
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("-i", "--interval", type=int, default=15, help="obs_interval in minutes")
+    ap.add_argument("-t", "--tolerance", type=int, default=60, help="seconds off the slot allowed")
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    ap.add_argument("paths", nargs="+")
+    args = ap.parse_args(argv[1:])
+
+    stations = {}
+    with Pool(args.jobs) as pool:
+        for stn, path, recs in pool.imap_unordered(read_log, find_logs(args.paths), chunksize=16):
+            stations.setdefault(stn, []).append((path, recs))
+
+    bad = False
+    for stn in sorted(stations):
+        lines, problem = check(stn, stations[stn], args.interval * 60, args.tolerance)
+        bad = bad or problem
+        sys.stdout.write("\n".join(lines) + "\n")
+    return 1 if bad else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+obscrc.py - Check the CRC32s of SSG_FAL_ULP binary logs (/OBS/YYYYMMDD.bin, .bst, .dla, FLASH.bin)
+
+A .bin with a footer (written when its day rolled over) is checked against the
+footer's CRC32 of the whole file, without reading its records. A .bin without
+one, the current day or FLASH.bin, has its schema header and each type 4 or 5
+record checked instead. A .bst has the CRC32 of each 512 byte block checked.
+A .dla archive has only its footer, one without is still being written. One
+line per file:
+
+  ok        footer or every block matches
+  records   no footer, every record with a CRC matches
+  open      .dla with no footer yet
+  BAD       what did not match
+
+Exit status 1 when any file is bad.
+
+Usage: obscrc.py PATH [...]
+       PATH is a file or a directory searched for them
+"""
+import os
+import struct
+import sys
+import zlib
+
+from obsbin2json import BLOCK, HEADER, REC_V4, RECS, SD_BIN_HEADER, block_ok, footer_ok
+
+EXT = (".bin", ".bst", ".dla")
+
+
+def check_bst(data):
+    if len(data) % BLOCK:
+        return "BAD size %d, not whole blocks" % len(data)
+    bad = [off // BLOCK for off in range(0, len(data), BLOCK) if not block_ok(data, off)]
+    return "BAD blocks %s" % " ".join(str(b) for b in bad) if bad else "ok %d blocks" % (len(data) // BLOCK)
+
+
+def check_bin(data):
+    ftr = footer_ok(data)
+    if ftr is not None:
+        return "ok footer" if ftr else "BAD footer"
+    off = n = 0
+    bad = []
+    while off < len(data):
+        if data[off] == SD_BIN_HEADER and off + HEADER.size <= len(data):
+            if zlib.crc32(data[off:off + HEADER.size - 4]) != HEADER.unpack_from(data, off)[-1]:
+                bad.append("header at %d" % off)
+            off += HEADER.size
+            continue
+        rec = RECS.get(data[off])
+        if rec is None or off + rec.size > len(data):
+            bad.append("at %d unparsed" % off)
+            break
+        if rec is REC_V4:
+            n += 1
+            crc, = struct.unpack_from("<I", data, off + rec.size - 4)
+            if zlib.crc32(data[off:off + rec.size - 4]) != crc:
+                bad.append("at %d" % off)
+        off += rec.size
+    return "BAD records %s" % ", ".join(bad) if bad else "records %d" % n
+
+
+def check_dla(data):
+    ftr = footer_ok(data)
+    if ftr is None:
+        return "open %d bytes" % len(data)
+    return "ok footer" if ftr else "BAD footer"
+
+
+def find_files(paths):
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, files in os.walk(p):
+                for name in sorted(files):
+                    if name.lower().endswith(EXT) and name.upper() != "JOURNAL.BIN":
+                        yield os.path.join(root, name)
+        else:
+            yield p
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    status = 0
+    for path in find_files(argv[1:]):
+        with open(path, "rb") as f:
+            data = f.read()
+        ext = os.path.splitext(path)[1].lower()
+        result = check_bst(data) if ext == ".bst" else check_dla(data) if ext == ".dla" else check_bin(data)
+        if result.startswith("BAD"):
+            status = 1
+        sys.stdout.write("%s: %s\n" % (path, result))
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+obsdelta2json.py - Convert SSG_FAL_ULP delta logs (/OBS/YYYYMMDD.dlt) and archives (.dla) to JSON lines
+
+Each record is rebuilt as the OBS_BINREC it was encoded from and printed the way
+obsbin2json.py prints a .bin record, so the output matches the .log file to the
+precision of the binary record. See the Delta Log comment in OBS.h. An archive
+(AR.h) is a delta log ending in the footer of a .bin, its CRC32 is checked.
+
+Usage: obsdelta2json.py YYYYMMDD.dlt|YYYYMMDD.dla [...] > YYYYMMDD.log
+"""
+import sys
+import zlib
+
+from obsbin2json import DS_MAX_PROBES, FOOTER, REC_V4, SD_BIN_FOOTER, footer_ok, record_to_json
+
+OBS_BIN_TYPE = 5                  # Its flags byte, bv only with OBS_BIN_F_BV
+OBS_DL_KEY = 0x80
+OBS_DL_FIXED = 14                 # sg .. hth, then dt1..dtN
+
+
+def varint(data, off):
+    """ Zig-zag LEB128 at off, returns (value, next offset) """
+    z = 0
+    shift = 0
+    while True:
+        if off >= len(data):
+            raise ValueError("record cut short")
+        b = data[off]
+        off += 1
+        z |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            break
+    return (z >> 1) ^ -(z & 1), off
+
+
+def to_binrec(at, flags, dtn, v):
+    """ REC_V4 bytes of decoded fields, as obs_dl_fields() listed them """
+    dt = list(v[OBS_DL_FIXED:OBS_DL_FIXED + dtn]) + [0] * (DS_MAX_PROBES - dtn)
+    rec = REC_V4.pack(OBS_BIN_TYPE, flags, at, *v[:13], v[13] & 0xFFFF, dtn, *dt, 0)
+    return rec[:-4] + zlib.crc32(rec[:-4]).to_bytes(4, "little")
+
+
+def decode(data):
+    """ Yield a JSON line per record, stops at the first record that does not decode """
+    off = 0
+    prev = None                   # (at, interval, flags, dtn, fields)
+    while off < len(data):
+        tag = data[off]
+        if tag == SD_BIN_FOOTER and off + FOOTER.size == len(data):
+            if not footer_ok(data):
+                raise ValueError("footer CRC")
+            return
+        off += 1
+        if tag == OBS_DL_KEY:
+            at, off = varint(data, off)
+            interval, off = varint(data, off)
+            at &= 0xFFFFFFFF
+            interval &= 0xFFFFFFFF
+            if off + 2 > len(data):
+                raise ValueError("record cut short")
+            flags, dtn = data[off], data[off + 1]
+            off += 2
+            v = []
+            for _ in range(OBS_DL_FIXED + dtn):
+                x, off = varint(data, off)
+                v.append(x)
+        elif 1 <= tag < OBS_DL_KEY and prev is not None:
+            pat, interval, flags, dtn, pv = prev
+            jitter, off = varint(data, off)
+            at = pat + tag * interval + jitter
+            v = []
+            for p in pv:
+                d, off = varint(data, off)
+                v.append(p + d)
+        else:
+            raise ValueError("bad tag %02X" % tag)
+        prev = (at, interval, flags, dtn, v)
+        yield record_to_json(to_binrec(at, flags, dtn, v))
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    for path in argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read()
+        try:
+            for line in decode(data):
+                sys.stdout.write(line + "\r\n")
+        except ValueError as e:
+            sys.stderr.write("%s: %s, rest ignored\n" % (path, e))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
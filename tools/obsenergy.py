@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+"""
+obsenergy.py - Fleet energy model from the per-phase times and energy in SSG_FAL_ULP observation logs
+
+Reads the "tm" phase times (obs_tm=1, ms) and "en" phase energy (en_ina, mJ,
+the sleep last) of the /OBS/YYYYMMDD.log records of many cards, one process
+per file. A station is the directory holding OBS, as in obsingest.py, its
+CONFIG.TXT gives the profile it ran and its OBS/BOOT.log the firmware version.
+
+  phases   median mJ and ms of each phase per firmware version over all of its
+           stations, sg and ds brought to the CF.h default config by the fit,
+           a phase more than -r percent above the version before is marked
+           REGRESSION
+  fit      the phases that follow the config, least squares over every record
+           with both arrays:  sg ms = a + b * sg_samples * sg_interval
+                              ds ms = a + b * DS18B20 conversion ms of ds_res
+  sites    per station the measured J a day and the days a battery of -c mAh
+           at -v volts lasts on its own profile and on each -p profile
+
+A -p profile is NAME:key=value,... over the station's CONFIG.TXT, keys
+obs_interval, sg_samples, sg_interval and ds_res. The other phases cost what
+they did at the station, each phase at the power it drew there and the sleep at
+its measured power, so a profile is projected per site.
+
+Usage: obsenergy.py [-c MAH] [-v VOLTS] [-r PERCENT] [-p NAME:key=value,...] [-j JOBS] PATH [...]
+"""
+import argparse
+import os
+import sys
+from multiprocessing import Pool
+
+from obsingest import parse_line, station_of
+
+# ph_names[] in WD.h, "arch" was added last, older firmware logs one fewer
+PH_NAMES = ["wake", "i2c", "sg", "bmx", "mcp", "ds", "fmt", "sd", "out", "sleep", "arch"]
+PH_SG = 2
+PH_DS = 5
+
+# CONFIG.TXT defaults, CF.h
+CF_DEFAULTS = {"obs_interval": 15, "sg_samples": 60, "sg_interval": 250, "ds_res": 12}
+DS_CONV_MS = {9: 94, 10: 188, 11: 375, 12: 750}
+
+
+def station_dir(path):
+    d = os.path.dirname(os.path.abspath(path))
+    return os.path.dirname(d) if os.path.basename(d).upper() == "OBS" else d
+
+
+def read_config(d):
+    cf = dict(CF_DEFAULTS)
+    try:
+        with open(os.path.join(d, "CONFIG.TXT"), "r", errors="replace") as f:
+            for line in f:
+                k, sep, v = line.strip().partition("=")
+                if sep and not k.startswith("#") and k in cf:
+                    try:
+                        cf[k] = int(v)
+                    except ValueError:
+                        pass
+    except OSError:
+        pass
+    return cf
+
+
+def read_version(d):
+    try:
+        with open(os.path.join(d, "OBS", "BOOT.log"), "r", errors="replace") as f:
+            for line in f:
+                if line.startswith("SSG"):
+                    return line.strip()
+    except OSError:
+        pass
+    return "unknown"
+
+
+def read_file(path):
+    """ Worker: (station, its directory, [(interval s, tm ms, en mJ)]) of one file """
+    recs = []
+    with open(path, "r", errors="replace") as f:
+        for line in f:
+            rec = parse_line(line)
+            if rec is None or "p" in rec or ("tm" not in rec and "en" not in rec):
+                continue
+            try:
+                tm = [int(x) for x in rec["tm"].split(";")] if "tm" in rec else None
+                en = [float(x) for x in rec["en"].split(";")] if "en" in rec else None
+                cad = int(rec["cad"]) * 60 if "cad" in rec else 0
+            except ValueError:
+                continue
+            recs.append((cad, tm, en))
+    return station_of(path), station_dir(path), recs
+
+
+def find_logs(paths):
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, files in os.walk(p):
+                for name in sorted(files):
+                    if name.lower().endswith(".log") and name.upper() != "BOOT.LOG":
+                        yield os.path.join(root, name)
+        else:
+            yield p
+
+
+def median(v):
+    v = sorted(v)
+    n = len(v)
+    if n == 0:
+        return None
+    return v[n // 2] if n % 2 else (v[n // 2 - 1] + v[n // 2]) / 2.0
+
+
+def fit_line(xy):
+    """ Least squares a, b of y = a + b * x, b = 0 with one x """
+    n = len(xy)
+    if n == 0:
+        return None
+    mx = sum(x for x, _ in xy) / float(n)
+    my = sum(y for _, y in xy) / float(n)
+    sxx = sum((x - mx) ** 2 for x, _ in xy)
+    b = sum((x - mx) * (y - my) for x, y in xy) / sxx if sxx else 0.0
+    return my - b * mx, b
+
+
+class Station:
+    def __init__(self, name, d):
+        self.name = name
+        self.cf = read_config(d)
+        self.version = read_version(d)
+        self.recs = []
+
+    def phases(self):
+        """ Median ms and mJ of each phase and of the sleep, and the sleep mW """
+        ms = {}
+        mj = {}
+        sleep_mw = []
+        for cad, tm, en in self.recs:
+            interval = cad or self.cf["obs_interval"] * 60
+            if tm:
+                for name, t in zip(PH_NAMES, tm):
+                    ms.setdefault(name, []).append(t)
+            if en:
+                for name, e in zip(PH_NAMES, en[:-1]):
+                    mj.setdefault(name, []).append(e)
+                if tm:
+                    asleep = interval - sum(tm) / 1000.0
+                    if asleep > 0:
+                        sleep_mw.append(en[-1] / asleep)
+        return ({k: median(v) for k, v in ms.items()}, {k: median(v) for k, v in mj.items()}, median(sleep_mw))
+
+
+def rescale(ms, mj, cf, fits):
+    """ Phase ms and mJ of a station moved to config cf, the phases with a fit at the power they drew """
+    ms, mj = dict(ms), dict(mj)
+    for name, fit, x in ((PH_NAMES[PH_SG], fits.get("sg"), cf["sg_samples"] * cf["sg_interval"]),
+                         (PH_NAMES[PH_DS], fits.get("ds"), DS_CONV_MS.get(cf["ds_res"], 750))):
+        t = ms.get(name)
+        if fit and t:
+            t_new = max(fit[0] + fit[1] * x, 0.0)
+            if mj.get(name) is not None:
+                mj[name] = mj[name] * t_new / t
+            ms[name] = t_new
+    return ms, mj
+
+
+def project(st, cf, fits, cap_j):
+    """ J a day and battery days of station st on config cf, None without energy """
+    ms, mj, sleep_mw = st.phases()
+    if not mj or sleep_mw is None:
+        return None
+    ms, mj = rescale(ms, mj, cf, fits)
+    cycle_mj = 0.0
+    awake_s = 0.0
+    for name, e in mj.items():
+        cycle_mj += e
+        awake_s += (ms.get(name) or 0) / 1000.0
+    per_day = 86400.0 / (cf["obs_interval"] * 60)
+    day_j = (per_day * cycle_mj + sleep_mw * max(86400.0 - per_day * awake_s, 0.0)) / 1000.0
+    return (day_j, cap_j / day_j) if day_j > 0 else None
+
+
+def parse_profile(text):
+    name, sep, body = text.partition(":")
+    if not sep:
+        raise argparse.ArgumentTypeError("profile %s is not NAME:key=value,..." % text)
+    cf = {}
+    for item in body.split(","):
+        k, sep, v = item.partition("=")
+        if not sep or k not in CF_DEFAULTS:
+            raise argparse.ArgumentTypeError("profile %s: %s is not one of %s" % (name, item, " ".join(CF_DEFAULTS)))
+        cf[k] = int(v)
+    return name, cf
+
+
+def main(argv):
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("-c", "--capacity", type=float, default=2000, help="battery mAh")
+    ap.add_argument("-v", "--volts", type=float, default=3.7, help="battery nominal V")
+    ap.add_argument("-r", "--regression", type=float, default=10, help="percent a phase may grow between versions")
+    ap.add_argument("-p", "--profile", type=parse_profile, action="append", default=[])
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    ap.add_argument("paths", nargs="+")
+    args = ap.parse_args(argv[1:])
+
+    stations = {}
+    with Pool(args.jobs) as pool:
+        for stn, d, recs in pool.imap_unordered(read_file, find_logs(args.paths), chunksize=16):
+            if stn not in stations:
+                stations[stn] = Station(stn, d)
+            stations[stn].recs.extend(recs)
+    stations = {k: s for k, s in stations.items() if s.recs}
+    if not stations:
+        sys.stderr.write("no records with tm or en, set obs_tm=1 and en_ina\n")
+        return 1
+
+    # Fleet fits of the phases that follow the config
+    sg_xy, ds_xy = [], []
+    for s in stations.values():
+        for _, tm, _ in s.recs:
+            if tm and len(tm) > PH_DS:
+                sg_xy.append((s.cf["sg_samples"] * s.cf["sg_interval"], tm[PH_SG]))
+                ds_xy.append((DS_CONV_MS.get(s.cf["ds_res"], 750), tm[PH_DS]))
+    fits = {"sg": fit_line(sg_xy), "ds": fit_line(ds_xy)}
+
+    # Per version phase medians over its stations' medians, oldest first (VERSION_INFO ends in YYMMDD)
+    print("phases")
+    prev = None
+    for ver in sorted(set(s.version for s in stations.values()), key=lambda v: (v.rsplit("-", 1)[-1], v)):
+        group = [s for s in stations.values() if s.version == ver]
+        ph = [rescale(*s.phases()[:2], cf=CF_DEFAULTS, fits=fits) for s in group]
+        mj = {n: median([p[1][n] for p in ph if p[1].get(n) is not None]) for n in PH_NAMES}
+        ms = {n: median([p[0][n] for p in ph if p[0].get(n) is not None]) for n in PH_NAMES}
+        print("  %s  %d stations" % (ver, len(group)))
+        for n in PH_NAMES:
+            if mj[n] is None and ms[n] is None:
+                continue
+            mark = ""
+            if prev and mj[n] and prev.get(n):
+                grow = 100.0 * (mj[n] - prev[n]) / prev[n]
+                mark = "  %+.0f%%%s" % (grow, " REGRESSION" if grow > args.regression else "")
+            print("    %-6s %10s mJ %8s ms%s" % (n, "-" if mj[n] is None else "%.2f" % mj[n],
+                                                  "-" if ms[n] is None else "%d" % ms[n], mark))
+        prev = mj
+
+    print("fit")
+    for name, fit, x in (("sg", fits["sg"], "sg_samples*sg_interval"), ("ds", fits["ds"], "conversion ms")):
+        print("  %s ms = %.1f + %.4f * %s" % (name, fit[0], fit[1], x) if fit else "  %s no tm records" % name)
+
+    cap_j = args.capacity * 3.6 * args.volts
+    print("sites  J/day and battery days of %.0f mAh at %.1f V" % (args.capacity, args.volts))
+    for stn in sorted(stations):
+        s = stations[stn]
+        cols = []
+        for name, over in [("site", {})] + args.profile:
+            cf = dict(s.cf)
+            cf.update(over)
+            p = project(s, cf, fits, cap_j)
+            cols.append("%s %s" % (name, "no en" if p is None else "%.1fJ %.0fd" % p))
+        print("  %-16s %-20s %dm  %s" % (stn, s.version, s.cf["obs_interval"], "  ".join(cols)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
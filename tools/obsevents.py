@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""
+obsevents.py - Expand SSG_FAL_ULP event logs (/OBS/EVENTS.bin) to text
+
+One line per event: time, code and the text the station printed for it, so
+the files of many stations can be concatenated and grepped by code.
+
+Usage: obsevents.py EVENTS.bin [...]
+"""
+import struct
+import sys
+from datetime import datetime, timezone
+
+# EV_REC in EV.h
+EV_REC = struct.Struct("<IBBh")     # unix time, id, pad, argument
+
+# EV_TABLE in EV.h, same order
+EV_TEXT = [
+    "EV:None",
+    "EV:Boot RCAUSE %02X",
+    "EV:%d Lost",
+    "WD:Reset after phase %d",
+    "PH:Overrun phase %d",
+    "SD:NF",
+    "BMX%d ONLINE",
+    "BMX%d OFFLINE",
+    "DS NF",
+    "DS CRC",
+    "OBS Open Log Err",
+    "OBS Write Log Err",
+    "BIN Open Log Err",
+    "SUM Open Log Err",
+    "SD:Write Err %d",
+    "SD:Retry %d",
+    "SD:Dropped %d",
+    "FL:Open Err",
+    "FL:Write Err",
+    "ERR:RTC INT %d LOW",
+    "ERR:RTC Alarm",
+    "SG:model %d NF",
+    "CF:Reload %d Changed",
+    "PWR:Brownout %dmV",
+    "PWR:Clean Shutdown",
+    "OBS:Gap %d Slots",
+    "ERR:RTC 32K %d Edges",
+    "SS:Season From %04d",
+    "TM:Woke %ds Off",
+]
+
+
+def event_text(ev_id, arg):
+    if ev_id >= len(EV_TEXT):
+        return "EV:Unknown %d" % arg
+    text = EV_TEXT[ev_id]
+    return text % arg if "%" in text else text
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    for path in argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read()
+        if len(data) % EV_REC.size:
+            sys.stderr.write("%s: %d bytes at the end ignored\n" % (path, len(data) % EV_REC.size))
+        for off in range(0, len(data) - EV_REC.size + 1, EV_REC.size):
+            at, ev_id, _, arg = EV_REC.unpack_from(data, off)
+            t = datetime.fromtimestamp(at, timezone.utc)
+            sys.stdout.write("%d-%02d-%02dT%02d:%02d:%02d E%02d:%d %s\n" % (
+                t.year, t.month, t.day, t.hour, t.minute, t.second, ev_id, arg, event_text(ev_id, arg)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+obsexport.py - Pull SSG_FAL_ULP daily files over the USB serial console (calibration mode)
+
+Sends the X command of EX.h and writes each day's file as YYYYMMDD.<ext> in the
+output directory. Frames are CRC checked; after a bad frame, a timeout or a
+dropped port the command is sent again from the last good day and offset, so
+a transfer picks up where it stopped.
+
+Usage: obsexport.py PORT YYYYMMDD[-YYYYMMDD] [log|bin|idx|dla] [OUTDIR]
+"""
+import os
+import struct
+import sys
+import time
+from datetime import datetime, timedelta
+
+import serial  # pyserial
+
+HDR = struct.Struct("<IIH")         # day, offset, len after the 'XF' sync
+RETRIES = 20
+
+
+def crc16(data, crc=0):
+    """CRC-16/ARC, OneWire::crc16() in the sketch"""
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def next_day(day):
+    return (datetime.strptime(day, "%Y%m%d") + timedelta(days=1)).strftime("%Y%m%d")
+
+
+def read_exact(port, n):
+    data = port.read(n)
+    if len(data) != n:
+        raise IOError("timeout")
+    return data
+
+
+def frames(port):
+    """Yield (day, offset, data) until the end frame, IOError on a bad frame"""
+    sync = b""
+    while True:
+        b = port.read(1)
+        if not b:
+            raise IOError("timeout")
+        sync = (sync + b)[-2:]
+        if sync != b"XF":
+            continue                # Console text before the first frame
+        sync = b""
+        hdr = read_exact(port, HDR.size)
+        day, offset, length = HDR.unpack(hdr)
+        data = read_exact(port, length)
+        (crc,) = struct.unpack("<H", read_exact(port, 2))
+        if crc != crc16(hdr + data):
+            raise IOError("crc")
+        if day == 0:
+            return
+        yield day, offset, data
+
+
+def export(portname, span, ext, outdir):
+    first, _, last = span.partition("-")
+    last = last or first
+    day, offset = first, 0
+
+    for attempt in range(RETRIES):
+        try:
+            with serial.Serial(portname, 115200, timeout=5) as port:
+                port.reset_input_buffer()
+                port.write(f"X {day}-{last} {ext} +{offset}\n".encode())
+                for d, off, data in frames(port):
+                    name = os.path.join(outdir, f"{d}.{ext}")
+                    mode = "r+b" if os.path.exists(name) and off else "wb"
+                    with open(name, mode) as f:
+                        f.seek(off)
+                        f.write(data)
+                        if not data:
+                            f.truncate(off)
+                            print(f"{name} {off} bytes")
+                    day, offset = str(d), off + len(data)
+                    if not data:
+                        day, offset = next_day(day), 0
+                        if day > last:
+                            return 0
+                return 0
+        except (IOError, serial.SerialException) as e:
+            sys.stderr.write(f"retry from {day} +{offset}: {e}\n")
+            time.sleep(2)
+    return 1
+
+
+def main(argv):
+    if len(argv) < 3:
+        sys.stderr.write(__doc__)
+        return 1
+    ext = argv[3] if len(argv) > 3 else "log"
+    outdir = argv[4] if len(argv) > 4 else "."
+    return export(argv[1], argv[2], ext, outdir)
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""
+obsidx.py - Print the records of an SSG_FAL_ULP daily log (/OBS/YYYYMMDD.log) in a time window
+
+Uses the YYYYMMDD.idx sidecar written with sd_idx=1: a binary search of the
+index for the first minute, then one seek into the log. Without an end time
+the window is the single minute given.
+
+Usage: obsidx.py YYYYMMDD.log HH:MM [HH:MM]
+"""
+import bisect
+import struct
+import sys
+
+# SD_IDXENT in SDC.h
+IDXENT = struct.Struct("<HHI")      # minute of day, record length, byte offset
+
+
+def minute_of_day(hhmm):
+    h, m = hhmm.split(":")
+    return int(h) * 60 + int(m)
+
+
+def read_index(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    n = len(data) // IDXENT.size
+    return [IDXENT.unpack_from(data, i * IDXENT.size) for i in range(n)]
+
+
+def main(argv):
+    if len(argv) not in (3, 4):
+        sys.stderr.write(__doc__)
+        return 1
+    log = argv[1]
+    first = minute_of_day(argv[2])
+    last = minute_of_day(argv[3]) if len(argv) == 4 else first
+    idx = read_index(log[:-3] + "idx")
+
+    i = bisect.bisect_left([e[0] for e in idx], first)
+    with open(log, "rb") as f:
+        while i < len(idx) and idx[i][0] <= last:
+            minute, length, offset = idx[i]
+            f.seek(offset)
+            sys.stdout.write(f.read(length).decode("ascii", "replace") + "\r\n")
+            i += 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""
+obsingest.py - Convert the observation logs of many SSG_FAL_ULP cards to one table per station
+
+Reads /OBS/YYYYMMDD.log JSON lines, .bin and .bst records, .dlt delta
+logs and .dla archives, one process per file, and writes STATION.csv, or STATION.parquet when
+pyarrow is installed and -f parquet is given. Summary records ("p") go to STATION_sum.
+A .dla is skipped when the .log it was archived from is still there.
+The station is the directory holding OBS, or the file's own directory when it
+is not in one named OBS.
+
+The lines are parsed for the grammar OBS_Do() writes with the jb_ functions in
+SF.h rather than by json.loads(): string values (at, p) have no escapes and
+arrays (i2c, tm, sgw, slp, sdio) hold integers only, so a record splits on ',"' into
+its key:value pairs. Numbers stay the text the station wrote, arrays are
+written as their values joined with ';'.
+
+Usage: obsingest.py [-j JOBS] [-f csv|parquet] [-o OUTDIR] PATH [...]
+       PATH is a log file or a directory searched for them
+"""
+import argparse
+import csv
+import os
+import sys
+from multiprocessing import Pool
+
+from obsbin2json import record_to_json, records
+from obsdelta2json import decode as delta_decode
+
+LOG_EXT = (".log", ".bin", ".bst", ".dlt", ".dla")
+
+
+def parse_line(line):
+    """ Key and value text of a record, None if it is not one """
+    line = line.strip()
+    if len(line) < 2 or line[0] != "{" or line[-1] != "}":
+        return None
+    rec = {}
+    for item in line[2:-1].split(',"'):
+        k, sep, v = item.partition('":')
+        if not sep:
+            return None
+        if v[:1] == '"':
+            v = v[1:-1]
+        elif v[:1] == "[":
+            v = v[1:-1].replace(",", ";")
+        rec[k] = v
+    return rec
+
+
+def bin_lines(data, path):
+    for rec in records(data, path, path.lower().endswith(".bst")):
+        yield record_to_json(rec)
+
+
+def delta_lines(data, path):
+    try:
+        for line in delta_decode(data):
+            yield line
+    except ValueError as e:
+        sys.stderr.write("%s: %s, rest ignored\n" % (path, e))
+
+
+def station_of(path):
+    d = os.path.dirname(os.path.abspath(path))
+    if os.path.basename(d).upper() == "OBS":
+        d = os.path.dirname(d)
+    return os.path.basename(d)
+
+
+def read_file(path):
+    """ Worker: (station, observation records, summary records) of one file """
+    ext = os.path.splitext(path)[1].lower()
+    if ext == ".log":
+        with open(path, "r", errors="replace") as f:
+            lines = f.readlines()
+    else:
+        with open(path, "rb") as f:
+            data = f.read()
+        lines = delta_lines(data, path) if ext in (".dlt", ".dla") else bin_lines(data, path)
+    obs, sums = [], []
+    for line in lines:
+        rec = parse_line(line)
+        if rec is not None and "at" in rec:
+            (sums if "p" in rec else obs).append(rec)
+    return station_of(path), obs, sums
+
+
+def find_logs(paths):
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, files in os.walk(p):
+                names = set(n.lower() for n in files)
+                for name in sorted(files):
+                    stem, ext = os.path.splitext(name.lower())
+                    if ext == ".dla" and stem + ".log" in names:
+                        continue
+                    if name.lower().endswith(LOG_EXT):
+                        yield os.path.join(root, name)
+        else:
+            yield p
+
+
+def columns(rows):
+    cols = {}
+    for r in rows:
+        for k in r:
+            cols.setdefault(k, None)
+    return list(cols)
+
+
+def write_csv(path, rows):
+    cols = columns(rows)
+    with open(path, "w", newline="") as f:
+        w = csv.DictWriter(f, cols, restval="", lineterminator="\n")
+        w.writeheader()
+        w.writerows(rows)
+
+
+def write_parquet(path, rows):
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+
+    cols = columns(rows)
+    table = {}
+    for c in cols:
+        v = [r.get(c) for r in rows]
+        if c not in ("at", "p") and all(x is None or ";" not in x for x in v):
+            try:
+                v = [None if x is None else float(x) for x in v]
+            except ValueError:
+                pass
+        table[c] = v
+    pq.write_table(pa.table(table), path, compression="zstd")
+
+
+def main(argv):
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    ap.add_argument("-f", "--format", choices=("csv", "parquet"), default="csv")
+    ap.add_argument("-o", "--outdir", default=".")
+    ap.add_argument("paths", nargs="+")
+    args = ap.parse_args(argv[1:])
+
+    files = list(find_logs(args.paths))
+    stations = {}
+    with Pool(args.jobs) as pool:
+        for stn, obs, sums in pool.imap_unordered(read_file, files, chunksize=8):
+            s = stations.setdefault(stn, ([], []))
+            s[0].extend(obs)
+            s[1].extend(sums)
+
+    write = write_parquet if args.format == "parquet" else write_csv
+    os.makedirs(args.outdir, exist_ok=True)
+    for stn, (obs, sums) in sorted(stations.items()):
+        for rows, suffix in ((obs, ""), (sums, "_sum")):
+            if rows:
+                rows.sort(key=lambda r: r["at"])
+                write(os.path.join(args.outdir, "%s%s.%s" % (stn, suffix, args.format)), rows)
+        sys.stderr.write("%s: %d records %d summaries\n" % (stn, len(obs), len(sums)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
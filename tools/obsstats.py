@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""
+obsstats.py - Print the SSG_FAL_ULP health counters (/OBS/STATS.bin)
+
+One line per file with the totals and the events that happened, by their
+catalog text, so the files of a fleet can be compared side by side. Version 2
+records add the SD write latency histograms, printed as the count in each
+log2 bin that has any, bin 0 under 256us and bin b up to 2^(b+8)us.
+
+Usage: obsstats.py STATS.bin [...]
+"""
+import struct
+import sys
+from datetime import datetime, timezone
+
+from obsevents import EV_TEXT
+
+# RS_STATS in RS.h
+RS_MAGIC = 0x54534253
+RS_EV_MAX = 64
+RS_LAT_KINDS = 3
+RS_LAT_BINS = 16
+RS_LAT_NAMES = ("blk", "multi", "flush")
+RS_HEAD = struct.Struct("<IHHIIIIIIHH%dH" % RS_EV_MAX)
+RS_STATS = {1: struct.Struct(RS_HEAD.format + "H"),
+            2: struct.Struct(RS_HEAD.format + "%dHH" % (RS_LAT_KINDS * RS_LAT_BINS))}
+
+
+def crc16(data):
+    """ CRC-16/ARC, OneWire::crc16() """
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def stamp(t):
+    return datetime.fromtimestamp(t, timezone.utc).strftime("%Y-%m-%dT%H:%M:%S")
+
+
+def bin_edge(b):
+    if b == RS_LAT_BINS - 1:
+        return ">=%dms" % ((128 << b) // 1000)
+    us = 256 << b
+    return "<%dus" % us if us < 1000 else "<%dms" % ((us + 999) // 1000)
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    for path in argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read(512)
+        rec = RS_STATS.get(struct.unpack_from("<H", data, 4)[0]) if len(data) >= RS_HEAD.size else None
+        if rec is None or len(data) < rec.size:
+            sys.stderr.write("%s: not a stats record\n" % path)
+            continue
+        data = data[:rec.size]
+        v = rec.unpack(data)
+        magic, version, events, since, at, boots, obs, awake, i2c, vmin, vmax = v[:11]
+        ev = v[11:11 + RS_EV_MAX]
+        lat = v[11 + RS_EV_MAX:-1]
+        if magic != RS_MAGIC or v[-1] != crc16(data[:-2]):
+            sys.stderr.write("%s: not a stats record\n" % path)
+            continue
+        hours = max(at - since, 1) / 3600.0
+        print("%s since %s at %s boots %d obs %d awake %ds (%.1fs/h) i2c %d bat %d-%dmV" % (
+            path, stamp(since), stamp(at), boots, obs, awake, awake / hours, i2c, vmin, vmax))
+        for i in range(1, min(events, RS_EV_MAX)):
+            if ev[i]:
+                text = EV_TEXT[i] if i < len(EV_TEXT) else "EV:%d" % i
+                print("  E%02d %6d  %s" % (i, ev[i], text))
+        for k, name in enumerate(RS_LAT_NAMES[:len(lat) // RS_LAT_BINS]):
+            h = lat[k * RS_LAT_BINS:(k + 1) * RS_LAT_BINS]
+            if any(h):
+                print("  sd %-5s %s" % (name, " ".join("%s:%d" % (bin_edge(b), n) for b, n in enumerate(h) if n)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""
+sgraw2csv.py - Print the raw gauge samples of SSG_FAL_ULP captures (/OBS/RAW/YYYYMMDD.bin) as CSV
+
+One row per sample: window start, capture number in the file, ms into the
+window, channel, sample and, with -f, the sample in mm. Samples are ADC counts
+at the record's bits, PW ticks (3 a mm) or mm (serial), as s_gauge_sample()
+took them. With -s only the header of each capture is printed.
+
+  -f FULL_SCALE_MM  5120 (5m sensors) or 10240 (10m), for ADC samples
+
+Usage: sgraw2csv.py [-s] [-f FULL_SCALE_MM] YYYYMMDD.bin [...] > raw.csv
+"""
+import argparse
+import struct
+import sys
+from datetime import datetime, timezone
+
+# SG_RAWHDR in SG.h
+RAWHDR = struct.Struct("<HIIHHBBBB")      # 18 bytes
+SG_RAW_MAGIC = 0x5752
+SG_RAW_F_SELECTED = 0x01
+SG_RAW_F_TRIG = 0x02
+SOURCES = {0: "adc", 1: "pw", 2: "serial"}
+SG_PW_TICKS_MM = 3
+
+
+def captures(data, path):
+    off = 0
+    while off + RAWHDR.size <= len(data):
+        magic, at, window_ms, interval_ms, n, source, bits, chans, flags = RAWHDR.unpack_from(data, off)
+        if magic != SG_RAW_MAGIC or off + RAWHDR.size + 2 * n > len(data):
+            sys.stderr.write("%s: bad capture at offset %d, rest ignored\n" % (path, off))
+            return
+        off += RAWHDR.size
+        samples = struct.unpack_from("<%dH" % n, data, off)
+        off += 2 * n
+        yield at, window_ms, interval_ms, source, bits, max(chans, 1), flags, samples
+
+
+def to_mm(v, source, bits, full_scale):
+    if source == 1:
+        return v // SG_PW_TICKS_MM
+    if source == 2:
+        return v
+    if full_scale:
+        return (v * full_scale) >> bits
+    return ""
+
+
+def main(argv):
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("-s", "--summary", action="store_true")
+    ap.add_argument("-f", "--full-scale", type=int, default=0)
+    ap.add_argument("paths", nargs="+")
+    args = ap.parse_args(argv[1:])
+
+    out = sys.stdout
+    out.write("at,capture,source,bits,chans,flags,window_ms,n\n" if args.summary else "at,capture,ms,chan,sample,mm\n")
+    for path in args.paths:
+        with open(path, "rb") as f:
+            data = f.read()
+        for k, (at, window_ms, interval_ms, source, bits, chans, flags, samples) in enumerate(captures(data, path)):
+            stamp = datetime.fromtimestamp(at, timezone.utc).strftime("%Y-%m-%dT%H:%M:%S")
+            if args.summary:
+                names = [name for bit, name in ((SG_RAW_F_SELECTED, "selected"), (SG_RAW_F_TRIG, "trig")) if flags & bit]
+                out.write("%s,%d,%s,%d,%d,%s,%d,%d\n" % (stamp, k, SOURCES.get(source, source), bits, chans,
+                                                        ";".join(names), window_ms, len(samples)))
+                continue
+            per_chan = len(samples) // chans or 1
+            for i, v in enumerate(samples):
+                step = i // chans
+                ms = step * interval_ms if interval_ms else (step * window_ms) // per_chan
+                out.write("%s,%d,%d,%d,%d,%s\n" % (stamp, k, ms, i % chans + 1, v,
+                                                   to_mm(v, source, bits, args.full_scale)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
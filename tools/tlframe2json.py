@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+tlframe2json.py - Convert SSG_FAL_ULP telemetry frames to JSON lines
+
+Reads the bytes a receiver saved from the radio, frames back to back or with
+other bytes between them, and prints each observation the way obsbin2json.py
+prints a .bin record. See the Telemetry comment in TL.h.
+
+Usage: tlframe2json.py FRAMES.bin [...] > OBS.log
+"""
+import sys
+
+from obsdelta2json import OBS_DL_FIXED, to_binrec, varint
+from obsbin2json import record_to_json
+
+TL_MAGIC = b"SG"
+TL_HDR_LEN = 5
+
+
+def crc16(data):
+    """ CRC-16/ARC, OneWire::crc16() """
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def frame_records(frame):
+    """ Yield a JSON line per record of a frame that passed its CRC """
+    count = frame[4]
+    off = TL_HDR_LEN
+    end = len(frame) - 2
+    at = int.from_bytes(frame[off:off + 4], "little")
+    flags, dtn = frame[off + 4], frame[off + 5]
+    off += 6
+    v = []
+    for _ in range(OBS_DL_FIXED + dtn):
+        x, off = varint(frame, off)
+        v.append(x)
+    yield record_to_json(to_binrec(at, flags, dtn, v))
+    for _ in range(count - 1):
+        d, off = varint(frame, off)
+        at = (at + d) & 0xFFFFFFFF
+        pv = v
+        v = []
+        for p in pv:
+            d, off = varint(frame, off)
+            v.append(p + d)
+        yield record_to_json(to_binrec(at, flags, dtn, v))
+    if off != end:
+        raise ValueError("frame length")
+
+
+def decode(data, name):
+    """ Find the frames in data, skipping what does not check """
+    off = data.find(TL_MAGIC)
+    while off >= 0 and off + TL_HDR_LEN <= len(data):
+        n = data[off + 2]
+        frame = data[off:off + n]
+        if n > TL_HDR_LEN + 2 and len(frame) == n and \
+                crc16(frame[:-2]) == int.from_bytes(frame[-2:], "little"):
+            try:
+                for line in frame_records(frame):
+                    yield line
+                off = data.find(TL_MAGIC, off + n)
+                continue
+            except ValueError as e:
+                sys.stderr.write("%s: seq %d %s\n" % (name, frame[3], e))
+        off = data.find(TL_MAGIC, off + 1)
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    for path in argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read()
+        for line in decode(data, path):
+            sys.stdout.write(line + "\r\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))